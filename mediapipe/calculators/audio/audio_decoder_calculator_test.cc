@@ -13,15 +13,82 @@
 // limitations under the License.
 
 #include "absl/flags/flag.h"
+#include "absl/strings/substitute.h"
 #include "mediapipe/framework/calculator_runner.h"
 #include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/formats/matrix.h"
 #include "mediapipe/framework/formats/time_series_header.pb.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/status_util.h"
+#include "mediapipe/util/audio_decoder.h"
+#include "mediapipe/util/audio_decoder.pb.h"
 
 namespace mediapipe {
+namespace {
+
+// Decodes the 2 second mono WAV test file with the given extra decoder
+// options, and returns the output audio packets.
+std::vector<Packet> DecodeMonoWav(const std::string& extra_options) {
+  CalculatorGraphConfig::Node node_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig::Node>(absl::Substitute(
+          R"pb(
+            calculator: "AudioDecoderCalculator"
+            input_side_packet: "INPUT_FILE_PATH:input_file_path"
+            output_stream: "AUDIO:audio"
+            output_stream: "AUDIO_HEADER:audio_header"
+            node_options {
+              [type.googleapis.com/mediapipe.AudioDecoderOptions]: {
+                audio_stream { stream_index: 0 }
+                $0
+              }
+            })pb",
+          extra_options));
+  CalculatorRunner runner(node_config);
+  runner.MutableSidePackets()->Tag("INPUT_FILE_PATH") = MakePacket<std::string>(
+      file::JoinPath("./",
+                     "/mediapipe/calculators/audio/"
+                     "testdata/sine_wave_1k_44100_mono_2_sec_wav.audio"));
+  MP_EXPECT_OK(runner.Run());
+  return runner.Outputs().Tag("AUDIO").packets;
+}
+
+int64 TotalNumSamples(const std::vector<Packet>& packets) {
+  int64 num_samples = 0;
+  for (const Packet& packet : packets) {
+    num_samples += packet.Get<Matrix>().cols();
+  }
+  return num_samples;
+}
+
+// Decodes the 2 second mono WAV test file with an AudioDecoder using the
+// given options, and returns the number of output samples and the number of
+// packets read from the file.
+void DecodeMonoWavWithDecoder(const std::string& options_text,
+                              int64* num_samples, int64* num_packets_read) {
+  AudioDecoder decoder;
+  MP_ASSERT_OK(decoder.Initialize(
+      file::JoinPath("./",
+                     "/mediapipe/calculators/audio/"
+                     "testdata/sine_wave_1k_44100_mono_2_sec_wav.audio"),
+      ParseTextProtoOrDie<AudioDecoderOptions>(options_text)));
+  std::vector<Packet> packets;
+  while (true) {
+    int options_index = -1;
+    Packet packet;
+    const absl::Status status = decoder.GetData(&options_index, &packet);
+    if (status == tool::StatusStop()) break;
+    MP_ASSERT_OK(status);
+    packets.push_back(std::move(packet));
+  }
+  MP_ASSERT_OK(decoder.Close());
+  *num_samples = TotalNumSamples(packets);
+  *num_packets_read = decoder.num_packets_read();
+}
+
+}  // namespace
 
 TEST(AudioDecoderCalculatorTest, TestWAV) {
   CalculatorGraphConfig::Node node_config =
@@ -147,4 +214,75 @@ TEST(AudioDecoderCalculatorTest, TestAAC) {
               std::ceil(44100.0 * 2 / 1024));
 }
 
+TEST(AudioDecoderCalculatorTest, ChunkDurationConcatenatesFrames) {
+  const std::vector<Packet> frames = DecodeMonoWav("");
+  const std::vector<Packet> chunks = DecodeMonoWav("chunk_duration: 0.5");
+  ASSERT_FALSE(chunks.empty());
+  EXPECT_LT(chunks.size(), frames.size());
+  EXPECT_EQ(TotalNumSamples(chunks), TotalNumSamples(frames));
+  EXPECT_EQ(chunks.front().Timestamp(), frames.front().Timestamp());
+  // Every chunk but the last one has at least 0.5 seconds of samples.
+  for (int i = 0; i + 1 < static_cast<int>(chunks.size()); ++i) {
+    EXPECT_GE(chunks[i].Get<Matrix>().cols(), 22050) << i;
+  }
+  // The samples are unchanged.
+  Matrix all_frames(1, TotalNumSamples(frames));
+  int64 column = 0;
+  for (const Packet& frame : frames) {
+    const Matrix& samples = frame.Get<Matrix>();
+    all_frames.middleCols(column, samples.cols()) = samples;
+    column += samples.cols();
+  }
+  column = 0;
+  for (const Packet& chunk : chunks) {
+    const Matrix& samples = chunk.Get<Matrix>();
+    EXPECT_TRUE(samples == all_frames.middleCols(column, samples.cols()));
+    column += samples.cols();
+  }
+}
+
+TEST(AudioDecoderCalculatorTest, ReadAheadMatchesSynchronousDecoding) {
+  const std::vector<Packet> expected = DecodeMonoWav("");
+  const std::vector<Packet> actual = DecodeMonoWav("read_ahead_packets: 4");
+  ASSERT_EQ(actual.size(), expected.size());
+  for (int i = 0; i < static_cast<int>(actual.size()); ++i) {
+    EXPECT_EQ(actual[i].Timestamp(), expected[i].Timestamp()) << i;
+    EXPECT_TRUE(actual[i].Get<Matrix>() == expected[i].Get<Matrix>()) << i;
+  }
+}
+
+TEST(AudioDecoderCalculatorTest, SeekToStartTime) {
+  const std::vector<Packet> packets = DecodeMonoWav(
+      "start_time: 1.0 seek_to_start_time: true read_ahead_packets: 2");
+  ASSERT_FALSE(packets.empty());
+  EXPECT_GE(packets.front().Timestamp(), Timestamp::FromSeconds(1.0));
+  // Only the frame straddling the start time may be missing.
+  const int64 num_samples = TotalNumSamples(packets);
+  EXPECT_LE(num_samples, 44100);
+  EXPECT_GT(num_samples, 44100 - 4096);
+
+  // Seeking outputs at least the samples output when the first second is
+  // decoded and dropped, as it may keep the frame straddling the start time,
+  // while reading only about half of the file.
+  int64 seek_num_samples = 0;
+  int64 seek_num_packets_read = 0;
+  DecodeMonoWavWithDecoder(
+      "audio_stream { stream_index: 0 } start_time: 1.0 "
+      "seek_to_start_time: true",
+      &seek_num_samples, &seek_num_packets_read);
+  int64 drop_num_samples = 0;
+  int64 drop_num_packets_read = 0;
+  DecodeMonoWavWithDecoder("audio_stream { stream_index: 0 } start_time: 1.0",
+                           &drop_num_samples, &drop_num_packets_read);
+  int64 full_num_samples = 0;
+  int64 full_num_packets_read = 0;
+  DecodeMonoWavWithDecoder("audio_stream { stream_index: 0 }",
+                           &full_num_samples, &full_num_packets_read);
+  EXPECT_GE(seek_num_samples, drop_num_samples);
+  EXPECT_LE(seek_num_samples, 44100);
+  EXPECT_EQ(drop_num_packets_read, full_num_packets_read);
+  EXPECT_GT(seek_num_packets_read, 0);
+  EXPECT_LT(seek_num_packets_read, full_num_packets_read * 3 / 4);
+}
+
 }  // namespace mediapipe
@@ -51,6 +51,34 @@ void CopyVectorToChannel(const std::vector<float>& vec, Matrix* matrix,
   matrix->row(channel) =
       Eigen::Map<const Eigen::ArrayXf>(vec.data(), vec.size());
 }
+
+// Sets the filter parameters of QResamplerParams or PolyphaseResampler::Params,
+// which have the same fields, from the options.
+template <typename ParamsType>
+void SetFilterParams(const double source_sample_rate,
+                     const double target_sample_rate,
+                     const RationalFactorResampleCalculatorOptions& options,
+                     ParamsType* params) {
+  const auto& rational_factor_options =
+      options.resampler_rational_factor_options();
+  if (rational_factor_options.has_radius() &&
+      rational_factor_options.has_cutoff() &&
+      rational_factor_options.has_kaiser_beta()) {
+    // Convert RationalFactorResampler kernel parameters to QResampler
+    // settings.
+    params->filter_radius_factor =
+        rational_factor_options.radius() *
+        std::min(1.0, target_sample_rate / source_sample_rate);
+    params->cutoff_proportion =
+        2 * rational_factor_options.cutoff() /
+        std::min(source_sample_rate, target_sample_rate);
+    params->kaiser_beta = rational_factor_options.kaiser_beta();
+  }
+  // Set large enough so that the resampling factor between common sample
+  // rates (e.g. 8kHz, 16kHz, 22.05kHz, 32kHz, 44.1kHz, 48kHz) is exact, and
+  // that any factor is represented with error less than 0.025%.
+  params->max_denominator = 2000;
+}
 }  // namespace
 
 absl::Status RationalFactorResampleCalculator::Open(CalculatorContext* cc) {
@@ -71,14 +99,26 @@ absl::Status RationalFactorResampleCalculator::Open(CalculatorContext* cc) {
   num_channels_ = input_header.num_channels();
 
   // Don't create resamplers for pass-thru (sample rates are equal).
+  resampler_.clear();
+  polyphase_resampler_.reset();
   if (source_sample_rate_ != target_sample_rate_) {
-    resampler_.resize(num_channels_);
-    for (auto& r : resampler_) {
-      r = ResamplerFromOptions(source_sample_rate_, target_sample_rate_,
-                               resample_options);
-      if (!r) {
-        LOG(ERROR) << "Failed to initialize resampler.";
-        return absl::UnknownError("Failed to initialize resampler.");
+    if (resample_options.use_polyphase_resampler()) {
+      PolyphaseResampler::Params params;
+      SetFilterParams(source_sample_rate_, target_sample_rate_,
+                      resample_options, &params);
+      ASSIGN_OR_RETURN(polyphase_resampler_,
+                       PolyphaseResampler::Create(source_sample_rate_,
+                                                  target_sample_rate_,
+                                                  num_channels_, params));
+    } else {
+      resampler_.resize(num_channels_);
+      for (auto& r : resampler_) {
+        r = ResamplerFromOptions(source_sample_rate_, target_sample_rate_,
+                                 resample_options);
+        if (!r) {
+          LOG(ERROR) << "Failed to initialize resampler.";
+          return absl::UnknownError("Failed to initialize resampler.");
+        }
       }
     }
   }
@@ -116,7 +156,7 @@ absl::Status RationalFactorResampleCalculator::ProcessInternal(
 
   cumulative_input_samples_ += input_frame.cols();
   std::unique_ptr<Matrix> output_frame(new Matrix(num_channels_, 0));
-  if (resampler_.empty()) {
+  if (resampler_.empty() && !polyphase_resampler_) {
     // Sample rates were same for input and output; pass-thru.
     *output_frame = input_frame;
   } else {
@@ -135,6 +175,14 @@ absl::Status RationalFactorResampleCalculator::ProcessInternal(
 bool RationalFactorResampleCalculator::Resample(const Matrix& input_frame,
                                                 Matrix* output_frame,
                                                 bool should_flush) {
+  if (polyphase_resampler_) {
+    if (should_flush) {
+      polyphase_resampler_->Flush(output_frame);
+    } else {
+      polyphase_resampler_->ProcessSamples(input_frame, output_frame);
+    }
+    return true;
+  }
   std::vector<float> input_vector;
   std::vector<float> output_vector;
   for (int i = 0; i < input_frame.rows(); ++i) {
@@ -155,25 +203,8 @@ RationalFactorResampleCalculator::ResamplerFromOptions(
     const double source_sample_rate, const double target_sample_rate,
     const RationalFactorResampleCalculatorOptions& options) {
   std::unique_ptr<Resampler<float>> resampler;
-  const auto& rational_factor_options =
-      options.resampler_rational_factor_options();
   audio_dsp::QResamplerParams params;
-  if (rational_factor_options.has_radius() &&
-      rational_factor_options.has_cutoff() &&
-      rational_factor_options.has_kaiser_beta()) {
-    // Convert RationalFactorResampler kernel parameters to QResampler
-    // settings.
-    params.filter_radius_factor =
-        rational_factor_options.radius() *
-        std::min(1.0, target_sample_rate / source_sample_rate);
-    params.cutoff_proportion = 2 * rational_factor_options.cutoff() /
-                               std::min(source_sample_rate, target_sample_rate);
-    params.kaiser_beta = rational_factor_options.kaiser_beta();
-  }
-  // Set large enough so that the resampling factor between common sample
-  // rates (e.g. 8kHz, 16kHz, 22.05kHz, 32kHz, 44.1kHz, 48kHz) is exact, and
-  // that any factor is represented with error less than 0.025%.
-  params.max_denominator = 2000;
+  SetFilterParams(source_sample_rate, target_sample_rate, options, &params);
 
   // NOTE: QResampler supports multichannel resampling, so the code might be
   // simplified using a single instance rather than one per channel.
@@ -28,6 +28,7 @@
 #include "mediapipe/framework/formats/time_series_header.pb.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/logging.h"
+#include "mediapipe/util/polyphase_resampler.h"
 #include "mediapipe/util/time_series_util.h"
 
 namespace mediapipe {
@@ -39,6 +40,10 @@ namespace mediapipe {
 //
 // NOTE: This calculator uses QResampler, despite the name, which supersedes
 // RationalFactorResampler.
+//
+// If use_polyphase_resampler is set, all channels are instead resampled
+// together by a PolyphaseResampler, which filters the interleaved samples of
+// each packet in one vectorized pass.
 class RationalFactorResampleCalculator : public CalculatorBase {
  public:
   struct TestAccess;
@@ -78,9 +83,9 @@ class RationalFactorResampleCalculator : public CalculatorBase {
   absl::Status ProcessInternal(const Matrix& input_frame, bool should_flush,
                                CalculatorContext* cc);
 
-  // Uses the internal resampler_ objects to actually resample each
-  // row of the input TimeSeries.  Returns false if the resampler
-  // state becomes inconsistent.
+  // Uses the internal resampler_ objects, or polyphase_resampler_, to
+  // actually resample each row of the input TimeSeries.  Returns false if
+  // the resampler state becomes inconsistent.
   bool Resample(const Matrix& input_frame, Matrix* output_frame,
                 bool should_flush);
 
@@ -92,6 +97,8 @@ class RationalFactorResampleCalculator : public CalculatorBase {
   bool check_inconsistent_timestamps_;
   int num_channels_;
   std::vector<std::unique_ptr<ResamplerType>> resampler_;
+  // Used instead of resampler_ if set.
+  std::unique_ptr<PolyphaseResampler> polyphase_resampler_;
 };
 
 // Test-only access to RationalFactorResampleCalculator methods.
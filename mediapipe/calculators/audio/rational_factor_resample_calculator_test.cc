@@ -31,6 +31,7 @@
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/polyphase_resampler.h"
 #include "mediapipe/util/time_series_test_util.h"
 
 namespace mediapipe {
@@ -169,6 +170,35 @@ class RationalFactorResampleCalculatorTest
     }
   }
 
+  // Checks that output values from the calculator match resampling the
+  // entire signal at once with a PolyphaseResampler, exactly.
+  void CheckPolyphaseOutputValues(double output_sample_rate) {
+    auto status_or_resampler =
+        PolyphaseResampler::Create(input_sample_rate_, output_sample_rate,
+                                   num_input_channels_, {});
+    MP_ASSERT_OK(status_or_resampler);
+    auto resampler = std::move(status_or_resampler).value();
+    Matrix expected_resampled_data;
+    Matrix temp;
+    resampler->ProcessSamples(concatenated_input_samples_,
+                              &expected_resampled_data);
+    resampler->Flush(&temp);
+    expected_resampled_data.conservativeResize(
+        num_input_channels_, expected_resampled_data.cols() + temp.cols());
+    expected_resampled_data.rightCols(temp.cols()) = temp;
+
+    Matrix actual_resampled_data(num_input_channels_, 0);
+    for (const Packet& packet : output().packets) {
+      const Matrix& output_frame = packet.Get<Matrix>();
+      actual_resampled_data.conservativeResize(
+          num_input_channels_,
+          actual_resampled_data.cols() + output_frame.cols());
+      actual_resampled_data.rightCols(output_frame.cols()) = output_frame;
+    }
+    ASSERT_EQ(expected_resampled_data.cols(), actual_resampled_data.cols());
+    EXPECT_TRUE(expected_resampled_data == actual_resampled_data);
+  }
+
   void CheckOutputHeaders(double output_sample_rate) {
     const TimeSeriesHeader& output_header =
         output().header.Get<TimeSeriesHeader>();
@@ -230,6 +260,31 @@ TEST_F(RationalFactorResampleCalculatorTest, PassthroughIfSampleRateUnchanged) {
   CheckOutputUnchanged();
 }
 
+TEST_F(RationalFactorResampleCalculatorTest, PolyphaseUpsample) {
+  const double kUpsampleRate = input_sample_rate_ * 1.9;
+  options_.set_use_polyphase_resampler(true);
+  MP_ASSERT_OK(Run(kUpsampleRate));
+  CheckOutputLength(kUpsampleRate);
+  CheckOutputPacketTimestamps(kUpsampleRate);
+  CheckPolyphaseOutputValues(kUpsampleRate);
+  CheckOutputHeaders(kUpsampleRate);
+}
+
+TEST_F(RationalFactorResampleCalculatorTest, PolyphaseDownsample) {
+  const double kDownsampleRate = input_sample_rate_ / 1.9;
+  options_.set_use_polyphase_resampler(true);
+  MP_ASSERT_OK(Run(kDownsampleRate));
+  CheckOutputLength(kDownsampleRate);
+  CheckOutputPacketTimestamps(kDownsampleRate);
+  CheckPolyphaseOutputValues(kDownsampleRate);
+  CheckOutputHeaders(kDownsampleRate);
+}
+
+TEST_F(RationalFactorResampleCalculatorTest, PolyphaseFailsOnBadTargetRate) {
+  options_.set_use_polyphase_resampler(true);
+  ASSERT_FALSE(Run(-999.9).ok());
+}
+
 TEST_F(RationalFactorResampleCalculatorTest, FailsOnBadTargetRate) {
   ASSERT_FALSE(Run(-999.9).ok());  // Invalid output sample rate.
 }
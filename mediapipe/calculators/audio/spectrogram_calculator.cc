@@ -15,10 +15,13 @@
 // Defines SpectrogramCalculator.
 #include <math.h>
 
+#include <algorithm>
 #include <complex>
+#include <cstring>
 #include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "Eigen/Core"
 #include "absl/strings/string_view.h"
@@ -34,9 +37,32 @@
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/source_location.h"
 #include "mediapipe/framework/port/status_builder.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/util/real_fft.h"
 #include "mediapipe/util/time_series_util.h"
 
 namespace mediapipe {
+namespace {
+
+// Sets column "frame" of a batched spectrogram from the complex bins of the
+// frame. audio_dsp::Spectrogram returns squared magnitudes, and complex values
+// with the sign convention of its underlying real FFT, which is the conjugate
+// of the RealFft one, so both are reproduced here.
+void SetSpectrogramColumn(const std::complex<float>* bins, int frame,
+                          Matrix* spectrogram) {
+  for (int k = 0; k < spectrogram->rows(); ++k) {
+    (*spectrogram)(k, frame) = std::norm(bins[k]);
+  }
+}
+
+void SetSpectrogramColumn(const std::complex<float>* bins, int frame,
+                          Eigen::MatrixXcf* spectrogram) {
+  for (int k = 0; k < spectrogram->rows(); ++k) {
+    (*spectrogram)(k, frame) = std::conj(bins[k]);
+  }
+}
+
+}  // namespace
 
 // MediaPipe Calculator for computing the "spectrogram" (short-time Fourier
 // transform squared-magnitude, by default) of a multichannel input
@@ -64,6 +90,11 @@ namespace mediapipe {
 // rounded to the nearest integer number of samples.  Conseqently, all output
 // frames will be based on the same number of input samples, and each
 // analysis frame will advance from its predecessor by the same time step.
+//
+// If the fft_backend option is set, the frames of all channels of a packet are
+// windowed into one buffer and transformed by a single RealFft::ForwardBatch
+// call, instead of one audio_dsp::Spectrogram per channel. The output is the
+// same, up to floating point rounding.
 class SpectrogramCalculator : public CalculatorBase {
  public:
   static absl::Status GetContract(CalculatorContract* cc) {
@@ -155,6 +186,15 @@ class SpectrogramCalculator : public CalculatorBase {
       const OutputMatrixType postprocess_output_fn(const OutputMatrixType&),
       CalculatorContext* cc);
 
+  // Appends "input_stream" to the samples buffered for the batched FFT, and
+  // adds one spectrogram per channel to "spectrograms" if any frame was
+  // completed.
+  template <class OutputMatrixType>
+  void ComputeBatchedSpectrograms(
+      const Matrix& input_stream,
+      const OutputMatrixType postprocess_output_fn(const OutputMatrixType&),
+      std::vector<OutputMatrixType>* spectrograms);
+
   // Use the MediaPipe timestamp instead of the estimated one. Useful when the
   // data is intermittent.
   bool use_local_timestamp_;
@@ -181,6 +221,18 @@ class SpectrogramCalculator : public CalculatorBase {
   bool allow_multichannel_input_;
   // Vector of Spectrogram objects, one for each channel.
   std::vector<std::unique_ptr<audio_dsp::Spectrogram>> spectrogram_generators_;
+  // Batched FFT, used instead of spectrogram_generators_ if set.
+  std::unique_ptr<RealFft> fft_;
+  std::vector<float> window_;
+  // Samples from the start of the next frame on, one row per channel, in the
+  // first num_batch_samples_ columns.
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      batch_samples_;
+  int num_batch_samples_ = 0;
+  // Windowed and zero padded frames, and their transforms, ordered by channel
+  // then frame. Kept across packets to avoid reallocations.
+  std::vector<float> fft_input_;
+  std::vector<std::complex<float>> fft_output_;
   // Fixed scale factor applied to output values (regardless of type).
   double output_scale_;
 
@@ -247,16 +299,30 @@ absl::Status SpectrogramCalculator::Open(CalculatorContext* cc) {
       break;
   }
 
-  // Propagate settings down to the actual Spectrogram object.
   spectrogram_generators_.clear();
-  for (int i = 0; i < num_input_channels_; i++) {
-    spectrogram_generators_.push_back(
-        std::unique_ptr<audio_dsp::Spectrogram>(new audio_dsp::Spectrogram()));
-    spectrogram_generators_[i]->Initialize(window, frame_step_samples());
-  }
+  fft_.reset();
+  if (!spectrogram_options.fft_backend().empty()) {
+    // Like audio_dsp::Spectrogram, use the smallest power of two FFT length
+    // which covers the window.
+    int fft_length = 1;
+    while (fft_length < frame_duration_samples_) fft_length *= 2;
+    ASSIGN_OR_RETURN(fft_, RealFftRegistry::CreateByName(
+                               spectrogram_options.fft_backend(), fft_length));
+    window_.assign(window.begin(), window.end());
+    batch_samples_.resize(num_input_channels_, 0);
+    num_batch_samples_ = 0;
+    num_output_channels_ = fft_->num_bins();
+  } else {
+    // Propagate settings down to the actual Spectrogram object.
+    for (int i = 0; i < num_input_channels_; i++) {
+      spectrogram_generators_.push_back(std::unique_ptr<audio_dsp::Spectrogram>(
+          new audio_dsp::Spectrogram()));
+      spectrogram_generators_[i]->Initialize(window, frame_step_samples());
+    }
 
-  num_output_channels_ =
-      spectrogram_generators_[0]->output_frequency_channels();
+    num_output_channels_ =
+        spectrogram_generators_[0]->output_frequency_channels();
+  }
   std::unique_ptr<TimeSeriesHeader> output_header(
       new TimeSeriesHeader(input_header));
   // Store the actual sample rate of the input audio in the TimeSeriesHeader
@@ -320,45 +386,52 @@ absl::Status SpectrogramCalculator::ProcessVectorToOutput(
     CalculatorContext* cc) {
   std::unique_ptr<std::vector<OutputMatrixType>> spectrogram_matrices(
       new std::vector<OutputMatrixType>());
-  std::vector<std::vector<typename OutputMatrixType::Scalar>> output_vectors;
-
-  // Compute a spectrogram for each channel.
-  int num_output_time_frames;
-  for (int channel = 0; channel < input_stream.rows(); ++channel) {
-    output_vectors.clear();
-
-    // Copy one row (channel) of the input matrix into the std::vector.
-    std::vector<float> input_vector(input_stream.cols());
-    Eigen::Map<Matrix>(&input_vector[0], 1, input_vector.size()) =
-        input_stream.row(channel);
-
-    if (!spectrogram_generators_[channel]->ComputeSpectrogram(
-            input_vector, &output_vectors)) {
-      return absl::Status(absl::StatusCode::kInternal,
-                          "Spectrogram returned failure");
-    }
-    if (channel == 0) {
-      // Record the number of time frames we expect from each channel.
-      num_output_time_frames = output_vectors.size();
-    } else {
-      RET_CHECK_EQ(output_vectors.size(), num_output_time_frames)
-          << "Inconsistent spectrogram time frames for channel " << channel;
+  int num_output_time_frames = 0;
+  if (fft_) {
+    ComputeBatchedSpectrograms(input_stream, postprocess_output_fn,
+                               spectrogram_matrices.get());
+    if (!spectrogram_matrices->empty()) {
+      num_output_time_frames = spectrogram_matrices->front().cols();
     }
-    // Skip remaining processing if there are too few input samples to trigger
-    // any output frames.
-    if (!output_vectors.empty()) {
-      // Translate the returned values into a matrix of output frames.
-      OutputMatrixType output_frames(num_output_channels_,
-                                     output_vectors.size());
-      for (int frame = 0; frame < output_vectors.size(); ++frame) {
-        Eigen::Map<const OutputMatrixType> frame_map(
-            &output_vectors[frame][0], output_vectors[frame].size(), 1);
-        // The underlying dsp object returns squared magnitudes; here
-        // we optionally translate to linear magnitude or dB.
-        output_frames.col(frame) =
-            output_scale_ * postprocess_output_fn(frame_map);
+  } else {
+    std::vector<std::vector<typename OutputMatrixType::Scalar>> output_vectors;
+    // Compute a spectrogram for each channel.
+    for (int channel = 0; channel < input_stream.rows(); ++channel) {
+      output_vectors.clear();
+
+      // Copy one row (channel) of the input matrix into the std::vector.
+      std::vector<float> input_vector(input_stream.cols());
+      Eigen::Map<Matrix>(&input_vector[0], 1, input_vector.size()) =
+          input_stream.row(channel);
+
+      if (!spectrogram_generators_[channel]->ComputeSpectrogram(
+              input_vector, &output_vectors)) {
+        return absl::Status(absl::StatusCode::kInternal,
+                            "Spectrogram returned failure");
+      }
+      if (channel == 0) {
+        // Record the number of time frames we expect from each channel.
+        num_output_time_frames = output_vectors.size();
+      } else {
+        RET_CHECK_EQ(output_vectors.size(), num_output_time_frames)
+            << "Inconsistent spectrogram time frames for channel " << channel;
+      }
+      // Skip remaining processing if there are too few input samples to trigger
+      // any output frames.
+      if (!output_vectors.empty()) {
+        // Translate the returned values into a matrix of output frames.
+        OutputMatrixType output_frames(num_output_channels_,
+                                       output_vectors.size());
+        for (int frame = 0; frame < output_vectors.size(); ++frame) {
+          Eigen::Map<const OutputMatrixType> frame_map(
+              &output_vectors[frame][0], output_vectors[frame].size(), 1);
+          // The underlying dsp object returns squared magnitudes; here
+          // we optionally translate to linear magnitude or dB.
+          output_frames.col(frame) =
+              output_scale_ * postprocess_output_fn(frame_map);
+        }
+        spectrogram_matrices->push_back(output_frames);
       }
-      spectrogram_matrices->push_back(output_frames);
     }
   }
   // If the input is very short, there may not be enough accumulated,
@@ -376,8 +449,8 @@ absl::Status SpectrogramCalculator::ProcessVectorToOutput(
           new OutputMatrixType(spectrogram_matrices->at(0)),
           CurrentOutputTimestamp(cc));
     }
-    cumulative_completed_frames_ += output_vectors.size();
-    last_completed_frames_ = output_vectors.size();
+    cumulative_completed_frames_ += num_output_time_frames;
+    last_completed_frames_ = num_output_time_frames;
     if (!use_local_timestamp_) {
       // In non-local timestamp mode the timestamp of the next packet will be
       // equal to CumulativeOutputTimestamp(). Inform the framework about this
@@ -388,6 +461,69 @@ absl::Status SpectrogramCalculator::ProcessVectorToOutput(
   return absl::OkStatus();
 }
 
+template <class OutputMatrixType>
+void SpectrogramCalculator::ComputeBatchedSpectrograms(
+    const Matrix& input_stream,
+    const OutputMatrixType postprocess_output_fn(const OutputMatrixType&),
+    std::vector<OutputMatrixType>* spectrograms) {
+  const int num_samples = num_batch_samples_ + input_stream.cols();
+  if (batch_samples_.cols() < num_samples) {
+    batch_samples_.conservativeResize(
+        num_input_channels_, std::max<int>(num_samples,
+                                           2 * batch_samples_.cols()));
+  }
+  batch_samples_.middleCols(num_batch_samples_, input_stream.cols()) =
+      input_stream;
+  num_batch_samples_ = num_samples;
+  if (num_samples < frame_duration_samples_) return;
+
+  const int frame_step = frame_step_samples();
+  const int num_frames =
+      (num_samples - frame_duration_samples_) / frame_step + 1;
+  const int fft_length = fft_->fft_length();
+  const int num_bins = fft_->num_bins();
+  const int num_transforms = num_input_channels_ * num_frames;
+
+  // Window and zero pad every frame of every channel, then transform them all
+  // at once.
+  fft_input_.resize(num_transforms * fft_length);
+  for (int channel = 0; channel < num_input_channels_; ++channel) {
+    const float* samples = batch_samples_.row(channel).data();
+    for (int frame = 0; frame < num_frames; ++frame) {
+      const float* src = samples + frame * frame_step;
+      float* dst =
+          fft_input_.data() + (channel * num_frames + frame) * fft_length;
+      for (int i = 0; i < frame_duration_samples_; ++i) {
+        dst[i] = src[i] * window_[i];
+      }
+      std::fill(dst + frame_duration_samples_, dst + fft_length, 0.0f);
+    }
+  }
+  fft_output_.resize(num_transforms * num_bins);
+  fft_->ForwardBatch(fft_input_.data(), fft_length, num_transforms,
+                     fft_output_.data(), num_bins);
+
+  for (int channel = 0; channel < num_input_channels_; ++channel) {
+    OutputMatrixType output_frames(num_output_channels_, num_frames);
+    for (int frame = 0; frame < num_frames; ++frame) {
+      SetSpectrogramColumn(
+          fft_output_.data() + (channel * num_frames + frame) * num_bins,
+          frame, &output_frames);
+    }
+    spectrograms->push_back(output_scale_ *
+                            postprocess_output_fn(output_frames));
+  }
+
+  // Keep the samples from the start of the next frame on.
+  const int consumed_samples = num_frames * frame_step;
+  num_batch_samples_ -= consumed_samples;
+  for (int channel = 0; channel < num_input_channels_; ++channel) {
+    float* samples = batch_samples_.row(channel).data();
+    std::memmove(samples, samples + consumed_samples,
+                 num_batch_samples_ * sizeof(float));
+  }
+}
+
 absl::Status SpectrogramCalculator::ProcessVector(const Matrix& input_stream,
                                                   CalculatorContext* cc) {
   switch (output_type_) {
@@ -846,6 +846,78 @@ TEST_F(SpectrogramCalculatorTest,
   }
 }
 
+// Returns the largest absolute difference between two spectrograms, relative
+// to the largest absolute value in "expected".
+template <typename MatrixType>
+float RelativeMaxDifference(const MatrixType& expected,
+                            const MatrixType& actual) {
+  return (expected - actual).cwiseAbs().maxCoeff() /
+         expected.cwiseAbs().maxCoeff();
+}
+
+TEST_F(SpectrogramCalculatorTest, BatchedFftMatchesPerChannelSpectrogram) {
+  // Mixed packet sizes, so that frames straddle packets and some packets
+  // produce no frames; the padded final frame is batched too.
+  const std::vector<int> input_packet_sizes = {50, 130, 7, 300, 61};
+  options_.set_frame_duration_seconds(100.0 / input_sample_rate_);
+  options_.set_frame_overlap_seconds(60.0 / input_sample_rate_);
+  options_.set_pad_final_packet(true);
+  options_.set_allow_multichannel_input(true);
+  num_input_channels_ = 3;
+  const float tone_frequency_hz = 440.0;
+
+  for (const auto output_type :
+       {SpectrogramCalculatorOptions::SQUARED_MAGNITUDE,
+        SpectrogramCalculatorOptions::COMPLEX}) {
+    options_.set_output_type(output_type);
+    std::vector<Packet> outputs[2];
+    for (const bool batched : {false, true}) {
+      options_.set_fft_backend(batched ? "Radix2RealFft" : "");
+      InitializeGraph();
+      FillInputHeader();
+      SetupMultichannelInputPackets(input_packet_sizes, tone_frequency_hz);
+      MP_ASSERT_OK(Run());
+      CheckOutputHeadersAndTimestamps();
+      outputs[batched] = output().packets;
+    }
+
+    ASSERT_EQ(outputs[0].size(), outputs[1].size());
+    for (int i = 0; i < outputs[0].size(); ++i) {
+      EXPECT_EQ(outputs[0][i].Timestamp(), outputs[1][i].Timestamp());
+      for (int channel = 0; channel < num_input_channels_; ++channel) {
+        if (output_type == SpectrogramCalculatorOptions::COMPLEX) {
+          const auto& expected =
+              outputs[0][i].Get<std::vector<Eigen::MatrixXcf>>()[channel];
+          const auto& actual =
+              outputs[1][i].Get<std::vector<Eigen::MatrixXcf>>()[channel];
+          ASSERT_EQ(expected.rows(), actual.rows());
+          ASSERT_EQ(expected.cols(), actual.cols());
+          EXPECT_LT(RelativeMaxDifference(expected, actual), 1e-5);
+        } else {
+          const auto& expected =
+              outputs[0][i].Get<std::vector<Matrix>>()[channel];
+          const auto& actual =
+              outputs[1][i].Get<std::vector<Matrix>>()[channel];
+          ASSERT_EQ(expected.rows(), actual.rows());
+          ASSERT_EQ(expected.cols(), actual.cols());
+          EXPECT_LT(RelativeMaxDifference(expected, actual), 1e-5);
+        }
+      }
+    }
+  }
+}
+
+TEST_F(SpectrogramCalculatorTest, RejectsUnknownFftBackend) {
+  options_.set_frame_duration_seconds(100.0 / input_sample_rate_);
+  options_.set_fft_backend("NoSuchFft");
+  InitializeGraph();
+  FillInputHeader();
+  SetupConstantInputPackets({140});
+  EXPECT_FALSE(Run().ok());
+}
+
+// Runs the per-channel spectrogram, or the batched one with the built-in
+// backend if state.range(0) is 1.
 void BM_ProcessDC(benchmark::State& state) {
   CalculatorGraphConfig::Node node_config;
   node_config.set_calculator("SpectrogramCalculator");
@@ -858,6 +930,9 @@ void BM_ProcessDC(benchmark::State& state) {
   options->set_frame_duration_seconds(0.010);
   options->set_frame_overlap_seconds(0.0);
   options->set_pad_final_packet(false);
+  if (state.range(0)) {
+    options->set_fft_backend("Radix2RealFft");
+  }
   *node_config.mutable_options()->MutableExtension(
       SpectrogramCalculatorOptions::ext) = *options;
 
@@ -889,7 +964,7 @@ void BM_ProcessDC(benchmark::State& state) {
             << output_matrix(3, 0);
 }
 
-BENCHMARK(BM_ProcessDC);
+BENCHMARK(BM_ProcessDC)->Arg(0)->Arg(1);
 
 }  // anonymous namespace
 }  // namespace mediapipe
@@ -15,6 +15,8 @@
 // Defines TimeSeriesFramerCalculator.
 #include <math.h>
 
+#include <algorithm>
+#include <cstring>
 #include <deque>
 #include <memory>
 #include <string>
@@ -90,6 +92,11 @@ class TimeSeriesFramerCalculator : public CalculatorBase {
  private:
   // Adds input data to the internal buffer.
   void EnqueueInput(CalculatorContext* cc);
+  // Removes the oldest "num_samples" samples from the internal buffer.
+  void DropSamples(int num_samples);
+  // Returns the timestamp of the buffered sample at "index", counted from the
+  // oldest buffered sample.
+  Timestamp BufferedSampleTimestamp(int index) const;
   // Constructs and emits framed output packets.
   void FrameOutput(CalculatorContext* cc);
 
@@ -109,7 +116,7 @@ class TimeSeriesFramerCalculator : public CalculatorBase {
   // Returns the timestamp of a sample on a base, which is usually the time
   // stamp of a packet.
   Timestamp CurrentSampleTimestamp(const Timestamp& timestamp_base,
-                                   int64 number_of_samples) {
+                                   int64 number_of_samples) const {
     return timestamp_base + round(number_of_samples / sample_rate_ *
                                   Timestamp::kTimestampUnitsPerSecond);
   }
@@ -144,9 +151,19 @@ class TimeSeriesFramerCalculator : public CalculatorBase {
   Timestamp current_timestamp_;
   int num_channels_;
 
-  // Each entry in this deque consists of a single sample, i.e. a
-  // single column vector, and its timestamp.
-  std::deque<std::pair<Matrix, Timestamp>> sample_buffer_;
+  // Buffered samples, one per column, are stored contiguously in columns
+  // [sample_buffer_start_, sample_buffer_start_ + num_buffered_samples_) so
+  // that each output frame is a single block copy. Samples are only moved
+  // when the end of the buffer is reached, and the buffer grows so that this
+  // happens at most once every num_buffered_samples_ samples.
+  Matrix sample_buffer_;
+  int sample_buffer_start_;
+  int num_buffered_samples_;
+  // Index of the oldest buffered sample among all input samples.
+  int64 buffered_samples_offset_;
+  // Index of the first sample and timestamp of each input packet which still
+  // has buffered samples. Sample timestamps are computed from these.
+  std::deque<std::pair<int64, Timestamp>> input_packet_starts_;
 
   bool use_window_;
   Matrix window_;
@@ -157,42 +174,78 @@ REGISTER_CALCULATOR(TimeSeriesFramerCalculator);
 
 void TimeSeriesFramerCalculator::EnqueueInput(CalculatorContext* cc) {
   const Matrix& input_frame = cc->Inputs().Index(0).Get<Matrix>();
+  const int num_input_samples = input_frame.cols();
+  if (num_input_samples == 0) return;
+
+  const int required_samples = num_buffered_samples_ + num_input_samples;
+  if (sample_buffer_start_ + required_samples > sample_buffer_.cols()) {
+    // Move the buffered samples to the front, and grow the buffer if less
+    // than half of it would be free afterwards.
+    if (sample_buffer_start_ > 0 && num_buffered_samples_ > 0) {
+      std::memmove(sample_buffer_.data(),
+                   sample_buffer_.col(sample_buffer_start_).data(),
+                   sizeof(float) * num_channels_ * num_buffered_samples_);
+    }
+    sample_buffer_start_ = 0;
+    if (2 * required_samples > sample_buffer_.cols()) {
+      sample_buffer_.conservativeResize(
+          num_channels_,
+          std::max(2 * required_samples, 2 * frame_duration_samples_));
+    }
+  }
+  sample_buffer_.middleCols(sample_buffer_start_ + num_buffered_samples_,
+                            num_input_samples) = input_frame;
+
+  input_packet_starts_.emplace_back(
+      buffered_samples_offset_ + num_buffered_samples_, cc->InputTimestamp());
+  num_buffered_samples_ += num_input_samples;
+}
+
+void TimeSeriesFramerCalculator::DropSamples(int num_samples) {
+  sample_buffer_start_ += num_samples;
+  num_buffered_samples_ -= num_samples;
+  buffered_samples_offset_ += num_samples;
+  // Forget input packets whose samples have all been dropped.
+  while (input_packet_starts_.size() > 1 &&
+         input_packet_starts_[1].first <= buffered_samples_offset_) {
+    input_packet_starts_.pop_front();
+  }
+}
 
-  for (int i = 0; i < input_frame.cols(); ++i) {
-    sample_buffer_.emplace_back(std::make_pair(
-        input_frame.col(i), CurrentSampleTimestamp(cc->InputTimestamp(), i)));
+Timestamp TimeSeriesFramerCalculator::BufferedSampleTimestamp(
+    int index) const {
+  const int64 sample = buffered_samples_offset_ + index;
+  // Input packets are few, and the sample is usually in one of the first.
+  auto packet = input_packet_starts_.begin();
+  while (std::next(packet) != input_packet_starts_.end() &&
+         std::next(packet)->first <= sample) {
+    ++packet;
   }
+  return CurrentSampleTimestamp(packet->second, sample - packet->first);
 }
 
 void TimeSeriesFramerCalculator::FrameOutput(CalculatorContext* cc) {
-  while (sample_buffer_.size() >=
+  while (num_buffered_samples_ >=
          frame_duration_samples_ + samples_still_to_drop_) {
-    while (samples_still_to_drop_ > 0) {
-      sample_buffer_.pop_front();
-      --samples_still_to_drop_;
-    }
+    DropSamples(samples_still_to_drop_);
+    samples_still_to_drop_ = 0;
     const int frame_step_samples = next_frame_step_samples();
+
+    // Copy, and window, the frame in a single pass over the buffer.
+    auto frame_samples = sample_buffer_.middleCols(sample_buffer_start_,
+                                                   frame_duration_samples_);
     std::unique_ptr<Matrix> output_frame(
         new Matrix(num_channels_, frame_duration_samples_));
-    for (int i = 0; i < std::min(frame_step_samples, frame_duration_samples_);
-         ++i) {
-      output_frame->col(i) = sample_buffer_.front().first;
-      current_timestamp_ = sample_buffer_.front().second;
-      sample_buffer_.pop_front();
-    }
-    const int frame_overlap_samples =
-        frame_duration_samples_ - frame_step_samples;
-    if (frame_overlap_samples > 0) {
-      for (int i = 0; i < frame_overlap_samples; ++i) {
-        output_frame->col(i + frame_step_samples) = sample_buffer_[i].first;
-        current_timestamp_ = sample_buffer_[i].second;
-      }
+    if (use_window_) {
+      output_frame->array() = frame_samples.array() * window_.array();
     } else {
-      samples_still_to_drop_ = -frame_overlap_samples;
+      *output_frame = frame_samples;
     }
+    current_timestamp_ = BufferedSampleTimestamp(frame_duration_samples_ - 1);
 
-    if (use_window_) {
-      *output_frame = (output_frame->array() * window_.array()).matrix();
+    DropSamples(std::min(frame_step_samples, frame_duration_samples_));
+    if (frame_step_samples > frame_duration_samples_) {
+      samples_still_to_drop_ = frame_step_samples - frame_duration_samples_;
     }
 
     cc->Outputs().Index(0).Add(output_frame.release(),
@@ -221,17 +274,13 @@ absl::Status TimeSeriesFramerCalculator::Process(CalculatorContext* cc) {
 }
 
 absl::Status TimeSeriesFramerCalculator::Close(CalculatorContext* cc) {
-  while (samples_still_to_drop_ > 0 && !sample_buffer_.empty()) {
-    sample_buffer_.pop_front();
-    --samples_still_to_drop_;
-  }
-  if (!sample_buffer_.empty() && pad_final_packet_) {
+  DropSamples(std::min(samples_still_to_drop_, num_buffered_samples_));
+  if (num_buffered_samples_ > 0 && pad_final_packet_) {
     std::unique_ptr<Matrix> output_frame(new Matrix);
     output_frame->setZero(num_channels_, frame_duration_samples_);
-    for (int i = 0; i < sample_buffer_.size(); ++i) {
-      output_frame->col(i) = sample_buffer_[i].first;
-      current_timestamp_ = sample_buffer_[i].second;
-    }
+    output_frame->leftCols(num_buffered_samples_) =
+        sample_buffer_.middleCols(sample_buffer_start_, num_buffered_samples_);
+    current_timestamp_ = BufferedSampleTimestamp(num_buffered_samples_ - 1);
 
     cc->Outputs().Index(0).Add(output_frame.release(),
                                CurrentOutputTimestamp());
@@ -291,6 +340,10 @@ absl::Status TimeSeriesFramerCalculator::Open(CalculatorContext* cc) {
   cumulative_completed_samples_ = 0;
   cumulative_output_frames_ = 0;
   samples_still_to_drop_ = 0;
+  sample_buffer_.resize(num_channels_, 0);
+  sample_buffer_start_ = 0;
+  num_buffered_samples_ = 0;
+  buffered_samples_offset_ = 0;
   initial_input_timestamp_ = Timestamp::Unstarted();
   current_timestamp_ = Timestamp::Unstarted();
 
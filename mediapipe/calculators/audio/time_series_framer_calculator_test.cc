@@ -25,6 +25,7 @@
 #include "mediapipe/framework/calculator_runner.h"
 #include "mediapipe/framework/formats/matrix.h"
 #include "mediapipe/framework/formats/time_series_header.pb.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
@@ -481,5 +482,39 @@ TEST_F(TimeSeriesFramerCalculatorTimestampingTest, UseCumulativeTimeStamp) {
   CheckOutputTimestamps();
 }
 
+// Frames one second of stereo audio, in 10 ms packets, into 25 ms Hann
+// windowed frames with a 10 ms step.
+void BM_FrameAudio(benchmark::State& state) {
+  const double sample_rate = state.range(0);
+  const int num_channels = 2;
+  CalculatorGraphConfig::Node node_config;
+  node_config.set_calculator("TimeSeriesFramerCalculator");
+  node_config.add_input_stream("input_audio");
+  node_config.add_output_stream("output_frames");
+  TimeSeriesFramerCalculatorOptions* options =
+      node_config.mutable_options()->MutableExtension(
+          TimeSeriesFramerCalculatorOptions::ext);
+  options->set_frame_duration_seconds(0.025);
+  options->set_frame_overlap_seconds(0.015);
+  options->set_window_function(TimeSeriesFramerCalculatorOptions::HANN);
+
+  CalculatorRunner runner(node_config);
+  TimeSeriesHeader* header = new TimeSeriesHeader();
+  header->set_sample_rate(sample_rate);
+  header->set_num_channels(num_channels);
+  runner.MutableInputs()->Index(0).header = Adopt(header);
+  const int packet_size_samples = sample_rate / 100;
+  for (int i = 0; i < 100; ++i) {
+    runner.MutableInputs()->Index(0).packets.push_back(
+        Adopt(new Matrix(Matrix::Random(num_channels, packet_size_samples)))
+            .At(Timestamp(i * 10000)));
+  }
+
+  for (auto _ : state) {
+    ASSERT_TRUE(runner.Run().ok());
+  }
+}
+BENCHMARK(BM_FrameAudio)->Arg(16000)->Arg(48000)->UseRealTime();
+
 }  // namespace
 }  // namespace mediapipe
@@ -14,6 +14,7 @@
 
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/logging.h"
@@ -83,6 +84,7 @@ class ColorConvertCalculator : public CalculatorBase {
 
   absl::Status Open(CalculatorContext* cc) override {
     cc->SetOffset(TimestampDiff(0));
+    frame_pool_ = &cc->Service(kImageFrameMultiPoolService).GetObject();
     return absl::OkStatus();
   }
 
@@ -96,6 +98,9 @@ class ColorConvertCalculator : public CalculatorBase {
                                 ImageFormat::Format output_format,
                                 int open_cv_convert_code,
                                 CalculatorContext* cc);
+
+  // Provides the output frames.
+  ImageFrameMultiPool* frame_pool_ = nullptr;
 };
 
 REGISTER_CALCULATOR(ColorConvertCalculator);
@@ -138,6 +143,8 @@ absl::Status ColorConvertCalculator::GetContract(CalculatorContract* cc) {
     cc->Outputs().Tag(kBgraOutTag).Set<ImageFrame>();
   }
 
+  cc->UseService(kImageFrameMultiPoolService);
+
   return absl::OkStatus();
 }
 
@@ -147,8 +154,8 @@ absl::Status ColorConvertCalculator::ConvertAndOutput(
     CalculatorContext* cc) {
   const cv::Mat& input_mat =
       formats::MatView(&cc->Inputs().Tag(input_tag).Get<ImageFrame>());
-  std::unique_ptr<ImageFrame> output_frame(
-      new ImageFrame(output_format, input_mat.cols, input_mat.rows));
+  std::unique_ptr<ImageFrame> output_frame =
+      frame_pool_->GetFrame(output_format, input_mat.cols, input_mat.rows);
   cv::Mat output_mat = formats::MatView(output_frame.get());
   cv::cvtColor(input_mat, output_mat, open_cv_convert_code);
 
@@ -19,10 +19,12 @@
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/formats/yuv_image.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/yuv_image_sampler.h"
 
 #if !MEDIAPIPE_DISABLE_GPU
 #include "mediapipe/gpu/gl_simple_shaders.h"
@@ -47,6 +49,7 @@ constexpr char kNormRectTag[] = "NORM_RECT";
 constexpr char kHeightTag[] = "HEIGHT";
 constexpr char kImageTag[] = "IMAGE";
 constexpr char kImageGpuTag[] = "IMAGE_GPU";
+constexpr char kImageYuvTag[] = "IMAGE_YUV";
 constexpr char kWidthTag[] = "WIDTH";
 
 }  // namespace
@@ -54,7 +57,10 @@ constexpr char kWidthTag[] = "WIDTH";
 REGISTER_CALCULATOR(ImageCroppingCalculator);
 
 absl::Status ImageCroppingCalculator::GetContract(CalculatorContract* cc) {
-  RET_CHECK(cc->Inputs().HasTag(kImageTag) ^ cc->Inputs().HasTag(kImageGpuTag));
+  RET_CHECK_EQ(cc->Inputs().HasTag(kImageTag) +
+                   cc->Inputs().HasTag(kImageGpuTag) +
+                   cc->Inputs().HasTag(kImageYuvTag),
+               1);
   RET_CHECK(cc->Outputs().HasTag(kImageTag) ^
             cc->Outputs().HasTag(kImageGpuTag));
 
@@ -64,6 +70,13 @@ absl::Status ImageCroppingCalculator::GetContract(CalculatorContract* cc) {
     RET_CHECK(cc->Outputs().HasTag(kImageTag));
     cc->Inputs().Tag(kImageTag).Set<ImageFrame>();
     cc->Outputs().Tag(kImageTag).Set<ImageFrame>();
+    cc->UseService(kImageFrameMultiPoolService);
+  }
+  if (cc->Inputs().HasTag(kImageYuvTag)) {
+    RET_CHECK(cc->Outputs().HasTag(kImageTag));
+    cc->Inputs().Tag(kImageYuvTag).Set<YUVImage>();
+    cc->Outputs().Tag(kImageTag).Set<ImageFrame>();
+    cc->UseService(kImageFrameMultiPoolService);
   }
 #if !MEDIAPIPE_DISABLE_GPU
   if (cc->Inputs().HasTag(kImageGpuTag)) {
@@ -123,6 +136,8 @@ absl::Status ImageCroppingCalculator::Open(CalculatorContext* cc) {
 
   if (cc->Inputs().HasTag(kImageGpuTag)) {
     use_gpu_ = true;
+  } else {
+    frame_pool_ = &cc->Service(kImageFrameMultiPoolService).GetObject();
   }
 
   options_ = cc->Options<mediapipe::ImageCroppingCalculatorOptions>();
@@ -170,6 +185,8 @@ absl::Status ImageCroppingCalculator::Process(CalculatorContext* cc) {
       return absl::OkStatus();
     }));
 #endif  // !MEDIAPIPE_DISABLE_GPU
+  } else if (cc->Inputs().HasTag(kImageYuvTag)) {
+    MP_RETURN_IF_ERROR(RenderYuvCpu(cc));
   } else {
     MP_RETURN_IF_ERROR(RenderCpu(cc));
   }
@@ -254,16 +271,80 @@ absl::Status ImageCroppingCalculator::RenderCpu(CalculatorContext* cc) {
   cv::Mat dst_points = cv::Mat(4, 2, CV_32F, dst_corners);
   cv::Mat projection_matrix =
       cv::getPerspectiveTransform(src_points, dst_points);
-  cv::Mat cropped_image;
-  cv::warpPerspective(input_mat, cropped_image, projection_matrix,
-                      cv::Size(output_width, output_height),
+  // Warp directly into the output frame.
+  const cv::Size output_size(output_width, output_height);
+  std::unique_ptr<ImageFrame> output_frame = frame_pool_->GetFrame(
+      input_img.Format(), output_size.width, output_size.height);
+  cv::Mat output_mat = formats::MatView(output_frame.get());
+  cv::warpPerspective(input_mat, output_mat, projection_matrix, output_size,
                       /* flags = */ 0,
                       /* borderMode = */ border_mode);
+  cc->Outputs().Tag(kImageTag).Add(output_frame.release(),
+                                   cc->InputTimestamp());
+  return absl::OkStatus();
+}
 
-  std::unique_ptr<ImageFrame> output_frame(new ImageFrame(
-      input_img.Format(), cropped_image.cols, cropped_image.rows));
-  cv::Mat output_mat = formats::MatView(output_frame.get());
-  cropped_image.copyTo(output_mat);
+absl::Status ImageCroppingCalculator::RenderYuvCpu(CalculatorContext* cc) {
+  if (cc->Inputs().Tag(kImageYuvTag).IsEmpty()) {
+    return absl::OkStatus();
+  }
+  const auto& input_img = cc->Inputs().Tag(kImageYuvTag).Get<YUVImage>();
+  RET_CHECK(YUVImageSampler::IsSupported(input_img))
+      << "Unsupported YUV image format: " << input_img.fourcc();
+  const YUVImageSampler sampler(input_img);
+
+  RectSpec specs = GetCropSpecs(cc, input_img.width(), input_img.height());
+  const cv::RotatedRect min_rect(cv::Point2f(specs.center_x, specs.center_y),
+                                 cv::Size2f(specs.width, specs.height),
+                                 specs.rotation * 180.f / M_PI);
+  // Bottom left, top left, top right and bottom right corners.
+  cv::Point2f corners[4];
+  min_rect.points(corners);
+
+  float scale = std::min({1.0f, output_max_width_ / min_rect.size.width,
+                          output_max_height_ / min_rect.size.height});
+  const int output_width = min_rect.size.width * scale;
+  const int output_height = min_rect.size.height * scale;
+  std::unique_ptr<ImageFrame> output_frame =
+      frame_pool_->GetFrame(ImageFormat::SRGB, output_width, output_height);
+
+  // Maps the output corners to the rectangle corners as the perspective
+  // transform of RenderCpu does, and samples the nearest pixel, converting
+  // only the pixels that end up in the output.
+  const cv::Point2f x_step =
+      output_width > 1 ? (corners[2] - corners[1]) / (output_width - 1)
+                       : cv::Point2f();
+  const cv::Point2f y_step =
+      output_height > 1 ? (corners[0] - corners[1]) / (output_height - 1)
+                        : cv::Point2f();
+  const bool replicate_border =
+      options_.border_mode() ==
+      mediapipe::ImageCroppingCalculatorOptions::BORDER_REPLICATE;
+  const int width = sampler.width();
+  const int height = sampler.height();
+  for (int y = 0; y < output_height; ++y) {
+    uint8* row =
+        output_frame->MutablePixelData() + y * output_frame->WidthStep();
+    const cv::Point2f row_start = corners[1] + y_step * y;
+    for (int x = 0; x < output_width; ++x, row += 3) {
+      int src_x = cvRound(row_start.x + x_step.x * x);
+      int src_y = cvRound(row_start.y + x_step.y * x);
+      if (replicate_border) {
+        src_x = std::min(std::max(src_x, 0), width - 1);
+        src_y = std::min(std::max(src_y, 0), height - 1);
+      } else if (src_x < 0 || src_y < 0 || src_x >= width || src_y >= height) {
+        row[0] = row[1] = row[2] = 0;
+        continue;
+      }
+      int luma, u, v;
+      sampler.GetYuv(src_x, src_y, &luma, &u, &v);
+      float rgb[3];
+      sampler.YuvToRgb(luma, u, v, rgb);
+      for (int c = 0; c < 3; ++c) {
+        row[c] = static_cast<uint8>(rgb[c] + 0.5f);
+      }
+    }
+  }
   cc->Outputs().Tag(kImageTag).Add(output_frame.release(),
                                    cc->InputTimestamp());
   return absl::OkStatus();
@@ -5,6 +5,7 @@
 
 #include "mediapipe/calculators/image/image_cropping_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
 
 #if !MEDIAPIPE_DISABLE_GPU
 #include "mediapipe/gpu/gl_calculator_helper.h"
@@ -16,9 +17,12 @@
 // be in radian, see rect.proto for detail.
 //
 // Input:
-//   One of the following two tags:
+//   One of the following three tags:
 //   IMAGE - ImageFrame representing the input image.
 //   IMAGE_GPU - GpuBuffer representing the input image.
+//   IMAGE_YUV - YUVImage (I420, NV12 or NV21) representing the input image.
+//               Only the cropped pixels are converted to RGB, and the output
+//               is an SRGB ImageFrame on the IMAGE tag.
 //   One of the following two tags (optional if WIDTH/HEIGHT is specified):
 //   RECT - A Rect proto specifying the width/height and location of the
 //          cropping rectangle.
@@ -69,6 +73,7 @@ class ImageCroppingCalculator : public CalculatorBase {
   absl::Status ValidateBorderModeForCPU(CalculatorContext* cc);
   absl::Status ValidateBorderModeForGPU(CalculatorContext* cc);
   absl::Status RenderCpu(CalculatorContext* cc);
+  absl::Status RenderYuvCpu(CalculatorContext* cc);
   absl::Status RenderGpu(CalculatorContext* cc);
   absl::Status InitGpu(CalculatorContext* cc);
   void GlRender();
@@ -79,6 +84,8 @@ class ImageCroppingCalculator : public CalculatorBase {
   mediapipe::ImageCroppingCalculatorOptions options_;
 
   bool use_gpu_ = false;
+  // Provides the CPU output frames.
+  ImageFrameMultiPool* frame_pool_ = nullptr;
   // Output texture corners (4) after transoformation in normalized coordinates.
   float transformed_points_[8];
   float output_max_width_ = FLT_MAX;
@@ -16,15 +16,22 @@
 
 #include <cmath>
 #include <memory>
+#include <string>
 
+#include "absl/strings/substitute.h"
 #include "mediapipe/calculators/image/image_cropping_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/rect.pb.h"
+#include "mediapipe/framework/formats/yuv_image.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status_matchers.h"
 #include "mediapipe/framework/tool/tag_map.h"
 #include "mediapipe/framework/tool/tag_map_helper.h"
+#include "mediapipe/util/yuv_image_sampler.h"
 
 namespace mediapipe {
 
@@ -212,5 +219,71 @@ TEST(ImageCroppingCalculatorTest, RedundantSpecWithInputStream) {
             expectRect);
 }  // TEST
 
+// Runs a crop of "input" on the given input tag and returns the output frame.
+absl::StatusOr<Packet> RunCrop(const std::string& input_tag,
+                               const Packet& input) {
+  CalculatorRunner runner(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(
+      absl::Substitute(R"pb(
+                         calculator: "ImageCroppingCalculator"
+                         input_stream: "$0:input_frames"
+                         output_stream: "IMAGE:cropped_output_frames"
+                         options: {
+                           [mediapipe.ImageCroppingCalculatorOptions.ext] {
+                             width: 30
+                             height: 20
+                             norm_center_x: 0.4
+                             norm_center_y: 0.6
+                             border_mode: BORDER_REPLICATE
+                           }
+                         }
+                       )pb",
+                       input_tag)));
+  runner.MutableInputs()->Tag(input_tag).packets.push_back(
+      input.At(Timestamp(0)));
+  MP_RETURN_IF_ERROR(runner.Run());
+  RET_CHECK_EQ(runner.Outputs().Tag("IMAGE").packets.size(), 1);
+  return runner.Outputs().Tag("IMAGE").packets[0];
+}
+
+// Test that cropping a YUV image matches cropping the converted RGB image.
+TEST(ImageCroppingCalculatorTest, YuvInputMatchesConvertedRgbInput) {
+  const int width = 64;
+  const int height = 48;
+  auto y = absl::make_unique<uint8[]>(width * height);
+  auto uv = absl::make_unique<uint8[]>(width * height / 2);
+  for (int i = 0; i < width * height; ++i) {
+    y[i] = (i * 37) % 256;
+  }
+  for (int i = 0; i < width * height / 2; ++i) {
+    uv[i] = (i * 53 + 11) % 256;
+  }
+  const Packet yuv_packet = Adopt(new YUVImage(
+      libyuv::FOURCC_NV12, std::move(y), width, std::move(uv), width, nullptr,
+      0, width, height));
+  auto rgb_image = absl::make_unique<ImageFrame>(ImageFormat::SRGB, width,
+                                                 height);
+  MP_ASSERT_OK(YUVImageSampler(yuv_packet.Get<YUVImage>())
+                   .ConvertRegion(0, 0, rgb_image.get()));
+
+  auto yuv_output = RunCrop("IMAGE_YUV", yuv_packet);
+  MP_ASSERT_OK(yuv_output);
+  auto rgb_output = RunCrop("IMAGE", Adopt(rgb_image.release()));
+  MP_ASSERT_OK(rgb_output);
+  const auto& yuv_frame = yuv_output->Get<ImageFrame>();
+  const auto& rgb_frame = rgb_output->Get<ImageFrame>();
+  ASSERT_EQ(yuv_frame.Format(), ImageFormat::SRGB);
+  ASSERT_EQ(yuv_frame.Width(), 30);
+  ASSERT_EQ(yuv_frame.Height(), 20);
+  ASSERT_EQ(rgb_frame.Width(), 30);
+  ASSERT_EQ(rgb_frame.Height(), 20);
+  for (int row = 0; row < 20; ++row) {
+    const uint8* yuv_row = yuv_frame.PixelData() + row * yuv_frame.WidthStep();
+    const uint8* rgb_row = rgb_frame.PixelData() + row * rgb_frame.WidthStep();
+    for (int i = 0; i < 30 * 3; ++i) {
+      EXPECT_NEAR(yuv_row[i], rgb_row[i], 1) << row << ", " << i;
+    }
+  }
+}
+
 }  // namespace
 }  // namespace mediapipe
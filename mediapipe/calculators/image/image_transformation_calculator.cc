@@ -13,8 +13,10 @@
 // limitations under the License.
 
 #include "mediapipe/calculators/image/image_transformation_calculator.pb.h"
+#include "mediapipe/calculators/image/image_transformation_utils.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
@@ -155,6 +157,11 @@ mediapipe::ScaleMode_Mode ParseScaleMode(
 // Note: To enable horizontal or vertical flipping, specify them in the
 // calculator options. Flipping is applied after rotation.
 //
+// Note: On CPU, images with 8 bits per channel are transformed in a single
+// pass by FusedImageTransformer, unless an image already scaled to the
+// output dimensions needs to be rotated about its center. Other formats and
+// those rotations go through OpenCV.
+//
 // Note: Input defines output, so only matchig types supported:
 // IMAGE -> IMAGE  or  IMAGE_GPU -> IMAGE_GPU
 //
@@ -171,6 +178,8 @@ class ImageTransformationCalculator : public CalculatorBase {
 
  private:
   absl::Status RenderCpu(CalculatorContext* cc);
+  // Transforms the images FusedImageTransformer does not, see RenderCpu().
+  absl::Status RenderCpuWithOpenCv(const ImageFrame& input, ImageFrame* output);
   absl::Status RenderGpu(CalculatorContext* cc);
   absl::Status GlSetup();
 
@@ -189,6 +198,10 @@ class ImageTransformationCalculator : public CalculatorBase {
   bool flip_vertically_ = false;
 
   bool use_gpu_ = false;
+  // Provides the CPU output frames.
+  ImageFrameMultiPool* frame_pool_ = nullptr;
+  // Transforms the 8-bit CPU frames in a single pass.
+  FusedImageTransformer transformer_;
 #if !MEDIAPIPE_DISABLE_GPU
   GlCalculatorHelper gpu_helper_;
   std::unique_ptr<QuadRenderer> rgb_renderer_;
@@ -211,6 +224,7 @@ absl::Status ImageTransformationCalculator::GetContract(
     RET_CHECK(cc->Outputs().HasTag(kImageFrameTag));
     cc->Inputs().Tag(kImageFrameTag).Set<ImageFrame>();
     cc->Outputs().Tag(kImageFrameTag).Set<ImageFrame>();
+    cc->UseService(kImageFrameMultiPoolService);
   }
 #if !MEDIAPIPE_DISABLE_GPU
   if (cc->Inputs().HasTag(kGpuBufferTag)) {
@@ -266,6 +280,8 @@ absl::Status ImageTransformationCalculator::Open(CalculatorContext* cc) {
 
   if (cc->Inputs().HasTag(kGpuBufferTag)) {
     use_gpu_ = true;
+  } else {
+    frame_pool_ = &cc->Service(kImageFrameMultiPoolService).GetObject();
   }
 
   if (cc->InputSidePackets().HasTag("OUTPUT_DIMENSIONS")) {
@@ -374,19 +390,72 @@ absl::Status ImageTransformationCalculator::Close(CalculatorContext* cc) {
 }
 
 absl::Status ImageTransformationCalculator::RenderCpu(CalculatorContext* cc) {
-  cv::Mat input_mat;
-  mediapipe::ImageFormat::Format format;
-
   const auto& input = cc->Inputs().Tag(kImageFrameTag).Get<ImageFrame>();
-  input_mat = formats::MatView(&input);
-  format = input.Format();
-
-  const int input_width = input_mat.cols;
-  const int input_height = input_mat.rows;
+  const int input_width = input.Width();
+  const int input_height = input.Height();
   int output_width;
   int output_height;
   ComputeOutputDimensions(input_width, input_height, &output_width,
                           &output_height);
+  // The image is scaled before it is rotated. FILL_AND_CROP scales it to fit
+  // the output dimensions, which are replaced by the scaled size.
+  int scaled_width = input_width;
+  int scaled_height = input_height;
+  if (output_width_ > 0 && output_height_ > 0) {
+    if (scale_mode_ == mediapipe::ScaleMode_Mode_FILL_AND_CROP) {
+      const float scale =
+          std::min(static_cast<float>(output_width_) / input_width,
+                   static_cast<float>(output_height_) / input_height);
+      output_width = std::round(input_width * scale);
+      output_height = std::round(input_height * scale);
+    }
+    scaled_width = output_width;
+    scaled_height = output_height;
+  }
+
+  if (cc->Outputs().HasTag("LETTERBOX_PADDING")) {
+    auto padding = absl::make_unique<std::array<float, 4>>();
+    ComputeOutputLetterboxPadding(input_width, input_height, output_width,
+                                  output_height, padding.get());
+    cc->Outputs()
+        .Tag("LETTERBOX_PADDING")
+        .Add(padding.release(), cc->InputTimestamp());
+  }
+
+  std::unique_ptr<ImageFrame> output_frame =
+      frame_pool_->GetFrame(input.Format(), output_width, output_height);
+  // An image already at the output dimensions is rotated about its center,
+  // see RenderCpuWithOpenCv(). Otherwise scaling and rotation are exclusive,
+  // and FusedImageTransformer gives the same result.
+  const int rotation = RotationModeToDegrees(rotation_);
+  const bool rotate_about_center = rotation != 0 &&
+                                   scaled_width == output_width &&
+                                   scaled_height == output_height;
+  if (FusedImageTransformer::SupportsFormat(input.Format()) &&
+      !rotate_about_center) {
+    FusedImageTransformer::Options options;
+    options.rotation_degrees = rotation;
+    options.flip_horizontally = flip_horizontally_;
+    options.flip_vertically = flip_vertically_;
+    options.scale_mode = scale_mode_;
+    options.constant_padding = options_.constant_padding();
+    MP_RETURN_IF_ERROR(
+        transformer_.Transform(options, input, output_frame.get()));
+  } else {
+    MP_RETURN_IF_ERROR(RenderCpuWithOpenCv(input, output_frame.get()));
+  }
+  cc->Outputs()
+      .Tag(kImageFrameTag)
+      .Add(output_frame.release(), cc->InputTimestamp());
+
+  return absl::OkStatus();
+}
+
+absl::Status ImageTransformationCalculator::RenderCpuWithOpenCv(
+    const ImageFrame& input, ImageFrame* output) {
+  cv::Mat input_mat = formats::MatView(&input);
+  const int input_width = input_mat.cols;
+  const int input_height = input_mat.rows;
 
   if (output_width_ > 0 && output_height_ > 0) {
     cv::Mat scaled_mat;
@@ -419,24 +488,13 @@ absl::Status ImageTransformationCalculator::RenderCpu(CalculatorContext* cc) {
       } else {
         cv::resize(input_mat, scaled_mat, cv::Size(target_width, target_height),
                    0, 0, scale_flag);
-        output_width = target_width;
-        output_height = target_height;
       }
     }
     input_mat = scaled_mat;
   }
 
-  if (cc->Outputs().HasTag("LETTERBOX_PADDING")) {
-    auto padding = absl::make_unique<std::array<float, 4>>();
-    ComputeOutputLetterboxPadding(input_width, input_height, output_width,
-                                  output_height, padding.get());
-    cc->Outputs()
-        .Tag("LETTERBOX_PADDING")
-        .Add(padding.release(), cc->InputTimestamp());
-  }
-
   cv::Mat rotated_mat;
-  cv::Size rotated_size(output_width, output_height);
+  cv::Size rotated_size(output->Width(), output->Height());
   if (input_mat.size() == rotated_size) {
     const int angle = RotationModeToDegrees(rotation_);
     cv::Point2f src_center(input_mat.cols / 2.0, input_mat.rows / 2.0);
@@ -469,14 +527,8 @@ absl::Status ImageTransformationCalculator::RenderCpu(CalculatorContext* cc) {
     flipped_mat = rotated_mat;
   }
 
-  std::unique_ptr<ImageFrame> output_frame(
-      new ImageFrame(format, output_width, output_height));
-  cv::Mat output_mat = formats::MatView(output_frame.get());
+  cv::Mat output_mat = formats::MatView(output);
   flipped_mat.copyTo(output_mat);
-  cc->Outputs()
-      .Tag(kImageFrameTag)
-      .Add(output_frame.release(), cc->InputTimestamp());
-
   return absl::OkStatus();
 }
 
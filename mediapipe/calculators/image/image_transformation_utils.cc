@@ -0,0 +1,451 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/image/image_transformation_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDIAPIPE_IMAGE_TRANSFORMATION_NEON 1
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+using AxisTaps = FusedImageTransformer::AxisTaps;
+
+// Number of output rows computed together by the rotated, scaled transforms.
+constexpr int kBandRows = 16;
+// Side of the square tiles copied by pure rotations and flips. The input
+// cache lines of a tile, one per input row, fit in the L1 cache.
+constexpr int kTileSize = 128;
+
+#if defined(__SSE2__)
+using Vec4 = __m128;
+
+inline Vec4 Splat(float value) { return _mm_set1_ps(value); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+inline Vec4 Load(const float* in) { return _mm_loadu_ps(in); }
+inline void Store(Vec4 v, float* out) { _mm_storeu_ps(out, v); }
+
+// Converts 16 bytes to floats.
+inline void Load16(const uint8* in, Vec4* out) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i bytes =
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+  const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+  const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+  out[0] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(low, zero));
+  out[1] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(low, zero));
+  out[2] = _mm_cvtepi32_ps(_mm_unpacklo_epi16(high, zero));
+  out[3] = _mm_cvtepi32_ps(_mm_unpackhi_epi16(high, zero));
+}
+#elif MEDIAPIPE_IMAGE_TRANSFORMATION_NEON
+using Vec4 = float32x4_t;
+
+inline Vec4 Splat(float value) { return vdupq_n_f32(value); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+inline Vec4 Load(const float* in) { return vld1q_f32(in); }
+inline void Store(Vec4 v, float* out) { vst1q_f32(out, v); }
+
+inline void Load16(const uint8* in, Vec4* out) {
+  const uint8x16_t bytes = vld1q_u8(in);
+  const uint16x8_t low = vmovl_u8(vget_low_u8(bytes));
+  const uint16x8_t high = vmovl_u8(vget_high_u8(bytes));
+  out[0] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(low)));
+  out[1] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(low)));
+  out[2] = vcvtq_f32_u32(vmovl_u16(vget_low_u16(high)));
+  out[3] = vcvtq_f32_u32(vmovl_u16(vget_high_u16(high)));
+}
+#endif  // defined(__SSE2__)
+
+// acc[i] += weight * in[i] for i in [0, size).
+void AccumulateRow(const uint8* in, int size, float weight, float* acc) {
+  int i = 0;
+#if defined(__SSE2__) || MEDIAPIPE_IMAGE_TRANSFORMATION_NEON
+  const Vec4 w = Splat(weight);
+  for (; i + 16 <= size; i += 16) {
+    Vec4 v[4];
+    Load16(in + i, v);
+    for (int k = 0; k < 4; ++k) {
+      float* out = acc + i + 4 * k;
+      Store(Add(Load(out), Mul(v[k], w)), out);
+    }
+  }
+#endif  // defined(__SSE2__) || MEDIAPIPE_IMAGE_TRANSFORMATION_NEON
+  for (; i < size; ++i) {
+    acc[i] += weight * in[i];
+  }
+}
+
+inline void StoreValue(float value, float* out) { *out = value; }
+
+inline void StoreValue(float value, uint8* out) {
+  *out = static_cast<uint8>(std::min(std::max(value, 0.0f), 255.0f) + 0.5f);
+}
+
+// Resamples output pixels [begin, end) of a line of pixels along one axis.
+// Input pixel i is at in[(i - first_index) * kChannels] and output pixel o at
+// out[(o - begin) * out_stride].
+template <int kChannels, typename In, typename Out>
+void ResampleLine(const In* in, int first_index, const AxisTaps& taps,
+                  int begin, int end, Out* out, int out_stride) {
+  for (int o = begin; o < end; ++o, out += out_stride) {
+    float sum[kChannels] = {};
+    for (int t = taps.offsets[o]; t < taps.offsets[o + 1]; ++t) {
+      const In* pixel = in + (taps.indices[t] - first_index) * kChannels;
+      const float weight = taps.weights[t];
+      for (int c = 0; c < kChannels; ++c) {
+        sum[c] += weight * pixel[c];
+      }
+    }
+    for (int c = 0; c < kChannels; ++c) {
+      StoreValue(sum[c], out + c);
+    }
+  }
+}
+
+// Computes the taps of an axis of "input_size" pixels scaled to
+// "scaled_size". With "reverse", the input axis is read backwards. A
+// downscaled axis is averaged if "area", and interpolated otherwise.
+void ComputeTaps(int input_size, int scaled_size, bool reverse, bool area,
+                 AxisTaps* taps) {
+  taps->offsets.clear();
+  taps->indices.clear();
+  taps->weights.clear();
+  taps->identity = input_size == scaled_size;
+  auto add_tap = [input_size, reverse, taps](int index, double weight) {
+    taps->indices.push_back(reverse ? input_size - 1 - index : index);
+    taps->weights.push_back(weight);
+  };
+  const double scale = static_cast<double>(input_size) / scaled_size;
+  for (int o = 0; o < scaled_size; ++o) {
+    taps->offsets.push_back(taps->indices.size());
+    if (taps->identity) {
+      add_tap(o, 1.0);
+    } else if (area && scaled_size < input_size) {
+      // Averages the input pixels covered by [o, o + 1) in the scaled axis.
+      const double begin = o * scale;
+      const double end =
+          std::min((o + 1) * scale, static_cast<double>(input_size));
+      for (int i = static_cast<int>(begin); i < end; ++i) {
+        const double weight =
+            (std::min(end, i + 1.0) - std::max(begin, static_cast<double>(i))) /
+            scale;
+        if (weight > 1e-6) add_tap(i, weight);
+      }
+    } else {
+      // Interpolates between the input pixels around the pixel center.
+      double position = (o + 0.5) * scale - 0.5;
+      int i = static_cast<int>(std::floor(position));
+      double fraction = position - i;
+      if (i < 0) {
+        i = 0;
+        fraction = 0.0;
+      } else if (i >= input_size - 1) {
+        i = input_size - 1;
+        fraction = 0.0;
+      }
+      add_tap(i, 1.0 - fraction);
+      if (fraction > 0.0) add_tap(i + 1, fraction);
+    }
+  }
+  taps->offsets.push_back(taps->indices.size());
+  const auto range =
+      std::minmax_element(taps->indices.begin(), taps->indices.end());
+  taps->min_index = taps->indices.empty() ? 0 : *range.first;
+  taps->max_index = taps->indices.empty() ? -1 : *range.second;
+}
+
+// Where the scaled image lies along one axis of the output.
+struct Placement {
+  // First output pixel written, and the size of the axis after scaling.
+  int start;
+  int size;
+};
+
+void ComputePlacements(ScaleMode::Mode scale_mode, int input_width,
+                       int input_height, int output_width, int output_height,
+                       Placement* x, Placement* y) {
+  // FILL_AND_CROP fills the output, which is expected to have the aspect
+  // ratio of the image already.
+  if (scale_mode != ScaleMode::FIT) {
+    *x = {0, output_width};
+    *y = {0, output_height};
+    return;
+  }
+  const float scale =
+      std::min(static_cast<float>(output_width) / input_width,
+               static_cast<float>(output_height) / input_height);
+  const int width =
+      std::min<int>(std::round(input_width * scale), output_width);
+  const int height =
+      std::min<int>(std::round(input_height * scale), output_height);
+  *x = {(output_width - width) / 2, width};
+  *y = {(output_height - height) / 2, height};
+}
+
+// The part of the output the image is written to.
+struct OutputRegion {
+  uint8* data;
+  int step;
+  int width;
+  int height;
+};
+
+// Copies the pixels of an unscaled rotation or flip. Output pixel (x, y)
+// is input pixel (x_taps.indices[x], y_taps.indices[y]), or
+// (y_taps.indices[y], x_taps.indices[x]) if "transposed".
+template <int kChannels>
+void CopyPixels(const ImageFrame& input, const AxisTaps& x_taps,
+                const AxisTaps& y_taps, bool transposed,
+                const OutputRegion& output) {
+  const uint8* in = input.PixelData();
+  const int in_step = input.WidthStep();
+  if (!transposed) {
+    const bool reverse_x = output.width > 1 && x_taps.indices[0] != 0;
+    for (int y = 0; y < output.height; ++y) {
+      const uint8* in_row = in + y_taps.indices[y] * in_step;
+      uint8* out_row = output.data + y * output.step;
+      if (!reverse_x) {
+        std::memcpy(out_row, in_row, output.width * kChannels);
+        continue;
+      }
+      for (int x = 0; x < output.width; ++x) {
+        std::memcpy(out_row + x * kChannels,
+                    in_row + x_taps.indices[x] * kChannels, kChannels);
+      }
+    }
+    return;
+  }
+  // Output rows are input columns: copy in tiles to use the input cache
+  // lines across consecutive output rows.
+  for (int tile_y = 0; tile_y < output.height; tile_y += kTileSize) {
+    const int end_y = std::min(tile_y + kTileSize, output.height);
+    for (int tile_x = 0; tile_x < output.width; tile_x += kTileSize) {
+      const int tile_width = std::min(kTileSize, output.width - tile_x);
+      const uint8* in_rows[kTileSize];
+      for (int i = 0; i < tile_width; ++i) {
+        in_rows[i] = in + x_taps.indices[tile_x + i] * in_step;
+      }
+      for (int y = tile_y; y < end_y; ++y) {
+        const int column = y_taps.indices[y] * kChannels;
+        uint8* out_pixel = output.data + y * output.step + tile_x * kChannels;
+        for (int i = 0; i < tile_width; ++i, out_pixel += kChannels) {
+          std::memcpy(out_pixel, in_rows[i] + column, kChannels);
+        }
+      }
+    }
+  }
+}
+
+// Scales without transposing: each output row is resampled from a weighted
+// sum of the input rows, restricted to the input columns it uses.
+template <int kChannels>
+void ScaleRows(const ImageFrame& input, const AxisTaps& x_taps,
+               const AxisTaps& y_taps, const OutputRegion& output,
+               std::vector<float>* scratch) {
+  const int first_column = x_taps.min_index;
+  const int size = (x_taps.max_index - first_column + 1) * kChannels;
+  scratch->resize(size);
+  float* row = scratch->data();
+  for (int y = 0; y < output.height; ++y) {
+    std::fill(row, row + size, 0.0f);
+    for (int t = y_taps.offsets[y]; t < y_taps.offsets[y + 1]; ++t) {
+      const uint8* in_row = input.PixelData() +
+                            y_taps.indices[t] * input.WidthStep() +
+                            first_column * kChannels;
+      AccumulateRow(in_row, size, y_taps.weights[t], row);
+    }
+    ResampleLine<kChannels>(row, first_column, x_taps, 0, output.width,
+                            output.data + y * output.step, kChannels);
+  }
+}
+
+// Scales with a 90 or 270 degree rotation, where output rows come from input
+// columns. Output rows are computed in bands. For each output column of a
+// band, the input rows it uses are summed over the few input columns the band
+// uses, then the sum is resampled along the columns into the band.
+template <int kChannels>
+void ScaleTransposed(const ImageFrame& input, const AxisTaps& x_taps,
+                     const AxisTaps& y_taps, const OutputRegion& output,
+                     std::vector<float>* scratch) {
+  for (int band = 0; band < output.height; band += kBandRows) {
+    const int band_end = std::min(band + kBandRows, output.height);
+    const auto columns =
+        std::minmax_element(y_taps.indices.begin() + y_taps.offsets[band],
+                            y_taps.indices.begin() + y_taps.offsets[band_end]);
+    const int first_column = *columns.first;
+    const int size = (*columns.second - first_column + 1) * kChannels;
+    scratch->resize(size);
+    float* line = scratch->data();
+    for (int x = 0; x < output.width; ++x) {
+      std::fill(line, line + size, 0.0f);
+      for (int t = x_taps.offsets[x]; t < x_taps.offsets[x + 1]; ++t) {
+        const uint8* in_row = input.PixelData() +
+                              x_taps.indices[t] * input.WidthStep() +
+                              first_column * kChannels;
+        AccumulateRow(in_row, size, x_taps.weights[t], line);
+      }
+      ResampleLine<kChannels>(line, first_column, y_taps, band, band_end,
+                              output.data + band * output.step + x * kChannels,
+                              output.step);
+    }
+  }
+}
+
+// Fills the output outside of "region": black, or the nearest pixel of
+// "region" with "replicate".
+void FillPadding(const OutputRegion& region, bool replicate,
+                 ImageFrame* output) {
+  const int pixel_size = output->ByteDepth() * output->NumberOfChannels();
+  const int row_size = output->Width() * pixel_size;
+  const int left = (region.data - output->PixelData()) % output->WidthStep();
+  const int top = (region.data - output->PixelData()) / output->WidthStep();
+  const int right = row_size - left - region.width * pixel_size;
+  replicate &= region.width > 0 && region.height > 0;
+  for (int y = top; y < top + region.height; ++y) {
+    uint8* row = output->MutablePixelData() + y * output->WidthStep();
+    if (!replicate) {
+      std::memset(row, 0, left);
+      std::memset(row + row_size - right, 0, right);
+      continue;
+    }
+    for (int x = 0; x < left; x += pixel_size) {
+      std::memcpy(row + x, row + left, pixel_size);
+    }
+    for (int x = row_size - right; x < row_size; x += pixel_size) {
+      std::memcpy(row + x, row + row_size - right - pixel_size, pixel_size);
+    }
+  }
+  for (int y = 0; y < output->Height(); ++y) {
+    if (y >= top && y < top + region.height) continue;
+    uint8* row = output->MutablePixelData() + y * output->WidthStep();
+    if (replicate) {
+      const int source = y < top ? top : top + region.height - 1;
+      std::memcpy(row, output->PixelData() + source * output->WidthStep(),
+                  row_size);
+    } else {
+      std::memset(row, 0, row_size);
+    }
+  }
+}
+
+template <int kChannels>
+void TransformPixels(const ImageFrame& input, const AxisTaps& x_taps,
+                     const AxisTaps& y_taps, bool transposed,
+                     const OutputRegion& output, std::vector<float>* scratch) {
+  if (x_taps.identity && y_taps.identity) {
+    CopyPixels<kChannels>(input, x_taps, y_taps, transposed, output);
+  } else if (transposed) {
+    ScaleTransposed<kChannels>(input, x_taps, y_taps, output, scratch);
+  } else {
+    ScaleRows<kChannels>(input, x_taps, y_taps, output, scratch);
+  }
+}
+
+}  // namespace
+
+// static
+bool FusedImageTransformer::SupportsFormat(ImageFormat::Format format) {
+  return ImageFrame::ByteDepthForFormat(format) == 1 &&
+         ImageFrame::NumberOfChannelsForFormat(format) <= 4;
+}
+
+absl::Status FusedImageTransformer::Transform(const Options& options,
+                                              const ImageFrame& input,
+                                              ImageFrame* output) {
+  RET_CHECK(SupportsFormat(input.Format()))
+      << "Unsupported format: " << input.Format();
+  RET_CHECK_EQ(input.Format(), output->Format());
+  RET_CHECK(!input.IsEmpty());
+  RET_CHECK_EQ(options.rotation_degrees % 90, 0);
+  const int rotation = (options.rotation_degrees % 360 + 360) % 360;
+
+  // Dimensions and axis directions of the input after rotating and
+  // flipping it. The x axis of the rotated image runs along the input rows
+  // when "transposed".
+  const bool transposed = rotation == 90 || rotation == 270;
+  const int width = transposed ? input.Height() : input.Width();
+  const int height = transposed ? input.Width() : input.Height();
+  const bool reverse_x =
+      (rotation == 180 || rotation == 270) != options.flip_horizontally;
+  const bool reverse_y =
+      (rotation == 90 || rotation == 180) != options.flip_vertically;
+
+  Placement x, y;
+  ComputePlacements(options.scale_mode, width, height, output->Width(),
+                    output->Height(), &x, &y);
+  // The flips apply to the letterboxed image.
+  if (options.flip_horizontally) {
+    x.start = output->Width() - x.size - x.start;
+  }
+  if (options.flip_vertically) {
+    y.start = output->Height() - y.size - y.start;
+  }
+  // Like cv::resize() in ImageTransformationCalculator, downscales by
+  // averaging (INTER_AREA) only if STRETCH shrinks both axes, or if FIT and
+  // FILL_AND_CROP shrink the image, and interpolates (INTER_LINEAR)
+  // otherwise.
+  const bool area =
+      options.scale_mode == ScaleMode::STRETCH
+          ? x.size < width && y.size < height
+          : std::min(static_cast<float>(output->Width()) / width,
+                     static_cast<float>(output->Height()) / height) < 1.0f;
+  ComputeTaps(width, x.size, reverse_x, area, &x_taps_);
+  ComputeTaps(height, y.size, reverse_y, area, &y_taps_);
+
+  const int channels = input.NumberOfChannels();
+  const OutputRegion region = {output->MutablePixelData() +
+                                   y.start * output->WidthStep() +
+                                   x.start * channels,
+                               output->WidthStep(), x.size, y.size};
+  if (region.width > 0 && region.height > 0) {
+    switch (channels) {
+      case 1:
+        TransformPixels<1>(input, x_taps_, y_taps_, transposed, region,
+                           &scratch_);
+        break;
+      case 2:
+        TransformPixels<2>(input, x_taps_, y_taps_, transposed, region,
+                           &scratch_);
+        break;
+      case 3:
+        TransformPixels<3>(input, x_taps_, y_taps_, transposed, region,
+                           &scratch_);
+        break;
+      case 4:
+        TransformPixels<4>(input, x_taps_, y_taps_, transposed, region,
+                           &scratch_);
+        break;
+    }
+  }
+  if (region.width < output->Width() || region.height < output->Height()) {
+    FillPadding(region, !options.constant_padding, output);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,89 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_CALCULATORS_IMAGE_IMAGE_TRANSFORMATION_UTILS_H_
+#define MEDIAPIPE_CALCULATORS_IMAGE_IMAGE_TRANSFORMATION_UTILS_H_
+
+#include <vector>
+
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/gpu/scale_mode.pb.h"
+
+namespace mediapipe {
+
+// Rotates, scales and flips 8-bit images in a single pass: the input is
+// rotated counterclockwise by a multiple of 90 degrees, then scaled to the
+// size of the output frame, then flipped. STRETCH and FILL_AND_CROP fill the
+// output, FIT letterboxes the image with black or replicated border pixels.
+// As on CPU in ImageTransformationCalculator, FILL_AND_CROP does not crop:
+// the output is expected to have the aspect ratio of the image.
+//
+// No intermediate image is produced. Scaled transforms sum input rows into a
+// one-line scratch buffer (with SSE2 or NEON when available) and resample it
+// into the output; with a 90 or 270 degree rotation they do so in bands of
+// output rows, each reading only the input columns it uses. Pure rotations
+// and flips copy pixels in square tiles. The image is downscaled by averaging
+// the input pixels covered by an output pixel (as cv::INTER_AREA does) when
+// ImageTransformationCalculator would use INTER_AREA, and interpolated
+// bilinearly (as cv::INTER_LINEAR does) otherwise.
+//
+// The scratch buffers are kept between calls, so an instance should be
+// reused for a stream of frames. Not thread-safe.
+class FusedImageTransformer {
+ public:
+  struct Options {
+    // Counterclockwise, a multiple of 90.
+    int rotation_degrees = 0;
+    // Applied last, to the scaled and letterboxed image.
+    bool flip_horizontally = false;
+    bool flip_vertically = false;
+    ScaleMode::Mode scale_mode = ScaleMode::STRETCH;
+    // Letterboxes with black pixels if true, or by replicating the border
+    // pixels of the image otherwise. Only used by FIT.
+    bool constant_padding = true;
+  };
+
+  // Returns true for the formats with 8 bits and 1 to 4 channels per pixel.
+  static bool SupportsFormat(ImageFormat::Format format);
+
+  // Transforms "input" into "output", which must have the same format and
+  // already have the desired size.
+  absl::Status Transform(const Options& options, const ImageFrame& input,
+                         ImageFrame* output);
+
+  // The input pixels contributing to each output pixel along one axis.
+  struct AxisTaps {
+    // The taps of output pixel i are [offsets[i], offsets[i + 1]).
+    std::vector<int> offsets;
+    // Index of the input pixel along the axis, and its weight.
+    std::vector<int> indices;
+    std::vector<float> weights;
+    // Range of the indices.
+    int min_index = 0;
+    int max_index = 0;
+    // Whether output pixel i is input pixel indices[i], without scaling.
+    bool identity = false;
+  };
+
+ private:
+  AxisTaps x_taps_;
+  AxisTaps y_taps_;
+  std::vector<float> scratch_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_IMAGE_IMAGE_TRANSFORMATION_UTILS_H_
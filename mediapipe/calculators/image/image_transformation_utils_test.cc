@@ -0,0 +1,341 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/image/image_transformation_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+using Options = FusedImageTransformer::Options;
+
+ImageFrame MakeRandomImage(ImageFormat::Format format, int width, int height) {
+  ImageFrame image(format, width, height);
+  std::mt19937 rng(width * height);
+  std::uniform_int_distribution<int> value(0, 255);
+  for (int y = 0; y < height; ++y) {
+    uint8* row = image.MutablePixelData() + y * image.WidthStep();
+    for (int x = 0; x < width * image.NumberOfChannels(); ++x) {
+      row[x] = value(rng);
+    }
+  }
+  return image;
+}
+
+// A plain image with float pixels, for the reference implementation.
+struct Image {
+  int width;
+  int height;
+  int channels;
+  std::vector<double> pixels;
+  double& at(int x, int y, int c) {
+    return pixels[(y * width + x) * channels + c];
+  }
+  double at(int x, int y, int c) const {
+    return pixels[(y * width + x) * channels + c];
+  }
+};
+
+// Rotates and flips "input" like cv::rotate() and cv::flip().
+Image ReferenceRotateAndFlip(const ImageFrame& input, const Options& options) {
+  const int w = input.Width();
+  const int h = input.Height();
+  const int channels = input.NumberOfChannels();
+  const bool transposed =
+      options.rotation_degrees == 90 || options.rotation_degrees == 270;
+  Image result{transposed ? h : w, transposed ? w : h, channels, {}};
+  result.pixels.resize(w * h * channels);
+  for (int y = 0; y < result.height; ++y) {
+    for (int x = 0; x < result.width; ++x) {
+      const int rx = options.flip_horizontally ? result.width - 1 - x : x;
+      const int ry = options.flip_vertically ? result.height - 1 - y : y;
+      int ix = rx, iy = ry;
+      switch (options.rotation_degrees) {
+        case 90:  // Counterclockwise: the top right corner moves to the left.
+          ix = w - 1 - ry;
+          iy = rx;
+          break;
+        case 180:
+          ix = w - 1 - rx;
+          iy = h - 1 - ry;
+          break;
+        case 270:
+          ix = ry;
+          iy = h - 1 - rx;
+          break;
+      }
+      for (int c = 0; c < channels; ++c) {
+        result.at(x, y, c) =
+            input.PixelData()[iy * input.WidthStep() + ix * channels + c];
+      }
+    }
+  }
+  return result;
+}
+
+// The weight of every input pixel in scaled pixel "index", for an axis of
+// "size" pixels scaled to "scaled_size", like cv::resize() with INTER_AREA
+// if "area" and INTER_LINEAR otherwise.
+std::vector<double> ReferenceWeights(int size, int scaled_size, int index,
+                                     bool area) {
+  std::vector<double> weights(size, 0.0);
+  const double scale = static_cast<double>(size) / scaled_size;
+  if (area && scaled_size < size) {
+    for (int i = 0; i < size; ++i) {
+      const double overlap = std::min<double>(i + 1, (index + 1) * scale) -
+                             std::max<double>(i, index * scale);
+      weights[i] = std::max(overlap, 0.0) / scale;
+    }
+  } else {
+    const double position =
+        std::min(std::max((index + 0.5) * scale - 0.5, 0.0), size - 1.0);
+    const int i = std::floor(position);
+    weights[i] = 1.0 - (position - i);
+    if (i + 1 < size) weights[i + 1] = position - i;
+  }
+  return weights;
+}
+
+ImageFrame ReferenceTransform(const ImageFrame& input, const Options& options,
+                              int output_width, int output_height) {
+  // Flipping before scaling gives the same pixels, only the letterbox
+  // padding is flipped too.
+  const Image rotated = ReferenceRotateAndFlip(input, options);
+  const float scale =
+      std::min(static_cast<float>(output_width) / rotated.width,
+               static_cast<float>(output_height) / rotated.height);
+  int scaled_width = output_width, scaled_height = output_height;
+  int left = 0, top = 0;
+  if (options.scale_mode == ScaleMode::FIT) {
+    scaled_width = std::round(rotated.width * scale);
+    scaled_height = std::round(rotated.height * scale);
+    left = (output_width - scaled_width) / 2;
+    top = (output_height - scaled_height) / 2;
+    if (options.flip_horizontally) {
+      left = output_width - scaled_width - left;
+    }
+    if (options.flip_vertically) {
+      top = output_height - scaled_height - top;
+    }
+  }
+  // As chosen by ImageTransformationCalculator.
+  const bool area = options.scale_mode == ScaleMode::STRETCH
+                        ? scaled_width < rotated.width &&
+                              scaled_height < rotated.height
+                        : scale < 1.0f;
+
+  ImageFrame output(input.Format(), output_width, output_height);
+  for (int y = 0; y < output_height; ++y) {
+    for (int x = 0; x < output_width; ++x) {
+      int sx = x - left;
+      int sy = y - top;
+      uint8* pixel = output.MutablePixelData() + y * output.WidthStep() +
+                     x * rotated.channels;
+      const bool inside =
+          sx >= 0 && sx < scaled_width && sy >= 0 && sy < scaled_height;
+      if (!inside && options.constant_padding) {
+        std::fill(pixel, pixel + rotated.channels, 0);
+        continue;
+      }
+      sx = std::min(std::max(sx, 0), scaled_width - 1);
+      sy = std::min(std::max(sy, 0), scaled_height - 1);
+      const std::vector<double> x_weights =
+          ReferenceWeights(rotated.width, scaled_width, sx, area);
+      const std::vector<double> y_weights =
+          ReferenceWeights(rotated.height, scaled_height, sy, area);
+      for (int c = 0; c < rotated.channels; ++c) {
+        double sum = 0.0;
+        for (int j = 0; j < rotated.height; ++j) {
+          for (int i = 0; i < rotated.width; ++i) {
+            sum += x_weights[i] * y_weights[j] * rotated.at(i, j, c);
+          }
+        }
+        pixel[c] = std::round(sum);
+      }
+    }
+  }
+  return output;
+}
+
+void ExpectTransformMatchesReference(ImageFormat::Format format, int width,
+                                     int height, const Options& options,
+                                     int output_width, int output_height,
+                                     int tolerance) {
+  const ImageFrame input = MakeRandomImage(format, width, height);
+  ImageFrame output(format, output_width, output_height);
+  FusedImageTransformer transformer;
+  MP_ASSERT_OK(transformer.Transform(options, input, &output));
+  const ImageFrame expected =
+      ReferenceTransform(input, options, output_width, output_height);
+  const int channels = input.NumberOfChannels();
+  for (int y = 0; y < output_height; ++y) {
+    for (int x = 0; x < output_width * channels; ++x) {
+      ASSERT_NEAR(output.PixelData()[y * output.WidthStep() + x],
+                  expected.PixelData()[y * expected.WidthStep() + x], tolerance)
+          << "x=" << x / channels << " y=" << y << " rotation="
+          << options.rotation_degrees << " scale_mode=" << options.scale_mode
+          << " " << width << "x" << height << " -> " << output_width << "x"
+          << output_height;
+    }
+  }
+}
+
+TEST(FusedImageTransformerTest, RotatesAndFlipsExactly) {
+  for (int rotation : {0, 90, 180, 270}) {
+    for (int flip = 0; flip < 4; ++flip) {
+      Options options;
+      options.rotation_degrees = rotation;
+      options.flip_horizontally = flip & 1;
+      options.flip_vertically = flip & 2;
+      const bool transposed = rotation == 90 || rotation == 270;
+      // Larger than a tile, with partial tiles.
+      ExpectTransformMatchesReference(ImageFormat::SRGB, 150, 130, options,
+                                      transposed ? 130 : 150,
+                                      transposed ? 150 : 130, /*tolerance=*/0);
+    }
+  }
+}
+
+TEST(FusedImageTransformerTest, ScalesLikeReference) {
+  struct Size {
+    int width;
+    int height;
+  };
+  // Downscaling, upscaling, both, and enough rows for several bands.
+  // FILL_AND_CROP is expected to keep the aspect ratio, but stretches
+  // otherwise.
+  const Size sizes[] = {{16, 16}, {80, 50}, {20, 40}, {30, 60}};
+  for (ScaleMode::Mode scale_mode :
+       {ScaleMode::STRETCH, ScaleMode::FIT, ScaleMode::FILL_AND_CROP}) {
+    for (int rotation : {0, 90, 180, 270}) {
+      for (const Size& size : sizes) {
+        Options options;
+        options.rotation_degrees = rotation;
+        options.flip_horizontally = rotation == 180;
+        options.flip_vertically = rotation == 90;
+        options.scale_mode = scale_mode;
+        ExpectTransformMatchesReference(ImageFormat::SRGB, 37, 23, options,
+                                        size.width, size.height,
+                                        /*tolerance=*/1);
+      }
+    }
+  }
+}
+
+TEST(FusedImageTransformerTest, SupportsFormatsWithOneToFourChannels) {
+  Options options;
+  options.rotation_degrees = 90;
+  options.scale_mode = ScaleMode::FIT;
+  for (ImageFormat::Format format :
+       {ImageFormat::GRAY8, ImageFormat::SRGB, ImageFormat::SRGBA}) {
+    ExpectTransformMatchesReference(format, 37, 23, options, 24, 24,
+                                    /*tolerance=*/1);
+  }
+  EXPECT_TRUE(FusedImageTransformer::SupportsFormat(ImageFormat::SBGRA));
+  EXPECT_FALSE(FusedImageTransformer::SupportsFormat(ImageFormat::GRAY16));
+  EXPECT_FALSE(FusedImageTransformer::SupportsFormat(ImageFormat::VEC32F1));
+}
+
+TEST(FusedImageTransformerTest, ReplicatesBorderPixels) {
+  for (int rotation : {0, 90}) {
+    Options options;
+    options.rotation_degrees = rotation;
+    options.scale_mode = ScaleMode::FIT;
+    options.constant_padding = false;
+    ExpectTransformMatchesReference(ImageFormat::SRGBA, 37, 23, options, 32,
+                                    32, /*tolerance=*/1);
+  }
+}
+
+TEST(FusedImageTransformerTest, CanBeReused) {
+  const ImageFrame large = MakeRandomImage(ImageFormat::SRGB, 64, 48);
+  const ImageFrame small = MakeRandomImage(ImageFormat::SRGB, 16, 12);
+  Options options;
+  options.rotation_degrees = 270;
+  options.scale_mode = ScaleMode::FIT;
+  ImageFrame output(ImageFormat::SRGB, 24, 24);
+  ImageFrame fresh_output(ImageFormat::SRGB, 24, 24);
+  FusedImageTransformer transformer;
+  MP_ASSERT_OK(transformer.Transform(options, large, &output));
+  MP_ASSERT_OK(transformer.Transform(options, small, &output));
+  FusedImageTransformer fresh_transformer;
+  MP_ASSERT_OK(fresh_transformer.Transform(options, small, &fresh_output));
+  for (int y = 0; y < 24; ++y) {
+    EXPECT_EQ(std::memcmp(output.PixelData() + y * output.WidthStep(),
+                          fresh_output.PixelData() + y * output.WidthStep(),
+                          24 * 3),
+              0);
+  }
+}
+
+TEST(FusedImageTransformerTest, RejectsInvalidArguments) {
+  const ImageFrame input = MakeRandomImage(ImageFormat::SRGB, 8, 8);
+  FusedImageTransformer transformer;
+  ImageFrame float_output(ImageFormat::VEC32F1, 8, 8);
+  EXPECT_FALSE(transformer.Transform({}, input, &float_output).ok());
+  ImageFrame output(ImageFormat::SRGB, 8, 8);
+  Options options;
+  options.rotation_degrees = 45;
+  EXPECT_FALSE(transformer.Transform(options, input, &output).ok());
+}
+
+void RunTransformBenchmark(benchmark::State& state, const Options& options,
+                           int output_width, int output_height) {
+  const ImageFrame input = MakeRandomImage(ImageFormat::SRGB, 1920, 1080);
+  ImageFrame output(ImageFormat::SRGB, output_width, output_height);
+  FusedImageTransformer transformer;
+  for (auto _ : state) {
+    MEDIAPIPE_CHECK_OK(transformer.Transform(options, input, &output));
+    benchmark::DoNotOptimize(output.PixelData());
+  }
+}
+
+// 1080p letterboxed into a 256x256 model input.
+void BM_Letterbox1080pTo256(benchmark::State& state) {
+  Options options;
+  options.scale_mode = ScaleMode::FIT;
+  RunTransformBenchmark(state, options, 256, 256);
+}
+BENCHMARK(BM_Letterbox1080pTo256);
+
+// The same, for a camera mounted sideways.
+void BM_RotateAndLetterbox1080pTo256(benchmark::State& state) {
+  Options options;
+  options.rotation_degrees = 90;
+  options.scale_mode = ScaleMode::FIT;
+  RunTransformBenchmark(state, options, 256, 256);
+}
+BENCHMARK(BM_RotateAndLetterbox1080pTo256);
+
+void BM_Rotate1080p(benchmark::State& state) {
+  Options options;
+  options.rotation_degrees = 90;
+  options.flip_horizontally = true;
+  RunTransformBenchmark(state, options, 1080, 1920);
+}
+BENCHMARK(BM_Rotate1080p);
+
+}  // namespace
+}  // namespace mediapipe
@@ -12,11 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include <vector>
 
 #include "mediapipe/calculators/image/recolor_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
+#include "mediapipe/framework/formats/tiled_mask.h"
 
 #if !defined(__EMSCRIPTEN__)
 #include "mediapipe/framework/formats/image_frame_opencv.h"
@@ -39,6 +44,7 @@ enum { ATTRIB_VERTEX, ATTRIB_TEXTURE_POSITION, NUM_ATTRIBUTES };
 
 constexpr char kImageFrameTag[] = "IMAGE";
 constexpr char kMaskCpuTag[] = "MASK";
+constexpr char kTiledMaskTag[] = "TILED_MASK";
 constexpr char kGpuBufferTag[] = "IMAGE_GPU";
 constexpr char kMaskGpuTag[] = "MASK_GPU";
 
@@ -76,6 +82,9 @@ namespace mediapipe {
 //   MASK: An ImageFrame input mask in ImageFormat::GRAY8, SRGB, SRGBA, or
 //         VEC32F1
 //   MASK_GPU: A GpuBuffer input mask, RGBA.
+//   TILED_MASK: A TiledMask input mask. When it has the size of the image,
+//               uniform tiles are recolored or copied without reading any
+//               mask values.
 // Output:
 //   One of the following IMAGE tags:
 //   IMAGE: An ImageFrame output image.
@@ -117,6 +126,9 @@ class RecolorCalculator : public CalculatorBase {
   absl::Status InitGpu(CalculatorContext* cc);
   absl::Status RenderGpu(CalculatorContext* cc);
   absl::Status RenderCpu(CalculatorContext* cc);
+  absl::Status RenderTiledMaskCpu(CalculatorContext* cc,
+                                  const ImageFrame& input_img,
+                                  const TiledMask& mask);
   void GlRender();
 
   bool initialized_ = false;
@@ -124,6 +136,8 @@ class RecolorCalculator : public CalculatorBase {
   mediapipe::RecolorCalculatorOptions::MaskChannel mask_channel_;
 
   bool use_gpu_ = false;
+  // Provides the CPU output frames.
+  ImageFrameMultiPool* frame_pool_ = nullptr;
   bool invert_mask_ = false;
   bool adjust_with_luminance_ = false;
 #if !MEDIAPIPE_DISABLE_GPU
@@ -159,6 +173,11 @@ absl::Status RecolorCalculator::GetContract(CalculatorContract* cc) {
   if (cc->Inputs().HasTag(kMaskCpuTag)) {
     cc->Inputs().Tag(kMaskCpuTag).Set<ImageFrame>();
   }
+  if (cc->Inputs().HasTag(kTiledMaskTag)) {
+    cc->Inputs().Tag(kTiledMaskTag).Set<TiledMask>();
+  }
+  RET_CHECK(!(cc->Inputs().HasTag(kMaskCpuTag) &&
+              cc->Inputs().HasTag(kTiledMaskTag)));
 
 #if !MEDIAPIPE_DISABLE_GPU
   if (cc->Outputs().HasTag(kGpuBufferTag)) {
@@ -168,6 +187,7 @@ absl::Status RecolorCalculator::GetContract(CalculatorContract* cc) {
 #endif  // !MEDIAPIPE_DISABLE_GPU
   if (cc->Outputs().HasTag(kImageFrameTag)) {
     cc->Outputs().Tag(kImageFrameTag).Set<ImageFrame>();
+    cc->UseService(kImageFrameMultiPoolService);
   }
 
   // Confirm only one of the input streams is present.
@@ -195,6 +215,9 @@ absl::Status RecolorCalculator::Open(CalculatorContext* cc) {
     MP_RETURN_IF_ERROR(gpu_helper_.Open(cc));
 #endif  // !MEDIAPIPE_DISABLE_GPU
   }
+  if (cc->Outputs().HasTag(kImageFrameTag)) {
+    frame_pool_ = &cc->Service(kImageFrameMultiPoolService).GetObject();
+  }
 
   MP_RETURN_IF_ERROR(LoadOptions(cc));
 
@@ -233,7 +256,9 @@ absl::Status RecolorCalculator::Close(CalculatorContext* cc) {
 
 #if !defined(__EMSCRIPTEN__)
 absl::Status RecolorCalculator::RenderCpu(CalculatorContext* cc) {
-  if (cc->Inputs().Tag(kMaskCpuTag).IsEmpty()) {
+  const char* mask_tag =
+      cc->Inputs().HasTag(kTiledMaskTag) ? kTiledMaskTag : kMaskCpuTag;
+  if (cc->Inputs().Tag(mask_tag).IsEmpty()) {
     cc->Outputs()
         .Tag(kImageFrameTag)
         .AddPacket(cc->Inputs().Tag(kImageFrameTag).Value());
@@ -241,10 +266,23 @@ absl::Status RecolorCalculator::RenderCpu(CalculatorContext* cc) {
   }
   // Get inputs and setup output.
   const auto& input_img = cc->Inputs().Tag(kImageFrameTag).Get<ImageFrame>();
-  const auto& mask_img = cc->Inputs().Tag(kMaskCpuTag).Get<ImageFrame>();
+  std::unique_ptr<ImageFrame> dense_mask;
+  const ImageFrame* mask_img;
+  if (cc->Inputs().HasTag(kTiledMaskTag)) {
+    const auto& tiled_mask = cc->Inputs().Tag(kTiledMaskTag).Get<TiledMask>();
+    if (tiled_mask.width() == input_img.Width() &&
+        tiled_mask.height() == input_img.Height()) {
+      return RenderTiledMaskCpu(cc, input_img, tiled_mask);
+    }
+    // Masks of another size are converted and resized below.
+    dense_mask = tiled_mask.ToImageFrame();
+    mask_img = dense_mask.get();
+  } else {
+    mask_img = &cc->Inputs().Tag(kMaskCpuTag).Get<ImageFrame>();
+  }
 
   cv::Mat input_mat = formats::MatView(&input_img);
-  cv::Mat mask_mat = formats::MatView(&mask_img);
+  cv::Mat mask_mat = formats::MatView(mask_img);
 
   RET_CHECK(input_mat.channels() == 3);  // RGB only.
 
@@ -260,8 +298,8 @@ absl::Status RecolorCalculator::RenderCpu(CalculatorContext* cc) {
   cv::resize(mask_mat, mask_full, input_mat.size());
   const cv::Vec3b recolor = {color_[0], color_[1], color_[2]};
 
-  auto output_img = absl::make_unique<ImageFrame>(
-      input_img.Format(), input_mat.cols, input_mat.rows);
+  auto output_img =
+      frame_pool_->GetFrame(input_img.Format(), input_mat.cols, input_mat.rows);
   cv::Mat output_mat = mediapipe::formats::MatView(output_img.get());
 
   const int invert_mask = invert_mask_ ? 1 : 0;
@@ -278,7 +316,7 @@ absl::Status RecolorCalculator::RenderCpu(CalculatorContext* cc) {
 
       fragColor = mix(color1, color2, mix_value);
   */
-  if (mask_img.Format() == ImageFormat::VEC32F1) {
+  if (mask_img->Format() == ImageFormat::VEC32F1) {
     for (int i = 0; i < output_mat.rows; ++i) {
       for (int j = 0; j < output_mat.cols; ++j) {
         const float weight = mask_full.at<float>(i, j);
@@ -305,10 +343,76 @@ absl::Status RecolorCalculator::RenderCpu(CalculatorContext* cc) {
   return absl::OkStatus();
 }
 
+absl::Status RecolorCalculator::RenderTiledMaskCpu(CalculatorContext* cc,
+                                                   const ImageFrame& input_img,
+                                                   const TiledMask& mask) {
+  RET_CHECK(input_img.NumberOfChannels() == 3);  // RGB only.
+  cv::Mat input_mat = formats::MatView(&input_img);
+  auto output_img =
+      frame_pool_->GetFrame(input_img.Format(), input_mat.cols, input_mat.rows);
+  cv::Mat output_mat = formats::MatView(output_img.get());
+
+  const cv::Vec3b recolor = {color_[0], color_[1], color_[2]};
+  const int invert_mask = invert_mask_ ? 1 : 0;
+  const int adjust_with_luminance = adjust_with_luminance_ ? 1 : 0;
+  constexpr int kTileSize = TiledMask::kTileSize;
+
+  for (int tile_y = 0; tile_y < mask.tiles_y(); ++tile_y) {
+    const int top = tile_y * kTileSize;
+    const int height = std::min(kTileSize, input_mat.rows - top);
+    for (int tile_x = 0; tile_x < mask.tiles_x(); ++tile_x) {
+      const int left = tile_x * kTileSize;
+      const int width = std::min(kTileSize, input_mat.cols - left);
+      const TiledMask::TileType type = mask.tile_type(tile_x, tile_y);
+      if (type == TiledMask::TileType::kMixed) {
+        const uint8* values = mask.tile_data(tile_x, tile_y);
+        for (int i = 0; i < height; ++i) {
+          const cv::Vec3b* src = input_mat.ptr<cv::Vec3b>(top + i) + left;
+          cv::Vec3b* dst = output_mat.ptr<cv::Vec3b>(top + i) + left;
+          for (int j = 0; j < width; ++j) {
+            dst[j] = Blend(src[j], recolor,
+                           values[i * kTileSize + j] * (1.0 / 255.0),
+                           invert_mask, adjust_with_luminance);
+          }
+        }
+        continue;
+      }
+      // Uniform tile: either untouched by the recolor, or blended with a
+      // constant weight.
+      const bool foreground = type == TiledMask::TileType::kFull;
+      if (foreground == invert_mask_) {
+        for (int i = 0; i < height; ++i) {
+          std::memcpy(output_mat.ptr<cv::Vec3b>(top + i) + left,
+                      input_mat.ptr<cv::Vec3b>(top + i) + left,
+                      width * sizeof(cv::Vec3b));
+        }
+        continue;
+      }
+      const float weight = foreground ? 1.0f : 0.0f;
+      for (int i = 0; i < height; ++i) {
+        const cv::Vec3b* src = input_mat.ptr<cv::Vec3b>(top + i) + left;
+        cv::Vec3b* dst = output_mat.ptr<cv::Vec3b>(top + i) + left;
+        for (int j = 0; j < width; ++j) {
+          dst[j] = Blend(src[j], recolor, weight, invert_mask,
+                         adjust_with_luminance);
+        }
+      }
+    }
+  }
+
+  cc->Outputs()
+      .Tag(kImageFrameTag)
+      .Add(output_img.release(), cc->InputTimestamp());
+
+  return absl::OkStatus();
+}
+
 #else 
 
 absl::Status RecolorCalculator::RenderCpu(CalculatorContext* cc) {
-  if (cc->Inputs().Tag(kMaskCpuTag).IsEmpty()) {
+  const char* mask_tag =
+      cc->Inputs().HasTag(kTiledMaskTag) ? kTiledMaskTag : kMaskCpuTag;
+  if (cc->Inputs().Tag(mask_tag).IsEmpty()) {
     cc->Outputs()
         .Tag(kImageFrameTag)
         .AddPacket(cc->Inputs().Tag(kImageFrameTag).Value());
@@ -316,7 +420,6 @@ absl::Status RecolorCalculator::RenderCpu(CalculatorContext* cc) {
   }
   // Get inputs and setup output.
   const auto& input_img = cc->Inputs().Tag(kImageFrameTag).Get<ImageFrame>();
-  const auto& mask_img = cc->Inputs().Tag(kMaskCpuTag).Get<ImageFrame>();
 
 
   return absl::OkStatus();
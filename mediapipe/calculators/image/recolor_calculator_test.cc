@@ -0,0 +1,161 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/tiled_mask.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+// Neither dimension is a multiple of the tile size, so the last column and row
+// of tiles are partial.
+constexpr int kWidth = 70;
+constexpr int kHeight = 45;
+
+std::unique_ptr<ImageFrame> MakeImage() {
+  auto image =
+      absl::make_unique<ImageFrame>(ImageFormat::SRGB, kWidth, kHeight);
+  cv::Mat mat = formats::MatView(image.get());
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      mat.at<cv::Vec3b>(y, x) =
+          cv::Vec3b((x * 3) % 256, (y * 5) % 256, ((x + y) * 2) % 256);
+    }
+  }
+  return image;
+}
+
+// Returns a GRAY8 mask with full, empty and mixed tiles. Tiles (1, 1) and
+// (2, 1) are full, tile (3, 1) holds a ramp, and the partial tiles along the
+// right and bottom edges hold a pattern.
+std::unique_ptr<ImageFrame> MakeMask(int width = kWidth, int height = kHeight) {
+  auto mask = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, width, height);
+  cv::Mat mat = formats::MatView(mask.get());
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8 value = 0;
+      if (y >= 16 && y < 32 && x >= 16 && x < 48) {
+        value = 255;
+      } else if (y >= 16 && y < 32 && x >= 48 && x < 60) {
+        value = 255 - (x - 47) * 20;
+      } else if (x >= 64 || y >= 40) {
+        value = (x * 7 + y * 3) % 256;
+      }
+      mat.at<uint8>(y, x) = value;
+    }
+  }
+  return mask;
+}
+
+constexpr char kRecolorNode[] = R"pb(
+  calculator: "RecolorCalculator"
+  input_stream: "IMAGE:image"
+  input_stream: "$0:mask"
+  output_stream: "IMAGE:output"
+  options {
+    [mediapipe.RecolorCalculatorOptions.ext] {
+      color { r: 250 g: 20 b: 100 }
+      $1
+    }
+  }
+)pb";
+
+TiledMask MakeTiledMask(const ImageFrame& mask) {
+  auto tiled_mask = TiledMask::FromImageFrame(mask);
+  MP_EXPECT_OK(tiled_mask);
+  return std::move(tiled_mask).value();
+}
+
+// Runs RecolorCalculator with "options" on the test image and "mask", passed
+// on the "mask_tag" input, and returns the output image.
+cv::Mat RunRecolor(const std::string& options, const std::string& mask_tag,
+                   Packet mask) {
+  CalculatorRunner runner(absl::Substitute(kRecolorNode, mask_tag, options));
+  runner.MutableInputs()->Tag("IMAGE").packets.push_back(
+      Adopt(MakeImage().release()).At(Timestamp(0)));
+  runner.MutableInputs()->Tag(mask_tag).packets.push_back(
+      mask.At(Timestamp(0)));
+  MP_EXPECT_OK(runner.Run());
+  const auto& outputs = runner.Outputs().Tag("IMAGE").packets;
+  EXPECT_EQ(outputs.size(), 1);
+  if (outputs.empty()) return cv::Mat();
+  return formats::MatView(&outputs[0].Get<ImageFrame>()).clone();
+}
+
+bool AreEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() &&
+         cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+TEST(RecolorCalculatorTest, TiledMaskMatchesDenseMask) {
+  const std::unique_ptr<ImageFrame> mask = MakeMask();
+  const TiledMask tiled_mask = MakeTiledMask(*mask);
+  ASSERT_EQ(tiled_mask.tiles_x(), 5);
+  ASSERT_EQ(tiled_mask.tiles_y(), 3);
+  EXPECT_EQ(tiled_mask.tile_type(0, 0), TiledMask::TileType::kEmpty);
+  EXPECT_EQ(tiled_mask.tile_type(1, 1), TiledMask::TileType::kFull);
+  EXPECT_EQ(tiled_mask.tile_type(3, 1), TiledMask::TileType::kMixed);
+  EXPECT_EQ(tiled_mask.tile_type(4, 2), TiledMask::TileType::kMixed);
+
+  for (const char* invert_mask : {"false", "true"}) {
+    for (const char* adjust_with_luminance : {"false", "true"}) {
+      const std::string options =
+          absl::Substitute("invert_mask: $0 adjust_with_luminance: $1",
+                           invert_mask, adjust_with_luminance);
+      const cv::Mat expected =
+          RunRecolor(options, "MASK", Adopt(MakeMask().release()));
+      const cv::Mat actual =
+          RunRecolor(options, "TILED_MASK", MakePacket<TiledMask>(tiled_mask));
+      EXPECT_TRUE(AreEqual(actual, expected)) << options;
+      // The mask has an effect.
+      EXPECT_FALSE(AreEqual(actual, formats::MatView(MakeImage().get())))
+          << options;
+    }
+  }
+}
+
+TEST(RecolorCalculatorTest, TiledMaskOfOtherSizeIsResized) {
+  // A mask of another size takes the resize path, like a dense mask does.
+  constexpr int kMaskWidth = 35;
+  constexpr int kMaskHeight = 23;
+  const TiledMask tiled_mask =
+      MakeTiledMask(*MakeMask(kMaskWidth, kMaskHeight));
+  for (const char* invert_mask : {"false", "true"}) {
+    const std::string options =
+        absl::Substitute("invert_mask: $0", invert_mask);
+    const cv::Mat expected = RunRecolor(
+        options, "MASK", Adopt(MakeMask(kMaskWidth, kMaskHeight).release()));
+    const cv::Mat actual =
+        RunRecolor(options, "TILED_MASK", MakePacket<TiledMask>(tiled_mask));
+    EXPECT_EQ(actual.cols, kWidth);
+    EXPECT_EQ(actual.rows, kHeight);
+    EXPECT_TRUE(AreEqual(actual, expected)) << options;
+  }
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -26,6 +26,7 @@
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image_format.pb.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/formats/video_stream_header.h"
 #include "mediapipe/framework/formats/yuv_image.h"
@@ -37,6 +38,7 @@
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/util/image_frame_util.h"
+#include "mediapipe/util/yuv_image_sampler.h"
 
 namespace mediapipe {
 
@@ -98,7 +100,8 @@ void CropImageFrame(const ImageFrame& original, int col_start, int row_start,
 // The output can be cropped and scaled ImageFrame with the SRGB format. If the
 // input is a YUVImage, the output can be a scaled YUVImage (the scaling is done
 // using libyuv). Cropping is not yet supported for a YUVImage to a scaled
-// YUVImage conversion.
+// YUVImage conversion. When converting an I420 YUVImage to SRGB, only the
+// cropped region is converted.
 //
 // Example config:
 // node {
@@ -184,6 +187,7 @@ class ScaleImageCalculator : public CalculatorBase {
     if (cc->Inputs().HasTag("OVERRIDE_OPTIONS")) {
       cc->Inputs().Tag("OVERRIDE_OPTIONS").Set<ScaleImageCalculatorOptions>();
     }
+    cc->UseService(kImageFrameMultiPoolService);
     return absl::OkStatus();
   }
 
@@ -243,6 +247,9 @@ class ScaleImageCalculator : public CalculatorBase {
 
   // Efficient image resizer with gamma correction and optional sharpening.
   std::unique_ptr<ImageResizer> downscaler_;
+
+  // Provides the cropped and output frames.
+  ImageFrameMultiPool* frame_pool_ = nullptr;
 };
 
 REGISTER_CALCULATOR(ScaleImageCalculator);
@@ -316,6 +323,8 @@ absl::Status ScaleImageCalculator::Open(CalculatorContext* cc) {
   // The output packets are at the same timestamp as the input.
   cc->Outputs().Get(output_data_id_).SetOffset(mediapipe::TimestampDiff(0));
 
+  frame_pool_ = &cc->Service(kImageFrameMultiPoolService).GetObject();
+
   has_header_ = false;
   input_width_ = 0;
   input_height_ = 0;
@@ -555,16 +564,25 @@ absl::Status ScaleImageCalculator::Process(CalculatorContext* cc) {
   cc->GetCounter("Inputs")->Increment();
   const ImageFrame* image_frame;
   ImageFrame converted_image_frame;
+  std::unique_ptr<ImageFrame> cropped_image;
   if (input_format_ == ImageFormat::YCBCR420P) {
     const YUVImage* yuv_image =
         &cc->Inputs().Get(input_data_id_).Get<YUVImage>();
     MP_RETURN_IF_ERROR(ValidateYUVImage(cc, *yuv_image));
 
-    if (output_format_ == ImageFormat::SRGB) {
-      // TODO: For ease of implementation, YUVImage is converted to
-      // ImageFrame immediately, before cropping and scaling. Investigate how to
-      // make color space conversion more efficient when cropping or scaling is
-      // also needed.
+    if (output_format_ == ImageFormat::SRGB &&
+        YUVImageSampler::IsSupported(*yuv_image)) {
+      // Convert only the crop window, directly into the cropped frame.
+      const YUVImageSampler sampler(*yuv_image,
+                                    options_.use_bt709()
+                                        ? YuvToRgbMatrix::Bt709(false)
+                                        : YuvToRgbMatrix::Bt601(false));
+      cropped_image = frame_pool_->GetFrame(ImageFormat::SRGB, crop_width_,
+                                            crop_height_, alignment_boundary_);
+      MP_RETURN_IF_ERROR(
+          sampler.ConvertRegion(col_start_, row_start_, cropped_image.get()));
+      image_frame = cropped_image.get();
+    } else if (output_format_ == ImageFormat::SRGB) {
       image_frame_util::YUVImageToImageFrame(*yuv_image, &converted_image_frame,
                                              options_.use_bt709());
       image_frame = &converted_image_frame;
@@ -609,12 +627,15 @@ absl::Status ScaleImageCalculator::Process(CalculatorContext* cc) {
     MP_RETURN_IF_ERROR(ValidateImageFrame(cc, *image_frame));
   }
 
-  std::unique_ptr<ImageFrame> cropped_image;
   if (crop_width_ < input_width_ || crop_height_ < input_height_) {
     cc->GetCounter("Crops")->Increment();
+  }
+  // A YUVImage may already have been cropped by the color conversion.
+  if (!cropped_image &&
+      (crop_width_ < input_width_ || crop_height_ < input_height_)) {
     // TODO Do the crop as a range restrict inside OpenCV code below.
-    cropped_image.reset(new ImageFrame(image_frame->Format(), crop_width_,
-                                       crop_height_, alignment_boundary_));
+    cropped_image = frame_pool_->GetFrame(image_frame->Format(), crop_width_,
+                                          crop_height_, alignment_boundary_);
     if (image_frame->ByteDepth() == 1 || image_frame->ByteDepth() == 2) {
       CropImageFrame(*image_frame, col_start_, row_start_, crop_width_,
                      crop_height_, cropped_image.get());
@@ -652,8 +673,11 @@ absl::Status ScaleImageCalculator::Process(CalculatorContext* cc) {
             .AddPacket(cc->Inputs().Get(input_data_id_).Value());
       } else {
         // Make a copy with the correct alignment.
-        std::unique_ptr<ImageFrame> output_frame(new ImageFrame());
-        output_frame->CopyFrom(*image_frame, alignment_boundary_);
+        std::unique_ptr<ImageFrame> output_frame =
+            frame_pool_->GetFrame(image_frame->Format(), image_frame->Width(),
+                                  image_frame->Height(), alignment_boundary_);
+        cv::Mat output_mat = ::mediapipe::formats::MatView(output_frame.get());
+        ::mediapipe::formats::MatView(image_frame).copyTo(output_mat);
         if (options_.set_alignment_padding()) {
           output_frame->SetAlignmentPaddingAreas();
         }
@@ -667,22 +691,23 @@ absl::Status ScaleImageCalculator::Process(CalculatorContext* cc) {
   }
 
   // Rescale the image frame.
-  std::unique_ptr<ImageFrame> output_frame(new ImageFrame());
+  std::unique_ptr<ImageFrame> output_frame =
+      frame_pool_->GetFrame(image_frame->Format(), output_width_,
+                            output_height_, alignment_boundary_);
+  cv::Mat input_mat = ::mediapipe::formats::MatView(image_frame);
+  cv::Mat output_mat = ::mediapipe::formats::MatView(output_frame.get());
   if (image_frame->Width() >= output_width_ &&
       image_frame->Height() >= output_height_) {
     // Downscale.
     cc->GetCounter("Downscales")->Increment();
-    cv::Mat input_mat = ::mediapipe::formats::MatView(image_frame);
-    output_frame->Reset(image_frame->Format(), output_width_, output_height_,
-                        alignment_boundary_);
-    cv::Mat output_mat = ::mediapipe::formats::MatView(output_frame.get());
     downscaler_->Resize(input_mat, &output_mat);
   } else {
     // Upscale. If upscaling is disallowed, output_width_ and output_height_ are
     // the same as the input/crop width and height.
-    image_frame_util::RescaleImageFrame(
-        *image_frame, output_width_, output_height_, alignment_boundary_,
-        interpolation_algorithm_, output_frame.get());
+    RET_CHECK_EQ(ImageFormat::SRGB, image_frame->Format());
+    image_frame_util::RescaleSrgbImage(input_mat, output_width_,
+                                       output_height_, interpolation_algorithm_,
+                                       &output_mat);
     if (interpolation_algorithm_ != -1) {
       cc->GetCounter("Upscales")->Increment();
     }
@@ -20,6 +20,7 @@
 #include "mediapipe/framework/formats/image_format.pb.h"
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/tiled_mask.h"
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/status.h"
@@ -37,6 +38,7 @@ namespace {
 
 constexpr char kInputFrameTag[] = "IMAGE";
 constexpr char kInputAlphaTag[] = "ALPHA";
+constexpr char kInputTiledAlphaTag[] = "TILED_ALPHA";
 constexpr char kOutputFrameTag[] = "IMAGE";
 
 constexpr char kInputFrameTagGpu[] = "IMAGE_GPU";
@@ -66,6 +68,9 @@ enum { ATTRIB_VERTEX, ATTRIB_TEXTURE_POSITION, NUM_ATTRIBUTES };
 //   ALPHA_GPU (optional): GpuBuffer alpha mask to apply,
 //                         can be any # of channels, only first channel used,
 //                         must be same format as input
+//   TILED_ALPHA (optional): TiledMask alpha mask to apply, must have the size
+//                           of the input. Uniform tiles set alpha without
+//                           reading any mask values.
 //   If ALPHA* input tag is not set, the 'alpha_value' option must be used.
 //
 // Output:
@@ -79,7 +84,7 @@ enum { ATTRIB_VERTEX, ATTRIB_TEXTURE_POSITION, NUM_ATTRIBUTES };
 //   If alpha_value is not set, the ALPHA* input tag must be used.
 //
 // Notes:
-//   Either alpha_value option or ALPHA (or ALPHA_GPU) must be set.
+//   Either alpha_value option or ALPHA (or ALPHA_GPU, TILED_ALPHA) must be set.
 //   All CPU inputs must have the same image dimensions and data type.
 //
 class SetAlphaCalculator : public CalculatorBase {
@@ -148,6 +153,12 @@ absl::Status SetAlphaCalculator::GetContract(CalculatorContract* cc) {
   if (cc->Inputs().HasTag(kInputAlphaTag)) {
     cc->Inputs().Tag(kInputAlphaTag).Set<ImageFrame>();
   }
+  if (cc->Inputs().HasTag(kInputTiledAlphaTag)) {
+    if (cc->Inputs().HasTag(kInputAlphaTag)) {
+      return absl::InternalError("Cannot have multiple alpha masks.");
+    }
+    cc->Inputs().Tag(kInputTiledAlphaTag).Set<TiledMask>();
+  }
 
   // RGBA output image.
 #if !MEDIAPIPE_DISABLE_GPU
@@ -188,6 +199,7 @@ absl::Status SetAlphaCalculator::Open(CalculatorContext* cc) {
   if (use_gpu_) alpha_value_ /= 255.0;
 
   const bool use_image_mask = cc->Inputs().HasTag(kInputAlphaTag) ||
+                              cc->Inputs().HasTag(kInputTiledAlphaTag) ||
                               cc->Inputs().HasTag(kInputAlphaTagGpu);
   if (!((alpha_value_ >= 0) ^ use_image_mask))
     RET_CHECK_FAIL() << "Must use either image mask or options alpha value.";
@@ -251,9 +263,43 @@ absl::Status SetAlphaCalculator::RenderCpu(CalculatorContext* cc) {
   const bool has_alpha_mask = cc->Inputs().HasTag(kInputAlphaTag) &&
                               !cc->Inputs().Tag(kInputAlphaTag).IsEmpty();
   const bool use_alpa_mask = alpha_value_ < 0 && has_alpha_mask;
+  const bool use_tiled_alpha_mask =
+      alpha_value_ < 0 && cc->Inputs().HasTag(kInputTiledAlphaTag) &&
+      !cc->Inputs().Tag(kInputTiledAlphaTag).IsEmpty();
 
   // Setup alpha image and Update image in CPU.
-  if (use_alpa_mask) {
+  if (use_tiled_alpha_mask) {
+    const auto& alpha_mask =
+        cc->Inputs().Tag(kInputTiledAlphaTag).Get<TiledMask>();
+    RET_CHECK_EQ(input_mat.rows, alpha_mask.height());
+    RET_CHECK_EQ(input_mat.cols, alpha_mask.width());
+
+    constexpr int kTileSize = TiledMask::kTileSize;
+    for (int i = 0; i < output_mat.rows; ++i) {
+      const uchar* in_ptr = input_mat.ptr<uchar>(i);
+      uchar* out_ptr = output_mat.ptr<uchar>(i);
+      const int tile_y = i / kTileSize;
+      const int tile_row = (i % kTileSize) * kTileSize;
+      for (int tile_x = 0; tile_x < alpha_mask.tiles_x(); ++tile_x) {
+        const int left = tile_x * kTileSize;
+        const int right = std::min(left + kTileSize, output_mat.cols);
+        const TiledMask::TileType type = alpha_mask.tile_type(tile_x, tile_y);
+        const uchar* alpha_ptr =
+            type == TiledMask::TileType::kMixed
+                ? alpha_mask.tile_data(tile_x, tile_y) + tile_row
+                : nullptr;
+        const uchar fill = type == TiledMask::TileType::kFull ? 255 : 0;
+        for (int j = left; j < right; ++j) {
+          const int out_idx = j * kNumChannelsRGBA;
+          const int in_idx = j * input_mat.channels();
+          out_ptr[out_idx + 0] = in_ptr[in_idx + 0];
+          out_ptr[out_idx + 1] = in_ptr[in_idx + 1];
+          out_ptr[out_idx + 2] = in_ptr[in_idx + 2];
+          out_ptr[out_idx + 3] = alpha_ptr ? alpha_ptr[j - left] : fill;
+        }
+      }
+    }
+  } else if (use_alpa_mask) {
     const auto& alpha_mask = cc->Inputs().Tag(kInputAlphaTag).Get<ImageFrame>();
     cv::Mat alpha_mat = mediapipe::formats::MatView(&alpha_mask);
     RET_CHECK_EQ(input_mat.rows, alpha_mat.rows);
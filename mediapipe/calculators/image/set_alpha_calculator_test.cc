@@ -0,0 +1,143 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/formats/tiled_mask.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/port/statusor.h"
+
+namespace mediapipe {
+namespace {
+
+// Neither dimension is a multiple of the tile size, so the last column and row
+// of tiles are partial.
+constexpr int kWidth = 70;
+constexpr int kHeight = 45;
+
+constexpr char kSetAlphaNode[] = R"pb(
+  calculator: "SetAlphaCalculator"
+  input_stream: "IMAGE:image"
+  input_stream: "$0:alpha"
+  output_stream: "IMAGE:output"
+)pb";
+
+std::unique_ptr<ImageFrame> MakeImage(ImageFormat::Format format) {
+  auto image = absl::make_unique<ImageFrame>(format, kWidth, kHeight);
+  cv::Mat mat = formats::MatView(image.get());
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      uchar* pixel = mat.ptr<uchar>(y) + x * mat.channels();
+      pixel[0] = (x * 3) % 256;
+      pixel[1] = (y * 5) % 256;
+      pixel[2] = ((x + y) * 2) % 256;
+      if (mat.channels() == 4) pixel[3] = 100;
+    }
+  }
+  return image;
+}
+
+// Returns a GRAY8 alpha mask with full, empty and mixed tiles, including
+// mixed partial tiles along the right and bottom edges.
+std::unique_ptr<ImageFrame> MakeAlpha(int width = kWidth,
+                                      int height = kHeight) {
+  auto alpha = absl::make_unique<ImageFrame>(ImageFormat::GRAY8, width, height);
+  cv::Mat mat = formats::MatView(alpha.get());
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8 value = 0;
+      if (y >= 16 && y < 32 && x >= 16 && x < 48) {
+        value = 255;
+      } else if (y >= 16 && y < 32 && x >= 48 && x < 60) {
+        value = 255 - (x - 47) * 20;
+      } else if (x >= 64 || y >= 40) {
+        value = (x * 7 + y * 3) % 256;
+      }
+      mat.at<uint8>(y, x) = value;
+    }
+  }
+  return alpha;
+}
+
+TiledMask MakeTiledAlpha(const ImageFrame& alpha) {
+  auto tiled_alpha = TiledMask::FromImageFrame(alpha);
+  MP_EXPECT_OK(tiled_alpha);
+  return std::move(tiled_alpha).value();
+}
+
+// Runs SetAlphaCalculator on an image of "format" and "alpha", passed on the
+// "alpha_tag" input. Returns the output image, or the run status on failure.
+absl::StatusOr<cv::Mat> RunSetAlpha(ImageFormat::Format format,
+                                    const std::string& alpha_tag,
+                                    Packet alpha) {
+  CalculatorRunner runner(absl::Substitute(kSetAlphaNode, alpha_tag));
+  runner.MutableInputs()->Tag("IMAGE").packets.push_back(
+      Adopt(MakeImage(format).release()).At(Timestamp(0)));
+  runner.MutableInputs()->Tag(alpha_tag).packets.push_back(
+      alpha.At(Timestamp(0)));
+  MP_RETURN_IF_ERROR(runner.Run());
+  const auto& outputs = runner.Outputs().Tag("IMAGE").packets;
+  RET_CHECK_EQ(outputs.size(), 1);
+  return formats::MatView(&outputs[0].Get<ImageFrame>()).clone();
+}
+
+bool AreEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() &&
+         cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+TEST(SetAlphaCalculatorTest, TiledAlphaMatchesDenseAlpha) {
+  const TiledMask tiled_alpha = MakeTiledAlpha(*MakeAlpha());
+  ASSERT_EQ(tiled_alpha.tiles_x(), 5);
+  ASSERT_EQ(tiled_alpha.tiles_y(), 3);
+  EXPECT_EQ(tiled_alpha.tile_type(0, 0), TiledMask::TileType::kEmpty);
+  EXPECT_EQ(tiled_alpha.tile_type(1, 1), TiledMask::TileType::kFull);
+  EXPECT_EQ(tiled_alpha.tile_type(3, 1), TiledMask::TileType::kMixed);
+  EXPECT_EQ(tiled_alpha.tile_type(4, 2), TiledMask::TileType::kMixed);
+
+  for (ImageFormat::Format format : {ImageFormat::SRGB, ImageFormat::SRGBA}) {
+    auto expected = RunSetAlpha(format, "ALPHA", Adopt(MakeAlpha().release()));
+    MP_ASSERT_OK(expected);
+    auto actual = RunSetAlpha(format, "TILED_ALPHA",
+                              MakePacket<TiledMask>(tiled_alpha));
+    MP_ASSERT_OK(actual);
+    EXPECT_EQ(actual.value().type(), CV_8UC4);
+    EXPECT_TRUE(AreEqual(actual.value(), expected.value()))
+        << ImageFormat::Format_Name(format);
+  }
+}
+
+TEST(SetAlphaCalculatorTest, TiledAlphaMustHaveImageSize) {
+  const TiledMask tiled_alpha =
+      MakeTiledAlpha(*MakeAlpha(kWidth / 2, kHeight / 2));
+  EXPECT_FALSE(RunSetAlpha(ImageFormat::SRGB, "TILED_ALPHA",
+                           MakePacket<TiledMask>(tiled_alpha))
+                   .ok());
+}
+
+}  // namespace
+}  // namespace mediapipe
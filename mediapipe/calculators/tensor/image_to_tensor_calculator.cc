@@ -18,6 +18,7 @@
 
 #include "mediapipe/calculators/tensor/image_to_tensor_calculator.pb.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_fused.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
 #include "mediapipe/framework/api2/node.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -25,6 +26,7 @@
 #include "mediapipe/framework/formats/image_frame.h"
 #include "mediapipe/framework/formats/rect.pb.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/yuv_image.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/ret_check.h"
@@ -71,22 +73,37 @@ using GpuBuffer = mediapipe::GpuBuffer;
 //           ImageFrame [ImageFormat::SRGB/SRGBA] (for backward compatibility
 //           with existing graphs that use IMAGE for ImageFrame input)
 //   IMAGE_GPU - GpuBuffer [GpuBufferFormat::kBGRA32]
+//   IMAGE_YUV - YUVImage [8-bit I420, NV12 or NV21]
 //     Image to extract from.
 //
 //   Note:
-//   - One and only one of IMAGE and IMAGE_GPU should be specified.
+//   - One and only one of IMAGE, IMAGE_GPU and IMAGE_YUV should be specified.
 //   - IMAGE input of type Image is processed on GPU if the data is already on
 //     GPU (i.e., Image::UsesGpu() returns true), or otherwise processed on CPU.
 //   - IMAGE input of type ImageFrame is always processed on CPU.
 //   - IMAGE_GPU input (of type GpuBuffer) is always processed on GPU.
+//   - IMAGE_YUV input is processed on CPU by sampling the YUV planes directly
+//     and converting only the sampled pixels to RGB, regardless of
+//     cpu_converter. The color matrix is taken from the image (BT.601 unless
+//     BT.709 is specified).
 //
 //   NORM_RECT - NormalizedRect @Optional
 //     Describes region of image to extract.
 //     @Optional: rect covering the whole image is used if not specified.
 //
+//   NORM_RECTS - std::vector<NormalizedRect> @Optional
+//     Describes several regions of the image to extract into one batched
+//     tensor, e.g. all the hands or faces detected in a frame. Can't be used
+//     together with NORM_RECT. No tensor is produced for an empty vector.
+//
 // Outputs:
 //   TENSORS - std::vector<Tensor>
 //     Vector containing a single Tensor populated with an extrated RGB image.
+//     The tensor is kFloat32 if output_tensor_float_range is specified,
+//     kInt8 for output_tensor_int_range and kUInt8 for
+//     output_tensor_uint_range. Integer tensors are produced on CPU only.
+//     With NORM_RECTS, the tensor has shape [N, height, width, 3] and holds
+//     one extracted image per rect, in order.
 //   MATRIX - std::array<float, 16> @Optional
 //     An std::array<float, 16> representing a 4x4 row-major-order matrix which
 //     can be used to map a point on the output tensor to a point on the input
@@ -103,6 +120,10 @@ using GpuBuffer = mediapipe::GpuBuffer;
 //     20x20 and places it in the middle of the output image with an equal
 //     padding of 10 pixels at the top and the bottom. The resulting array is
 //     therefore [0.f, 0.25f, 0.f, 0.25f] (10/40 = 0.25f).
+//   MATRICES - std::vector<std::array<float, 16>> @Optional
+//   LETTERBOX_PADDINGS - std::vector<std::array<float, 4>> @Optional
+//     Same as MATRIX and LETTERBOX_PADDING, with one entry per rect of
+//     NORM_RECTS. Only available with NORM_RECTS.
 //
 // Example:
 // node {
@@ -129,32 +150,77 @@ class ImageToTensorCalculator : public Node {
   static constexpr Input<
       OneOf<mediapipe::Image, mediapipe::ImageFrame>>::Optional kIn{"IMAGE"};
   static constexpr Input<GpuBuffer>::Optional kInGpu{"IMAGE_GPU"};
+  static constexpr Input<mediapipe::YUVImage>::Optional kInYuv{"IMAGE_YUV"};
   static constexpr Input<mediapipe::NormalizedRect>::Optional kInNormRect{
       "NORM_RECT"};
+  static constexpr Input<std::vector<mediapipe::NormalizedRect>>::Optional
+      kInNormRects{"NORM_RECTS"};
   static constexpr Output<std::vector<Tensor>> kOutTensors{"TENSORS"};
   static constexpr Output<std::array<float, 4>>::Optional kOutLetterboxPadding{
       "LETTERBOX_PADDING"};
   static constexpr Output<std::array<float, 16>>::Optional kOutMatrix{"MATRIX"};
+  static constexpr Output<std::vector<std::array<float, 4>>>::Optional
+      kOutLetterboxPaddings{"LETTERBOX_PADDINGS"};
+  static constexpr Output<std::vector<std::array<float, 16>>>::Optional
+      kOutMatrices{"MATRICES"};
 
-  MEDIAPIPE_NODE_CONTRACT(kIn, kInGpu, kInNormRect, kOutTensors,
-                          kOutLetterboxPadding, kOutMatrix);
+  MEDIAPIPE_NODE_CONTRACT(kIn, kInGpu, kInYuv, kInNormRect, kInNormRects,
+                          kOutTensors, kOutLetterboxPadding, kOutMatrix,
+                          kOutLetterboxPaddings, kOutMatrices);
 
   static absl::Status UpdateContract(CalculatorContract* cc) {
     const auto& options =
         cc->Options<mediapipe::ImageToTensorCalculatorOptions>();
 
-    RET_CHECK(options.has_output_tensor_float_range())
+    RET_CHECK(options.has_output_tensor_float_range() ||
+              options.has_output_tensor_int_range() ||
+              options.has_output_tensor_uint_range())
         << "Output tensor range is required.";
-    RET_CHECK_LT(options.output_tensor_float_range().min(),
-                 options.output_tensor_float_range().max())
-        << "Valid output tensor range is required.";
+    if (options.has_output_tensor_float_range()) {
+      RET_CHECK_LT(options.output_tensor_float_range().min(),
+                   options.output_tensor_float_range().max())
+          << "Valid output float tensor range is required.";
+    }
+    if (options.has_output_tensor_int_range()) {
+      RET_CHECK_LT(options.output_tensor_int_range().min(),
+                   options.output_tensor_int_range().max())
+          << "Valid output int tensor range is required.";
+      RET_CHECK_GE(options.output_tensor_int_range().min(), -128)
+          << "The minimum of the output int tensor range must be >= -128.";
+      RET_CHECK_LE(options.output_tensor_int_range().max(), 127)
+          << "The maximum of the output int tensor range must be <= 127.";
+    }
+    if (options.has_output_tensor_uint_range()) {
+      RET_CHECK_LT(options.output_tensor_uint_range().min(),
+                   options.output_tensor_uint_range().max())
+          << "Valid output uint tensor range is required.";
+      RET_CHECK_LE(options.output_tensor_uint_range().max(), 255)
+          << "The maximum of the output uint tensor range must be <= 255.";
+    }
     RET_CHECK_GT(options.output_tensor_width(), 0)
         << "Valid output tensor width is required.";
     RET_CHECK_GT(options.output_tensor_height(), 0)
         << "Valid output tensor height is required.";
 
-    RET_CHECK(kIn(cc).IsConnected() ^ kInGpu(cc).IsConnected())
-        << "One and only one of IMAGE and IMAGE_GPU input is expected.";
+    RET_CHECK_EQ(kIn(cc).IsConnected() + kInGpu(cc).IsConnected() +
+                     kInYuv(cc).IsConnected(),
+                 1)
+        << "One and only one of IMAGE, IMAGE_GPU and IMAGE_YUV input is "
+           "expected.";
+    RET_CHECK(!kInGpu(cc).IsConnected() ||
+              options.has_output_tensor_float_range())
+        << "IMAGE_GPU input requires output_tensor_float_range.";
+    if (kInNormRects(cc).IsConnected()) {
+      RET_CHECK(!kInNormRect(cc).IsConnected())
+          << "At most one of NORM_RECT and NORM_RECTS input is expected.";
+      RET_CHECK(!kOutMatrix(cc).IsConnected() &&
+                !kOutLetterboxPadding(cc).IsConnected())
+          << "Use MATRICES and LETTERBOX_PADDINGS outputs with NORM_RECTS.";
+    } else {
+      RET_CHECK(!kOutMatrices(cc).IsConnected() &&
+                !kOutLetterboxPaddings(cc).IsConnected())
+          << "MATRICES and LETTERBOX_PADDINGS outputs require NORM_RECTS.";
+    }
 
 #if MEDIAPIPE_DISABLE_GPU
     if (kInGpu(cc).IsConnected()) {
@@ -176,18 +242,34 @@ class ImageToTensorCalculator : public Node {
     options_ = cc->Options<mediapipe::ImageToTensorCalculatorOptions>();
     output_width_ = options_.output_tensor_width();
     output_height_ = options_.output_tensor_height();
-    range_min_ = options_.output_tensor_float_range().min();
-    range_max_ = options_.output_tensor_float_range().max();
+    if (options_.has_output_tensor_int_range()) {
+      range_min_ =
+          static_cast<float>(options_.output_tensor_int_range().min());
+      range_max_ =
+          static_cast<float>(options_.output_tensor_int_range().max());
+    } else if (options_.has_output_tensor_uint_range()) {
+      range_min_ =
+          static_cast<float>(options_.output_tensor_uint_range().min());
+      range_max_ =
+          static_cast<float>(options_.output_tensor_uint_range().max());
+    } else {
+      range_min_ = options_.output_tensor_float_range().min();
+      range_max_ = options_.output_tensor_float_range().max();
+    }
 
     return absl::OkStatus();
   }
 
   absl::Status Process(CalculatorContext* cc) {
     if ((kIn(cc).IsConnected() && kIn(cc).IsEmpty()) ||
-        (kInGpu(cc).IsConnected() && kInGpu(cc).IsEmpty())) {
+        (kInGpu(cc).IsConnected() && kInGpu(cc).IsEmpty()) ||
+        (kInYuv(cc).IsConnected() && kInYuv(cc).IsEmpty())) {
       // Timestamp bound update happens automatically.
       return absl::OkStatus();
     }
+    if (kInNormRects(cc).IsConnected()) {
+      return ProcessBatch(cc);
+    }
 
     absl::optional<mediapipe::NormalizedRect> norm_rect;
     if (kInNormRect(cc).IsConnected()) {
@@ -208,8 +290,8 @@ class ImageToTensorCalculator : public Node {
       }
     }
 
-    ASSIGN_OR_RETURN(auto image, GetInputImage(cc));
-    const Size size{image->width(), image->height()};
+    ASSIGN_OR_RETURN(InputImage input, GetInputImage(cc));
+    const Size& size = input.size;
     RotatedRect roi = GetRoi(size.width, size.height, norm_rect);
     ASSIGN_OR_RETURN(auto padding, PadRoi(options_.output_tensor_width(),
                                           options_.output_tensor_height(),
@@ -225,13 +307,8 @@ class ImageToTensorCalculator : public Node {
       kOutMatrix(cc).Send(std::move(matrix));
     }
 
-    // Lazy initialization of the GPU or CPU converter.
-    MP_RETURN_IF_ERROR(InitConverterIfNecessary(cc, image->UsesGpu()));
-
     ASSIGN_OR_RETURN(Tensor tensor,
-                     (image->UsesGpu() ? gpu_converter_ : cpu_converter_)
-                         ->Convert(*image, roi, {output_width_, output_height_},
-                                   range_min_, range_max_));
+                     ConvertRois(cc, input, {roi}, /*batch=*/false));
 
     auto result = std::make_unique<std::vector<Tensor>>();
     result->push_back(std::move(tensor));
@@ -241,10 +318,68 @@ class ImageToTensorCalculator : public Node {
   }
 
  private:
+  // Extracts all the rects of NORM_RECTS into one batched tensor. The input
+  // image is read once and shared by all the rects.
+  absl::Status ProcessBatch(CalculatorContext* cc) {
+    if (kInNormRects(cc).IsEmpty() || (*kInNormRects(cc)).empty()) {
+      // Timestamp bound update happens automatically.
+      return absl::OkStatus();
+    }
+
+    ASSIGN_OR_RETURN(InputImage input, GetInputImage(cc));
+    const Size& size = input.size;
+    const auto& norm_rects = *kInNormRects(cc);
+    std::vector<RotatedRect> rois;
+    rois.reserve(norm_rects.size());
+    auto paddings = std::make_unique<std::vector<std::array<float, 4>>>();
+    auto matrices = std::make_unique<std::vector<std::array<float, 16>>>();
+    for (const auto& norm_rect : norm_rects) {
+      RotatedRect roi = GetRoi(size.width, size.height, norm_rect);
+      ASSIGN_OR_RETURN(auto padding,
+                       PadRoi(options_.output_tensor_width(),
+                              options_.output_tensor_height(),
+                              options_.keep_aspect_ratio(), &roi));
+      paddings->push_back(padding);
+      if (kOutMatrices(cc).IsConnected()) {
+        std::array<float, 16> matrix;
+        GetRotatedSubRectToRectTransformMatrix(roi, size.width, size.height,
+                                               /*flip_horizontaly=*/false,
+                                               &matrix);
+        matrices->push_back(matrix);
+      }
+      rois.push_back(roi);
+    }
+    if (kOutLetterboxPaddings(cc).IsConnected()) {
+      kOutLetterboxPaddings(cc).Send(std::move(paddings));
+    }
+    if (kOutMatrices(cc).IsConnected()) {
+      kOutMatrices(cc).Send(std::move(matrices));
+    }
+
+    ASSIGN_OR_RETURN(Tensor tensor,
+                     ConvertRois(cc, input, rois, /*batch=*/true));
+
+    auto result = std::make_unique<std::vector<Tensor>>();
+    result->push_back(std::move(tensor));
+    kOutTensors(cc).Send(std::move(result));
+
+    return absl::OkStatus();
+  }
+
   bool DoesGpuInputStartAtBottom() {
     return options_.gpu_origin() != mediapipe::GpuOrigin_Mode_TOP_LEFT;
   }
 
+  Tensor::ElementType GetOutputTensorType() {
+    if (options_.has_output_tensor_int_range()) {
+      return Tensor::ElementType::kInt8;
+    }
+    if (options_.has_output_tensor_uint_range()) {
+      return Tensor::ElementType::kUInt8;
+    }
+    return Tensor::ElementType::kFloat32;
+  }
+
   BorderMode GetBorderMode() {
     switch (options_.border_mode()) {
       case mediapipe::
@@ -258,7 +393,26 @@ class ImageToTensorCalculator : public Node {
     }
   }
 
-  absl::StatusOr<std::shared_ptr<const mediapipe::Image>> GetInputImage(
+  // The input image: either an Image, from IMAGE or IMAGE_GPU, or a YUVImage.
+  struct InputImage {
+    std::shared_ptr<const mediapipe::Image> image;
+    const mediapipe::YUVImage* yuv_image = nullptr;
+    Size size;
+  };
+
+  absl::StatusOr<InputImage> GetInputImage(CalculatorContext* cc) {
+    InputImage input;
+    if (kInYuv(cc).IsConnected()) {
+      input.yuv_image = &*kInYuv(cc);
+      input.size = {input.yuv_image->width(), input.yuv_image->height()};
+    } else {
+      ASSIGN_OR_RETURN(input.image, GetImage(cc));
+      input.size = {input.image->width(), input.image->height()};
+    }
+    return input;
+  }
+
+  absl::StatusOr<std::shared_ptr<const mediapipe::Image>> GetImage(
       CalculatorContext* cc) {
     if (kIn(cc).IsConnected()) {
       const auto& packet = kIn(cc).packet();
@@ -284,9 +438,36 @@ class ImageToTensorCalculator : public Node {
     }
   }
 
+  // Extracts "rois" from the input into one tensor, with ConvertBatch() if
+  // "batch" is true or with Convert() for the single roi otherwise.
+  absl::StatusOr<Tensor> ConvertRois(CalculatorContext* cc,
+                                     const InputImage& input,
+                                     const std::vector<RotatedRect>& rois,
+                                     bool batch) {
+    const Size output_dims{output_width_, output_height_};
+    if (input.yuv_image != nullptr) {
+      return ConvertYuvImageToTensor(*input.yuv_image, rois, output_dims,
+                                     range_min_, range_max_, GetBorderMode(),
+                                     GetOutputTensorType());
+    }
+    // Lazy initialization of the GPU or CPU converter.
+    const bool use_gpu = input.image->UsesGpu();
+    MP_RETURN_IF_ERROR(InitConverterIfNecessary(cc, use_gpu));
+    ImageToTensorConverter* converter =
+        use_gpu ? gpu_converter_.get() : cpu_converter_.get();
+    if (batch) {
+      return converter->ConvertBatch(*input.image, rois, output_dims,
+                                     range_min_, range_max_);
+    }
+    return converter->Convert(*input.image, rois[0], output_dims, range_min_,
+                              range_max_);
+  }
+
   absl::Status InitConverterIfNecessary(CalculatorContext* cc, bool use_gpu) {
     // Lazy initialization of the GPU or CPU converter.
     if (use_gpu) {
+      RET_CHECK(GetOutputTensorType() == Tensor::ElementType::kFloat32)
+          << "Only float tensors can be produced from GPU images.";
       if (!gpu_converter_) {
 #if !MEDIAPIPE_DISABLE_GPU
 #if MEDIAPIPE_METAL_ENABLED
@@ -306,12 +487,24 @@ class ImageToTensorCalculator : public Node {
     } else {
       if (!cpu_converter_) {
 #if !MEDIAPIPE_DISABLE_OPENCV && !defined(__EMSCRIPTEN__)
-        ASSIGN_OR_RETURN(cpu_converter_,
-                         CreateOpenCvConverter(cc, GetBorderMode()));
+        if (options_.cpu_converter() !=
+            mediapipe::ImageToTensorCalculatorOptions::CPU_CONVERTER_FUSED) {
+          ASSIGN_OR_RETURN(cpu_converter_,
+                           CreateOpenCvConverter(cc, GetBorderMode(),
+                                                 GetOutputTensorType()));
+        }
 #else
-        LOG(FATAL) << "Cannot create image to tensor opencv converter since "
-                      "MEDIAPIPE_DISABLE_OPENCV is defined.";
+        RET_CHECK(options_.cpu_converter() !=
+                  mediapipe::ImageToTensorCalculatorOptions::
+                      CPU_CONVERTER_OPENCV)
+            << "Cannot create image to tensor opencv converter since "
+               "MEDIAPIPE_DISABLE_OPENCV is defined.";
 #endif  // !MEDIAPIPE_DISABLE_OPENCV
+        if (!cpu_converter_) {
+          ASSIGN_OR_RETURN(cpu_converter_,
+                           CreateFusedConverter(cc, GetBorderMode(),
+                                                GetOutputTensorType()));
+        }
       }
     }
     return absl::OkStatus();
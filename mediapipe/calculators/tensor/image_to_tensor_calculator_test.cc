@@ -12,13 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <array>
 #include <cmath>
+#include <string>
 #include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_calculator.pb.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_fused.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_opencv.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
@@ -29,6 +34,8 @@
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/formats/rect.pb.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/yuv_image.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/gtest.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
@@ -36,6 +43,7 @@
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
 #include "mediapipe/framework/port/parse_text_proto.h"
 #include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/util/yuv_image_sampler.h"
 
 namespace mediapipe {
 namespace {
@@ -61,7 +69,10 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
                                  float range_max, int tensor_width,
                                  int tensor_height, bool keep_aspect,
                                  absl::optional<BorderMode> border_mode,
-                                 const mediapipe::NormalizedRect& roi) {
+                                 const mediapipe::NormalizedRect& roi,
+                                 Tensor::ElementType tensor_type,
+                                 ImageToTensorCalculatorOptions::CpuConverter
+                                     cpu_converter) {
   std::string border_mode_str;
   if (border_mode) {
     switch (*border_mode) {
@@ -73,6 +84,22 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
         break;
     }
   }
+  std::string range_str;
+  int mat_type;
+  switch (tensor_type) {
+    case Tensor::ElementType::kInt8:
+      range_str = "output_tensor_int_range";
+      mat_type = CV_8SC3;
+      break;
+    case Tensor::ElementType::kUInt8:
+      range_str = "output_tensor_uint_range";
+      mat_type = CV_8UC3;
+      break;
+    default:
+      range_str = "output_tensor_float_range";
+      mat_type = CV_32FC3;
+      break;
+  }
   auto graph_config = mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(
       absl::Substitute(R"(
         input_stream: "input_image"
@@ -87,11 +114,12 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
               output_tensor_width: $0
               output_tensor_height: $1
               keep_aspect_ratio: $4
-              output_tensor_float_range {
+              $6 {
                 min: $2
                 max: $3
               }
               $5 # border mode
+              cpu_converter: $7
             }
           }
         }
@@ -101,7 +129,10 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
                        /*$2=*/range_min,
                        /*$3=*/range_max,
                        /*$4=*/keep_aspect ? "true" : "false",
-                       /*$5=*/border_mode_str));
+                       /*$5=*/border_mode_str,
+                       /*$6=*/range_str,
+                       /*$7=*/ImageToTensorCalculatorOptions::CpuConverter_Name(
+                           cpu_converter)));
 
   std::vector<Packet> output_packets;
   tool::AddVectorSink("tensor", &graph_config, &output_packets);
@@ -126,11 +157,11 @@ void RunTestWithInputImagePacket(const Packet& input_image_packet,
   ASSERT_THAT(tensor_vec, testing::SizeIs(1));
 
   const Tensor& tensor = tensor_vec[0];
-  EXPECT_EQ(tensor.element_type(), Tensor::ElementType::kFloat32);
+  EXPECT_EQ(tensor.element_type(), tensor_type);
 
   auto view = tensor.GetCpuReadView();
-  cv::Mat tensor_mat(tensor_height, tensor_width, CV_32FC3,
-                     const_cast<float*>(view.buffer<float>()));
+  cv::Mat tensor_mat(tensor_height, tensor_width, mat_type,
+                     const_cast<void*>(view.buffer<void>()));
   cv::Mat result_rgb;
   auto transformation =
       GetValueRangeTransformation(range_min, range_max, 0.0f, 255.0f).value();
@@ -170,16 +201,24 @@ enum class InputType { kImageFrame, kImage };
 const std::vector<InputType> kInputTypesToTest = {InputType::kImageFrame,
                                                   InputType::kImage};
 
+const std::vector<ImageToTensorCalculatorOptions::CpuConverter>
+    kCpuConvertersToTest = {
+        ImageToTensorCalculatorOptions::CPU_CONVERTER_OPENCV,
+        ImageToTensorCalculatorOptions::CPU_CONVERTER_FUSED};
+
 void RunTest(cv::Mat input, cv::Mat expected_result, float range_min,
              float range_max, int tensor_width, int tensor_height,
              bool keep_aspect, absl::optional<BorderMode> border_mode,
-             const mediapipe::NormalizedRect& roi) {
+             const mediapipe::NormalizedRect& roi,
+             Tensor::ElementType tensor_type = Tensor::ElementType::kFloat32) {
   for (auto input_type : kInputTypesToTest) {
-    RunTestWithInputImagePacket(
-        input_type == InputType::kImageFrame ? MakeImageFramePacket(input)
-                                             : MakeImagePacket(input),
-        expected_result, range_min, range_max, tensor_width, tensor_height,
-        keep_aspect, border_mode, roi);
+    for (auto cpu_converter : kCpuConvertersToTest) {
+      RunTestWithInputImagePacket(
+          input_type == InputType::kImageFrame ? MakeImageFramePacket(input)
+                                               : MakeImagePacket(input),
+          expected_result, range_min, range_max, tensor_width, tensor_height,
+          keep_aspect, border_mode, roi, tensor_type, cpu_converter);
+    }
   }
 }
 
@@ -433,5 +472,280 @@ TEST(ImageToTensorCalculatorTest, NoOpExceptRangeBorderZero) {
           BorderMode::kZero, roi);
 }
 
+TEST(ImageToTensorCalculatorTest, NoOpExceptRangeUInt8) {
+  mediapipe::NormalizedRect roi;
+  roi.set_x_center(0.5f);
+  roi.set_y_center(0.5f);
+  roi.set_width(1.0f);
+  roi.set_height(1.0f);
+  roi.set_rotation(0);
+  RunTest(GetRgba("/mediapipe/calculators/"
+                  "tensor/testdata/image_to_tensor/input.jpg"),
+          GetRgb("/mediapipe/calculators/"
+                 "tensor/testdata/image_to_tensor/noop_except_range.png"),
+          /*range_min=*/0.0f,
+          /*range_max=*/255.0f,
+          /*tensor_width=*/64, /*tensor_height=*/128, /*keep_aspect=*/true,
+          BorderMode::kReplicate, roi, Tensor::ElementType::kUInt8);
+}
+
+TEST(ImageToTensorCalculatorTest, NoOpExceptRangeInt8) {
+  mediapipe::NormalizedRect roi;
+  roi.set_x_center(0.5f);
+  roi.set_y_center(0.5f);
+  roi.set_width(1.0f);
+  roi.set_height(1.0f);
+  roi.set_rotation(0);
+  RunTest(GetRgba("/mediapipe/calculators/"
+                  "tensor/testdata/image_to_tensor/input.jpg"),
+          GetRgb("/mediapipe/calculators/"
+                 "tensor/testdata/image_to_tensor/noop_except_range.png"),
+          /*range_min=*/-128.0f,
+          /*range_max=*/127.0f,
+          /*tensor_width=*/64, /*tensor_height=*/128, /*keep_aspect=*/true,
+          BorderMode::kReplicate, roi, Tensor::ElementType::kInt8);
+}
+
+// Runs the calculator with the given NORM_RECT or NORM_RECTS packet and returns
+// the TENSORS and MATRICES output packets (if any).
+std::vector<Packet> RunWithRects(
+    const std::string& rect_tag, const Packet& image_packet,
+    const Packet& rect_packet,
+    ImageToTensorCalculatorOptions::CpuConverter cpu_converter,
+    const std::string& image_tag = "IMAGE") {
+  const bool batched = rect_tag == "NORM_RECTS";
+  auto graph_config = mediapipe::ParseTextProtoOrDie<CalculatorGraphConfig>(
+      absl::Substitute(R"(
+        input_stream: "input_image"
+        input_stream: "roi"
+        node {
+          calculator: "ImageToTensorCalculator"
+          input_stream: "$3:input_image"
+          input_stream: "$0:roi"
+          output_stream: "TENSORS:tensor"
+          $1
+          options {
+            [mediapipe.ImageToTensorCalculatorOptions.ext] {
+              output_tensor_width: 16
+              output_tensor_height: 24
+              keep_aspect_ratio: true
+              output_tensor_float_range { min: -1.0 max: 1.0 }
+              cpu_converter: $2
+            }
+          }
+        }
+        )",
+                       rect_tag,
+                       batched ? "output_stream: \"MATRICES:matrices\"" : "",
+                       ImageToTensorCalculatorOptions::CpuConverter_Name(
+                           cpu_converter),
+                       image_tag));
+  std::vector<Packet> tensor_packets;
+  std::vector<Packet> matrix_packets;
+  tool::AddVectorSink("tensor", &graph_config, &tensor_packets);
+  if (batched) {
+    tool::AddVectorSink("matrices", &graph_config, &matrix_packets);
+  }
+  CalculatorGraph graph;
+  MP_EXPECT_OK(graph.Initialize(graph_config));
+  MP_EXPECT_OK(graph.StartRun({}));
+  MP_EXPECT_OK(graph.AddPacketToInputStream("input_image", image_packet));
+  MP_EXPECT_OK(graph.AddPacketToInputStream("roi", rect_packet));
+  MP_EXPECT_OK(graph.CloseAllInputStreams());
+  MP_EXPECT_OK(graph.WaitUntilDone());
+  tensor_packets.insert(tensor_packets.end(), matrix_packets.begin(),
+                        matrix_packets.end());
+  return tensor_packets;
+}
+
+TEST(ImageToTensorCalculatorTest, BatchedRectsMatchSingleRects) {
+  cv::Mat input(60, 80, CV_8UC4);
+  cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(255));
+  std::vector<mediapipe::NormalizedRect> rects(3);
+  rects[0].set_x_center(0.5f);
+  rects[0].set_y_center(0.5f);
+  rects[0].set_width(0.5f);
+  rects[0].set_height(0.5f);
+  rects[1].set_x_center(0.2f);
+  rects[1].set_y_center(0.7f);
+  rects[1].set_width(0.3f);
+  rects[1].set_height(0.4f);
+  rects[1].set_rotation(M_PI * 30.0f / 180.0f);
+  rects[2].set_x_center(0.9f);
+  rects[2].set_y_center(0.1f);
+  rects[2].set_width(0.6f);
+  rects[2].set_height(0.2f);
+  for (auto cpu_converter : kCpuConvertersToTest) {
+    const std::vector<Packet> batched_packets = RunWithRects(
+        "NORM_RECTS", MakeImagePacket(input),
+        MakePacket<std::vector<mediapipe::NormalizedRect>>(rects).At(
+            Timestamp(0)),
+        cpu_converter);
+    ASSERT_THAT(batched_packets, testing::SizeIs(2));
+    const Tensor& batch =
+        batched_packets[0].Get<std::vector<Tensor>>().front();
+    EXPECT_EQ(batch.shape().dims, (std::vector<int>{3, 24, 16, 3}));
+    EXPECT_THAT(batched_packets[1].Get<std::vector<std::array<float, 16>>>(),
+                testing::SizeIs(3));
+    auto batch_view = batch.GetCpuReadView();
+    const float* batch_data = batch_view.buffer<float>();
+
+    // Every slice of the batch is the tensor extracted from its rect alone.
+    for (int i = 0; i < rects.size(); ++i) {
+      const std::vector<Packet> packets =
+          RunWithRects("NORM_RECT", MakeImagePacket(input),
+                       MakePacket<mediapipe::NormalizedRect>(rects[i]).At(
+                           Timestamp(0)),
+                       cpu_converter);
+      ASSERT_THAT(packets, testing::SizeIs(1));
+      const Tensor& tensor = packets[0].Get<std::vector<Tensor>>().front();
+      EXPECT_EQ(tensor.shape().dims, (std::vector<int>{1, 24, 16, 3}));
+      auto view = tensor.GetCpuReadView();
+      const int num_elements = tensor.shape().num_elements();
+      const std::vector<float> expected(view.buffer<float>(),
+                                        view.buffer<float>() + num_elements);
+      const std::vector<float> actual(batch_data + i * num_elements,
+                                      batch_data + (i + 1) * num_elements);
+      EXPECT_EQ(actual, expected);
+    }
+  }
+}
+
+TEST(ImageToTensorCalculatorTest, EmptyRectsProduceNoTensor) {
+  cv::Mat input(60, 80, CV_8UC3, cv::Scalar::all(7));
+  const std::vector<Packet> packets = RunWithRects(
+      "NORM_RECTS", MakeImagePacket(input),
+      MakePacket<std::vector<mediapipe::NormalizedRect>>().At(Timestamp(0)),
+      ImageToTensorCalculatorOptions::CPU_CONVERTER_FUSED);
+  EXPECT_THAT(packets, testing::IsEmpty());
+}
+
+// Returns an NV12 image with random pixels. Luma and chroma are kept in a
+// range that converts to RGB without clamping.
+std::unique_ptr<YUVImage> MakeRandomNv12Image(int width, int height) {
+  const int chroma_width = (width + 1) / 2;
+  const int chroma_height = (height + 1) / 2;
+  cv::Mat y(height, width, CV_8UC1);
+  cv::Mat uv(chroma_height, chroma_width, CV_8UC2);
+  cv::randu(y, cv::Scalar::all(64), cv::Scalar::all(192));
+  cv::randu(uv, cv::Scalar::all(112), cv::Scalar::all(144));
+  auto y_data = absl::make_unique<uint8[]>(y.total());
+  auto uv_data = absl::make_unique<uint8[]>(uv.total() * 2);
+  std::memcpy(y_data.get(), y.data, y.total());
+  std::memcpy(uv_data.get(), uv.data, uv.total() * 2);
+  return absl::make_unique<YUVImage>(
+      libyuv::FOURCC_NV12, std::move(y_data), width, std::move(uv_data),
+      2 * chroma_width, nullptr, 0, width, height);
+}
+
+TEST(ImageToTensorCalculatorTest, YuvInputMatchesConvertedRgbInput) {
+  const Packet yuv_packet =
+      Adopt(MakeRandomNv12Image(80, 60).release()).At(Timestamp(0));
+  auto rgb_image = std::make_shared<ImageFrame>(ImageFormat::SRGB, 80, 60);
+  MP_ASSERT_OK(YUVImageSampler(yuv_packet.Get<YUVImage>())
+                   .ConvertRegion(0, 0, rgb_image.get()));
+  std::vector<mediapipe::NormalizedRect> rects(2);
+  rects[0].set_x_center(0.4f);
+  rects[0].set_y_center(0.6f);
+  rects[0].set_width(0.5f);
+  rects[0].set_height(0.7f);
+  rects[0].set_rotation(M_PI * 30.0f / 180.0f);
+  rects[1].set_x_center(0.9f);
+  rects[1].set_y_center(0.1f);
+  rects[1].set_width(0.6f);
+  rects[1].set_height(0.3f);
+  const Packet rects_packet =
+      MakePacket<std::vector<mediapipe::NormalizedRect>>(rects).At(
+          Timestamp(0));
+
+  const std::vector<Packet> yuv_packets = RunWithRects(
+      "NORM_RECTS", yuv_packet, rects_packet,
+      ImageToTensorCalculatorOptions::CPU_CONVERTER_FUSED, "IMAGE_YUV");
+  const std::vector<Packet> rgb_packets = RunWithRects(
+      "NORM_RECTS",
+      MakePacket<mediapipe::Image>(rgb_image).At(Timestamp(0)), rects_packet,
+      ImageToTensorCalculatorOptions::CPU_CONVERTER_FUSED);
+  ASSERT_THAT(yuv_packets, testing::SizeIs(2));
+  ASSERT_THAT(rgb_packets, testing::SizeIs(2));
+  const Tensor& yuv_tensor = yuv_packets[0].Get<std::vector<Tensor>>().front();
+  const Tensor& rgb_tensor = rgb_packets[0].Get<std::vector<Tensor>>().front();
+  ASSERT_EQ(yuv_tensor.shape().dims, rgb_tensor.shape().dims);
+  auto yuv_view = yuv_tensor.GetCpuReadView();
+  auto rgb_view = rgb_tensor.GetCpuReadView();
+  // Without clamping, interpolating before or after the color conversion only
+  // differs by rounding.
+  for (int i = 0; i < yuv_tensor.shape().num_elements(); ++i) {
+    EXPECT_NEAR(yuv_view.buffer<float>()[i], rgb_view.buffer<float>()[i],
+                2.0f / 255.0f)
+        << i;
+  }
+}
+
+// Converts a rotated ROI of a 640x480 RGBA frame into a square float tensor of
+// the given size, as for palm or face detection.
+void RunConverterBenchmark(benchmark::State& state,
+                           ImageToTensorConverter* converter) {
+  const int tensor_size = state.range(0);
+  cv::Mat input(480, 640, CV_8UC4);
+  cv::randu(input, cv::Scalar::all(0), cv::Scalar::all(255));
+  mediapipe::Image image(std::make_shared<mediapipe::ImageFrame>(
+      ImageFormat::SRGBA, input.cols, input.rows, input.step, input.data,
+      [](uint8*) {}));
+  const RotatedRect roi{/*center_x=*/320.0f, /*center_y=*/240.0f,
+                        /*width=*/300.0f, /*height=*/300.0f,
+                        /*rotation=*/0.3f};
+  for (auto _ : state) {
+    auto tensor =
+        converter->Convert(image, roi, {tensor_size, tensor_size},
+                           /*range_min=*/-1.0f, /*range_max=*/1.0f);
+    benchmark::DoNotOptimize(tensor);
+  }
+}
+
+void BM_OpenCvConverter(benchmark::State& state) {
+  auto converter = CreateOpenCvConverter(/*cc=*/nullptr, BorderMode::kZero,
+                                         Tensor::ElementType::kFloat32);
+  RunConverterBenchmark(state, converter.value().get());
+}
+BENCHMARK(BM_OpenCvConverter)->Arg(128)->Arg(256);
+
+void BM_FusedConverter(benchmark::State& state) {
+  auto converter = CreateFusedConverter(/*cc=*/nullptr, BorderMode::kZero,
+                                        Tensor::ElementType::kFloat32);
+  RunConverterBenchmark(state, converter.value().get());
+}
+BENCHMARK(BM_FusedConverter)->Arg(128)->Arg(256);
+
+// Converts a ROI of a 1920x1080 NV12 frame into a 256x256 float tensor, either
+// directly or after converting the whole frame to RGB.
+void BM_YuvImageToTensor(benchmark::State& state) {
+  const bool convert_frame = state.range(0);
+  auto yuv_image = MakeRandomNv12Image(1920, 1080);
+  auto converter = CreateFusedConverter(/*cc=*/nullptr, BorderMode::kZero,
+                                        Tensor::ElementType::kFloat32);
+  const RotatedRect roi{/*center_x=*/960.0f, /*center_y=*/540.0f,
+                        /*width=*/400.0f, /*height=*/400.0f,
+                        /*rotation=*/0.3f};
+  const Size output_dims{256, 256};
+  for (auto _ : state) {
+    if (convert_frame) {
+      auto frame = std::make_shared<ImageFrame>(ImageFormat::SRGB, 1920, 1080);
+      YUVImageSampler(*yuv_image)
+          .ConvertRegion(0, 0, frame.get())
+          .IgnoreError();
+      auto tensor = converter.value()->Convert(mediapipe::Image(frame), roi,
+                                               output_dims, -1.0f, 1.0f);
+      benchmark::DoNotOptimize(tensor);
+    } else {
+      auto tensor =
+          ConvertYuvImageToTensor(*yuv_image, {roi}, output_dims, -1.0f, 1.0f,
+                                  BorderMode::kZero,
+                                  Tensor::ElementType::kFloat32);
+      benchmark::DoNotOptimize(tensor);
+    }
+  }
+}
+BENCHMARK(BM_YuvImageToTensor)->Arg(0)->Arg(1);
+
 }  // namespace
 }  // namespace mediapipe
@@ -15,6 +15,9 @@
 #ifndef MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_H_
 #define MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_H_
 
+#include <cstring>
+#include <vector>
+
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
 #include "mediapipe/framework/formats/image.h"
 #include "mediapipe/framework/formats/tensor.h"
@@ -49,6 +52,38 @@ class ImageToTensorConverter {
                                          const RotatedRect& roi,
                                          const Size& output_dims,
                                          float range_min, float range_max) = 0;
+
+  // Converts several regions of the same image into a single tensor of shape
+  // [N, H, W, C], where N is the number of @rois. Arguments are the same as
+  // for Convert().
+  // The default implementation converts every region separately and copies
+  // the results into the batched tensor. Converters which can share work
+  // between regions should override it.
+  virtual absl::StatusOr<Tensor> ConvertBatch(
+      const mediapipe::Image& input, const std::vector<RotatedRect>& rois,
+      const Size& output_dims, float range_min, float range_max) {
+    if (rois.empty()) {
+      return absl::InvalidArgumentError("At least one ROI is required.");
+    }
+    std::vector<Tensor> tensors;
+    tensors.reserve(rois.size());
+    for (const RotatedRect& roi : rois) {
+      auto tensor = Convert(input, roi, output_dims, range_min, range_max);
+      if (!tensor.ok()) return tensor.status();
+      tensors.push_back(std::move(tensor).value());
+    }
+    Tensor::Shape shape = tensors[0].shape();
+    shape.dims[0] = static_cast<int>(rois.size());
+    Tensor batch(tensors[0].element_type(), shape);
+    auto batch_view = batch.GetCpuWriteView();
+    char* output = batch_view.buffer<char>();
+    for (const Tensor& tensor : tensors) {
+      auto view = tensor.GetCpuReadView();
+      std::memcpy(output, view.buffer<char>(), tensor.bytes());
+      output += tensor.bytes();
+    }
+    return batch;
+  }
 };
 
 }  // namespace mediapipe
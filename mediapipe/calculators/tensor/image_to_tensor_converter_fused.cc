@@ -0,0 +1,471 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensor/image_to_tensor_converter_fused.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+#include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/yuv_image.h"
+#include "mediapipe/framework/port/canonical_errors.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/util/yuv_image_sampler.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDIAPIPE_FUSED_CONVERTER_NEON 1
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// The four channels of a pixel, as floats. Pixels with three channels are
+// loaded with a zero fourth channel, which is dropped when storing.
+#if defined(__SSE2__)
+using Vec4 = __m128;
+
+inline Vec4 Splat(float value) { return _mm_set1_ps(value); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+inline Vec4 LoadRgb(const float* rgb) {
+  return _mm_setr_ps(rgb[0], rgb[1], rgb[2], 0.0f);
+}
+
+template <int kChannels>
+inline Vec4 LoadPixel(const uint8_t* pixel) {
+  int32_t bytes = 0;
+  std::memcpy(&bytes, pixel, kChannels);
+  const __m128i zero = _mm_setzero_si128();
+  __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero);
+  v = _mm_unpacklo_epi16(v, zero);
+  return _mm_cvtepi32_ps(v);
+}
+
+inline void StorePixel(Vec4 v, float* out) { _mm_storeu_ps(out, v); }
+
+// Rounds to the nearest integer, ties to even, and saturates.
+inline void StorePixel(Vec4 v, uint8_t* out) {
+  __m128i i = _mm_cvtps_epi32(v);
+  i = _mm_packs_epi32(i, i);
+  i = _mm_packus_epi16(i, i);
+  const int32_t bytes = _mm_cvtsi128_si32(i);
+  std::memcpy(out, &bytes, 4);
+}
+
+inline void StorePixel(Vec4 v, int8_t* out) {
+  __m128i i = _mm_cvtps_epi32(v);
+  i = _mm_packs_epi32(i, i);
+  i = _mm_packs_epi16(i, i);
+  const int32_t bytes = _mm_cvtsi128_si32(i);
+  std::memcpy(out, &bytes, 4);
+}
+#elif MEDIAPIPE_FUSED_CONVERTER_NEON
+using Vec4 = float32x4_t;
+
+inline Vec4 Splat(float value) { return vdupq_n_f32(value); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+inline Vec4 LoadRgb(const float* rgb) {
+  const float values[4] = {rgb[0], rgb[1], rgb[2], 0.0f};
+  return vld1q_f32(values);
+}
+
+template <int kChannels>
+inline Vec4 LoadPixel(const uint8_t* pixel) {
+  uint32_t bytes = 0;
+  std::memcpy(&bytes, pixel, kChannels);
+  const uint16x8_t v = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(bytes)));
+  return vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+}
+
+inline void StorePixel(Vec4 v, float* out) { vst1q_f32(out, v); }
+
+// Rounds to the nearest integer, ties to even, and saturates.
+inline void StorePixel(Vec4 v, uint8_t* out) {
+  const int16x4_t i = vqmovn_s32(vcvtnq_s32_f32(v));
+  const uint8x8_t u = vqmovun_s16(vcombine_s16(i, i));
+  const uint32_t bytes = vget_lane_u32(vreinterpret_u32_u8(u), 0);
+  std::memcpy(out, &bytes, 4);
+}
+
+inline void StorePixel(Vec4 v, int8_t* out) {
+  const int16x4_t i = vqmovn_s32(vcvtnq_s32_f32(v));
+  const int8x8_t s = vqmovn_s16(vcombine_s16(i, i));
+  const uint32_t bytes = vget_lane_u32(vreinterpret_u32_s8(s), 0);
+  std::memcpy(out, &bytes, 4);
+}
+#else
+struct Vec4 {
+  float v[4];
+};
+
+inline Vec4 Splat(float value) { return {{value, value, value, value}}; }
+inline Vec4 Add(Vec4 a, Vec4 b) {
+  return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+inline Vec4 Sub(Vec4 a, Vec4 b) {
+  return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]}};
+}
+inline Vec4 Mul(Vec4 a, Vec4 b) {
+  return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]}};
+}
+inline Vec4 LoadRgb(const float* rgb) {
+  return {{rgb[0], rgb[1], rgb[2], 0.0f}};
+}
+
+template <int kChannels>
+inline Vec4 LoadPixel(const uint8_t* pixel) {
+  Vec4 result = Splat(0.0f);
+  for (int c = 0; c < kChannels; ++c) {
+    result.v[c] = pixel[c];
+  }
+  return result;
+}
+
+inline void StorePixel(Vec4 v, float* out) { std::memcpy(out, v.v, 16); }
+
+// Rounds to the nearest integer, ties to even, and saturates.
+inline void StorePixel(Vec4 v, uint8_t* out) {
+  for (int c = 0; c < 4; ++c) {
+    out[c] = std::min(std::max(std::nearbyint(v.v[c]), 0.0f), 255.0f);
+  }
+}
+
+inline void StorePixel(Vec4 v, int8_t* out) {
+  for (int c = 0; c < 4; ++c) {
+    out[c] = std::min(std::max(std::nearbyint(v.v[c]), -128.0f), 127.0f);
+  }
+}
+#endif  // defined(__SSE2__)
+
+// Stores the first three channels only, for the last pixel of the tensor.
+template <typename T>
+inline void StoreLastPixel(Vec4 v, T* out) {
+  T pixel[4];
+  StorePixel(v, pixel);
+  std::memcpy(out, pixel, 3 * sizeof(T));
+}
+
+// Reads input pixels with bilinear interpolation.
+template <int kChannels, BorderMode kBorderMode>
+class BilinearSampler {
+ public:
+  explicit BilinearSampler(const ImageFrame& image)
+      : data_(image.PixelData()),
+        width_(image.Width()),
+        height_(image.Height()),
+        step_(image.WidthStep()) {}
+
+  // Returns the pixel value at (x, y), where (0, 0) is the center of the top
+  // left pixel.
+  inline Vec4 Sample(float x, float y) const {
+    // Far outside the image, all taps are replaced by the border value.
+    x = std::min(std::max(x, -2.0f), width_ + 1.0f);
+    y = std::min(std::max(y, -2.0f), height_ + 1.0f);
+    // Truncation rounds down the non-negative shifted coordinates, which is
+    // much cheaper than std::floor without SSE4.1.
+    const int x0 = static_cast<int>(x + 2.0f) - 2;
+    const int y0 = static_cast<int>(y + 2.0f) - 2;
+    Vec4 p00, p01, p10, p11;
+    if (x0 >= 0 && y0 >= 0 && x0 < width_ - 1 && y0 < height_ - 1) {
+      const uint8_t* pixel = data_ + y0 * step_ + x0 * kChannels;
+      p00 = LoadPixel<kChannels>(pixel);
+      p01 = LoadPixel<kChannels>(pixel + kChannels);
+      p10 = LoadPixel<kChannels>(pixel + step_);
+      p11 = LoadPixel<kChannels>(pixel + step_ + kChannels);
+    } else {
+      p00 = Tap(x0, y0);
+      p01 = Tap(x0 + 1, y0);
+      p10 = Tap(x0, y0 + 1);
+      p11 = Tap(x0 + 1, y0 + 1);
+    }
+    const Vec4 wx = Splat(x - x0);
+    const Vec4 top = Add(p00, Mul(Sub(p01, p00), wx));
+    const Vec4 bottom = Add(p10, Mul(Sub(p11, p10), wx));
+    return Add(top, Mul(Sub(bottom, top), Splat(y - y0)));
+  }
+
+ private:
+  // Returns the pixel at (x, y), extrapolated according to the border mode.
+  inline Vec4 Tap(int x, int y) const {
+    if (kBorderMode == BorderMode::kReplicate) {
+      x = std::min(std::max(x, 0), width_ - 1);
+      y = std::min(std::max(y, 0), height_ - 1);
+    } else if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+      return Splat(0.0f);
+    }
+    return LoadPixel<kChannels>(data_ + y * step_ + x * kChannels);
+  }
+
+  const uint8_t* data_;
+  int width_;
+  int height_;
+  int step_;
+};
+
+// Reads the pixels of a YUV image with bilinear interpolation, converting
+// them to RGB.
+template <BorderMode kBorderMode>
+class YuvBilinearSampler {
+ public:
+  explicit YuvBilinearSampler(const YUVImageSampler& sampler)
+      : sampler_(sampler) {}
+
+  inline Vec4 Sample(float x, float y) const {
+    float rgb[3];
+    sampler_.SampleBilinear(x, y, kBorderMode == BorderMode::kReplicate, rgb);
+    return LoadRgb(rgb);
+  }
+
+ private:
+  const YUVImageSampler& sampler_;
+};
+
+// Maps tensor element (x, y) to image position origin + x * dx + y * dy.
+struct SampleGrid {
+  float origin_x;
+  float origin_y;
+  float dx_x;
+  float dx_y;
+  float dy_x;
+  float dy_y;
+};
+
+// Maps the tensor corners to the ROI corners, in the same way as the
+// perspective transform computed by the OpenCV converter.
+SampleGrid GetSampleGrid(const RotatedRect& roi, const Size& output_dims) {
+  const float cos_r = std::cos(roi.rotation);
+  const float sin_r = std::sin(roi.rotation);
+  SampleGrid grid;
+  grid.origin_x =
+      roi.center_x - 0.5f * cos_r * roi.width + 0.5f * sin_r * roi.height;
+  grid.origin_y =
+      roi.center_y - 0.5f * sin_r * roi.width - 0.5f * cos_r * roi.height;
+  grid.dx_x = cos_r * roi.width / output_dims.width;
+  grid.dx_y = sin_r * roi.width / output_dims.width;
+  grid.dy_x = -sin_r * roi.height / output_dims.height;
+  grid.dy_y = cos_r * roi.height / output_dims.height;
+  return grid;
+}
+
+// Samples, normalizes and stores every pixel of the tensor in one pass.
+template <typename T, typename Sampler>
+void ConvertPixels(const Sampler& sampler, const SampleGrid& grid,
+                   const Size& output_dims, float scale, float offset,
+                   T* output) {
+  constexpr int kNumChannels = 3;
+  const Vec4 scale_vec = Splat(scale);
+  const Vec4 offset_vec = Splat(offset);
+  for (int y = 0; y < output_dims.height; ++y) {
+    const float row_x = grid.origin_x + y * grid.dy_x;
+    const float row_y = grid.origin_y + y * grid.dy_y;
+    for (int x = 0; x < output_dims.width; ++x) {
+      const Vec4 value =
+          Add(Mul(sampler.Sample(row_x + x * grid.dx_x, row_y + x * grid.dx_y),
+                  scale_vec),
+              offset_vec);
+      // All four channels are stored, the fourth one is overwritten by the
+      // next pixel. Only the last pixel needs to stay within the tensor.
+      if (y == output_dims.height - 1 && x == output_dims.width - 1) {
+        StoreLastPixel(value, output);
+      } else {
+        StorePixel(value, output);
+      }
+      output += kNumChannels;
+    }
+  }
+}
+
+template <typename T, int kChannels, BorderMode kBorderMode>
+void ConvertPixels(const ImageFrame& image, const SampleGrid& grid,
+                   const Size& output_dims, float scale, float offset,
+                   T* output) {
+  ConvertPixels(BilinearSampler<kChannels, kBorderMode>(image), grid,
+                output_dims, scale, offset, output);
+}
+
+template <typename T>
+void ConvertPixels(const ImageFrame& image, BorderMode border_mode,
+                   const SampleGrid& grid, const Size& output_dims,
+                   float scale, float offset, T* output) {
+  const bool has_alpha = image.NumberOfChannels() == 4;
+  if (border_mode == BorderMode::kReplicate) {
+    if (has_alpha) {
+      ConvertPixels<T, 4, BorderMode::kReplicate>(image, grid, output_dims,
+                                                  scale, offset, output);
+    } else {
+      ConvertPixels<T, 3, BorderMode::kReplicate>(image, grid, output_dims,
+                                                  scale, offset, output);
+    }
+  } else {
+    if (has_alpha) {
+      ConvertPixels<T, 4, BorderMode::kZero>(image, grid, output_dims, scale,
+                                             offset, output);
+    } else {
+      ConvertPixels<T, 3, BorderMode::kZero>(image, grid, output_dims, scale,
+                                             offset, output);
+    }
+  }
+}
+
+template <typename T>
+void ConvertPixels(const YUVImageSampler& sampler, BorderMode border_mode,
+                   const SampleGrid& grid, const Size& output_dims,
+                   float scale, float offset, T* output) {
+  if (border_mode == BorderMode::kReplicate) {
+    ConvertPixels(YuvBilinearSampler<BorderMode::kReplicate>(sampler), grid,
+                  output_dims, scale, offset, output);
+  } else {
+    ConvertPixels(YuvBilinearSampler<BorderMode::kZero>(sampler), grid,
+                  output_dims, scale, offset, output);
+  }
+}
+
+bool IsSupportedTensorType(Tensor::ElementType tensor_type) {
+  return tensor_type == Tensor::ElementType::kInt8 ||
+         tensor_type == Tensor::ElementType::kFloat32 ||
+         tensor_type == Tensor::ElementType::kUInt8;
+}
+
+// Extracts every region of "image", an ImageFrame or a YUVImageSampler, into
+// its slice of a batched tensor.
+template <typename Image>
+absl::StatusOr<Tensor> ConvertRois(const Image& image, BorderMode border_mode,
+                                   const std::vector<RotatedRect>& rois,
+                                   const Size& output_dims, float range_min,
+                                   float range_max,
+                                   Tensor::ElementType tensor_type) {
+  if (rois.empty()) {
+    return InvalidArgumentError("At least one ROI is required.");
+  }
+  constexpr float kInputImageRangeMin = 0.0f;
+  constexpr float kInputImageRangeMax = 255.0f;
+  ASSIGN_OR_RETURN(
+      auto transform,
+      GetValueRangeTransformation(kInputImageRangeMin, kInputImageRangeMax,
+                                  range_min, range_max));
+
+  constexpr int kNumChannels = 3;
+  const int num_rois = static_cast<int>(rois.size());
+  Tensor tensor(tensor_type, Tensor::Shape{num_rois, output_dims.height,
+                                           output_dims.width, kNumChannels});
+  auto buffer_view = tensor.GetCpuWriteView();
+  const int slice_size = output_dims.height * output_dims.width * kNumChannels;
+  for (int i = 0; i < num_rois; ++i) {
+    const SampleGrid grid = GetSampleGrid(rois[i], output_dims);
+    const int offset = i * slice_size;
+    switch (tensor_type) {
+      case Tensor::ElementType::kInt8:
+        ConvertPixels(image, border_mode, grid, output_dims, transform.scale,
+                      transform.offset, buffer_view.buffer<int8_t>() + offset);
+        break;
+      case Tensor::ElementType::kUInt8:
+        ConvertPixels(image, border_mode, grid, output_dims, transform.scale,
+                      transform.offset, buffer_view.buffer<uint8_t>() + offset);
+        break;
+      default:
+        ConvertPixels(image, border_mode, grid, output_dims, transform.scale,
+                      transform.offset, buffer_view.buffer<float>() + offset);
+        break;
+    }
+  }
+  return tensor;
+}
+
+class FusedProcessor : public ImageToTensorConverter {
+ public:
+  FusedProcessor(BorderMode border_mode, Tensor::ElementType tensor_type)
+      : border_mode_(border_mode), tensor_type_(tensor_type) {}
+
+  absl::StatusOr<Tensor> Convert(const mediapipe::Image& input,
+                                 const RotatedRect& roi,
+                                 const Size& output_dims, float range_min,
+                                 float range_max) override {
+    return ConvertBatch(input, {roi}, output_dims, range_min, range_max);
+  }
+
+  // Validates and reads the image and computes the value transformation once
+  // for all regions, which are written directly into their batch slices.
+  absl::StatusOr<Tensor> ConvertBatch(const mediapipe::Image& input,
+                                      const std::vector<RotatedRect>& rois,
+                                      const Size& output_dims, float range_min,
+                                      float range_max) override {
+    if (input.image_format() != mediapipe::ImageFormat::SRGB &&
+        input.image_format() != mediapipe::ImageFormat::SRGBA) {
+      return InvalidArgumentError(
+          absl::StrCat("Only RGBA/RGB formats are supported, passed format: ",
+                       static_cast<uint32_t>(input.image_format())));
+    }
+    return ConvertRois(*input.GetImageFrameSharedPtr(), border_mode_, rois,
+                       output_dims, range_min, range_max, tensor_type_);
+  }
+
+ private:
+  BorderMode border_mode_;
+  Tensor::ElementType tensor_type_;
+};
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<ImageToTensorConverter>> CreateFusedConverter(
+    CalculatorContext* cc, BorderMode border_mode,
+    Tensor::ElementType tensor_type) {
+  if (!IsSupportedTensorType(tensor_type)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Tensor type is currently not supported by FusedProcessor, type: ",
+        static_cast<int>(tensor_type)));
+  }
+  return absl::make_unique<FusedProcessor>(border_mode, tensor_type);
+}
+
+absl::StatusOr<Tensor> ConvertYuvImageToTensor(
+    const YUVImage& image, const std::vector<RotatedRect>& rois,
+    const Size& output_dims, float range_min, float range_max,
+    BorderMode border_mode, Tensor::ElementType tensor_type) {
+  if (!YUVImageSampler::IsSupported(image)) {
+    return InvalidArgumentError(absl::StrCat(
+        "Only 8-bit I420, NV12 and NV21 YUV images are supported, passed "
+        "fourcc: ",
+        static_cast<uint32_t>(image.fourcc()), ", bit depth: ",
+        image.bit_depth()));
+  }
+  if (!IsSupportedTensorType(tensor_type)) {
+    return InvalidArgumentError(absl::StrCat(
+        "Tensor type is currently not supported for YUV images, type: ",
+        static_cast<int>(tensor_type)));
+  }
+  return ConvertRois(YUVImageSampler(image), border_mode, rois, output_dims,
+                     range_min, range_max, tensor_type);
+}
+
+}  // namespace mediapipe
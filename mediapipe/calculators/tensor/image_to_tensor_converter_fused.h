@@ -0,0 +1,51 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_FUSED_H_
+#define MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_FUSED_H_
+
+#include <memory>
+#include <vector>
+
+#include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/yuv_image.h"
+#include "mediapipe/framework/port/statusor.h"
+
+namespace mediapipe {
+
+// Creates a CPU image-to-tensor converter which does not depend on OpenCV.
+// For every tensor element, it samples the rotated ROI bilinearly, drops the
+// alpha channel and converts the value range in a single pass, writing
+// directly into the tensor buffer. Uses SSE2 or NEON when available.
+// @tensor_type is the element type of the output tensor: kFloat32, kUInt8 or
+// kInt8.
+absl::StatusOr<std::unique_ptr<ImageToTensorConverter>> CreateFusedConverter(
+    CalculatorContext* cc, BorderMode border_mode,
+    Tensor::ElementType tensor_type);
+
+// Extracts @rois from a YUV image into a tensor of shape [N, height, width, 3],
+// in the same way as the fused converter does from an RGB image. Sampled
+// pixels are converted to RGB on the fly, so the image is never converted as
+// a whole. Supports the formats of YUVImageSampler. Other arguments are as for
+// ImageToTensorConverter::ConvertBatch() and CreateFusedConverter().
+absl::StatusOr<Tensor> ConvertYuvImageToTensor(
+    const YUVImage& image, const std::vector<RotatedRect>& rois,
+    const Size& output_dims, float range_min, float range_max,
+    BorderMode border_mode, Tensor::ElementType tensor_type);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TENSOR_IMAGE_TO_TENSOR_CONVERTER_FUSED_H_
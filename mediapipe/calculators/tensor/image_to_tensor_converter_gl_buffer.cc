@@ -53,12 +53,13 @@ namespace {
 class SubRectExtractorGl {
  public:
   // Extracts a region defined by @sub_rect, removes A channel, transforms input
-  // pixels as alpha * x + beta and resizes result into destination.
+  // pixels as alpha * x + beta and resizes result into destination, starting
+  // at the float element @destination_offset.
   absl::Status ExtractSubRectToBuffer(
       const tflite::gpu::gl::GlTexture& texture,
       const tflite::gpu::HW& texture_size, const RotatedRect& sub_rect,
       bool flip_horizontaly, float alpha, float beta,
-      const tflite::gpu::HW& destination_size,
+      const tflite::gpu::HW& destination_size, int destination_offset,
       tflite::gpu::gl::CommandQueue* command_queue,
       tflite::gpu::gl::GlBuffer* destination);
 
@@ -107,6 +108,7 @@ layout(binding = 0) writeonly buffer B0 {
 } output_data;
 
 uniform ivec2 out_size;
+uniform int out_offset;
 uniform float alpha;
 uniform float beta;
 uniform mat4 transform_matrix;
@@ -144,7 +146,7 @@ void main() {
     int linear_index = gid.y * out_width + gid.x;
 
     // output_data.elements is populated as though it contains vec3 elements.
-    int first_component_index = 3 * linear_index;
+    int first_component_index = out_offset + 3 * linear_index;
     output_data.elements[first_component_index] = src_value.r;
     output_data.elements[first_component_index + 1] = src_value.g;
     output_data.elements[first_component_index + 2] = src_value.b;
@@ -155,7 +157,7 @@ absl::Status SubRectExtractorGl::ExtractSubRectToBuffer(
     const tflite::gpu::gl::GlTexture& texture,
     const tflite::gpu::HW& texture_size, const RotatedRect& texture_sub_rect,
     bool flip_horizontaly, float alpha, float beta,
-    const tflite::gpu::HW& destination_size,
+    const tflite::gpu::HW& destination_size, int destination_offset,
     tflite::gpu::gl::CommandQueue* command_queue,
     tflite::gpu::gl::GlBuffer* destination) {
   std::array<float, 16> transform_mat;
@@ -192,6 +194,8 @@ absl::Status SubRectExtractorGl::ExtractSubRectToBuffer(
       SetMat4x4(program_, "transform_matrix", transform_mat.data()));
   MP_RETURN_IF_ERROR(program_.SetParameter(
       {"out_size", tflite::gpu::int2(destination_size.w, destination_size.h)}));
+  MP_RETURN_IF_ERROR(
+      program_.SetParameter({"out_offset", destination_offset}));
   MP_RETURN_IF_ERROR(program_.SetParameter({"alpha", alpha}));
   MP_RETURN_IF_ERROR(program_.SetParameter({"beta", beta}));
   tflite::gpu::uint3 num_workgroups = tflite::gpu::DivideRoundUp(
@@ -268,17 +272,28 @@ class GlProcessor : public ImageToTensorConverter {
                                  const RotatedRect& roi,
                                  const Size& output_dims, float range_min,
                                  float range_max) override {
+    return ConvertBatch(input, {roi}, output_dims, range_min, range_max);
+  }
+
+  // Binds the input texture and the output buffer once, and writes each roi
+  // into its slice of the output buffer.
+  absl::StatusOr<Tensor> ConvertBatch(const mediapipe::Image& input,
+                                      const std::vector<RotatedRect>& rois,
+                                      const Size& output_dims, float range_min,
+                                      float range_max) override {
     if (input.format() != mediapipe::GpuBufferFormat::kBGRA32) {
       return InvalidArgumentError(
           absl::StrCat("Only BGRA/RGBA textures are supported, passed format: ",
                        static_cast<uint32_t>(input.format())));
     }
+    RET_CHECK(!rois.empty()) << "At least one ROI is required.";
 
     constexpr int kNumChannels = 3;
     Tensor tensor(Tensor::ElementType::kFloat32,
-                  {1, output_dims.height, output_dims.width, kNumChannels});
+                  {static_cast<int>(rois.size()), output_dims.height,
+                   output_dims.width, kNumChannels});
 
-    MP_RETURN_IF_ERROR(gl_helper_.RunInGlContext([this, &tensor, &input, &roi,
+    MP_RETURN_IF_ERROR(gl_helper_.RunInGlContext([this, &tensor, &input, &rois,
                                                   &output_dims, range_min,
                                                   range_max]() -> absl::Status {
       constexpr int kRgbaNumChannels = 4;
@@ -302,12 +317,18 @@ class GlProcessor : public ImageToTensorConverter {
                                        buffer_view.name(), tensor.bytes(),
                                        /*offset=*/0,
                                        /*has_ownership=*/false);
-      MP_RETURN_IF_ERROR(extractor_->ExtractSubRectToBuffer(
-          input_texture,
-          tflite::gpu::HW(source_texture.height(), source_texture.width()), roi,
-          /*flip_horizontaly=*/false, transform.scale, transform.offset,
-          tflite::gpu::HW(output_dims.height, output_dims.width),
-          command_queue_.get(), &output));
+      const int slice_size =
+          output_dims.height * output_dims.width * kNumChannels;
+      for (int i = 0; i < rois.size(); ++i) {
+        MP_RETURN_IF_ERROR(extractor_->ExtractSubRectToBuffer(
+            input_texture,
+            tflite::gpu::HW(source_texture.height(), source_texture.width()),
+            rois[i],
+            /*flip_horizontaly=*/false, transform.scale, transform.offset,
+            tflite::gpu::HW(output_dims.height, output_dims.width),
+            /*destination_offset=*/i * slice_size, command_queue_.get(),
+            &output));
+      }
 
       return absl::OkStatus();
     }));
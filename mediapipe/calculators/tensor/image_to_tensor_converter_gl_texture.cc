@@ -172,20 +172,39 @@ class GlProcessor : public ImageToTensorConverter {
                                  const RotatedRect& roi,
                                  const Size& output_dims, float range_min,
                                  float range_max) override {
+    return ConvertBatch(input, {roi}, output_dims, range_min, range_max);
+  }
+
+  // Creates the input texture once, and renders each roi into its rows of the
+  // output texture.
+  absl::StatusOr<Tensor> ConvertBatch(const mediapipe::Image& input,
+                                      const std::vector<RotatedRect>& rois,
+                                      const Size& output_dims, float range_min,
+                                      float range_max) override {
     if (input.format() != mediapipe::GpuBufferFormat::kBGRA32) {
       return InvalidArgumentError(
           absl::StrCat("Only BGRA/RGBA textures are supported, passed format: ",
                        static_cast<uint32_t>(input.format())));
     }
+    RET_CHECK(!rois.empty()) << "At least one ROI is required.";
 
     constexpr int kNumChannels = 3;
-    Tensor tensor(
-        Tensor::ElementType::kFloat32,
-        Tensor::Shape{1, output_dims.height, output_dims.width, kNumChannels});
+    Tensor tensor(Tensor::ElementType::kFloat32,
+                  Tensor::Shape{static_cast<int>(rois.size()),
+                                output_dims.height, output_dims.width,
+                                kNumChannels});
 
     MP_RETURN_IF_ERROR(
-        gl_helper_.RunInGlContext([this, &tensor, &input, &roi, &output_dims,
+        gl_helper_.RunInGlContext([this, &tensor, &input, &rois, &output_dims,
                                    range_min, range_max]() -> absl::Status {
+          // With the aligned layout each roi takes output_dims.height rows.
+          int texture_width;
+          int texture_height;
+          RET_CHECK(Tensor::OpenGlTexture2dView::GetLayoutDimensions(
+                        tensor.shape(), &texture_width, &texture_height) ==
+                    Tensor::OpenGlTexture2dView::Layout::kAligned)
+              << "Too many ROIs to fit into one texture: " << rois.size();
+
           auto input_texture = gl_helper_.CreateSourceTexture(input);
 
           constexpr float kInputImageRangeMin = 0.0f;
@@ -195,26 +214,31 @@ class GlProcessor : public ImageToTensorConverter {
                                                        kInputImageRangeMax,
                                                        range_min, range_max));
           auto tensor_view = tensor.GetOpenGlTexture2dWriteView();
-          MP_RETURN_IF_ERROR(ExtractSubRect(input_texture, roi,
-                                            /*flip_horizontaly=*/false,
-                                            transform.scale, transform.offset,
-                                            output_dims, &tensor_view));
+          for (int i = 0; i < rois.size(); ++i) {
+            MP_RETURN_IF_ERROR(ExtractSubRect(
+                input_texture, rois[i],
+                /*flip_horizontaly=*/false, transform.scale, transform.offset,
+                output_dims, /*output_row=*/i * output_dims.height,
+                &tensor_view));
+          }
           return absl::OkStatus();
         }));
 
     return tensor;
   }
 
+  // Renders @sub_rect into the @output_dims rows of @output starting at
+  // @output_row.
   absl::Status ExtractSubRect(const mediapipe::GlTexture& texture,
                               const RotatedRect& sub_rect,
                               bool flip_horizontaly, float alpha, float beta,
-                              const Size& output_dims,
+                              const Size& output_dims, int output_row,
                               Tensor::OpenGlTexture2dView* output) {
     std::array<float, 16> transform_mat;
 
     glDisable(GL_DEPTH_TEST);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
-    glViewport(0, 0, output_dims.width, output_dims.height);
+    glViewport(0, output_row, output_dims.width, output_dims.height);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, output->name());
@@ -174,13 +174,23 @@ class SubRectExtractorMetal {
                             options:MTLResourceOptionCPUCacheModeDefault];
   }
 
+  // Renders @sub_rect into @destination starting at byte
+  // @destination_offset, which must meet the linear texture alignment of the
+  // output pixel format.
   absl::Status Execute(id<MTLTexture> input_texture,
                        const RotatedRect& sub_rect, bool flip_horizontaly,
                        float alpha, float beta,
                        const tflite::gpu::HW& destination_size,
                        id<MTLCommandBuffer> command_buffer,
-                       id<MTLBuffer> destination) {
-    auto output_texture = MTLTextureWithBuffer(destination_size, destination);
+                       id<MTLBuffer> destination,
+                       NSUInteger destination_offset) {
+    const NSUInteger alignment = [device_
+        minimumLinearTextureAlignmentForPixelFormat:GetPixelFormat(
+                                                        output_format_)];
+    RET_CHECK_EQ(destination_offset % alignment, 0)
+        << "Unaligned destination offset: " << destination_offset;
+    auto output_texture = MTLTextureWithBuffer(destination_size, destination,
+                                               destination_offset);
     return InternalExecute(input_texture, sub_rect, flip_horizontaly, alpha,
                            beta, destination_size, command_buffer,
                            output_texture);
@@ -188,7 +198,8 @@ class SubRectExtractorMetal {
 
  private:
   id<MTLTexture> MTLTextureWithBuffer(const tflite::gpu::HW& size,
-                                      id<MTLBuffer> buffer) {
+                                      id<MTLBuffer> buffer,
+                                      NSUInteger offset) {
     MTLTextureDescriptor* texture_desc = [MTLTextureDescriptor
         texture2DDescriptorWithPixelFormat:GetPixelFormat(output_format_)
                                      width:size.w
@@ -200,7 +211,7 @@ class SubRectExtractorMetal {
 
     id<MTLTexture> texture =
         [buffer newTextureWithDescriptor:texture_desc
-                                  offset:0
+                                  offset:offset
                              bytesPerRow:output_bytes_per_row];
     return texture;
   }
@@ -352,12 +363,22 @@ class MetalProcessor : public ImageToTensorConverter {
                                  const RotatedRect& roi,
                                  const Size& output_dims, float range_min,
                                  float range_max) override {
+    return ConvertBatch(input, {roi}, output_dims, range_min, range_max);
+  }
+
+  // Encodes all rois into one command buffer, each rendering into its slice
+  // of the output tensor buffer.
+  absl::StatusOr<Tensor> ConvertBatch(const mediapipe::Image& input,
+                                      const std::vector<RotatedRect>& rois,
+                                      const Size& output_dims, float range_min,
+                                      float range_max) override {
     if (input.format() != mediapipe::GpuBufferFormat::kBGRA32) {
       return InvalidArgumentError(
           absl::StrCat("Only BGRA/RGBA textures are supported, passed "
                        "format: ",
                        static_cast<uint32_t>(input.format())));
     }
+    RET_CHECK(!rois.empty()) << "At least one ROI is required.";
 
     @autoreleasepool {
       id<MTLTexture> texture =
@@ -365,7 +386,8 @@ class MetalProcessor : public ImageToTensorConverter {
 
       constexpr int kNumChannels = 4;
       Tensor tensor(Tensor::ElementType::kFloat32,
-                    Tensor::Shape{1, output_dims.height, output_dims.width,
+                    Tensor::Shape{static_cast<int>(rois.size()),
+                                  output_dims.height, output_dims.width,
                                   kNumChannels});
 
       constexpr float kInputImageRangeMin = 0.0f;
@@ -377,11 +399,14 @@ class MetalProcessor : public ImageToTensorConverter {
 
       id<MTLCommandBuffer> command_buffer = [metal_helper_ commandBuffer];
       const auto& buffer_view = tensor.GetMtlBufferWriteView(command_buffer);
-      MP_RETURN_IF_ERROR(extractor_->Execute(
-          texture, roi,
-          /*flip_horizontaly=*/false, transform.scale, transform.offset,
-          tflite::gpu::HW(output_dims.height, output_dims.width),
-          command_buffer, buffer_view.buffer()));
+      const NSUInteger slice_bytes = tensor.bytes() / rois.size();
+      for (int i = 0; i < rois.size(); ++i) {
+        MP_RETURN_IF_ERROR(extractor_->Execute(
+            texture, rois[i],
+            /*flip_horizontaly=*/false, transform.scale, transform.offset,
+            tflite::gpu::HW(output_dims.height, output_dims.width),
+            command_buffer, buffer_view.buffer(), i * slice_bytes));
+      }
       [command_buffer commit];
       return tensor;
     }
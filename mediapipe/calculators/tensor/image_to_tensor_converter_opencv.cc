@@ -16,6 +16,7 @@
 
 #include <cmath>
 #include <memory>
+#include <vector>
 
 #include "mediapipe/calculators/tensor/image_to_tensor_converter.h"
 #include "mediapipe/calculators/tensor/image_to_tensor_utils.h"
@@ -27,6 +28,7 @@
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
+#include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/statusor.h"
 
 namespace mediapipe {
@@ -35,7 +37,8 @@ namespace {
 
 class OpenCvProcessor : public ImageToTensorConverter {
  public:
-  OpenCvProcessor(BorderMode border_mode) {
+  OpenCvProcessor(BorderMode border_mode, Tensor::ElementType tensor_type)
+      : tensor_type_(tensor_type) {
     switch (border_mode) {
       case BorderMode::kReplicate:
         border_mode_ = cv::BORDER_REPLICATE;
@@ -44,36 +47,76 @@ class OpenCvProcessor : public ImageToTensorConverter {
         border_mode_ = cv::BORDER_CONSTANT;
         break;
     }
+    switch (tensor_type_) {
+      case Tensor::ElementType::kInt8:
+        mat_type_ = CV_8SC3;
+        break;
+      case Tensor::ElementType::kUInt8:
+        mat_type_ = CV_8UC3;
+        break;
+      default:
+        mat_type_ = CV_32FC3;
+        break;
+    }
   }
 
   absl::StatusOr<Tensor> Convert(const mediapipe::Image& input,
                                  const RotatedRect& roi,
                                  const Size& output_dims, float range_min,
                                  float range_max) override {
+    return ConvertBatch(input, {roi}, output_dims, range_min, range_max);
+  }
+
+  // Validates the input and computes the value transformation once, then
+  // converts every roi directly into its slice of the output tensor.
+  absl::StatusOr<Tensor> ConvertBatch(const mediapipe::Image& input,
+                                      const std::vector<RotatedRect>& rois,
+                                      const Size& output_dims, float range_min,
+                                      float range_max) override {
     if (input.image_format() != mediapipe::ImageFormat::SRGB &&
         input.image_format() != mediapipe::ImageFormat::SRGBA) {
       return InvalidArgumentError(
           absl::StrCat("Only RGBA/RGB formats are supported, passed format: ",
                        static_cast<uint32_t>(input.image_format())));
     }
+    RET_CHECK(!rois.empty()) << "At least one ROI is required.";
     cv::Mat src = mediapipe::formats::MatView(&input);
 
+    constexpr float kInputImageRangeMin = 0.0f;
+    constexpr float kInputImageRangeMax = 255.0f;
+    ASSIGN_OR_RETURN(
+        auto transform,
+        GetValueRangeTransformation(kInputImageRangeMin, kInputImageRangeMax,
+                                    range_min, range_max));
+
     constexpr int kNumChannels = 3;
-    Tensor tensor(
-        Tensor::ElementType::kFloat32,
-        Tensor::Shape{1, output_dims.height, output_dims.width, kNumChannels});
+    Tensor tensor(tensor_type_, Tensor::Shape{static_cast<int>(rois.size()),
+                                              output_dims.height,
+                                              output_dims.width, kNumChannels});
     auto buffer_view = tensor.GetCpuWriteView();
-    cv::Mat dst(output_dims.height, output_dims.width, CV_32FC3,
-                buffer_view.buffer<float>());
+    const int slice_bytes = tensor.bytes() / rois.size();
+    for (int i = 0; i < rois.size(); ++i) {
+      cv::Mat dst(output_dims.height, output_dims.width, mat_type_,
+                  buffer_view.buffer<char>() + i * slice_bytes);
+      ExtractSubRect(src, rois[i], transform.scale, transform.offset, &dst);
+    }
+    return tensor;
+  }
 
+ private:
+  // Warps @roi of @src into @dst, whose size is the output size, and maps
+  // values with @alpha * value + @beta.
+  void ExtractSubRect(const cv::Mat& src, const RotatedRect& roi, float alpha,
+                      float beta, cv::Mat* dst) {
+    constexpr int kNumChannels = 3;
     const cv::RotatedRect rotated_rect(cv::Point2f(roi.center_x, roi.center_y),
                                        cv::Size2f(roi.width, roi.height),
                                        roi.rotation * 180.f / M_PI);
     cv::Mat src_points;
     cv::boxPoints(rotated_rect, src_points);
 
-    const float dst_width = output_dims.width;
-    const float dst_height = output_dims.height;
+    const float dst_width = dst->cols;
+    const float dst_height = dst->rows;
     /* clang-format off */
     float dst_corners[8] = {0.0f,      dst_height,
                             0.0f,      0.0f,
@@ -96,25 +139,28 @@ class OpenCvProcessor : public ImageToTensorConverter {
       transformed = proper_channels_mat;
     }
 
-    constexpr float kInputImageRangeMin = 0.0f;
-    constexpr float kInputImageRangeMax = 255.0f;
-    ASSIGN_OR_RETURN(
-        auto transform,
-        GetValueRangeTransformation(kInputImageRangeMin, kInputImageRangeMax,
-                                    range_min, range_max));
-    transformed.convertTo(dst, CV_32FC3, transform.scale, transform.offset);
-    return tensor;
+    // For integer tensors, convertTo rounds and saturates the result.
+    transformed.convertTo(*dst, mat_type_, alpha, beta);
   }
 
- private:
   enum cv::BorderTypes border_mode_;
+  Tensor::ElementType tensor_type_;
+  int mat_type_;
 };
 
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<ImageToTensorConverter>> CreateOpenCvConverter(
-    CalculatorContext* cc, BorderMode border_mode) {
-  return absl::make_unique<OpenCvProcessor>(border_mode);
+    CalculatorContext* cc, BorderMode border_mode,
+    Tensor::ElementType tensor_type) {
+  if (tensor_type != Tensor::ElementType::kInt8 &&
+      tensor_type != Tensor::ElementType::kFloat32 &&
+      tensor_type != Tensor::ElementType::kUInt8) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Tensor type is currently not supported by OpenCvProcessor, type: ",
+        static_cast<int>(tensor_type)));
+  }
+  return absl::make_unique<OpenCvProcessor>(border_mode, tensor_type);
 }
 
 }  // namespace mediapipe
@@ -0,0 +1,270 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensor/inference_batching_service.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/port/status_macros.h"
+#include "tensorflow/lite/model.h"
+
+namespace mediapipe {
+
+const GraphService<InferenceBatchingService> kInferenceBatchingService(
+    "kInferenceBatchingService");
+
+namespace {
+
+absl::StatusOr<Tensor::ElementType> GetTensorElementType(TfLiteType type) {
+  switch (type) {
+    case kTfLiteFloat32:
+      return Tensor::ElementType::kFloat32;
+    case kTfLiteUInt8:
+      return Tensor::ElementType::kUInt8;
+    case kTfLiteInt8:
+      return Tensor::ElementType::kInt8;
+    case kTfLiteInt32:
+      return Tensor::ElementType::kInt32;
+    default:
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Unsupported TfLite tensor type: ", TfLiteTypeGetName(type)));
+  }
+}
+
+Tensor::QuantizationParameters GetQuantizationParameters(
+    const TfLiteTensor& tensor) {
+  if (tensor.type != kTfLiteUInt8 && tensor.type != kTfLiteInt8) {
+    return {};
+  }
+  return {tensor.params.scale, tensor.params.zero_point};
+}
+
+std::vector<int> TfLiteTensorDims(const TfLiteTensor& tensor) {
+  return {tensor.dims->data, tensor.dims->data + tensor.dims->size};
+}
+
+}  // namespace
+
+struct InferenceBatcher::Request {
+  explicit Request(const std::vector<Tensor>* inputs) : inputs(inputs) {}
+
+  const std::vector<Tensor>* inputs;
+  std::vector<Tensor> outputs;
+  absl::Status status;
+  bool done = false;
+};
+
+absl::StatusOr<std::unique_ptr<InferenceBatcher>> InferenceBatcher::Create(
+    api2::Packet<TfLiteModelPtr> model, const tflite::OpResolver& op_resolver,
+    const Options& options) {
+  RET_CHECK_GT(options.max_batch_size, 0);
+  std::unique_ptr<tflite::Interpreter> interpreter;
+  tflite::InterpreterBuilder(*model.Get(), op_resolver)(&interpreter);
+  RET_CHECK(interpreter);
+  interpreter->SetNumThreads(options.num_threads);
+  RET_CHECK_EQ(interpreter->AllocateTensors(), kTfLiteOk);
+  for (int tensor_index : interpreter->inputs()) {
+    const TfLiteTensor* tensor = interpreter->tensor(tensor_index);
+    RET_CHECK(tensor->dims->size > 0 && tensor->dims->data[0] == 1)
+        << "Batching requires a batch dimension of 1 for input "
+        << tensor->name;
+    MP_RETURN_IF_ERROR(GetTensorElementType(tensor->type).status());
+  }
+  for (int tensor_index : interpreter->outputs()) {
+    MP_RETURN_IF_ERROR(
+        GetTensorElementType(interpreter->tensor(tensor_index)->type)
+            .status());
+  }
+  return absl::WrapUnique(
+      new InferenceBatcher(std::move(model), std::move(interpreter), options));
+}
+
+InferenceBatcher::InferenceBatcher(
+    api2::Packet<TfLiteModelPtr> model,
+    std::unique_ptr<tflite::Interpreter> interpreter, const Options& options)
+    : model_(std::move(model)),
+      options_(options),
+      interpreter_(std::move(interpreter)) {
+  for (int tensor_index : interpreter_->inputs()) {
+    const TfLiteTensor* tensor = interpreter_->tensor(tensor_index);
+    input_shapes_.emplace_back(TfLiteTensorDims(*tensor));
+    input_types_.push_back(tensor->type);
+  }
+}
+
+int64 InferenceBatcher::num_batches() const {
+  absl::MutexLock lock(&mutex_);
+  return num_batches_;
+}
+
+int64 InferenceBatcher::num_requests() const {
+  absl::MutexLock lock(&mutex_);
+  return num_requests_;
+}
+
+absl::Status InferenceBatcher::CheckInputs(
+    const std::vector<Tensor>& inputs) const {
+  RET_CHECK_EQ(inputs.size(), input_shapes_.size());
+  for (int i = 0; i < inputs.size(); ++i) {
+    ASSIGN_OR_RETURN(auto element_type, GetTensorElementType(input_types_[i]));
+    RET_CHECK(inputs[i].element_type() == element_type)
+        << "Unexpected element type of input " << i;
+    RET_CHECK_EQ(inputs[i].shape().num_elements(),
+                 input_shapes_[i].num_elements())
+        << "Unexpected number of elements in input " << i;
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<Tensor>> InferenceBatcher::Run(
+    const std::vector<Tensor>& inputs) {
+  MP_RETURN_IF_ERROR(CheckInputs(inputs));
+  Request request(&inputs);
+
+  mutex_.Lock();
+  pending_.push_back(&request);
+  // Wakes up the collecting caller if the batch is complete now.
+  condition_.SignalAll();
+  while (!request.done) {
+    // With no pending request, this one is part of a batch being run by
+    // another caller, which signals when it is done.
+    if (collecting_ || pending_.empty()) {
+      condition_.Wait(&mutex_);
+      continue;
+    }
+    // Collect the next batch, this request may or may not be part of it.
+    collecting_ = true;
+    const absl::Time deadline = absl::Now() + options_.max_wait;
+    while (!request.done &&
+           pending_.size() < static_cast<size_t>(options_.max_batch_size) &&
+           !condition_.WaitWithDeadline(&mutex_, deadline)) {
+    }
+    if (request.done) {
+      // This request was run in the meantime, leave the remaining ones to
+      // their own callers.
+      collecting_ = false;
+      condition_.SignalAll();
+      break;
+    }
+    const int batch_size =
+        std::min<int>(pending_.size(), options_.max_batch_size);
+    std::vector<Request*> batch(pending_.begin(),
+                                pending_.begin() + batch_size);
+    pending_.erase(pending_.begin(), pending_.begin() + batch_size);
+    collecting_ = false;
+    // Let another waiting caller collect the next batch meanwhile.
+    condition_.SignalAll();
+    if (batch.empty()) {
+      continue;
+    }
+    mutex_.Unlock();
+
+    absl::Status status = RunBatch(batch);
+
+    mutex_.Lock();
+    ++num_batches_;
+    num_requests_ += batch.size();
+    for (Request* batched : batch) {
+      if (!status.ok()) batched->status = status;
+      batched->done = true;
+    }
+    condition_.SignalAll();
+  }
+  mutex_.Unlock();
+
+  MP_RETURN_IF_ERROR(request.status);
+  return std::move(request.outputs);
+}
+
+absl::Status InferenceBatcher::RunBatch(const std::vector<Request*>& batch) {
+  RET_CHECK_GT(batch.size(), 0);
+  absl::MutexLock lock(&interpreter_mutex_);
+  const int batch_size = batch.size();
+  if (batch_size != batch_size_) {
+    for (int i = 0; i < input_shapes_.size(); ++i) {
+      std::vector<int> dims = input_shapes_[i].dims;
+      dims[0] = batch_size;
+      RET_CHECK_EQ(
+          interpreter_->ResizeInputTensor(interpreter_->inputs()[i], dims),
+          kTfLiteOk);
+    }
+    RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+    batch_size_ = batch_size;
+  }
+
+  for (int i = 0; i < input_shapes_.size(); ++i) {
+    TfLiteTensor* tensor = interpreter_->input_tensor(i);
+    const size_t request_bytes = tensor->bytes / batch_size;
+    char* dst = tensor->data.raw;
+    for (const Request* request : batch) {
+      auto view = (*request->inputs)[i].GetCpuReadView();
+      std::memcpy(dst, view.buffer<void>(), request_bytes);
+      dst += request_bytes;
+    }
+  }
+
+  RET_CHECK_EQ(interpreter_->Invoke(), kTfLiteOk);
+
+  for (Request* request : batch) {
+    request->outputs.reserve(interpreter_->outputs().size());
+  }
+  for (int i = 0; i < interpreter_->outputs().size(); ++i) {
+    const TfLiteTensor* tensor = interpreter_->output_tensor(i);
+    std::vector<int> dims = TfLiteTensorDims(*tensor);
+    RET_CHECK(!dims.empty() && dims[0] == batch_size)
+        << "Output " << tensor->name << " doesn't follow the batch size.";
+    dims[0] = 1;
+    ASSIGN_OR_RETURN(auto element_type, GetTensorElementType(tensor->type));
+    const auto quantization_parameters = GetQuantizationParameters(*tensor);
+    const size_t request_bytes = tensor->bytes / batch_size;
+    const char* src = tensor->data.raw;
+    for (Request* request : batch) {
+      request->outputs.emplace_back(element_type, Tensor::Shape{dims},
+                                    quantization_parameters);
+      auto view = request->outputs.back().GetCpuWriteView();
+      std::memcpy(view.buffer<void>(), src, request_bytes);
+      src += request_bytes;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::shared_ptr<InferenceBatcher>>
+InferenceBatchingService::GetBatcher(const std::string& model_key,
+                                     const ModelGetter& get_model,
+                                     const tflite::OpResolver& op_resolver,
+                                     int num_threads) {
+  absl::MutexLock lock(&mutex_);
+  auto it = batchers_.find(model_key);
+  if (it != batchers_.end()) {
+    return it->second;
+  }
+  ASSIGN_OR_RETURN(auto model, get_model());
+  InferenceBatcher::Options options = options_;
+  if (num_threads != -1) {
+    options.num_threads = num_threads;
+  }
+  ASSIGN_OR_RETURN(std::shared_ptr<InferenceBatcher> batcher,
+                   InferenceBatcher::Create(std::move(model), op_resolver,
+                                            options));
+  batchers_.emplace(model_key, batcher);
+  return batcher;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,143 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_CALCULATORS_TENSOR_INFERENCE_BATCHING_SERVICE_H_
+#define MEDIAPIPE_CALCULATORS_TENSOR_INFERENCE_BATCHING_SERVICE_H_
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/api2/packet.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/statusor.h"
+#include "mediapipe/util/tflite/tflite_model_loader.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/op_resolver.h"
+
+namespace mediapipe {
+
+// Runs one TfLite model for many callers, coalescing concurrent requests into
+// batched Invoke() calls on a single interpreter.
+//
+// The model must have a batch dimension of 1 as the first dimension of every
+// input, and every output must follow the batch size of the inputs. A batch of
+// N requests is run by resizing the inputs to N along the first dimension.
+//
+// Requests are collected until either max_batch_size requests are pending or
+// max_wait has passed since the first one arrived. The calling thread of one
+// of the waiting requests runs the batch, there are no extra threads.
+class InferenceBatcher {
+ public:
+  struct Options {
+    // Maximum number of requests run by a single Invoke() call.
+    int max_batch_size = 8;
+    // Maximum time the first request of a batch waits for more requests.
+    absl::Duration max_wait = absl::Milliseconds(2);
+    // Number of threads used by the interpreter, -1 lets TfLite decide.
+    int num_threads = -1;
+  };
+
+  static absl::StatusOr<std::unique_ptr<InferenceBatcher>> Create(
+      api2::Packet<TfLiteModelPtr> model, const tflite::OpResolver& op_resolver,
+      const Options& options);
+
+  // Runs the model on "inputs", which must match the model inputs with a batch
+  // size of 1, and returns the corresponding outputs. Blocks until the batch
+  // containing the request has been run.
+  absl::StatusOr<std::vector<Tensor>> Run(const std::vector<Tensor>& inputs);
+
+  // Number of Invoke() calls and of requests run so far.
+  int64 num_batches() const;
+  int64 num_requests() const;
+
+ private:
+  struct Request;
+
+  InferenceBatcher(api2::Packet<TfLiteModelPtr> model,
+                   std::unique_ptr<tflite::Interpreter> interpreter,
+                   const Options& options);
+
+  absl::Status CheckInputs(const std::vector<Tensor>& inputs) const;
+  // Runs "batch" on the interpreter and fills in the request outputs.
+  absl::Status RunBatch(const std::vector<Request*>& batch);
+
+  // TfLite requires us to keep the model alive as long as the interpreter is.
+  api2::Packet<TfLiteModelPtr> model_;
+  const Options options_;
+  // Shapes and types of the inputs for a single request.
+  std::vector<Tensor::Shape> input_shapes_;
+  std::vector<TfLiteType> input_types_;
+
+  mutable absl::Mutex mutex_;
+  absl::CondVar condition_;
+  std::vector<Request*> pending_ ABSL_GUARDED_BY(mutex_);
+  // True while one of the callers is collecting the next batch.
+  bool collecting_ ABSL_GUARDED_BY(mutex_) = false;
+  int64 num_batches_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64 num_requests_ ABSL_GUARDED_BY(mutex_) = 0;
+
+  // Serializes the batches. A batch can be collected while the previous one is
+  // running.
+  absl::Mutex interpreter_mutex_;
+  std::unique_ptr<tflite::Interpreter> interpreter_
+      ABSL_GUARDED_BY(interpreter_mutex_);
+  int batch_size_ ABSL_GUARDED_BY(interpreter_mutex_) = 1;
+};
+
+// Shares InferenceBatchers between InferenceCalculators, possibly across
+// several graphs: set the same service object on every graph with
+//
+//   auto service = std::make_shared<InferenceBatchingService>(options);
+//   graph.SetServiceObject(kInferenceBatchingService, service);
+//
+// and enable use_batching_service in the InferenceCalculator options. All
+// calculators running the same model then share one interpreter.
+class InferenceBatchingService {
+ public:
+  using ModelGetter =
+      std::function<absl::StatusOr<api2::Packet<TfLiteModelPtr>>()>;
+
+  explicit InferenceBatchingService(const InferenceBatcher::Options& options)
+      : options_(options) {}
+  InferenceBatchingService()
+      : InferenceBatchingService(InferenceBatcher::Options()) {}
+
+  // Returns the batcher identified by "model_key", creating it with the model
+  // returned by "get_model" on first use. The key must identify the model and
+  // everything else that configures the interpreter, such as "op_resolver"
+  // and "num_threads", which override the service options unless -1.
+  absl::StatusOr<std::shared_ptr<InferenceBatcher>> GetBatcher(
+      const std::string& model_key, const ModelGetter& get_model,
+      const tflite::OpResolver& op_resolver, int num_threads = -1);
+
+ private:
+  const InferenceBatcher::Options options_;
+  absl::Mutex mutex_;
+  std::map<std::string, std::shared_ptr<InferenceBatcher>> batchers_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+extern const GraphService<InferenceBatchingService> kInferenceBatchingService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TENSOR_INFERENCE_BATCHING_SERVICE_H_
@@ -0,0 +1,195 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensor/inference_batching_service.h"
+
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/util/tflite/tflite_model_loader.h"
+#include "tensorflow/lite/kernels/register.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr char kModelPath[] = "mediapipe/calculators/tensor/testdata/add.bin";
+constexpr int kWidth = 8;
+constexpr int kHeight = 8;
+constexpr int kChannels = 3;
+
+std::vector<Tensor> MakeInput(float value) {
+  std::vector<Tensor> input;
+  input.emplace_back(Tensor::ElementType::kFloat32,
+                     Tensor::Shape{1, kHeight, kWidth, kChannels});
+  auto view = input.back().GetCpuWriteView();
+  float* buffer = view.buffer<float>();
+  for (int i = 0; i < kWidth * kHeight * kChannels; ++i) {
+    buffer[i] = value;
+  }
+  return input;
+}
+
+// The test model adds the input tensor to itself twice.
+void ExpectOutput(const std::vector<Tensor>& output, float input_value) {
+  ASSERT_EQ(output.size(), 1);
+  EXPECT_THAT(output[0].shape().dims,
+              testing::ElementsAre(1, kHeight, kWidth, kChannels));
+  auto view = output[0].GetCpuReadView();
+  const float* buffer = view.buffer<float>();
+  for (int i = 0; i < kWidth * kHeight * kChannels; ++i) {
+    ASSERT_EQ(buffer[i], 3 * input_value);
+  }
+}
+
+std::unique_ptr<InferenceBatcher> CreateBatcher(
+    const InferenceBatcher::Options& options) {
+  auto model = TfLiteModelLoader::LoadFromPath(kModelPath);
+  MP_EXPECT_OK(model);
+  auto batcher = InferenceBatcher::Create(
+      *model, tflite::ops::builtin::BuiltinOpResolver(), options);
+  MP_EXPECT_OK(batcher);
+  return std::move(batcher).value();
+}
+
+TEST(InferenceBatcherTest, RunsSingleRequest) {
+  InferenceBatcher::Options options;
+  options.max_batch_size = 4;
+  options.max_wait = absl::ZeroDuration();
+  auto batcher = CreateBatcher(options);
+
+  auto output = batcher->Run(MakeInput(1.0f));
+  MP_ASSERT_OK(output);
+  ExpectOutput(*output, 1.0f);
+  EXPECT_EQ(batcher->num_batches(), 1);
+  EXPECT_EQ(batcher->num_requests(), 1);
+}
+
+TEST(InferenceBatcherTest, CoalescesConcurrentRequests) {
+  constexpr int kNumRequests = 4;
+  InferenceBatcher::Options options;
+  options.max_batch_size = kNumRequests;
+  // Long enough for all the requests to arrive, the batch is run as soon as
+  // it is full.
+  options.max_wait = absl::Seconds(60);
+  auto batcher = CreateBatcher(options);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumRequests; ++i) {
+    threads.emplace_back([&batcher, i]() {
+      auto output = batcher->Run(MakeInput(i));
+      MP_ASSERT_OK(output);
+      ExpectOutput(*output, i);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(batcher->num_batches(), 1);
+  EXPECT_EQ(batcher->num_requests(), kNumRequests);
+}
+
+TEST(InferenceBatcherTest, RunsRequestsOfOtherCallers) {
+  constexpr int kNumRequests = 8;
+  InferenceBatcher::Options options;
+  options.max_batch_size = 2;
+  // Every batch is run once full. A caller whose request was run in another
+  // caller's batch must return without collecting or running an empty batch,
+  // even while nothing else is pending.
+  options.max_wait = absl::Seconds(60);
+  auto batcher = CreateBatcher(options);
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < kNumRequests; ++i) {
+    threads.emplace_back([&batcher, i]() {
+      for (int j = 0; j < 4; ++j) {
+        auto output = batcher->Run(MakeInput(i));
+        MP_ASSERT_OK(output);
+        ExpectOutput(*output, i);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(batcher->num_requests(), 4 * kNumRequests);
+  EXPECT_EQ(batcher->num_batches(), 2 * kNumRequests);
+}
+
+TEST(InferenceBatcherTest, ResizesForEachBatchSize) {
+  InferenceBatcher::Options options;
+  options.max_batch_size = 2;
+  options.max_wait = absl::Milliseconds(100);
+  auto batcher = CreateBatcher(options);
+
+  // Usually runs batches of 1, then 2, then 1 again. Results must be correct
+  // regardless of how the requests end up being batched.
+  auto output = batcher->Run(MakeInput(1.0f));
+  MP_ASSERT_OK(output);
+  ExpectOutput(*output, 1.0f);
+
+  std::thread thread([&batcher]() {
+    auto output = batcher->Run(MakeInput(2.0f));
+    MP_ASSERT_OK(output);
+    ExpectOutput(*output, 2.0f);
+  });
+  output = batcher->Run(MakeInput(3.0f));
+  thread.join();
+  MP_ASSERT_OK(output);
+  ExpectOutput(*output, 3.0f);
+
+  output = batcher->Run(MakeInput(4.0f));
+  MP_ASSERT_OK(output);
+  ExpectOutput(*output, 4.0f);
+  EXPECT_EQ(batcher->num_requests(), 4);
+}
+
+TEST(InferenceBatcherTest, RejectsMismatchingInput) {
+  auto batcher = CreateBatcher({});
+  std::vector<Tensor> input;
+  input.emplace_back(Tensor::ElementType::kFloat32, Tensor::Shape{1, 2, 2, 3});
+  EXPECT_FALSE(batcher->Run(input).ok());
+  EXPECT_EQ(batcher->num_requests(), 0);
+}
+
+TEST(InferenceBatchingServiceTest, SharesBatcherPerModel) {
+  InferenceBatchingService service;
+  int num_loads = 0;
+  auto get_model = [&num_loads]() {
+    ++num_loads;
+    return TfLiteModelLoader::LoadFromPath(kModelPath);
+  };
+  tflite::ops::builtin::BuiltinOpResolver op_resolver;
+  auto batcher1 = service.GetBatcher(kModelPath, get_model, op_resolver);
+  MP_ASSERT_OK(batcher1);
+  auto batcher2 = service.GetBatcher(kModelPath, get_model, op_resolver);
+  MP_ASSERT_OK(batcher2);
+  EXPECT_EQ(batcher1->get(), batcher2->get());
+  EXPECT_EQ(num_loads, 1);
+
+  // A different key, e.g. for other interpreter options, gets its own batcher.
+  auto batcher3 = service.GetBatcher(absl::StrCat(kModelPath, "|threads=1"),
+                                     get_model, op_resolver, 1);
+  MP_ASSERT_OK(batcher3);
+  EXPECT_NE(batcher1->get(), batcher3->get());
+  EXPECT_EQ(num_loads, 2);
+}
+
+}  // namespace
+}  // namespace mediapipe
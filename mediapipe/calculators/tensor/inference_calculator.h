@@ -48,6 +48,12 @@ namespace api2 {
 // When the input tensors are on GPU, inference is GPU and output can be CPU or
 // GPU.
 //
+// On CPU, input tensors may have a different batch (first) dimension than the
+// model, e.g. the batched tensors of ImageToTensorCalculator with NORM_RECTS.
+// The interpreter is then resized to run all batch entries in one invocation,
+// and the outputs have the same batch dimension. Not supported with
+// zero_copy_cpu_io.
+//
 // Input:
 //  TENSORS - Vector of Tensors
 //
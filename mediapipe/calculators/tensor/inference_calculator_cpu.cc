@@ -12,13 +12,19 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/calculators/tensor/inference_batching_service.h"
 #include "mediapipe/calculators/tensor/inference_calculator.h"
+#include "mediapipe/framework/port/aligned_malloc_and_free.h"
 
 #if defined(MEDIAPIPE_ANDROID)
 #include "tensorflow/lite/delegates/nnapi/nnapi_delegate.h"
@@ -59,6 +65,158 @@ int GetXnnpackNumThreads(const mediapipe::InferenceCalculatorOptions& opts) {
   return GetXnnpackDefaultNumThreads();
 }
 
+// TfLite requires custom tensor allocations to be aligned to this many bytes.
+constexpr int kTfLiteTensorAlignment = 64;
+
+// Number of frames an output is copied out of its staging buffer before it is
+// bound to a pool buffer again. Rebinding costs an AllocateTensors() call.
+constexpr int kZeroCopyRetryInterval = 8;
+
+// A pool of equally sized CPU buffers backing the output tensors of one
+// interpreter output. Output tensors keep the pool alive through their release
+// callback, so that buffers still in use when the calculator closes are freed
+// once the last packet referencing them is released.
+class CpuBufferPool : public std::enable_shared_from_this<CpuBufferPool> {
+ public:
+  explicit CpuBufferPool(size_t size) : size_(size) {}
+  ~CpuBufferPool() {
+    for (void* buffer : available_) aligned_free(buffer);
+  }
+
+  size_t size() const { return size_; }
+
+  // Returns an available buffer, or a newly allocated one.
+  void* Acquire() {
+    absl::MutexLock lock(&mutex_);
+    if (available_.empty()) {
+      return aligned_malloc(size_, kTfLiteTensorAlignment);
+    }
+    void* buffer = available_.back();
+    available_.pop_back();
+    return buffer;
+  }
+
+  // Returns an available buffer without allocating one, or nullptr if there
+  // is none.
+  void* TryAcquireAny() {
+    absl::MutexLock lock(&mutex_);
+    if (available_.empty()) return nullptr;
+    void* buffer = available_.back();
+    available_.pop_back();
+    return buffer;
+  }
+
+  // Acquires "buffer" if it is available.
+  bool TryAcquire(void* buffer) {
+    absl::MutexLock lock(&mutex_);
+    auto it = std::find(available_.begin(), available_.end(), buffer);
+    if (it == available_.end()) return false;
+    available_.erase(it);
+    return true;
+  }
+
+  void Release(void* buffer) {
+    absl::MutexLock lock(&mutex_);
+    available_.push_back(buffer);
+  }
+
+  // Wraps an acquired buffer into a tensor that returns it to the pool.
+  Tensor MakeTensor(
+      void* buffer, Tensor::ElementType element_type,
+      const Tensor::Shape& shape,
+      const Tensor::QuantizationParameters& quantization_parameters) {
+    return Tensor(
+        element_type, shape, buffer,
+        [pool = shared_from_this()](void* buffer) { pool->Release(buffer); },
+        quantization_parameters);
+  }
+
+ private:
+  const size_t size_;
+  absl::Mutex mutex_;
+  std::vector<void*> available_ ABSL_GUARDED_BY(mutex_);
+};
+
+std::vector<int> TfLiteTensorDims(const TfLiteTensor& tensor) {
+  return {tensor.dims->data, tensor.dims->data + tensor.dims->size};
+}
+
+absl::StatusOr<Tensor::ElementType> GetTensorElementType(
+    const TfLiteTensor& tensor) {
+  switch (tensor.type) {
+    case kTfLiteFloat32:
+      return Tensor::ElementType::kFloat32;
+    case kTfLiteUInt8:
+      return Tensor::ElementType::kUInt8;
+    case kTfLiteInt8:
+      return Tensor::ElementType::kInt8;
+    case kTfLiteInt32:
+      return Tensor::ElementType::kInt32;
+    default:
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unsupported TfLite tensor type: ",
+                       TfLiteTypeGetName(tensor.type)));
+  }
+}
+
+bool IsQuantized(Tensor::ElementType element_type) {
+  return element_type == Tensor::ElementType::kUInt8 ||
+         element_type == Tensor::ElementType::kInt8;
+}
+
+Tensor::QuantizationParameters GetQuantizationParameters(
+    const TfLiteTensor& tensor) {
+  if (tensor.type != kTfLiteUInt8 && tensor.type != kTfLiteInt8) {
+    return {};
+  }
+  return {tensor.params.scale, tensor.params.zero_point};
+}
+
+template <typename T>
+void Dequantize(const T* src, int num_elements,
+                const Tensor::QuantizationParameters& params, float* dst) {
+  for (int i = 0; i < num_elements; ++i) {
+    dst[i] = params.scale * (static_cast<int>(src[i]) - params.zero_point);
+  }
+}
+
+// Converts the quantized uint8/int8 values in "data" into a float32 tensor.
+Tensor DequantizeToFloat(const void* data, Tensor::ElementType element_type,
+                         const Tensor::Shape& shape,
+                         const Tensor::QuantizationParameters& params) {
+  Tensor result(Tensor::ElementType::kFloat32, shape);
+  auto view = result.GetCpuWriteView();
+  const int num_elements = shape.num_elements();
+  if (element_type == Tensor::ElementType::kUInt8) {
+    Dequantize(static_cast<const uint8_t*>(data), num_elements, params,
+               view.buffer<float>());
+  } else {
+    Dequantize(static_cast<const int8_t*>(data), num_elements, params,
+               view.buffer<float>());
+  }
+  return result;
+}
+
+// Returns true if LoadDelegate() may apply a delegate with these options.
+bool RequestsCpuDelegate(const mediapipe::InferenceCalculatorOptions& options) {
+  if (options.has_delegate()) {
+    if (options.delegate().has_nnapi() || options.delegate().has_xnnpack()) {
+      return true;
+    }
+#if defined(__EMSCRIPTEN__)
+    // XNNPACK is used unless the TfLite CPU kernels are requested.
+    return !options.delegate().has_tflite();
+#else
+    return false;
+#endif  // __EMSCRIPTEN__
+  }
+#if defined(__EMSCRIPTEN__)
+  return true;
+#else
+  return options.use_nnapi();
+#endif  // __EMSCRIPTEN__
+}
+
 }  // namespace
 
 class InferenceCalculatorCpuImpl
@@ -73,11 +231,48 @@ class InferenceCalculatorCpuImpl
  private:
   absl::Status LoadModel(CalculatorContext* cc);
   absl::Status LoadDelegate(CalculatorContext* cc);
+  absl::Status ProcessZeroCopy(CalculatorContext* cc);
+  absl::Status CheckInputTensor(const Tensor& tensor, int index) const;
+  absl::Status ResizeInputsIfNeeded(const std::vector<Tensor>& input_tensors);
+  absl::Status InitBatcher(CalculatorContext* cc);
+  bool ShouldDequantizeOutput(int index) const {
+    return dequantize_outputs_ && IsQuantized(output_types_[index]);
+  }
+
+  // Points the interpreter tensor "tensor_index" at "buffer". Returns true if
+  // the binding changed, in which case AllocateTensors() must be called before
+  // the next Invoke().
+  absl::StatusOr<bool> BindBuffer(int tensor_index, void* buffer, size_t size);
 
   // TfLite requires us to keep the model alive as long as the interpreter is.
   Packet<TfLiteModelPtr> model_packet_;
   std::unique_ptr<tflite::Interpreter> interpreter_;
   TfLiteDelegatePtr delegate_;
+
+  // Element types of the interpreter inputs and outputs.
+  std::vector<Tensor::ElementType> input_types_;
+  std::vector<Tensor::ElementType> output_types_;
+  std::vector<Tensor::QuantizationParameters> output_quantization_;
+  bool dequantize_outputs_ = false;
+
+  // Used instead of the interpreter if use_batching_service is enabled.
+  std::shared_ptr<InferenceBatcher> batcher_;
+
+  // Used if zero_copy_cpu_io is enabled.
+  absl::Status BindZeroCopyBuffers();
+  bool zero_copy_ = false;
+  // Buffers bound to the interpreter inputs, which the input tensors are
+  // copied into.
+  std::vector<std::unique_ptr<void, decltype(&aligned_free)>> input_staging_;
+  // Provide the buffers bound to the interpreter outputs, which are emitted
+  // without a copy.
+  std::vector<std::shared_ptr<CpuBufferPool>> output_pools_;
+  // Bound instead to the outputs whose previous packets were still in use
+  // when the next frame was processed. Those outputs are copied out.
+  std::vector<std::unique_ptr<void, decltype(&aligned_free)>> output_staging_;
+  // Number of frames each output has been copied out of its staging buffer
+  // since it was last bound to a pool buffer, or tried to be.
+  std::vector<int> frames_on_staging_;
 };
 
 absl::Status InferenceCalculatorCpuImpl::UpdateContract(
@@ -85,13 +280,44 @@ absl::Status InferenceCalculatorCpuImpl::UpdateContract(
   const auto& options = cc->Options<::mediapipe::InferenceCalculatorOptions>();
   RET_CHECK(!options.model_path().empty() ^ kSideInModel(cc).IsConnected())
       << "Either model as side packet or model path in options is required.";
+  cc->UseService(kInferenceBatchingService).Optional();
 
   return absl::OkStatus();
 }
 
 absl::Status InferenceCalculatorCpuImpl::Open(CalculatorContext* cc) {
+  if (cc->Options<mediapipe::InferenceCalculatorOptions>()
+          .use_batching_service()) {
+    return InitBatcher(cc);
+  }
   MP_RETURN_IF_ERROR(LoadModel(cc));
   MP_RETURN_IF_ERROR(LoadDelegate(cc));
+
+  const auto& options = cc->Options<mediapipe::InferenceCalculatorOptions>();
+  for (int tensor_index : interpreter_->inputs()) {
+    ASSIGN_OR_RETURN(auto type,
+                     GetTensorElementType(*interpreter_->tensor(tensor_index)));
+    input_types_.push_back(type);
+  }
+  for (int tensor_index : interpreter_->outputs()) {
+    const TfLiteTensor* tensor = interpreter_->tensor(tensor_index);
+    ASSIGN_OR_RETURN(auto type, GetTensorElementType(*tensor));
+    output_types_.push_back(type);
+    output_quantization_.push_back(GetQuantizationParameters(*tensor));
+  }
+  dequantize_outputs_ = options.dequantize_outputs();
+
+  zero_copy_ = options.zero_copy_cpu_io();
+#if defined(MEDIAPIPE_ANDROID)
+  // NNAPI may hold on to the buffers bound at delegation time.
+  if (delegate_ && (options.has_delegate() ? options.delegate().has_nnapi()
+                                           : options.use_nnapi())) {
+    zero_copy_ = false;
+  }
+#endif  // MEDIAPIPE_ANDROID
+  if (zero_copy_) {
+    MP_RETURN_IF_ERROR(BindZeroCopyBuffers());
+  }
   return absl::OkStatus();
 }
 
@@ -99,16 +325,41 @@ absl::Status InferenceCalculatorCpuImpl::Process(CalculatorContext* cc) {
   if (kInTensors(cc).IsEmpty()) {
     return absl::OkStatus();
   }
+  if (batcher_) {
+    ASSIGN_OR_RETURN(std::vector<Tensor> outputs,
+                     batcher_->Run(*kInTensors(cc)));
+    auto output_tensors = absl::make_unique<std::vector<Tensor>>();
+    output_tensors->reserve(outputs.size());
+    for (Tensor& output : outputs) {
+      if (dequantize_outputs_ && IsQuantized(output.element_type())) {
+        auto view = output.GetCpuReadView();
+        output_tensors->push_back(DequantizeToFloat(
+            view.buffer<void>(), output.element_type(), output.shape(),
+            output.quantization_parameters()));
+      } else {
+        output_tensors->push_back(std::move(output));
+      }
+    }
+    kOutTensors(cc).Send(std::move(output_tensors));
+    return absl::OkStatus();
+  }
+  if (zero_copy_) {
+    return ProcessZeroCopy(cc);
+  }
   const auto& input_tensors = *kInTensors(cc);
-  RET_CHECK(!input_tensors.empty());
+  RET_CHECK_EQ(input_tensors.size(), interpreter_->inputs().size());
+  MP_RETURN_IF_ERROR(ResizeInputsIfNeeded(input_tensors));
   auto output_tensors = absl::make_unique<std::vector<Tensor>>();
 
   // Read CPU input into tensors.
   for (int i = 0; i < input_tensors.size(); ++i) {
     const Tensor* input_tensor = &input_tensors[i];
+    MP_RETURN_IF_ERROR(CheckInputTensor(*input_tensor, i));
+    RET_CHECK_EQ(input_tensor->bytes(), interpreter_->input_tensor(i)->bytes)
+        << "Input tensor " << i << " doesn't match the model input size.";
     auto input_tensor_view = input_tensor->GetCpuReadView();
-    auto input_tensor_buffer = input_tensor_view.buffer<float>();
-    float* local_tensor_buffer = interpreter_->typed_input_tensor<float>(i);
+    auto input_tensor_buffer = input_tensor_view.buffer<void>();
+    void* local_tensor_buffer = interpreter_->input_tensor(i)->data.raw;
     std::memcpy(local_tensor_buffer, input_tensor_buffer,
                 input_tensor->bytes());
   }
@@ -121,21 +372,245 @@ absl::Status InferenceCalculatorCpuImpl::Process(CalculatorContext* cc) {
   output_tensors->reserve(tensor_indexes.size());
   for (int i = 0; i < tensor_indexes.size(); ++i) {
     TfLiteTensor* tensor = interpreter_->tensor(tensor_indexes[i]);
-    output_tensors->emplace_back(
-        Tensor::ElementType::kFloat32,
-        Tensor::Shape{std::vector<int>{
-            tensor->dims->data, tensor->dims->data + tensor->dims->size}});
+    Tensor::Shape shape{TfLiteTensorDims(*tensor)};
+    if (ShouldDequantizeOutput(i)) {
+      output_tensors->push_back(DequantizeToFloat(
+          tensor->data.raw, output_types_[i], shape, output_quantization_[i]));
+      continue;
+    }
+    output_tensors->emplace_back(output_types_[i], shape,
+                                 output_quantization_[i]);
     auto cpu_view = output_tensors->back().GetCpuWriteView();
-    std::memcpy(cpu_view.buffer<float>(), tensor->data.f,
+    std::memcpy(cpu_view.buffer<void>(), tensor->data.raw,
                 output_tensors->back().bytes());
   }
   kOutTensors(cc).Send(std::move(output_tensors));
   return absl::OkStatus();
 }
 
+absl::Status InferenceCalculatorCpuImpl::InitBatcher(CalculatorContext* cc) {
+  const auto& options = cc->Options<mediapipe::InferenceCalculatorOptions>();
+  auto service = cc->Service(kInferenceBatchingService);
+  RET_CHECK(service.IsAvailable())
+      << "use_batching_service requires kInferenceBatchingService to be set "
+         "on the graph.";
+  // The batcher runs the TfLite CPU kernels, it doesn't apply delegates.
+  RET_CHECK(!RequestsCpuDelegate(options))
+      << "use_batching_service doesn't support delegates, set "
+         "delegate { tflite {} } instead.";
+  // Calculators share a batcher if they load the same model file or get the
+  // same model object as a side packet, and configure the interpreter the
+  // same way.
+  std::string model_key =
+      !options.model_path().empty()
+          ? options.model_path()
+          : absl::StrCat("model@", reinterpret_cast<uintptr_t>(
+                                       kSideInModel(cc).Get().get()));
+  absl::StrAppend(&model_key, "|threads=", options.cpu_num_thread());
+  if (kSideInCustomOpResolver(cc).IsConnected()) {
+    absl::StrAppend(&model_key, "|op_resolver@",
+                    reinterpret_cast<uintptr_t>(
+                        &kSideInCustomOpResolver(cc).Get()));
+  }
+  tflite::ops::builtin::BuiltinOpResolver op_resolver =
+      kSideInCustomOpResolver(cc).GetOr(
+          tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates());
+  ASSIGN_OR_RETURN(batcher_,
+                   service.GetObject().GetBatcher(
+                       model_key, [this, cc]() { return GetModelAsPacket(cc); },
+                       op_resolver, options.cpu_num_thread()));
+  dequantize_outputs_ = options.dequantize_outputs();
+  return absl::OkStatus();
+}
+
+absl::Status InferenceCalculatorCpuImpl::CheckInputTensor(const Tensor& tensor,
+                                                          int index) const {
+  RET_CHECK(tensor.element_type() == input_types_[index])
+      << "Input tensor " << index << " has element type "
+      << static_cast<int>(tensor.element_type()) << ", the model expects "
+      << static_cast<int>(input_types_[index]) << ".";
+  return absl::OkStatus();
+}
+
+absl::Status InferenceCalculatorCpuImpl::ResizeInputsIfNeeded(
+    const std::vector<Tensor>& input_tensors) {
+  RET_CHECK_EQ(input_tensors.size(), interpreter_->inputs().size());
+  bool resized = false;
+  for (int i = 0; i < input_tensors.size(); ++i) {
+    const int tensor_index = interpreter_->inputs()[i];
+    const std::vector<int>& dims = input_tensors[i].shape().dims;
+    const std::vector<int> model_dims =
+        TfLiteTensorDims(*interpreter_->tensor(tensor_index));
+    // Only the batch dimension is adjusted, e.g. for the batched tensors of
+    // ImageToTensorCalculator with NORM_RECTS. Inputs with other shape
+    // mismatches are left as is, and rejected by the byte size checks of
+    // Process() unless their size matches the model input.
+    if (dims.empty() || dims.size() != model_dims.size() ||
+        dims[0] == model_dims[0] ||
+        !std::equal(dims.begin() + 1, dims.end(), model_dims.begin() + 1)) {
+      continue;
+    }
+    // The custom allocations of the outputs would have to be resized before
+    // their new size is known.
+    RET_CHECK(!zero_copy_)
+        << "Input " << i << " has batch size " << dims[0]
+        << ", the model expects " << model_dims[0]
+        << ". Batch size changes are not supported with zero_copy_cpu_io.";
+    RET_CHECK_EQ(interpreter_->ResizeInputTensor(tensor_index, dims),
+                 kTfLiteOk);
+    resized = true;
+  }
+  if (resized) {
+    RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<bool> InferenceCalculatorCpuImpl::BindBuffer(int tensor_index,
+                                                           void* buffer,
+                                                           size_t size) {
+  TfLiteTensor* tensor = interpreter_->tensor(tensor_index);
+  if (tensor->data.raw == buffer) return false;
+  RET_CHECK_GE(size, tensor->bytes);
+  RET_CHECK_EQ(interpreter_->SetCustomAllocationForTensor(
+                   tensor_index, TfLiteCustomAllocation{buffer, size}),
+               kTfLiteOk);
+  return true;
+}
+
+absl::Status InferenceCalculatorCpuImpl::BindZeroCopyBuffers() {
+  // Binding a different buffer requires AllocateTensors() before the next
+  // Invoke(), so the buffers bound here are kept for as long as possible.
+  for (int tensor_index : interpreter_->inputs()) {
+    const size_t size = interpreter_->tensor(tensor_index)->bytes;
+    input_staging_.emplace_back(aligned_malloc(size, kTfLiteTensorAlignment),
+                                &aligned_free);
+    MP_RETURN_IF_ERROR(
+        BindBuffer(tensor_index, input_staging_.back().get(), size).status());
+  }
+  for (int tensor_index : interpreter_->outputs()) {
+    const size_t size = interpreter_->tensor(tensor_index)->bytes;
+    output_pools_.push_back(std::make_shared<CpuBufferPool>(size));
+    // The bound buffer stays available, to be acquired by the first frame.
+    void* buffer = output_pools_.back()->Acquire();
+    output_pools_.back()->Release(buffer);
+    MP_RETURN_IF_ERROR(BindBuffer(tensor_index, buffer, size).status());
+    output_staging_.emplace_back(nullptr, &aligned_free);
+    frames_on_staging_.push_back(0);
+  }
+  RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
+  return absl::OkStatus();
+}
+
+absl::Status InferenceCalculatorCpuImpl::ProcessZeroCopy(
+    CalculatorContext* cc) {
+  const auto& input_tensors = *kInTensors(cc);
+  RET_CHECK_EQ(input_tensors.size(), interpreter_->inputs().size());
+  MP_RETURN_IF_ERROR(ResizeInputsIfNeeded(input_tensors));
+
+  // Copy the inputs into the bound staging buffers. Binding the input tensors
+  // in place would require AllocateTensors() for every frame, since every
+  // packet has its own buffer.
+  for (int i = 0; i < input_tensors.size(); ++i) {
+    const TfLiteTensor* tensor = interpreter_->input_tensor(i);
+    MP_RETURN_IF_ERROR(CheckInputTensor(input_tensors[i], i));
+    RET_CHECK_EQ(input_tensors[i].bytes(), tensor->bytes)
+        << "Input tensor " << i << " doesn't match the model input size.";
+    auto view = input_tensors[i].GetCpuReadView();
+    std::memcpy(tensor->data.raw, view.buffer<void>(), tensor->bytes);
+  }
+
+  // The outputs are written into the buffers bound for the previous frame if
+  // their packets have been released already. Otherwise, the output is bound
+  // to a staging buffer and copied out, until a later retry finds a free pool
+  // buffer to bind it to again.
+  const auto& output_indexes = interpreter_->outputs();
+  // Returns the output buffers acquired for outputs [0, end) to their pools.
+  auto release_outputs = [this, &output_indexes](int end) {
+    for (int i = 0; i < end; ++i) {
+      if (!output_staging_[i]) {
+        output_pools_[i]->Release(
+            interpreter_->tensor(output_indexes[i])->data.raw);
+      }
+    }
+  };
+  bool needs_allocation = false;
+  for (int i = 0; i < output_indexes.size(); ++i) {
+    TfLiteTensor* tensor = interpreter_->tensor(output_indexes[i]);
+    if (output_staging_[i]) {
+      if (++frames_on_staging_[i] < kZeroCopyRetryInterval) continue;
+      frames_on_staging_[i] = 0;
+      void* buffer = output_pools_[i]->TryAcquireAny();
+      if (!buffer) continue;
+      auto rebound = BindBuffer(output_indexes[i], buffer, tensor->bytes);
+      if (!rebound.ok()) {
+        output_pools_[i]->Release(buffer);
+        release_outputs(i);
+        return rebound.status();
+      }
+      output_staging_[i].reset();
+      needs_allocation |= *rebound;
+      continue;
+    }
+    if (output_pools_[i]->TryAcquire(tensor->data.raw)) continue;
+    frames_on_staging_[i] = 0;
+    output_staging_[i].reset(
+        aligned_malloc(tensor->bytes, kTfLiteTensorAlignment));
+    auto rebound = BindBuffer(output_indexes[i], output_staging_[i].get(),
+                              tensor->bytes);
+    if (!rebound.ok()) {
+      release_outputs(i);
+      return rebound.status();
+    }
+    needs_allocation |= *rebound;
+  }
+
+  TfLiteStatus status = kTfLiteOk;
+  if (needs_allocation) {
+    status = interpreter_->AllocateTensors();
+  }
+  if (status == kTfLiteOk) {
+    status = interpreter_->Invoke();
+  }
+  if (status != kTfLiteOk) {
+    release_outputs(output_indexes.size());
+    return absl::InternalError("Failed to run TfLite inference.");
+  }
+
+  auto output_tensors = absl::make_unique<std::vector<Tensor>>();
+  output_tensors->reserve(output_indexes.size());
+  for (int i = 0; i < output_indexes.size(); ++i) {
+    const TfLiteTensor* tensor = interpreter_->tensor(output_indexes[i]);
+    Tensor::Shape shape{TfLiteTensorDims(*tensor)};
+    if (ShouldDequantizeOutput(i)) {
+      output_tensors->push_back(DequantizeToFloat(
+          tensor->data.raw, output_types_[i], shape, output_quantization_[i]));
+      if (!output_staging_[i]) output_pools_[i]->Release(tensor->data.raw);
+      continue;
+    }
+    void* buffer = tensor->data.raw;
+    if (output_staging_[i]) {
+      buffer = output_pools_[i]->Acquire();
+      std::memcpy(buffer, tensor->data.raw, tensor->bytes);
+    }
+    output_tensors->push_back(output_pools_[i]->MakeTensor(
+        buffer, output_types_[i], shape, output_quantization_[i]));
+  }
+  kOutTensors(cc).Send(std::move(output_tensors));
+  return absl::OkStatus();
+}
+
 absl::Status InferenceCalculatorCpuImpl::Close(CalculatorContext* cc) {
   interpreter_ = nullptr;
   delegate_ = nullptr;
+  batcher_ = nullptr;
+  input_types_.clear();
+  output_types_.clear();
+  output_quantization_.clear();
+  input_staging_.clear();
+  output_pools_.clear();
+  output_staging_.clear();
+  frames_on_staging_.clear();
   return absl::OkStatus();
 }
 
@@ -157,9 +632,6 @@ absl::Status InferenceCalculatorCpuImpl::LoadModel(CalculatorContext* cc) {
 #endif  // __EMSCRIPTEN__
 
   RET_CHECK_EQ(interpreter_->AllocateTensors(), kTfLiteOk);
-  // TODO: Support quantized tensors.
-  CHECK(interpreter_->tensor(interpreter_->inputs()[0])->quantization.type !=
-        kTfLiteAffineQuantization);
 
   return absl::OkStatus();
 }
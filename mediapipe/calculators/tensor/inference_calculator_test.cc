@@ -12,12 +12,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "absl/strings/str_replace.h"
 #include "absl/strings/string_view.h"
+#include "mediapipe/calculators/tensor/inference_batching_service.h"
 #include "mediapipe/calculators/tensor/inference_calculator.pb.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/calculator_runner.h"
@@ -30,6 +34,7 @@
 #include "mediapipe/framework/port/status_matchers.h"  // NOLINT
 #include "mediapipe/framework/tool/validate_type.h"
 #include "tensorflow/lite/error_reporter.h"
+#include "tensorflow/lite/kernels/builtin_op_kernels.h"
 #include "tensorflow/lite/kernels/register.h"
 #include "tensorflow/lite/model.h"
 
@@ -41,19 +46,66 @@ namespace mediapipe {
 
 using ::tflite::Interpreter;
 
-void DoSmokeTest(const std::string& graph_proto) {
+namespace {
+
+// The buffers of each tensor read and written by the ADD kernels.
+struct TensorBuffers {
+  std::map<int, std::set<const void*>> read;
+  std::map<int, std::set<const void*>> written;
+  // The buffer written by the last ADD kernel run, i.e. the model output.
+  const void* last_written = nullptr;
+};
+
+TensorBuffers& AddTensorBuffers() {
+  static auto* buffers = new TensorBuffers();
+  return *buffers;
+}
+
+TfLiteStatus RecordingAddInvoke(TfLiteContext* context, TfLiteNode* node) {
+  for (int i = 0; i < node->inputs->size; ++i) {
+    const int tensor_index = node->inputs->data[i];
+    AddTensorBuffers().read[tensor_index].insert(
+        context->tensors[tensor_index].data.raw);
+  }
+  for (int i = 0; i < node->outputs->size; ++i) {
+    const int tensor_index = node->outputs->data[i];
+    AddTensorBuffers().written[tensor_index].insert(
+        context->tensors[tensor_index].data.raw);
+    AddTensorBuffers().last_written = context->tensors[tensor_index].data.raw;
+  }
+  return tflite::ops::builtin::Register_ADD()->invoke(context, node);
+}
+
+// Returns an op resolver whose ADD kernel records the buffers it uses.
+tflite::ops::builtin::BuiltinOpResolver RecordingOpResolver() {
+  static TfLiteRegistration* registration = []() {
+    auto* registration =
+        new TfLiteRegistration(*tflite::ops::builtin::Register_ADD());
+    registration->invoke = RecordingAddInvoke;
+    return registration;
+  }();
+  tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates op_resolver;
+  op_resolver.AddBuiltin(tflite::BuiltinOperator_ADD, registration,
+                         /*min_version=*/1, /*max_version=*/4);
+  return op_resolver;
+}
+
+}  // namespace
+
+void DoSmokeTest(const std::string& graph_proto, int batch_size = 1) {
   const int width = 8;
   const int height = 8;
   const int channels = 3;
+  const int num_elements = batch_size * width * height * channels;
   // Prepare input tensor.
   auto input_vec = absl::make_unique<std::vector<Tensor>>();
   input_vec->emplace_back(Tensor::ElementType::kFloat32,
-                          Tensor::Shape{1, height, width, channels});
+                          Tensor::Shape{batch_size, height, width, channels});
   {
     auto view1 = input_vec->back().GetCpuWriteView();
     auto tensor_buffer = view1.buffer<float>();
     ASSERT_NE(tensor_buffer, nullptr);
-    for (int i = 0; i < width * height * channels - 1; i++) {
+    for (int i = 0; i < num_elements - 1; i++) {
       tensor_buffer[i] = 1;
     }
   }
@@ -79,10 +131,11 @@ void DoSmokeTest(const std::string& graph_proto) {
   ASSERT_EQ(1, result_vec.size());
 
   const Tensor& result = result_vec[0];
+  EXPECT_EQ(result.shape().dims[0], batch_size);
   auto view = result.GetCpuReadView();
   auto result_buffer = view.buffer<float>();
   ASSERT_NE(result_buffer, nullptr);
-  for (int i = 0; i < width * height * channels - 1; i++) {
+  for (int i = 0; i < num_elements - 1; i++) {
     ASSERT_EQ(3, result_buffer[i]);
   }
 
@@ -116,6 +169,380 @@ TEST(InferenceCalculatorTest, SmokeTest) {
   DoSmokeTest(absl::StrReplaceAll(
       graph_proto,
       {{"$delegate", "delegate { xnnpack { num_threads: 10 } }"}}));
+  // Test CPU inference with the interpreter bound to the tensor buffers.
+  DoSmokeTest(absl::StrReplaceAll(
+      graph_proto,
+      {{"$delegate", "delegate { tflite {} } zero_copy_cpu_io: true"}}));
+  DoSmokeTest(absl::StrReplaceAll(
+      graph_proto,
+      {{"$delegate", "delegate { xnnpack {} } zero_copy_cpu_io: true"}}));
+}
+
+// Tests that the interpreter is resized to the batch size of the input.
+TEST(InferenceCalculatorTest, BatchedInput) {
+  std::string graph_proto = R"(
+    input_stream: "tensor_in"
+    node {
+      calculator: "InferenceCalculator"
+      input_stream: "TENSORS:tensor_in"
+      output_stream: "TENSORS:tensor_out"
+      options {
+        [mediapipe.InferenceCalculatorOptions.ext] {
+          model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+          $delegate
+        }
+      }
+    }
+  )";
+  DoSmokeTest(absl::StrReplaceAll(graph_proto,
+                                  {{"$delegate", "delegate { tflite {} }"}}),
+              /*batch_size=*/3);
+  DoSmokeTest(absl::StrReplaceAll(graph_proto,
+                                  {{"$delegate", "delegate { xnnpack {} }"}}),
+              /*batch_size=*/3);
+}
+
+// Tests that zero_copy_cpu_io keeps the same buffers bound to the interpreter
+// across frames, instead of rebinding them for each input packet.
+TEST(InferenceCalculatorTest, ZeroCopyKeepsBuffersBound) {
+  constexpr int kNumFrames = 5;
+  for (bool keep_outputs : {false, true}) {
+    AddTensorBuffers() = {};
+    CalculatorGraphConfig graph_config =
+        ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+          input_stream: "tensor_in"
+          input_side_packet: "op_resolver"
+          node {
+            calculator: "InferenceCalculator"
+            input_stream: "TENSORS:tensor_in"
+            output_stream: "TENSORS:tensor_out"
+            input_side_packet: "CUSTOM_OP_RESOLVER:op_resolver"
+            options {
+              [mediapipe.InferenceCalculatorOptions.ext] {
+                model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+                delegate { tflite {} }
+                zero_copy_cpu_io: true
+              }
+            }
+          }
+        )");
+    CalculatorGraph graph(graph_config);
+    std::vector<Packet> kept_packets;
+    std::vector<const void*> output_buffers;
+    MP_ASSERT_OK(graph.ObserveOutputStream(
+        "tensor_out", [&](const Packet& packet) {
+          const Tensor& tensor = packet.Get<std::vector<Tensor>>()[0];
+          auto view = tensor.GetCpuReadView();
+          const float expected = 3 * packet.Timestamp().Value();
+          EXPECT_EQ(view.buffer<float>()[0], expected);
+          EXPECT_EQ(view.buffer<float>()[tensor.shape().num_elements() - 1],
+                    expected);
+          output_buffers.push_back(view.buffer<void>());
+          if (keep_outputs) kept_packets.push_back(packet);
+          return absl::OkStatus();
+        }));
+    MP_ASSERT_OK(graph.StartRun(
+        {{"op_resolver",
+          MakePacket<tflite::ops::builtin::BuiltinOpResolver>(
+              RecordingOpResolver())}}));
+    for (int frame = 0; frame < kNumFrames; ++frame) {
+      auto input_vec = absl::make_unique<std::vector<Tensor>>();
+      input_vec->emplace_back(Tensor::ElementType::kFloat32,
+                              Tensor::Shape{1, 8, 8, 3});
+      {
+        auto view = input_vec->back().GetCpuWriteView();
+        std::fill_n(view.buffer<float>(), 8 * 8 * 3, frame);
+      }
+      MP_ASSERT_OK(graph.AddPacketToInputStream(
+          "tensor_in", Adopt(input_vec.release()).At(Timestamp(frame))));
+      MP_ASSERT_OK(graph.WaitUntilIdle());
+    }
+    MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+    MP_ASSERT_OK(graph.WaitUntilDone());
+    ASSERT_EQ(output_buffers.size(), kNumFrames);
+
+    // The model input and output keep their buffers, except for the output
+    // when its packets are kept: it is rebound once to a buffer it is copied
+    // out of.
+    const TensorBuffers& buffers = AddTensorBuffers();
+    int num_rebinds = 0;
+    for (const auto& read : buffers.read) {
+      if (!buffers.written.count(read.first)) {
+        num_rebinds += read.second.size() - 1;
+      }
+    }
+    for (const auto& written : buffers.written) {
+      if (!buffers.read.count(written.first)) {
+        num_rebinds += written.second.size() - 1;
+      }
+    }
+    if (keep_outputs) {
+      EXPECT_EQ(num_rebinds, 1);
+    } else {
+      EXPECT_EQ(num_rebinds, 0);
+      // The output is emitted without a copy.
+      EXPECT_THAT(output_buffers, testing::Each(output_buffers[0]));
+    }
+  }
+}
+
+// Tests that an output which falls back to being copied out, because its
+// previous packet was still in use, is emitted without a copy again once the
+// packet is released.
+TEST(InferenceCalculatorTest, ZeroCopyRecoversAfterOutputIsReleased) {
+  // More than the number of frames an output stays copied out.
+  constexpr int kNumFrames = 20;
+  AddTensorBuffers() = {};
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        input_side_packet: "op_resolver"
+        node {
+          calculator: "InferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:tensor_out"
+          input_side_packet: "CUSTOM_OP_RESOLVER:op_resolver"
+          options {
+            [mediapipe.InferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+              delegate { tflite {} }
+              zero_copy_cpu_io: true
+            }
+          }
+        }
+      )");
+  CalculatorGraph graph(graph_config);
+  // Only the packet of the first frame is kept, until the second frame.
+  Packet kept_packet;
+  std::vector<bool> zero_copy;
+  MP_ASSERT_OK(graph.ObserveOutputStream(
+      "tensor_out", [&](const Packet& packet) {
+        const Tensor& tensor = packet.Get<std::vector<Tensor>>()[0];
+        auto view = tensor.GetCpuReadView();
+        EXPECT_EQ(view.buffer<float>()[0], 3 * packet.Timestamp().Value());
+        zero_copy.push_back(view.buffer<void>() ==
+                            AddTensorBuffers().last_written);
+        if (packet.Timestamp() == Timestamp(0)) kept_packet = packet;
+        return absl::OkStatus();
+      }));
+  MP_ASSERT_OK(graph.StartRun(
+      {{"op_resolver", MakePacket<tflite::ops::builtin::BuiltinOpResolver>(
+                           RecordingOpResolver())}}));
+  for (int frame = 0; frame < kNumFrames; ++frame) {
+    auto input_vec = absl::make_unique<std::vector<Tensor>>();
+    input_vec->emplace_back(Tensor::ElementType::kFloat32,
+                            Tensor::Shape{1, 8, 8, 3});
+    {
+      auto view = input_vec->back().GetCpuWriteView();
+      std::fill_n(view.buffer<float>(), 8 * 8 * 3, frame);
+    }
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "tensor_in", Adopt(input_vec.release()).At(Timestamp(frame))));
+    MP_ASSERT_OK(graph.WaitUntilIdle());
+    if (frame == 1) kept_packet = Packet();
+  }
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  ASSERT_EQ(zero_copy.size(), kNumFrames);
+
+  EXPECT_TRUE(zero_copy[0]);
+  EXPECT_FALSE(zero_copy[1]);
+  // Once back, the output stays zero-copy.
+  auto recovered = std::find(zero_copy.begin() + 1, zero_copy.end(), true);
+  ASSERT_NE(recovered, zero_copy.end());
+  EXPECT_TRUE(std::all_of(recovered, zero_copy.end(),
+                          [](bool value) { return value; }));
+}
+
+// Tests that inputs which don't match the model inputs are rejected instead
+// of being copied into the interpreter.
+TEST(InferenceCalculatorTest, RejectsMismatchedInputs) {
+  std::string graph_proto = R"(
+    input_stream: "tensor_in"
+    node {
+      calculator: "InferenceCalculator"
+      input_stream: "TENSORS:tensor_in"
+      output_stream: "TENSORS:tensor_out"
+      options {
+        [mediapipe.InferenceCalculatorOptions.ext] {
+          model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+          delegate { tflite {} }
+          $zero_copy
+        }
+      }
+    }
+  )";
+  // The model input is a float tensor of shape [1, 8, 8, 3].
+  const std::vector<std::vector<Tensor::Shape>> mismatched_inputs = {
+      // Too many inputs.
+      {Tensor::Shape{1, 8, 8, 3}, Tensor::Shape{1, 8, 8, 3}},
+      // Fewer elements than the model input.
+      {Tensor::Shape{1, 8, 8, 1}},
+      // More elements than the model input.
+      {Tensor::Shape{1, 16, 8, 3}},
+  };
+  for (const char* zero_copy : {"", "zero_copy_cpu_io: true"}) {
+    for (const auto& shapes : mismatched_inputs) {
+      CalculatorGraph graph(ParseTextProtoOrDie<CalculatorGraphConfig>(
+          absl::StrReplaceAll(graph_proto, {{"$zero_copy", zero_copy}})));
+      MP_ASSERT_OK(graph.StartRun({}));
+      auto input_vec = absl::make_unique<std::vector<Tensor>>();
+      for (const Tensor::Shape& shape : shapes) {
+        input_vec->emplace_back(Tensor::ElementType::kFloat32, shape);
+        auto view = input_vec->back().GetCpuWriteView();
+        std::fill_n(view.buffer<float>(), shape.num_elements(), 1.0f);
+      }
+      MP_ASSERT_OK(graph.AddPacketToInputStream(
+          "tensor_in", Adopt(input_vec.release()).At(Timestamp(0))));
+      EXPECT_FALSE(graph.WaitUntilIdle().ok()) << zero_copy;
+    }
+  }
+}
+
+// Tests a quantized add model, whose uint8 output is emitted as is or
+// dequantized to float.
+TEST(InferenceCalculatorTest, QuantizedModel) {
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"(
+        input_stream: "tensor_in"
+        node {
+          calculator: "InferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:quantized_out"
+          options {
+            [mediapipe.InferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tflite/testdata/add_quantized.bin"
+              delegate { tflite {} }
+            }
+          }
+        }
+        node {
+          calculator: "InferenceCalculator"
+          input_stream: "TENSORS:tensor_in"
+          output_stream: "TENSORS:dequantized_out"
+          options {
+            [mediapipe.InferenceCalculatorOptions.ext] {
+              model_path: "mediapipe/calculators/tflite/testdata/add_quantized.bin"
+              delegate { tflite {} }
+              dequantize_outputs: true
+            }
+          }
+        }
+      )");
+  std::vector<Packet> quantized_packets;
+  std::vector<Packet> dequantized_packets;
+  tool::AddVectorSink("quantized_out", &graph_config, &quantized_packets);
+  tool::AddVectorSink("dequantized_out", &graph_config, &dequantized_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  // The model input is a uint8 tensor of shape [1, 8, 8, 3], and the model
+  // adds it to itself twice. Values are kept small enough not to saturate.
+  const int num_elements = 8 * 8 * 3;
+  auto input_vec = absl::make_unique<std::vector<Tensor>>();
+  input_vec->emplace_back(Tensor::ElementType::kUInt8,
+                          Tensor::Shape{1, 8, 8, 3});
+  {
+    auto view = input_vec->back().GetCpuWriteView();
+    uint8* buffer = view.buffer<uint8>();
+    for (int i = 0; i < num_elements; ++i) buffer[i] = i % 85;
+  }
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "tensor_in", Adopt(input_vec.release()).At(Timestamp(0))));
+  MP_ASSERT_OK(graph.WaitUntilIdle());
+  ASSERT_EQ(quantized_packets.size(), 1);
+  ASSERT_EQ(dequantized_packets.size(), 1);
+
+  const auto& quantized_vec = quantized_packets[0].Get<std::vector<Tensor>>();
+  ASSERT_EQ(quantized_vec.size(), 1);
+  const Tensor& quantized = quantized_vec[0];
+  EXPECT_EQ(quantized.element_type(), Tensor::ElementType::kUInt8);
+  EXPECT_EQ(quantized.shape().dims, std::vector<int>({1, 8, 8, 3}));
+  const Tensor::QuantizationParameters& params =
+      quantized.quantization_parameters();
+  EXPECT_NEAR(params.scale, 1.0f / 255.0f, 1e-5f);
+  EXPECT_EQ(params.zero_point, 0);
+
+  const auto& dequantized_vec =
+      dequantized_packets[0].Get<std::vector<Tensor>>();
+  ASSERT_EQ(dequantized_vec.size(), 1);
+  const Tensor& dequantized = dequantized_vec[0];
+  EXPECT_EQ(dequantized.element_type(), Tensor::ElementType::kFloat32);
+  EXPECT_EQ(dequantized.shape().dims, quantized.shape().dims);
+
+  auto quantized_view = quantized.GetCpuReadView();
+  auto dequantized_view = dequantized.GetCpuReadView();
+  const uint8* quantized_buffer = quantized_view.buffer<uint8>();
+  const float* dequantized_buffer = dequantized_view.buffer<float>();
+  for (int i = 0; i < num_elements; ++i) {
+    EXPECT_NEAR(quantized_buffer[i], 3 * (i % 85), 1) << "i=" << i;
+    EXPECT_FLOAT_EQ(dequantized_buffer[i],
+                    params.scale * (quantized_buffer[i] - params.zero_point))
+        << "i=" << i;
+  }
+
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+}
+
+// Tests that use_batching_service runs the TfLite CPU kernels, and rejects
+// the options which would apply a delegate without batching.
+TEST(InferenceCalculatorTest, BatchingServiceRejectsDelegates) {
+  std::string graph_proto = R"(
+    input_stream: "tensor_in"
+    node {
+      calculator: "InferenceCalculator"
+      input_stream: "TENSORS:tensor_in"
+      output_stream: "TENSORS:tensor_out"
+      options {
+        [mediapipe.InferenceCalculatorOptions.ext] {
+          model_path: "mediapipe/calculators/tensor/testdata/add.bin"
+          use_batching_service: true
+          $delegate
+        }
+      }
+    }
+  )";
+  for (const char* delegate : {"delegate { xnnpack {} }",
+                               "delegate { nnapi {} }", "use_nnapi: true"}) {
+    CalculatorGraph graph(ParseTextProtoOrDie<CalculatorGraphConfig>(
+        absl::StrReplaceAll(graph_proto, {{"$delegate", delegate}})));
+    MP_ASSERT_OK(graph.SetServiceObject(
+        kInferenceBatchingService,
+        std::make_shared<InferenceBatchingService>()));
+    MP_ASSERT_OK(graph.StartRun({}));
+    const absl::Status status = graph.WaitUntilIdle();
+    EXPECT_FALSE(status.ok()) << delegate;
+    EXPECT_THAT(status.message(), testing::HasSubstr("delegate")) << delegate;
+  }
+
+  CalculatorGraphConfig graph_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(absl::StrReplaceAll(
+          graph_proto, {{"$delegate", "delegate { tflite {} }"}}));
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("tensor_out", &graph_config, &output_packets);
+  CalculatorGraph graph(graph_config);
+  MP_ASSERT_OK(graph.SetServiceObject(
+      kInferenceBatchingService, std::make_shared<InferenceBatchingService>()));
+  MP_ASSERT_OK(graph.StartRun({}));
+  auto input_vec = absl::make_unique<std::vector<Tensor>>();
+  input_vec->emplace_back(Tensor::ElementType::kFloat32,
+                          Tensor::Shape{1, 8, 8, 3});
+  {
+    auto view = input_vec->back().GetCpuWriteView();
+    std::fill_n(view.buffer<float>(), 8 * 8 * 3, 1.0f);
+  }
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "tensor_in", Adopt(input_vec.release()).At(Timestamp(0))));
+  MP_ASSERT_OK(graph.CloseInputStream("tensor_in"));
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  ASSERT_EQ(output_packets.size(), 1);
+  const auto& result = output_packets[0].Get<std::vector<Tensor>>();
+  ASSERT_EQ(result.size(), 1);
+  auto view = result[0].GetCpuReadView();
+  EXPECT_THAT(std::vector<float>(view.buffer<float>(),
+                                 view.buffer<float>() + 8 * 8 * 3),
+              testing::Each(3.0f));
 }
 
 TEST(InferenceCalculatorTest, SmokeTest_ModelAsInputSidePacket) {
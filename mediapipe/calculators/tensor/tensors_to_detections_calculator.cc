@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <unordered_map>
 #include <vector>
 
@@ -27,6 +30,13 @@
 #include "mediapipe/framework/formats/tensor.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/util/non_max_suppression.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 // Note: On Apple platforms MEDIAPIPE_DISABLE_GL_COMPUTE is automatically
 // defined in mediapipe/framework/port.h. Therefore,
@@ -91,6 +101,103 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
   }
 }
 
+float Sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+// Returns a bound such that raw scores below it can not pass
+// min_score_thresh, after clipping and sigmoid as configured in "options".
+float GetMinCandidateRawScore(
+    const ::mediapipe::TensorsToDetectionsCalculatorOptions& options) {
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+  if (!options.has_min_score_thresh()) return -kInfinity;
+  const float min_score = options.min_score_thresh();
+  if (!options.sigmoid_score()) return min_score;
+
+  float min_raw_score = -kInfinity;
+  if (min_score > 0.0f && min_score < 1.0f) {
+    // Walk down from the logit of the threshold to the first value whose
+    // (rounded) sigmoid is below the threshold, so that the bound is exact.
+    constexpr int kMaxSteps = 1 << 20;
+    float raw_score = std::log(min_score) - std::log1p(-min_score);
+    int steps = 0;
+    while (Sigmoid(raw_score) >= min_score && steps < kMaxSteps) {
+      raw_score = std::nextafter(raw_score, -kInfinity);
+      ++steps;
+    }
+    if (steps < kMaxSteps) {
+      min_raw_score = std::nextafter(raw_score, kInfinity);
+    }
+  }
+  if (options.has_score_clipping_thresh()) {
+    const float clipping_thresh = options.score_clipping_thresh();
+    if (-clipping_thresh >= min_raw_score) return -kInfinity;
+    if (clipping_thresh < min_raw_score) return kInfinity;
+  }
+  return min_raw_score;
+}
+
+// Appends the indices of all boxes with at least one of their "num_classes"
+// raw scores greater than or equal to "min_raw_score" to "boxes", in
+// increasing order.
+void FindCandidateBoxes(const float* raw_scores, int num_boxes,
+                        int num_classes, float min_raw_score,
+                        std::vector<int>* boxes) {
+  const int size = num_boxes * num_classes;
+  auto add_candidates = [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      if (raw_scores[i] < min_raw_score) continue;
+      const int box = i / num_classes;
+      if (boxes->empty() || boxes->back() != box) boxes->push_back(box);
+    }
+  };
+  int i = 0;
+#if defined(__SSE2__)
+  const __m128 threshold = _mm_set1_ps(min_raw_score);
+  for (; i + 4 <= size; i += 4) {
+    const __m128 scores = _mm_loadu_ps(raw_scores + i);
+    if (_mm_movemask_ps(_mm_cmpge_ps(scores, threshold)) != 0) {
+      add_candidates(i, i + 4);
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const float32x4_t threshold = vdupq_n_f32(min_raw_score);
+  for (; i + 4 <= size; i += 4) {
+    const float32x4_t scores = vld1q_f32(raw_scores + i);
+    if (vmaxvq_u32(vcgeq_f32(scores, threshold)) != 0) {
+      add_candidates(i, i + 4);
+    }
+  }
+#endif
+  add_candidates(i, size);
+}
+
+NmsOptions::OverlapType GetOverlapType(
+    TensorsToDetectionsCalculatorOptions::NonMaxSuppression::OverlapType
+        overlap_type) {
+  switch (overlap_type) {
+    case TensorsToDetectionsCalculatorOptions::NonMaxSuppression::
+        MODIFIED_JACCARD:
+      return NmsOptions::OverlapType::kModifiedJaccard;
+    case TensorsToDetectionsCalculatorOptions::NonMaxSuppression::
+        INTERSECTION_OVER_UNION:
+      return NmsOptions::OverlapType::kIntersectionOverUnion;
+    default:
+      return NmsOptions::OverlapType::kJaccard;
+  }
+}
+
+NmsOptions::Algorithm GetAlgorithm(
+    TensorsToDetectionsCalculatorOptions::NonMaxSuppression::NmsAlgorithm
+        algorithm) {
+  switch (algorithm) {
+    case TensorsToDetectionsCalculatorOptions::NonMaxSuppression::WEIGHTED:
+      return NmsOptions::Algorithm::kWeighted;
+    case TensorsToDetectionsCalculatorOptions::NonMaxSuppression::SOFT:
+      return NmsOptions::Algorithm::kSoft;
+    default:
+      return NmsOptions::Algorithm::kHard;
+  }
+}
+
 }  // namespace
 
 // Convert result Tensors from object detection models into MediaPipe
@@ -117,6 +224,12 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
 // Output:
 //  DETECTIONS - Result MediaPipe detections.
 //
+// If the non_max_suppression option is set, the detections are also
+// non-maximum suppressed. On CPU this is fused with decoding: a vectorized
+// pass over the raw scores finds the boxes that can pass min_score_thresh, and
+// only those are scored, decoded and suppressed. Only the surviving boxes are
+// converted to Detection protos.
+//
 // Usage example:
 // node {
 //   calculator: "TensorsToDetectionsCalculator"
@@ -157,12 +270,19 @@ class TensorsToDetectionsCalculator : public Node {
                           std::vector<Detection>* output_detections);
   absl::Status ProcessGPU(CalculatorContext* cc,
                           std::vector<Detection>* output_detections);
+  absl::Status ProcessFusedCPU(const float* raw_boxes, const float* raw_scores,
+                               std::vector<Detection>* output_detections);
 
   absl::Status LoadOptions(CalculatorContext* cc);
   absl::Status GpuInit(CalculatorContext* cc);
   absl::Status DecodeBoxes(const float* raw_boxes,
                            const std::vector<Anchor>& anchors,
                            std::vector<float>* boxes);
+  // Decodes the "num_coords_" values of box "i" into "box".
+  void DecodeBox(const float* raw_boxes, const std::vector<Anchor>& anchors,
+                 int i, float* box);
+  // Computes the score and class of a box from its "num_classes_" raw scores.
+  void ScoreBox(const float* raw_scores, float* score, int* class_id);
   absl::Status ConvertToDetections(const float* detection_boxes,
                                    const float* detection_scores,
                                    const int* detection_classes,
@@ -170,6 +290,15 @@ class TensorsToDetectionsCalculator : public Node {
   Detection ConvertToDetection(float box_ymin, float box_xmin, float box_ymax,
                                float box_xmax, float score, int class_id,
                                bool flip_vertically);
+  void AddKeypoints(const float* box, Detection* detection);
+  // Keeps the max_num_candidates highest scoring candidates.
+  void SelectTopCandidates();
+  // Suppresses the candidates and converts the remaining ones to detections.
+  void SuppressCandidates(std::vector<Detection>* output_detections);
+  // Sets the location of "detection" to the average of weighted NMS cluster
+  // "k".
+  void SetWeightedLocation(const NmsResult& result, int k,
+                           Detection* detection);
 
   int num_classes_ = 0;
   int num_boxes_ = 0;
@@ -179,6 +308,15 @@ class TensorsToDetectionsCalculator : public Node {
   ::mediapipe::TensorsToDetectionsCalculatorOptions options_;
   std::vector<Anchor> anchors_;
 
+  // Non-maximum suppression state, reused across calls.
+  NmsOptions nms_options_;
+  float min_candidate_raw_score_ = 0.0f;
+  std::vector<int> candidate_indices_;
+  std::vector<float> candidate_scores_;
+  std::vector<int> candidate_classes_;
+  std::vector<float> candidate_boxes_;
+  NmsBoxes nms_boxes_;
+
 #ifndef MEDIAPIPE_DISABLE_GL_COMPUTE
   mediapipe::GlCalculatorHelper gpu_helper_;
   GLuint decode_program_;
@@ -295,6 +433,9 @@ absl::Status TensorsToDetectionsCalculator::ProcessCPU(
       }
       anchors_init_ = true;
     }
+    if (options_.has_non_max_suppression()) {
+      return ProcessFusedCPU(raw_boxes, raw_scores, output_detections);
+    }
     std::vector<float> boxes(num_boxes_ * num_coords_);
     MP_RETURN_IF_ERROR(DecodeBoxes(raw_boxes, anchors_, &boxes));
 
@@ -303,31 +444,8 @@ absl::Status TensorsToDetectionsCalculator::ProcessCPU(
 
     // Filter classes by scores.
     for (int i = 0; i < num_boxes_; ++i) {
-      int class_id = -1;
-      float max_score = -std::numeric_limits<float>::max();
-      // Find the top score for box i.
-      for (int score_idx = 0; score_idx < num_classes_; ++score_idx) {
-        if (ignore_classes_.find(score_idx) == ignore_classes_.end()) {
-          auto score = raw_scores[i * num_classes_ + score_idx];
-          if (options_.sigmoid_score()) {
-            if (options_.has_score_clipping_thresh()) {
-              score = score < -options_.score_clipping_thresh()
-                          ? -options_.score_clipping_thresh()
-                          : score;
-              score = score > options_.score_clipping_thresh()
-                          ? options_.score_clipping_thresh()
-                          : score;
-            }
-            score = 1.0f / (1.0f + std::exp(-score));
-          }
-          if (max_score < score) {
-            max_score = score;
-            class_id = score_idx;
-          }
-        }
-      }
-      detection_scores[i] = max_score;
-      detection_classes[i] = class_id;
+      ScoreBox(raw_scores + i * num_classes_, &detection_scores[i],
+               &detection_classes[i]);
     }
 
     MP_RETURN_IF_ERROR(
@@ -381,6 +499,44 @@ absl::Status TensorsToDetectionsCalculator::ProcessCPU(
   return absl::OkStatus();
 }
 
+absl::Status TensorsToDetectionsCalculator::ProcessFusedCPU(
+    const float* raw_boxes, const float* raw_scores,
+    std::vector<Detection>* output_detections) {
+  candidate_indices_.clear();
+  candidate_scores_.clear();
+  candidate_classes_.clear();
+  // Only score the boxes which can pass the threshold.
+  std::vector<int> box_indices;
+  if (options_.has_min_score_thresh()) {
+    FindCandidateBoxes(raw_scores, num_boxes_, num_classes_,
+                       min_candidate_raw_score_, &box_indices);
+  } else {
+    box_indices.resize(num_boxes_);
+    for (int i = 0; i < num_boxes_; ++i) box_indices[i] = i;
+  }
+  for (int i : box_indices) {
+    float score;
+    int class_id;
+    ScoreBox(raw_scores + i * num_classes_, &score, &class_id);
+    if (options_.has_min_score_thresh() &&
+        score < options_.min_score_thresh()) {
+      continue;
+    }
+    candidate_indices_.push_back(i);
+    candidate_scores_.push_back(score);
+    candidate_classes_.push_back(class_id);
+  }
+  SelectTopCandidates();
+
+  candidate_boxes_.resize(candidate_indices_.size() * num_coords_);
+  for (int k = 0; k < candidate_indices_.size(); ++k) {
+    DecodeBox(raw_boxes, anchors_, candidate_indices_[k],
+              &candidate_boxes_[k * num_coords_]);
+  }
+  SuppressCandidates(output_detections);
+  return absl::OkStatus();
+}
+
 absl::Status TensorsToDetectionsCalculator::ProcessGPU(
     CalculatorContext* cc, std::vector<Detection>* output_detections) {
   const auto& input_tensors = *kInTensors(cc);
@@ -589,6 +745,22 @@ absl::Status TensorsToDetectionsCalculator::LoadOptions(CalculatorContext* cc) {
     }
   }
 
+  if (options_.has_non_max_suppression()) {
+    const auto& nms = options_.non_max_suppression();
+    RET_CHECK_NE(nms.max_num_detections(), 0)
+        << "max_num_detections=0 is not a valid value. Set -1 for no limit.";
+    RET_CHECK_NE(nms.max_num_candidates(), 0)
+        << "max_num_candidates=0 is not a valid value. Set -1 for no limit.";
+    nms_options_.algorithm = GetAlgorithm(nms.algorithm());
+    nms_options_.overlap_type = GetOverlapType(nms.overlap_type());
+    nms_options_.min_suppression_threshold = nms.min_suppression_threshold();
+    nms_options_.min_score_threshold =
+        options_.has_min_score_thresh() ? options_.min_score_thresh() : -1.0f;
+    nms_options_.max_num_detections = nms.max_num_detections();
+    nms_options_.soft_nms_sigma = nms.soft_nms_sigma();
+    min_candidate_raw_score_ = GetMinCandidateRawScore(options_);
+  }
+
   return absl::OkStatus();
 }
 
@@ -596,69 +768,126 @@ absl::Status TensorsToDetectionsCalculator::DecodeBoxes(
     const float* raw_boxes, const std::vector<Anchor>& anchors,
     std::vector<float>* boxes) {
   for (int i = 0; i < num_boxes_; ++i) {
-    const int box_offset = i * num_coords_ + options_.box_coord_offset();
-
-    float y_center = raw_boxes[box_offset];
-    float x_center = raw_boxes[box_offset + 1];
-    float h = raw_boxes[box_offset + 2];
-    float w = raw_boxes[box_offset + 3];
-    if (options_.reverse_output_order()) {
-      x_center = raw_boxes[box_offset];
-      y_center = raw_boxes[box_offset + 1];
-      w = raw_boxes[box_offset + 2];
-      h = raw_boxes[box_offset + 3];
-    }
+    DecodeBox(raw_boxes, anchors, i, boxes->data() + i * num_coords_);
+  }
+
+  return absl::OkStatus();
+}
 
-    x_center =
-        x_center / options_.x_scale() * anchors[i].w() + anchors[i].x_center();
-    y_center =
-        y_center / options_.y_scale() * anchors[i].h() + anchors[i].y_center();
+void TensorsToDetectionsCalculator::DecodeBox(
+    const float* raw_boxes, const std::vector<Anchor>& anchors, int i,
+    float* box) {
+  const int box_offset = i * num_coords_ + options_.box_coord_offset();
+
+  float y_center = raw_boxes[box_offset];
+  float x_center = raw_boxes[box_offset + 1];
+  float h = raw_boxes[box_offset + 2];
+  float w = raw_boxes[box_offset + 3];
+  if (options_.reverse_output_order()) {
+    x_center = raw_boxes[box_offset];
+    y_center = raw_boxes[box_offset + 1];
+    w = raw_boxes[box_offset + 2];
+    h = raw_boxes[box_offset + 3];
+  }
 
-    if (options_.apply_exponential_on_box_size()) {
-      h = std::exp(h / options_.h_scale()) * anchors[i].h();
-      w = std::exp(w / options_.w_scale()) * anchors[i].w();
-    } else {
-      h = h / options_.h_scale() * anchors[i].h();
-      w = w / options_.w_scale() * anchors[i].w();
-    }
+  x_center =
+      x_center / options_.x_scale() * anchors[i].w() + anchors[i].x_center();
+  y_center =
+      y_center / options_.y_scale() * anchors[i].h() + anchors[i].y_center();
 
-    const float ymin = y_center - h / 2.f;
-    const float xmin = x_center - w / 2.f;
-    const float ymax = y_center + h / 2.f;
-    const float xmax = x_center + w / 2.f;
-
-    (*boxes)[i * num_coords_ + 0] = ymin;
-    (*boxes)[i * num_coords_ + 1] = xmin;
-    (*boxes)[i * num_coords_ + 2] = ymax;
-    (*boxes)[i * num_coords_ + 3] = xmax;
-
-    if (options_.num_keypoints()) {
-      for (int k = 0; k < options_.num_keypoints(); ++k) {
-        const int offset = i * num_coords_ + options_.keypoint_coord_offset() +
-                           k * options_.num_values_per_keypoint();
-
-        float keypoint_y = raw_boxes[offset];
-        float keypoint_x = raw_boxes[offset + 1];
-        if (options_.reverse_output_order()) {
-          keypoint_x = raw_boxes[offset];
-          keypoint_y = raw_boxes[offset + 1];
-        }
+  if (options_.apply_exponential_on_box_size()) {
+    h = std::exp(h / options_.h_scale()) * anchors[i].h();
+    w = std::exp(w / options_.w_scale()) * anchors[i].w();
+  } else {
+    h = h / options_.h_scale() * anchors[i].h();
+    w = w / options_.w_scale() * anchors[i].w();
+  }
 
-        (*boxes)[offset] = keypoint_x / options_.x_scale() * anchors[i].w() +
-                           anchors[i].x_center();
-        (*boxes)[offset + 1] =
-            keypoint_y / options_.y_scale() * anchors[i].h() +
-            anchors[i].y_center();
+  const float ymin = y_center - h / 2.f;
+  const float xmin = x_center - w / 2.f;
+  const float ymax = y_center + h / 2.f;
+  const float xmax = x_center + w / 2.f;
+
+  box[0] = ymin;
+  box[1] = xmin;
+  box[2] = ymax;
+  box[3] = xmax;
+
+  if (options_.num_keypoints()) {
+    for (int k = 0; k < options_.num_keypoints(); ++k) {
+      const int keypoint_offset = options_.keypoint_coord_offset() +
+                                  k * options_.num_values_per_keypoint();
+      const int offset = i * num_coords_ + keypoint_offset;
+
+      float keypoint_y = raw_boxes[offset];
+      float keypoint_x = raw_boxes[offset + 1];
+      if (options_.reverse_output_order()) {
+        keypoint_x = raw_boxes[offset];
+        keypoint_y = raw_boxes[offset + 1];
       }
+
+      box[keypoint_offset] = keypoint_x / options_.x_scale() * anchors[i].w() +
+                             anchors[i].x_center();
+      box[keypoint_offset + 1] =
+          keypoint_y / options_.y_scale() * anchors[i].h() +
+          anchors[i].y_center();
     }
   }
+}
 
-  return absl::OkStatus();
+void TensorsToDetectionsCalculator::ScoreBox(const float* raw_scores,
+                                             float* score, int* class_id) {
+  *class_id = -1;
+  *score = -std::numeric_limits<float>::max();
+  // Find the top score for the box.
+  for (int score_idx = 0; score_idx < num_classes_; ++score_idx) {
+    if (ignore_classes_.find(score_idx) == ignore_classes_.end()) {
+      auto class_score = raw_scores[score_idx];
+      if (options_.sigmoid_score()) {
+        if (options_.has_score_clipping_thresh()) {
+          class_score = class_score < -options_.score_clipping_thresh()
+                            ? -options_.score_clipping_thresh()
+                            : class_score;
+          class_score = class_score > options_.score_clipping_thresh()
+                            ? options_.score_clipping_thresh()
+                            : class_score;
+        }
+        class_score = Sigmoid(class_score);
+      }
+      if (*score < class_score) {
+        *score = class_score;
+        *class_id = score_idx;
+      }
+    }
+  }
 }
 
 absl::Status TensorsToDetectionsCalculator::ConvertToDetections(
     const float* detection_boxes, const float* detection_scores,
     const int* detection_classes, std::vector<Detection>* output_detections) {
+  if (options_.has_non_max_suppression()) {
+    candidate_indices_.clear();
+    candidate_scores_.clear();
+    candidate_classes_.clear();
+    for (int i = 0; i < num_boxes_; ++i) {
+      if (options_.has_min_score_thresh() &&
+          detection_scores[i] < options_.min_score_thresh()) {
+        continue;
+      }
+      candidate_indices_.push_back(i);
+      candidate_scores_.push_back(detection_scores[i]);
+      candidate_classes_.push_back(detection_classes[i]);
+    }
+    SelectTopCandidates();
+    candidate_boxes_.resize(candidate_indices_.size() * num_coords_);
+    for (int k = 0; k < candidate_indices_.size(); ++k) {
+      std::copy_n(detection_boxes + candidate_indices_[k] * num_coords_,
+                  num_coords_, &candidate_boxes_[k * num_coords_]);
+    }
+    SuppressCandidates(output_detections);
+    return absl::OkStatus();
+  }
+
   for (int i = 0; i < num_boxes_; ++i) {
     if (options_.has_min_score_thresh() &&
         detection_scores[i] < options_.min_score_thresh()) {
@@ -676,26 +905,139 @@ absl::Status TensorsToDetectionsCalculator::ConvertToDetections(
       // calculators may assume non-negative values. (b/171391719)
       continue;
     }
-    // Add keypoints.
-    if (options_.num_keypoints() > 0) {
-      auto* location_data = detection.mutable_location_data();
-      for (int kp_id = 0; kp_id < options_.num_keypoints() *
-                                      options_.num_values_per_keypoint();
-           kp_id += options_.num_values_per_keypoint()) {
-        auto keypoint = location_data->add_relative_keypoints();
-        const int keypoint_index =
-            box_offset + options_.keypoint_coord_offset() + kp_id;
-        keypoint->set_x(detection_boxes[keypoint_index + 0]);
-        keypoint->set_y(options_.flip_vertically()
-                            ? 1.f - detection_boxes[keypoint_index + 1]
-                            : detection_boxes[keypoint_index + 1]);
-      }
-    }
+    AddKeypoints(detection_boxes + box_offset, &detection);
     output_detections->emplace_back(detection);
   }
   return absl::OkStatus();
 }
 
+void TensorsToDetectionsCalculator::AddKeypoints(const float* box,
+                                                 Detection* detection) {
+  if (options_.num_keypoints() == 0) return;
+  auto* location_data = detection->mutable_location_data();
+  for (int kp_id = 0;
+       kp_id < options_.num_keypoints() * options_.num_values_per_keypoint();
+       kp_id += options_.num_values_per_keypoint()) {
+    auto keypoint = location_data->add_relative_keypoints();
+    const int keypoint_index = options_.keypoint_coord_offset() + kp_id;
+    keypoint->set_x(box[keypoint_index + 0]);
+    keypoint->set_y(options_.flip_vertically() ? 1.f - box[keypoint_index + 1]
+                                               : box[keypoint_index + 1]);
+  }
+}
+
+void TensorsToDetectionsCalculator::SelectTopCandidates() {
+  const int max_num_candidates =
+      options_.non_max_suppression().max_num_candidates();
+  if (max_num_candidates < 0 ||
+      candidate_indices_.size() <= max_num_candidates) {
+    return;
+  }
+  // Keep the highest scores, preferring lower box indices on ties, and then
+  // restore the box order so that suppression breaks ties as before.
+  std::vector<int> order(candidate_indices_.size());
+  for (int k = 0; k < order.size(); ++k) order[k] = k;
+  std::nth_element(order.begin(), order.begin() + max_num_candidates,
+                   order.end(), [this](int a, int b) {
+                     if (candidate_scores_[a] != candidate_scores_[b]) {
+                       return candidate_scores_[a] > candidate_scores_[b];
+                     }
+                     return a < b;
+                   });
+  order.resize(max_num_candidates);
+  std::sort(order.begin(), order.end());
+  for (int k = 0; k < max_num_candidates; ++k) {
+    candidate_indices_[k] = candidate_indices_[order[k]];
+    candidate_scores_[k] = candidate_scores_[order[k]];
+    candidate_classes_[k] = candidate_classes_[order[k]];
+  }
+  candidate_indices_.resize(max_num_candidates);
+  candidate_scores_.resize(max_num_candidates);
+  candidate_classes_.resize(max_num_candidates);
+}
+
+void TensorsToDetectionsCalculator::SuppressCandidates(
+    std::vector<Detection>* output_detections) {
+  const bool flip_vertically = options_.flip_vertically();
+  // Drop boxes with negative width or height, as ConvertToDetections() does,
+  // and compute the boxes in output coordinates exactly as
+  // NonMaxSuppressionCalculator would from the detections.
+  nms_boxes_.Clear();
+  nms_boxes_.Reserve(candidate_indices_.size());
+  int num_candidates = 0;
+  for (int k = 0; k < candidate_indices_.size(); ++k) {
+    const float* box = &candidate_boxes_[k * num_coords_];
+    const float width = box[3] - box[1];
+    const float height = box[2] - box[0];
+    if (width < 0 || height < 0) continue;
+    const float xmin = box[1];
+    const float ymin = flip_vertically ? 1.f - box[2] : box[0];
+    nms_boxes_.Add(xmin, ymin, xmin + width, ymin + height,
+                   candidate_scores_[k]);
+    if (k != num_candidates) {
+      std::copy_n(box, num_coords_,
+                  &candidate_boxes_[num_candidates * num_coords_]);
+      candidate_scores_[num_candidates] = candidate_scores_[k];
+      candidate_classes_[num_candidates] = candidate_classes_[k];
+    }
+    ++num_candidates;
+  }
+  if (num_candidates == 0) return;
+
+  const NmsResult result = NonMaxSuppression(nms_boxes_, nms_options_);
+  output_detections->reserve(output_detections->size() +
+                             result.indices.size());
+  for (int k = 0; k < result.indices.size(); ++k) {
+    const int index = result.indices[k];
+    const float* box = &candidate_boxes_[index * num_coords_];
+    Detection detection = ConvertToDetection(
+        box[0], box[1], box[2], box[3], candidate_scores_[index],
+        candidate_classes_[index], flip_vertically);
+    AddKeypoints(box, &detection);
+    if (nms_options_.algorithm == NmsOptions::Algorithm::kSoft) {
+      detection.set_score(0, result.scores[k]);
+    } else if (nms_options_.algorithm == NmsOptions::Algorithm::kWeighted) {
+      SetWeightedLocation(result, k, &detection);
+    }
+    output_detections->push_back(std::move(detection));
+  }
+}
+
+void TensorsToDetectionsCalculator::SetWeightedLocation(
+    const NmsResult& result, int k, Detection* detection) {
+  const int begin = result.cluster_offsets[k];
+  const int end = result.cluster_offsets[k + 1];
+  if (begin == end) return;
+  auto* location_data = detection->mutable_location_data();
+  auto* bbox = location_data->mutable_relative_bounding_box();
+  bbox->set_xmin(result.weighted_boxes.xmin[k]);
+  bbox->set_ymin(result.weighted_boxes.ymin[k]);
+  bbox->set_width(result.weighted_boxes.xmax[k] - bbox->xmin());
+  bbox->set_height(result.weighted_boxes.ymax[k] - bbox->ymin());
+
+  // Average the keypoints of the cluster, in output coordinates.
+  for (int kp = 0; kp < location_data->relative_keypoints_size(); ++kp) {
+    const int keypoint_index = options_.keypoint_coord_offset() +
+                               kp * options_.num_values_per_keypoint();
+    float x = 0.0f;
+    float y = 0.0f;
+    float total_score = 0.0f;
+    for (int m = begin; m < end; ++m) {
+      const int member = result.cluster_members[m];
+      const float* box = &candidate_boxes_[member * num_coords_];
+      const float score = candidate_scores_[member];
+      total_score += score;
+      x += box[keypoint_index] * score;
+      y += (options_.flip_vertically() ? 1.f - box[keypoint_index + 1]
+                                       : box[keypoint_index + 1]) *
+           score;
+    }
+    auto* keypoint = location_data->mutable_relative_keypoints(kp);
+    keypoint->set_x(x / total_score);
+    keypoint->set_y(y / total_score);
+  }
+}
+
 Detection TensorsToDetectionsCalculator::ConvertToDetection(
     float box_ymin, float box_xmin, float box_ymax, float box_xmax, float score,
     int class_id, bool flip_vertically) {
@@ -0,0 +1,307 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/deps/message_matchers.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/formats/object_detection/anchor.pb.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/sink.h"
+
+namespace mediapipe {
+namespace {
+
+// A palm detection like model: one class, 7 keypoints, raw boxes relative to
+// a 128x128 input.
+constexpr int kNumCoords = 18;
+constexpr char kDecodingOptions[] = R"(
+      num_classes: 1
+      num_boxes: $0
+      num_coords: 18
+      box_coord_offset: 0
+      keypoint_coord_offset: 4
+      num_keypoints: 7
+      num_values_per_keypoint: 2
+      sigmoid_score: true
+      score_clipping_thresh: 100.0
+      reverse_output_order: true
+      x_scale: 128.0
+      y_scale: 128.0
+      h_scale: 128.0
+      w_scale: 128.0
+      flip_vertically: $1
+      min_score_thresh: $2
+)";
+
+// Returns a graph decoding the "tensors" input stream into "detections", with
+// a fused non-maximum suppression if "fused", and with a separate
+// NonMaxSuppressionCalculator otherwise.
+CalculatorGraphConfig MakeGraph(int num_boxes, bool flip_vertically,
+                                float min_score_thresh,
+                                const std::string& nms_options, bool fused) {
+  const std::string decoding_options =
+      absl::Substitute(kDecodingOptions, num_boxes,
+                       flip_vertically ? "true" : "false", min_score_thresh);
+  if (fused) {
+    return ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+        R"pb(
+          input_stream: "tensors"
+          input_side_packet: "anchors"
+          node {
+            calculator: "TensorsToDetectionsCalculator"
+            input_stream: "TENSORS:tensors"
+            input_side_packet: "ANCHORS:anchors"
+            output_stream: "DETECTIONS:detections"
+            options: {
+              [mediapipe.TensorsToDetectionsCalculatorOptions.ext] {
+                $0
+                non_max_suppression { $1 }
+              }
+            }
+          }
+        )pb",
+        decoding_options, nms_options));
+  }
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+      R"pb(
+        input_stream: "tensors"
+        input_side_packet: "anchors"
+        node {
+          calculator: "TensorsToDetectionsCalculator"
+          input_stream: "TENSORS:tensors"
+          input_side_packet: "ANCHORS:anchors"
+          output_stream: "DETECTIONS:unfiltered_detections"
+          options: {
+            [mediapipe.TensorsToDetectionsCalculatorOptions.ext] { $0 }
+          }
+        }
+        node {
+          calculator: "NonMaxSuppressionCalculator"
+          input_stream: "unfiltered_detections"
+          output_stream: "detections"
+          options: {
+            [mediapipe.NonMaxSuppressionCalculatorOptions.ext] {
+              min_score_threshold: $2
+              $1
+            }
+          }
+        }
+      )pb",
+      decoding_options, nms_options, min_score_thresh));
+}
+
+std::vector<Anchor> MakeAnchors(int num_boxes) {
+  std::vector<Anchor> anchors(num_boxes);
+  for (int i = 0; i < num_boxes; ++i) {
+    const int cell = i / 2;
+    anchors[i].set_x_center(((cell % 16) + 0.5f) / 16.0f);
+    anchors[i].set_y_center((((cell / 16) % 16) + 0.5f) / 16.0f);
+    anchors[i].set_w(1.0f);
+    anchors[i].set_h(1.0f);
+  }
+  return anchors;
+}
+
+// Returns raw boxes and scores around a few objects: most scores are low, and
+// the boxes of the anchors close to an object overlap.
+std::vector<Tensor> MakeTensors(const std::vector<Anchor>& anchors, int seed) {
+  const int num_boxes = anchors.size();
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<Tensor> tensors;
+  tensors.emplace_back(Tensor::ElementType::kFloat32,
+                       Tensor::Shape{1, num_boxes, kNumCoords});
+  tensors.emplace_back(Tensor::ElementType::kFloat32,
+                       Tensor::Shape{1, num_boxes, 1});
+  auto boxes_view = tensors[0].GetCpuWriteView();
+  auto scores_view = tensors[1].GetCpuWriteView();
+  float* raw_boxes = boxes_view.buffer<float>();
+  float* raw_scores = scores_view.buffer<float>();
+  const float objects[3][2] = {{0.3f, 0.3f}, {0.7f, 0.4f}, {0.5f, 0.8f}};
+  for (int i = 0; i < num_boxes; ++i) {
+    float* box = raw_boxes + i * kNumCoords;
+    float min_distance = 1.0f;
+    for (const auto& object : objects) {
+      const float dx = object[0] - anchors[i].x_center();
+      const float dy = object[1] - anchors[i].y_center();
+      min_distance = std::min(min_distance, std::sqrt(dx * dx + dy * dy));
+    }
+    // Boxes are in reversed order: x_center, y_center, w, h.
+    box[0] = 128.0f * 0.02f * (unit(rng) - 0.5f);
+    box[1] = 128.0f * 0.02f * (unit(rng) - 0.5f);
+    box[2] = 128.0f * (0.15f + 0.05f * unit(rng));
+    box[3] = 128.0f * (0.15f + 0.05f * unit(rng));
+    for (int k = 4; k < kNumCoords; ++k) {
+      box[k] = 128.0f * 0.1f * (unit(rng) - 0.5f);
+    }
+    raw_scores[i] = 4.0f - 60.0f * min_distance + 2.0f * unit(rng);
+  }
+  return tensors;
+}
+
+std::vector<Detection> RunGraph(const CalculatorGraphConfig& config,
+                                const std::vector<Anchor>& anchors,
+                                int seed) {
+  CalculatorGraphConfig graph_config = config;
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("detections", &graph_config, &output_packets);
+  CalculatorGraph graph;
+  MP_EXPECT_OK(graph.Initialize(graph_config));
+  MP_EXPECT_OK(graph.StartRun({{"anchors", MakePacket<std::vector<Anchor>>(
+                                               anchors)}}));
+  MP_EXPECT_OK(graph.AddPacketToInputStream(
+      "tensors", MakePacket<std::vector<Tensor>>(MakeTensors(anchors, seed))
+                     .At(Timestamp(0))));
+  MP_EXPECT_OK(graph.CloseAllInputStreams());
+  MP_EXPECT_OK(graph.WaitUntilDone());
+  if (output_packets.empty()) return {};
+  EXPECT_EQ(output_packets.size(), 1);
+  return output_packets[0].Get<std::vector<Detection>>();
+}
+
+// Checks that fused suppression gives the same detections as a separate
+// NonMaxSuppressionCalculator.
+void ExpectFusedMatchesSeparate(const std::string& nms_options,
+                                bool flip_vertically,
+                                float min_score_thresh = 0.5f) {
+  constexpr int kNumBoxes = 2016;
+  const std::vector<Anchor> anchors = MakeAnchors(kNumBoxes);
+  for (int seed = 0; seed < 3; ++seed) {
+    const std::vector<Detection> expected =
+        RunGraph(MakeGraph(kNumBoxes, flip_vertically, min_score_thresh,
+                           nms_options, /*fused=*/false),
+                 anchors, seed);
+    const std::vector<Detection> fused =
+        RunGraph(MakeGraph(kNumBoxes, flip_vertically, min_score_thresh,
+                           nms_options, /*fused=*/true),
+                 anchors, seed);
+    EXPECT_FALSE(expected.empty());
+    ASSERT_EQ(fused.size(), expected.size()) << "seed=" << seed;
+    for (int i = 0; i < fused.size(); ++i) {
+      EXPECT_THAT(fused[i], EqualsProto(expected[i])) << "seed=" << seed;
+    }
+  }
+}
+
+TEST(TensorsToDetectionsCalculatorTest, FusedHardNmsMatchesSeparateNms) {
+  const std::string nms_options = R"(
+    min_suppression_threshold: 0.3
+    overlap_type: INTERSECTION_OVER_UNION
+  )";
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/false);
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/true);
+}
+
+TEST(TensorsToDetectionsCalculatorTest, FusedWeightedNmsMatchesSeparateNms) {
+  const std::string nms_options = R"(
+    min_suppression_threshold: 0.3
+    overlap_type: INTERSECTION_OVER_UNION
+    algorithm: WEIGHTED
+  )";
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/false);
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/true);
+}
+
+TEST(TensorsToDetectionsCalculatorTest, FusedSoftNmsMatchesSeparateNms) {
+  const std::string nms_options = R"(
+    overlap_type: JACCARD
+    algorithm: SOFT
+    max_num_detections: 5
+  )";
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/false);
+}
+
+TEST(TensorsToDetectionsCalculatorTest, FusedNmsScoreThresholdIsExact) {
+  // Nothing is suppressed, so that all boxes above the threshold are compared.
+  const std::string nms_options = R"(
+    min_suppression_threshold: 1.0
+    overlap_type: MODIFIED_JACCARD
+  )";
+  for (float min_score_thresh : {0.01f, 0.5f, 0.98f}) {
+    ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/false,
+                               min_score_thresh);
+  }
+}
+
+TEST(TensorsToDetectionsCalculatorTest, FusedNmsKeepsTopCandidates) {
+  constexpr int kNumBoxes = 896;
+  const std::vector<Anchor> anchors = MakeAnchors(kNumBoxes);
+  const std::vector<Detection> all = RunGraph(
+      MakeGraph(kNumBoxes, /*flip_vertically=*/false, 0.5f,
+                "min_suppression_threshold: 1.0", /*fused=*/true),
+      anchors, /*seed=*/0);
+  const std::vector<Detection> top = RunGraph(
+      MakeGraph(kNumBoxes, /*flip_vertically=*/false, 0.5f,
+                "min_suppression_threshold: 1.0 max_num_candidates: 4",
+                /*fused=*/true),
+      anchors, /*seed=*/0);
+  ASSERT_GT(all.size(), 4);
+  ASSERT_EQ(top.size(), 4);
+  for (int i = 0; i < top.size(); ++i) {
+    EXPECT_THAT(top[i], EqualsProto(all[i]));
+  }
+}
+
+void RunDecodingBenchmark(benchmark::State& state, bool fused) {
+  const int num_boxes = state.range(0);
+  const std::vector<Anchor> anchors = MakeAnchors(num_boxes);
+  CalculatorGraphConfig config =
+      MakeGraph(num_boxes, /*flip_vertically=*/false, 0.5f,
+                R"(min_suppression_threshold: 0.3
+                   overlap_type: INTERSECTION_OVER_UNION
+                   algorithm: WEIGHTED)",
+                fused);
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("detections", &config, &output_packets);
+  CalculatorGraph graph;
+  MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+  MEDIAPIPE_CHECK_OK(graph.StartRun(
+      {{"anchors", MakePacket<std::vector<Anchor>>(anchors)}}));
+  Packet tensors =
+      MakePacket<std::vector<Tensor>>(MakeTensors(anchors, /*seed=*/0));
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+        "tensors", tensors.At(Timestamp(timestamp++))));
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilIdle());
+    output_packets.clear();
+  }
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+}
+
+void BM_DecodeThenNms(benchmark::State& state) {
+  RunDecodingBenchmark(state, /*fused=*/false);
+}
+BENCHMARK(BM_DecodeThenNms)->Arg(896)->Arg(2016);
+
+void BM_FusedDecodeNms(benchmark::State& state) {
+  RunDecodingBenchmark(state, /*fused=*/true);
+}
+BENCHMARK(BM_FusedDecodeNms)->Arg(896)->Arg(2016);
+
+}  // namespace
+}  // namespace mediapipe
@@ -12,21 +12,19 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <memory>
 #include <vector>
 
 #include "absl/strings/str_format.h"
 #include "absl/types/span.h"
 #include "mediapipe/calculators/tensor/tensors_to_segmentation_calculator.pb.h"
+#include "mediapipe/calculators/tensor/tensors_to_segmentation_utils.h"
 #include "mediapipe/framework/calculator_context.h"
 #include "mediapipe/framework/calculator_framework.h"
 #include "mediapipe/framework/formats/image.h"
-
-#if !defined(__EMSCRIPTEN__)
-#include "mediapipe/framework/formats/image_opencv.h"
-#include "mediapipe/framework/port/opencv_imgproc_inc.h"
-#endif
-
+#include "mediapipe/framework/formats/image_frame_pool.h"
 #include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/tiled_mask.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/ret_check.h"
 #include "mediapipe/framework/port/statusor.h"
@@ -80,6 +78,10 @@ bool CanUseGpu() {
 constexpr char kTensorsTag[] = "TENSORS";
 constexpr char kOutputSizeTag[] = "OUTPUT_SIZE";
 constexpr char kMaskTag[] = "MASK";
+constexpr char kTiledMaskTag[] = "TILED_MASK";
+
+// Number of CPU masks kept for reuse by the mask pool.
+constexpr int kMaskPoolKeepCount = 2;
 
 absl::StatusOr<std::tuple<int, int, int>> GetHwcFromDims(
     const std::vector<int>& dims) {
@@ -112,7 +114,10 @@ using ::tflite::gpu::gl::GlShader;
 // mask are both on CPU.
 //
 // On GPU, the mask is an RGBA image, in both the R & A channels, scaled 0-1.
-// On CPU, the mask is a ImageFormat::VEC32F1 image, with values scaled 0-1.
+// On CPU, the mask is a ImageFormat::VEC32F1 image, with values scaled 0-1, or
+// a ImageFormat::GRAY8 image with values scaled 0-255 if output_uint8_mask is
+// set. The CPU path applies the activation and the bilinear upscale in a
+// single vectorized pass, and reuses mask buffers from a pool.
 //
 //
 // Inputs:
@@ -123,7 +128,11 @@ using ::tflite::gpu::gl::GlShader;
 //                          If provided, the size to upscale mask to.
 //
 // Output:
-//   MASK: An Image output mask, RGBA(GPU) / VEC32F1(CPU).
+//   At least one of the following:
+//   MASK: An Image output mask, RGBA(GPU) / VEC32F1 or GRAY8(CPU).
+//   TILED_MASK: A TiledMask with values scaled 0-255 (CPU only). Uniform
+//               background and foreground tiles take one byte each, which
+//               makes the packet much smaller than MASK for typical masks.
 //
 // Options:
 //   See tensors_to_segmentation_calculator.proto
@@ -164,13 +173,11 @@ class TensorsToSegmentationCalculator : public CalculatorBase {
     return options_.gpu_origin() != mediapipe::GpuOrigin_Mode_TOP_LEFT;
   }
 
-  #if !defined(__EMSCRIPTEN__)
-    template <class T>
-    absl::Status ApplyActivation(cv::Mat& tensor_mat, cv::Mat* small_mask_mat);
-  #endif // !defined(__EMSCRIPTEN__)
-
   ::mediapipe::TensorsToSegmentationCalculatorOptions options_;
 
+  MaskResizer mask_resizer_;
+  std::shared_ptr<ImageFramePool> mask_pool_;
+
 #if !MEDIAPIPE_DISABLE_GPU
   mediapipe::GlCalculatorHelper gpu_helper_;
   GLuint upsample_program_;
@@ -200,7 +207,15 @@ absl::Status TensorsToSegmentationCalculator::GetContract(
   }
 
   // Outputs.
-  cc->Outputs().Tag(kMaskTag).Set<Image>();
+  RET_CHECK(cc->Outputs().HasTag(kMaskTag) ||
+            cc->Outputs().HasTag(kTiledMaskTag))
+      << "At least one of MASK or TILED_MASK outputs is required.";
+  if (cc->Outputs().HasTag(kMaskTag)) {
+    cc->Outputs().Tag(kMaskTag).Set<Image>();
+  }
+  if (cc->Outputs().HasTag(kTiledMaskTag)) {
+    cc->Outputs().Tag(kTiledMaskTag).Set<TiledMask>();
+  }
 
   if (CanUseGpu()) {
 #if !MEDIAPIPE_DISABLE_GPU
@@ -287,6 +302,8 @@ absl::Status TensorsToSegmentationCalculator::Process(CalculatorContext* cc) {
   }
 
   if (use_gpu) {
+    RET_CHECK(!cc->Outputs().HasTag(kTiledMaskTag))
+        << "TILED_MASK is only supported on CPU.";
 #if !MEDIAPIPE_DISABLE_GPU
     MP_RETURN_IF_ERROR(gpu_helper_.RunInGlContext([this, cc]() -> absl::Status {
       MP_RETURN_IF_ERROR(ProcessGpu(cc));
@@ -337,102 +354,57 @@ absl::Status TensorsToSegmentationCalculator::ProcessCpu(
     output_height = size.second;
   }
 
-  #if !defined(__EMSCRIPTEN__)
-  
-  // Create initial working mask.
-  cv::Mat small_mask_mat(cv::Size(tensor_width, tensor_height), CV_32FC1);
-
-  // Wrap input tensor.
-  auto raw_input_tensor = &input_tensors[0];
-  auto raw_input_view = raw_input_tensor->GetCpuReadView();
-  const float* raw_input_data = raw_input_view.buffer<float>();
-  cv::Mat tensor_mat(cv::Size(tensor_width, tensor_height),
-                     CV_MAKETYPE(CV_32F, tensor_channels),
-                     const_cast<float*>(raw_input_data));
-
-  // Process mask tensor and apply activation function.
-  if (tensor_channels == 2) {
-    MP_RETURN_IF_ERROR(ApplyActivation<cv::Vec2f>(tensor_mat, &small_mask_mat));
-  } else if (tensor_channels == 1) {
-    RET_CHECK(mediapipe::TensorsToSegmentationCalculatorOptions::SOFTMAX !=
-              options_.activation());  // Requires 2 channels.
-    if (mediapipe::TensorsToSegmentationCalculatorOptions::NONE ==
-        options_.activation())  // Pass-through optimization.
-      tensor_mat.copyTo(small_mask_mat);
-    else
-      MP_RETURN_IF_ERROR(ApplyActivation<float>(tensor_mat, &small_mask_mat));
-  } else {
-    RET_CHECK_FAIL() << "Unsupported number of tensor channels "
-                     << tensor_channels;
+  MaskActivation activation = MaskActivation::kNone;
+  switch (options_.activation()) {
+    case mediapipe::TensorsToSegmentationCalculatorOptions::NONE:
+      activation = MaskActivation::kNone;
+      break;
+    case mediapipe::TensorsToSegmentationCalculatorOptions::SIGMOID:
+      activation = MaskActivation::kSigmoid;
+      break;
+    case mediapipe::TensorsToSegmentationCalculatorOptions::SOFTMAX:
+      activation = MaskActivation::kSoftmax;
+      break;
   }
 
-  // Send out image as CPU packet.
-  std::shared_ptr<ImageFrame> mask_frame = std::make_shared<ImageFrame>(
-      ImageFormat::VEC32F1, output_width, output_height);
-  std::unique_ptr<Image> output_mask = absl::make_unique<Image>(mask_frame);
-  cv::Mat output_mat = formats::MatView(output_mask.get());
-  // Upsample small mask into output.
-  cv::resize(small_mask_mat, output_mat, cv::Size(output_width, output_height));
-  cc->Outputs().Tag(kMaskTag).Add(output_mask.release(), cc->InputTimestamp());
-
-  #endif // !defined(__EMSCRIPTEN__)
-
-  return absl::OkStatus();
-}
-
-
-#if !defined(__EMSCRIPTEN__)
-
-template <class T>
-absl::Status TensorsToSegmentationCalculator::ApplyActivation(
-    cv::Mat& tensor_mat, cv::Mat* small_mask_mat) {
-  // Configure activation function.
-  const int output_layer_index = options_.output_layer_index();
-  typedef mediapipe::TensorsToSegmentationCalculatorOptions Options;
-  const auto activation_fn = [&](const cv::Vec2f& mask_value) {
-    float new_mask_value = 0;
-    // TODO consider moving switch out of the loop,
-    // and also avoid float/Vec2f casting.
-    switch (options_.activation()) {
-      case Options::NONE: {
-        new_mask_value = mask_value[0];
-        break;
-      }
-      case Options::SIGMOID: {
-        const float pixel0 = mask_value[0];
-        new_mask_value = 1.0 / (std::exp(-pixel0) + 1.0);
-        break;
-      }
-      case Options::SOFTMAX: {
-        const float pixel0 = mask_value[0];
-        const float pixel1 = mask_value[1];
-        const float max_pixel = std::max(pixel0, pixel1);
-        const float min_pixel = std::min(pixel0, pixel1);
-        const float softmax_denom =
-            /*exp(max_pixel - max_pixel)=*/1.0f +
-            std::exp(min_pixel - max_pixel);
-        new_mask_value = std::exp(mask_value[output_layer_index] - max_pixel) /
-                         softmax_denom;
-        break;
-      }
-    }
-    return new_mask_value;
-  };
+  // Get an output mask from the pool, recreating the pool if the mask size or
+  // format changed.
+  const ImageFormat::Format mask_format = options_.output_uint8_mask()
+                                              ? ImageFormat::GRAY8
+                                              : ImageFormat::VEC32F1;
+  if (!mask_pool_ || mask_pool_->width() != output_width ||
+      mask_pool_->height() != output_height ||
+      mask_pool_->format() != mask_format) {
+    mask_pool_ = ImageFramePool::Create(output_width, output_height,
+                                        mask_format, kMaskPoolKeepCount);
+  }
+  std::shared_ptr<ImageFrame> mask_frame = mask_pool_->GetBuffer();
+  RET_CHECK(mask_frame);
+
+  // Activate and upsample the tensor into the mask.
+  auto raw_input_view = input_tensors[0].GetCpuReadView();
+  MP_RETURN_IF_ERROR(mask_resizer_.Resize(
+      activation, options_.output_layer_index(),
+      raw_input_view.buffer<float>(), tensor_width, tensor_height,
+      mask_frame.get()));
+
+  if (cc->Outputs().HasTag(kTiledMaskTag)) {
+    ASSIGN_OR_RETURN(TiledMask tiled_mask,
+                     TiledMask::FromImageFrame(*mask_frame));
+    cc->Outputs()
+        .Tag(kTiledMaskTag)
+        .Add(new TiledMask(std::move(tiled_mask)), cc->InputTimestamp());
+  }
 
-  // Process mask tensor.
-  for (int i = 0; i < tensor_mat.rows; ++i) {
-    for (int j = 0; j < tensor_mat.cols; ++j) {
-      const T& input_pix = tensor_mat.at<T>(i, j);
-      const float mask_value = activation_fn(input_pix);
-      small_mask_mat->at<float>(i, j) = mask_value;
-    }
+  // Send out image as CPU packet.
+  if (cc->Outputs().HasTag(kMaskTag)) {
+    cc->Outputs().Tag(kMaskTag).Add(new Image(std::move(mask_frame)),
+                                    cc->InputTimestamp());
   }
 
   return absl::OkStatus();
 }
 
-#endif // !defined(__EMSCRIPTEN__)
-
 // Steps:
 // 1. receive tensor
 // 2. process segmentation tensor into small mask
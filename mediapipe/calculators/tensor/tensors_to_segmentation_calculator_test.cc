@@ -0,0 +1,174 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/tensor.h"
+#include "mediapipe/framework/formats/tiled_mask.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+// Neither dimension is a multiple of the tile size, so the last column and row
+// of tiles are partial.
+constexpr int kWidth = 70;
+constexpr int kHeight = 45;
+
+constexpr char kSegmentationNode[] = R"pb(
+  calculator: "TensorsToSegmentationCalculator"
+  input_stream: "TENSORS:tensors"
+  $0
+  options {
+    [mediapipe.TensorsToSegmentationCalculatorOptions.ext] {
+      activation: NONE
+      output_uint8_mask: $1
+    }
+  }
+)pb";
+
+// Returns a {1, kHeight, kWidth, 1} tensor with values in [0, 1] that give
+// full, empty and mixed tiles, including mixed partial tiles along the right
+// and bottom edges.
+Packet MakeTensorsPacket() {
+  auto tensors = absl::make_unique<std::vector<Tensor>>();
+  tensors->emplace_back(Tensor::ElementType::kFloat32,
+                        Tensor::Shape{1, kHeight, kWidth, 1});
+  auto view = tensors->back().GetCpuWriteView();
+  float* buffer = view.buffer<float>();
+  for (int y = 0; y < kHeight; ++y) {
+    for (int x = 0; x < kWidth; ++x) {
+      float value = 0.0f;
+      if (y >= 16 && y < 32 && x >= 16 && x < 48) {
+        value = 1.0f;
+      } else if (y >= 16 && y < 32 && x >= 48 && x < 60) {
+        value = (255 - (x - 47) * 20) / 255.0f;
+      } else if (x >= 64 || y >= 40) {
+        value = ((x * 7 + y * 3) % 256) / 255.0f;
+      }
+      buffer[y * kWidth + x] = value;
+    }
+  }
+  return Adopt(tensors.release());
+}
+
+// Returns the value of the dense "mask" at (x, y) scaled to [0, 255] like a
+// TiledMask value.
+int GetMaskValue(const ImageFrame& mask, int x, int y) {
+  const uint8* row = mask.PixelData() + y * mask.WidthStep();
+  if (mask.Format() == ImageFormat::GRAY8) return row[x];
+  const float value = reinterpret_cast<const float*>(row)[x];
+  return static_cast<int>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f +
+                          0.5f);
+}
+
+// Runs the calculator with "outputs" on the test tensor, optionally resized to
+// "output_size", and returns the runner.
+std::unique_ptr<CalculatorRunner> RunSegmentation(
+    const std::string& outputs, bool output_uint8_mask,
+    const std::pair<int, int>* output_size = nullptr) {
+  std::string streams = outputs;
+  if (output_size) streams += "\ninput_stream: \"OUTPUT_SIZE:size\"";
+  auto runner = absl::make_unique<CalculatorRunner>(absl::Substitute(
+      kSegmentationNode, streams, output_uint8_mask ? "true" : "false"));
+  runner->MutableInputs()->Tag("TENSORS").packets.push_back(
+      MakeTensorsPacket().At(Timestamp(0)));
+  if (output_size) {
+    runner->MutableInputs()->Tag("OUTPUT_SIZE").packets.push_back(
+        MakePacket<std::pair<int, int>>(*output_size).At(Timestamp(0)));
+  }
+  MP_EXPECT_OK(runner->Run());
+  return runner;
+}
+
+void ExpectTiledMaskMatchesMask(const TiledMask& tiled_mask,
+                                const ImageFrame& mask) {
+  ASSERT_EQ(tiled_mask.width(), mask.Width());
+  ASSERT_EQ(tiled_mask.height(), mask.Height());
+  for (int y = 0; y < mask.Height(); ++y) {
+    for (int x = 0; x < mask.Width(); ++x) {
+      ASSERT_EQ(tiled_mask.GetValue(x, y), GetMaskValue(mask, x, y))
+          << "x=" << x << " y=" << y;
+    }
+  }
+}
+
+TEST(TensorsToSegmentationCalculatorTest, TiledMaskMatchesMask) {
+  for (bool output_uint8_mask : {true, false}) {
+    auto runner = RunSegmentation(
+        "output_stream: \"MASK:mask\"\noutput_stream: \"TILED_MASK:tiled\"",
+        output_uint8_mask);
+    const auto& masks = runner->Outputs().Tag("MASK").packets;
+    const auto& tiled_masks = runner->Outputs().Tag("TILED_MASK").packets;
+    ASSERT_EQ(masks.size(), 1);
+    ASSERT_EQ(tiled_masks.size(), 1);
+    EXPECT_EQ(tiled_masks[0].Timestamp(), Timestamp(0));
+
+    const ImageFrame& mask = *masks[0].Get<Image>().GetImageFrameSharedPtr();
+    EXPECT_EQ(mask.Format(), output_uint8_mask ? ImageFormat::GRAY8
+                                               : ImageFormat::VEC32F1);
+    const TiledMask& tiled_mask = tiled_masks[0].Get<TiledMask>();
+    ASSERT_EQ(tiled_mask.tiles_x(), 5);
+    ASSERT_EQ(tiled_mask.tiles_y(), 3);
+    EXPECT_EQ(tiled_mask.tile_type(0, 0), TiledMask::TileType::kEmpty);
+    EXPECT_EQ(tiled_mask.tile_type(1, 1), TiledMask::TileType::kFull);
+    EXPECT_EQ(tiled_mask.tile_type(2, 1), TiledMask::TileType::kFull);
+    EXPECT_EQ(tiled_mask.tile_type(3, 1), TiledMask::TileType::kMixed);
+    EXPECT_EQ(tiled_mask.tile_type(4, 2), TiledMask::TileType::kMixed);
+    ExpectTiledMaskMatchesMask(tiled_mask, mask);
+  }
+}
+
+TEST(TensorsToSegmentationCalculatorTest, TiledMaskIsResizedToOutputSize) {
+  const std::pair<int, int> output_size = {kWidth * 2 + 3, kHeight + 7};
+  auto runner = RunSegmentation(
+      "output_stream: \"MASK:mask\"\noutput_stream: \"TILED_MASK:tiled\"",
+      /*output_uint8_mask=*/true, &output_size);
+  const auto& masks = runner->Outputs().Tag("MASK").packets;
+  const auto& tiled_masks = runner->Outputs().Tag("TILED_MASK").packets;
+  ASSERT_EQ(masks.size(), 1);
+  ASSERT_EQ(tiled_masks.size(), 1);
+  const ImageFrame& mask = *masks[0].Get<Image>().GetImageFrameSharedPtr();
+  EXPECT_EQ(mask.Width(), output_size.first);
+  EXPECT_EQ(mask.Height(), output_size.second);
+  ExpectTiledMaskMatchesMask(tiled_masks[0].Get<TiledMask>(), mask);
+}
+
+TEST(TensorsToSegmentationCalculatorTest, OutputsOnlyTiledMask) {
+  auto tiled_runner = RunSegmentation("output_stream: \"TILED_MASK:tiled\"",
+                                      /*output_uint8_mask=*/true);
+  auto dense_runner = RunSegmentation("output_stream: \"MASK:mask\"",
+                                      /*output_uint8_mask=*/true);
+  const auto& tiled_masks = tiled_runner->Outputs().Tag("TILED_MASK").packets;
+  const auto& masks = dense_runner->Outputs().Tag("MASK").packets;
+  ASSERT_EQ(tiled_masks.size(), 1);
+  ASSERT_EQ(masks.size(), 1);
+  ExpectTiledMaskMatchesMask(tiled_masks[0].Get<TiledMask>(),
+                             *masks[0].Get<Image>().GetImageFrameSharedPtr());
+}
+
+}  // namespace
+}  // namespace mediapipe
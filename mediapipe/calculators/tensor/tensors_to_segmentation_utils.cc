@@ -0,0 +1,297 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensor/tensors_to_segmentation_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDIAPIPE_MASK_NEON 1
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// Inputs of exp() are clamped to this range, in which neither the result nor
+// 1 + result overflow.
+constexpr float kMaxExpInput = 87.0f;
+
+#if defined(__SSE2__)
+using Vec4 = __m128;
+
+inline Vec4 Splat(float value) { return _mm_set1_ps(value); }
+inline Vec4 Load(const float* in) { return _mm_loadu_ps(in); }
+inline void Store(Vec4 v, float* out) { _mm_storeu_ps(out, v); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+inline Vec4 Div(Vec4 a, Vec4 b) { return _mm_div_ps(a, b); }
+inline Vec4 Min(Vec4 a, Vec4 b) { return _mm_min_ps(a, b); }
+inline Vec4 Max(Vec4 a, Vec4 b) { return _mm_max_ps(a, b); }
+
+// Loads two interleaved channels of four elements.
+inline void LoadDeinterleaved(const float* in, Vec4* c0, Vec4* c1) {
+  const __m128 a = _mm_loadu_ps(in);
+  const __m128 b = _mm_loadu_ps(in + 4);
+  *c0 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+  *c1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+}
+
+// Returns floor(x) and 2^floor(x), for x in the range of kMaxExpInput.
+inline void FloorAndPow2(Vec4 x, Vec4* floor_x, Vec4* pow2) {
+  __m128i n = _mm_cvttps_epi32(x);
+  __m128 truncated = _mm_cvtepi32_ps(n);
+  // Truncation rounds negative values up: correct by one.
+  const __m128 too_large = _mm_cmpgt_ps(truncated, x);
+  n = _mm_add_epi32(n, _mm_castps_si128(too_large));  // -1 where too large.
+  *floor_x = _mm_cvtepi32_ps(n);
+  *pow2 = _mm_castsi128_ps(
+      _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+}
+
+// Rounds to the nearest integer, ties to even, and saturates.
+inline void StoreUint8(Vec4 v, uint8_t* out) {
+  __m128i i = _mm_cvtps_epi32(v);
+  i = _mm_packs_epi32(i, i);
+  i = _mm_packus_epi16(i, i);
+  const int32_t bytes = _mm_cvtsi128_si32(i);
+  std::memcpy(out, &bytes, 4);
+}
+#elif MEDIAPIPE_MASK_NEON
+using Vec4 = float32x4_t;
+
+inline Vec4 Splat(float value) { return vdupq_n_f32(value); }
+inline Vec4 Load(const float* in) { return vld1q_f32(in); }
+inline void Store(Vec4 v, float* out) { vst1q_f32(out, v); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+inline Vec4 Div(Vec4 a, Vec4 b) { return vdivq_f32(a, b); }
+inline Vec4 Min(Vec4 a, Vec4 b) { return vminq_f32(a, b); }
+inline Vec4 Max(Vec4 a, Vec4 b) { return vmaxq_f32(a, b); }
+
+inline void LoadDeinterleaved(const float* in, Vec4* c0, Vec4* c1) {
+  const float32x4x2_t v = vld2q_f32(in);
+  *c0 = v.val[0];
+  *c1 = v.val[1];
+}
+
+inline void FloorAndPow2(Vec4 x, Vec4* floor_x, Vec4* pow2) {
+  const int32x4_t n = vcvtmq_s32_f32(x);
+  *floor_x = vcvtq_f32_s32(n);
+  *pow2 = vreinterpretq_f32_s32(vshlq_n_s32(vaddq_s32(n, vdupq_n_s32(127)), 23));
+}
+
+inline void StoreUint8(Vec4 v, uint8_t* out) {
+  const int16x4_t i = vqmovn_s32(vcvtnq_s32_f32(v));
+  const uint8x8_t u = vqmovun_s16(vcombine_s16(i, i));
+  const uint32_t bytes = vget_lane_u32(vreinterpret_u32_u8(u), 0);
+  std::memcpy(out, &bytes, 4);
+}
+#endif  // defined(__SSE2__)
+
+#if defined(__SSE2__) || MEDIAPIPE_MASK_NEON
+// exp(x), with the range reduction and polynomial of the Cephes library.
+inline Vec4 Exp(Vec4 x) {
+  x = Min(Max(x, Splat(-kMaxExpInput)), Splat(kMaxExpInput));
+  Vec4 n;
+  Vec4 pow2;
+  FloorAndPow2(Add(Mul(x, Splat(1.44269504088896341f)), Splat(0.5f)), &n,
+               &pow2);
+  // x - n * ln(2), with ln(2) split in two for precision.
+  x = Sub(x, Mul(n, Splat(0.693359375f)));
+  x = Sub(x, Mul(n, Splat(-2.12194440e-4f)));
+  Vec4 y = Splat(1.9875691500e-4f);
+  y = Add(Mul(y, x), Splat(1.3981999507e-3f));
+  y = Add(Mul(y, x), Splat(8.3334519073e-3f));
+  y = Add(Mul(y, x), Splat(4.1665795894e-2f));
+  y = Add(Mul(y, x), Splat(1.6666665459e-1f));
+  y = Add(Mul(y, x), Splat(5.0000001201e-1f));
+  y = Add(Add(Mul(Mul(y, x), x), x), Splat(1.0f));
+  return Mul(y, pow2);
+}
+
+inline Vec4 Sigmoid(Vec4 x) {
+  const Vec4 one = Splat(1.0f);
+  return Div(one, Add(one, Exp(Sub(Splat(0.0f), x))));
+}
+#endif  // defined(__SSE2__) || MEDIAPIPE_MASK_NEON
+
+inline float Sigmoid(float x) {
+  x = std::min(std::max(x, -kMaxExpInput), kMaxExpInput);
+  return 1.0f / (1.0f + std::exp(-x));
+}
+
+// Computes the horizontal sampling of cv::resize() with INTER_LINEAR.
+void ComputeSampling(int input_size, int output_size, int index, int* i0,
+                     int* i1, float* weight) {
+  const double scale = static_cast<double>(input_size) / output_size;
+  float f = static_cast<float>((index + 0.5) * scale - 0.5);
+  int i = static_cast<int>(std::floor(f));
+  f -= i;
+  if (i < 0) {
+    i = 0;
+    f = 0.0f;
+  }
+  if (i >= input_size - 1) {
+    i = input_size - 1;
+    f = 0.0f;
+  }
+  *i0 = i;
+  *i1 = std::min(i + 1, input_size - 1);
+  *weight = f;
+}
+
+}  // namespace
+
+void ApplyMaskActivation(MaskActivation activation, int output_channel,
+                         const float* input, int size, float* output) {
+  int i = 0;
+  switch (activation) {
+    case MaskActivation::kNone:
+      std::memcpy(output, input, size * sizeof(float));
+      return;
+    case MaskActivation::kSigmoid:
+#if defined(__SSE2__) || MEDIAPIPE_MASK_NEON
+      for (; i + 4 <= size; i += 4) {
+        Store(Sigmoid(Load(input + i)), output + i);
+      }
+#endif
+      for (; i < size; ++i) {
+        output[i] = Sigmoid(input[i]);
+      }
+      return;
+    case MaskActivation::kSoftmax:
+      // With two channels, softmax is the sigmoid of their difference.
+#if defined(__SSE2__) || MEDIAPIPE_MASK_NEON
+      for (; i + 4 <= size; i += 4) {
+        Vec4 c0;
+        Vec4 c1;
+        LoadDeinterleaved(input + i * 2, &c0, &c1);
+        Store(Sigmoid(output_channel == 0 ? Sub(c0, c1) : Sub(c1, c0)),
+              output + i);
+      }
+#endif
+      for (; i < size; ++i) {
+        const float selected = input[i * 2 + output_channel];
+        const float other = input[i * 2 + 1 - output_channel];
+        output[i] = Sigmoid(selected - other);
+      }
+      return;
+  }
+}
+
+absl::Status MaskResizer::Resize(MaskActivation activation, int output_channel,
+                                 const float* tensor, int width, int height,
+                                 ImageFrame* output) {
+  RET_CHECK(output->Format() == ImageFormat::VEC32F1 ||
+            output->Format() == ImageFormat::GRAY8)
+      << "Unsupported mask format " << output->Format();
+  RET_CHECK_GT(width, 0);
+  RET_CHECK_GT(height, 0);
+  RET_CHECK(activation != MaskActivation::kSoftmax ||
+            (output_channel == 0 || output_channel == 1))
+      << "Invalid output channel " << output_channel;
+  const int output_width = output->Width();
+  const int output_height = output->Height();
+
+  if (input_width_ != width || output_width_ != output_width) {
+    input_width_ = width;
+    output_width_ = output_width;
+    x0_.resize(output_width);
+    x1_.resize(output_width);
+    fx_.resize(output_width);
+    for (int x = 0; x < output_width; ++x) {
+      ComputeSampling(width, output_width, x, &x0_[x], &x1_[x], &fx_[x]);
+    }
+    activated_row_.resize(width);
+    resampled_rows_[0].resize(output_width);
+    resampled_rows_[1].resize(output_width);
+  }
+  resampled_row_index_[0] = -1;
+  resampled_row_index_[1] = -1;
+
+  const bool to_uint8 = output->Format() == ImageFormat::GRAY8;
+  const float scale = to_uint8 ? 255.0f : 1.0f;
+  for (int y = 0; y < output_height; ++y) {
+    int y0;
+    int y1;
+    float fy;
+    ComputeSampling(height, output_height, y, &y0, &y1, &fy);
+    const float* row0 =
+        GetResampledRow(activation, output_channel, tensor, width, y0);
+    const float* row1 =
+        GetResampledRow(activation, output_channel, tensor, width, y1);
+    const float w0 = (1.0f - fy) * scale;
+    const float w1 = fy * scale;
+    uint8_t* out_row = output->MutablePixelData() + y * output->WidthStep();
+
+    int x = 0;
+#if defined(__SSE2__) || MEDIAPIPE_MASK_NEON
+    const Vec4 vw0 = Splat(w0);
+    const Vec4 vw1 = Splat(w1);
+    for (; x + 4 <= output_width; x += 4) {
+      const Vec4 v =
+          Add(Mul(Load(row0 + x), vw0), Mul(Load(row1 + x), vw1));
+      if (to_uint8) {
+        StoreUint8(v, out_row + x);
+      } else {
+        Store(v, reinterpret_cast<float*>(out_row) + x);
+      }
+    }
+#endif
+    for (; x < output_width; ++x) {
+      const float v = row0[x] * w0 + row1[x] * w1;
+      if (to_uint8) {
+        out_row[x] = static_cast<uint8_t>(
+            std::min(std::max(std::nearbyint(v), 0.0f), 255.0f));
+      } else {
+        reinterpret_cast<float*>(out_row)[x] = v;
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+const float* MaskResizer::GetResampledRow(MaskActivation activation,
+                                          int output_channel,
+                                          const float* tensor, int width,
+                                          int y) {
+  const int slot = y % 2;
+  float* row = resampled_rows_[slot].data();
+  if (resampled_row_index_[slot] == y) return row;
+  resampled_row_index_[slot] = y;
+
+  const int channels = activation == MaskActivation::kSoftmax ? 2 : 1;
+  ApplyMaskActivation(activation, output_channel,
+                      tensor + static_cast<size_t>(y) * width * channels,
+                      width, activated_row_.data());
+  const float* activated = activated_row_.data();
+  for (int x = 0; x < output_width_; ++x) {
+    row[x] = activated[x0_[x]] * (1.0f - fx_[x]) + activated[x1_[x]] * fx_[x];
+  }
+  return row;
+}
+
+}  // namespace mediapipe
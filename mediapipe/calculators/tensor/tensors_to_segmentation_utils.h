@@ -0,0 +1,80 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_CALCULATORS_TENSOR_TENSORS_TO_SEGMENTATION_UTILS_H_
+#define MEDIAPIPE_CALCULATORS_TENSOR_TENSORS_TO_SEGMENTATION_UTILS_H_
+
+#include <vector>
+
+#include "absl/status/status.h"
+#include "mediapipe/framework/formats/image_frame.h"
+
+namespace mediapipe {
+
+// Activation applied to the values of a segmentation tensor.
+enum class MaskActivation {
+  // One channel, passed through.
+  kNone,
+  // One channel.
+  kSigmoid,
+  // Two channels, converted to the probability of one of them.
+  kSoftmax,
+};
+
+// Applies "activation" to the "size" elements of "input" and writes one value
+// per element to "output". For kSoftmax, "input" holds two interleaved
+// channels and "output_channel" selects the probability to output. Uses SSE2 or
+// NEON when available, with a polynomial exp() accurate to about 1e-7.
+void ApplyMaskActivation(MaskActivation activation, int output_channel,
+                         const float* input, int size, float* output);
+
+// Converts a segmentation tensor to a mask of a different size, applying the
+// activation and resizing bilinearly in a single pass. Each tensor row is
+// activated and resampled horizontally only once, right before the output
+// rows which need it, so no intermediate mask is allocated. Sampling matches
+// cv::resize() with INTER_LINEAR.
+//
+// Keeps scratch buffers across calls: not thread-safe.
+class MaskResizer {
+ public:
+  // Converts the [height, width, channels] "tensor", where channels is 2 for
+  // kSoftmax and 1 otherwise, into "output". "output" must be VEC32F1, or
+  // GRAY8 in which case mask values are scaled to [0, 255], rounded and
+  // saturated.
+  absl::Status Resize(MaskActivation activation, int output_channel,
+                      const float* tensor, int width, int height,
+                      ImageFrame* output);
+
+ private:
+  // Returns tensor row "y", activated and resampled to the output width.
+  const float* GetResampledRow(MaskActivation activation, int output_channel,
+                               const float* tensor, int width, int y);
+
+  // Horizontal sampling: output column x interpolates activated columns
+  // x0_[x] and x1_[x] with weight fx_[x] on the latter.
+  int input_width_ = 0;
+  int output_width_ = 0;
+  std::vector<int> x0_;
+  std::vector<int> x1_;
+  std::vector<float> fx_;
+
+  std::vector<float> activated_row_;
+  // Resampled rows, row y is cached in slot y % 2.
+  std::vector<float> resampled_rows_[2];
+  int resampled_row_index_[2] = {-1, -1};
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_CALCULATORS_TENSOR_TENSORS_TO_SEGMENTATION_UTILS_H_
@@ -0,0 +1,218 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/calculators/tensor/tensors_to_segmentation_utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+std::vector<float> MakeRandomTensor(int size, int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> logit(-12.0f, 12.0f);
+  std::vector<float> tensor(size);
+  for (float& value : tensor) value = logit(rng);
+  return tensor;
+}
+
+// The activations as implemented by the OpenCV based calculator.
+float ReferenceActivation(MaskActivation activation, int output_channel,
+                          const float* value) {
+  switch (activation) {
+    case MaskActivation::kNone:
+      return value[0];
+    case MaskActivation::kSigmoid:
+      return 1.0 / (std::exp(-value[0]) + 1.0);
+    case MaskActivation::kSoftmax: {
+      const float max_value = std::max(value[0], value[1]);
+      const float min_value = std::min(value[0], value[1]);
+      return std::exp(value[output_channel] - max_value) /
+             (1.0f + std::exp(min_value - max_value));
+    }
+  }
+  return 0.0f;
+}
+
+// Samples "mask" like cv::resize() with INTER_LINEAR.
+double ReferenceSample(const std::vector<float>& mask, int width, int height,
+                       int output_width, int output_height, int x, int y) {
+  auto sample = [](int size, int output_size, int index, int* i0, int* i1,
+                   double* weight) {
+    double f = (index + 0.5) * size / output_size - 0.5;
+    int i = static_cast<int>(std::floor(f));
+    f -= i;
+    if (i < 0) i = 0, f = 0.0;
+    if (i >= size - 1) i = size - 1, f = 0.0;
+    *i0 = i;
+    *i1 = std::min(i + 1, size - 1);
+    *weight = f;
+  };
+  int x0, x1, y0, y1;
+  double fx, fy;
+  sample(width, output_width, x, &x0, &x1, &fx);
+  sample(height, output_height, y, &y0, &y1, &fy);
+  auto at = [&](int xi, int yi) { return mask[yi * width + xi]; };
+  return (at(x0, y0) * (1 - fx) + at(x1, y0) * fx) * (1 - fy) +
+         (at(x0, y1) * (1 - fx) + at(x1, y1) * fx) * fy;
+}
+
+TEST(TensorsToSegmentationUtilsTest, ActivationsMatchReference) {
+  // An odd size covers both the vectorized and the scalar loop.
+  constexpr int kSize = 1023;
+  const std::vector<float> tensor = MakeRandomTensor(kSize * 2, /*seed=*/0);
+  std::vector<float> output(kSize);
+  for (MaskActivation activation :
+       {MaskActivation::kNone, MaskActivation::kSigmoid}) {
+    ApplyMaskActivation(activation, 0, tensor.data(), kSize, output.data());
+    for (int i = 0; i < kSize; ++i) {
+      EXPECT_NEAR(output[i], ReferenceActivation(activation, 0, &tensor[i]),
+                  1e-6)
+          << "i=" << i;
+    }
+  }
+  for (int output_channel : {0, 1}) {
+    ApplyMaskActivation(MaskActivation::kSoftmax, output_channel,
+                        tensor.data(), kSize, output.data());
+    for (int i = 0; i < kSize; ++i) {
+      EXPECT_NEAR(output[i],
+                  ReferenceActivation(MaskActivation::kSoftmax,
+                                      output_channel, &tensor[i * 2]),
+                  1e-6)
+          << "i=" << i;
+    }
+  }
+}
+
+TEST(TensorsToSegmentationUtilsTest, SigmoidSaturates) {
+  const float tensor[] = {-1000.0f, -90.0f, 0.0f, 90.0f, 1000.0f};
+  float output[5];
+  ApplyMaskActivation(MaskActivation::kSigmoid, 0, tensor, 5, output);
+  EXPECT_NEAR(output[0], 0.0f, 1e-30);
+  EXPECT_NEAR(output[1], 0.0f, 1e-30);
+  EXPECT_FLOAT_EQ(output[2], 0.5f);
+  EXPECT_EQ(output[3], 1.0f);
+  EXPECT_EQ(output[4], 1.0f);
+}
+
+void ExpectResizeMatchesReference(MaskActivation activation, int width,
+                                  int height, ImageFormat::Format format,
+                                  int output_width, int output_height) {
+  const int channels = activation == MaskActivation::kSoftmax ? 2 : 1;
+  const std::vector<float> tensor =
+      MakeRandomTensor(width * height * channels, /*seed=*/1);
+  std::vector<float> mask(width * height);
+  for (int i = 0; i < width * height; ++i) {
+    mask[i] = ReferenceActivation(activation, 1, &tensor[i * channels]);
+  }
+
+  ImageFrame output(format, output_width, output_height);
+  MaskResizer resizer;
+  MP_ASSERT_OK(resizer.Resize(activation, 1, tensor.data(), width, height,
+                              &output));
+  for (int y = 0; y < output_height; ++y) {
+    const uint8_t* row = output.PixelData() + y * output.WidthStep();
+    for (int x = 0; x < output_width; ++x) {
+      const double expected = ReferenceSample(mask, width, height,
+                                              output_width, output_height, x, y);
+      if (format == ImageFormat::GRAY8) {
+        const double scaled = std::min(std::max(expected * 255, 0.0), 255.0);
+        EXPECT_NEAR(row[x], scaled, 0.5 + 1e-3) << "x=" << x << " y=" << y;
+      } else {
+        EXPECT_NEAR(reinterpret_cast<const float*>(row)[x], expected, 1e-5)
+            << "x=" << x << " y=" << y;
+      }
+    }
+  }
+}
+
+TEST(TensorsToSegmentationUtilsTest, ResizeMatchesReference) {
+  ExpectResizeMatchesReference(MaskActivation::kSigmoid, 16, 12,
+                               ImageFormat::VEC32F1, 51, 37);
+  ExpectResizeMatchesReference(MaskActivation::kSoftmax, 16, 12,
+                               ImageFormat::VEC32F1, 51, 37);
+  ExpectResizeMatchesReference(MaskActivation::kSigmoid, 16, 12,
+                               ImageFormat::GRAY8, 51, 37);
+  // Downscaling, and the same size.
+  ExpectResizeMatchesReference(MaskActivation::kNone, 16, 12,
+                               ImageFormat::VEC32F1, 7, 5);
+  ExpectResizeMatchesReference(MaskActivation::kNone, 16, 12,
+                               ImageFormat::VEC32F1, 16, 12);
+}
+
+TEST(TensorsToSegmentationUtilsTest, ResizerCanBeReused) {
+  const std::vector<float> tensor = MakeRandomTensor(8 * 8, /*seed=*/2);
+  const std::vector<float> other_tensor = MakeRandomTensor(8 * 8, /*seed=*/3);
+  MaskResizer resizer;
+  ImageFrame output(ImageFormat::VEC32F1, 20, 20);
+  ImageFrame fresh_output(ImageFormat::VEC32F1, 20, 20);
+  MP_ASSERT_OK(resizer.Resize(MaskActivation::kSigmoid, 0, tensor.data(), 8, 8,
+                              &output));
+  MP_ASSERT_OK(resizer.Resize(MaskActivation::kSigmoid, 0, other_tensor.data(),
+                              8, 8, &output));
+  MaskResizer fresh_resizer;
+  MP_ASSERT_OK(fresh_resizer.Resize(MaskActivation::kSigmoid, 0,
+                                    other_tensor.data(), 8, 8, &fresh_output));
+  for (int y = 0; y < 20; ++y) {
+    EXPECT_EQ(std::memcmp(output.PixelData() + y * output.WidthStep(),
+                          fresh_output.PixelData() + y * output.WidthStep(),
+                          20 * sizeof(float)),
+              0);
+  }
+}
+
+TEST(TensorsToSegmentationUtilsTest, ResizeRejectsUnsupportedFormat) {
+  const std::vector<float> tensor(4, 0.0f);
+  ImageFrame output(ImageFormat::SRGB, 4, 4);
+  MaskResizer resizer;
+  EXPECT_FALSE(resizer
+                   .Resize(MaskActivation::kNone, 0, tensor.data(), 2, 2,
+                           &output)
+                   .ok());
+}
+
+// Selfie segmentation: a 256x256 tensor resized to 1080p.
+void RunResizeBenchmark(benchmark::State& state, ImageFormat::Format format) {
+  const std::vector<float> tensor = MakeRandomTensor(256 * 256, /*seed=*/0);
+  ImageFrame output(format, 1920, 1080);
+  MaskResizer resizer;
+  for (auto _ : state) {
+    MEDIAPIPE_CHECK_OK(resizer.Resize(MaskActivation::kSigmoid, 0,
+                                      tensor.data(), 256, 256, &output));
+    benchmark::DoNotOptimize(output.PixelData());
+  }
+}
+
+void BM_ResizeMaskFloat(benchmark::State& state) {
+  RunResizeBenchmark(state, ImageFormat::VEC32F1);
+}
+BENCHMARK(BM_ResizeMaskFloat);
+
+void BM_ResizeMaskUint8(benchmark::State& state) {
+  RunResizeBenchmark(state, ImageFormat::GRAY8);
+}
+BENCHMARK(BM_ResizeMaskUint8);
+
+}  // namespace
+}  // namespace mediapipe
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <unordered_map>
 #include <vector>
 
@@ -24,6 +25,7 @@
 #include "mediapipe/framework/formats/location.h"
 #include "mediapipe/framework/formats/object_detection/anchor.pb.h"
 #include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/util/non_max_suppression.h"
 #include "mediapipe/util/tflite/config.h"
 #include "tensorflow/lite/interpreter.h"
 
@@ -104,6 +106,35 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
   }
 }
 
+NmsOptions::OverlapType GetOverlapType(
+    TfLiteTensorsToDetectionsCalculatorOptions::NonMaxSuppression::OverlapType
+        overlap_type) {
+  switch (overlap_type) {
+    case TfLiteTensorsToDetectionsCalculatorOptions::NonMaxSuppression::
+        MODIFIED_JACCARD:
+      return NmsOptions::OverlapType::kModifiedJaccard;
+    case TfLiteTensorsToDetectionsCalculatorOptions::NonMaxSuppression::
+        INTERSECTION_OVER_UNION:
+      return NmsOptions::OverlapType::kIntersectionOverUnion;
+    default:
+      return NmsOptions::OverlapType::kJaccard;
+  }
+}
+
+NmsOptions::Algorithm GetAlgorithm(
+    TfLiteTensorsToDetectionsCalculatorOptions::NonMaxSuppression::NmsAlgorithm
+        algorithm) {
+  switch (algorithm) {
+    case TfLiteTensorsToDetectionsCalculatorOptions::NonMaxSuppression::
+        WEIGHTED:
+      return NmsOptions::Algorithm::kWeighted;
+    case TfLiteTensorsToDetectionsCalculatorOptions::NonMaxSuppression::SOFT:
+      return NmsOptions::Algorithm::kSoft;
+    default:
+      return NmsOptions::Algorithm::kHard;
+  }
+}
+
 }  // namespace
 
 // Convert result TFLite tensors from object detection models into MediaPipe
@@ -122,6 +153,10 @@ void ConvertAnchorsToRawValues(const std::vector<Anchor>& anchors,
 // Output:
 //  DETECTIONS - Result MediaPipe detections.
 //
+// If the non_max_suppression option is set, the decoded detections are also
+// non-maximum suppressed, and only the surviving boxes are converted to
+// Detection protos.
+//
 // Usage example:
 // node {
 //   calculator: "TfLiteTensorsToDetectionsCalculator"
@@ -167,6 +202,21 @@ class TfLiteTensorsToDetectionsCalculator : public CalculatorBase {
   Detection ConvertToDetection(float box_ymin, float box_xmin, float box_ymax,
                                float box_xmax, float score, int class_id,
                                bool flip_vertically);
+  void AddKeypoints(const float* box, Detection* detection);
+  // Suppresses the boxes above min_score_thresh and converts the remaining
+  // ones to detections.
+  void SuppressDetections(const float* detection_boxes,
+                          const float* detection_scores,
+                          const int* detection_classes,
+                          std::vector<Detection>* output_detections);
+  // Keeps the max_num_candidates highest scoring candidates.
+  void SelectTopCandidates(const float* detection_scores);
+  // Sets the location of "detection" to the average of weighted NMS cluster
+  // "k".
+  void SetWeightedLocation(const NmsResult& result, int k,
+                           const float* detection_boxes,
+                           const float* detection_scores,
+                           Detection* detection);
 
   int num_classes_ = 0;
   int num_boxes_ = 0;
@@ -177,6 +227,11 @@ class TfLiteTensorsToDetectionsCalculator : public CalculatorBase {
   std::vector<Anchor> anchors_;
   bool side_packet_anchors_{};
 
+  // Non-maximum suppression state, reused across calls.
+  NmsOptions nms_options_;
+  std::vector<int> candidate_indices_;
+  NmsBoxes nms_boxes_;
+
 #if MEDIAPIPE_TFLITE_GL_INFERENCE
   mediapipe::GlCalculatorHelper gpu_helper_;
   std::unique_ptr<GPUData> gpu_data_;
@@ -578,6 +633,21 @@ absl::Status TfLiteTensorsToDetectionsCalculator::LoadOptions(
     ignore_classes_.insert(options_.ignore_classes(i));
   }
 
+  if (options_.has_non_max_suppression()) {
+    const auto& nms = options_.non_max_suppression();
+    RET_CHECK_NE(nms.max_num_detections(), 0)
+        << "max_num_detections=0 is not a valid value. Set -1 for no limit.";
+    RET_CHECK_NE(nms.max_num_candidates(), 0)
+        << "max_num_candidates=0 is not a valid value. Set -1 for no limit.";
+    nms_options_.algorithm = GetAlgorithm(nms.algorithm());
+    nms_options_.overlap_type = GetOverlapType(nms.overlap_type());
+    nms_options_.min_suppression_threshold = nms.min_suppression_threshold();
+    nms_options_.min_score_threshold =
+        options_.has_min_score_thresh() ? options_.min_score_thresh() : -1.0f;
+    nms_options_.max_num_detections = nms.max_num_detections();
+    nms_options_.soft_nms_sigma = nms.soft_nms_sigma();
+  }
+
   return absl::OkStatus();
 }
 
@@ -648,6 +718,12 @@ absl::Status TfLiteTensorsToDetectionsCalculator::DecodeBoxes(
 absl::Status TfLiteTensorsToDetectionsCalculator::ConvertToDetections(
     const float* detection_boxes, const float* detection_scores,
     const int* detection_classes, std::vector<Detection>* output_detections) {
+  if (options_.has_non_max_suppression()) {
+    SuppressDetections(detection_boxes, detection_scores, detection_classes,
+                       output_detections);
+    return absl::OkStatus();
+  }
+
   for (int i = 0; i < num_boxes_; ++i) {
     if (options_.has_min_score_thresh() &&
         detection_scores[i] < options_.min_score_thresh()) {
@@ -665,27 +741,139 @@ absl::Status TfLiteTensorsToDetectionsCalculator::ConvertToDetections(
       // calculators may assume non-negative values. (b/171391719)
       continue;
     }
-
-    // Add keypoints.
-    if (options_.num_keypoints() > 0) {
-      auto* location_data = detection.mutable_location_data();
-      for (int kp_id = 0; kp_id < options_.num_keypoints() *
-                                      options_.num_values_per_keypoint();
-           kp_id += options_.num_values_per_keypoint()) {
-        auto keypoint = location_data->add_relative_keypoints();
-        const int keypoint_index =
-            box_offset + options_.keypoint_coord_offset() + kp_id;
-        keypoint->set_x(detection_boxes[keypoint_index + 0]);
-        keypoint->set_y(options_.flip_vertically()
-                            ? 1.f - detection_boxes[keypoint_index + 1]
-                            : detection_boxes[keypoint_index + 1]);
-      }
-    }
+    AddKeypoints(detection_boxes + box_offset, &detection);
     output_detections->emplace_back(detection);
   }
   return absl::OkStatus();
 }
 
+void TfLiteTensorsToDetectionsCalculator::AddKeypoints(const float* box,
+                                                       Detection* detection) {
+  if (options_.num_keypoints() == 0) return;
+  auto* location_data = detection->mutable_location_data();
+  for (int kp_id = 0;
+       kp_id < options_.num_keypoints() * options_.num_values_per_keypoint();
+       kp_id += options_.num_values_per_keypoint()) {
+    auto keypoint = location_data->add_relative_keypoints();
+    const int keypoint_index = options_.keypoint_coord_offset() + kp_id;
+    keypoint->set_x(box[keypoint_index + 0]);
+    keypoint->set_y(options_.flip_vertically() ? 1.f - box[keypoint_index + 1]
+                                               : box[keypoint_index + 1]);
+  }
+}
+
+void TfLiteTensorsToDetectionsCalculator::SuppressDetections(
+    const float* detection_boxes, const float* detection_scores,
+    const int* detection_classes, std::vector<Detection>* output_detections) {
+  candidate_indices_.clear();
+  for (int i = 0; i < num_boxes_; ++i) {
+    if (options_.has_min_score_thresh() &&
+        detection_scores[i] < options_.min_score_thresh()) {
+      continue;
+    }
+    candidate_indices_.push_back(i);
+  }
+  SelectTopCandidates(detection_scores);
+
+  // Drop boxes with negative width or height, as ConvertToDetections() does,
+  // and compute the boxes in output coordinates exactly as
+  // NonMaxSuppressionCalculator would from the detections.
+  const bool flip_vertically = options_.flip_vertically();
+  nms_boxes_.Clear();
+  nms_boxes_.Reserve(candidate_indices_.size());
+  int num_candidates = 0;
+  for (int i : candidate_indices_) {
+    const float* box = detection_boxes + i * num_coords_;
+    const float width = box[3] - box[1];
+    const float height = box[2] - box[0];
+    if (width < 0 || height < 0) continue;
+    const float xmin = box[1];
+    const float ymin = flip_vertically ? 1.f - box[2] : box[0];
+    nms_boxes_.Add(xmin, ymin, xmin + width, ymin + height,
+                   detection_scores[i]);
+    candidate_indices_[num_candidates++] = i;
+  }
+  candidate_indices_.resize(num_candidates);
+  if (num_candidates == 0) return;
+
+  const NmsResult result = NonMaxSuppression(nms_boxes_, nms_options_);
+  output_detections->reserve(output_detections->size() +
+                             result.indices.size());
+  for (int k = 0; k < result.indices.size(); ++k) {
+    const int i = candidate_indices_[result.indices[k]];
+    const float* box = detection_boxes + i * num_coords_;
+    Detection detection =
+        ConvertToDetection(box[0], box[1], box[2], box[3], detection_scores[i],
+                           detection_classes[i], flip_vertically);
+    AddKeypoints(box, &detection);
+    if (nms_options_.algorithm == NmsOptions::Algorithm::kSoft) {
+      detection.set_score(0, result.scores[k]);
+    } else if (nms_options_.algorithm == NmsOptions::Algorithm::kWeighted) {
+      SetWeightedLocation(result, k, detection_boxes, detection_scores,
+                          &detection);
+    }
+    output_detections->push_back(std::move(detection));
+  }
+}
+
+void TfLiteTensorsToDetectionsCalculator::SelectTopCandidates(
+    const float* detection_scores) {
+  const int max_num_candidates =
+      options_.non_max_suppression().max_num_candidates();
+  if (max_num_candidates < 0 ||
+      candidate_indices_.size() <= max_num_candidates) {
+    return;
+  }
+  // Keep the highest scores, preferring lower box indices on ties, and then
+  // restore the box order so that suppression breaks ties as before.
+  std::nth_element(candidate_indices_.begin(),
+                   candidate_indices_.begin() + max_num_candidates,
+                   candidate_indices_.end(), [detection_scores](int a, int b) {
+                     if (detection_scores[a] != detection_scores[b]) {
+                       return detection_scores[a] > detection_scores[b];
+                     }
+                     return a < b;
+                   });
+  candidate_indices_.resize(max_num_candidates);
+  std::sort(candidate_indices_.begin(), candidate_indices_.end());
+}
+
+void TfLiteTensorsToDetectionsCalculator::SetWeightedLocation(
+    const NmsResult& result, int k, const float* detection_boxes,
+    const float* detection_scores, Detection* detection) {
+  const int begin = result.cluster_offsets[k];
+  const int end = result.cluster_offsets[k + 1];
+  if (begin == end) return;
+  auto* location_data = detection->mutable_location_data();
+  auto* bbox = location_data->mutable_relative_bounding_box();
+  bbox->set_xmin(result.weighted_boxes.xmin[k]);
+  bbox->set_ymin(result.weighted_boxes.ymin[k]);
+  bbox->set_width(result.weighted_boxes.xmax[k] - bbox->xmin());
+  bbox->set_height(result.weighted_boxes.ymax[k] - bbox->ymin());
+
+  // Average the keypoints of the cluster, in output coordinates.
+  for (int kp = 0; kp < location_data->relative_keypoints_size(); ++kp) {
+    const int keypoint_index = options_.keypoint_coord_offset() +
+                               kp * options_.num_values_per_keypoint();
+    float x = 0.0f;
+    float y = 0.0f;
+    float total_score = 0.0f;
+    for (int m = begin; m < end; ++m) {
+      const int i = candidate_indices_[result.cluster_members[m]];
+      const float* box = detection_boxes + i * num_coords_;
+      const float score = detection_scores[i];
+      total_score += score;
+      x += box[keypoint_index] * score;
+      y += (options_.flip_vertically() ? 1.f - box[keypoint_index + 1]
+                                       : box[keypoint_index + 1]) *
+           score;
+    }
+    auto* keypoint = location_data->mutable_relative_keypoints(kp);
+    keypoint->set_x(x / total_score);
+    keypoint->set_y(y / total_score);
+  }
+}
+
 Detection TfLiteTensorsToDetectionsCalculator::ConvertToDetection(
     float box_ymin, float box_xmin, float box_ymax, float box_xmax, float score,
     int class_id, bool flip_vertically) {
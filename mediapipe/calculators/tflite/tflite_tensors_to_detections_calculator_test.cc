@@ -0,0 +1,263 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/deps/message_matchers.h"
+#include "mediapipe/framework/formats/detection.pb.h"
+#include "mediapipe/framework/formats/object_detection/anchor.pb.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/tool/sink.h"
+#include "tensorflow/lite/interpreter.h"
+
+namespace mediapipe {
+namespace {
+
+// A palm detection like model: one class, 7 keypoints, raw boxes relative to
+// a 128x128 input.
+constexpr int kNumCoords = 18;
+constexpr int kNumBoxes = 896;
+constexpr char kDecodingOptions[] = R"(
+      num_classes: 1
+      num_boxes: 896
+      num_coords: 18
+      box_coord_offset: 0
+      keypoint_coord_offset: 4
+      num_keypoints: 7
+      num_values_per_keypoint: 2
+      sigmoid_score: true
+      score_clipping_thresh: 100.0
+      reverse_output_order: true
+      x_scale: 128.0
+      y_scale: 128.0
+      h_scale: 128.0
+      w_scale: 128.0
+      flip_vertically: $0
+      min_score_thresh: 0.5
+)";
+
+// Returns a graph decoding the "tensors" input stream into "detections", with
+// the calculator's own non-maximum suppression if "fused", and with a separate
+// NonMaxSuppressionCalculator otherwise.
+CalculatorGraphConfig MakeGraph(bool flip_vertically,
+                                const std::string& nms_options, bool fused) {
+  const std::string decoding_options =
+      absl::Substitute(kDecodingOptions, flip_vertically ? "true" : "false");
+  if (fused) {
+    return ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+        R"pb(
+          input_stream: "tensors"
+          input_side_packet: "anchors"
+          node {
+            calculator: "TfLiteTensorsToDetectionsCalculator"
+            input_stream: "TENSORS:tensors"
+            input_side_packet: "ANCHORS:anchors"
+            output_stream: "DETECTIONS:detections"
+            options: {
+              [mediapipe.TfLiteTensorsToDetectionsCalculatorOptions.ext] {
+                $0
+                non_max_suppression { $1 }
+              }
+            }
+          }
+        )pb",
+        decoding_options, nms_options));
+  }
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(absl::Substitute(
+      R"pb(
+        input_stream: "tensors"
+        input_side_packet: "anchors"
+        node {
+          calculator: "TfLiteTensorsToDetectionsCalculator"
+          input_stream: "TENSORS:tensors"
+          input_side_packet: "ANCHORS:anchors"
+          output_stream: "DETECTIONS:unfiltered_detections"
+          options: {
+            [mediapipe.TfLiteTensorsToDetectionsCalculatorOptions.ext] { $0 }
+          }
+        }
+        node {
+          calculator: "NonMaxSuppressionCalculator"
+          input_stream: "unfiltered_detections"
+          output_stream: "detections"
+          options: {
+            [mediapipe.NonMaxSuppressionCalculatorOptions.ext] {
+              min_score_threshold: 0.5
+              $1
+            }
+          }
+        }
+      )pb",
+      decoding_options, nms_options));
+}
+
+std::vector<Anchor> MakeAnchors() {
+  std::vector<Anchor> anchors(kNumBoxes);
+  for (int i = 0; i < kNumBoxes; ++i) {
+    const int cell = i / 2;
+    anchors[i].set_x_center(((cell % 16) + 0.5f) / 16.0f);
+    anchors[i].set_y_center((((cell / 16) % 16) + 0.5f) / 16.0f);
+    anchors[i].set_w(1.0f);
+    anchors[i].set_h(1.0f);
+  }
+  return anchors;
+}
+
+// Fills raw boxes and scores around a few objects: most scores are low, and
+// the boxes of the anchors close to an object overlap.
+void MakeRawValues(const std::vector<Anchor>& anchors, int seed,
+                   std::vector<float>* raw_boxes,
+                   std::vector<float>* raw_scores) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  raw_boxes->resize(kNumBoxes * kNumCoords);
+  raw_scores->resize(kNumBoxes);
+  const float objects[3][2] = {{0.3f, 0.3f}, {0.7f, 0.4f}, {0.5f, 0.8f}};
+  for (int i = 0; i < kNumBoxes; ++i) {
+    float* box = raw_boxes->data() + i * kNumCoords;
+    float min_distance = 1.0f;
+    for (const auto& object : objects) {
+      const float dx = object[0] - anchors[i].x_center();
+      const float dy = object[1] - anchors[i].y_center();
+      min_distance = std::min(min_distance, std::sqrt(dx * dx + dy * dy));
+    }
+    // Boxes are in reversed order: x_center, y_center, w, h.
+    box[0] = 128.0f * 0.02f * (unit(rng) - 0.5f);
+    box[1] = 128.0f * 0.02f * (unit(rng) - 0.5f);
+    box[2] = 128.0f * (0.15f + 0.05f * unit(rng));
+    box[3] = 128.0f * (0.15f + 0.05f * unit(rng));
+    for (int k = 4; k < kNumCoords; ++k) {
+      box[k] = 128.0f * 0.1f * (unit(rng) - 0.5f);
+    }
+    (*raw_scores)[i] = 4.0f - 60.0f * min_distance + 2.0f * unit(rng);
+  }
+}
+
+// Returns a [1, kNumBoxes, depth] float tensor on "data".
+TfLiteTensor MakeTensor(std::vector<float>* data, int depth) {
+  TfLiteTensor tensor = {};
+  tensor.type = kTfLiteFloat32;
+  tensor.data.f = data->data();
+  tensor.bytes = data->size() * sizeof(float);
+  tensor.dims = TfLiteIntArrayCreate(3);
+  tensor.dims->data[0] = 1;
+  tensor.dims->data[1] = kNumBoxes;
+  tensor.dims->data[2] = depth;
+  return tensor;
+}
+
+std::vector<Detection> RunGraph(const CalculatorGraphConfig& config,
+                                const std::vector<Anchor>& anchors,
+                                int seed) {
+  std::vector<float> raw_boxes;
+  std::vector<float> raw_scores;
+  MakeRawValues(anchors, seed, &raw_boxes, &raw_scores);
+  std::vector<TfLiteTensor> tensors = {MakeTensor(&raw_boxes, kNumCoords),
+                                       MakeTensor(&raw_scores, 1)};
+
+  CalculatorGraphConfig graph_config = config;
+  std::vector<Packet> output_packets;
+  tool::AddVectorSink("detections", &graph_config, &output_packets);
+  CalculatorGraph graph;
+  MP_EXPECT_OK(graph.Initialize(graph_config));
+  MP_EXPECT_OK(graph.StartRun({{"anchors", MakePacket<std::vector<Anchor>>(
+                                               anchors)}}));
+  MP_EXPECT_OK(graph.AddPacketToInputStream(
+      "tensors",
+      MakePacket<std::vector<TfLiteTensor>>(tensors).At(Timestamp(0))));
+  MP_EXPECT_OK(graph.CloseAllInputStreams());
+  MP_EXPECT_OK(graph.WaitUntilDone());
+  for (TfLiteTensor& tensor : tensors) TfLiteIntArrayFree(tensor.dims);
+
+  if (output_packets.empty()) return {};
+  EXPECT_EQ(output_packets.size(), 1);
+  return output_packets[0].Get<std::vector<Detection>>();
+}
+
+// Checks that the calculator's own suppression gives the same detections as a
+// separate NonMaxSuppressionCalculator.
+void ExpectFusedMatchesSeparate(const std::string& nms_options,
+                                bool flip_vertically) {
+  const std::vector<Anchor> anchors = MakeAnchors();
+  for (int seed = 0; seed < 3; ++seed) {
+    const std::vector<Detection> expected = RunGraph(
+        MakeGraph(flip_vertically, nms_options, /*fused=*/false), anchors,
+        seed);
+    const std::vector<Detection> fused = RunGraph(
+        MakeGraph(flip_vertically, nms_options, /*fused=*/true), anchors, seed);
+    EXPECT_FALSE(expected.empty());
+    ASSERT_EQ(fused.size(), expected.size()) << "seed=" << seed;
+    for (int i = 0; i < fused.size(); ++i) {
+      EXPECT_THAT(fused[i], EqualsProto(expected[i])) << "seed=" << seed;
+    }
+  }
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, HardNmsMatchesSeparateNms) {
+  const std::string nms_options = R"(
+    min_suppression_threshold: 0.3
+    overlap_type: INTERSECTION_OVER_UNION
+  )";
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/false);
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/true);
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, WeightedNmsMatchesSeparateNms) {
+  const std::string nms_options = R"(
+    min_suppression_threshold: 0.3
+    overlap_type: INTERSECTION_OVER_UNION
+    algorithm: WEIGHTED
+  )";
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/false);
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/true);
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, SoftNmsMatchesSeparateNms) {
+  const std::string nms_options = R"(
+    overlap_type: JACCARD
+    algorithm: SOFT
+    max_num_detections: 5
+  )";
+  ExpectFusedMatchesSeparate(nms_options, /*flip_vertically=*/false);
+}
+
+TEST(TfLiteTensorsToDetectionsCalculatorTest, NmsKeepsTopCandidates) {
+  const std::vector<Anchor> anchors = MakeAnchors();
+  const std::vector<Detection> all =
+      RunGraph(MakeGraph(/*flip_vertically=*/false,
+                         "min_suppression_threshold: 1.0", /*fused=*/true),
+               anchors, /*seed=*/0);
+  const std::vector<Detection> top = RunGraph(
+      MakeGraph(/*flip_vertically=*/false,
+                "min_suppression_threshold: 1.0 max_num_candidates: 4",
+                /*fused=*/true),
+      anchors, /*seed=*/0);
+  ASSERT_GT(all.size(), 4);
+  ASSERT_EQ(top.size(), 4);
+  for (int i = 0; i < top.size(); ++i) {
+    EXPECT_THAT(top[i], EqualsProto(all[i]));
+  }
+}
+
+}  // namespace
+}  // namespace mediapipe
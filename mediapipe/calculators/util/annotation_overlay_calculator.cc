@@ -20,6 +20,7 @@
 #include "mediapipe/framework/calculator_options.pb.h"
 #include "mediapipe/framework/formats/image_format.pb.h"
 #include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
 #include "mediapipe/framework/formats/image_frame_opencv.h"
 #include "mediapipe/framework/formats/video_stream_header.h"
 #include "mediapipe/framework/port/logging.h"
@@ -27,6 +28,7 @@
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/port/vector.h"
+#include "mediapipe/util/annotation_overlay_canvas.h"
 #include "mediapipe/util/annotation_renderer.h"
 #include "mediapipe/util/color.pb.h"
 #include "mediapipe/util/render_data.pb.h"
@@ -84,6 +86,11 @@ inline bool HasImageTag(mediapipe::CalculatorContext* cc) { return false; }
 //
 // For GPU input frames, only 4-channel images are supported.
 //
+// On CPU the annotations are drawn directly on the output frame, and an input
+// frame with no annotations at its timestamp is forwarded without a copy. On
+// GPU, only the rows of the overlay that changed since the previous frame are
+// cleared and uploaded.
+//
 // Note: When using GPU, drawing with color kAnnotationBackgroundColor (defined
 // above) is not supported.
 //
@@ -132,17 +139,18 @@ class AnnotationOverlayCalculator : public CalculatorBase {
   absl::Status Close(CalculatorContext* cc) override;
 
  private:
+  // Returns true if any RenderData at the current timestamp has annotations.
+  bool HasAnnotations(CalculatorContext* cc) const;
   absl::Status CreateRenderTargetCpu(CalculatorContext* cc,
-                                     std::unique_ptr<cv::Mat>& image_mat,
-                                     ImageFormat::Format* target_format);
+                                     std::unique_ptr<ImageFrame>& output_frame,
+                                     std::unique_ptr<cv::Mat>& image_mat);
   template <typename Type, const char* Tag>
   absl::Status CreateRenderTargetGpu(CalculatorContext* cc,
                                      std::unique_ptr<cv::Mat>& image_mat);
   template <typename Type, const char* Tag>
   absl::Status RenderToGpu(CalculatorContext* cc, uchar* overlay_image);
   absl::Status RenderToCpu(CalculatorContext* cc,
-                           const ImageFormat::Format& target_format,
-                           uchar* data_image);
+                           std::unique_ptr<ImageFrame> output_frame);
 
   absl::Status GlRender(CalculatorContext* cc);
   template <typename Type, const char* Tag>
@@ -157,6 +165,9 @@ class AnnotationOverlayCalculator : public CalculatorBase {
   // Indicates if image frame is available as input.
   bool image_frame_available_ = false;
 
+  // Provides the CPU output frames.
+  ImageFrameMultiPool* frame_pool_ = nullptr;
+
   bool use_gpu_ = false;
   bool gpu_initialized_ = false;
 #if !MEDIAPIPE_DISABLE_GPU
@@ -167,6 +178,9 @@ class AnnotationOverlayCalculator : public CalculatorBase {
   int height_ = 0;
   int width_canvas_ = 0;  // Size of overlay drawing texture canvas.
   int height_canvas_ = 0;
+  // Overlay drawing canvas, kept between frames so that only the region drawn
+  // on in the previous frame has to be cleared and uploaded.
+  AnnotationOverlayCanvas overlay_canvas_;
 #endif  // MEDIAPIPE_DISABLE_GPU
 };
 REGISTER_CALCULATOR(AnnotationOverlayCalculator);
@@ -197,6 +211,9 @@ absl::Status AnnotationOverlayCalculator::GetContract(CalculatorContract* cc) {
     cc->Inputs().Tag(kImageFrameTag).Set<ImageFrame>();
     CHECK(cc->Outputs().HasTag(kImageFrameTag));
   }
+  if (!use_gpu) {
+    cc->UseService(kImageFrameMultiPoolService);
+  }
 
   // Data streams to render.
   for (CollectionItemId id = cc->Inputs().BeginId(); id < cc->Inputs().EndId();
@@ -266,6 +283,8 @@ absl::Status AnnotationOverlayCalculator::Open(CalculatorContext* cc) {
 #if !MEDIAPIPE_DISABLE_GPU
     MP_RETURN_IF_ERROR(gpu_helper_.Open(cc));
 #endif  // !MEDIAPIPE_DISABLE_GPU
+  } else {
+    frame_pool_ = &cc->Service(kImageFrameMultiPoolService).GetObject();
   }
 
   return absl::OkStatus();
@@ -281,9 +300,19 @@ absl::Status AnnotationOverlayCalculator::Process(CalculatorContext* cc) {
     return absl::OkStatus();
   }
 
+  if (!use_gpu_ && image_frame_available_ && !HasAnnotations(cc) &&
+      cc->Inputs().Tag(kImageFrameTag).Get<ImageFrame>().Format() !=
+          ImageFormat::GRAY8) {
+    // Nothing to draw, the input frame is the output frame.
+    cc->Outputs()
+        .Tag(kImageFrameTag)
+        .AddPacket(cc->Inputs().Tag(kImageFrameTag).Value());
+    return absl::OkStatus();
+  }
+
   // Initialize render target, drawn with OpenCV.
   std::unique_ptr<cv::Mat> image_mat;
-  ImageFormat::Format target_format;
+  std::unique_ptr<ImageFrame> output_frame;
   if (use_gpu_) {
 #if !MEDIAPIPE_DISABLE_GPU
     if (!gpu_initialized_) {
@@ -301,7 +330,7 @@ absl::Status AnnotationOverlayCalculator::Process(CalculatorContext* cc) {
 #endif  // !MEDIAPIPE_DISABLE_GPU
   } else {
     if (cc->Outputs().HasTag(kImageFrameTag)) {
-      MP_RETURN_IF_ERROR(CreateRenderTargetCpu(cc, image_mat, &target_format));
+      MP_RETURN_IF_ERROR(CreateRenderTargetCpu(cc, output_frame, image_mat));
     }
   }
 
@@ -344,9 +373,8 @@ absl::Status AnnotationOverlayCalculator::Process(CalculatorContext* cc) {
         }));
 #endif  // !MEDIAPIPE_DISABLE_GPU
   } else {
-    // Copy the rendered image to output.
-    uchar* image_mat_ptr = image_mat->data;
-    MP_RETURN_IF_ERROR(RenderToCpu(cc, target_format, image_mat_ptr));
+    // The image was rendered in place.
+    MP_RETURN_IF_ERROR(RenderToCpu(cc, std::move(output_frame)));
   }
 
   return absl::OkStatus();
@@ -360,27 +388,37 @@ absl::Status AnnotationOverlayCalculator::Close(CalculatorContext* cc) {
     if (image_mat_tex_) glDeleteTextures(1, &image_mat_tex_);
     image_mat_tex_ = 0;
   });
+  overlay_canvas_.Reset();
 #endif  // !MEDIAPIPE_DISABLE_GPU
 
   return absl::OkStatus();
 }
 
-absl::Status AnnotationOverlayCalculator::RenderToCpu(
-    CalculatorContext* cc, const ImageFormat::Format& target_format,
-    uchar* data_image) {
-  auto output_frame = absl::make_unique<ImageFrame>(
-      target_format, renderer_->GetImageWidth(), renderer_->GetImageHeight());
-
-#if !MEDIAPIPE_DISABLE_GPU
-  output_frame->CopyPixelData(target_format, renderer_->GetImageWidth(),
-                              renderer_->GetImageHeight(), data_image,
-                              ImageFrame::kGlDefaultAlignmentBoundary);
-#else
-  output_frame->CopyPixelData(target_format, renderer_->GetImageWidth(),
-                              renderer_->GetImageHeight(), data_image,
-                              ImageFrame::kDefaultAlignmentBoundary);
-#endif  // !MEDIAPIPE_DISABLE_GPU
+bool AnnotationOverlayCalculator::HasAnnotations(
+    CalculatorContext* cc) const {
+  for (CollectionItemId id = cc->Inputs().BeginId(); id < cc->Inputs().EndId();
+       ++id) {
+    const std::string& tag = cc->Inputs().TagAndIndexFromId(id).first;
+    if ((!tag.empty() && tag != kVectorTag) || cc->Inputs().Get(id).IsEmpty()) {
+      continue;
+    }
+    if (tag.empty()) {
+      if (cc->Inputs().Get(id).Get<RenderData>().render_annotations_size() >
+          0) {
+        return true;
+      }
+    } else {
+      for (const RenderData& render_data :
+           cc->Inputs().Get(id).Get<std::vector<RenderData>>()) {
+        if (render_data.render_annotations_size() > 0) return true;
+      }
+    }
+  }
+  return false;
+}
 
+absl::Status AnnotationOverlayCalculator::RenderToCpu(
+    CalculatorContext* cc, std::unique_ptr<ImageFrame> output_frame) {
   if (cc->Outputs().HasTag(kImageFrameTag)) {
     cc->Outputs()
         .Tag(kImageFrameTag)
@@ -401,11 +439,15 @@ absl::Status AnnotationOverlayCalculator::RenderToGpu(CalculatorContext* cc,
   auto output_texture = gpu_helper_.CreateDestinationTexture(
       width_, height_, mediapipe::GpuBufferFormat::kBGRA32);
 
-  // Upload render target to GPU.
-  {
+  // Upload the rows of the render target that were cleared or drawn on since
+  // the last upload.
+  const AnnotationOverlayCanvas::RowRange rows =
+      overlay_canvas_.EndFrame(renderer_->GetDirtyRegion());
+  if (!rows.empty()) {
     glBindTexture(GL_TEXTURE_2D, image_mat_tex_);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width_canvas_, height_canvas_,
-                    GL_RGB, GL_UNSIGNED_BYTE, overlay_image);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, rows.first, width_canvas_,
+                    rows.end - rows.first, GL_RGB, GL_UNSIGNED_BYTE,
+                    overlay_image + rows.first * width_canvas_ * 3);
     glBindTexture(GL_TEXTURE_2D, 0);
   }
 
@@ -440,48 +482,55 @@ absl::Status AnnotationOverlayCalculator::RenderToGpu(CalculatorContext* cc,
 }
 
 absl::Status AnnotationOverlayCalculator::CreateRenderTargetCpu(
-    CalculatorContext* cc, std::unique_ptr<cv::Mat>& image_mat,
-    ImageFormat::Format* target_format) {
+    CalculatorContext* cc, std::unique_ptr<ImageFrame>& output_frame,
+    std::unique_ptr<cv::Mat>& image_mat) {
+#if !MEDIAPIPE_DISABLE_GPU
+  constexpr uint32 kAlignmentBoundary = ImageFrame::kGlDefaultAlignmentBoundary;
+#else
+  constexpr uint32 kAlignmentBoundary = ImageFrame::kDefaultAlignmentBoundary;
+#endif  // !MEDIAPIPE_DISABLE_GPU
   if (image_frame_available_) {
     const auto& input_frame =
         cc->Inputs().Tag(kImageFrameTag).Get<ImageFrame>();
 
-    int target_mat_type;
+    ImageFormat::Format target_format;
     switch (input_frame.Format()) {
       case ImageFormat::SRGBA:
-        *target_format = ImageFormat::SRGBA;
-        target_mat_type = CV_8UC4;
+        target_format = ImageFormat::SRGBA;
         break;
       case ImageFormat::SRGB:
-        *target_format = ImageFormat::SRGB;
-        target_mat_type = CV_8UC3;
+        target_format = ImageFormat::SRGB;
         break;
       case ImageFormat::GRAY8:
-        *target_format = ImageFormat::SRGB;
-        target_mat_type = CV_8UC3;
+        target_format = ImageFormat::SRGB;
         break;
       default:
         return absl::UnknownError("Unexpected image frame format.");
         break;
     }
 
-    image_mat = absl::make_unique<cv::Mat>(
-        input_frame.Height(), input_frame.Width(), target_mat_type);
+    // Render directly on the output frame, so the input is copied only once.
+    output_frame =
+        frame_pool_->GetFrame(target_format, input_frame.Width(),
+                              input_frame.Height(), kAlignmentBoundary);
+    image_mat =
+        absl::make_unique<cv::Mat>(formats::MatView(output_frame.get()));
 
     auto input_mat = formats::MatView(&input_frame);
     if (input_frame.Format() == ImageFormat::GRAY8) {
-      cv::Mat rgb_mat;
-      cv::cvtColor(input_mat, rgb_mat, CV_GRAY2RGB);
-      rgb_mat.copyTo(*image_mat);
+      cv::cvtColor(input_mat, *image_mat, CV_GRAY2RGB);
     } else {
       input_mat.copyTo(*image_mat);
     }
   } else {
-    image_mat = absl::make_unique<cv::Mat>(
-        options_.canvas_height_px(), options_.canvas_width_px(), CV_8UC3,
+    output_frame = frame_pool_->GetFrame(
+        ImageFormat::SRGB, options_.canvas_width_px(),
+        options_.canvas_height_px(), kAlignmentBoundary);
+    image_mat =
+        absl::make_unique<cv::Mat>(formats::MatView(output_frame.get()));
+    image_mat->setTo(
         cv::Scalar(options_.canvas_color().r(), options_.canvas_color().g(),
                    options_.canvas_color().b()));
-    *target_format = ImageFormat::SRGB;
   }
 
   return absl::OkStatus();
@@ -498,16 +547,15 @@ absl::Status AnnotationOverlayCalculator::CreateRenderTargetGpu(
     if (format != mediapipe::ImageFormat::SRGBA &&
         format != mediapipe::ImageFormat::SRGB)
       RET_CHECK_FAIL() << "Unsupported GPU input format: " << format;
-    image_mat =
-        absl::make_unique<cv::Mat>(height_canvas_, width_canvas_, CV_8UC3);
-    memset(image_mat->data, kAnnotationBackgroundColor,
-           height_canvas_ * width_canvas_ * image_mat->elemSize());
-  } else {
-    image_mat = absl::make_unique<cv::Mat>(
-        height_canvas_, width_canvas_, CV_8UC3,
-        cv::Scalar(options_.canvas_color().r(), options_.canvas_color().g(),
-                   options_.canvas_color().b()));
   }
+  const cv::Scalar background =
+      image_frame_available_
+          ? cv::Scalar::all(kAnnotationBackgroundColor)
+          : cv::Scalar(options_.canvas_color().r(), options_.canvas_color().g(),
+                       options_.canvas_color().b());
+  // Only the header is copied, the canvas is drawn on in place.
+  image_mat = absl::make_unique<cv::Mat>(
+      overlay_canvas_.BeginFrame(width_canvas_, height_canvas_, background));
 #endif  // !MEDIAPIPE_DISABLE_GPU
 
   return absl::OkStatus();
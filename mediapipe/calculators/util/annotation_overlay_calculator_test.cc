@@ -0,0 +1,115 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/formats/image_format.pb.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/image_frame_opencv.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/util/render_data.pb.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr int kWidth = 32;
+constexpr int kHeight = 24;
+
+Packet MakeImagePacket(ImageFormat::Format format, int timestamp) {
+  auto frame = absl::make_unique<ImageFrame>(format, kWidth, kHeight);
+  formats::MatView(frame.get()).setTo(cv::Scalar(40, 80, 120, 255));
+  return Adopt(frame.release()).At(Timestamp(timestamp));
+}
+
+Packet MakeRenderDataPacket(bool with_point, int timestamp) {
+  auto render_data = absl::make_unique<RenderData>();
+  if (with_point) {
+    RenderAnnotation* annotation = render_data->add_render_annotations();
+    annotation->mutable_color()->set_r(255);
+    annotation->set_thickness(2);
+    annotation->mutable_point()->set_x(10);
+    annotation->mutable_point()->set_y(10);
+  }
+  return Adopt(render_data.release()).At(Timestamp(timestamp));
+}
+
+CalculatorRunner MakeRunner() {
+  return CalculatorRunner(ParseTextProtoOrDie<CalculatorGraphConfig::Node>(R"pb(
+    calculator: "AnnotationOverlayCalculator"
+    input_stream: "IMAGE:image"
+    input_stream: "render_data"
+    output_stream: "IMAGE:output_image"
+  )pb"));
+}
+
+TEST(AnnotationOverlayCalculatorTest, ForwardsInputFrameWithoutAnnotations) {
+  CalculatorRunner runner = MakeRunner();
+  // No annotations at all, then an empty RenderData, then a point.
+  runner.MutableInputs()->Tag("IMAGE").packets.push_back(
+      MakeImagePacket(ImageFormat::SRGB, 0));
+  runner.MutableInputs()->Tag("IMAGE").packets.push_back(
+      MakeImagePacket(ImageFormat::SRGBA, 1));
+  runner.MutableInputs()->Index(0).packets.push_back(
+      MakeRenderDataPacket(/*with_point=*/false, 1));
+  runner.MutableInputs()->Tag("IMAGE").packets.push_back(
+      MakeImagePacket(ImageFormat::SRGB, 2));
+  runner.MutableInputs()->Index(0).packets.push_back(
+      MakeRenderDataPacket(/*with_point=*/true, 2));
+  MP_ASSERT_OK(runner.Run());
+
+  const auto& inputs = runner.MutableInputs()->Tag("IMAGE").packets;
+  const auto& outputs = runner.Outputs().Tag("IMAGE").packets;
+  ASSERT_EQ(outputs.size(), 3);
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(outputs[i].Timestamp(), inputs[i].Timestamp());
+    // The input frame itself is the output.
+    EXPECT_EQ(&outputs[i].Get<ImageFrame>(), &inputs[i].Get<ImageFrame>());
+  }
+
+  // With an annotation, the frame is drawn on a copy of the input.
+  const ImageFrame& input = inputs[2].Get<ImageFrame>();
+  const ImageFrame& output = outputs[2].Get<ImageFrame>();
+  EXPECT_NE(&output, &input);
+  EXPECT_EQ(output.Format(), ImageFormat::SRGB);
+  const cv::Mat input_mat = formats::MatView(&input);
+  const cv::Mat output_mat = formats::MatView(&output);
+  EXPECT_EQ(output_mat.at<cv::Vec3b>(10, 10), cv::Vec3b(255, 0, 0));
+  EXPECT_EQ(output_mat.at<cv::Vec3b>(0, 31), input_mat.at<cv::Vec3b>(0, 31));
+  // The input is left unchanged.
+  EXPECT_EQ(input_mat.at<cv::Vec3b>(10, 10), cv::Vec3b(40, 80, 120));
+}
+
+TEST(AnnotationOverlayCalculatorTest, ConvertsGrayFramesWithoutAnnotations) {
+  CalculatorRunner runner = MakeRunner();
+  runner.MutableInputs()->Tag("IMAGE").packets.push_back(
+      MakeImagePacket(ImageFormat::GRAY8, 0));
+  MP_ASSERT_OK(runner.Run());
+
+  const auto& outputs = runner.Outputs().Tag("IMAGE").packets;
+  ASSERT_EQ(outputs.size(), 1);
+  // GRAY8 frames are always output as SRGB, so they can't be forwarded.
+  const ImageFrame& output = outputs[0].Get<ImageFrame>();
+  EXPECT_EQ(output.Format(), ImageFormat::SRGB);
+  EXPECT_EQ(formats::MatView(&output).at<cv::Vec3b>(5, 5),
+            cv::Vec3b(40, 40, 40));
+}
+
+}  // namespace
+}  // namespace mediapipe
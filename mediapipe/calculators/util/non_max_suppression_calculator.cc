@@ -26,11 +26,11 @@
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/rectangle.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/util/non_max_suppression.h"
 
 namespace mediapipe {
 
 typedef std::vector<Detection> Detections;
-typedef std::vector<std::pair<int, float>> IndexedScores;
 
 namespace {
 
@@ -73,51 +73,86 @@ bool RetainMaxScoringLabelOnly(Detection* detection) {
   return true;
 }
 
-// Computes an overlap similarity between two rectangles. Similarity measure is
-// defined by overlap_type parameter.
-float OverlapSimilarity(
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Rectangle_f& rect1, const Rectangle_f& rect2) {
-  if (!rect1.Intersects(rect2)) return 0.0f;
-  const float intersection_area = Rectangle_f(rect1).Intersect(rect2).Area();
-  float normalization;
+NmsOptions::OverlapType GetOverlapType(
+    NonMaxSuppressionCalculatorOptions::OverlapType overlap_type) {
   switch (overlap_type) {
     case NonMaxSuppressionCalculatorOptions::JACCARD:
-      normalization = Rectangle_f(rect1).Union(rect2).Area();
-      break;
+      return NmsOptions::OverlapType::kJaccard;
     case NonMaxSuppressionCalculatorOptions::MODIFIED_JACCARD:
-      normalization = rect2.Area();
-      break;
+      return NmsOptions::OverlapType::kModifiedJaccard;
     case NonMaxSuppressionCalculatorOptions::INTERSECTION_OVER_UNION:
-      normalization = rect1.Area() + rect2.Area() - intersection_area;
-      break;
+      return NmsOptions::OverlapType::kIntersectionOverUnion;
     default:
       LOG(FATAL) << "Unrecognized overlap type: " << overlap_type;
   }
-  return normalization > 0.0f ? intersection_area / normalization : 0.0f;
 }
 
-// Computes an overlap similarity between two locations by first extracting the
-// relative box (dimension normalized by frame width/height) from the location.
-float OverlapSimilarity(
-    const int frame_width, const int frame_height,
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Location& location1, const Location& location2) {
-  const auto rect1 = location1.ConvertToRelativeBBox(frame_width, frame_height);
-  const auto rect2 = location2.ConvertToRelativeBBox(frame_width, frame_height);
-  return OverlapSimilarity(overlap_type, rect1, rect2);
+NmsOptions::Algorithm GetAlgorithm(
+    NonMaxSuppressionCalculatorOptions::NmsAlgorithm algorithm) {
+  switch (algorithm) {
+    case NonMaxSuppressionCalculatorOptions::WEIGHTED:
+      return NmsOptions::Algorithm::kWeighted;
+    case NonMaxSuppressionCalculatorOptions::SOFT:
+      return NmsOptions::Algorithm::kSoft;
+    default:
+      return NmsOptions::Algorithm::kHard;
+  }
 }
 
-// Computes an overlap similarity between two locations by first extracting the
-// relative box from the location. It assumes that a relative-box representation
-// is already available in the location, and therefore frame width and height
-// are not needed for further normalization.
-float OverlapSimilarity(
-    const NonMaxSuppressionCalculatorOptions::OverlapType overlap_type,
-    const Location& location1, const Location& location2) {
-  const auto rect1 = location1.GetRelativeBBox();
-  const auto rect2 = location2.GetRelativeBBox();
-  return OverlapSimilarity(overlap_type, rect1, rect2);
+// Returns the relative bounding box of the detection. The frame size is only
+// needed if the location isn't already a relative bounding box.
+Rectangle_f GetRelativeBox(const Detection& detection,
+                           const ImageFrame* frame) {
+  const auto& location_data = detection.location_data();
+  if (location_data.format() == LocationData::RELATIVE_BOUNDING_BOX) {
+    const auto& box = location_data.relative_bounding_box();
+    return Rectangle_f(box.xmin(), box.ymin(), box.width(), box.height());
+  }
+  const Location location(location_data);
+  if (frame != nullptr) {
+    return location.ConvertToRelativeBBox(frame->Width(), frame->Height());
+  }
+  return location.GetRelativeBBox();
+}
+
+// Replaces the location of the detection by the score-weighted average of the
+// clustered detections.
+void SetWeightedLocation(const Detections& detections,
+                         const NmsResult& result, int k,
+                         Detection* weighted_detection) {
+  const int begin = result.cluster_offsets[k];
+  const int end = result.cluster_offsets[k + 1];
+  if (begin == end) return;
+  auto* weighted_location = weighted_detection->mutable_location_data()
+                                ->mutable_relative_bounding_box();
+  weighted_location->set_xmin(result.weighted_boxes.xmin[k]);
+  weighted_location->set_ymin(result.weighted_boxes.ymin[k]);
+  weighted_location->set_width(result.weighted_boxes.xmax[k] -
+                               weighted_location->xmin());
+  weighted_location->set_height(result.weighted_boxes.ymax[k] -
+                                weighted_location->ymin());
+
+  const int num_keypoints =
+      weighted_detection->location_data().relative_keypoints_size();
+  if (num_keypoints == 0) return;
+  std::vector<float> keypoints(num_keypoints * 2);
+  float total_score = 0.0f;
+  for (int m = begin; m < end; ++m) {
+    const Detection& candidate = detections[result.cluster_members[m]];
+    const float score = candidate.score(0);
+    total_score += score;
+    const auto& location_data = candidate.location_data();
+    for (int i = 0; i < num_keypoints; ++i) {
+      keypoints[i * 2] += location_data.relative_keypoints(i).x() * score;
+      keypoints[i * 2 + 1] += location_data.relative_keypoints(i).y() * score;
+    }
+  }
+  for (int i = 0; i < num_keypoints; ++i) {
+    auto* keypoint = weighted_detection->mutable_location_data()
+                         ->mutable_relative_keypoints(i);
+    keypoint->set_x(keypoints[i * 2] / total_score);
+    keypoint->set_y(keypoints[i * 2 + 1] / total_score);
+  }
 }
 
 }  // namespace
@@ -177,6 +212,13 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
         << "max_num_detections=0 is not a valid value. Please choose a "
         << "positive number of you want to limit the number of output "
         << "detections, or set -1 if you do not want any limit.";
+    nms_options_.algorithm = GetAlgorithm(options_.algorithm());
+    nms_options_.overlap_type = GetOverlapType(options_.overlap_type());
+    nms_options_.min_suppression_threshold =
+        options_.min_suppression_threshold();
+    nms_options_.min_score_threshold = options_.min_score_threshold();
+    nms_options_.max_num_detections = options_.max_num_detections();
+    nms_options_.soft_nms_sigma = options_.soft_nms_sigma();
     return absl::OkStatus();
   }
 
@@ -210,37 +252,40 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
     pruned_detections.reserve(input_detections.size());
     for (auto& detection : input_detections) {
       if (RetainMaxScoringLabelOnly(&detection)) {
-        pruned_detections.push_back(detection);
+        pruned_detections.push_back(std::move(detection));
       }
     }
 
-    // Copy all the scores (there is a single score in each detection after
-    // the above pruning) to an indexed vector for sorting. The first value is
-    // the index of the detection in the original vector from which the score
-    // stems, while the second is the actual score.
-    IndexedScores indexed_scores;
-    indexed_scores.reserve(pruned_detections.size());
-    for (int index = 0; index < pruned_detections.size(); ++index) {
-      indexed_scores.push_back(
-          std::make_pair(index, pruned_detections[index].score(0)));
+    // Extract the boxes once, into the packed arrays of the NMS engine.
+    const ImageFrame* frame = nullptr;
+    if (cc->Inputs().HasTag(kImageTag) &&
+        !cc->Inputs().Tag(kImageTag).IsEmpty()) {
+      frame = &cc->Inputs().Tag(kImageTag).Get<ImageFrame>();
     }
-    std::sort(indexed_scores.begin(), indexed_scores.end(), SortBySecond);
+    NmsBoxes boxes;
+    boxes.Reserve(pruned_detections.size());
+    for (const auto& detection : pruned_detections) {
+      const Rectangle_f box = GetRelativeBox(detection, frame);
+      boxes.Add(box.xmin(), box.ymin(), box.xmax(), box.ymax(),
+                detection.score(0));
+    }
+    const NmsResult result = NonMaxSuppression(boxes, nms_options_);
 
-    const int max_num_detections =
-        (options_.max_num_detections() > -1)
-            ? options_.max_num_detections()
-            : static_cast<int>(indexed_scores.size());
-    // A set of detections and locations, wrapping the location data from each
-    // detection, which are retained after the non-maximum suppression.
     auto* retained_detections = new Detections();
-    retained_detections->reserve(max_num_detections);
-
-    if (options_.algorithm() == NonMaxSuppressionCalculatorOptions::WEIGHTED) {
-      WeightedNonMaxSuppression(indexed_scores, pruned_detections,
-                                max_num_detections, cc, retained_detections);
-    } else {
-      NonMaxSuppression(indexed_scores, pruned_detections, max_num_detections,
-                        cc, retained_detections);
+    retained_detections->reserve(result.indices.size());
+    for (int k = 0; k < result.indices.size(); ++k) {
+      retained_detections->push_back(pruned_detections[result.indices[k]]);
+      Detection& detection = retained_detections->back();
+      switch (nms_options_.algorithm) {
+        case NmsOptions::Algorithm::kWeighted:
+          SetWeightedLocation(pruned_detections, result, k, &detection);
+          break;
+        case NmsOptions::Algorithm::kSoft:
+          detection.set_score(0, result.scores[k]);
+          break;
+        case NmsOptions::Algorithm::kHard:
+          break;
+      }
     }
 
     cc->Outputs().Index(0).Add(retained_detections, cc->InputTimestamp());
@@ -249,136 +294,8 @@ class NonMaxSuppressionCalculator : public CalculatorBase {
   }
 
  private:
-  void NonMaxSuppression(const IndexedScores& indexed_scores,
-                         const Detections& detections, int max_num_detections,
-                         CalculatorContext* cc, Detections* output_detections) {
-    std::vector<Location> retained_locations;
-    retained_locations.reserve(max_num_detections);
-    // We traverse the detections by decreasing score.
-    for (const auto& indexed_score : indexed_scores) {
-      const auto& detection = detections[indexed_score.first];
-      if (options_.min_score_threshold() > 0 &&
-          detection.score(0) < options_.min_score_threshold()) {
-        break;
-      }
-      const Location location(detection.location_data());
-      bool suppressed = false;
-      // The current detection is suppressed iff there exists a retained
-      // detection, whose location overlaps more than the specified
-      // threshold with the location of the current detection.
-      for (const auto& retained_location : retained_locations) {
-        float similarity;
-        if (cc->Inputs().HasTag(kImageTag)) {
-          const auto& frame = cc->Inputs().Tag(kImageTag).Get<ImageFrame>();
-          similarity = OverlapSimilarity(frame.Width(), frame.Height(),
-                                         options_.overlap_type(),
-                                         retained_location, location);
-        } else {
-          similarity = OverlapSimilarity(options_.overlap_type(),
-                                         retained_location, location);
-        }
-        if (similarity > options_.min_suppression_threshold()) {
-          suppressed = true;
-          break;
-        }
-      }
-      if (!suppressed) {
-        output_detections->push_back(detection);
-        retained_locations.push_back(location);
-      }
-      if (output_detections->size() >= max_num_detections) {
-        break;
-      }
-    }
-  }
-
-  void WeightedNonMaxSuppression(const IndexedScores& indexed_scores,
-                                 const Detections& detections,
-                                 int max_num_detections, CalculatorContext* cc,
-                                 Detections* output_detections) {
-    IndexedScores remained_indexed_scores;
-    remained_indexed_scores.assign(indexed_scores.begin(),
-                                   indexed_scores.end());
-
-    IndexedScores remained;
-    IndexedScores candidates;
-    output_detections->clear();
-    while (!remained_indexed_scores.empty()) {
-      const int original_indexed_scores_size = remained_indexed_scores.size();
-      const auto& detection = detections[remained_indexed_scores[0].first];
-      if (options_.min_score_threshold() > 0 &&
-          detection.score(0) < options_.min_score_threshold()) {
-        break;
-      }
-      remained.clear();
-      candidates.clear();
-      const Location location(detection.location_data());
-      // This includes the first box.
-      for (const auto& indexed_score : remained_indexed_scores) {
-        Location rest_location(detections[indexed_score.first].location_data());
-        float similarity =
-            OverlapSimilarity(options_.overlap_type(), rest_location, location);
-        if (similarity > options_.min_suppression_threshold()) {
-          candidates.push_back(indexed_score);
-        } else {
-          remained.push_back(indexed_score);
-        }
-      }
-      auto weighted_detection = detection;
-      if (!candidates.empty()) {
-        const int num_keypoints =
-            detection.location_data().relative_keypoints_size();
-        std::vector<float> keypoints(num_keypoints * 2);
-        float w_xmin = 0.0f;
-        float w_ymin = 0.0f;
-        float w_xmax = 0.0f;
-        float w_ymax = 0.0f;
-        float total_score = 0.0f;
-        for (const auto& candidate : candidates) {
-          total_score += candidate.second;
-          const auto& location_data =
-              detections[candidate.first].location_data();
-          const auto& bbox = location_data.relative_bounding_box();
-          w_xmin += bbox.xmin() * candidate.second;
-          w_ymin += bbox.ymin() * candidate.second;
-          w_xmax += (bbox.xmin() + bbox.width()) * candidate.second;
-          w_ymax += (bbox.ymin() + bbox.height()) * candidate.second;
-
-          for (int i = 0; i < num_keypoints; ++i) {
-            keypoints[i * 2] +=
-                location_data.relative_keypoints(i).x() * candidate.second;
-            keypoints[i * 2 + 1] +=
-                location_data.relative_keypoints(i).y() * candidate.second;
-          }
-        }
-        auto* weighted_location = weighted_detection.mutable_location_data()
-                                      ->mutable_relative_bounding_box();
-        weighted_location->set_xmin(w_xmin / total_score);
-        weighted_location->set_ymin(w_ymin / total_score);
-        weighted_location->set_width((w_xmax / total_score) -
-                                     weighted_location->xmin());
-        weighted_location->set_height((w_ymax / total_score) -
-                                      weighted_location->ymin());
-        for (int i = 0; i < num_keypoints; ++i) {
-          auto* keypoint = weighted_detection.mutable_location_data()
-                               ->mutable_relative_keypoints(i);
-          keypoint->set_x(keypoints[i * 2] / total_score);
-          keypoint->set_y(keypoints[i * 2 + 1] / total_score);
-        }
-      }
-
-      output_detections->push_back(weighted_detection);
-      // Breaks the loop if the size of indexed scores doesn't change after an
-      // iteration.
-      if (original_indexed_scores_size == remained.size()) {
-        break;
-      } else {
-        remained_indexed_scores = std::move(remained);
-      }
-    }
-  }
-
   NonMaxSuppressionCalculatorOptions options_;
+  NmsOptions nms_options_;
 };
 REGISTER_CALCULATOR(NonMaxSuppressionCalculator);
 
@@ -0,0 +1,114 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/video_stream_header.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/tool/options_util.h"
+#include "mediapipe/util/video_decoder.h"
+#include "mediapipe/util/video_decoder.pb.h"
+
+namespace mediapipe {
+
+// The VideoDecoderCalculator decodes a video stream of a media file with
+// FFmpeg. Unlike OpenCvVideoDecoderCalculator, decoding runs on background
+// threads ahead of Process(), and the output can be thinned to every Nth
+// frame, a target frame rate or the key frames, skipping the decoding of
+// frames which are not output where the codec allows it. See VideoDecoder.
+//
+// Output Streams:
+//   VIDEO: Output video frames (ImageFrame).
+//   VIDEO_PRESTREAM:
+//       Optional video header information output at
+//       Timestamp::PreStream() for the corresponding stream.
+// Input Side Packets:
+//   INPUT_FILE_PATH: The input file path.
+//   OPTIONS: Optional VideoDecoderOptions, overriding the node options.
+//
+// Example config:
+// node {
+//   calculator: "VideoDecoderCalculator"
+//   input_side_packet: "INPUT_FILE_PATH:input_file_path"
+//   output_stream: "VIDEO:video_frames"
+//   output_stream: "VIDEO_PRESTREAM:video_header"
+//   node_options {
+//     [type.googleapis.com/mediapipe.VideoDecoderOptions]: {
+//       frame_selection: TARGET_FRAME_RATE
+//       target_frame_rate: 5
+//     }
+//   }
+// }
+class VideoDecoderCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc);
+
+  absl::Status Open(CalculatorContext* cc) override;
+  absl::Status Process(CalculatorContext* cc) override;
+  absl::Status Close(CalculatorContext* cc) override;
+
+ private:
+  std::unique_ptr<VideoDecoder> decoder_;
+};
+
+absl::Status VideoDecoderCalculator::GetContract(CalculatorContract* cc) {
+  cc->InputSidePackets().Tag("INPUT_FILE_PATH").Set<std::string>();
+  if (cc->InputSidePackets().HasTag("OPTIONS")) {
+    cc->InputSidePackets().Tag("OPTIONS").Set<mediapipe::VideoDecoderOptions>();
+  }
+  cc->Outputs().Tag("VIDEO").Set<ImageFrame>();
+  if (cc->Outputs().HasTag("VIDEO_PRESTREAM")) {
+    cc->Outputs().Tag("VIDEO_PRESTREAM").Set<VideoHeader>();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VideoDecoderCalculator::Open(CalculatorContext* cc) {
+  const std::string& input_file_path =
+      cc->InputSidePackets().Tag("INPUT_FILE_PATH").Get<std::string>();
+  const auto& decoder_options =
+      tool::RetrieveOptions(cc->Options<mediapipe::VideoDecoderOptions>(),
+                            cc->InputSidePackets(), "OPTIONS");
+  decoder_ = absl::make_unique<VideoDecoder>();
+  MP_RETURN_IF_ERROR(decoder_->Initialize(input_file_path, decoder_options));
+  if (cc->Outputs().HasTag("VIDEO_PRESTREAM")) {
+    auto header = absl::make_unique<VideoHeader>();
+    MP_RETURN_IF_ERROR(decoder_->FillVideoHeader(header.get()));
+    cc->Outputs()
+        .Tag("VIDEO_PRESTREAM")
+        .Add(header.release(), Timestamp::PreStream());
+    cc->Outputs().Tag("VIDEO_PRESTREAM").Close();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status VideoDecoderCalculator::Process(CalculatorContext* cc) {
+  Packet data;
+  auto status = decoder_->GetData(&data);
+  if (status.ok()) {
+    cc->Outputs().Tag("VIDEO").AddPacket(data);
+  }
+  return status;
+}
+
+absl::Status VideoDecoderCalculator::Close(CalculatorContext* cc) {
+  return decoder_->Close();
+}
+
+REGISTER_CALCULATOR(VideoDecoderCalculator);
+
+}  // namespace mediapipe
@@ -0,0 +1,159 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <set>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/substitute.h"
+#include "mediapipe/framework/calculator_runner.h"
+#include "mediapipe/framework/deps/file_path.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/video_stream_header.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+
+namespace {
+
+// The test video is 6 seconds of 1280x640 frames at 30 fps.
+constexpr int kNumFrames = 180;
+
+// Decodes the test video with the given decoder options, and returns the
+// runner holding its outputs.
+std::unique_ptr<CalculatorRunner> DecodeVideo(const std::string& options) {
+  CalculatorGraphConfig::Node node_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig::Node>(absl::Substitute(
+          R"pb(
+            calculator: "VideoDecoderCalculator"
+            input_side_packet: "INPUT_FILE_PATH:input_file_path"
+            output_stream: "VIDEO:video"
+            output_stream: "VIDEO_PRESTREAM:video_prestream"
+            node_options {
+              [type.googleapis.com/mediapipe.VideoDecoderOptions]: { $0 }
+            })pb",
+          options));
+  auto runner = absl::make_unique<CalculatorRunner>(node_config);
+  runner->MutableSidePackets()->Tag("INPUT_FILE_PATH") =
+      MakePacket<std::string>(
+          file::JoinPath("./",
+                         "/mediapipe/calculators/video/"
+                         "testdata/format_MP4_AVC720P_AAC.video"));
+  MP_EXPECT_OK(runner->Run());
+  return runner;
+}
+
+std::vector<Timestamp> GetTimestamps(const CalculatorRunner& runner) {
+  std::vector<Timestamp> timestamps;
+  for (const Packet& packet : runner.Outputs().Tag("VIDEO").packets) {
+    timestamps.push_back(packet.Timestamp());
+  }
+  return timestamps;
+}
+
+TEST(VideoDecoderCalculatorTest, DecodesAllFrames) {
+  auto runner = DecodeVideo("num_threads: 2 max_queued_frames: 2");
+  ASSERT_EQ(runner->Outputs().Tag("VIDEO_PRESTREAM").packets.size(), 1);
+  const VideoHeader& header =
+      runner->Outputs().Tag("VIDEO_PRESTREAM").packets[0].Get<VideoHeader>();
+  EXPECT_EQ(ImageFormat::SRGB, header.format);
+  EXPECT_EQ(1280, header.width);
+  EXPECT_EQ(640, header.height);
+  EXPECT_FLOAT_EQ(30.0f, header.frame_rate);
+  EXPECT_NEAR(6.0f, header.duration, 0.1f);
+
+  const std::vector<Packet>& packets = runner->Outputs().Tag("VIDEO").packets;
+  EXPECT_EQ(packets.size(), kNumFrames);
+  for (const Packet& packet : packets) {
+    const ImageFrame& frame = packet.Get<ImageFrame>();
+    EXPECT_EQ(ImageFormat::SRGB, frame.Format());
+    EXPECT_EQ(1280, frame.Width());
+    EXPECT_EQ(640, frame.Height());
+  }
+}
+
+TEST(VideoDecoderCalculatorTest, OutputsGrayFrames) {
+  auto runner = DecodeVideo("output_format: GRAY8");
+  const std::vector<Packet>& packets = runner->Outputs().Tag("VIDEO").packets;
+  ASSERT_EQ(packets.size(), kNumFrames);
+  EXPECT_EQ(ImageFormat::GRAY8, packets[0].Get<ImageFrame>().Format());
+}
+
+TEST(VideoDecoderCalculatorTest, SelectsEveryNthFrame) {
+  const std::vector<Timestamp> all_timestamps = GetTimestamps(*DecodeVideo(""));
+  ASSERT_EQ(all_timestamps.size(), kNumFrames);
+  auto runner = DecodeVideo("frame_selection: EVERY_NTH_FRAME frame_stride: 4");
+  EXPECT_FLOAT_EQ(7.5f, runner->Outputs()
+                            .Tag("VIDEO_PRESTREAM")
+                            .packets[0]
+                            .Get<VideoHeader>()
+                            .frame_rate);
+  std::vector<Timestamp> expected;
+  for (int i = 0; i < kNumFrames; i += 4) {
+    expected.push_back(all_timestamps[i]);
+  }
+  EXPECT_THAT(GetTimestamps(*runner), testing::ElementsAreArray(expected));
+}
+
+TEST(VideoDecoderCalculatorTest, SelectsTargetFrameRate) {
+  const std::vector<Timestamp> all_timestamps = GetTimestamps(*DecodeVideo(""));
+  auto runner = DecodeVideo(
+      "frame_selection: TARGET_FRAME_RATE target_frame_rate: 10");
+  EXPECT_FLOAT_EQ(10.0f, runner->Outputs()
+                             .Tag("VIDEO_PRESTREAM")
+                             .packets[0]
+                             .Get<VideoHeader>()
+                             .frame_rate);
+  const std::vector<Timestamp> timestamps = GetTimestamps(*runner);
+  EXPECT_EQ(timestamps.size(), kNumFrames / 3);
+  const std::set<Timestamp> all_timestamp_set(all_timestamps.begin(),
+                                              all_timestamps.end());
+  for (const Timestamp& timestamp : timestamps) {
+    EXPECT_TRUE(all_timestamp_set.count(timestamp)) << timestamp;
+  }
+}
+
+TEST(VideoDecoderCalculatorTest, SelectsKeyframes) {
+  const std::vector<Timestamp> all_timestamps = GetTimestamps(*DecodeVideo(""));
+  auto runner = DecodeVideo("frame_selection: KEYFRAMES_ONLY");
+  const std::vector<Timestamp> timestamps = GetTimestamps(*runner);
+  ASSERT_FALSE(timestamps.empty());
+  EXPECT_LT(timestamps.size(), all_timestamps.size());
+  EXPECT_EQ(timestamps.front(), all_timestamps.front());
+}
+
+TEST(VideoDecoderCalculatorTest, FailsOnMissingStream) {
+  CalculatorGraphConfig::Node node_config =
+      ParseTextProtoOrDie<CalculatorGraphConfig::Node>(R"pb(
+        calculator: "VideoDecoderCalculator"
+        input_side_packet: "INPUT_FILE_PATH:input_file_path"
+        output_stream: "VIDEO:video"
+        node_options {
+          [type.googleapis.com/mediapipe.VideoDecoderOptions]: {
+            stream_index: 1
+          }
+        })pb");
+  CalculatorRunner runner(node_config);
+  runner.MutableSidePackets()->Tag("INPUT_FILE_PATH") = MakePacket<std::string>(
+      file::JoinPath("./",
+                     "/mediapipe/calculators/video/"
+                     "testdata/format_MP4_AVC720P_AAC.video"));
+  EXPECT_FALSE(runner.Run().ok());
+}
+
+}  // namespace
+}  // namespace mediapipe
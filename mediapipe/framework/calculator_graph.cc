@@ -36,6 +36,7 @@
 #include "mediapipe/framework/calculator_base.h"
 #include "mediapipe/framework/counter_factory.h"
 #include "mediapipe/framework/delegating_executor.h"
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
 #include "mediapipe/framework/graph_service_manager.h"
 #include "mediapipe/framework/input_stream_manager.h"
 #include "mediapipe/framework/mediapipe_profiling.h"
@@ -56,6 +57,7 @@
 #include "mediapipe/framework/thread_pool_executor.h"
 #include "mediapipe/framework/thread_pool_executor.pb.h"
 #include "mediapipe/framework/tool/fill_packet_set.h"
+#include "mediapipe/framework/tool/name_util.h"
 #include "mediapipe/framework/tool/status_util.h"
 #include "mediapipe/framework/tool/tag_map.h"
 #include "mediapipe/framework/tool/validate.h"
@@ -585,6 +587,20 @@ absl::StatusOr<std::map<std::string, Packet>> CalculatorGraph::PrepareGpu(
 }
 #endif  // !MEDIAPIPE_DISABLE_GPU && !defined(__EMSCRIPTEN__)
 
+absl::Status CalculatorGraph::PrepareImageFrameMultiPool() {
+  if (service_manager_.GetServiceObject(kImageFrameMultiPoolService)) {
+    return absl::OkStatus();
+  }
+  for (const auto& node_type_info : validated_graph_->CalculatorInfos()) {
+    if (node_type_info.Contract().ServiceRequests().count(
+            kImageFrameMultiPoolService.key)) {
+      return service_manager_.SetServiceObject(kImageFrameMultiPoolService,
+                                               ImageFrameMultiPool::Create());
+    }
+  }
+  return absl::OkStatus();
+}
+
 absl::Status CalculatorGraph::PrepareForRun(
     const std::map<std::string, Packet>& extra_side_packets,
     const std::map<std::string, Packet>& stream_headers) {
@@ -605,6 +621,7 @@ absl::Status CalculatorGraph::PrepareForRun(
 #if !MEDIAPIPE_DISABLE_GPU
   ASSIGN_OR_RETURN(additional_side_packets, PrepareGpu(extra_side_packets));
 #endif  // !MEDIAPIPE_DISABLE_GPU && !defined(__EMSCRIPTEN__)
+  MP_RETURN_IF_ERROR(PrepareImageFrameMultiPool());
 
   const std::map<std::string, Packet>* input_side_packets;
   if (!additional_side_packets.empty()) {
@@ -649,6 +666,8 @@ absl::Status CalculatorGraph::PrepareForRun(
     RET_CHECK(default_executor);
   }
   scheduler_.Reset();
+  scheduler_.GetTimestampDeadlines()->Reset(
+      validated_graph_->Config().deadline_config().drop_expired());
 
   {
     absl::MutexLock lock(&full_input_streams_mutex_);
@@ -677,6 +696,7 @@ absl::Status CalculatorGraph::PrepareForRun(
                   std::placeholders::_1, std::placeholders::_2);
     node.SetQueueSizeCallbacks(queue_size_callback, queue_size_callback);
     scheduler_.AssignNodeToSchedulerQueue(&node);
+    node.SetTimestampDeadlines(scheduler_.GetTimestampDeadlines());
     // TODO: update calculator node to use GraphServiceManager
     // instead of service packets?
     const absl::Status result = node.PrepareForRun(
@@ -791,6 +811,12 @@ absl::Status CalculatorGraph::AddPacketToInputStream(
   return AddPacketToInputStreamInternal(stream_name, std::move(packet));
 }
 
+absl::Status CalculatorGraph::AddPacketToInputStream(
+    const std::string& stream_name, Packet packet, absl::Time deadline) {
+  scheduler_.GetTimestampDeadlines()->SetDeadline(packet.Timestamp(), deadline);
+  return AddPacketToInputStreamInternal(stream_name, std::move(packet));
+}
+
 // We avoid having two copies of this code for AddPacketToInputStream(
 // const Packet&) and AddPacketToInputStream(Packet &&) by having this
 // internal-only templated version.  T&& is a forwarding reference here, so
@@ -844,6 +870,15 @@ absl::Status CalculatorGraph::AddPacketToInputStreamInternal(
     }
   }
 
+  // The latency budget of a timestamp starts with its first packet.
+  const int64 latency_budget_usec =
+      validated_graph_->Config().deadline_config().latency_budget_usec();
+  if (latency_budget_usec > 0) {
+    scheduler_.GetTimestampDeadlines()->SetDeadline(
+        packet.Timestamp(),
+        absl::Now() + absl::Microseconds(latency_budget_usec));
+  }
+
   // Adding profiling info for a new packet entering the graph.
   const std::string* stream_id = &(*stream)->GetManager()->Name();
   profiler_->LogEvent(TraceEvent(TraceEvent::PROCESS)
@@ -1019,6 +1054,40 @@ void CalculatorGraph::CallStatusHandlers(GraphRunState graph_run_state,
 
 int CalculatorGraph::GetMaxInputStreamQueueSize() { return max_queue_size_; }
 
+std::vector<CalculatorGraph::InputStreamQueueStats>
+CalculatorGraph::GetInputStreamQueueStats() const {
+  std::vector<InputStreamQueueStats> result;
+  if (!input_stream_managers_) {
+    return result;
+  }
+  const auto& input_stream_infos = validated_graph_->InputStreamInfos();
+  result.reserve(input_stream_infos.size());
+  for (int index = 0; index < input_stream_infos.size(); ++index) {
+    const EdgeInfo& edge_info = input_stream_infos[index];
+    const InputStreamManager& stream = input_stream_managers_[index];
+    InputStreamQueueStats stats;
+    stats.node_name = tool::CanonicalNodeName(validated_graph_->Config(),
+                                              edge_info.parent_node.index);
+    stats.stream_name = edge_info.name;
+    stats.queue_size = stream.QueueSize();
+    stats.max_queue_size = stream.MaxQueueSize();
+    result.push_back(std::move(stats));
+  }
+  absl::MutexLock lock(&full_input_streams_mutex_);
+  for (int index = 0; index < result.size(); ++index) {
+    const InputStreamManager* stream = &input_stream_managers_[index];
+    auto it = num_throttled_.find(stream);
+    if (it != num_throttled_.end()) {
+      result[index].num_throttled = it->second;
+    }
+    it = num_max_queue_size_grown_.find(stream);
+    if (it != num_max_queue_size_grown_.end()) {
+      result[index].num_max_queue_size_grown = it->second;
+    }
+  }
+  return result;
+}
+
 void CalculatorGraph::UpdateThrottledNodes(InputStreamManager* stream,
                                            bool* stream_was_full) {
   // TODO Change the throttling code to use the index directly
@@ -1046,6 +1115,9 @@ void CalculatorGraph::UpdateThrottledNodes(InputStreamManager* stream,
     // in this function and is guarded by full_input_streams_mutex_.
     bool stream_is_full = stream->IsFull();
     if (*stream_was_full != stream_is_full) {
+      if (stream_is_full) {
+        ++num_throttled_[stream];
+      }
       for (int node_id : *upstream_nodes) {
         VLOG(2) << "Stream \"" << stream->Name() << "\" is "
                 << (stream_is_full ? "throttling" : "no longer throttling")
@@ -1144,6 +1216,10 @@ bool CalculatorGraph::UnthrottleSources() {
     }
     int new_size = stream->QueueSize() + 1;
     stream->SetMaxQueueSize(new_size);
+    {
+      absl::MutexLock lock(&full_input_streams_mutex_);
+      ++num_max_queue_size_grown_[stream];
+    }
     LOG_EVERY_N(WARNING, 100)
         << "Resolved a deadlock by increasing max_queue_size of input stream: "
         << stream->Name() << " to: " << new_size
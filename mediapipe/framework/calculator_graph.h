@@ -31,6 +31,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/flat_hash_set.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_base.h"
 #include "mediapipe/framework/calculator_node.h"
@@ -255,6 +256,14 @@ class CalculatorGraph {
   absl::Status AddPacketToInputStream(const std::string& stream_name,
                                       Packet&& packet);
 
+  // Same as above, but also sets the deadline for processing the timestamp of
+  // the packet. The earliest deadline set for a timestamp is kept, including
+  // the one derived from DeadlineConfig::latency_budget_usec. Calculators run
+  // for timestamps with earlier deadlines first, and skip timestamps past their
+  // deadline if DeadlineConfig::drop_expired is set.
+  absl::Status AddPacketToInputStream(const std::string& stream_name,
+                                      Packet packet, absl::Time deadline);
+
   // Sets the queue size of a graph input stream, overriding the graph default.
   absl::Status SetInputStreamMaxQueueSize(const std::string& stream_name,
                                           int max_queue_size);
@@ -311,6 +320,27 @@ class CalculatorGraph {
   // Returns the maximum input stream queue size.
   int GetMaxInputStreamQueueSize();
 
+  // The state of the queue of one calculator input stream, for monitoring.
+  struct InputStreamQueueStats {
+    // The canonical name of the calculator node reading the stream.
+    std::string node_name;
+    std::string stream_name;
+    // The number of packets in the queue, and its limit or -1 if unlimited.
+    int queue_size = 0;
+    int max_queue_size = -1;
+    // The number of times the queue became full and throttled its sources.
+    int64 num_throttled = 0;
+    // The number of times max_queue_size was grown to resolve a deadlock.
+    int64 num_max_queue_size_grown = 0;
+  };
+
+  // Returns the current state of every calculator input stream queue, in the
+  // order of the validated graph. May be called from any thread at any time
+  // after the graph has been initialized; the queue sizes are approximate
+  // while packets are in flight.
+  std::vector<InputStreamQueueStats> GetInputStreamQueueStats() const
+      ABSL_LOCKS_EXCLUDED(full_input_streams_mutex_);
+
   // Get the mode for adding packets to an input stream.
   GraphInputStreamAddMode GetGraphInputStreamAddMode() const;
 
@@ -376,6 +406,11 @@ class CalculatorGraph {
   absl::StatusOr<std::map<std::string, Packet>> PrepareGpu(
       const std::map<std::string, Packet>& side_packets);
 #endif  // !MEDIAPIPE_DISABLE_GPU && !defined(__EMSCRIPTEN__)
+
+  // Helper for PrepareForRun. Creates the graph-wide ImageFrameMultiPool if a
+  // node uses it and none has been set.
+  absl::Status PrepareImageFrameMultiPool();
+
   template <typename T>
   absl::Status SetServiceObject(const GraphService<T>& service,
                                 std::shared_ptr<T> object) {
@@ -580,6 +615,13 @@ class CalculatorGraph {
   std::vector<absl::flat_hash_set<InputStreamManager*>> full_input_streams_
       ABSL_GUARDED_BY(full_input_streams_mutex_);
 
+  // The number of times each input stream became full, and the number of
+  // times its max_queue_size was grown by UnthrottleSources().
+  absl::flat_hash_map<const InputStreamManager*, int64> num_throttled_
+      ABSL_GUARDED_BY(full_input_streams_mutex_);
+  absl::flat_hash_map<const InputStreamManager*, int64>
+      num_max_queue_size_grown_ ABSL_GUARDED_BY(full_input_streams_mutex_);
+
   // Maps stream names to graph input stream objects.
   absl::flat_hash_map<std::string, std::unique_ptr<GraphInputStream>>
       graph_input_streams_;
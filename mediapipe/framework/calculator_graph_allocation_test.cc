@@ -0,0 +1,139 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Counts the heap allocations made by a running graph for every frame. The
+// framework recycles calculator contexts, output queues and packet holders, so
+// in steady state only the packet payloads and a few bookkeeping structures
+// should be allocated. BM_PassThroughGraph reports the count in its
+// "allocs_per_frame" counter.
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status.h"
+
+namespace {
+std::atomic<int64_t> num_allocations{0};
+}  // namespace
+
+// Counts every allocation made through the global operator new.
+void* operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+void* operator new[](size_t size) { return ::operator new(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace mediapipe {
+namespace {
+
+constexpr int kNumWarmUpFrames = 100;
+constexpr double kMaxSequentialAllocationsPerFrame = 10;
+constexpr double kMaxParallelAllocationsPerFrame = 12;
+
+// A chain of pass-through nodes. The middle one runs up to "max_in_flight"
+// Process() calls in parallel, each with its own CalculatorContext.
+CalculatorGraphConfig PassThroughGraphConfig(int max_in_flight) {
+  auto config = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+    input_stream: "in"
+    output_stream: "out"
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "in"
+      output_stream: "a"
+    }
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "a"
+      output_stream: "b"
+    }
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "b"
+      output_stream: "out"
+    }
+  )pb");
+  config.mutable_node(1)->set_max_in_flight(max_in_flight);
+  return config;
+}
+
+// Runs "num_frames" frames through the graph after a warm-up period and
+// returns the average number of heap allocations per frame.
+double MeasureAllocationsPerFrame(const CalculatorGraphConfig& config,
+                                  int num_frames) {
+  CalculatorGraph graph;
+  MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+  std::atomic<int> num_outputs{0};
+  MEDIAPIPE_CHECK_OK(
+      graph.ObserveOutputStream("out", [&num_outputs](const Packet&) {
+        num_outputs.fetch_add(1, std::memory_order_relaxed);
+        return absl::OkStatus();
+      }));
+  MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+  int64 timestamp = 0;
+  auto run_frames = [&](int count) {
+    for (int i = 0; i < count; ++i) {
+      MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+          "in", MakePacket<int>(i).At(Timestamp(timestamp++))));
+    }
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilIdle());
+  };
+  run_frames(kNumWarmUpFrames);
+  const int64_t allocations_before = num_allocations.load();
+  run_frames(num_frames);
+  const int64_t allocations = num_allocations.load() - allocations_before;
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  CHECK_EQ(num_outputs.load(), kNumWarmUpFrames + num_frames);
+  return static_cast<double>(allocations) / num_frames;
+}
+
+TEST(CalculatorGraphAllocationTest, SequentialNodes) {
+  const double allocations_per_frame =
+      MeasureAllocationsPerFrame(PassThroughGraphConfig(1), 1000);
+  LOG(INFO) << "Allocations per frame: " << allocations_per_frame;
+  EXPECT_LT(allocations_per_frame, kMaxSequentialAllocationsPerFrame);
+}
+
+TEST(CalculatorGraphAllocationTest, ParallelNode) {
+  const double allocations_per_frame =
+      MeasureAllocationsPerFrame(PassThroughGraphConfig(4), 1000);
+  LOG(INFO) << "Allocations per frame: " << allocations_per_frame;
+  EXPECT_LT(allocations_per_frame, kMaxParallelAllocationsPerFrame);
+}
+
+void BM_PassThroughGraph(benchmark::State& state) {
+  const CalculatorGraphConfig config = PassThroughGraphConfig(state.range(0));
+  double allocations_per_frame = 0;
+  for (auto _ : state) {
+    allocations_per_frame = MeasureAllocationsPerFrame(config, 1000);
+  }
+  state.counters["allocs_per_frame"] = allocations_per_frame;
+}
+
+BENCHMARK(BM_PassThroughGraph)->Arg(1)->Arg(4);
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,198 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/framework/timestamp_deadlines.h"
+
+namespace mediapipe {
+namespace {
+
+using ::testing::ElementsAre;
+
+// Blocks in Process() until "release" is notified.
+absl::Notification* blocked = nullptr;
+absl::Notification* release = nullptr;
+
+class BlockingCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) final {
+    blocked->Notify();
+    release->WaitForNotification();
+    return absl::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(BlockingCalculator);
+
+// Records the input timestamps of all Process() calls.
+absl::Mutex timestamps_mutex;
+std::vector<Timestamp>* processed_timestamps = nullptr;
+
+class RecordingCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) final {
+    absl::MutexLock lock(&timestamps_mutex);
+    processed_timestamps->push_back(cc->InputTimestamp());
+    return absl::OkStatus();
+  }
+};
+REGISTER_CALCULATOR(RecordingCalculator);
+
+TEST(TimestampDeadlinesTest, KeepsEarliestDeadline) {
+  internal::TimestampDeadlines deadlines;
+  const absl::Time now = absl::Now();
+  EXPECT_EQ(deadlines.GetDeadline(Timestamp(1)), absl::InfiniteFuture());
+  deadlines.SetDeadline(Timestamp(1), now + absl::Seconds(2));
+  deadlines.SetDeadline(Timestamp(1), now + absl::Seconds(1));
+  deadlines.SetDeadline(Timestamp(1), now + absl::Seconds(3));
+  EXPECT_EQ(deadlines.GetDeadline(Timestamp(1)), now + absl::Seconds(1));
+  EXPECT_EQ(deadlines.GetDeadline(Timestamp(2)), absl::InfiniteFuture());
+
+  deadlines.SetDeadline(Timestamp(2), absl::InfinitePast());
+  EXPECT_FALSE(deadlines.ShouldDrop(Timestamp(2)));
+  deadlines.Reset(/*drop_expired=*/true);
+  EXPECT_EQ(deadlines.GetDeadline(Timestamp(1)), absl::InfiniteFuture());
+  deadlines.SetDeadline(Timestamp(2), absl::InfinitePast());
+  EXPECT_TRUE(deadlines.ShouldDrop(Timestamp(2)));
+  EXPECT_FALSE(deadlines.ShouldDrop(Timestamp(3)));
+}
+
+TEST(CalculatorGraphDeadlineTest, DropsExpiredTimestamps) {
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "in"
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "in"
+          output_stream: "mid"
+        }
+        node { calculator: "RecordingCalculator" input_stream: "mid" }
+        deadline_config { drop_expired: true }
+        profiler_config { trace_enabled: true trace_log_disabled: true }
+      )pb");
+  std::vector<Timestamp> timestamps;
+  processed_timestamps = &timestamps;
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  MP_ASSERT_OK(graph.StartRun({}));
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "in", MakePacket<int>(0).At(Timestamp(0)), absl::InfinitePast()));
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "in", MakePacket<int>(1).At(Timestamp(1)), absl::InfiniteFuture()));
+  MP_ASSERT_OK(
+      graph.AddPacketToInputStream("in", MakePacket<int>(2).At(Timestamp(2))));
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  EXPECT_THAT(timestamps, ElementsAre(Timestamp(1), Timestamp(2)));
+
+  // The first calculator drops the timestamp, so the second one never sees it.
+  GraphTrace trace;
+  graph.profiler()->tracer()->GetTrace(absl::InfinitePast(),
+                                       absl::InfiniteFuture(), &trace);
+  std::vector<int> dropping_nodes;
+  for (const auto& calculator_trace : trace.calculator_trace()) {
+    if (calculator_trace.event_type() == GraphTrace::DEADLINE_EXCEEDED) {
+      EXPECT_EQ(calculator_trace.input_timestamp() + trace.base_timestamp(), 0);
+      dropping_nodes.push_back(calculator_trace.node_id());
+    }
+  }
+  EXPECT_THAT(dropping_nodes, ElementsAre(0));
+  processed_timestamps = nullptr;
+}
+
+TEST(CalculatorGraphDeadlineTest, KeepsExpiredTimestampsByDefault) {
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "in"
+        node { calculator: "RecordingCalculator" input_stream: "in" }
+        deadline_config { latency_budget_usec: 1 }
+      )pb");
+  std::vector<Timestamp> timestamps;
+  processed_timestamps = &timestamps;
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  MP_ASSERT_OK(graph.StartRun({}));
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "in", MakePacket<int>(0).At(Timestamp(0)), absl::InfinitePast()));
+  MP_ASSERT_OK(
+      graph.AddPacketToInputStream("in", MakePacket<int>(1).At(Timestamp(1))));
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  EXPECT_THAT(timestamps, ElementsAre(Timestamp(0), Timestamp(1)));
+  processed_timestamps = nullptr;
+}
+
+TEST(CalculatorGraphDeadlineTest, RunsEarliestDeadlineFirst) {
+  // Without deadlines, the node reading "b" would run first because it has
+  // the higher node id.
+  CalculatorGraphConfig config =
+      ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+        input_stream: "gate"
+        input_stream: "a"
+        input_stream: "b"
+        num_threads: 1
+        node { calculator: "BlockingCalculator" input_stream: "gate" }
+        node { calculator: "RecordingCalculator" input_stream: "a" }
+        node { calculator: "RecordingCalculator" input_stream: "b" }
+      )pb");
+  absl::Notification blocked_notification;
+  absl::Notification release_notification;
+  blocked = &blocked_notification;
+  release = &release_notification;
+  std::vector<Timestamp> timestamps;
+  processed_timestamps = &timestamps;
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(config));
+  MP_ASSERT_OK(graph.StartRun({}));
+
+  // Occupies the only worker thread while the other nodes are scheduled.
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "gate", MakePacket<int>(0).At(Timestamp(0))));
+  blocked_notification.WaitForNotification();
+  const absl::Time now = absl::Now();
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "b", MakePacket<int>(2).At(Timestamp(2)), now + absl::Hours(2)));
+  MP_ASSERT_OK(graph.AddPacketToInputStream(
+      "a", MakePacket<int>(1).At(Timestamp(1)), now + absl::Hours(1)));
+  release_notification.Notify();
+
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  EXPECT_THAT(timestamps, ElementsAre(Timestamp(1), Timestamp(2)));
+  processed_timestamps = nullptr;
+  blocked = nullptr;
+  release = nullptr;
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -60,6 +60,7 @@
 #include "mediapipe/framework/tool/sink.h"
 #include "mediapipe/framework/tool/status_util.h"
 #include "mediapipe/framework/type_map.h"
+#include "mediapipe/framework/work_stealing_executor.h"
 
 namespace mediapipe {
 
@@ -1580,6 +1581,26 @@ TEST(CalculatorGraph, RunsCorrectlyWithMultipleExecutors) {
   RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
 }
 
+TEST(CalculatorGraph, RunsCorrectlyWithWorkStealingExecutor) {
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.SetExecutor(
+      "", std::make_shared<WorkStealingExecutor>(ThreadOptions(), 4)));
+  CalculatorGraphConfig proto = GetConfig();
+  RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
+}
+
+TEST(CalculatorGraph, RunsCorrectlyWithWorkStealingDefaultExecutor) {
+  CalculatorGraph graph;
+  CalculatorGraphConfig proto = GetConfig();
+  ExecutorConfig* executor = proto.add_executor();
+  ThreadPoolExecutorOptions* extension =
+      executor->mutable_options()->MutableExtension(
+          ThreadPoolExecutorOptions::ext);
+  extension->set_num_threads(4);
+  extension->set_scheduling_policy(ThreadPoolExecutorOptions::WORK_STEALING);
+  RunComprehensiveTest(&graph, proto, /*define_node_5=*/true);
+}
+
 // Packet generator for an arbitrary unit64 packet.
 class Uint64PacketGenerator : public PacketGenerator {
  public:
@@ -291,10 +291,34 @@ absl::Status CalculatorNode::InitializeInputStreams(
             << " which will be connected to output stream with flat index "
             << output_stream_index;
     origin_output_stream_manager->AddMirror(input_stream_handler_.get(), id);
+    if (CanUseLockFreeQueue(output_stream_index)) {
+      VLOG(2) << "Input stream " << id.value() << " of " << DebugName()
+              << " uses a lock-free queue.";
+      current_input_stream_managers[id.value()].EnableLockFreeQueue();
+    }
   }
   return absl::OkStatus();
 }
 
+bool CalculatorNode::CanUseLockFreeQueue(int output_stream_index) const {
+  // The consumer side is serialized by the scheduling loop as long as the
+  // input stream handler only reads the streams from there.
+  if (max_in_flight_ != 1 || !input_stream_handler_->SupportsLockFreeQueues()) {
+    return false;
+  }
+  // The producer side is serialized if the stream is written by a calculator
+  // node that runs one invocation at a time: its packets and timestamp bounds
+  // are propagated either by its Open(), Process() and Close() calls, or by
+  // its scheduling loop while it isn't running. Graph input streams can be
+  // written by any number of application threads.
+  const NodeTypeInfo::NodeRef& producer =
+      validated_graph_->OutputStreamInfos()[output_stream_index].parent_node;
+  if (producer.type != NodeTypeInfo::NodeType::CALCULATOR) {
+    return false;
+  }
+  return validated_graph_->Config().node(producer.index).max_in_flight() <= 1;
+}
+
 absl::Status CalculatorNode::InitializeInputStreamHandler(
     const InputStreamHandlerConfig& handler_config,
     const PacketTypeSet& input_stream_types) {
@@ -842,14 +866,16 @@ absl::Status CalculatorNode::ProcessNode(
     // This is not a source Calculator.
     InputStreamShardSet* const inputs = &calculator_context->Inputs();
     OutputStreamShardSet* const outputs = &calculator_context->Outputs();
-    absl::Status result =
-        absl::InternalError("Calculator context has no input packets.");
+    absl::Status result;
 
     int num_invocations = calculator_context_manager_.NumberOfContextTimestamps(
         *calculator_context);
     RET_CHECK(num_invocations <= 1 || max_in_flight_ <= 1)
         << "num_invocations:" << num_invocations
         << ", max_in_flight_:" << max_in_flight_;
+    if (num_invocations == 0) {
+      return absl::InternalError("Calculator context has no input packets.");
+    }
     for (int i = 0; i < num_invocations; ++i) {
       const Timestamp input_timestamp = calculator_context->InputTimestamp();
       // The node is ready for Process().
@@ -863,6 +889,14 @@ absl::Status CalculatorNode::ProcessNode(
         if (OutputsAreConstant(calculator_context)) {
           // Do nothing.
           result = absl::OkStatus();
+        } else if (timestamp_deadlines_ &&
+                   timestamp_deadlines_->ShouldDrop(input_timestamp)) {
+          // The input timestamp is past its deadline, its packets are dropped.
+          mediapipe::LogEvent(calculator_context->GetProfilingContext(),
+                              TraceEvent(TraceEvent::DEADLINE_EXCEEDED)
+                                  .set_node_id(calculator_context->NodeId())
+                                  .set_input_ts(input_timestamp));
+          result = absl::OkStatus();
         } else {
           MEDIAPIPE_PROFILING(PROCESS, calculator_context);
           LegacyCalculatorSupport::Scoped<CalculatorContext> s(
@@ -888,7 +922,8 @@ absl::Status CalculatorNode::ProcessNode(
                         DebugName());
         }
         output_stream_handler_->PostProcess(input_timestamp);
-        if (result == tool::StatusStop()) {
+        if (!result.ok()) {
+          // The node returned tool::StatusStop().
           return result;
         }
       } else if (input_timestamp == Timestamp::Done()) {
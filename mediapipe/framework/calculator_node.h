@@ -47,6 +47,7 @@
 #include "mediapipe/framework/port/status.h"
 #include "mediapipe/framework/stream_handler.pb.h"
 #include "mediapipe/framework/timestamp.h"
+#include "mediapipe/framework/timestamp_deadlines.h"
 #include "mediapipe/framework/tool/validate_name.h"
 #include "mediapipe/framework/validated_graph_config.h"
 
@@ -206,6 +207,12 @@ class CalculatorNode {
     scheduler_queue_ = queue;
   }
 
+  // Sets the deadlines of the input timestamps of the graph run. Process() is
+  // skipped for input timestamps that should be dropped.
+  void SetTimestampDeadlines(const internal::TimestampDeadlines* deadlines) {
+    timestamp_deadlines_ = deadlines;
+  }
+
   // Sets callbacks in the scheduler that should be invoked when an input queue
   // becomes full/non-full.
   void SetQueueSizeCallbacks(
@@ -252,6 +259,10 @@ class CalculatorNode {
   absl::Status InitializeInputStreams(
       InputStreamManager* input_stream_managers,
       OutputStreamManager* output_stream_managers);
+  // Returns true if the input stream fed by the given output stream can use a
+  // lock-free queue, i.e. if it has a single producer thread and a single
+  // consumer thread at any time.
+  bool CanUseLockFreeQueue(int output_stream_index) const;
 
   absl::Status InitializeInputStreamHandler(
       const InputStreamHandlerConfig& handler_config,
@@ -371,6 +382,8 @@ class CalculatorNode {
 
   internal::SchedulerQueue* scheduler_queue_ = nullptr;
 
+  const internal::TimestampDeadlines* timestamp_deadlines_ = nullptr;
+
   const ValidatedGraphConfig* validated_graph_ = nullptr;
 };
 
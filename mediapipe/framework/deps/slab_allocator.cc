@@ -0,0 +1,192 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/slab_allocator.h"
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+
+namespace mediapipe {
+namespace slab_allocator_internal {
+namespace {
+
+constexpr int kNumSizeClasses = kMaxBlockSize / kAlignment;
+// Number of blocks moved between a thread cache and the central lists at once.
+constexpr int kBatchSize = 32;
+// Maximum number of free blocks of each size class kept by a thread.
+constexpr int kMaxThreadCachedBlocks = 2 * kBatchSize;
+// Maximum number of free blocks of each size class kept in the central lists.
+constexpr int kMaxCentralBlocks = 64 * kBatchSize;
+
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+size_t BlockSize(int size_class) { return (size_class + 1) * kAlignment; }
+
+int SizeClass(size_t size) {
+  return size == 0 ? 0 : static_cast<int>((size - 1) / kAlignment);
+}
+
+// Deletes the "count" blocks of the list starting at "first".
+void DeleteBlocks(FreeBlock* first, int count) {
+  for (int i = 0; i < count; ++i) {
+    FreeBlock* next = first->next;
+    ::operator delete(first);
+    first = next;
+  }
+}
+
+// The free lists shared by all threads.
+class CentralCache {
+ public:
+  // Takes up to kBatchSize blocks of "size_class". Returns the number of
+  // blocks, which are linked from *first.
+  int Fetch(int size_class, FreeBlock** first) {
+    absl::MutexLock lock(&mutex_);
+    FreeBlock* block = free_lists_[size_class];
+    *first = block;
+    int count = 0;
+    FreeBlock* last = nullptr;
+    while (block != nullptr && count < kBatchSize) {
+      last = block;
+      block = block->next;
+      ++count;
+    }
+    if (last != nullptr) {
+      last->next = nullptr;
+    }
+    free_lists_[size_class] = block;
+    num_blocks_[size_class] -= count;
+    return count;
+  }
+
+  // Takes over the "count" blocks of "size_class" linked from "first" to
+  // "last". Deletes them if the central list is full.
+  void Release(int size_class, FreeBlock* first, FreeBlock* last, int count) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (num_blocks_[size_class] + count <= kMaxCentralBlocks) {
+        last->next = free_lists_[size_class];
+        free_lists_[size_class] = first;
+        num_blocks_[size_class] += count;
+        return;
+      }
+    }
+    DeleteBlocks(first, count);
+  }
+
+ private:
+  absl::Mutex mutex_;
+  FreeBlock* free_lists_[kNumSizeClasses] ABSL_GUARDED_BY(mutex_) = {};
+  int num_blocks_[kNumSizeClasses] ABSL_GUARDED_BY(mutex_) = {};
+};
+
+CentralCache& GetCentralCache() {
+  static CentralCache* central_cache = new CentralCache();
+  return *central_cache;
+}
+
+class ThreadCache {
+ public:
+  ~ThreadCache();
+
+  void* Allocate(int size_class) {
+    if (free_lists_[size_class] == nullptr) {
+      num_blocks_[size_class] =
+          GetCentralCache().Fetch(size_class, &free_lists_[size_class]);
+      if (num_blocks_[size_class] == 0) {
+        return ::operator new(BlockSize(size_class));
+      }
+    }
+    FreeBlock* block = free_lists_[size_class];
+    free_lists_[size_class] = block->next;
+    --num_blocks_[size_class];
+    return block;
+  }
+
+  void Deallocate(void* ptr, int size_class) {
+    FreeBlock* block = static_cast<FreeBlock*>(ptr);
+    block->next = free_lists_[size_class];
+    free_lists_[size_class] = block;
+    if (++num_blocks_[size_class] == kMaxThreadCachedBlocks) {
+      ReleaseBlocks(size_class, kBatchSize);
+    }
+  }
+
+ private:
+  // Hands the first "count" blocks of "size_class" over to the central cache.
+  void ReleaseBlocks(int size_class, int count) {
+    FreeBlock* first = free_lists_[size_class];
+    FreeBlock* last = first;
+    for (int i = 1; i < count; ++i) {
+      last = last->next;
+    }
+    free_lists_[size_class] = last->next;
+    num_blocks_[size_class] -= count;
+    GetCentralCache().Release(size_class, first, last, count);
+  }
+
+  FreeBlock* free_lists_[kNumSizeClasses] = {};
+  int num_blocks_[kNumSizeClasses] = {};
+};
+
+// Trivially destructible, so it remains usable after the cache of the thread
+// has been destroyed, e.g. by objects with static storage duration released
+// at exit.
+thread_local bool thread_cache_destroyed = false;
+
+ThreadCache::~ThreadCache() {
+  thread_cache_destroyed = true;
+  for (int size_class = 0; size_class < kNumSizeClasses; ++size_class) {
+    if (num_blocks_[size_class] > 0) {
+      ReleaseBlocks(size_class, num_blocks_[size_class]);
+    }
+  }
+}
+
+ThreadCache* GetThreadCache() {
+  if (thread_cache_destroyed) {
+    return nullptr;
+  }
+  thread_local ThreadCache thread_cache;
+  return &thread_cache;
+}
+
+}  // namespace
+
+void* Allocate(size_t size) {
+  if (size > kMaxBlockSize) {
+    return ::operator new(size);
+  }
+  const int size_class = SizeClass(size);
+  ThreadCache* thread_cache = GetThreadCache();
+  if (thread_cache == nullptr) {
+    return ::operator new(BlockSize(size_class));
+  }
+  return thread_cache->Allocate(size_class);
+}
+
+void Deallocate(void* ptr, size_t size) {
+  ThreadCache* thread_cache =
+      size > kMaxBlockSize ? nullptr : GetThreadCache();
+  if (thread_cache == nullptr) {
+    ::operator delete(ptr);
+    return;
+  }
+  thread_cache->Deallocate(ptr, SizeClass(size));
+}
+
+}  // namespace slab_allocator_internal
+}  // namespace mediapipe
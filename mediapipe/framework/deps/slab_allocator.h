@@ -0,0 +1,88 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_DEPS_SLAB_ALLOCATOR_H_
+#define MEDIAPIPE_DEPS_SLAB_ALLOCATOR_H_
+
+#include <cstddef>
+#include <new>
+
+namespace mediapipe {
+
+namespace slab_allocator_internal {
+
+// Blocks are handed out in multiples of kAlignment bytes, up to kMaxBlockSize.
+constexpr size_t kAlignment = alignof(std::max_align_t);
+constexpr size_t kMaxBlockSize = 256;
+
+// Returns a block of at least "size" bytes, aligned to kAlignment.
+void* Allocate(size_t size);
+// Returns a block obtained from Allocate(size) to the calling thread's cache.
+void Deallocate(void* ptr, size_t size);
+
+}  // namespace slab_allocator_internal
+
+// A std::allocator replacement for small, short-lived objects that are
+// allocated and freed at a high rate, such as the packet holders created for
+// every timestamp.
+//
+// Freed blocks are kept in per-thread free lists, one per size class, and are
+// handed out again by the next allocation of the same size class. Blocks are
+// commonly allocated on one thread and freed on another, e.g. a packet created
+// by the application thread and released by a worker thread. To keep them
+// flowing back, a thread cache that grows too large hands a batch of blocks
+// over to a shared central list, and an empty thread cache takes a batch from
+// it before falling back to operator new. Both the thread caches and the
+// central lists are bounded, and a thread's cache is released when the thread
+// exits. Allocations larger than kMaxBlockSize or over-aligned ones go
+// straight to operator new.
+template <typename T>
+class SlabAllocator {
+ public:
+  using value_type = T;
+
+  SlabAllocator() = default;
+  template <typename U>
+  SlabAllocator(const SlabAllocator<U>&) {}  // NOLINT(runtime/explicit)
+
+  T* allocate(size_t n) {
+    if (alignof(T) > slab_allocator_internal::kAlignment) {
+      return static_cast<T*>(
+          ::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+    }
+    return static_cast<T*>(slab_allocator_internal::Allocate(n * sizeof(T)));
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    if (alignof(T) > slab_allocator_internal::kAlignment) {
+      ::operator delete(ptr, std::align_val_t(alignof(T)));
+      return;
+    }
+    slab_allocator_internal::Deallocate(ptr, n * sizeof(T));
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const SlabAllocator<T>&, const SlabAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const SlabAllocator<T>&, const SlabAllocator<U>&) {
+  return false;
+}
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_DEPS_SLAB_ALLOCATOR_H_
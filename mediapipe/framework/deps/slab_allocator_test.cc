@@ -0,0 +1,116 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/slab_allocator.h"
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+struct alignas(64) OverAligned {
+  char data[64];
+};
+
+struct LargeBlock {
+  char data[200];
+};
+
+TEST(SlabAllocatorTest, ReusesFreedBlocks) {
+  SlabAllocator<int64_t> allocator;
+  int64_t* first = allocator.allocate(2);
+  allocator.deallocate(first, 2);
+  int64_t* second = allocator.allocate(2);
+  EXPECT_EQ(first, second);
+  allocator.deallocate(second, 2);
+}
+
+TEST(SlabAllocatorTest, SeparatesSizeClasses) {
+  SlabAllocator<char> allocator;
+  char* small = allocator.allocate(8);
+  allocator.deallocate(small, 8);
+  char* large = allocator.allocate(200);
+  EXPECT_NE(small, large);
+  large[199] = 1;
+  allocator.deallocate(large, 200);
+  EXPECT_EQ(allocator.allocate(8), small);
+  allocator.deallocate(small, 8);
+}
+
+TEST(SlabAllocatorTest, HandlesLargeAndOverAlignedAllocations) {
+  SlabAllocator<char> char_allocator;
+  char* large = char_allocator.allocate(4096);
+  large[4095] = 1;
+  char_allocator.deallocate(large, 4096);
+
+  SlabAllocator<OverAligned> aligned_allocator;
+  OverAligned* aligned = aligned_allocator.allocate(1);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % alignof(OverAligned), 0);
+  aligned_allocator.deallocate(aligned, 1);
+}
+
+TEST(SlabAllocatorTest, WorksWithAllocateShared) {
+  auto value = std::allocate_shared<int>(SlabAllocator<int>(), 42);
+  EXPECT_EQ(*value, 42);
+  std::weak_ptr<int> weak = value;
+  value.reset();
+  EXPECT_TRUE(weak.expired());
+}
+
+TEST(SlabAllocatorTest, FreesBlocksAllocatedOnOtherThreads) {
+  constexpr int kNumBlocks = 1000;
+  SlabAllocator<int> allocator;
+  std::vector<int*> blocks;
+  std::thread producer([&]() {
+    for (int i = 0; i < kNumBlocks; ++i) {
+      blocks.push_back(allocator.allocate(1));
+      *blocks.back() = i;
+    }
+  });
+  producer.join();
+  for (int i = 0; i < kNumBlocks; ++i) {
+    EXPECT_EQ(*blocks[i], i);
+    allocator.deallocate(blocks[i], 1);
+  }
+}
+
+TEST(SlabAllocatorTest, ReturnsBlocksFreedOnOtherThreadsToAllocatingThread) {
+  constexpr int kNumBlocks = 1000;
+  SlabAllocator<LargeBlock> allocator;
+  std::vector<LargeBlock*> blocks;
+  for (int i = 0; i < kNumBlocks; ++i) {
+    blocks.push_back(allocator.allocate(1));
+  }
+  const std::set<LargeBlock*> allocated(blocks.begin(), blocks.end());
+  std::thread consumer([&]() {
+    for (LargeBlock* block : blocks) {
+      allocator.deallocate(block, 1);
+    }
+  });
+  consumer.join();
+  // The consumer handed the freed blocks over to the central lists, from
+  // which this thread's allocations are served now.
+  LargeBlock* block = allocator.allocate(1);
+  EXPECT_EQ(allocated.count(block), 1);
+  allocator.deallocate(block, 1);
+}
+
+}  // namespace
+}  // namespace mediapipe
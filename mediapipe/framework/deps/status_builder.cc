@@ -23,7 +23,9 @@ StatusBuilder::StatusBuilder(const StatusBuilder& sb) {
   file_ = sb.file_;
   line_ = sb.line_;
   no_logging_ = sb.no_logging_;
-  stream_ = absl::make_unique<std::ostringstream>(sb.stream_->str());
+  stream_ = sb.stream_
+                ? absl::make_unique<std::ostringstream>(sb.stream_->str())
+                : nullptr;
   join_style_ = sb.join_style_;
 }
 
@@ -32,7 +34,9 @@ StatusBuilder& StatusBuilder::operator=(const StatusBuilder& sb) {
   file_ = sb.file_;
   line_ = sb.line_;
   no_logging_ = sb.no_logging_;
-  stream_ = absl::make_unique<std::ostringstream>(sb.stream_->str());
+  stream_ = sb.stream_
+                ? absl::make_unique<std::ostringstream>(sb.stream_->str())
+                : nullptr;
   join_style_ = sb.join_style_;
   return *this;
 }
@@ -55,14 +59,14 @@ StatusBuilder& StatusBuilder::SetNoLogging() {
 }
 
 StatusBuilder::operator Status() const& {
-  if (stream_->str().empty() || no_logging_) {
+  if (!stream_ || stream_->str().empty() || no_logging_) {
     return status_;
   }
   return StatusBuilder(*this).JoinMessageToStatus();
 }
 
 StatusBuilder::operator Status() && {
-  if (stream_->str().empty() || no_logging_) {
+  if (!stream_ || stream_->str().empty() || no_logging_) {
     return status_;
   }
   return JoinMessageToStatus();
@@ -72,12 +76,12 @@ absl::Status StatusBuilder::JoinMessageToStatus() {
   std::string message;
   if (join_style_ == MessageJoinStyle::kAnnotate) {
     if (!status_.ok()) {
-      message = absl::StrCat(status_.message(), "; ", stream_->str());
+      message = absl::StrCat(status_.message(), "; ", StreamMessage());
     }
   } else {
     message = join_style_ == MessageJoinStyle::kPrepend
-                  ? absl::StrCat(stream_->str(), status_.message())
-                  : absl::StrCat(status_.message(), stream_->str());
+                  ? absl::StrCat(StreamMessage(), status_.message())
+                  : absl::StrCat(status_.message(), StreamMessage());
   }
   return Status(status_.code(), message);
 }
@@ -15,6 +15,10 @@
 #ifndef MEDIAPIPE_DEPS_STATUS_BUILDER_H_
 #define MEDIAPIPE_DEPS_STATUS_BUILDER_H_
 
+#include <memory>
+#include <sstream>
+#include <string>
+
 #include "absl/base/attributes.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
@@ -35,14 +39,14 @@ class ABSL_MUST_USE_RESULT StatusBuilder {
       : status_(original_status),
         line_(location.line()),
         file_(location.file_name()),
-        stream_(new std::ostringstream) {}
+        stream_(InitStream(status_)) {}
 
   StatusBuilder(absl::Status&& original_status,
                 mediapipe::source_location location)
       : status_(std::move(original_status)),
         line_(location.line()),
         file_(location.file_name()),
-        stream_(new std::ostringstream) {}
+        stream_(InitStream(status_)) {}
 
   // Creates a `StatusBuilder` from a mediapipe status code.  If logging is
   // enabled, it will use `location` as the location from which the log message
@@ -51,13 +55,13 @@ class ABSL_MUST_USE_RESULT StatusBuilder {
       : status_(code, ""),
         line_(location.line()),
         file_(location.file_name()),
-        stream_(new std::ostringstream) {}
+        stream_(InitStream(status_)) {}
 
   StatusBuilder(const absl::Status& original_status, const char* file, int line)
       : status_(original_status),
         line_(line),
         file_(file),
-        stream_(new std::ostringstream) {}
+        stream_(InitStream(status_)) {}
 
   bool ok() const { return status_.ok(); }
 
@@ -80,6 +84,22 @@ class ABSL_MUST_USE_RESULT StatusBuilder {
   absl::Status JoinMessageToStatus();
 
  private:
+  // Returns the stream collecting the messages added with `<<`, or nullptr if
+  // `status` is OK and the messages are dropped anyway. This keeps builders
+  // for OK statuses, e.g. in MP_RETURN_IF_ERROR, free of heap allocations.
+  static std::unique_ptr<std::ostringstream> InitStream(
+      const absl::Status& status) {
+    if (status.ok()) {
+      return nullptr;
+    }
+    return std::unique_ptr<std::ostringstream>(new std::ostringstream);
+  }
+
+  // Returns the messages added with `<<`.
+  std::string StreamMessage() const {
+    return stream_ ? stream_->str() : std::string();
+  }
+
   // Specifies how to join the error message in the original status and any
   // additional message that has been streamed into the builder.
   enum class MessageJoinStyle {
@@ -95,7 +115,7 @@ class ABSL_MUST_USE_RESULT StatusBuilder {
   // Not-owned: The file to record if this status is logged.
   const char* file_;
   bool no_logging_ = false;
-  // The additional messages added with `<<`.
+  // The additional messages added with `<<`, nullptr if `status_` is OK.
   std::unique_ptr<std::ostringstream> stream_;
   // Specifies how to join the message in `status_` and `stream_`.
   MessageJoinStyle join_style_ = MessageJoinStyle::kAnnotate;
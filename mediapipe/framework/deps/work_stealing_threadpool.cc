@@ -0,0 +1,208 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <utility>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_join.h"
+#include "mediapipe/framework/deps/threadpool.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+namespace {
+
+// The pool that owns the current thread, and the index of the current thread
+// in that pool.
+thread_local const WorkStealingThreadPool* current_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+// Applies the nice priority level, processor affinity and name of the calling
+// worker thread. Mirrors ThreadPool::WorkerThread::ThreadBody.
+void ConfigureWorkerThread(const ThreadOptions& thread_options,
+                           const std::string& name_prefix) {
+  int nice_priority_level = thread_options.nice_priority_level();
+  const std::set<int>& selected_cpus = thread_options.cpu_set();
+#if defined(__linux__)
+  const std::string name =
+      internal::CreateThreadName(name_prefix, syscall(SYS_gettid));
+  if (nice_priority_level != 0) {
+    if (nice(nice_priority_level) != -1 || errno == 0) {
+      VLOG(1) << "Changed the nice priority level by " << nice_priority_level;
+    } else {
+      LOG(ERROR) << "Error : " << strerror(errno) << std::endl
+                 << "Could not change the nice priority level by "
+                 << nice_priority_level;
+    }
+  }
+  if (!selected_cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : selected_cpus) {
+      CPU_SET(cpu, &cpu_set);
+    }
+    if (sched_setaffinity(syscall(SYS_gettid), sizeof(cpu_set_t), &cpu_set) !=
+            -1 ||
+        errno == 0) {
+      VLOG(1) << "Pinned the work stealing thread pool to processor "
+              << absl::StrJoin(selected_cpus, ", processor ") << ".";
+    } else {
+      LOG(ERROR) << "Error : " << strerror(errno) << std::endl
+                 << "Failed to set processor affinity. Ignore processor "
+                    "affinity setting for now.";
+    }
+  }
+  int error = pthread_setname_np(pthread_self(), name.c_str());
+  if (error != 0) {
+    LOG(ERROR) << "Error : " << strerror(error) << std::endl
+               << "Failed to set name for thread: " << name;
+  }
+#else
+  if (nice_priority_level != 0 || !selected_cpus.empty()) {
+    LOG(ERROR) << "Thread priority and processor affinity feature aren't "
+                  "supported on the current platform.";
+  }
+#endif  // __linux__
+}
+
+}  // namespace
+
+WorkStealingThreadPool::WorkStealingThreadPool(const std::string& name_prefix,
+                                               int num_threads)
+    : WorkStealingThreadPool(ThreadOptions(), name_prefix, num_threads) {}
+
+WorkStealingThreadPool::WorkStealingThreadPool(
+    const ThreadOptions& thread_options, const std::string& name_prefix,
+    int num_threads)
+    : name_prefix_(name_prefix), thread_options_(thread_options) {
+  num_threads_ = (num_threads == 0) ? 1 : num_threads;
+  if (thread_options_.stack_size() != 0) {
+    LOG(WARNING) << "The stack_size thread option is ignored by "
+                    "WorkStealingThreadPool.";
+  }
+  queues_.reserve(num_threads_);
+  for (int i = 0; i < num_threads_; ++i) {
+    queues_.push_back(absl::make_unique<WorkerQueue>());
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  {
+    absl::MutexLock lock(&sleep_mutex_);
+    stopped_ = true;
+    sleep_condition_.SignalAll();
+  }
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+void WorkStealingThreadPool::StartWorkers() {
+  CHECK(threads_.empty()) << "StartWorkers must be called only once.";
+  threads_.reserve(num_threads_);
+  for (int i = 0; i < num_threads_; ++i) {
+    threads_.emplace_back([this, i] {
+      ConfigureWorkerThread(thread_options_, name_prefix_);
+      RunWorker(i);
+    });
+  }
+}
+
+int WorkStealingThreadPool::CurrentWorkerIndex() const {
+  return current_pool == this ? current_worker_index : -1;
+}
+
+void WorkStealingThreadPool::Schedule(std::function<void()> callback) {
+  int index = CurrentWorkerIndex();
+  if (index < 0) {
+    index = next_queue_.fetch_add(1, std::memory_order_relaxed) % num_threads_;
+  }
+  {
+    WorkerQueue& queue = *queues_[index];
+    absl::MutexLock lock(&queue.mutex);
+    queue.tasks.push_back(std::move(callback));
+  }
+  // num_queued_tasks_ and num_sleeping_ are both sequentially consistent: a
+  // worker increments num_sleeping_ before it re-checks num_queued_tasks_,
+  // and we increment num_queued_tasks_ before we check num_sleeping_, so at
+  // least one of the two sides observes the other and the wakeup is not lost.
+  num_queued_tasks_.fetch_add(1);
+  if (num_sleeping_.load() > 0) {
+    absl::MutexLock lock(&sleep_mutex_);
+    sleep_condition_.Signal();
+  }
+}
+
+bool WorkStealingThreadPool::TryGetTask(int index,
+                                        std::function<void()>* task) {
+  {
+    WorkerQueue& own = *queues_[index];
+    absl::MutexLock lock(&own.mutex);
+    if (!own.tasks.empty()) {
+      *task = std::move(own.tasks.front());
+      own.tasks.pop_front();
+      return true;
+    }
+  }
+  for (int i = 1; i < num_threads_; ++i) {
+    WorkerQueue& victim = *queues_[(index + i) % num_threads_];
+    // Don't wait on a busy victim, try the next one instead.
+    if (!victim.mutex.TryLock()) continue;
+    bool found = !victim.tasks.empty();
+    if (found) {
+      *task = std::move(victim.tasks.back());
+      victim.tasks.pop_back();
+    }
+    victim.mutex.Unlock();
+    if (found) return true;
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::RunWorker(int index) {
+  current_pool = this;
+  current_worker_index = index;
+  std::function<void()> task;
+  while (true) {
+    if (num_queued_tasks_.load() > 0 && TryGetTask(index, &task)) {
+      num_queued_tasks_.fetch_sub(1);
+      task();
+      task = nullptr;
+      continue;
+    }
+    absl::MutexLock lock(&sleep_mutex_);
+    num_sleeping_.fetch_add(1);
+    while (num_queued_tasks_.load() <= 0 && !stopped_) {
+      sleep_condition_.Wait(&sleep_mutex_);
+    }
+    num_sleeping_.fetch_sub(1);
+    if (num_queued_tasks_.load() <= 0 && stopped_) break;
+  }
+  current_pool = nullptr;
+  current_worker_index = -1;
+}
+
+}  // namespace mediapipe
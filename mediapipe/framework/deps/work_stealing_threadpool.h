@@ -0,0 +1,133 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
+#define MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/deps/thread_options.h"
+
+namespace mediapipe {
+
+// A thread pool in which every worker owns its own task deque.
+//
+// Unlike ThreadPool, there is no single queue shared by all workers:
+// - A callback scheduled from one of the pool's own worker threads is pushed
+//   onto that worker's deque.
+// - A callback scheduled from any other thread is distributed round-robin
+//   over the worker deques.
+// - A worker runs callbacks from the front of its own deque. When its deque
+//   is empty it steals from the back of the other workers' deques before
+//   going to sleep.
+//
+// Each deque is guarded by its own mutex, so workers only contend with each
+// other when stealing. Callbacks are not guaranteed to run in FIFO order,
+// even if num_threads is 1 and callbacks are scheduled from several threads.
+//
+// The thread pool is shut down when the pool is destroyed. All callbacks
+// scheduled before destruction are run.
+//
+// Sample usage:
+//
+// {
+//   WorkStealingThreadPool pool("testpool", num_workers);
+//   pool.StartWorkers();
+//   for (int i = 0; i < N; ++i) {
+//     pool.Schedule([i]() { DoWork(i); });
+//   }
+// }
+//
+class WorkStealingThreadPool {
+ public:
+  // Like ThreadPool(const std::string& name_prefix, int num_threads).
+  WorkStealingThreadPool(const std::string& name_prefix, int num_threads);
+
+  // Like ThreadPool(const ThreadOptions& thread_options,
+  //                 const std::string& name_prefix, int num_threads).
+  // The stack_size thread option is not supported and is ignored.
+  WorkStealingThreadPool(const ThreadOptions& thread_options,
+                         const std::string& name_prefix, int num_threads);
+  WorkStealingThreadPool(const WorkStealingThreadPool&) = delete;
+  WorkStealingThreadPool& operator=(const WorkStealingThreadPool&) = delete;
+
+  // Waits for closures (if any) to complete. May be called without
+  // having called StartWorkers().
+  ~WorkStealingThreadPool();
+
+  // REQUIRES: StartWorkers has not been called
+  // Actually start the worker threads.
+  void StartWorkers();
+
+  // REQUIRES: StartWorkers has been called
+  // Add specified callback to the queue of a worker. Eventually a thread will
+  // pull this callback off a queue and execute it.
+  void Schedule(std::function<void()> callback);
+
+  // Provided for debugging and testing only.
+  int num_threads() const { return num_threads_; }
+
+  // Standard thread options.  Use this accessor to get them.
+  const ThreadOptions& thread_options() const { return thread_options_; }
+
+  // Returns the index in [0, num_threads()) of the calling thread if it is a
+  // worker of this pool, and -1 otherwise.
+  int CurrentWorkerIndex() const;
+
+ private:
+  // A worker-owned task deque.
+  struct WorkerQueue {
+    absl::Mutex mutex;
+    std::deque<std::function<void()>> tasks ABSL_GUARDED_BY(mutex);
+  };
+
+  void RunWorker(int index);
+
+  // Pops a task from the front of the deque of worker "index", or steals one
+  // from the back of another worker's deque. Returns false if all deques
+  // were found empty.
+  bool TryGetTask(int index, std::function<void()>* task);
+
+  std::string name_prefix_;
+  int num_threads_;
+  ThreadOptions thread_options_;
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> threads_;
+
+  // Round-robin cursor for callbacks scheduled from non-worker threads.
+  std::atomic<unsigned int> next_queue_{0};
+
+  // Number of callbacks that are queued and have not been picked up yet.
+  std::atomic<int> num_queued_tasks_{0};
+
+  // Idle workers sleep on sleep_condition_. num_sleeping_ is written while
+  // holding sleep_mutex_ but can be read without it, so that Schedule() only
+  // takes the lock when a worker actually needs to be woken up.
+  absl::Mutex sleep_mutex_;
+  absl::CondVar sleep_condition_;
+  std::atomic<int> num_sleeping_{0};
+  bool stopped_ ABSL_GUARDED_BY(sleep_mutex_) = false;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_DEPS_WORK_STEALING_THREADPOOL_H_
@@ -0,0 +1,127 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
+
+#include <atomic>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/synchronization/notification.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+
+TEST(WorkStealingThreadPoolTest, DestroyWithoutStart) {
+  WorkStealingThreadPool thread_pool("testpool", 10);
+}
+
+TEST(WorkStealingThreadPoolTest, EmptyThread) {
+  WorkStealingThreadPool thread_pool("testpool", 0);
+  ASSERT_EQ(1, thread_pool.num_threads());
+  thread_pool.StartWorkers();
+}
+
+TEST(WorkStealingThreadPoolTest, SingleThread) {
+  absl::Mutex mu;
+  int n = 100;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 1);
+    ASSERT_EQ(1, thread_pool.num_threads());
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n, &mu]() mutable {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+TEST(WorkStealingThreadPoolTest, MultiThreads) {
+  absl::Mutex mu;
+  int n = 100;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 10);
+    ASSERT_EQ(10, thread_pool.num_threads());
+    thread_pool.StartWorkers();
+
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&n, &mu]() mutable {
+        absl::MutexLock l(&mu);
+        --n;
+      });
+    }
+  }
+
+  EXPECT_EQ(0, n);
+}
+
+// Tasks scheduled from a worker land on that worker's own deque. If the worker
+// is blocked, the other workers must steal them.
+TEST(WorkStealingThreadPoolTest, IdleWorkersStealFromBlockedWorker) {
+  std::atomic<int> n(0);
+  absl::Notification stolen_tasks_done;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 4);
+    thread_pool.StartWorkers();
+    thread_pool.Schedule([&thread_pool, &n, &stolen_tasks_done]() {
+      for (int i = 0; i < 100; ++i) {
+        thread_pool.Schedule([&n, &stolen_tasks_done]() {
+          if (++n == 100) stolen_tasks_done.Notify();
+        });
+      }
+      // Block the owning worker until the other workers have drained its
+      // deque.
+      stolen_tasks_done.WaitForNotification();
+    });
+  }
+  EXPECT_EQ(100, n);
+}
+
+TEST(WorkStealingThreadPoolTest, CurrentWorkerIndex) {
+  std::atomic<int> num_valid_indices(0);
+  {
+    WorkStealingThreadPool thread_pool("testpool", 4);
+    EXPECT_EQ(-1, thread_pool.CurrentWorkerIndex());
+    thread_pool.StartWorkers();
+    for (int i = 0; i < 100; ++i) {
+      thread_pool.Schedule([&thread_pool, &num_valid_indices]() {
+        int index = thread_pool.CurrentWorkerIndex();
+        if (index >= 0 && index < thread_pool.num_threads()) {
+          ++num_valid_indices;
+        }
+      });
+    }
+  }
+  EXPECT_EQ(100, num_valid_indices);
+}
+
+TEST(WorkStealingThreadPoolTest, CreateWithThreadOptions) {
+  WorkStealingThreadPool thread_pool(ThreadOptions(), "testpool", 10);
+  ASSERT_EQ(10, thread_pool.num_threads());
+  thread_pool.StartWorkers();
+}
+
+TEST(WorkStealingThreadPoolTest, CreateWithCPUAffinity) {
+  ThreadOptions thread_options = ThreadOptions().set_cpu_set({0});
+  WorkStealingThreadPool thread_pool(thread_options, "testpool", 10);
+  ASSERT_EQ(10, thread_pool.num_threads());
+  ASSERT_EQ(1, thread_pool.thread_options().cpu_set().size());
+  thread_pool.StartWorkers();
+}
+
+}  // namespace mediapipe
@@ -62,6 +62,14 @@ class Executor {
 
   // Schedule the specified "task" for execution in this executor.
   virtual void Schedule(std::function<void()> task) = 0;
+
+  // Executors that keep a separate task queue for each worker thread return
+  // the number of such queues, and the index of the queue owned by the
+  // calling thread (-1 if the calling thread is not a worker). A TaskQueue
+  // may use these to keep its ready tasks per worker as well. The defaults
+  // describe a single shared queue.
+  virtual int num_local_queues() const { return 1; }
+  virtual int CurrentLocalQueueIndex() const { return -1; }
 };
 
 using ExecutorRegistry =
@@ -0,0 +1,151 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
+
+#include "absl/memory/memory.h"
+
+namespace mediapipe {
+
+const GraphService<ImageFrameMultiPool> kImageFrameMultiPoolService(
+    "kImageFrameMultiPoolService");
+
+std::unique_ptr<ImageFrame> ImageFrameMultiPool::GetFrame(
+    ImageFormat::Format format, int width, int height,
+    uint32 alignment_boundary) {
+  if (width <= 0 || height <= 0) {
+    // Nothing worth pooling.
+    return absl::make_unique<ImageFrame>(format, width, height,
+                                         alignment_boundary);
+  }
+
+  const BufferSpec spec{width, height, format, alignment_boundary};
+  PixelData pixel_data;
+  int width_step = 0;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto inserted = buckets_.try_emplace(spec);
+    Bucket& bucket = inserted.first->second;
+    if (inserted.second) {
+      lru_.push_front(spec);
+      bucket.lru_it = lru_.begin();
+    } else {
+      Touch(&bucket);
+    }
+    if (!bucket.idle.empty()) {
+      pixel_data = std::move(bucket.idle.back());
+      bucket.idle.pop_back();
+      idle_bytes_ -= bucket.buffer_size;
+      width_step = bucket.width_step;
+    }
+    ++bucket.in_use_count;
+  }
+
+  if (!pixel_data) {
+    // Let ImageFrame pick the row stride and allocator.
+    ImageFrame allocated(format, width, height, alignment_boundary);
+    width_step = allocated.WidthStep();
+    pixel_data = allocated.Release();
+  }
+
+  // The deleter returns the buffer to the pool, or frees it with its original
+  // deleter if the pool is gone.
+  std::weak_ptr<ImageFrameMultiPool> weak_pool(shared_from_this());
+  ImageFrame::Deleter deleter = pixel_data.get_deleter();
+  auto frame = absl::make_unique<ImageFrame>();
+  frame->AdoptPixelData(
+      format, width, height, width_step, pixel_data.release(),
+      [weak_pool, spec, width_step, deleter](uint8* data) {
+        PixelData returned(data, deleter);
+        auto pool = weak_pool.lock();
+        if (pool) {
+          pool->Return(spec, width_step, std::move(returned));
+        }
+      });
+  return frame;
+}
+
+void ImageFrameMultiPool::Return(const BufferSpec& spec, int width_step,
+                                 PixelData pixel_data) {
+  std::vector<PixelData> trimmed;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = buckets_.find(spec);
+    if (it == buckets_.end()) {
+      trimmed.push_back(std::move(pixel_data));
+      return;
+    }
+    Bucket& bucket = it->second;
+    --bucket.in_use_count;
+    bucket.width_step = width_step;
+    bucket.buffer_size = static_cast<int64>(width_step) * spec.height;
+    if (bucket.idle.size() < options_.max_idle_buffers_per_bucket) {
+      bucket.idle.push_back(std::move(pixel_data));
+      idle_bytes_ += bucket.buffer_size;
+    } else {
+      trimmed.push_back(std::move(pixel_data));
+    }
+    if (bucket.in_use_count == 0 && bucket.idle.empty()) {
+      lru_.erase(bucket.lru_it);
+      buckets_.erase(it);
+    }
+    TrimIdle(&trimmed);
+  }
+  // The trimmed buffers will be released without holding the lock.
+}
+
+void ImageFrameMultiPool::Touch(Bucket* bucket) {
+  lru_.splice(lru_.begin(), lru_, bucket->lru_it);
+}
+
+void ImageFrameMultiPool::TrimIdle(std::vector<PixelData>* trimmed) {
+  auto lru_it = lru_.end();
+  while (idle_bytes_ > options_.max_idle_bytes && lru_it != lru_.begin()) {
+    --lru_it;
+    auto bucket_it = buckets_.find(*lru_it);
+    Bucket& bucket = bucket_it->second;
+    while (idle_bytes_ > options_.max_idle_bytes && !bucket.idle.empty()) {
+      trimmed->push_back(std::move(bucket.idle.back()));
+      bucket.idle.pop_back();
+      idle_bytes_ -= bucket.buffer_size;
+    }
+    if (bucket.in_use_count == 0 && bucket.idle.empty()) {
+      buckets_.erase(bucket_it);
+      lru_it = lru_.erase(lru_it);
+    }
+  }
+}
+
+int ImageFrameMultiPool::GetBucketCount() {
+  absl::MutexLock lock(&mutex_);
+  return buckets_.size();
+}
+
+std::pair<int, int> ImageFrameMultiPool::GetInUseAndIdleCounts() {
+  absl::MutexLock lock(&mutex_);
+  int in_use = 0;
+  int idle = 0;
+  for (const auto& entry : buckets_) {
+    in_use += entry.second.in_use_count;
+    idle += entry.second.idle.size();
+  }
+  return {in_use, idle};
+}
+
+int64 ImageFrameMultiPool::GetIdleBytes() {
+  absl::MutexLock lock(&mutex_);
+  return idle_bytes_;
+}
+
+}  // namespace mediapipe
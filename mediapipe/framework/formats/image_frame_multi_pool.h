@@ -0,0 +1,142 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_MULTI_POOL_H_
+#define MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_MULTI_POOL_H_
+
+#include <list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/graph_service.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Recycles the pixel buffers of CPU ImageFrames of any size and format, so
+// that calculators producing a new frame per input do not allocate and free
+// (and page fault in) several megabytes per frame.
+//
+// Frames are returned as ordinary std::unique_ptr<ImageFrame>: they can be
+// added to output streams with Add() and consumed like any other frame. When a
+// frame is destroyed its pixel buffer goes back to the pool, in a bucket keyed
+// by (width, height, format, alignment). Idle buffers are bounded per bucket
+// and in total size; when over the size limit, the buffers of the least
+// recently used buckets are freed first.
+//
+// The pool is thread-safe. Calculators normally obtain it through
+// kImageFrameMultiPoolService, which the graph creates when needed.
+class ImageFrameMultiPool
+    : public std::enable_shared_from_this<ImageFrameMultiPool> {
+ public:
+  struct Options {
+    // Maximum number of idle buffers kept for each bucket. Buffers in use are
+    // not limited.
+    int max_idle_buffers_per_bucket = 2;
+    // Maximum total size of the idle buffers, in bytes.
+    int64 max_idle_bytes = 128 << 20;
+  };
+
+  // We enforce creation as a shared_ptr so that we can use a weak reference in
+  // the buffers' deleters.
+  static std::shared_ptr<ImageFrameMultiPool> Create(const Options& options) {
+    return std::shared_ptr<ImageFrameMultiPool>(
+        new ImageFrameMultiPool(options));
+  }
+  static std::shared_ptr<ImageFrameMultiPool> Create() {
+    return Create(Options());
+  }
+
+  // Returns a frame with the given properties, reusing an idle buffer when
+  // one is available. The pixel data is uninitialized.
+  std::unique_ptr<ImageFrame> GetFrame(
+      ImageFormat::Format format, int width, int height,
+      uint32 alignment_boundary = ImageFrame::kDefaultAlignmentBoundary);
+
+  // These methods are meant for testing.
+  int GetBucketCount();
+  std::pair<int, int> GetInUseAndIdleCounts();
+  int64 GetIdleBytes();
+
+ private:
+  struct BufferSpec {
+    template <typename H>
+    friend H AbslHashValue(H h, const BufferSpec& spec) {
+      return H::combine(std::move(h), spec.width, spec.height,
+                        static_cast<int>(spec.format),
+                        spec.alignment_boundary);
+    }
+    friend bool operator==(const BufferSpec& lhs, const BufferSpec& rhs) {
+      return lhs.width == rhs.width && lhs.height == rhs.height &&
+             lhs.format == rhs.format &&
+             lhs.alignment_boundary == rhs.alignment_boundary;
+    }
+
+    int width;
+    int height;
+    ImageFormat::Format format;
+    uint32 alignment_boundary;
+  };
+
+  // Pixel data as allocated by ImageFrame, with its original deleter.
+  using PixelData = std::unique_ptr<uint8[], ImageFrame::Deleter>;
+
+  struct Bucket {
+    // Row stride and size of the buffers, known once one has been returned.
+    int width_step = 0;
+    int64 buffer_size = 0;
+    int in_use_count = 0;
+    std::vector<PixelData> idle;
+    // Position in lru_, most recently used first.
+    std::list<BufferSpec>::iterator lru_it;
+  };
+
+  explicit ImageFrameMultiPool(const Options& options) : options_(options) {}
+
+  // Returns a buffer to the pool.
+  void Return(const BufferSpec& spec, int width_step, PixelData pixel_data);
+
+  // Marks "bucket" as the most recently used one.
+  void Touch(Bucket* bucket) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Frees idle buffers of the least recently used buckets until the idle size
+  // is within max_idle_bytes, and removes buckets left empty.
+  void TrimIdle(std::vector<PixelData>* trimmed)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const Options options_;
+
+  absl::Mutex mutex_;
+  absl::flat_hash_map<BufferSpec, Bucket, absl::Hash<BufferSpec>> buckets_
+      ABSL_GUARDED_BY(mutex_);
+  std::list<BufferSpec> lru_ ABSL_GUARDED_BY(mutex_);
+  int64 idle_bytes_ ABSL_GUARDED_BY(mutex_) = 0;
+};
+
+// Graph-wide pool used by the CPU image calculators. The graph creates one
+// with default options when a calculator requests it; to share a pool between
+// graphs or change its limits, set it before starting the graph:
+//
+//   graph.SetServiceObject(kImageFrameMultiPoolService,
+//                          ImageFrameMultiPool::Create(options));
+extern const GraphService<ImageFrameMultiPool> kImageFrameMultiPoolService;
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_FORMATS_IMAGE_FRAME_MULTI_POOL_H_
@@ -0,0 +1,246 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/image_frame_multi_pool.h"
+
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+using Pair = std::pair<int, int>;
+
+TEST(ImageFrameMultiPoolTest, ReusesBuffers) {
+  auto pool = ImageFrameMultiPool::Create();
+  auto frame = pool->GetFrame(ImageFormat::SRGB, 300, 200);
+  EXPECT_EQ(frame->Format(), ImageFormat::SRGB);
+  EXPECT_EQ(frame->Width(), 300);
+  EXPECT_EQ(frame->Height(), 200);
+  EXPECT_EQ(frame->WidthStep(), 912);
+  const uint8* pixel_data = frame->PixelData();
+  EXPECT_EQ(Pair(1, 0), pool->GetInUseAndIdleCounts());
+
+  frame = nullptr;
+  EXPECT_EQ(Pair(0, 1), pool->GetInUseAndIdleCounts());
+  EXPECT_EQ(pool->GetIdleBytes(), 912 * 200);
+
+  frame = pool->GetFrame(ImageFormat::SRGB, 300, 200);
+  EXPECT_EQ(frame->PixelData(), pixel_data);
+  EXPECT_EQ(frame->WidthStep(), 912);
+  EXPECT_EQ(Pair(1, 0), pool->GetInUseAndIdleCounts());
+  EXPECT_EQ(pool->GetIdleBytes(), 0);
+}
+
+TEST(ImageFrameMultiPoolTest, SeparatesSizesAndFormats) {
+  auto pool = ImageFrameMultiPool::Create();
+  std::vector<std::unique_ptr<ImageFrame>> frames;
+  frames.push_back(pool->GetFrame(ImageFormat::SRGB, 64, 32));
+  frames.push_back(pool->GetFrame(ImageFormat::SRGBA, 64, 32));
+  frames.push_back(pool->GetFrame(ImageFormat::SRGB, 32, 64));
+  frames.push_back(pool->GetFrame(ImageFormat::SRGB, 64, 32, /*alignment=*/1));
+  EXPECT_EQ(pool->GetBucketCount(), 4);
+  EXPECT_EQ(frames[3]->WidthStep(), 64 * 3);
+  frames.clear();
+  EXPECT_EQ(Pair(0, 4), pool->GetInUseAndIdleCounts());
+
+  auto frame = pool->GetFrame(ImageFormat::SRGBA, 32, 64);
+  EXPECT_EQ(pool->GetBucketCount(), 5);
+  EXPECT_EQ(Pair(1, 4), pool->GetInUseAndIdleCounts());
+}
+
+TEST(ImageFrameMultiPoolTest, LimitsIdleBuffersPerBucket) {
+  ImageFrameMultiPool::Options options;
+  options.max_idle_buffers_per_bucket = 2;
+  auto pool = ImageFrameMultiPool::Create(options);
+  std::vector<std::unique_ptr<ImageFrame>> frames;
+  for (int i = 0; i < 5; ++i) {
+    frames.push_back(pool->GetFrame(ImageFormat::GRAY8, 16, 16));
+  }
+  EXPECT_EQ(Pair(5, 0), pool->GetInUseAndIdleCounts());
+  frames.clear();
+  EXPECT_EQ(Pair(0, 2), pool->GetInUseAndIdleCounts());
+}
+
+TEST(ImageFrameMultiPoolTest, TrimsLeastRecentlyUsedBuckets) {
+  ImageFrameMultiPool::Options options;
+  options.max_idle_bytes = 2 * 100 * 100;
+  auto pool = ImageFrameMultiPool::Create(options);
+
+  pool->GetFrame(ImageFormat::GRAY8, 96, 100);
+  pool->GetFrame(ImageFormat::GRAY8, 80, 100);
+  EXPECT_EQ(pool->GetBucketCount(), 2);
+  // Exceeds the limit: the 96x100 bucket was used least recently.
+  pool->GetFrame(ImageFormat::GRAY8, 64, 100);
+  EXPECT_EQ(pool->GetBucketCount(), 2);
+  EXPECT_EQ(pool->GetIdleBytes(), (80 + 64) * 100);
+
+  // Using the 80x100 bucket makes the 64x100 one the least recently used.
+  auto frame = pool->GetFrame(ImageFormat::GRAY8, 80, 100);
+  frame = nullptr;
+  pool->GetFrame(ImageFormat::GRAY8, 96, 100);
+  EXPECT_EQ(pool->GetBucketCount(), 2);
+  EXPECT_EQ(pool->GetIdleBytes(), (96 + 80) * 100);
+}
+
+TEST(ImageFrameMultiPoolTest, DropsBuffersLargerThanLimit) {
+  ImageFrameMultiPool::Options options;
+  options.max_idle_bytes = 1000;
+  auto pool = ImageFrameMultiPool::Create(options);
+  pool->GetFrame(ImageFormat::GRAY8, 64, 64);
+  EXPECT_EQ(pool->GetBucketCount(), 0);
+  EXPECT_EQ(pool->GetIdleBytes(), 0);
+}
+
+TEST(ImageFrameMultiPoolTest, FramesCanOutliveThePool) {
+  auto pool = ImageFrameMultiPool::Create();
+  auto frame = pool->GetFrame(ImageFormat::SRGBA, 64, 64);
+  pool = nullptr;
+  frame->SetToZero();
+  frame = nullptr;
+}
+
+TEST(ImageFrameMultiPoolTest, ReleasedPixelDataReturnsToThePool) {
+  auto pool = ImageFrameMultiPool::Create();
+  auto frame = pool->GetFrame(ImageFormat::SRGBA, 64, 64);
+  auto pixel_data = frame->Release();
+  frame = nullptr;
+  EXPECT_EQ(Pair(1, 0), pool->GetInUseAndIdleCounts());
+  pixel_data = nullptr;
+  EXPECT_EQ(Pair(0, 1), pool->GetInUseAndIdleCounts());
+}
+
+TEST(ImageFrameMultiPoolTest, EmptyFramesAreNotPooled) {
+  auto pool = ImageFrameMultiPool::Create();
+  auto frame = pool->GetFrame(ImageFormat::SRGB, 0, 10);
+  EXPECT_EQ(frame->Width(), 0);
+  EXPECT_EQ(pool->GetBucketCount(), 0);
+}
+
+// Outputs a pooled 8x8 GRAY8 frame per input packet.
+class PooledFrameCalculator : public CalculatorBase {
+ public:
+  static absl::Status GetContract(CalculatorContract* cc) {
+    cc->Inputs().Index(0).SetAny();
+    cc->Outputs().Index(0).Set<ImageFrame>();
+    cc->UseService(kImageFrameMultiPoolService);
+    return absl::OkStatus();
+  }
+
+  absl::Status Open(CalculatorContext* cc) override {
+    frame_pool_ = &cc->Service(kImageFrameMultiPoolService).GetObject();
+    return absl::OkStatus();
+  }
+
+  absl::Status Process(CalculatorContext* cc) override {
+    auto frame = frame_pool_->GetFrame(ImageFormat::GRAY8, 8, 8);
+    cc->Outputs().Index(0).Add(frame.release(), cc->InputTimestamp());
+    return absl::OkStatus();
+  }
+
+ private:
+  ImageFrameMultiPool* frame_pool_ = nullptr;
+};
+REGISTER_CALCULATOR(PooledFrameCalculator);
+
+CalculatorGraphConfig PooledFrameGraphConfig() {
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+    input_stream: "in"
+    node {
+      calculator: "PooledFrameCalculator"
+      input_stream: "in"
+      output_stream: "out"
+    }
+  )pb");
+}
+
+TEST(ImageFrameMultiPoolTest, GraphProvidesThePool) {
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(PooledFrameGraphConfig()));
+  std::vector<Packet> frames;
+  MP_ASSERT_OK(graph.ObserveOutputStream("out", [&frames](const Packet& p) {
+    frames.push_back(p);
+    return absl::OkStatus();
+  }));
+  EXPECT_EQ(graph.GetServiceObject(kImageFrameMultiPoolService), nullptr);
+  MP_ASSERT_OK(graph.StartRun({}));
+  auto pool = graph.GetServiceObject(kImageFrameMultiPoolService);
+  ASSERT_NE(pool, nullptr);
+
+  for (int i = 0; i < 3; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "in", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  ASSERT_EQ(frames.size(), 3);
+  EXPECT_EQ(Pair(3, 0), pool->GetInUseAndIdleCounts());
+  frames.clear();
+  EXPECT_EQ(Pair(0, 2), pool->GetInUseAndIdleCounts());
+}
+
+TEST(ImageFrameMultiPoolTest, GraphUsesPoolSetByApplication) {
+  auto pool = ImageFrameMultiPool::Create();
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(PooledFrameGraphConfig()));
+  MP_ASSERT_OK(graph.SetServiceObject(kImageFrameMultiPoolService, pool));
+  MP_ASSERT_OK(graph.StartRun({}));
+  MP_ASSERT_OK(
+      graph.AddPacketToInputStream("in", MakePacket<int>(0).At(Timestamp(0))));
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+  EXPECT_EQ(graph.GetServiceObject(kImageFrameMultiPoolService), pool);
+  EXPECT_EQ(pool->GetBucketCount(), 1);
+}
+
+// Frames alternating between 4K RGB and 1080p RGBA, with a few of them in
+// flight and every frame fully written, as in a pipelined graph.
+template <typename GetFrame>
+void RunFrameBenchmark(benchmark::State& state, GetFrame get_frame) {
+  std::vector<std::unique_ptr<ImageFrame>> in_flight(4);
+  int index = 0;
+  for (auto _ : state) {
+    auto frame = index % 2 ? get_frame(ImageFormat::SRGB, 3840, 2160)
+                           : get_frame(ImageFormat::SRGBA, 1920, 1080);
+    frame->SetToZero();
+    in_flight[index++ % in_flight.size()] = std::move(frame);
+  }
+}
+
+void BM_NewImageFrame(benchmark::State& state) {
+  RunFrameBenchmark(state, [](ImageFormat::Format format, int width,
+                              int height) {
+    return absl::make_unique<ImageFrame>(format, width, height);
+  });
+}
+BENCHMARK(BM_NewImageFrame);
+
+void BM_PooledImageFrame(benchmark::State& state) {
+  auto pool = ImageFrameMultiPool::Create();
+  RunFrameBenchmark(state,
+                    [&pool](ImageFormat::Format format, int width, int height) {
+                      return pool->GetFrame(format, width, height);
+                    });
+}
+BENCHMARK(BM_PooledImageFrame);
+
+}  // namespace
+}  // namespace mediapipe
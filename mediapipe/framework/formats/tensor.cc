@@ -19,6 +19,7 @@
 
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/port.h"
+#include "mediapipe/framework/port/aligned_malloc_and_free.h"
 #include "mediapipe/framework/port/logging.h"
 
 #if MEDIAPIPE_METAL_ENABLED
@@ -121,6 +122,16 @@ void Tensor::AllocateMtlBuffer(id<MTLDevice> device) const {
     cpu_buffer_ = AllocateVirtualMemory(bytes());
   }
   if (!metal_buffer_) {
+    if (cpu_buffer_release_) {
+      // The caller-provided memory is released in Invalidate().
+      metal_buffer_ =
+          [device_ newBufferWithBytesNoCopy:cpu_buffer_
+                                     length:AlignToPageSize(bytes())
+                                    options:MTLResourceStorageModeShared |
+                                            MTLResourceCPUCacheModeDefaultCache
+                                deallocator:nil];
+      return;
+    }
     metal_buffer_ =
         [device_ newBufferWithBytesNoCopy:cpu_buffer_
                                    length:AlignToPageSize(bytes())
@@ -317,8 +328,11 @@ void Tensor::Move(Tensor* src) {
   shape_ = src->shape();
   element_type_ = src->element_type();
   src->element_type_ = ElementType::kNone;  // Mark as invalidated.
+  quantization_parameters_ = src->quantization_parameters_;
   cpu_buffer_ = src->cpu_buffer_;
   src->cpu_buffer_ = nullptr;
+  cpu_buffer_release_ = std::move(src->cpu_buffer_release_);
+  src->cpu_buffer_release_ = nullptr;
 #if MEDIAPIPE_METAL_ENABLED
   device_ = src->device_;
   command_buffer_ = src->command_buffer_;
@@ -344,6 +358,27 @@ void Tensor::Move(Tensor* src) {
 Tensor::Tensor(ElementType element_type, const Shape& shape)
     : element_type_(element_type), shape_(shape) {}
 
+Tensor::Tensor(ElementType element_type, const Shape& shape,
+               const QuantizationParameters& quantization_parameters)
+    : element_type_(element_type),
+      shape_(shape),
+      quantization_parameters_(quantization_parameters) {}
+
+Tensor::Tensor(ElementType element_type, const Shape& shape, void* cpu_buffer,
+               std::function<void(void*)> release)
+    : Tensor(element_type, shape, cpu_buffer, std::move(release),
+             QuantizationParameters()) {}
+
+Tensor::Tensor(ElementType element_type, const Shape& shape, void* cpu_buffer,
+               std::function<void(void*)> release,
+               const QuantizationParameters& quantization_parameters)
+    : element_type_(element_type),
+      shape_(shape),
+      quantization_parameters_(quantization_parameters),
+      valid_(kValidCpu),
+      cpu_buffer_(cpu_buffer),
+      cpu_buffer_release_(std::move(release)) {}
+
 void Tensor::Invalidate() {
 #if MEDIAPIPE_OPENGL_ES_VERSION >= MEDIAPIPE_OPENGL_ES_30
   GLuint cleanup_gl_tex = GL_INVALID_INDEX;
@@ -352,18 +387,27 @@ void Tensor::Invalidate() {
 #endif  // MEDIAPIPE_OPENGL_ES_VERSION >= MEDIAPIPE_OPENGL_ES_30
   {
     absl::MutexLock lock(&view_mutex_);
+    if (cpu_buffer_release_) {
 #if MEDIAPIPE_METAL_ENABLED
-    // If memory is allocated and not owned by the metal buffer.
-    // TODO: Re-design cpu buffer memory management.
-    if (cpu_buffer_ && !metal_buffer_) {
-      DeallocateVirtualMemory(cpu_buffer_, AlignToPageSize(bytes()));
-    }
-    metal_buffer_ = nil;
+      // The metal buffer doesn't own the caller-provided memory.
+      metal_buffer_ = nil;
+#endif  // MEDIAPIPE_METAL_ENABLED
+      cpu_buffer_release_(cpu_buffer_);
+      cpu_buffer_release_ = nullptr;
+    } else {
+#if MEDIAPIPE_METAL_ENABLED
+      // If memory is allocated and not owned by the metal buffer.
+      // TODO: Re-design cpu buffer memory management.
+      if (cpu_buffer_ && !metal_buffer_) {
+        DeallocateVirtualMemory(cpu_buffer_, AlignToPageSize(bytes()));
+      }
+      metal_buffer_ = nil;
 #else
-    if (cpu_buffer_) {
-      free(cpu_buffer_);
-    }
+      if (cpu_buffer_) {
+        aligned_free(cpu_buffer_);
+      }
 #endif  // MEDIAPIPE_METAL_ENABLED
+    }
     cpu_buffer_ = nullptr;
 
     // Don't need to wait for the resource to be deleted bacause if will be
@@ -477,7 +521,7 @@ void Tensor::AllocateCpuBuffer() const {
 #if MEDIAPIPE_METAL_ENABLED
     cpu_buffer_ = AllocateVirtualMemory(bytes());
 #else
-    cpu_buffer_ = malloc(bytes());
+    cpu_buffer_ = aligned_malloc(bytes(), kCpuBufferAlignment);
 #endif  // MEDIAPIPE_METAL_ENABLED
   }
 }
@@ -16,6 +16,8 @@
 #define MEDIAPIPE_FRAMEWORK_FORMATS_TENSOR_H_
 
 #include <algorithm>
+#include <cstdint>
+#include <functional>
 #include <initializer_list>
 #include <tuple>
 #include <type_traits>
@@ -76,7 +78,7 @@ class Tensor {
 
  public:
   // No resources are allocated here.
-  enum class ElementType { kNone, kFloat16, kFloat32 };
+  enum class ElementType { kNone, kFloat16, kFloat32, kUInt8, kInt8, kInt32 };
   struct Shape {
     Shape() = default;
     Shape(std::initializer_list<int> dimensions) : dims(dimensions) {}
@@ -88,8 +90,31 @@ class Tensor {
     }
     std::vector<int> dims;
   };
+  // Quantization parameters corresponding to the zero_point and scale value
+  // made available by TfLite quantized (uint8/int8) tensors:
+  // real_value = scale * (quantized_value - zero_point).
+  struct QuantizationParameters {
+    QuantizationParameters() = default;
+    QuantizationParameters(float scale, int zero_point)
+        : scale(scale), zero_point(zero_point) {}
+    float scale = 1.0f;
+    int zero_point = 0;
+  };
 
   Tensor(ElementType element_type, const Shape& shape);
+  Tensor(ElementType element_type, const Shape& shape,
+         const QuantizationParameters& quantization_parameters);
+
+  // Creates a tensor whose CPU content lives in "cpu_buffer", which is owned
+  // by the caller and must hold at least bytes() bytes. The buffer is
+  // considered written, i.e. the tensor is ready on CPU. "release" is invoked
+  // with the buffer once the tensor no longer uses it, which allows the caller
+  // to recycle the memory. With Metal, the buffer must be page-aligned.
+  Tensor(ElementType element_type, const Shape& shape, void* cpu_buffer,
+         std::function<void(void*)> release);
+  Tensor(ElementType element_type, const Shape& shape, void* cpu_buffer,
+         std::function<void(void*)> release,
+         const QuantizationParameters& quantization_parameters);
 
   // Non-copyable.
   Tensor(const Tensor&) = delete;
@@ -207,6 +232,9 @@ class Tensor {
 
   const Shape& shape() const { return shape_; }
   ElementType element_type() const { return element_type_; }
+  const QuantizationParameters& quantization_parameters() const {
+    return quantization_parameters_;
+  }
   int element_size() const {
     switch (element_type_) {
       case ElementType::kNone:
@@ -215,10 +243,21 @@ class Tensor {
         return 2;
       case ElementType::kFloat32:
         return sizeof(float);
+      case ElementType::kUInt8:
+        return 1;
+      case ElementType::kInt8:
+        return 1;
+      case ElementType::kInt32:
+        return sizeof(int32_t);
     }
   }
   int bytes() const { return shape_.num_elements() * element_size(); }
 
+  // CPU buffers allocated by the tensor are aligned to this many bytes, which
+  // also satisfies the alignment TfLite requires for custom tensor
+  // allocations.
+  static constexpr int kCpuBufferAlignment = 64;
+
   bool ready_on_cpu() const { return valid_ & kValidCpu; }
   bool ready_on_gpu() const {
     return valid_ &
@@ -236,6 +275,7 @@ class Tensor {
 
   ElementType element_type_;
   Shape shape_;
+  QuantizationParameters quantization_parameters_;
 
   // The flags describe the current source of truth resource type.
   enum {
@@ -252,6 +292,8 @@ class Tensor {
   mutable absl::Mutex view_mutex_;
 
   mutable void* cpu_buffer_ = nullptr;
+  // Set if cpu_buffer_ is provided by the caller instead of allocated here.
+  std::function<void(void*)> cpu_buffer_release_;
   void AllocateCpuBuffer() const;
 #if MEDIAPIPE_METAL_ENABLED
   mutable id<MTLCommandBuffer> command_buffer_;
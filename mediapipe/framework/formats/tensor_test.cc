@@ -23,6 +23,30 @@ TEST(General, TestDataTypes) {
 
   Tensor t2(Tensor::ElementType::kFloat16, Tensor::Shape{4, 3, 2, 3});
   EXPECT_EQ(t2.bytes(), t2.shape().num_elements() * 2);
+
+  Tensor t_uint8(Tensor::ElementType::kUInt8, Tensor::Shape{4, 3, 2, 3});
+  EXPECT_EQ(t_uint8.bytes(), t_uint8.shape().num_elements() * 1);
+
+  Tensor t_int8(Tensor::ElementType::kInt8, Tensor::Shape{4, 3, 2, 3});
+  EXPECT_EQ(t_int8.bytes(), t_int8.shape().num_elements() * 1);
+
+  Tensor t_int32(Tensor::ElementType::kInt32, Tensor::Shape{4, 3, 2, 3});
+  EXPECT_EQ(t_int32.bytes(), t_int32.shape().num_elements() * sizeof(int32_t));
+}
+
+TEST(General, TestQuantizationParameters) {
+  Tensor t1(Tensor::ElementType::kFloat32, Tensor::Shape{1, 2, 3, 4});
+  EXPECT_EQ(t1.quantization_parameters().scale, 1.0f);
+  EXPECT_EQ(t1.quantization_parameters().zero_point, 0);
+
+  Tensor t2(Tensor::ElementType::kInt8, Tensor::Shape{1, 2, 3, 4},
+            Tensor::QuantizationParameters(0.5f, -3));
+  EXPECT_EQ(t2.quantization_parameters().scale, 0.5f);
+  EXPECT_EQ(t2.quantization_parameters().zero_point, -3);
+  Tensor t3(std::move(t2));
+  EXPECT_EQ(t3.element_type(), Tensor::ElementType::kInt8);
+  EXPECT_EQ(t3.quantization_parameters().scale, 0.5f);
+  EXPECT_EQ(t3.quantization_parameters().zero_point, -3);
 }
 
 TEST(Cpu, TestMemoryAllocation) {
@@ -54,6 +78,23 @@ TEST(Cpu, TestViewMove) {
   EXPECT_EQ(v1.buffer<float>(), nullptr);  // NOLINT
 }
 
+TEST(Cpu, TestExternalBuffer) {
+  float buffer[4 * 3 * 2 * 3] = {1.0f};
+  void* released = nullptr;
+  {
+    Tensor t1(Tensor::ElementType::kFloat32, Tensor::Shape{4, 3, 2, 3}, buffer,
+              [&released](void* ptr) { released = ptr; });
+    EXPECT_TRUE(t1.ready_on_cpu());
+    EXPECT_EQ(t1.GetCpuReadView().buffer<float>(), buffer);
+    EXPECT_EQ(t1.GetCpuReadView().buffer<float>()[0], 1.0f);
+    // Moving the tensor doesn't release the buffer.
+    Tensor t2(std::move(t1));
+    EXPECT_EQ(released, nullptr);
+    EXPECT_EQ(t2.GetCpuWriteView().buffer<float>(), buffer);
+  }
+  EXPECT_EQ(released, buffer);
+}
+
 }  // namespace mediapipe
 
 int main(int argc, char** argv) {
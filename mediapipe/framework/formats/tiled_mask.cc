@@ -0,0 +1,175 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/tiled_mask.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr int kTileSize = TiledMask::kTileSize;
+
+inline uint8 ToMaskValue(uint8 value) { return value; }
+
+inline uint8 ToMaskValue(float value) {
+  return static_cast<uint8>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f +
+                            0.5f);
+}
+
+// Reads a tile of "frame" starting at (left, top) into "tile", with zeros past
+// the edge of the frame, and returns the type of the tile.
+template <typename T>
+TiledMask::TileType ReadTile(const ImageFrame& frame, int left, int top,
+                             uint8* tile) {
+  const int width = std::min(kTileSize, frame.Width() - left);
+  const int height = std::min(kTileSize, frame.Height() - top);
+  const int channels = frame.NumberOfChannels();
+  if (width < kTileSize || height < kTileSize) {
+    std::memset(tile, 0, TiledMask::kTilePixels);
+  }
+  // Bitwise and/or of all values: 0 if all are 0, 255 if all are 255.
+  uint8 all_and = 255;
+  uint8 any_or = 0;
+  for (int y = 0; y < height; ++y) {
+    const T* src = reinterpret_cast<const T*>(
+        frame.PixelData() + (top + y) * frame.WidthStep()) + left * channels;
+    uint8* dst = tile + y * kTileSize;
+    if (channels == 1) {
+      // Contiguous loop, which the compiler vectorizes.
+      for (int x = 0; x < width; ++x) {
+        const uint8 value = ToMaskValue(src[x]);
+        dst[x] = value;
+        all_and &= value;
+        any_or |= value;
+      }
+    } else {
+      for (int x = 0; x < width; ++x) {
+        const uint8 value = ToMaskValue(src[x * channels]);
+        dst[x] = value;
+        all_and &= value;
+        any_or |= value;
+      }
+    }
+  }
+  if (any_or == 0) return TiledMask::TileType::kEmpty;
+  if (all_and == 255) return TiledMask::TileType::kFull;
+  return TiledMask::TileType::kMixed;
+}
+
+}  // namespace
+
+constexpr int TiledMask::kTileSize;
+constexpr int TiledMask::kTilePixels;
+
+TiledMask::TiledMask(int width, int height)
+    : width_(width),
+      height_(height),
+      tiles_x_((width + kTileSize - 1) / kTileSize),
+      tiles_y_((height + kTileSize - 1) / kTileSize),
+      tile_types_(tiles_x_ * tiles_y_, TileType::kEmpty),
+      tile_offsets_(tiles_x_ * tiles_y_, 0) {}
+
+absl::StatusOr<TiledMask> TiledMask::FromImageFrame(const ImageFrame& frame) {
+  RET_CHECK(frame.Format() == ImageFormat::GRAY8 ||
+            frame.Format() == ImageFormat::VEC32F1)
+      << "Unsupported mask format: " << frame.Format();
+  TiledMask mask(frame.Width(), frame.Height());
+  uint8 tile[kTilePixels];
+  for (int tile_y = 0; tile_y < mask.tiles_y_; ++tile_y) {
+    for (int tile_x = 0; tile_x < mask.tiles_x_; ++tile_x) {
+      const int left = tile_x * kTileSize;
+      const int top = tile_y * kTileSize;
+      const TileType type =
+          frame.Format() == ImageFormat::VEC32F1
+              ? ReadTile<float>(frame, left, top, tile)
+              : ReadTile<uint8>(frame, left, top, tile);
+      const int index = tile_y * mask.tiles_x_ + tile_x;
+      mask.tile_types_[index] = type;
+      if (type == TileType::kMixed) {
+        mask.tile_offsets_[index] = mask.data_.size();
+        mask.data_.insert(mask.data_.end(), tile, tile + kTilePixels);
+      }
+    }
+  }
+  return mask;
+}
+
+absl::Status TiledMask::CopyToImageFrame(ImageFrame* frame) const {
+  RET_CHECK(frame->Format() == ImageFormat::GRAY8 ||
+            frame->Format() == ImageFormat::VEC32F1)
+      << "Unsupported mask format: " << frame->Format();
+  RET_CHECK_EQ(frame->Width(), width_);
+  RET_CHECK_EQ(frame->Height(), height_);
+  const bool is_float = frame->Format() == ImageFormat::VEC32F1;
+  for (int tile_y = 0; tile_y < tiles_y_; ++tile_y) {
+    const int top = tile_y * kTileSize;
+    const int height = std::min(kTileSize, height_ - top);
+    for (int tile_x = 0; tile_x < tiles_x_; ++tile_x) {
+      const int left = tile_x * kTileSize;
+      const int width = std::min(kTileSize, width_ - left);
+      const TileType type = tile_type(tile_x, tile_y);
+      const uint8* values =
+          type == TileType::kMixed ? tile_data(tile_x, tile_y) : nullptr;
+      const uint8 fill = type == TileType::kFull ? 255 : 0;
+      for (int y = 0; y < height; ++y) {
+        uint8* row = frame->MutablePixelData() + (top + y) * frame->WidthStep();
+        if (is_float) {
+          float* dst = reinterpret_cast<float*>(row) + left;
+          for (int x = 0; x < width; ++x) {
+            dst[x] = (values ? values[y * kTileSize + x] : fill) / 255.0f;
+          }
+        } else if (values) {
+          std::memcpy(row + left, values + y * kTileSize, width);
+        } else {
+          std::memset(row + left, fill, width);
+        }
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+std::unique_ptr<ImageFrame> TiledMask::ToImageFrame() const {
+  auto frame =
+      absl::make_unique<ImageFrame>(ImageFormat::GRAY8, width_, height_);
+  CopyToImageFrame(frame.get()).IgnoreError();
+  return frame;
+}
+
+uint8 TiledMask::GetValue(int x, int y) const {
+  const int tile_x = x / kTileSize;
+  const int tile_y = y / kTileSize;
+  switch (tile_type(tile_x, tile_y)) {
+    case TileType::kEmpty:
+      return 0;
+    case TileType::kFull:
+      return 255;
+    case TileType::kMixed:
+      break;
+  }
+  return tile_data(tile_x, tile_y)[(y % kTileSize) * kTileSize +
+                                   x % kTileSize];
+}
+
+size_t TiledMask::ByteSize() const {
+  return sizeof(*this) + tile_types_.size() * sizeof(TileType) +
+         tile_offsets_.size() * sizeof(int32) + data_.size();
+}
+
+}  // namespace mediapipe
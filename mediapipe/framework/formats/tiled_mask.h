@@ -0,0 +1,122 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_FORMATS_TILED_MASK_H_
+#define MEDIAPIPE_FRAMEWORK_FORMATS_TILED_MASK_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+
+namespace mediapipe {
+
+// A single channel 8-bit mask, such as a segmentation mask or an alpha matte,
+// stored as square tiles of kTileSize x kTileSize pixels. Tiles that are
+// entirely 0 (background) or entirely 255 (foreground) only take one byte,
+// so a mask whose edges cover a small part of the frame is much smaller than
+// the equivalent ImageFrame and cheaper to pass between calculators.
+//
+// Consumers can iterate over the tiles and skip uniform ones, or convert the
+// mask back to an ImageFrame with CopyToImageFrame().
+//
+// Example usage:
+//   ASSIGN_OR_RETURN(TiledMask mask, TiledMask::FromImageFrame(mask_frame));
+//   for (int tile_y = 0; tile_y < mask.tiles_y(); ++tile_y) {
+//     for (int tile_x = 0; tile_x < mask.tiles_x(); ++tile_x) {
+//       if (mask.tile_type(tile_x, tile_y) == TiledMask::TileType::kMixed) {
+//         const uint8* values = mask.tile_data(tile_x, tile_y);
+//         ...
+//       }
+//     }
+//   }
+class TiledMask {
+ public:
+  static constexpr int kTileSize = 16;
+  static constexpr int kTilePixels = kTileSize * kTileSize;
+
+  enum class TileType : uint8 {
+    // All values are 0.
+    kEmpty = 0,
+    // All values are 255.
+    kFull = 1,
+    // Values are stored in tile_data().
+    kMixed = 2,
+  };
+
+  TiledMask() = default;
+  // Creates a mask of the given size with all values 0.
+  TiledMask(int width, int height);
+
+  TiledMask(TiledMask&&) = default;
+  TiledMask& operator=(TiledMask&&) = default;
+  TiledMask(const TiledMask&) = default;
+  TiledMask& operator=(const TiledMask&) = default;
+
+  // Creates a mask from the first channel of a GRAY8 frame, or from a VEC32F1
+  // frame with values in [0, 1], which are scaled to [0, 255] and rounded.
+  static absl::StatusOr<TiledMask> FromImageFrame(const ImageFrame& frame);
+
+  // Writes the mask to "frame", which must have the size of the mask and the
+  // GRAY8 or VEC32F1 format. VEC32F1 values are scaled to [0, 1]. Uniform
+  // tiles are filled without reading any mask data.
+  absl::Status CopyToImageFrame(ImageFrame* frame) const;
+
+  // Returns the mask as a new GRAY8 frame.
+  std::unique_ptr<ImageFrame> ToImageFrame() const;
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  // Number of tiles in each direction. Tiles in the last column and row may
+  // extend past the mask.
+  int tiles_x() const { return tiles_x_; }
+  int tiles_y() const { return tiles_y_; }
+
+  TileType tile_type(int tile_x, int tile_y) const {
+    return tile_types_[tile_y * tiles_x_ + tile_x];
+  }
+
+  // Returns the kTileSize x kTileSize values of a kMixed tile, row by row.
+  // Values past the edge of the mask are 0.
+  const uint8* tile_data(int tile_x, int tile_y) const {
+    return data_.data() + tile_offsets_[tile_y * tiles_x_ + tile_x];
+  }
+
+  // Returns the value at pixel (x, y), which must be in the mask.
+  uint8 GetValue(int x, int y) const;
+
+  // Number of tiles that store their values.
+  int num_mixed_tiles() const { return data_.size() / kTilePixels; }
+
+  // Approximate memory used by the mask, in bytes.
+  size_t ByteSize() const;
+
+ private:
+  int width_ = 0;
+  int height_ = 0;
+  int tiles_x_ = 0;
+  int tiles_y_ = 0;
+  std::vector<TileType> tile_types_;
+  // Offset of each kMixed tile in data_, indexed like tile_types_.
+  std::vector<int32> tile_offsets_;
+  std::vector<uint8> data_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_FORMATS_TILED_MASK_H_
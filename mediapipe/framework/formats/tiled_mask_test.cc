@@ -0,0 +1,138 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/formats/tiled_mask.h"
+
+#include <cmath>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+using TileType = TiledMask::TileType;
+
+// Returns a GRAY8 mask with a filled circle and a soft edge.
+ImageFrame MakeCircleMask(int width, int height, float center_x,
+                          float center_y, float radius) {
+  ImageFrame frame(ImageFormat::GRAY8, width, height);
+  for (int y = 0; y < height; ++y) {
+    uint8* row = frame.MutablePixelData() + y * frame.WidthStep();
+    for (int x = 0; x < width; ++x) {
+      const float distance = std::hypot(x - center_x, y - center_y);
+      row[x] = static_cast<uint8>(
+          std::min(std::max(radius - distance, 0.0f), 1.0f) * 255.0f);
+    }
+  }
+  return frame;
+}
+
+TEST(TiledMaskTest, EmptyMask) {
+  TiledMask mask(40, 20);
+  EXPECT_EQ(mask.tiles_x(), 3);
+  EXPECT_EQ(mask.tiles_y(), 2);
+  EXPECT_EQ(mask.num_mixed_tiles(), 0);
+  EXPECT_EQ(mask.tile_type(2, 1), TileType::kEmpty);
+  EXPECT_EQ(mask.GetValue(39, 19), 0);
+}
+
+TEST(TiledMaskTest, RoundTripsGray8) {
+  const ImageFrame frame = MakeCircleMask(101, 67, 40.0f, 30.0f, 25.0f);
+  auto status_or_mask = TiledMask::FromImageFrame(frame);
+  MP_ASSERT_OK(status_or_mask);
+  const TiledMask& mask = status_or_mask.value();
+  EXPECT_EQ(mask.width(), 101);
+  EXPECT_EQ(mask.height(), 67);
+  EXPECT_EQ(mask.tile_type(0, 0), TileType::kEmpty);
+  EXPECT_EQ(mask.tile_type(2, 1), TileType::kFull);
+  EXPECT_EQ(mask.tile_type(1, 0), TileType::kMixed);
+  EXPECT_GT(mask.num_mixed_tiles(), 0);
+  EXPECT_LT(mask.num_mixed_tiles(), mask.tiles_x() * mask.tiles_y());
+
+  ImageFrame output(ImageFormat::GRAY8, 101, 67);
+  MP_ASSERT_OK(mask.CopyToImageFrame(&output));
+  for (int y = 0; y < 67; ++y) {
+    for (int x = 0; x < 101; ++x) {
+      const uint8 expected = frame.PixelData()[y * frame.WidthStep() + x];
+      ASSERT_EQ(output.PixelData()[y * output.WidthStep() + x], expected)
+          << x << ", " << y;
+      ASSERT_EQ(mask.GetValue(x, y), expected) << x << ", " << y;
+    }
+  }
+}
+
+TEST(TiledMaskTest, ConvertsFloatMasks) {
+  ImageFrame frame(ImageFormat::VEC32F1, 20, 18);
+  for (int y = 0; y < 18; ++y) {
+    float* row = reinterpret_cast<float*>(frame.MutablePixelData() +
+                                          y * frame.WidthStep());
+    for (int x = 0; x < 20; ++x) {
+      row[x] = x < 16 ? 1.5f : (x - 16) * 0.25f;
+    }
+  }
+  auto status_or_mask = TiledMask::FromImageFrame(frame);
+  MP_ASSERT_OK(status_or_mask);
+  const TiledMask& mask = status_or_mask.value();
+  // Out of range values are clamped.
+  EXPECT_EQ(mask.tile_type(0, 0), TileType::kFull);
+  EXPECT_EQ(mask.tile_type(0, 1), TileType::kFull);
+  EXPECT_EQ(mask.tile_type(1, 0), TileType::kMixed);
+  EXPECT_EQ(mask.GetValue(17, 3), 64);
+
+  ImageFrame output(ImageFormat::VEC32F1, 20, 18);
+  MP_ASSERT_OK(mask.CopyToImageFrame(&output));
+  for (int y = 0; y < 18; ++y) {
+    const float* row = reinterpret_cast<const float*>(output.PixelData() +
+                                                      y * output.WidthStep());
+    for (int x = 0; x < 20; ++x) {
+      EXPECT_NEAR(row[x], x < 16 ? 1.0f : (x - 16) * 0.25f, 1.0f / 255.0f);
+    }
+  }
+
+  auto gray = mask.ToImageFrame();
+  EXPECT_EQ(gray->Format(), ImageFormat::GRAY8);
+  EXPECT_EQ(gray->PixelData()[19], 191);
+}
+
+TEST(TiledMaskTest, RejectsInvalidFrames) {
+  EXPECT_FALSE(
+      TiledMask::FromImageFrame(ImageFrame(ImageFormat::SRGB, 8, 8)).ok());
+  TiledMask mask(8, 8);
+  ImageFrame wrong_size(ImageFormat::GRAY8, 8, 9);
+  EXPECT_FALSE(mask.CopyToImageFrame(&wrong_size).ok());
+}
+
+// A 1080p person mask: most tiles are uniform.
+void BM_FromImageFrame(benchmark::State& state) {
+  const ImageFrame frame = MakeCircleMask(1920, 1080, 960, 700, 400);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(TiledMask::FromImageFrame(frame));
+  }
+}
+BENCHMARK(BM_FromImageFrame);
+
+void BM_CopyToImageFrame(benchmark::State& state) {
+  const ImageFrame frame = MakeCircleMask(1920, 1080, 960, 700, 400);
+  const TiledMask mask = TiledMask::FromImageFrame(frame).value();
+  ImageFrame output(ImageFormat::GRAY8, 1920, 1080);
+  for (auto _ : state) {
+    mask.CopyToImageFrame(&output).IgnoreError();
+  }
+}
+BENCHMARK(BM_CopyToImageFrame);
+
+}  // namespace
+}  // namespace mediapipe
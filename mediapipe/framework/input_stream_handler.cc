@@ -247,6 +247,10 @@ void LogQueuedPackets(CalculatorContext* context, InputStreamManager* stream,
                            .set_event_data(stream->QueueSize() + 1);
     mediapipe::LogEvent(context->GetProfilingContext(),
                         event.set_packet_ts(queue_tail.Timestamp()));
+    // Only the consumer can look at the head of a lock-free queue.
+    if (stream->UsesLockFreeQueue()) {
+      return;
+    }
     Packet queue_head = stream->QueueHead();
     if (!queue_head.IsEmpty()) {
       mediapipe::LogEvent(context->GetProfilingContext(),
@@ -188,6 +188,13 @@ class InputStreamHandler {
   // Returns the number of sync-sets populated by this input stream handler.
   virtual int SyncSetCount() { return 1; }
 
+  // Returns true if the input streams can use a lock-free packet queue, see
+  // InputStreamManager::EnableLockFreeQueue(). This requires the handler to
+  // read the streams only from GetNodeReadiness() and FillInputSet() called
+  // by the scheduling loop, and not to touch the queues when packets are
+  // added.
+  virtual bool SupportsLockFreeQueues() const { return false; }
+
   // A helper class to build input packet sets for a certain set of streams.
   //
   // ReadyForProcess requires all of the streams to be fully determined
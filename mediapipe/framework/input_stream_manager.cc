@@ -23,6 +23,7 @@
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/source_location.h"
 #include "mediapipe/framework/port/status_builder.h"
+#include "mediapipe/framework/port/status_macros.h"
 #include "mediapipe/framework/tool/status_util.h"
 
 namespace mediapipe {
@@ -39,6 +40,8 @@ absl::Status InputStreamManager::Initialize(const std::string& name,
 
 const std::string& InputStreamManager::Name() const { return name_; }
 
+void InputStreamManager::EnableLockFreeQueue() { lock_free_ = true; }
+
 void InputStreamManager::SetQueueSizeCallbacks(
     QueueSizeCallback becomes_full_callback,
     QueueSizeCallback becomes_not_full_callback) {
@@ -49,9 +52,11 @@ void InputStreamManager::SetQueueSizeCallbacks(
 void InputStreamManager::PrepareForRun() {
   absl::MutexLock stream_lock(&stream_mutex_);
   queue_.clear();
+  spsc_queue_.Clear();
   last_reported_stream_full_ = false;
   num_packets_added_ = 0;
   next_timestamp_bound_ = Timestamp::PreStream();
+  lock_free_bound_ = Timestamp::PreStream().Value();
   last_select_timestamp_ = Timestamp::Unstarted();
   closed_ = false;
   header_ = Packet();
@@ -59,11 +64,18 @@ void InputStreamManager::PrepareForRun() {
 
 bool InputStreamManager::IsEmpty() const {
   absl::MutexLock stream_lock(&stream_mutex_);
+  if (lock_free_) {
+    return spsc_queue_.Empty();
+  }
   return queue_.empty();
 }
 
 Packet InputStreamManager::QueueHead() const {
   absl::MutexLock stream_lock(&stream_mutex_);
+  if (lock_free_) {
+    const Packet* head = spsc_queue_.Front();
+    return head ? *head : Packet();
+  }
   if (queue_.empty()) {
     return Packet();
   }
@@ -90,9 +102,57 @@ absl::Status InputStreamManager::MovePackets(std::list<Packet>* container,
   return AddOrMovePacketsInternal<std::list<Packet>&>(*container, notify);
 }
 
+absl::Status InputStreamManager::ValidatePacket(
+    const Packet& packet, Timestamp next_timestamp_bound) const {
+  absl::Status result = packet_type_->Validate(packet);
+  if (!result.ok()) {
+    return tool::AddStatusPrefix(
+        absl::StrCat(
+            "Packet type mismatch on a calculator receiving from stream \"",
+            name_, "\": "),
+        result);
+  }
+
+  const Timestamp timestamp = packet.Timestamp();
+  if (!timestamp.IsAllowedInStream()) {
+    return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+           << "In stream \"" << name_
+           << "\", timestamp not specified or set to illegal value: "
+           << timestamp.DebugString();
+  }
+  if (enable_timestamps_) {
+    // Check that PostStream(), if used, is the only timestamp used.  This
+    // is also true for PreStream() but doesn't need to be checked because
+    // Timestamp::PreStream().NextAllowedInStream() is
+    // Timestamp::OneOverPostStream().
+    if (timestamp == Timestamp::PostStream() && num_packets_added_ > 0) {
+      return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "In stream \"" << name_
+             << "\", a packet at Timestamp::PostStream() must be the only "
+                "Packet in an InputStream.";
+    }
+    if (timestamp < next_timestamp_bound) {
+      return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
+             << "Packet timestamp mismatch on a calculator receiving from "
+                "stream \""
+             << name_ << "\". Current minimum expected timestamp is "
+             << next_timestamp_bound.DebugString() << " but received "
+             << timestamp.DebugString()
+             << ". Are you using a custom InputStreamHandler? Note that "
+                "some InputStreamHandlers allow timestamps that are not "
+                "strictly monotonically increasing. See for example the "
+                "ImmediateInputStreamHandler class comment.";
+    }
+  }
+  return absl::OkStatus();
+}
+
 template <typename Container>
 absl::Status InputStreamManager::AddOrMovePacketsInternal(Container container,
                                                           bool* notify) {
+  if (lock_free_) {
+    return AddOrMovePacketsLockFree<Container>(container, notify);
+  }
   *notify = false;
   bool queue_became_non_empty = false;
   bool queue_became_full = false;
@@ -108,47 +168,8 @@ absl::Status InputStreamManager::AddOrMovePacketsInternal(Container container,
     // Check if the queue becomes non-empty.
     queue_became_non_empty = queue_.empty() && !container.empty();
     for (auto& packet : container) {
-      absl::Status result = packet_type_->Validate(packet);
-      if (!result.ok()) {
-        return tool::AddStatusPrefix(
-            absl::StrCat(
-                "Packet type mismatch on a calculator receiving from stream \"",
-                name_, "\": "),
-            result);
-      }
-
-      const Timestamp timestamp = packet.Timestamp();
-      if (!timestamp.IsAllowedInStream()) {
-        return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-               << "In stream \"" << name_
-               << "\", timestamp not specified or set to illegal value: "
-               << timestamp.DebugString();
-      }
-      if (enable_timestamps_) {
-        // Check that PostStream(), if used, is the only timestamp used.  This
-        // is also true for PreStream() but doesn't need to be checked because
-        // Timestamp::PreStream().NextAllowedInStream() is
-        // Timestamp::OneOverPostStream().
-        if (timestamp == Timestamp::PostStream() && num_packets_added_ > 0) {
-          return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-                 << "In stream \"" << name_
-                 << "\", a packet at Timestamp::PostStream() must be the only "
-                    "Packet in an InputStream.";
-        }
-        if (timestamp < next_timestamp_bound_) {
-          return mediapipe::InvalidArgumentErrorBuilder(MEDIAPIPE_LOC)
-                 << "Packet timestamp mismatch on a calculator receiving from "
-                    "stream \""
-                 << name_ << "\". Current minimum expected timestamp is "
-                 << next_timestamp_bound_.DebugString() << " but received "
-                 << timestamp.DebugString()
-                 << ". Are you using a custom InputStreamHandler? Note that "
-                    "some InputStreamHandlers allow timestamps that are not "
-                    "strictly monotonically increasing. See for example the "
-                    "ImmediateInputStreamHandler class comment.";
-        }
-      }
-      next_timestamp_bound_ = timestamp.NextAllowedInStream();
+      MP_RETURN_IF_ERROR(ValidatePacket(packet, next_timestamp_bound_));
+      next_timestamp_bound_ = packet.Timestamp().NextAllowedInStream();
 
       // If the caller is MovePackets(), packet's underlying holder should be
       // transferred into queue_. Otherwise, queue_ keeps a copy of the packet.
@@ -180,8 +201,58 @@ absl::Status InputStreamManager::AddOrMovePacketsInternal(Container container,
   return absl::OkStatus();
 }
 
+template <typename Container>
+absl::Status InputStreamManager::AddOrMovePacketsLockFree(
+    Container container, bool* notify) ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  *notify = false;
+  if (closed_ || container.empty()) {
+    return absl::OkStatus();
+  }
+  const int max_queue_size = max_queue_size_;
+  const bool was_queue_full =
+      (max_queue_size != -1 && spsc_queue_.Size() >= max_queue_size);
+  absl::Status status;
+  Timestamp bound = LockFreeBound();
+  int64 num_pushed = 0;
+  for (auto& packet : container) {
+    status = ValidatePacket(packet, bound);
+    if (!status.ok()) {
+      break;
+    }
+    bound = packet.Timestamp().NextAllowedInStream();
+    ++num_packets_added_;
+    VLOG(3) << "Input stream:" << name_
+            << " has added packet at time: " << packet.Timestamp();
+    if (std::is_const<
+            typename std::remove_reference<Container>::type>::value) {
+      spsc_queue_.Push(packet);
+    } else {
+      spsc_queue_.Push(std::move(packet));
+    }
+    ++num_pushed;
+  }
+  // The bound is raised only once the packets are visible in the queue.
+  RaiseLockFreeBound(bound);
+  MP_RETURN_IF_ERROR(status);
+
+  // Reads the size after pushing: either we see that the consumer has drained
+  // the queue before our packets, or the consumer sees our packets.
+  const int64 queue_size = spsc_queue_.Size();
+  const bool queue_became_full =
+      (!was_queue_full && max_queue_size != -1 && queue_size >= max_queue_size);
+  if (queue_became_full) {
+    VLOG(3) << "Queue became full: " << Name();
+    becomes_full_callback_(this, &last_reported_stream_full_);
+  }
+  *notify = queue_size <= num_pushed;
+  return absl::OkStatus();
+}
+
 absl::Status InputStreamManager::SetNextTimestampBound(const Timestamp bound,
                                                        bool* notify) {
+  if (lock_free_) {
+    return SetNextTimestampBoundLockFree(bound, notify);
+  }
   *notify = false;
   {
     // Scope to prevent locking the stream when notification is called.
@@ -214,6 +285,38 @@ absl::Status InputStreamManager::SetNextTimestampBound(const Timestamp bound,
   return absl::OkStatus();
 }
 
+absl::Status InputStreamManager::SetNextTimestampBoundLockFree(
+    const Timestamp bound, bool* notify) {
+  *notify = false;
+  if (closed_) {
+    return absl::OkStatus();
+  }
+  const Timestamp next_timestamp_bound = LockFreeBound();
+  if (enable_timestamps_ && bound < next_timestamp_bound) {
+    return mediapipe::UnknownErrorBuilder(MEDIAPIPE_LOC)
+           << "SetNextTimestampBound must be called with a timestamp greater "
+              "than or equal to the current bound. In stream \""
+           << name_ << "\". Current minimum expected timestamp is "
+           << next_timestamp_bound.DebugString() << " but received "
+           << bound.DebugString();
+  }
+  // Checks the queue after raising the bound, see AddOrMovePacketsLockFree().
+  if (RaiseLockFreeBound(bound) && spsc_queue_.Size() == 0) {
+    *notify = true;
+  }
+  return absl::OkStatus();
+}
+
+bool InputStreamManager::RaiseLockFreeBound(Timestamp bound) {
+  int64 current = lock_free_bound_.load();
+  while (current < bound.Value()) {
+    if (lock_free_bound_.compare_exchange_weak(current, bound.Value())) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void InputStreamManager::DisableTimestamps() { enable_timestamps_ = false; }
 
 void InputStreamManager::Close() {
@@ -222,12 +325,22 @@ void InputStreamManager::Close() {
     return;
   }
   next_timestamp_bound_ = Timestamp::Done();
+  lock_free_bound_ = Timestamp::Done().Value();
   last_select_timestamp_ = Timestamp::Done();
   closed_ = true;
 }
 
 Timestamp InputStreamManager::MinTimestampOrBound(bool* is_empty) const {
   absl::MutexLock stream_lock(&stream_mutex_);
+  if (lock_free_) {
+    // Reads the bound first, see lock_free_.
+    const Timestamp bound = LockFreeBound();
+    const Packet* head = spsc_queue_.Front();
+    if (is_empty) {
+      *is_empty = (head == nullptr);
+    }
+    return head ? head->Timestamp() : bound;
+  }
   if (is_empty) {
     *is_empty = queue_.empty();
   }
@@ -236,6 +349,11 @@ Timestamp InputStreamManager::MinTimestampOrBound(bool* is_empty) const {
 
 Timestamp InputStreamManager::MinTimestampOrBoundHelper() const
     ABSL_EXCLUSIVE_LOCKS_REQUIRED(stream_mutex_) {
+  if (lock_free_) {
+    const Timestamp bound = LockFreeBound();
+    const Packet* head = spsc_queue_.Front();
+    return head ? head->Timestamp() : bound;
+  }
   return queue_.empty() ? next_timestamp_bound_ : queue_.front().Timestamp();
 }
 
@@ -255,21 +373,37 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
 
     // Make sure AddPacket and SetNextTimestampBound are not called with
     // timestamps we have already passed.
-    if (next_timestamp_bound_ <= timestamp) {
+    if (lock_free_) {
+      if (LockFreeBound() <= timestamp) {
+        RaiseLockFreeBound(timestamp.NextAllowedInStream());
+      }
+    } else if (next_timestamp_bound_ <= timestamp) {
       next_timestamp_bound_ = timestamp.NextAllowedInStream();
     }
 
     VLOG(3) << "Input stream " << name_
             << " selecting at timestamp:" << timestamp.Value()
-            << " next timestamp bound: " << next_timestamp_bound_;
+            << " next timestamp bound: "
+            << (lock_free_ ? LockFreeBound() : next_timestamp_bound_);
 
     // Advances time to timestamp.
     Timestamp current_timestamp = Timestamp::Unset();
 
     // Checks if queue is full.
+    const int max_queue_size = max_queue_size_;
     bool was_queue_full =
-        (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
-
+        (max_queue_size != -1 && QueueSizeInternal() >= max_queue_size);
+
+    if (lock_free_) {
+      for (Packet* head = spsc_queue_.Front();
+           head && head->Timestamp() <= timestamp;
+           head = spsc_queue_.Front()) {
+        packet = std::move(*head);
+        spsc_queue_.Pop();
+        current_timestamp = packet.Timestamp();
+        ++(*num_packets_dropped);
+      }
+    }
     while (!queue_.empty() && queue_.front().Timestamp() <= timestamp) {
       packet = std::move(queue_.front());
       queue_.pop_front();
@@ -284,9 +418,10 @@ Packet InputStreamManager::PopPacketAtTimestamp(Timestamp timestamp,
       ++(*num_packets_dropped);
     }
 
+    const int64 queue_size = QueueSizeInternal();
     VLOG(3) << "Input stream removed packets:" << name_
-            << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+            << " Size:" << queue_size;
+    queue_became_non_full = (was_queue_full && queue_size < max_queue_size);
     *stream_is_done = IsDone();
   }
   if (queue_became_non_full) {
@@ -307,19 +442,27 @@ Packet InputStreamManager::PopQueueHead(bool* stream_is_done) {
     VLOG(3) << "Input stream " << name_ << " selecting at queue head";
 
     // Check if queue is full.
+    const int max_queue_size = max_queue_size_;
     bool was_queue_full =
-        (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+        (max_queue_size != -1 && QueueSizeInternal() >= max_queue_size);
 
-    if (!queue_.empty()) {
+    if (lock_free_) {
+      Packet* head = spsc_queue_.Front();
+      if (head) {
+        packet = std::move(*head);
+        spsc_queue_.Pop();
+      }
+    } else if (!queue_.empty()) {
       packet = std::move(queue_.front());
       queue_.pop_front();
     } else {
       packet = Packet();
     }
 
+    const int64 queue_size = QueueSizeInternal();
     VLOG(3) << "Input stream removed a packet:" << name_
-            << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+            << " Size:" << queue_size;
+    queue_became_non_full = (was_queue_full && queue_size < max_queue_size);
     *stream_is_done = IsDone();
   }
   if (queue_became_non_full) {
@@ -330,23 +473,26 @@ Packet InputStreamManager::PopQueueHead(bool* stream_is_done) {
 }
 
 int InputStreamManager::QueueSize() const {
-  absl::MutexLock lock(&stream_mutex_);
-  return static_cast<int>(queue_.size());
+  absl::MutexLockMaybe lock(lock_free_ ? nullptr : &stream_mutex_);
+  return static_cast<int>(QueueSizeInternal());
 }
 
-int InputStreamManager::MaxQueueSize() const {
-  absl::MutexLock lock(&stream_mutex_);
-  return max_queue_size_;
+int64 InputStreamManager::QueueSizeInternal() const
+    ABSL_NO_THREAD_SAFETY_ANALYSIS {
+  return lock_free_ ? spsc_queue_.Size() : queue_.size();
 }
 
+int InputStreamManager::MaxQueueSize() const { return max_queue_size_; }
+
 void InputStreamManager::SetMaxQueueSize(int max_queue_size) {
   bool was_full;
   bool is_full;
   {
     absl::MutexLock lock(&stream_mutex_);
-    was_full = (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    const int64 queue_size = QueueSizeInternal();
+    was_full = (max_queue_size_ != -1 && queue_size >= max_queue_size_);
     max_queue_size_ = max_queue_size;
-    is_full = (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+    is_full = (max_queue_size_ != -1 && queue_size >= max_queue_size_);
   }
 
   // QueueSizeCallback is called with no mutexes held.
@@ -360,11 +506,15 @@ void InputStreamManager::SetMaxQueueSize(int max_queue_size) {
 }
 
 bool InputStreamManager::IsFull() const {
-  absl::MutexLock lock(&stream_mutex_);
-  return max_queue_size_ != -1 && queue_.size() >= max_queue_size_;
+  absl::MutexLockMaybe lock(lock_free_ ? nullptr : &stream_mutex_);
+  const int max_queue_size = max_queue_size_;
+  return max_queue_size != -1 && QueueSizeInternal() >= max_queue_size;
 }
 
 Timestamp InputStreamManager::GetMinTimestampAmongNLatest(int n) const {
+  CHECK(!lock_free_) << "GetMinTimestampAmongNLatest() isn't supported by "
+                        "the lock-free queue of stream "
+                     << name_;
   absl::MutexLock lock(&stream_mutex_);
   if (queue_.empty()) {
     return Timestamp::Unset();
@@ -377,16 +527,24 @@ void InputStreamManager::ErasePacketsEarlierThan(Timestamp timestamp) {
   {
     absl::MutexLock lock(&stream_mutex_);
     // Checks if queue is full.
+    const int max_queue_size = max_queue_size_;
     bool was_queue_full =
-        (max_queue_size_ != -1 && queue_.size() >= max_queue_size_);
+        (max_queue_size != -1 && QueueSizeInternal() >= max_queue_size);
 
+    if (lock_free_) {
+      for (Packet* head = spsc_queue_.Front();
+           head && head->Timestamp() < timestamp; head = spsc_queue_.Front()) {
+        spsc_queue_.Pop();
+      }
+    }
     while (!queue_.empty() && queue_.front().Timestamp() < timestamp) {
       queue_.pop_front();
     }
 
+    const int64 queue_size = QueueSizeInternal();
     VLOG(3) << "Input stream removed packets:" << name_
-            << " Size:" << queue_.size();
-    queue_became_non_full = (was_queue_full && queue_.size() < max_queue_size_);
+            << " Size:" << queue_size;
+    queue_became_non_full = (was_queue_full && queue_size < max_queue_size);
   }
   if (queue_became_non_full) {
     VLOG(3) << "Queue became non-full: " << Name();
@@ -395,6 +553,11 @@ void InputStreamManager::ErasePacketsEarlierThan(Timestamp timestamp) {
 }
 
 bool InputStreamManager::IsDone() const {
+  if (lock_free_) {
+    // Reads the bound first, see lock_free_.
+    const bool bound_is_done = LockFreeBound() == Timestamp::Done();
+    return bound_is_done && spsc_queue_.Empty();
+  }
   return queue_.empty() && next_timestamp_bound_ == Timestamp::Done();
 }
 
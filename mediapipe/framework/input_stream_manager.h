@@ -15,6 +15,7 @@
 #ifndef MEDIAPIPE_FRAMEWORK_INPUT_STREAM_MANAGER_H_
 #define MEDIAPIPE_FRAMEWORK_INPUT_STREAM_MANAGER_H_
 
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <list>
@@ -27,6 +28,7 @@
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/spsc_queue.h"
 #include "mediapipe/framework/timestamp.h"
 
 namespace mediapipe {
@@ -43,6 +45,15 @@ namespace mediapipe {
 // An input stream is written to by exactly one output stream and is read by a
 // single node. None of its methods should hold a lock when they invoke a
 // callback in the scheduler.
+//
+// By default the packet queue and the timestamp bound are protected by a
+// mutex shared by the producer and the consumer. When the producer's updates
+// (AddPackets(), MovePackets(), SetNextTimestampBound()) are serialized, and
+// so are the consumer's calls, EnableLockFreeQueue() switches the stream to a
+// single-producer/single-consumer queue: the producer then never locks the
+// stream, and the consumer never waits for the producer. The graph enables it
+// automatically for the streams that qualify, see
+// CalculatorNode::InitializeInputStreams().
 class InputStreamManager {
  public:
   // Function type for becomes_full_callback and becomes_not_full_callback.
@@ -63,6 +74,19 @@ class InputStreamManager {
   // Returns the stream name.
   const std::string& Name() const;
 
+  // Switches the stream to a lock-free single-producer/single-consumer packet
+  // queue. Must be called before PrepareForRun(), and only if the producer
+  // calls and the consumer calls are each serialized. In this mode:
+  // * QueueHead() may only be called by the consumer.
+  // * GetMinTimestampAmongNLatest() isn't supported.
+  // * QueueSize() and IsFull() are approximate while packets are in flight,
+  //   so the max_queue_size callbacks may be invoked spuriously. The graph
+  //   re-checks IsFull() in its callbacks.
+  void EnableLockFreeQueue();
+
+  // Returns true if EnableLockFreeQueue() has been called.
+  bool UsesLockFreeQueue() const { return lock_free_; }
+
   // Returns true if the input stream is a back edge.
   bool BackEdge() const { return back_edge_; }
 
@@ -190,6 +214,28 @@ class InputStreamManager {
   // Returns the smallest timestamp at which this stream might see an input.
   Timestamp MinTimestampOrBoundHelper() const;
 
+  // The lock-free counterparts of the functions above, used once
+  // EnableLockFreeQueue() is called.
+  template <typename Container>
+  absl::Status AddOrMovePacketsLockFree(Container container, bool* notify);
+  absl::Status SetNextTimestampBoundLockFree(Timestamp bound, bool* notify);
+
+  // Checks that "packet" can be added to the stream, given the current next
+  // timestamp bound.
+  absl::Status ValidatePacket(const Packet& packet,
+                              Timestamp next_timestamp_bound) const;
+
+  // Returns the number of queued packets. Exact only if called by the
+  // producer or the consumer in lock-free mode.
+  int64 QueueSizeInternal() const;
+
+  // Raises the lock-free next timestamp bound to "bound" if it is lower.
+  // Returns true if the bound was raised.
+  bool RaiseLockFreeBound(Timestamp bound);
+  Timestamp LockFreeBound() const {
+    return Timestamp::CreateNoErrorChecking(lock_free_bound_.load());
+  }
+
   mutable absl::Mutex stream_mutex_;
   std::deque<Packet> queue_ ABSL_GUARDED_BY(stream_mutex_);
   // The number of packets added to queue_.  Used to verify a packet at
@@ -199,7 +245,7 @@ class InputStreamManager {
   // The |timestamp| argument passed to the last SelectAtTimestamp() call.
   // Ignored if enable_timestamps_ is false.
   Timestamp last_select_timestamp_ ABSL_GUARDED_BY(stream_mutex_);
-  bool closed_ ABSL_GUARDED_BY(stream_mutex_);
+  std::atomic<bool> closed_;
   // True if packet timestamps are used.
   bool enable_timestamps_ = true;
   std::string name_;
@@ -209,7 +255,19 @@ class InputStreamManager {
   Packet header_;
 
   // The maximum queue size for this stream if set.
-  int max_queue_size_ ABSL_GUARDED_BY(stream_mutex_) = -1;
+  std::atomic<int> max_queue_size_{-1};
+
+  // True if EnableLockFreeQueue() has been called. Then the producer uses
+  // spsc_queue_ and lock_free_bound_ in place of queue_ and
+  // next_timestamp_bound_, and never locks stream_mutex_. The consumer still
+  // locks it to serialize itself with Close() and SetMaxQueueSize(). The
+  // producer pushes packets before raising the bound, and the consumer reads
+  // the bound before looking at the queue, so that it never takes a packet
+  // that is still being pushed for a settled timestamp.
+  bool lock_free_ = false;
+  mutable SpscQueue<Packet> spsc_queue_;
+  // The next timestamp bound as the value of a Timestamp.
+  std::atomic<int64> lock_free_bound_;
 
   // Callback to notify the framework that we have hit the maximum queue size.
   QueueSizeCallback becomes_full_callback_;
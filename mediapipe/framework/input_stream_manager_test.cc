@@ -15,6 +15,7 @@
 #include "mediapipe/framework/input_stream_manager.h"
 
 #include <memory>
+#include <thread>  // NOLINT(build/c++11)
 
 #include "absl/memory/memory.h"
 #include "mediapipe/framework/input_stream_shard.h"
@@ -26,7 +27,9 @@
 
 namespace mediapipe {
 namespace {
-class InputStreamManagerTest : public ::testing::Test {
+// The parameter selects the lock-free queue, which must behave the same as the
+// default queue for a single producer and consumer.
+class InputStreamManagerTest : public ::testing::TestWithParam<bool> {
  protected:
   InputStreamManagerTest() {}
 
@@ -44,6 +47,9 @@ class InputStreamManagerTest : public ::testing::Test {
     input_stream_manager_ = absl::make_unique<InputStreamManager>();
     MP_ASSERT_OK(input_stream_manager_->Initialize("a_test", &packet_type_,
                                                    /*back_edge=*/false));
+    if (GetParam()) {
+      input_stream_manager_->EnableLockFreeQueue();
+    }
 
     queue_full_callback_ =
         std::bind(&InputStreamManagerTest::ReportQueueBecomesFull, this,
@@ -89,9 +95,9 @@ class InputStreamManagerTest : public ::testing::Test {
   int queue_becomes_not_full_count_;
 };
 
-TEST_F(InputStreamManagerTest, Init) {}
+TEST_P(InputStreamManagerTest, Init) {}
 
-TEST_F(InputStreamManagerTest, AddPackets) {
+TEST_P(InputStreamManagerTest, AddPackets) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -108,7 +114,7 @@ TEST_F(InputStreamManagerTest, AddPackets) {
   }
 }
 
-TEST_F(InputStreamManagerTest, MovePackets) {
+TEST_P(InputStreamManagerTest, MovePackets) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -128,7 +134,7 @@ TEST_F(InputStreamManagerTest, MovePackets) {
 // InputStreamManager should reject the four timestamps that are not allowed in
 // a stream: Timestamp::Unset(), Timestamp::Unstarted(),
 // Timestamp::OneOverPostStream(), and Timestamp::Done().
-TEST_F(InputStreamManagerTest, AddPacketUnset) {
+TEST_P(InputStreamManagerTest, AddPacketUnset) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp::Unset()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -139,7 +145,7 @@ TEST_F(InputStreamManagerTest, AddPacketUnset) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, AddPacketUnstarted) {
+TEST_P(InputStreamManagerTest, AddPacketUnstarted) {
   std::list<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::Unstarted()));
@@ -151,7 +157,7 @@ TEST_F(InputStreamManagerTest, AddPacketUnstarted) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, AddPacketOneOverPostStream) {
+TEST_P(InputStreamManagerTest, AddPacketOneOverPostStream) {
   std::list<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::OneOverPostStream()));
@@ -164,7 +170,7 @@ TEST_F(InputStreamManagerTest, AddPacketOneOverPostStream) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, AddPacketDone) {
+TEST_P(InputStreamManagerTest, AddPacketDone) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp::Done()));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -175,7 +181,7 @@ TEST_F(InputStreamManagerTest, AddPacketDone) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, AddPacketsOnlyPreStream) {
+TEST_P(InputStreamManagerTest, AddPacketsOnlyPreStream) {
   std::list<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::PreStream()));
@@ -189,7 +195,7 @@ TEST_F(InputStreamManagerTest, AddPacketsOnlyPreStream) {
 
 // An attempt to add a packet after Timestamp::PreStream() should be rejected
 // because the next timestamp bound is Timestamp::OneOverPostStream().
-TEST_F(InputStreamManagerTest, AddPacketsAfterPreStream) {
+TEST_P(InputStreamManagerTest, AddPacketsAfterPreStream) {
   std::list<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::PreStream()));
@@ -203,7 +209,7 @@ TEST_F(InputStreamManagerTest, AddPacketsAfterPreStream) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, AddPacketsOnlyPostStream) {
+TEST_P(InputStreamManagerTest, AddPacketsOnlyPostStream) {
   std::list<Packet> packets;
   packets.push_back(
       MakePacket<std::string>("packet 1").At(Timestamp::PostStream()));
@@ -217,7 +223,7 @@ TEST_F(InputStreamManagerTest, AddPacketsOnlyPostStream) {
 
 // A packet at Timestamp::PostStream() must be the only Packet in an input
 // stream.
-TEST_F(InputStreamManagerTest, AddPacketsBeforePostStream) {
+TEST_P(InputStreamManagerTest, AddPacketsBeforePostStream) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(
@@ -230,7 +236,7 @@ TEST_F(InputStreamManagerTest, AddPacketsBeforePostStream) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, AddPacketsReverseTimestamps) {
+TEST_P(InputStreamManagerTest, AddPacketsReverseTimestamps) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(20)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(10)));
@@ -245,7 +251,7 @@ TEST_F(InputStreamManagerTest, AddPacketsReverseTimestamps) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, PopPacketAtTimestamp) {
+TEST_P(InputStreamManagerTest, PopPacketAtTimestamp) {
   std::string expected_value_at_10("packet 1");
   std::string expected_value_at_20("packet 2");
   std::string expected_value_at_30("packet 3");
@@ -329,7 +335,7 @@ TEST_F(InputStreamManagerTest, PopPacketAtTimestamp) {
   EXPECT_TRUE(stream_is_done_);
 }
 
-TEST_F(InputStreamManagerTest, PopQueueHead) {
+TEST_P(InputStreamManagerTest, PopQueueHead) {
   input_stream_manager_->DisableTimestamps();
   std::string expected_value_at_10("packet 1");
   std::string expected_value_at_20("packet 2");
@@ -393,7 +399,7 @@ TEST_F(InputStreamManagerTest, PopQueueHead) {
   EXPECT_TRUE(stream_is_done_);
 }
 
-TEST_F(InputStreamManagerTest, BadPacketType) {
+TEST_P(InputStreamManagerTest, BadPacketType) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<int>(10).At(Timestamp(10)));
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
@@ -404,7 +410,7 @@ TEST_F(InputStreamManagerTest, BadPacketType) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, Close) {
+TEST_P(InputStreamManagerTest, Close) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -427,7 +433,7 @@ TEST_F(InputStreamManagerTest, Close) {
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
 }
 
-TEST_F(InputStreamManagerTest, ReuseInputStreamManager) {
+TEST_P(InputStreamManagerTest, ReuseInputStreamManager) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -480,7 +486,7 @@ TEST_F(InputStreamManagerTest, ReuseInputStreamManager) {
   EXPECT_TRUE(input_stream_manager_->IsEmpty());
 }
 
-TEST_F(InputStreamManagerTest, MultipleNotifications) {
+TEST_P(InputStreamManagerTest, MultipleNotifications) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -516,7 +522,7 @@ TEST_F(InputStreamManagerTest, MultipleNotifications) {
   EXPECT_TRUE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, SetHeader) {
+TEST_P(InputStreamManagerTest, SetHeader) {
   Packet header = MakePacket<std::string>("blah");
   MP_ASSERT_OK(input_stream_manager_->SetHeader(header));
 
@@ -525,7 +531,7 @@ TEST_F(InputStreamManagerTest, SetHeader) {
   EXPECT_EQ(header.Timestamp(), input_stream_manager_->Header().Timestamp());
 }
 
-TEST_F(InputStreamManagerTest, BackwardsInTime) {
+TEST_P(InputStreamManagerTest, BackwardsInTime) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -592,7 +598,7 @@ TEST_F(InputStreamManagerTest, BackwardsInTime) {
   EXPECT_FALSE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, SelectBackwardsInTime) {
+TEST_P(InputStreamManagerTest, SelectBackwardsInTime) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -636,7 +642,7 @@ TEST_F(InputStreamManagerTest, SelectBackwardsInTime) {
                "");
 }
 
-TEST_F(InputStreamManagerTest, TimestampBound) {
+TEST_P(InputStreamManagerTest, TimestampBound) {
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
   packets.push_back(MakePacket<std::string>("packet 2").At(Timestamp(20)));
@@ -746,7 +752,7 @@ TEST_F(InputStreamManagerTest, TimestampBound) {
             input_stream_manager_->MinTimestampOrBound(&is_empty));
 }
 
-TEST_F(InputStreamManagerTest, QueueSizeTest) {
+TEST_P(InputStreamManagerTest, QueueSizeTest) {
   std::list<Packet> packets;
   int max_queue_size = 2;
   input_stream_manager_->SetMaxQueueSize(max_queue_size);
@@ -781,7 +787,7 @@ TEST_F(InputStreamManagerTest, QueueSizeTest) {
   expected_queue_becomes_not_full_count_ = 1;
 }
 
-TEST_F(InputStreamManagerTest, InputReleaseTest) {
+TEST_P(InputStreamManagerTest, InputReleaseTest) {
   packet_type_.Set<LifetimeTracker::Object>();
   input_stream_manager_ = absl::make_unique<InputStreamManager>();
   MP_ASSERT_OK(input_stream_manager_->Initialize("a_test", &packet_type_,
@@ -831,7 +837,7 @@ TEST_F(InputStreamManagerTest, InputReleaseTest) {
 
 // An attempt to add a packet after Timestamp::PreStream() should be allowed
 // if packet timestamps don't need to be increasing.
-TEST_F(InputStreamManagerTest, AddPacketsAfterPreStreamUntimed) {
+TEST_P(InputStreamManagerTest, AddPacketsAfterPreStreamUntimed) {
   input_stream_manager_->DisableTimestamps();
   std::list<Packet> packets;
   packets.push_back(
@@ -847,7 +853,7 @@ TEST_F(InputStreamManagerTest, AddPacketsAfterPreStreamUntimed) {
 
 // A packet at Timestamp::PostStream() doesn't need to be the only Packet in
 // an input stream if packet timestamps don't need to be increasing.
-TEST_F(InputStreamManagerTest, AddPacketsBeforePostStreamUntimed) {
+TEST_P(InputStreamManagerTest, AddPacketsBeforePostStreamUntimed) {
   input_stream_manager_->DisableTimestamps();
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
@@ -861,7 +867,7 @@ TEST_F(InputStreamManagerTest, AddPacketsBeforePostStreamUntimed) {
   EXPECT_TRUE(notify_);
 }
 
-TEST_F(InputStreamManagerTest, BackwardsInTimeUntimed) {
+TEST_P(InputStreamManagerTest, BackwardsInTimeUntimed) {
   input_stream_manager_->DisableTimestamps();
   std::list<Packet> packets;
   packets.push_back(MakePacket<std::string>("packet 1").At(Timestamp(10)));
@@ -922,5 +928,54 @@ TEST_F(InputStreamManagerTest, BackwardsInTimeUntimed) {
   EXPECT_TRUE(notify_);
 }
 
+// A producer thread and a consumer thread exchanging packets the way a
+// calculator node and its downstream node do.
+TEST_P(InputStreamManagerTest, ConcurrentProducerAndConsumer) {
+  constexpr int kNumPackets = 10000;
+  input_stream_manager_->SetMaxQueueSize(-1);
+  std::thread producer([this]() {
+    for (int i = 0; i < kNumPackets; ++i) {
+      bool notify = false;
+      std::list<Packet> packets;
+      packets.push_back(MakePacket<std::string>("packet").At(Timestamp(2 * i)));
+      MP_ASSERT_OK(input_stream_manager_->MovePackets(&packets, &notify));
+      // Advances the bound past the gap between the packets.
+      MP_ASSERT_OK(input_stream_manager_->SetNextTimestampBound(
+          Timestamp(2 * i + 2), &notify));
+    }
+    input_stream_manager_->SetNextTimestampBound(Timestamp::Done(), &notify_)
+        .IgnoreError();
+  });
+
+  int num_received = 0;
+  Timestamp last_timestamp = Timestamp::Unstarted();
+  bool stream_is_done = false;
+  while (!stream_is_done) {
+    bool is_empty = false;
+    const Timestamp bound =
+        input_stream_manager_->MinTimestampOrBound(&is_empty);
+    if (is_empty) {
+      if (bound == Timestamp::Done()) {
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    int num_packets_dropped = 0;
+    Packet packet = input_stream_manager_->PopPacketAtTimestamp(
+        bound, &num_packets_dropped, &stream_is_done);
+    ASSERT_EQ(num_packets_dropped, 0);
+    ASSERT_FALSE(packet.IsEmpty());
+    ASSERT_GT(packet.Timestamp(), last_timestamp);
+    last_timestamp = packet.Timestamp();
+    ++num_received;
+  }
+  producer.join();
+  EXPECT_EQ(num_received, kNumPackets);
+  EXPECT_TRUE(input_stream_manager_->IsEmpty());
+}
+
+INSTANTIATE_TEST_SUITE_P(LockFree, InputStreamManagerTest, ::testing::Bool());
+
 }  // namespace
 }  // namespace mediapipe
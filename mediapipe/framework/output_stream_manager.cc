@@ -201,7 +201,7 @@ void OutputStreamManager::PropagateUpdatesToMirrors(
     }
   }
   // Clear out the packets.
-  packets_to_propagate->clear();
+  output_stream_shard->ClearOutputQueue();
 }
 
 void OutputStreamManager::ResetShard(OutputStreamShard* output_stream_shard) {
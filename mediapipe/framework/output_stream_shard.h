@@ -108,6 +108,10 @@ class OutputStreamShard : public OutputStream {
   std::list<Packet>* OutputQueue() { return &output_queue_; }
   const std::list<Packet>* OutputQueue() const { return &output_queue_; }
 
+  // Removes the packets from the output queue, keeping the list nodes for
+  // reuse.
+  void ClearOutputQueue();
+
   // Resets data members.
   void Reset(Timestamp next_timestamp_bound, bool close);
 
@@ -115,6 +119,10 @@ class OutputStreamShard : public OutputStream {
   // stream manager.
   OutputStreamSpec* output_stream_spec_;
   std::list<Packet> output_queue_;
+  // List nodes released by ClearOutputQueue(), reused by AddPacketInternal()
+  // so that a calculator outputting the same number of packets for every
+  // timestamp doesn't allocate list nodes in steady state.
+  std::list<Packet> spare_nodes_;
   bool closed_;
   Timestamp next_timestamp_bound_;
   // Equal to next_timestamp_bound_ only if the bound has been explicitly set
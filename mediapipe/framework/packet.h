@@ -29,6 +29,7 @@
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/deps/no_destructor.h"
 #include "mediapipe/framework/deps/registration.h"
+#include "mediapipe/framework/deps/slab_allocator.h"
 #include "mediapipe/framework/port.h"
 #include "mediapipe/framework/port/canonical_errors.h"
 #include "mediapipe/framework/port/logging.h"
@@ -787,16 +788,33 @@ absl::Status Packet::ValidateAsType() const {
 
 inline Timestamp Packet::Timestamp() const { return timestamp_; }
 
+namespace packet_internal {
+
+// Allocates a holder and its shared_ptr control block as a single block taken
+// from the per-thread slab caches. Holders are created and released for every
+// packet, so this keeps them off the general purpose heap in steady state.
+template <typename H, typename... Args>
+std::shared_ptr<H> AllocateHolder(Args&&... args) {
+  return std::allocate_shared<H>(SlabAllocator<H>(),
+                                 std::forward<Args>(args)...);
+}
+
+}  // namespace packet_internal
+
 template <typename T>
 Packet Adopt(const T* ptr) {
   CHECK(ptr != nullptr);
-  return packet_internal::Create(new packet_internal::Holder<T>(ptr));
+  return packet_internal::Create(
+      packet_internal::AllocateHolder<packet_internal::Holder<T>>(ptr),
+      Timestamp::Unset());
 }
 
 template <typename T>
 Packet PointToForeign(const T* ptr) {
   CHECK(ptr != nullptr);
-  return packet_internal::Create(new packet_internal::ForeignHolder<T>(ptr));
+  return packet_internal::Create(
+      packet_internal::AllocateHolder<packet_internal::ForeignHolder<T>>(ptr),
+      Timestamp::Unset());
 }
 
 // Equal Packets refer to the same memory contents, like equal pointers.
@@ -0,0 +1,340 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/reporter/critical_path.h"
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+
+namespace mediapipe {
+namespace {
+
+using reporter::CriticalPathAnalyzer;
+using reporter::CriticalPathEdgeData;
+using reporter::CriticalPathNodeData;
+using reporter::CriticalPathReport;
+using reporter::Percentiles;
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+
+// A diamond graph: A feeds B and C, which both feed D. At timestamp 0 the
+// path through B is critical, at timestamp 1 the path through C is. The
+// second timestamp is recorded in a separate GraphTrace with other bases.
+constexpr char kDiamondProfile[] = R"pb(
+  graph_trace {
+    base_time: 1000
+    base_timestamp: 0
+    calculator_name: [ "A", "B", "C", "D" ]
+    stream_name: [ "in", "ab", "ac", "bd", "cd" ]
+    calculator_trace {
+      node_id: -1
+      input_timestamp: 0
+      event_type: PROCESS
+      finish_time: 5
+      output_trace { packet_timestamp: 0 stream_id: 0 }
+    }
+    calculator_trace {
+      node_id: 0
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 10
+      finish_time: 20
+      input_trace {
+        start_time: 5
+        finish_time: 10
+        packet_timestamp: 0
+        stream_id: 0
+      }
+      output_trace { packet_timestamp: 0 stream_id: 1 }
+      output_trace { packet_timestamp: 0 stream_id: 2 }
+    }
+    calculator_trace {
+      node_id: 1
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 22
+      finish_time: 52
+      input_trace {
+        start_time: 20
+        finish_time: 22
+        packet_timestamp: 0
+        stream_id: 1
+      }
+      output_trace { packet_timestamp: 0 stream_id: 3 }
+    }
+    calculator_trace {
+      node_id: 2
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 30
+      finish_time: 40
+      input_trace {
+        start_time: 20
+        finish_time: 30
+        packet_timestamp: 0
+        stream_id: 2
+      }
+      output_trace { packet_timestamp: 0 stream_id: 4 }
+    }
+    calculator_trace {
+      node_id: 3
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 55
+      finish_time: 60
+      input_trace {
+        start_time: 52
+        finish_time: 55
+        packet_timestamp: 0
+        stream_id: 3
+      }
+      input_trace {
+        start_time: 40
+        finish_time: 55
+        packet_timestamp: 0
+        stream_id: 4
+      }
+    }
+  }
+  graph_trace {
+    base_time: 2000
+    base_timestamp: 1
+    calculator_name: [ "A", "B", "C", "D" ]
+    stream_name: [ "in", "ab", "ac", "bd", "cd" ]
+    calculator_trace {
+      node_id: 0
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 0
+      finish_time: 10
+      input_trace { finish_time: 0 packet_timestamp: 0 stream_id: 0 }
+      output_trace { packet_timestamp: 0 stream_id: 1 }
+      output_trace { packet_timestamp: 0 stream_id: 2 }
+    }
+    calculator_trace {
+      node_id: 1
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 10
+      finish_time: 15
+      input_trace {
+        start_time: 10
+        finish_time: 10
+        packet_timestamp: 0
+        stream_id: 1
+      }
+      output_trace { packet_timestamp: 0 stream_id: 3 }
+    }
+    calculator_trace {
+      node_id: 2
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 12
+      finish_time: 40
+      input_trace {
+        start_time: 10
+        finish_time: 12
+        packet_timestamp: 0
+        stream_id: 2
+      }
+      output_trace { packet_timestamp: 0 stream_id: 4 }
+    }
+    calculator_trace {
+      node_id: 3
+      input_timestamp: 0
+      event_type: PROCESS
+      start_time: 40
+      finish_time: 45
+      input_trace {
+        start_time: 15
+        finish_time: 40
+        packet_timestamp: 0
+        stream_id: 3
+      }
+      input_trace {
+        start_time: 40
+        finish_time: 40
+        packet_timestamp: 0
+        stream_id: 4
+      }
+    }
+  }
+)pb";
+
+const CriticalPathNodeData* FindNode(const CriticalPathReport& report,
+                                     const std::string& name) {
+  for (const auto& node : report.nodes) {
+    if (node.name == name) return &node;
+  }
+  return nullptr;
+}
+
+const CriticalPathEdgeData* FindEdge(const CriticalPathReport& report,
+                                     const std::string& stream) {
+  for (const auto& edge : report.edges) {
+    if (edge.stream == stream) return &edge;
+  }
+  return nullptr;
+}
+
+TEST(CriticalPathTest, Percentiles) {
+  std::vector<int64_t> values;
+  for (int i = 100; i > 0; --i) {
+    values.push_back(i);
+  }
+  Percentiles p = Percentiles::Of(values);
+  EXPECT_EQ(p.count, 100);
+  EXPECT_EQ(p.p50, 50);
+  EXPECT_EQ(p.p90, 90);
+  EXPECT_EQ(p.p99, 99);
+  EXPECT_EQ(p.max, 100);
+
+  p = Percentiles::Of({7});
+  EXPECT_EQ(p.p50, 7);
+  EXPECT_EQ(p.p99, 7);
+  EXPECT_EQ(Percentiles::Of({}).count, 0);
+}
+
+TEST(CriticalPathTest, DiamondGraph) {
+  CriticalPathAnalyzer analyzer;
+  analyzer.Accumulate(ParseTextProtoOrDie<GraphProfile>(kDiamondProfile));
+  CriticalPathReport report = analyzer.Analyze();
+
+  ASSERT_EQ(report.timestamps.size(), 2);
+  EXPECT_EQ(report.timestamps[0].timestamp, 0);
+  EXPECT_THAT(report.timestamps[0].path, ElementsAre("A", "B", "D"));
+  EXPECT_EQ(report.timestamps[0].latency, 55);
+  EXPECT_EQ(report.timestamps[1].timestamp, 1);
+  EXPECT_THAT(report.timestamps[1].path, ElementsAre("A", "C", "D"));
+  EXPECT_EQ(report.timestamps[1].latency, 45);
+  EXPECT_EQ(report.latency.p50, 45);
+  EXPECT_EQ(report.latency.max, 55);
+  EXPECT_EQ(report.path_counts.size(), 2);
+
+  // B spends 32us on the critical path at timestamp 0, C 30us at timestamp 1.
+  ASSERT_EQ(report.nodes.size(), 4);
+  EXPECT_EQ(report.nodes[0].name, "B");
+  EXPECT_EQ(report.nodes[0].critical_time, 32);
+  const CriticalPathNodeData* a = FindNode(report, "A");
+  ASSERT_NE(a, nullptr);
+  EXPECT_EQ(a->timestamp_count, 2);
+  EXPECT_EQ(a->critical_count, 2);
+  EXPECT_EQ(a->compute_time.max, 10);
+  // The input packet arrival is unknown at timestamp 1.
+  EXPECT_EQ(a->queueing_time.p50, 0);
+  EXPECT_EQ(a->queueing_time.max, 5);
+  const CriticalPathNodeData* c = FindNode(report, "C");
+  ASSERT_NE(c, nullptr);
+  EXPECT_EQ(c->critical_count, 1);
+  EXPECT_EQ(c->compute_time.p50, 10);
+  EXPECT_EQ(c->compute_time.max, 28);
+  EXPECT_EQ(c->queueing_time.max, 10);
+
+  ASSERT_EQ(report.edges.size(), 4);
+  const CriticalPathEdgeData* bd = FindEdge(report, "bd");
+  ASSERT_NE(bd, nullptr);
+  EXPECT_EQ(bd->producer, "B");
+  EXPECT_EQ(bd->consumer, "D");
+  EXPECT_EQ(bd->packet_count, 2);
+  EXPECT_EQ(bd->critical_count, 1);
+  EXPECT_EQ(bd->slack.p50, 0);
+  EXPECT_EQ(bd->slack.max, 25);
+  const CriticalPathEdgeData* cd = FindEdge(report, "cd");
+  ASSERT_NE(cd, nullptr);
+  EXPECT_EQ(cd->slack.p50, 0);
+  EXPECT_EQ(cd->slack.max, 12);
+
+  std::ostringstream output;
+  report.Print(output);
+  EXPECT_THAT(output.str(), HasSubstr("50.00% A -> B -> D"));
+  EXPECT_THAT(output.str(), HasSubstr("B -> D (bd)"));
+}
+
+TEST(CriticalPathTest, JoinsSplitCalls) {
+  // The Process() call of A starts in one graph trace and finishes in the
+  // next one.
+  CriticalPathAnalyzer analyzer;
+  analyzer.Accumulate(ParseTextProtoOrDie<GraphProfile>(R"pb(
+    graph_trace {
+      base_time: 100
+      calculator_name: "A"
+      calculator_trace {
+        node_id: 0
+        input_timestamp: 7
+        event_type: PROCESS
+        start_time: 0
+      }
+    }
+    graph_trace {
+      base_time: 200
+      calculator_name: "A"
+      calculator_trace {
+        node_id: 0
+        input_timestamp: 7
+        event_type: PROCESS
+        finish_time: 30
+      }
+    }
+  )pb"));
+  CriticalPathReport report = analyzer.Analyze();
+  ASSERT_EQ(report.timestamps.size(), 1);
+  EXPECT_EQ(report.timestamps[0].timestamp, 7);
+  EXPECT_EQ(report.timestamps[0].latency, 130);
+  ASSERT_EQ(report.nodes.size(), 1);
+  EXPECT_EQ(report.nodes[0].compute_time.max, 130);
+}
+
+TEST(CriticalPathTest, JoinsSplitCallsAtLatestFinishTime) {
+  // Both parts of the Process() call of A record a finish time, the call ends
+  // at the later one.
+  CriticalPathAnalyzer analyzer;
+  analyzer.Accumulate(ParseTextProtoOrDie<GraphProfile>(R"pb(
+    graph_trace {
+      base_time: 100
+      calculator_name: "A"
+      calculator_trace {
+        node_id: 0
+        input_timestamp: 7
+        event_type: PROCESS
+        start_time: 0
+        finish_time: 10
+      }
+    }
+    graph_trace {
+      base_time: 200
+      calculator_name: "A"
+      calculator_trace {
+        node_id: 0
+        input_timestamp: 7
+        event_type: PROCESS
+        start_time: 5
+        finish_time: 30
+      }
+    }
+  )pb"));
+  CriticalPathReport report = analyzer.Analyze();
+  ASSERT_EQ(report.timestamps.size(), 1);
+  EXPECT_EQ(report.timestamps[0].latency, 130);
+  ASSERT_EQ(report.nodes.size(), 1);
+  EXPECT_EQ(report.nodes[0].compute_time.max, 130);
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,288 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/graph_metrics_exporter.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+
+namespace mediapipe {
+
+namespace {
+
+// Escapes a label value as required by the OpenMetrics text format.
+std::string EscapeLabelValue(absl::string_view value) {
+  std::string result;
+  result.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        result += "\\\\";
+        break;
+      case '"':
+        result += "\\\"";
+        break;
+      case '\n':
+        result += "\\n";
+        break;
+      default:
+        result += c;
+    }
+  }
+  return result;
+}
+
+std::string CalculatorLabels(absl::string_view calculator) {
+  return absl::StrCat("calculator=\"", EscapeLabelValue(calculator), "\"");
+}
+
+std::string StreamLabels(absl::string_view calculator,
+                         absl::string_view stream) {
+  return absl::StrCat(CalculatorLabels(calculator), ",stream=\"",
+                      EscapeLabelValue(stream), "\"");
+}
+
+// Appends the TYPE, UNIT and HELP lines of a metric family.
+void AppendMetadata(absl::string_view name, absl::string_view type,
+                    absl::string_view unit, absl::string_view help,
+                    std::string* out) {
+  absl::StrAppend(out, "# TYPE ", name, " ", type, "\n");
+  if (!unit.empty()) {
+    absl::StrAppend(out, "# UNIT ", name, " ", unit, "\n");
+  }
+  absl::StrAppend(out, "# HELP ", name, " ", help, "\n");
+}
+
+// Appends the samples of a TimeHistogram. Each histogram interval is closed
+// on the lower end, so a sample equal to an upper bound is counted in the
+// next bucket.
+void AppendHistogram(absl::string_view name, absl::string_view labels,
+                     const TimeHistogram& histogram, std::string* out) {
+  int64 cumulative_count = 0;
+  for (int i = 0; i < histogram.count_size(); ++i) {
+    cumulative_count += histogram.count(i);
+    if (i + 1 < histogram.count_size()) {
+      absl::StrAppend(out, name, "_bucket{", labels, ",le=\"",
+                      (i + 1) * histogram.interval_size_usec(), ".0\"} ",
+                      cumulative_count, "\n");
+    }
+  }
+  absl::StrAppend(out, name, "_bucket{", labels, ",le=\"+Inf\"} ",
+                  cumulative_count, "\n");
+  absl::StrAppend(out, name, "_count{", labels, "} ", cumulative_count, "\n");
+  absl::StrAppend(out, name, "_sum{", labels, "} ", histogram.total(), "\n");
+}
+
+// Appends a histogram family with one histogram per calculator, skipping the
+// calculators that don't have it.
+void AppendCalculatorHistograms(
+    absl::string_view name, absl::string_view help,
+    const std::vector<CalculatorProfile>& profiles,
+    bool (CalculatorProfile::*has_histogram)() const,
+    const TimeHistogram& (CalculatorProfile::*histogram)() const,
+    std::string* out) {
+  bool has_any = false;
+  for (const CalculatorProfile& profile : profiles) {
+    has_any |= (profile.*has_histogram)();
+  }
+  if (!has_any) {
+    return;
+  }
+  AppendMetadata(name, "histogram", "microseconds", help, out);
+  for (const CalculatorProfile& profile : profiles) {
+    if ((profile.*has_histogram)()) {
+      AppendHistogram(name, CalculatorLabels(profile.name()),
+                      (profile.*histogram)(), out);
+    }
+  }
+}
+
+}  // namespace
+
+GraphMetricsExporter::GraphMetricsExporter(CalculatorGraph* graph)
+    : graph_(graph) {}
+
+GraphMetricsExporter::~GraphMetricsExporter() { StopPeriodicExport(); }
+
+absl::StatusOr<std::string> GraphMetricsExporter::GetSnapshot() const {
+  std::vector<CalculatorProfile> profiles;
+  MP_RETURN_IF_ERROR(graph_->profiler()->GetCalculatorProfiles(&profiles));
+  return FormatSnapshot(profiles, graph_->GetInputStreamQueueStats());
+}
+
+absl::Status GraphMetricsExporter::StartPeriodicExport(
+    absl::Duration interval, SnapshotCallback callback) {
+  RET_CHECK(interval > absl::ZeroDuration())
+      << "The export interval must be positive.";
+  RET_CHECK(callback) << "The export callback must be set.";
+  RET_CHECK(!export_thread_) << "The periodic export is already running.";
+  {
+    absl::MutexLock lock(&mutex_);
+    stop_ = false;
+  }
+  export_thread_ = absl::make_unique<std::thread>(
+      &GraphMetricsExporter::ExportLoop, this, interval, std::move(callback));
+  return absl::OkStatus();
+}
+
+void GraphMetricsExporter::StopPeriodicExport() {
+  if (!export_thread_) {
+    return;
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    stop_ = true;
+  }
+  export_thread_->join();
+  export_thread_.reset();
+}
+
+void GraphMetricsExporter::ExportLoop(absl::Duration interval,
+                                      SnapshotCallback callback) {
+  while (true) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (mutex_.AwaitWithTimeout(absl::Condition(&stop_), interval)) {
+        return;
+      }
+    }
+    absl::StatusOr<std::string> snapshot = GetSnapshot();
+    if (!snapshot.ok()) {
+      LOG(WARNING) << "Failed to export graph metrics: " << snapshot.status();
+      continue;
+    }
+    callback(*snapshot);
+  }
+}
+
+std::string GraphMetricsExporter::FormatSnapshot(
+    const std::vector<CalculatorProfile>& profiles,
+    const std::vector<CalculatorGraph::InputStreamQueueStats>& queue_stats) {
+  // Sorts the calculators so that successive snapshots list them in the same
+  // order.
+  std::vector<CalculatorProfile> sorted_profiles = profiles;
+  std::sort(sorted_profiles.begin(), sorted_profiles.end(),
+            [](const CalculatorProfile& a, const CalculatorProfile& b) {
+              return a.name() < b.name();
+            });
+
+  std::string out;
+  AppendCalculatorHistograms(
+      "mediapipe_calculator_process_runtime_microseconds",
+      "Time spent in Process().", sorted_profiles,
+      &CalculatorProfile::has_process_runtime,
+      &CalculatorProfile::process_runtime, &out);
+  AppendCalculatorHistograms(
+      "mediapipe_calculator_process_input_latency_microseconds",
+      "Time from the start of the graph to the start of Process().",
+      sorted_profiles, &CalculatorProfile::has_process_input_latency,
+      &CalculatorProfile::process_input_latency, &out);
+  AppendCalculatorHistograms(
+      "mediapipe_calculator_process_output_latency_microseconds",
+      "Time from the start of the graph to the end of Process().",
+      sorted_profiles, &CalculatorProfile::has_process_output_latency,
+      &CalculatorProfile::process_output_latency, &out);
+
+  bool has_stream_latency = false;
+  for (const CalculatorProfile& profile : sorted_profiles) {
+    for (const StreamProfile& stream : profile.input_stream_profiles()) {
+      has_stream_latency |= !stream.back_edge() && stream.has_latency();
+    }
+  }
+  if (has_stream_latency) {
+    const char kName[] = "mediapipe_input_stream_latency_microseconds";
+    AppendMetadata(kName, "histogram", "microseconds",
+                   "Time from the production to the consumption of a packet.",
+                   &out);
+    for (const CalculatorProfile& profile : sorted_profiles) {
+      for (const StreamProfile& stream : profile.input_stream_profiles()) {
+        if (!stream.back_edge() && stream.has_latency()) {
+          AppendHistogram(kName, StreamLabels(profile.name(), stream.name()),
+                          stream.latency(), &out);
+        }
+      }
+    }
+  }
+
+  if (!sorted_profiles.empty()) {
+    const char kOpenName[] = "mediapipe_calculator_open_runtime_microseconds";
+    AppendMetadata(kOpenName, "gauge", "microseconds", "Time spent in Open().",
+                   &out);
+    for (const CalculatorProfile& profile : sorted_profiles) {
+      absl::StrAppend(&out, kOpenName, "{", CalculatorLabels(profile.name()),
+                      "} ", profile.open_runtime(), "\n");
+    }
+    const char kCloseName[] = "mediapipe_calculator_close_runtime_microseconds";
+    AppendMetadata(kCloseName, "gauge", "microseconds",
+                   "Time spent in Close().", &out);
+    for (const CalculatorProfile& profile : sorted_profiles) {
+      absl::StrAppend(&out, kCloseName, "{", CalculatorLabels(profile.name()),
+                      "} ", profile.close_runtime(), "\n");
+    }
+  }
+
+  if (!queue_stats.empty()) {
+    const char kQueueName[] = "mediapipe_input_stream_queue_size";
+    AppendMetadata(kQueueName, "gauge", "",
+                   "Number of packets waiting in the input stream queue.",
+                   &out);
+    for (const auto& stats : queue_stats) {
+      absl::StrAppend(&out, kQueueName, "{",
+                      StreamLabels(stats.node_name, stats.stream_name), "} ",
+                      stats.queue_size, "\n");
+    }
+    const char kMaxQueueName[] = "mediapipe_input_stream_max_queue_size";
+    AppendMetadata(kMaxQueueName, "gauge", "",
+                   "Queue size at which the input stream throttles its "
+                   "sources, or -1 if unlimited.",
+                   &out);
+    for (const auto& stats : queue_stats) {
+      absl::StrAppend(&out, kMaxQueueName, "{",
+                      StreamLabels(stats.node_name, stats.stream_name), "} ",
+                      stats.max_queue_size, "\n");
+    }
+    const char kThrottledName[] = "mediapipe_input_stream_throttled";
+    AppendMetadata(kThrottledName, "counter", "",
+                   "Number of times the input stream queue became full and "
+                   "throttled its sources.",
+                   &out);
+    for (const auto& stats : queue_stats) {
+      absl::StrAppend(&out, kThrottledName, "_total{",
+                      StreamLabels(stats.node_name, stats.stream_name), "} ",
+                      stats.num_throttled, "\n");
+    }
+    const char kGrownName[] = "mediapipe_input_stream_max_queue_size_grown";
+    AppendMetadata(kGrownName, "counter", "",
+                   "Number of times max_queue_size was grown to resolve a "
+                   "throttling deadlock.",
+                   &out);
+    for (const auto& stats : queue_stats) {
+      absl::StrAppend(&out, kGrownName, "_total{",
+                      StreamLabels(stats.node_name, stats.stream_name), "} ",
+                      stats.num_max_queue_size_grown, "\n");
+    }
+  }
+
+  absl::StrAppend(&out, "# EOF\n");
+  return out;
+}
+
+}  // namespace mediapipe
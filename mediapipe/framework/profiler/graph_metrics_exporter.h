@@ -0,0 +1,106 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_METRICS_EXPORTER_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_METRICS_EXPORTER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_graph.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/port/statusor.h"
+
+namespace mediapipe {
+
+// Exports the statistics of a running CalculatorGraph as an OpenMetrics text
+// snapshot, which monitoring systems such as Prometheus can scrape.
+//
+// The snapshot contains, with all times in microseconds:
+// - For each calculator, histograms of the Process() runtime and, if
+//   enable_stream_latency is set, of the process input and output latency and
+//   of the latency of each input stream. They come from
+//   GraphProfiler::GetCalculatorProfiles(). Their "_count" samples count the
+//   Process() calls and the consumed packets, which gives packet rates.
+// - For each calculator, gauges of the Open() and Close() runtime.
+// - For each calculator input stream, gauges of the queue size and its limit,
+//   and counters of the throttling events. These come from
+//   CalculatorGraph::GetInputStreamQueueStats().
+//
+// The profiler histograms are only filled in if enable_profiler is set in the
+// ProfilerConfig. GraphProfiler::CaptureProfile() and WriteProfile() reset
+// them, which monitoring systems handle as a counter reset.
+//
+// The exporter doesn't serve the snapshot itself. Either call GetSnapshot()
+// from the handler of an HTTP endpoint, or receive snapshots on a callback
+// with StartPeriodicExport(), e.g. to push them to a gateway:
+//
+//   GraphMetricsExporter exporter(&graph);
+//   MP_RETURN_IF_ERROR(exporter.StartPeriodicExport(
+//       absl::Seconds(10),
+//       [](const std::string& snapshot) { PushToGateway(snapshot); }));
+class GraphMetricsExporter {
+ public:
+  // Receives each periodic snapshot.
+  using SnapshotCallback = std::function<void(const std::string& snapshot)>;
+
+  // The graph must outlive the exporter.
+  explicit GraphMetricsExporter(CalculatorGraph* graph);
+
+  GraphMetricsExporter(const GraphMetricsExporter&) = delete;
+  GraphMetricsExporter& operator=(const GraphMetricsExporter&) = delete;
+
+  // Stops the periodic export, if any.
+  ~GraphMetricsExporter();
+
+  // Returns the current statistics of the graph. Fails if the graph hasn't
+  // been initialized.
+  absl::StatusOr<std::string> GetSnapshot() const;
+
+  // Calls "callback" with a fresh snapshot every "interval", on a thread owned
+  // by the exporter, until StopPeriodicExport() is called.
+  absl::Status StartPeriodicExport(absl::Duration interval,
+                                   SnapshotCallback callback)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Stops the periodic export and waits for a running callback to return.
+  // No-op if the export isn't running.
+  void StopPeriodicExport() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Formats the given statistics as an OpenMetrics text snapshot.
+  static std::string FormatSnapshot(
+      const std::vector<CalculatorProfile>& profiles,
+      const std::vector<CalculatorGraph::InputStreamQueueStats>& queue_stats);
+
+ private:
+  // Runs on export_thread_ until stop_ is set.
+  void ExportLoop(absl::Duration interval, SnapshotCallback callback)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  CalculatorGraph* const graph_;
+  absl::Mutex mutex_;
+  bool stop_ ABSL_GUARDED_BY(mutex_) = false;
+  std::unique_ptr<std::thread> export_thread_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_METRICS_EXPORTER_H_
@@ -0,0 +1,198 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/graph_metrics_exporter.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/calculator_framework.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/parse_text_proto.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+using testing::HasSubstr;
+
+TEST(GraphMetricsExporterTest, FormatSnapshot) {
+  CalculatorProfile profile = ParseTextProtoOrDie<CalculatorProfile>(R"pb(
+    name: "Node\"1"
+    open_runtime: 10
+    close_runtime: 20
+    process_runtime {
+      total: 2500
+      interval_size_usec: 1000
+      num_intervals: 3
+      count: [ 1, 0, 2 ]
+    }
+    input_stream_profiles {
+      name: "in"
+      back_edge: false
+      latency { total: 30 interval_size_usec: 1000 num_intervals: 1 count: 2 }
+    }
+    input_stream_profiles { name: "loop" back_edge: true }
+  )pb");
+  CalculatorGraph::InputStreamQueueStats stats;
+  stats.node_name = "Node\"1";
+  stats.stream_name = "in";
+  stats.queue_size = 3;
+  stats.max_queue_size = 4;
+  stats.num_throttled = 5;
+  stats.num_max_queue_size_grown = 1;
+
+  EXPECT_EQ(
+      GraphMetricsExporter::FormatSnapshot({profile}, {stats}),
+      R"(# TYPE mediapipe_calculator_process_runtime_microseconds histogram
+# UNIT mediapipe_calculator_process_runtime_microseconds microseconds
+# HELP mediapipe_calculator_process_runtime_microseconds Time spent in Process().
+mediapipe_calculator_process_runtime_microseconds_bucket{calculator="Node\"1",le="1000.0"} 1
+mediapipe_calculator_process_runtime_microseconds_bucket{calculator="Node\"1",le="2000.0"} 1
+mediapipe_calculator_process_runtime_microseconds_bucket{calculator="Node\"1",le="+Inf"} 3
+mediapipe_calculator_process_runtime_microseconds_count{calculator="Node\"1"} 3
+mediapipe_calculator_process_runtime_microseconds_sum{calculator="Node\"1"} 2500
+# TYPE mediapipe_input_stream_latency_microseconds histogram
+# UNIT mediapipe_input_stream_latency_microseconds microseconds
+# HELP mediapipe_input_stream_latency_microseconds Time from the production to the consumption of a packet.
+mediapipe_input_stream_latency_microseconds_bucket{calculator="Node\"1",stream="in",le="+Inf"} 2
+mediapipe_input_stream_latency_microseconds_count{calculator="Node\"1",stream="in"} 2
+mediapipe_input_stream_latency_microseconds_sum{calculator="Node\"1",stream="in"} 30
+# TYPE mediapipe_calculator_open_runtime_microseconds gauge
+# UNIT mediapipe_calculator_open_runtime_microseconds microseconds
+# HELP mediapipe_calculator_open_runtime_microseconds Time spent in Open().
+mediapipe_calculator_open_runtime_microseconds{calculator="Node\"1"} 10
+# TYPE mediapipe_calculator_close_runtime_microseconds gauge
+# UNIT mediapipe_calculator_close_runtime_microseconds microseconds
+# HELP mediapipe_calculator_close_runtime_microseconds Time spent in Close().
+mediapipe_calculator_close_runtime_microseconds{calculator="Node\"1"} 20
+# TYPE mediapipe_input_stream_queue_size gauge
+# HELP mediapipe_input_stream_queue_size Number of packets waiting in the input stream queue.
+mediapipe_input_stream_queue_size{calculator="Node\"1",stream="in"} 3
+# TYPE mediapipe_input_stream_max_queue_size gauge
+# HELP mediapipe_input_stream_max_queue_size Queue size at which the input stream throttles its sources, or -1 if unlimited.
+mediapipe_input_stream_max_queue_size{calculator="Node\"1",stream="in"} 4
+# TYPE mediapipe_input_stream_throttled counter
+# HELP mediapipe_input_stream_throttled Number of times the input stream queue became full and throttled its sources.
+mediapipe_input_stream_throttled_total{calculator="Node\"1",stream="in"} 5
+# TYPE mediapipe_input_stream_max_queue_size_grown counter
+# HELP mediapipe_input_stream_max_queue_size_grown Number of times max_queue_size was grown to resolve a throttling deadlock.
+mediapipe_input_stream_max_queue_size_grown_total{calculator="Node\"1",stream="in"} 1
+# EOF
+)");
+}
+
+TEST(GraphMetricsExporterTest, FormatEmptySnapshot) {
+  EXPECT_EQ(GraphMetricsExporter::FormatSnapshot({}, {}), "# EOF\n");
+}
+
+CalculatorGraphConfig TwoInputGraphConfig() {
+  // The calculator waits for both inputs, so packets queue up on "a" until
+  // "b" catches up.
+  return ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+    input_stream: "a"
+    input_stream: "b"
+    max_queue_size: 2
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "a"
+      input_stream: "b"
+      output_stream: "a_out"
+      output_stream: "b_out"
+    }
+    profiler_config { enable_profiler: true }
+  )pb");
+}
+
+TEST(GraphMetricsExporterTest, ReportsQueueSizesAndThrottling) {
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(TwoInputGraphConfig()));
+  MP_ASSERT_OK(graph.StartRun({}));
+  for (int i = 0; i < 2; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "a", MakePacket<int>(i).At(Timestamp(i))));
+  }
+
+  std::vector<CalculatorGraph::InputStreamQueueStats> queue_stats =
+      graph.GetInputStreamQueueStats();
+  ASSERT_EQ(queue_stats.size(), 2);
+  EXPECT_EQ(queue_stats[0].node_name, "PassThroughCalculator");
+  EXPECT_EQ(queue_stats[0].stream_name, "a");
+  EXPECT_EQ(queue_stats[0].queue_size, 2);
+  EXPECT_EQ(queue_stats[0].num_throttled, 1);
+  // Once the graph is idle, the scheduler may grow the full queue to resolve
+  // the throttling deadlock.
+  EXPECT_GE(queue_stats[0].max_queue_size, 2);
+  EXPECT_EQ(queue_stats[1].stream_name, "b");
+  EXPECT_EQ(queue_stats[1].queue_size, 0);
+  EXPECT_EQ(queue_stats[1].num_throttled, 0);
+
+  for (int i = 0; i < 2; ++i) {
+    MP_ASSERT_OK(graph.AddPacketToInputStream(
+        "b", MakePacket<int>(i).At(Timestamp(i))));
+  }
+  MP_ASSERT_OK(graph.CloseAllInputStreams());
+  MP_ASSERT_OK(graph.WaitUntilDone());
+
+  GraphMetricsExporter exporter(&graph);
+  auto snapshot = exporter.GetSnapshot();
+  MP_ASSERT_OK(snapshot);
+  EXPECT_THAT(*snapshot, HasSubstr("mediapipe_calculator_process_runtime_"
+                                   "microseconds_count{calculator="
+                                   "\"PassThroughCalculator\"} 2\n"));
+  EXPECT_THAT(*snapshot, HasSubstr("mediapipe_input_stream_queue_size{"
+                                   "calculator=\"PassThroughCalculator\","
+                                   "stream=\"a\"} 0\n"));
+  EXPECT_THAT(*snapshot, HasSubstr("mediapipe_input_stream_throttled_total{"
+                                   "calculator=\"PassThroughCalculator\","
+                                   "stream=\"a\"} 1\n"));
+}
+
+TEST(GraphMetricsExporterTest, ExportsPeriodically) {
+  CalculatorGraph graph;
+  MP_ASSERT_OK(graph.Initialize(TwoInputGraphConfig()));
+  GraphMetricsExporter exporter(&graph);
+  absl::Mutex mutex;
+  std::vector<std::string> snapshots;
+  MP_ASSERT_OK(exporter.StartPeriodicExport(
+      absl::Milliseconds(1), [&mutex, &snapshots](const std::string& snapshot) {
+        absl::MutexLock lock(&mutex);
+        snapshots.push_back(snapshot);
+      }));
+  EXPECT_FALSE(exporter
+                   .StartPeriodicExport(absl::Milliseconds(1),
+                                        [](const std::string&) {})
+                   .ok());
+  {
+    absl::MutexLock lock(&mutex);
+    mutex.Await(absl::Condition(
+        +[](std::vector<std::string>* snapshots) {
+          return snapshots->size() >= 2;
+        },
+        &snapshots));
+  }
+  exporter.StopPeriodicExport();
+
+  absl::MutexLock lock(&mutex);
+  for (const std::string& snapshot : snapshots) {
+    EXPECT_THAT(snapshot, HasSubstr("mediapipe_input_stream_queue_size{"));
+    EXPECT_THAT(snapshot, HasSubstr("# EOF\n"));
+  }
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -14,9 +14,12 @@
 
 #include "mediapipe/framework/profiler/graph_profiler.h"
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <list>
 
+#include "absl/memory/memory.h"
 #include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
@@ -155,6 +158,19 @@ void GraphProfiler::Initialize(
     auto iter = calculator_profiles_.insert({node_name, profile});
     CHECK(iter.second) << absl::Substitute(
         "Calculator \"$0\" has already been added.", node_name);
+    node_ids_[node_name] = node_id;
+  }
+  if (profiler_config_.trace_buffer_per_thread()) {
+    histogram_interval_size_usec_ = interval_size_usec;
+    num_histogram_intervals_ = num_intervals;
+    const size_t num_counters =
+        validated_graph_config.CalculatorInfos().size() * (num_intervals + 1);
+    process_runtime_counters_ =
+        absl::make_unique<PerThreadStorage<ProcessRuntimeCounters>>(
+            [num_counters]() {
+              return absl::make_unique<ProcessRuntimeCounters>(num_counters);
+            });
+    process_runtime_baseline_.assign(num_counters, 0);
   }
   is_initialized_ = true;
 }
@@ -196,6 +212,9 @@ void GraphProfiler::Reset() {
       ResetTimeHistogram(input_stream_profile.mutable_latency());
     }
   }
+  if (process_runtime_counters_) {
+    process_runtime_baseline_ = SumProcessRuntimeCounters();
+  }
 }
 
 // Begins profiling for a single graph run.
@@ -286,12 +305,39 @@ absl::Status GraphProfiler::GetCalculatorProfiles(
   absl::ReaderMutexLock lock(&profiler_mutex_);
   RET_CHECK(is_initialized_)
       << "GetCalculatorProfiles can only be called after Initialize()";
+  const std::vector<int64> process_runtime_sums =
+      process_runtime_counters_ ? SumProcessRuntimeCounters()
+                                : std::vector<int64>();
   for (auto& entry : calculator_profiles_) {
     profiles->push_back(entry.second);
+    if (process_runtime_counters_) {
+      // Fills in the samples added since the previous Reset().
+      const int first =
+          node_ids_.at(entry.first) * (num_histogram_intervals_ + 1);
+      auto counter = [&](int i) {
+        return process_runtime_sums[first + i] -
+               process_runtime_baseline_[first + i];
+      };
+      TimeHistogram* histogram = profiles->back().mutable_process_runtime();
+      histogram->set_total(counter(0));
+      for (int i = 0; i < num_histogram_intervals_; ++i) {
+        histogram->set_count(i, counter(i + 1));
+      }
+    }
   }
   return absl::OkStatus();
 }
 
+std::vector<int64> GraphProfiler::SumProcessRuntimeCounters() const {
+  std::vector<int64> result(process_runtime_baseline_.size());
+  for (const auto& counters : process_runtime_counters_->GetAll()) {
+    for (int i = 0; i < result.size(); ++i) {
+      result[i] += counters->values[i].load(std::memory_order_relaxed);
+    }
+  }
+  return result;
+}
+
 void GraphProfiler::InitializeTimeHistogram(int64 interval_size_usec,
                                             int64 num_intervals,
                                             TimeHistogram* histogram) {
@@ -486,9 +532,42 @@ int64 GraphProfiler::AddInputStreamTimeSamples(
   return min_source_process_start_usec;
 }
 
+void GraphProfiler::AddProcessRuntimeSample(int node_id,
+                                            int64 start_time_usec,
+                                            int64 end_time_usec) {
+  if (end_time_usec < start_time_usec) {
+    LOG(ERROR) << absl::Substitute(
+        "end_time_usec ($0) is < start_time_usec ($1)", end_time_usec,
+        start_time_usec);
+    return;
+  }
+  int64 time_usec = end_time_usec - start_time_usec;
+  int64 interval_index = std::min(time_usec / histogram_interval_size_usec_,
+                                  num_histogram_intervals_ - 1);
+  // Only the calling thread writes its counters, so they are updated without
+  // a read-modify-write.
+  std::atomic<int64>* counters =
+      &process_runtime_counters_->Get()
+           ->values[node_id * (num_histogram_intervals_ + 1)];
+  counters[0].store(counters[0].load(std::memory_order_relaxed) + time_usec,
+                    std::memory_order_relaxed);
+  std::atomic<int64>& count = counters[interval_index + 1];
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
 void GraphProfiler::AddProcessSample(
     const CalculatorContext& calculator_context, int64 start_time_usec,
     int64 end_time_usec) {
+  if (process_runtime_counters_ &&
+      !profiler_config_.enable_stream_latency()) {
+    // Without stream latencies, nothing is shared with other threads.
+    if (is_profiling_) {
+      AddProcessRuntimeSample(calculator_context.NodeId(), start_time_usec,
+                              end_time_usec);
+    }
+    return;
+  }
   absl::ReaderMutexLock lock(&profiler_mutex_);
   if (!is_profiling_) {
     return;
@@ -502,8 +581,13 @@ void GraphProfiler::AddProcessSample(
   CalculatorProfile* calculator_profile = &profile_iter->second;
 
   // Update Process() runtime.
-  AddTimeSample(start_time_usec, end_time_usec,
-                calculator_profile->mutable_process_runtime());
+  if (process_runtime_counters_) {
+    AddProcessRuntimeSample(calculator_context.NodeId(), start_time_usec,
+                            end_time_usec);
+  } else {
+    AddTimeSample(start_time_usec, end_time_usec,
+                  calculator_profile->mutable_process_runtime());
+  }
 
   if (profiler_config_.enable_stream_latency()) {
     int64 min_source_process_start_usec = AddStreamLatencies(
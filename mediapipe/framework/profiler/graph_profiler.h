@@ -17,6 +17,7 @@
 
 #include <atomic>
 #include <cstddef>
+#include <map>
 #include <memory>
 #include <set>
 #include <string>
@@ -31,6 +32,7 @@
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/profiler/graph_tracer.h"
+#include "mediapipe/framework/profiler/per_thread_storage.h"
 #include "mediapipe/framework/profiler/sharded_map.h"
 #include "mediapipe/framework/validated_graph_config.h"
 
@@ -295,6 +297,13 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
                         int64 start_time_usec, int64 end_time_usec)
       ABSL_LOCKS_EXCLUDED(profiler_mutex_);
 
+  // Adds a Process() runtime sample to the counters of the calling thread.
+  void AddProcessRuntimeSample(int node_id, int64 start_time_usec,
+                               int64 end_time_usec);
+  // Returns the sums of the process runtime counters of all threads.
+  std::vector<int64> SumProcessRuntimeCounters() const
+      ABSL_SHARED_LOCKS_REQUIRED(profiler_mutex_);
+
   // Helper method to get trace_log_path.  If the trace_log_path is empty and
   // tracing is enabled, this function returns a default platform dependent
   // trace_log_path.
@@ -327,6 +336,25 @@ class GraphProfiler : public std::enable_shared_from_this<ProfilingContext> {
   // Global mutex for the profiler.
   mutable absl::Mutex profiler_mutex_;
 
+  // The Process() runtime histograms of all nodes, recorded separately by each
+  // thread if trace_buffer_per_thread is set. They replace the process_runtime
+  // of calculator_profiles_, which is then filled in when read. Each node has
+  // num_histogram_intervals_ + 1 counters: the total time, then the count of
+  // each interval.
+  struct ProcessRuntimeCounters {
+    explicit ProcessRuntimeCounters(size_t size) : values(size) {}
+    std::vector<std::atomic<int64>> values;
+  };
+  std::unique_ptr<PerThreadStorage<ProcessRuntimeCounters>>
+      process_runtime_counters_;
+  // The sums of the process runtime counters at the previous Reset().
+  std::vector<int64> process_runtime_baseline_
+      ABSL_GUARDED_BY(profiler_mutex_);
+  // The node id of each calculator profile name.
+  std::map<std::string, int> node_ids_;
+  int64 histogram_interval_size_usec_ = 0;
+  int64 num_histogram_intervals_ = 0;
+
   // Buffer of recent profile trace events.
   std::unique_ptr<GraphTracer> packet_tracer_;
 
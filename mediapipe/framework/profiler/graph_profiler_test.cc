@@ -14,7 +14,10 @@
 
 #include "mediapipe/framework/profiler/graph_profiler.h"
 
+#include <thread>  // NOLINT(build/c++11)
+
 #include "absl/status/statusor.h"
+#include "absl/strings/substitute.h"
 #include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_framework.h"
@@ -1016,6 +1019,58 @@ TEST_F(GraphProfilerTestPeer, AddProcessSample) {
   ASSERT_EQ(GetPacketsInfoMap()->size(), 0);
 }
 
+// Tests that AddProcessSample() records |process_runtime| for each thread
+// separately when trace_buffer_per_thread is set, and merges the threads when
+// the profiles are read.
+TEST_F(GraphProfilerTestPeer, AddProcessSamplePerThread) {
+  InitializeProfilerWithGraphConfig(R"(
+    profiler_config {
+      enable_profiler: true
+      trace_buffer_per_thread: true
+      histogram_interval_size_usec: 100
+      num_histogram_intervals: 3
+    }
+    input_stream: "input_stream"
+    node {
+      calculator: "DummyTestCalculator"
+      input_stream: "input_stream"
+      output_stream: "output_stream"
+    })");
+  TestContextBuilder context(kDummyTestCalculatorName, /*node_id=*/0,
+                             {"input_stream"}, {"output_stream"});
+  context.AddInputs({MakePacket<std::string>("5").At(Timestamp(100))});
+
+  AddProcessSample(*context.get(), /*start_time_usec=*/0,
+                   /*end_time_usec=*/50);
+  std::thread thread([this, &context]() {
+    AddProcessSample(*context.get(), /*start_time_usec=*/100,
+                     /*end_time_usec=*/250);
+    AddProcessSample(*context.get(), /*start_time_usec=*/300,
+                     /*end_time_usec=*/1300);
+  });
+  thread.join();
+  std::vector<CalculatorProfile> profiles = Profiles();
+  ASSERT_EQ(profiles.size(), 1);
+  EXPECT_THAT(profiles[0].process_runtime(),
+              EqualsProto(R"pb(
+                total: 1200
+                interval_size_usec: 100
+                num_intervals: 3
+                count: [ 1, 1, 1 ]
+              )pb"));
+
+  // Reset() clears the samples of all threads.
+  profiler_.Reset();
+  EXPECT_THAT(Profiles()[0].process_runtime(),
+              Partially(EqualsProto(CreateTimeHistogram(0, {0, 0, 0}))));
+  AddProcessSample(*context.get(), /*start_time_usec=*/0,
+                   /*end_time_usec=*/120);
+  EXPECT_THAT(Profiles()[0].process_runtime(),
+              Partially(EqualsProto(CreateTimeHistogram(120, {0, 1, 0}))));
+  // Checks packets_info_ map hasn't changed.
+  ASSERT_EQ(GetPacketsInfoMap()->size(), 0);
+}
+
 // Tests that AddProcessSample() updates |process_runtime| and also updates the
 // packet info map when stream latency is enabled.
 TEST_F(GraphProfilerTestPeer, AddProcessSampleWithStreamLatency) {
@@ -1133,18 +1188,12 @@ TEST_F(GraphProfilerTestPeer, AddProcessSampleWithStreamLatency) {
   ASSERT_NE(GetPacketInfo(GetPacketsInfoMap(), {"stream_1", 100}), nullptr);
 }
 
-// This test shows that CalculatorGraph::GetCalculatorProfiles and
-// GraphProfiler::AddProcessSample() can be called in parallel.
-// Without the GraphProfiler::profiler_mutex_ this test should
-// fail with --config=tsan with message
-// "WARNING: ThreadSanitizer: data race in
-// mediapipe::ProcessProfile::set_total"
-TEST(GraphProfilerTest, ParallelReads) {
+// Runs a graph with "profiler_config" while reading its profiles.
+void RunWithParallelReads(const std::string& profiler_config) {
   // A graph that processes a certain number of packets before finishing.
-  CalculatorGraphConfig config;
-  QCHECK(proto2::TextFormat::ParseFromString(R"(
+  const std::string graph_config = absl::Substitute(R"(
     profiler_config {
-     enable_profiler: true
+      $0
     }
     node {
       calculator: "RangeCalculator"
@@ -1164,7 +1213,9 @@ TEST(GraphProfilerTest, ParallelReads) {
     }
     output_stream: "OUT:0:the_integers"
     )",
-                                             &config));
+                                                    profiler_config);
+  CalculatorGraphConfig config;
+  QCHECK(proto2::TextFormat::ParseFromString(graph_config, &config));
 
   // Start running the graph on its own threads.
   absl::Mutex out_1_mutex;
@@ -1205,5 +1256,20 @@ TEST(GraphProfilerTest, ParallelReads) {
   EXPECT_EQ(1001, out_1_packets.size());
 }
 
+// This test shows that CalculatorGraph::GetCalculatorProfiles and
+// GraphProfiler::AddProcessSample() can be called in parallel.
+// Without the GraphProfiler::profiler_mutex_ this test should
+// fail with --config=tsan with message
+// "WARNING: ThreadSanitizer: data race in
+// mediapipe::ProcessProfile::set_total"
+TEST(GraphProfilerTest, ParallelReads) {
+  RunWithParallelReads("enable_profiler: true");
+}
+
+// Same as above, with the Process() runtimes recorded by each thread.
+TEST(GraphProfilerTest, ParallelReadsPerThread) {
+  RunWithParallelReads("enable_profiler: true trace_buffer_per_thread: true");
+}
+
 }  // namespace
 }  // namespace mediapipe
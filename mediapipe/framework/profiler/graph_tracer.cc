@@ -14,6 +14,9 @@
 
 #include "mediapipe/framework/profiler/graph_tracer.h"
 
+#include <algorithm>
+
+#include "absl/memory/memory.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/calculator_context.h"
 #include "mediapipe/framework/calculator_profile.pb.h"
@@ -30,6 +33,13 @@ using EventType = GraphTrace::EventType;
 
 const absl::Duration kDefaultTraceLogInterval = absl::Milliseconds(500);
 
+// The default number of trace events buffered in the shared trace buffer.
+constexpr int64 kDefaultTraceLogCapacity = 20000;
+
+// The default number of trace events buffered per thread, which keeps the
+// ring of each thread small enough to stay in the cache of its core.
+constexpr int64 kDefaultPerThreadTraceLogCapacity = 1024;
+
 // Returns a unique identifier for the current thread.
 inline int GetCurrentThreadId() {
   static int next_thread_id = 0;
@@ -46,13 +56,23 @@ absl::Duration GraphTracer::GetTraceLogInterval() {
 }
 
 int64 GraphTracer::GetTraceLogCapacity() {
-  return profiler_config_.trace_log_capacity()
-             ? profiler_config_.trace_log_capacity()
-             : 20000;
+  if (profiler_config_.trace_log_capacity()) {
+    return profiler_config_.trace_log_capacity();
+  }
+  return profiler_config_.trace_buffer_per_thread()
+             ? kDefaultPerThreadTraceLogCapacity
+             : kDefaultTraceLogCapacity;
 }
 
 GraphTracer::GraphTracer(const ProfilerConfig& profiler_config)
-    : profiler_config_(profiler_config), trace_buffer_(GetTraceLogCapacity()) {
+    : profiler_config_(profiler_config),
+      trace_buffer_(profiler_config.trace_buffer_per_thread()
+                        ? 0
+                        : GetTraceLogCapacity()) {
+  if (profiler_config_.trace_buffer_per_thread()) {
+    per_thread_buffer_ =
+        absl::make_unique<PerThreadTraceBuffer>(GetTraceLogCapacity());
+  }
   for (int disabled : profiler_config_.trace_event_types_disabled()) {
     EventType event_type = static_cast<EventType>(disabled);
     (*trace_event_registry())[event_type].set_enabled(false);
@@ -68,7 +88,11 @@ void GraphTracer::LogEvent(TraceEvent event) {
     return;
   }
   event.set_thread_id(GetCurrentThreadId());
-  trace_buffer_.push_back(event);
+  if (per_thread_buffer_) {
+    per_thread_buffer_->push_back(event);
+  } else {
+    trace_buffer_.push_back(event);
+  }
 }
 
 void GraphTracer::LogInputEvents(GraphTrace::EventType event_type,
@@ -114,23 +138,47 @@ void GraphTracer::LogOutputEvents(GraphTrace::EventType event_type,
 }
 
 Timestamp GraphTracer::TimestampAfter(absl::Time begin_time) {
+  if (per_thread_buffer_) {
+    return TraceBuilder::TimestampAfter(MergePerThreadBuffers(), begin_time);
+  }
   return TraceBuilder::TimestampAfter(trace_buffer_, begin_time);
 }
 
 void GraphTracer::GetTrace(absl::Time begin_time, absl::Time end_time,
                            GraphTrace* result) {
-  trace_builder_.CreateTrace(trace_buffer_, begin_time, end_time, result);
+  if (per_thread_buffer_) {
+    trace_builder_.CreateTrace(MergePerThreadBuffers(), begin_time, end_time,
+                               result);
+  } else {
+    trace_builder_.CreateTrace(trace_buffer_, begin_time, end_time, result);
+  }
   trace_builder_.Clear();
 }
 
 void GraphTracer::GetLog(absl::Time begin_time, absl::Time end_time,
                          GraphTrace* result) {
-  trace_builder_.CreateLog(trace_buffer_, begin_time, end_time, result);
+  if (per_thread_buffer_) {
+    trace_builder_.CreateLog(MergePerThreadBuffers(), begin_time, end_time,
+                             result);
+  } else {
+    trace_builder_.CreateLog(trace_buffer_, begin_time, end_time, result);
+  }
   trace_builder_.Clear();
 }
 
 const TraceBuffer& GraphTracer::GetTraceBuffer() { return trace_buffer_; }
 
+std::vector<TraceEvent> GraphTracer::MergePerThreadBuffers() {
+  std::vector<TraceEvent> events = per_thread_buffer_->Snapshot();
+  // The events of each thread are already in order, so a stable sort keeps
+  // the order of the events logged at the same time by the same thread.
+  std::stable_sort(events.begin(), events.end(),
+                   [](const TraceEvent& a, const TraceEvent& b) {
+                     return a.event_time < b.event_time;
+                   });
+  return events;
+}
+
 Timestamp GraphTracer::GetOutputTimestamp(const CalculatorContext* context) {
   for (const OutputStreamShard& out_stream : context->Outputs()) {
     for (const Packet& packet : *out_stream.OutputQueue()) {
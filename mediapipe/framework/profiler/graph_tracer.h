@@ -15,7 +15,9 @@
 #ifndef MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_TRACER_H_
 #define MEDIAPIPE_FRAMEWORK_PROFILER_GRAPH_TRACER_H_
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "mediapipe/framework/calculator.pb.h"
 #include "mediapipe/framework/calculator_context.h"
@@ -78,19 +80,26 @@ class GraphTracer {
   // Returns trace events between begin_time and end_time exclusive.
   void GetLog(absl::Time begin_time, absl::Time end_time, GraphTrace* result);
 
-  // Returns the logged TraceEvents.
+  // Returns the logged TraceEvents. Empty if trace_buffer_per_thread is set.
   const TraceBuffer& GetTraceBuffer();
 
  private:
   // Returns the timestamp of the first output packet.
   Timestamp GetOutputTimestamp(const CalculatorContext* context);
 
+  // Returns the TraceEvents of all threads in order of event_time.
+  std::vector<TraceEvent> MergePerThreadBuffers();
+
   // The settings for this tracer.
   ProfilerConfig profiler_config_;
 
   // The circular buffer of TraceEvents.
   TraceBuffer trace_buffer_;
 
+  // The per-thread buffers of TraceEvents, used instead of trace_buffer_ if
+  // trace_buffer_per_thread is set.
+  std::unique_ptr<PerThreadTraceBuffer> per_thread_buffer_;
+
   // The builder for the GraphTrace protobuf.
   TraceBuilder trace_builder_;
 };
@@ -18,6 +18,7 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -29,6 +30,7 @@
 #include "mediapipe/framework/deps/clock.h"
 #include "mediapipe/framework/deps/message_matchers.h"
 #include "mediapipe/framework/port/advanced_proto_inc.h"
+#include "mediapipe/framework/port/benchmark.h"
 #include "mediapipe/framework/port/file_helpers.h"
 #include "mediapipe/framework/port/gmock.h"
 #include "mediapipe/framework/port/gtest.h"
@@ -74,6 +76,14 @@ class GraphTracerTest : public ::testing::Test {
     tracer_ = absl::make_unique<GraphTracer>(profiler_config);
   }
 
+  // Initializes the GraphTracer with a trace buffer for each thread.
+  void SetUpPerThreadGraphTracer() {
+    ProfilerConfig profiler_config;
+    profiler_config.set_trace_enabled(true);
+    profiler_config.set_trace_buffer_per_thread(true);
+    tracer_ = absl::make_unique<GraphTracer>(profiler_config);
+  }
+
   // Initializes the input and output stream specs for a calculator node.
   void SetUpCalculatorContext(const std::string& node_name, int node_id,
                               const std::vector<std::string>& inputs,
@@ -169,6 +179,57 @@ TEST_F(GraphTracerTest, CalculatorTrace) {
       )pb")));
 }
 
+TEST_F(GraphTracerTest, CalculatorTracePerThread) {
+  // Define the GraphTracer, the CalculatorState, and the stream specs.
+  SetUpPerThreadGraphTracer();
+  SetUpCalculatorContext("PCalculator_1", /*node_id=*/0, {"input_stream"},
+                         {"output_stream"});
+  absl::Time curr_time = start_time_;
+
+  // PCalculator_1 processes one packet from stream "input_stream". The output
+  // is logged first, by another thread.
+  Packet input = MakePacket<std::string>("hello").At(start_timestamp_);
+  context_builders_["PCalculator_1"].AddInputs({input});
+  std::thread thread([&]() {
+    LogOutputPackets(
+        "PCalculator_1", GraphTrace::PROCESS,
+        curr_time + absl::Microseconds(10000),
+        {{MakePacket<std::string>("goodbye").At(start_timestamp_)}});
+  });
+  thread.join();
+  LogInputPackets("PCalculator_1", GraphTrace::PROCESS, curr_time, {input});
+
+  // Validate the GraphTrace data, the events are merged in time order.
+  GraphTrace trace = GetTrace();
+  for (auto& calculator_trace : *trace.mutable_calculator_trace()) {
+    calculator_trace.clear_thread_id();
+  }
+  EXPECT_THAT(
+      trace, EqualsProto(mediapipe::ParseTextProtoOrDie<GraphTrace>(R"pb(
+        base_time: 1608911100000000
+        base_timestamp: 1608911100000000
+        stream_name: ""
+        stream_name: "input_stream"
+        stream_name: "output_stream"
+        calculator_trace {
+          node_id: 0
+          input_timestamp: 0
+          event_type: PROCESS
+          start_time: 0
+          finish_time: 10000
+          input_trace {
+            finish_time: 0
+            packet_timestamp: 0
+            stream_id: 1
+            event_data: 1
+          }
+          output_trace { packet_timestamp: 0 stream_id: 2 event_data: 2 }
+        }
+      )pb")));
+  EXPECT_EQ(tracer_->TimestampAfter(curr_time + absl::Microseconds(1)),
+            start_timestamp_ + 1);
+}
+
 TEST_F(GraphTracerTest, GraphTrace) {
   // Define the GraphTracer, the CalculatorState, and the stream specs.
   SetUpGraphTracer();
@@ -1396,6 +1457,65 @@ TEST_F(GraphTracerE2ETest, GpuTracing) {
   EXPECT_NE(nullptr, graph_.profiler()->CreateGlProfilingHelper());
 }
 
+// Shows that the events recorded by each thread are merged into one trace.
+TEST_F(GraphTracerE2ETest, PassThroughGraphTracePerThread) {
+  constexpr int kNumPackets = 100;
+  CHECK(proto_ns::TextFormat::ParseFromString(R"(
+        input_stream: "input_0"
+        num_threads: 4
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "input_0"
+          output_stream: "output_0"
+        }
+        node {
+          calculator: "PassThroughCalculator"
+          input_stream: "output_0"
+          output_stream: "output_1"
+        }
+        profiler_config {
+          trace_enabled: true
+          trace_buffer_per_thread: true
+          trace_log_disabled: true
+        }
+        )",
+                                              &graph_config_));
+  MP_ASSERT_OK(graph_.Initialize(graph_config_, {}));
+  MP_ASSERT_OK(graph_.StartRun({}));
+  for (int ts = 0; ts < kNumPackets; ++ts) {
+    MP_ASSERT_OK(graph_.AddPacketToInputStream("input_0", PacketAt(ts)));
+  }
+  MP_ASSERT_OK(graph_.CloseAllPacketSources());
+  MP_ASSERT_OK(graph_.WaitUntilDone());
+
+  // Every Process call is reported once, with its start and finish times.
+  // Packets added to the graph are reported with node_id -1.
+  GraphTrace trace;
+  graph_.profiler()->tracer()->GetTrace(absl::InfinitePast(),
+                                        absl::InfiniteFuture(), &trace);
+  std::map<int, std::vector<int64>> input_timestamps;
+  for (const auto& calculator_trace : trace.calculator_trace()) {
+    if (calculator_trace.event_type() != GraphTrace::PROCESS ||
+        calculator_trace.node_id() < 0) {
+      continue;
+    }
+    EXPECT_TRUE(calculator_trace.has_start_time());
+    EXPECT_TRUE(calculator_trace.has_finish_time());
+    EXPECT_LE(calculator_trace.start_time(), calculator_trace.finish_time());
+    input_timestamps[calculator_trace.node_id()].push_back(
+        calculator_trace.input_timestamp() + trace.base_timestamp());
+  }
+  std::vector<int64> expected_timestamps;
+  for (int ts = 0; ts < kNumPackets; ++ts) {
+    expected_timestamps.push_back(ts);
+  }
+  ASSERT_EQ(input_timestamps.size(), 2);
+  for (auto& node_timestamps : input_timestamps) {
+    EXPECT_THAT(node_timestamps.second,
+                testing::UnorderedElementsAreArray(expected_timestamps));
+  }
+}
+
 // This test shows that ~CalculatorGraph() can complete successfully, even when
 // the periodic profiler output is enabled.  If periodic profiler output is not
 // stopped in ~CalculatorGraph(), it will deadlock at ~Executor().
@@ -1424,5 +1544,99 @@ TEST_F(GraphTracerE2ETest, DestructGraph) {
   }
 }
 
+// The tracing modes compared by BM_PassThroughGraphTracing.
+enum TracingMode {
+  kTracingDisabled = 0,
+  kSharedTraceBuffer = 1,
+  kPerThreadTraceBuffers = 2,
+};
+
+// Measures the throughput of a chain of PassThroughCalculators, as used in
+// calculator_graph_test, in each TracingMode. The calculators do no work, so
+// this is the worst case for the relative overhead of tracing. Shared and
+// per-thread buffers differ most when the nodes run on many cores at once.
+void BM_PassThroughGraphTracing(benchmark::State& state) {
+  constexpr int kNumPacketsPerIteration = 100;
+  auto config = ParseTextProtoOrDie<CalculatorGraphConfig>(R"pb(
+    input_stream: "in"
+    output_stream: "out"
+    num_threads: 4
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "in"
+      output_stream: "a"
+    }
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "a"
+      output_stream: "b"
+    }
+    node {
+      calculator: "PassThroughCalculator"
+      input_stream: "b"
+      output_stream: "out"
+    }
+  )pb");
+  ProfilerConfig* profiler_config = config.mutable_profiler_config();
+  profiler_config->set_trace_enabled(state.range(0) != kTracingDisabled);
+  profiler_config->set_trace_buffer_per_thread(state.range(0) ==
+                                               kPerThreadTraceBuffers);
+  profiler_config->set_trace_log_disabled(true);
+
+  CalculatorGraph graph;
+  MEDIAPIPE_CHECK_OK(graph.Initialize(config));
+  MEDIAPIPE_CHECK_OK(graph.StartRun({}));
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < kNumPacketsPerIteration; ++i) {
+      MEDIAPIPE_CHECK_OK(graph.AddPacketToInputStream(
+          "in", MakePacket<int>(i).At(Timestamp(timestamp++))));
+    }
+    MEDIAPIPE_CHECK_OK(graph.WaitUntilIdle());
+  }
+  MEDIAPIPE_CHECK_OK(graph.CloseAllInputStreams());
+  MEDIAPIPE_CHECK_OK(graph.WaitUntilDone());
+  state.SetItemsProcessed(state.iterations() * kNumPacketsPerIteration);
+}
+
+BENCHMARK(BM_PassThroughGraphTracing)
+    ->Arg(kTracingDisabled)
+    ->Arg(kSharedTraceBuffer)
+    ->Arg(kPerThreadTraceBuffers)
+    ->UseRealTime();
+
+// Measures the cost of GraphTracer::LogEvent alone, with the shared trace
+// buffer or the per-thread trace buffers, from one or more threads logging to
+// the same tracer. This excludes the cost of building the events, which
+// dominates BM_PassThroughGraphTracing.
+void BM_GraphTracerLogEvent(benchmark::State& state) {
+  // The tracers are shared by the benchmark threads, and never destroyed.
+  static GraphTracer* const tracers[] = {
+      nullptr,
+      new GraphTracer(
+          ParseTextProtoOrDie<ProfilerConfig>("trace_enabled: true")),
+      new GraphTracer(ParseTextProtoOrDie<ProfilerConfig>(
+          "trace_enabled: true trace_buffer_per_thread: true")),
+  };
+  GraphTracer* tracer = tracers[state.range(0)];
+  const std::string stream_id = "stream";
+  const absl::Time event_time = absl::Now();
+  int64 timestamp = 0;
+  for (auto _ : state) {
+    tracer->LogEvent(TraceEvent(GraphTrace::PROCESS)
+                         .set_event_time(event_time)
+                         .set_input_ts(Timestamp(timestamp++))
+                         .set_node_id(1)
+                         .set_stream_id(&stream_id));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_GraphTracerLogEvent)
+    ->Arg(kSharedTraceBuffer)
+    ->Arg(kPerThreadTraceBuffers)
+    ->ThreadRange(1, 4)
+    ->UseRealTime();
+
 }  // namespace
 }  // namespace mediapipe
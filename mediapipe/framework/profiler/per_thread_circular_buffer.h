@@ -0,0 +1,132 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_PER_THREAD_CIRCULAR_BUFFER_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_PER_THREAD_CIRCULAR_BUFFER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "absl/base/attributes.h"
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/profiler/per_thread_storage.h"
+
+namespace mediapipe {
+
+// A circular buffer for lock-free event logging with a separate ring for each
+// writing thread.
+//
+// Unlike CircularBuffer, writers never touch a shared cache line: push_back
+// appends to a ring owned by the calling thread with two relaxed stores and a
+// release store. The rings are held in a PerThreadStorage, so only the first
+// push_back of each thread takes a lock to find or create its ring. Readers
+// copy every ring with Snapshot() and discard the events that may have been
+// overwritten while they were being copied.
+//
+// Each ring holds up to "capacity" events, so the buffer holds the most recent
+// "capacity" events of each thread. A ring is handed over to a new thread once
+// its writing thread has exited, so the number of rings is bounded by the
+// number of threads logging concurrently.
+//
+// T must be trivially copyable, since readers may copy an event while it is
+// being overwritten.
+template <typename T>
+class PerThreadCircularBuffer {
+ public:
+  static_assert(std::is_trivially_copyable<T>::value,
+                "PerThreadCircularBuffer requires a trivially copyable type.");
+
+  // Create a circular buffer to hold up to |capacity| events per thread.
+  explicit PerThreadCircularBuffer(size_t capacity);
+
+  PerThreadCircularBuffer(const PerThreadCircularBuffer&) = delete;
+  PerThreadCircularBuffer& operator=(const PerThreadCircularBuffer&) = delete;
+
+  // Appends one event to the ring of the calling thread.
+  inline void push_back(const T& event);
+
+  // Returns the available events of all threads. The events of each thread are
+  // in the order they were written, the threads follow each other.
+  std::vector<T> Snapshot() const;
+
+ private:
+  struct Ring {
+    explicit Ring(size_t capacity) : events(capacity) {}
+
+    std::vector<T> events;
+    // The number of events the writer started and finished writing.
+    alignas(64) std::atomic<uint64> num_started{0};
+    std::atomic<uint64> num_written{0};
+  };
+
+  // Copies an event between a ring slot and a local. Readers race with the
+  // writer by design and discard the events it may have overwritten.
+  ABSL_ATTRIBUTE_NO_SANITIZE_THREAD static void CopyEvent(const T& from,
+                                                          T* to) {
+    *to = from;
+  }
+
+  const size_t capacity_;
+  PerThreadStorage<Ring> rings_;
+};
+
+template <typename T>
+PerThreadCircularBuffer<T>::PerThreadCircularBuffer(size_t capacity)
+    : capacity_(capacity),
+      rings_([capacity]() { return absl::make_unique<Ring>(capacity); }) {}
+
+template <typename T>
+void PerThreadCircularBuffer<T>::push_back(const T& event) {
+  Ring* ring = rings_.Get();
+  const uint64 i = ring->num_written.load(std::memory_order_relaxed);
+  // Announces the overwrite before the slot changes, see Snapshot().
+  ring->num_started.store(i + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  CopyEvent(event, &ring->events[i % capacity_]);
+  ring->num_written.store(i + 1, std::memory_order_release);
+}
+
+template <typename T>
+std::vector<T> PerThreadCircularBuffer<T>::Snapshot() const {
+  std::vector<T> result;
+  for (const auto& ring : rings_.GetAll()) {
+    const uint64 end = ring->num_written.load(std::memory_order_acquire);
+    const uint64 begin = end > capacity_ ? end - capacity_ : 0;
+    const size_t first = result.size();
+    result.resize(first + (end - begin));
+    for (uint64 i = begin; i < end; ++i) {
+      CopyEvent(ring->events[i % capacity_], &result[first + (i - begin)]);
+    }
+    // The writer may have wrapped around while we were copying. Every slot it
+    // started to overwrite belongs to an event before "valid_begin".
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64 started = ring->num_started.load(std::memory_order_relaxed);
+    const uint64 valid_begin = started > capacity_ ? started - capacity_ : 0;
+    if (valid_begin > begin) {
+      const uint64 num_invalid = std::min(valid_begin, end) - begin;
+      result.erase(result.begin() + first,
+                   result.begin() + first + num_invalid);
+    }
+  }
+  return result;
+}
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_PER_THREAD_CIRCULAR_BUFFER_H_
@@ -0,0 +1,137 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/per_thread_circular_buffer.h"
+
+#include <atomic>
+#include <map>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+namespace {
+
+using testing::ElementsAre;
+
+// An event tagged with its writer and its position in the writer's sequence.
+struct Event {
+  int writer;
+  int64 index;
+};
+
+TEST(PerThreadCircularBufferTest, SequentialWriteAndRead) {
+  PerThreadCircularBuffer<int> buffer(100);
+  EXPECT_TRUE(buffer.Snapshot().empty());
+  buffer.push_back(1);
+  buffer.push_back(2);
+  buffer.push_back(3);
+  EXPECT_THAT(buffer.Snapshot(), ElementsAre(1, 2, 3));
+}
+
+TEST(PerThreadCircularBufferTest, KeepsMostRecentEvents) {
+  PerThreadCircularBuffer<int> buffer(3);
+  for (int i = 0; i < 10; ++i) {
+    buffer.push_back(i);
+  }
+  EXPECT_THAT(buffer.Snapshot(), ElementsAre(7, 8, 9));
+}
+
+TEST(PerThreadCircularBufferTest, SeparatesBuffers) {
+  // A thread alternating between two buffers writes to one ring in each.
+  PerThreadCircularBuffer<int> buffer_1(100);
+  PerThreadCircularBuffer<int> buffer_2(100);
+  for (int i = 0; i < 3; ++i) {
+    buffer_1.push_back(i);
+    buffer_2.push_back(10 + i);
+  }
+  EXPECT_THAT(buffer_1.Snapshot(), ElementsAre(0, 1, 2));
+  EXPECT_THAT(buffer_2.Snapshot(), ElementsAre(10, 11, 12));
+}
+
+TEST(PerThreadCircularBufferTest, MergesThreads) {
+  PerThreadCircularBuffer<int> buffer(100);
+  buffer.push_back(1);
+  std::thread thread([&buffer]() {
+    buffer.push_back(2);
+    buffer.push_back(3);
+  });
+  thread.join();
+  buffer.push_back(4);
+  // The events of each thread are kept together and in order.
+  EXPECT_THAT(buffer.Snapshot(), ElementsAre(1, 4, 2, 3));
+}
+
+TEST(PerThreadCircularBufferTest, HandsOverRingsOfExitedThreads) {
+  PerThreadCircularBuffer<int> buffer(100);
+  for (int i = 0; i < 3; ++i) {
+    std::thread thread([&buffer, i]() { buffer.push_back(i); });
+    thread.join();
+  }
+  // Every thread exited before the next one started, so they all share a ring.
+  EXPECT_THAT(buffer.Snapshot(), ElementsAre(0, 1, 2));
+}
+
+TEST(PerThreadCircularBufferTest, ReadsWhileWriting) {
+  constexpr int kNumWriters = 4;
+  constexpr int kNumEvents = 100000;
+  constexpr int kCapacity = 64;
+  PerThreadCircularBuffer<Event> buffer(kCapacity);
+  std::atomic<bool> done(false);
+  std::atomic<int> num_finished(0);
+  std::vector<std::thread> writers;
+  for (int w = 0; w < kNumWriters; ++w) {
+    writers.emplace_back([&buffer, &num_finished, w]() {
+      for (int64 i = 0; i < kNumEvents; ++i) {
+        buffer.push_back({w, i});
+      }
+      // Keeps the writers alive so that each one keeps its own ring.
+      ++num_finished;
+      while (num_finished < kNumWriters) {
+        std::this_thread::yield();
+      }
+    });
+  }
+  std::thread reader([&buffer, &done]() {
+    while (!done) {
+      // Every snapshot holds consecutive events of each writer, without any
+      // event overwritten while it was being copied.
+      std::map<int, int64> next_index;
+      for (const Event& event : buffer.Snapshot()) {
+        auto it = next_index.find(event.writer);
+        if (it != next_index.end()) {
+          ASSERT_EQ(event.index, it->second);
+        }
+        next_index[event.writer] = event.index + 1;
+      }
+    }
+  });
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  done = true;
+  reader.join();
+
+  std::vector<Event> events = buffer.Snapshot();
+  ASSERT_EQ(events.size(), kNumWriters * kCapacity);
+  for (int i = 0; i < events.size(); ++i) {
+    EXPECT_EQ(events[i].index, kNumEvents - kCapacity + i % kCapacity);
+  }
+}
+
+}  // namespace
+}  // namespace mediapipe
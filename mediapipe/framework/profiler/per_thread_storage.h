@@ -0,0 +1,191 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_PER_THREAD_STORAGE_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_PER_THREAD_STORAGE_H_
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/integral_types.h"
+
+namespace mediapipe {
+
+// Holds a separate T for each thread that uses it, for data written by many
+// threads without sharing a cache line, such as profiler events and counters.
+//
+// Get() returns the T of the calling thread. Only the first call of each
+// thread takes a lock to find or create its T, later calls read a thread local
+// cache. The cache holds the T's of the last kNumCachedStorages storages the
+// thread looked up, so a thread alternating between more storages than that,
+// such as a thread feeding the tracers of many graphs, takes the lock on most
+// calls. A T is handed over to a new thread once its thread has exited, so the
+// number of T's is bounded by the number of threads using the storage
+// concurrently. Readers merge the T's returned by GetAll(), and must cope with
+// the owning threads writing concurrently.
+template <typename T>
+class PerThreadStorage {
+ public:
+  // Creates the T of a new thread.
+  using Factory = std::function<std::unique_ptr<T>()>;
+
+  explicit PerThreadStorage(Factory factory)
+      : factory_(std::move(factory)), storage_id_(NextStorageId()) {}
+
+  PerThreadStorage(const PerThreadStorage&) = delete;
+  PerThreadStorage& operator=(const PerThreadStorage&) = delete;
+
+  // The number of storages whose T's each thread caches.
+  static constexpr int kNumCachedStorages = 4;
+
+  // Returns the T of the calling thread.
+  inline T* Get() {
+    for (const CacheEntry& entry : GetThreadSlots().cache) {
+      if (entry.storage_id == storage_id_) {
+        return entry.value;
+      }
+    }
+    return GetSlow();
+  }
+
+  // Returns the T of every thread, including the T's of exited threads not
+  // handed over yet.
+  std::vector<std::shared_ptr<T>> GetAll() const ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    std::vector<std::shared_ptr<T>> result;
+    result.reserve(slots_.size());
+    for (const auto& slot : slots_) {
+      result.emplace_back(slot, slot->value.get());
+    }
+    return result;
+  }
+
+ private:
+  struct Slot {
+    std::unique_ptr<T> value;
+    // Set when the owning thread exits, the slot can then be handed over.
+    std::atomic<bool> owner_exited{false};
+    // The owning thread, guarded by the mutex of the storage.
+    std::thread::id owner;
+  };
+
+  // A T of the current thread, and the id of its storage.
+  struct CacheEntry {
+    uint64 storage_id = 0;
+    T* value = nullptr;
+  };
+
+  // The slots owned by the current thread, one per storage.
+  struct ThreadSlots {
+    ~ThreadSlots() {
+      for (auto& weak_slot : slots) {
+        if (auto slot = weak_slot.lock()) {
+          slot->owner_exited.store(true, std::memory_order_release);
+        }
+      }
+    }
+
+    // The values of the most recently used storages. Storage ids are never
+    // reused, so the entries of destroyed storages are never matched.
+    CacheEntry cache[kNumCachedStorages];
+    // The cache entry replaced next.
+    int next_cache_entry = 0;
+    std::vector<std::weak_ptr<Slot>> slots;
+  };
+
+  static ThreadSlots& GetThreadSlots() {
+    static thread_local ThreadSlots thread_slots;
+    return thread_slots;
+  }
+
+  // Returns a unique id for each storage, ids are never reused.
+  static uint64 NextStorageId() {
+    static std::atomic<uint64> next_storage_id{1};
+    return next_storage_id++;
+  }
+
+  // Returns the T of the current thread, after the fast path missed.
+  T* GetSlow() ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const Factory factory_;
+  const uint64 storage_id_;
+  mutable absl::Mutex mutex_;
+  std::vector<std::shared_ptr<Slot>> slots_ ABSL_GUARDED_BY(mutex_);
+};
+
+template <typename T>
+T* PerThreadStorage<T>::GetSlow() {
+  ThreadSlots& thread_slots = GetThreadSlots();
+  const std::thread::id this_thread = std::this_thread::get_id();
+  std::shared_ptr<Slot> result;
+  {
+    absl::MutexLock lock(&mutex_);
+    // The thread may already own a slot, if it alternates between storages.
+    for (auto& slot : slots_) {
+      if (slot->owner == this_thread &&
+          !slot->owner_exited.load(std::memory_order_acquire)) {
+        result = slot;
+        break;
+      }
+    }
+    if (!result) {
+      for (auto& slot : slots_) {
+        if (slot->owner_exited.load(std::memory_order_acquire)) {
+          slot->owner = this_thread;
+          slot->owner_exited.store(false, std::memory_order_relaxed);
+          result = slot;
+          break;
+        }
+      }
+    }
+    if (!result) {
+      result = std::make_shared<Slot>();
+      result->value = factory_();
+      result->owner = this_thread;
+      slots_.push_back(result);
+    }
+  }
+
+  // Forgets the slots of destroyed storages, and registers the new slot.
+  auto& slots = thread_slots.slots;
+  bool registered = false;
+  for (auto it = slots.begin(); it != slots.end();) {
+    auto slot = it->lock();
+    if (!slot) {
+      it = slots.erase(it);
+      continue;
+    }
+    registered |= slot == result;
+    ++it;
+  }
+  if (!registered) {
+    slots.push_back(result);
+  }
+  CacheEntry& entry = thread_slots.cache[thread_slots.next_cache_entry];
+  thread_slots.next_cache_entry =
+      (thread_slots.next_cache_entry + 1) % kNumCachedStorages;
+  entry.storage_id = storage_id_;
+  entry.value = result->value.get();
+  return result->value.get();
+}
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_PER_THREAD_STORAGE_H_
@@ -0,0 +1,109 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/per_thread_storage.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+using testing::UnorderedElementsAre;
+
+std::vector<int> GetAllValues(const PerThreadStorage<int>& storage) {
+  std::vector<int> result;
+  for (const auto& value : storage.GetAll()) {
+    result.push_back(*value);
+  }
+  return result;
+}
+
+PerThreadStorage<int>::Factory ZeroFactory() {
+  return []() { return absl::make_unique<int>(0); };
+}
+
+TEST(PerThreadStorageTest, ReturnsSameValueOnSameThread) {
+  PerThreadStorage<int> storage(ZeroFactory());
+  EXPECT_TRUE(storage.GetAll().empty());
+  int* value = storage.Get();
+  *value = 5;
+  EXPECT_EQ(storage.Get(), value);
+  EXPECT_THAT(GetAllValues(storage), UnorderedElementsAre(5));
+}
+
+TEST(PerThreadStorageTest, SeparatesThreadsAndStorages) {
+  PerThreadStorage<int> storage_1(ZeroFactory());
+  PerThreadStorage<int> storage_2(ZeroFactory());
+  *storage_1.Get() = 1;
+  *storage_2.Get() = 10;
+  // The thread is kept alive while the main thread uses the storages, so that
+  // it doesn't hand its values over.
+  std::atomic<bool> done(false);
+  std::atomic<bool> written(false);
+  std::thread thread([&]() {
+    *storage_1.Get() = 2;
+    *storage_2.Get() = 20;
+    written = true;
+    while (!done) {
+      std::this_thread::yield();
+    }
+  });
+  while (!written) {
+    std::this_thread::yield();
+  }
+  // A thread alternating between storages keeps its value in each.
+  EXPECT_EQ(*storage_1.Get(), 1);
+  EXPECT_EQ(*storage_2.Get(), 10);
+  EXPECT_THAT(GetAllValues(storage_1), UnorderedElementsAre(1, 2));
+  EXPECT_THAT(GetAllValues(storage_2), UnorderedElementsAre(10, 20));
+  done = true;
+  thread.join();
+}
+
+TEST(PerThreadStorageTest, AlternatesBetweenMoreStoragesThanCached) {
+  constexpr int kNumStorages = PerThreadStorage<int>::kNumCachedStorages + 2;
+  std::vector<std::unique_ptr<PerThreadStorage<int>>> storages;
+  for (int i = 0; i < kNumStorages; ++i) {
+    storages.push_back(absl::make_unique<PerThreadStorage<int>>(ZeroFactory()));
+  }
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < kNumStorages; ++i) {
+      *storages[i]->Get() += i;
+    }
+  }
+  for (int i = 0; i < kNumStorages; ++i) {
+    EXPECT_THAT(GetAllValues(*storages[i]), UnorderedElementsAre(3 * i));
+  }
+}
+
+TEST(PerThreadStorageTest, HandsOverValuesOfExitedThreads) {
+  PerThreadStorage<int> storage(ZeroFactory());
+  for (int i = 0; i < 3; ++i) {
+    std::thread thread([&storage]() { ++*storage.Get(); });
+    thread.join();
+  }
+  // Every thread exited before the next one started, so they all share the
+  // value created by the first one.
+  EXPECT_THAT(GetAllValues(storage), UnorderedElementsAre(3));
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,292 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/profiler/reporter/critical_path.h"
+
+#include <algorithm>
+#include <set>
+#include <utility>
+
+#include "absl/strings/str_format.h"
+#include "absl/strings/str_join.h"
+
+namespace mediapipe {
+namespace reporter {
+
+namespace {
+
+// The samples collected for a calculator before computing percentiles.
+struct NodeSamples {
+  int critical_count = 0;
+  int64_t critical_time = 0;
+  std::vector<int64_t> compute_times;
+  std::vector<int64_t> queueing_times;
+};
+
+// The samples collected for a stream before computing percentiles.
+struct EdgeSamples {
+  int critical_count = 0;
+  std::vector<int64_t> slacks;
+};
+
+std::string FormatPercentiles(const Percentiles& p) {
+  return absl::StrFormat("%8d %8d %8d %8d", p.p50, p.p90, p.p99, p.max);
+}
+
+}  // namespace
+
+Percentiles Percentiles::Of(std::vector<int64_t> values) {
+  Percentiles result;
+  result.count = values.size();
+  if (values.empty()) {
+    return result;
+  }
+  std::sort(values.begin(), values.end());
+  auto rank = [&values](int percent) {
+    // The smallest value greater or equal to "percent" percent of the values.
+    size_t index = (values.size() * percent + 99) / 100;
+    return values[std::max<size_t>(index, 1) - 1];
+  };
+  result.p50 = rank(50);
+  result.p90 = rank(90);
+  result.p99 = rank(99);
+  result.max = values.back();
+  return result;
+}
+
+void CriticalPathAnalyzer::Accumulate(const GraphProfile& profile) {
+  for (const GraphTrace& graph_trace : profile.graph_trace()) {
+    const int64_t base_time = graph_trace.base_time();
+    const int64_t base_ts = graph_trace.base_timestamp();
+    for (const auto& calc_trace : graph_trace.calculator_trace()) {
+      // Graph input streams are logged with negative node ids, their packets
+      // show up as the inputs of the calculators.
+      if (calc_trace.event_type() != GraphTrace::PROCESS ||
+          calc_trace.node_id() < 0 ||
+          calc_trace.node_id() >= graph_trace.calculator_name_size()) {
+        continue;
+      }
+      const std::string& node =
+          graph_trace.calculator_name(calc_trace.node_id());
+      const int64_t timestamp = calc_trace.input_timestamp() + base_ts;
+      Call& call = calls_[std::make_tuple(node, timestamp)];
+      call.node = node;
+      call.timestamp = timestamp;
+      if (calc_trace.has_start_time()) {
+        const int64_t start_time = calc_trace.start_time() + base_time;
+        call.start_time = call.start_time < 0
+                              ? start_time
+                              : std::min(call.start_time, start_time);
+      }
+      if (calc_trace.has_finish_time()) {
+        const int64_t finish_time = calc_trace.finish_time() + base_time;
+        call.finish_time = call.finish_time < 0
+                               ? finish_time
+                               : std::max(call.finish_time, finish_time);
+      }
+      for (const auto& stream_trace : calc_trace.input_trace()) {
+        Input input;
+        input.stream = graph_trace.stream_name(stream_trace.stream_id());
+        input.packet_timestamp = stream_trace.packet_timestamp() + base_ts;
+        if (stream_trace.has_start_time()) {
+          input.arrival_time = stream_trace.start_time() + base_time;
+        }
+        call.inputs.push_back(std::move(input));
+      }
+      for (const auto& stream_trace : calc_trace.output_trace()) {
+        call.outputs.emplace_back(
+            graph_trace.stream_name(stream_trace.stream_id()),
+            stream_trace.packet_timestamp() + base_ts);
+      }
+    }
+  }
+}
+
+CriticalPathReport CriticalPathAnalyzer::Analyze() const {
+  // Indexes the complete calls by timestamp, and their output packets.
+  std::map<int64_t, std::vector<const Call*>> calls_by_timestamp;
+  std::map<std::pair<std::string, int64_t>, const Call*> producers;
+  for (const auto& entry : calls_) {
+    const Call& call = entry.second;
+    if (call.start_time < 0 || call.finish_time < 0) {
+      continue;
+    }
+    calls_by_timestamp[call.timestamp].push_back(&call);
+    for (const auto& output : call.outputs) {
+      producers[output] = &call;
+    }
+  }
+  auto find_producer = [&producers](const Input& input) -> const Call* {
+    auto it = producers.find(std::make_pair(input.stream,
+                                            input.packet_timestamp));
+    return it == producers.end() ? nullptr : it->second;
+  };
+  // Returns the arrival time of an input packet, or -1 if unknown.
+  auto arrival_time = [&find_producer](const Input& input) -> int64_t {
+    if (input.arrival_time >= 0) {
+      return input.arrival_time;
+    }
+    const Call* producer = find_producer(input);
+    return producer ? producer->finish_time : -1;
+  };
+  // Returns the time a call became ready to run.
+  auto ready_time = [&arrival_time](const Call& call) {
+    int64_t result = -1;
+    for (const Input& input : call.inputs) {
+      result = std::max(result, arrival_time(input));
+    }
+    return result < 0 ? call.start_time : std::min(result, call.start_time);
+  };
+
+  std::map<std::string, NodeSamples> node_samples;
+  std::map<std::tuple<std::string, std::string, std::string>, EdgeSamples>
+      edge_samples;
+  std::vector<int64_t> latencies;
+  CriticalPathReport report;
+  for (const auto& entry : calls_by_timestamp) {
+    for (const Call* call : entry.second) {
+      const int64_t ready = ready_time(*call);
+      NodeSamples& samples = node_samples[call->node];
+      samples.compute_times.push_back(call->finish_time - call->start_time);
+      samples.queueing_times.push_back(call->start_time - ready);
+      for (const Input& input : call->inputs) {
+        const Call* producer = find_producer(input);
+        const int64_t arrival = arrival_time(input);
+        if (!producer || arrival < 0) {
+          continue;
+        }
+        edge_samples[std::make_tuple(producer->node, call->node, input.stream)]
+            .slacks.push_back(std::max<int64_t>(ready - arrival, 0));
+      }
+    }
+
+    // Follows the last-arriving input packets back from the call that
+    // finished last.
+    const Call* sink = *std::max_element(
+        entry.second.begin(), entry.second.end(),
+        [](const Call* a, const Call* b) {
+          return a->finish_time < b->finish_time;
+        });
+    TimestampPath timestamp_path;
+    timestamp_path.timestamp = entry.first;
+    std::set<const Call*> visited;
+    const Call* call = sink;
+    const Call* root = sink;
+    while (call && visited.insert(call).second) {
+      root = call;
+      timestamp_path.path.push_back(call->node);
+      NodeSamples& samples = node_samples[call->node];
+      ++samples.critical_count;
+      samples.critical_time += call->finish_time - ready_time(*call);
+
+      const Input* critical_input = nullptr;
+      for (const Input& input : call->inputs) {
+        if (arrival_time(input) >= 0 &&
+            (!critical_input ||
+             arrival_time(input) > arrival_time(*critical_input))) {
+          critical_input = &input;
+        }
+      }
+      const Call* producer =
+          critical_input ? find_producer(*critical_input) : nullptr;
+      if (!producer || producer->timestamp != call->timestamp) {
+        break;
+      }
+      ++edge_samples[std::make_tuple(producer->node, call->node,
+                                     critical_input->stream)]
+            .critical_count;
+      call = producer;
+    }
+    std::reverse(timestamp_path.path.begin(), timestamp_path.path.end());
+    timestamp_path.latency = sink->finish_time - ready_time(*root);
+    latencies.push_back(timestamp_path.latency);
+    ++report.path_counts[timestamp_path.path];
+    report.timestamps.push_back(std::move(timestamp_path));
+  }
+
+  report.latency = Percentiles::Of(std::move(latencies));
+  for (auto& entry : node_samples) {
+    CriticalPathNodeData node;
+    node.name = entry.first;
+    node.timestamp_count = entry.second.compute_times.size();
+    node.critical_count = entry.second.critical_count;
+    node.critical_time = entry.second.critical_time;
+    node.compute_time = Percentiles::Of(std::move(entry.second.compute_times));
+    node.queueing_time =
+        Percentiles::Of(std::move(entry.second.queueing_times));
+    report.nodes.push_back(std::move(node));
+  }
+  std::stable_sort(report.nodes.begin(), report.nodes.end(),
+                   [](const CriticalPathNodeData& a,
+                      const CriticalPathNodeData& b) {
+                     return a.critical_time > b.critical_time;
+                   });
+  for (auto& entry : edge_samples) {
+    CriticalPathEdgeData edge;
+    std::tie(edge.producer, edge.consumer, edge.stream) = entry.first;
+    edge.packet_count = entry.second.slacks.size();
+    edge.critical_count = entry.second.critical_count;
+    edge.slack = Percentiles::Of(std::move(entry.second.slacks));
+    report.edges.push_back(std::move(edge));
+  }
+  return report;
+}
+
+void CriticalPathReport::Print(std::ostream& output, int max_paths) const {
+  const int num_timestamps = timestamps.size();
+  auto percent = [num_timestamps](int count) {
+    return num_timestamps == 0 ? 0.0 : 100.0 * count / num_timestamps;
+  };
+  output << absl::StrFormat("timestamps: %d\n", num_timestamps);
+  output << absl::StrFormat("latency (us): p50 %d p90 %d p99 %d max %d\n\n",
+                            latency.p50, latency.p90, latency.p99,
+                            latency.max);
+
+  std::vector<std::pair<int, const std::vector<std::string>*>> paths;
+  for (const auto& entry : path_counts) {
+    paths.emplace_back(entry.second, &entry.first);
+  }
+  std::stable_sort(
+      paths.begin(), paths.end(),
+      [](const auto& a, const auto& b) { return a.first > b.first; });
+  output << "critical paths:\n";
+  for (int i = 0; i < paths.size() && i < max_paths; ++i) {
+    output << absl::StrFormat("%6.2f%% %s\n", percent(paths[i].first),
+                              absl::StrJoin(*paths[i].second, " -> "));
+  }
+
+  output << absl::StrFormat(
+      "\n%-40s %8s %12s %35s %35s\n", "calculator", "critical",
+      "critical_us", "compute_us p50/p90/p99/max",
+      "queueing_us p50/p90/p99/max");
+  for (const CriticalPathNodeData& node : nodes) {
+    output << absl::StrFormat("%-40s %7.2f%% %12d %35s %35s\n", node.name,
+                              percent(node.critical_count), node.critical_time,
+                              FormatPercentiles(node.compute_time),
+                              FormatPercentiles(node.queueing_time));
+  }
+
+  output << absl::StrFormat("\n%-60s %8s %35s\n", "stream", "critical",
+                            "slack_us p50/p90/p99/max");
+  for (const CriticalPathEdgeData& edge : edges) {
+    const std::string name = absl::StrFormat(
+        "%s -> %s (%s)", edge.producer, edge.consumer, edge.stream);
+    output << absl::StrFormat("%-60s %7.2f%% %35s\n", name,
+                              percent(edge.critical_count),
+                              FormatPercentiles(edge.slack));
+  }
+}
+
+}  // namespace reporter
+}  // namespace mediapipe
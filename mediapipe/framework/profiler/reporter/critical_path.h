@@ -0,0 +1,162 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_PROFILER_REPORTER_CRITICAL_PATH_H_
+#define MEDIAPIPE_FRAMEWORK_PROFILER_REPORTER_CRITICAL_PATH_H_
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "mediapipe/framework/calculator_profile.pb.h"
+
+namespace mediapipe {
+namespace reporter {
+
+// Percentiles of a set of durations in microseconds.
+struct Percentiles {
+  int count = 0;
+  int64_t p50 = 0;
+  int64_t p90 = 0;
+  int64_t p99 = 0;
+  int64_t max = 0;
+
+  // Computes the nearest-rank percentiles of "values".
+  static Percentiles Of(std::vector<int64_t> values);
+};
+
+// The critical path through the calculators run for one input timestamp.
+struct TimestampPath {
+  // The input timestamp of the Process() calls.
+  int64_t timestamp = 0;
+
+  // The time from the arrival of the first input packet on the path to the
+  // end of the last Process() call of the timestamp.
+  int64_t latency = 0;
+
+  // The calculators on the critical path, from source to sink.
+  std::vector<std::string> path;
+};
+
+// The timing of one calculator, over all the analyzed timestamps.
+struct CriticalPathNodeData {
+  std::string name;
+
+  // The number of timestamps for which the calculator ran Process(), and the
+  // number of those for which it was on the critical path.
+  int timestamp_count = 0;
+  int critical_count = 0;
+
+  // The time spent in Process().
+  Percentiles compute_time;
+
+  // The time from the arrival of the last input packet to the start of
+  // Process(), i.e. waiting for the scheduler or for a busy calculator.
+  Percentiles queueing_time;
+
+  // The queueing and compute time spent on the critical path, summed over all
+  // timestamps.
+  int64_t critical_time = 0;
+};
+
+// The timing of the packets sent over one stream between two calculators.
+struct CriticalPathEdgeData {
+  std::string producer;
+  std::string consumer;
+  std::string stream;
+
+  // The number of packets sent, and the number of those on the critical path.
+  int packet_count = 0;
+  int critical_count = 0;
+
+  // The time between the arrival of a packet and the arrival of the last
+  // input packet of the consumer, i.e. how much later the packet could have
+  // arrived without delaying the consumer. Zero on the critical path.
+  Percentiles slack;
+};
+
+// The results of a CriticalPathAnalyzer.
+struct CriticalPathReport {
+  // The end-to-end latency of the timestamps.
+  Percentiles latency;
+
+  // The critical path of each timestamp, ordered by timestamp.
+  std::vector<TimestampPath> timestamps;
+
+  // The number of timestamps for each distinct critical path.
+  std::map<std::vector<std::string>, int> path_counts;
+
+  // The calculators, ordered by decreasing critical_time.
+  std::vector<CriticalPathNodeData> nodes;
+
+  // The streams between calculators, ordered by producer and consumer.
+  std::vector<CriticalPathEdgeData> edges;
+
+  // Prints the latency, the "max_paths" most frequent critical paths, and the
+  // node and edge statistics.
+  void Print(std::ostream& output, int max_paths = 5) const;
+};
+
+// Finds the chain of calculators that bounds the latency of each input
+// timestamp in GraphTraces recorded by GraphTracer::GetTrace.
+//
+// For each input timestamp, the Process() calls form a DAG whose edges are the
+// packets passed between them. A call is ready once its last input packet
+// arrived, so the critical path follows the last-arriving input packet back
+// from the call that finished last. Each call spends its time queueing, from
+// becoming ready until Process() starts, and computing, until Process()
+// returns.
+//
+// The analyzer needs traces with both start and finish times, so it ignores
+// the instant events of trace_log_instant_events.
+class CriticalPathAnalyzer {
+ public:
+  // Adds the PROCESS events of the graph traces of a GraphProfile. Process()
+  // calls split across successive graph traces are joined.
+  void Accumulate(const GraphProfile& profile);
+
+  // Computes the critical paths and their statistics.
+  CriticalPathReport Analyze() const;
+
+ private:
+  // A packet received by a Process() call.
+  struct Input {
+    std::string stream;
+    int64_t packet_timestamp = 0;
+    // The time the packet was output, or -1 if unknown.
+    int64_t arrival_time = -1;
+  };
+
+  // A Process() call, with absolute times and timestamps.
+  struct Call {
+    std::string node;
+    int64_t timestamp = 0;
+    int64_t start_time = -1;
+    int64_t finish_time = -1;
+    std::vector<Input> inputs;
+    // The output packets, as stream name and packet timestamp.
+    std::vector<std::pair<std::string, int64_t>> outputs;
+  };
+
+  // Process() calls indexed by calculator name and input timestamp.
+  std::map<std::tuple<std::string, int64_t>, Call> calls_;
+};
+
+}  // namespace reporter
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_PROFILER_REPORTER_CRITICAL_PATH_H_
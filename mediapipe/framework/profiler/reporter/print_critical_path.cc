@@ -0,0 +1,54 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+// Prints the critical paths of the graph traces in MediaPipe trace files.
+
+#include <fstream>
+#include <iostream>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/flags/usage.h"
+#include "mediapipe/framework/calculator_profile.pb.h"
+#include "mediapipe/framework/port/advanced_proto_inc.h"
+#include "mediapipe/framework/profiler/reporter/critical_path.h"
+
+ABSL_FLAG(std::vector<std::string>, logfiles, {},
+          "comma-separated list of .binarypb files to process.");
+ABSL_FLAG(int, max_paths, 5, "number of most frequent critical paths to show.");
+
+using mediapipe::reporter::CriticalPathAnalyzer;
+
+// The command line utility to find the calculators that bound the end-to-end
+// latency of a graph.
+int main(int argc, char** argv) {
+  absl::SetProgramUsageMessage(
+      "Display the critical paths from MediaPipe log files.");
+  absl::ParseCommandLine(argc, argv);
+
+  CriticalPathAnalyzer analyzer;
+  for (const auto& file_name : absl::GetFlag(FLAGS_logfiles)) {
+    std::ifstream ifs(file_name.c_str(), std::ifstream::in);
+    mediapipe::proto_ns::io::IstreamInputStream isis(&ifs);
+    mediapipe::proto_ns::io::CodedInputStream coded_input_stream(&isis);
+    mediapipe::GraphProfile proto;
+    if (!proto.ParseFromCodedStream(&coded_input_stream)) {
+      std::cerr << "Failed to parse proto: " << file_name << "\n";
+      return 1;
+    }
+    analyzer.Accumulate(proto);
+  }
+  analyzer.Analyze().Print(std::cout, absl::GetFlag(FLAGS_max_paths));
+  return 0;
+}
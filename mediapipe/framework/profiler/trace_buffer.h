@@ -19,6 +19,7 @@
 #include "mediapipe/framework/calculator_profile.pb.h"
 #include "mediapipe/framework/packet.h"
 #include "mediapipe/framework/profiler/circular_buffer.h"
+#include "mediapipe/framework/profiler/per_thread_circular_buffer.h"
 #include "mediapipe/framework/timestamp.h"
 
 namespace mediapipe {
@@ -109,11 +110,15 @@ struct TraceEvent {
   static constexpr EventType TPU_TASK = GraphTrace::TPU_TASK;
   static constexpr EventType GPU_CALIBRATION = GraphTrace::GPU_CALIBRATION;
   static constexpr EventType PACKET_QUEUED = GraphTrace::PACKET_QUEUED;
+  static constexpr EventType DEADLINE_EXCEEDED = GraphTrace::DEADLINE_EXCEEDED;
 };
 
 // Packet trace log buffer.
 using TraceBuffer = CircularBuffer<TraceEvent>;
 
+// Packet trace log buffer with a separate ring for each writing thread.
+using PerThreadTraceBuffer = PerThreadCircularBuffer<TraceEvent>;
+
 // TraceEvent type traits.
 class TraceEventType {
   using EventType = TraceEvent::EventType;
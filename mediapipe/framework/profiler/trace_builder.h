@@ -16,6 +16,7 @@
 #define MEDIAPIPE_FRAMEWORK_PROFILER_TRACE_BUILDER_H_
 
 #include <string>
+#include <vector>
 
 #include "mediapipe/framework/calculator_profile.pb.h"
 #include "mediapipe/framework/profiler/trace_buffer.h"
@@ -43,6 +44,15 @@ class TraceBuilder {
   void CreateLog(const TraceBuffer& buffer, absl::Time begin_time,
                  absl::Time end_time, GraphTrace* result);
 
+  // The same as above, for the events of a PerThreadTraceBuffer merged in
+  // order of event_time.
+  static Timestamp TimestampAfter(const std::vector<TraceEvent>& events,
+                                  absl::Time begin_time);
+  void CreateTrace(const std::vector<TraceEvent>& events, absl::Time begin_time,
+                   absl::Time end_time, GraphTrace* result);
+  void CreateLog(const std::vector<TraceEvent>& events, absl::Time begin_time,
+                 absl::Time end_time, GraphTrace* result);
+
   // Resets the TraceBuilder to begin building a new trace.
   void Clear();
 
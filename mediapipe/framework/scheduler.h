@@ -147,6 +147,9 @@ class Scheduler {
 
   void SetHasError(bool error) { shared_.has_error = error; }
 
+  // Returns the deadlines of the input timestamps of the graph run.
+  TimestampDeadlines* GetTimestampDeadlines() { return &shared_.deadlines; }
+
   // Notifies the scheduler that a packet was added to a graph input stream.
   // The scheduler needs to check whether it is still deadlocked, and
   // unthrottle again if so.
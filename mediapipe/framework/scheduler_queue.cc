@@ -14,10 +14,13 @@
 
 #include "mediapipe/framework/scheduler_queue.h"
 
+#include <functional>
 #include <memory>
 #include <queue>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 
+#include "absl/memory/memory.h"
 #include "absl/synchronization/mutex.h"
 #include "mediapipe/framework/calculator_node.h"
 #include "mediapipe/framework/executor.h"
@@ -34,8 +37,9 @@
 namespace mediapipe {
 namespace internal {
 
-SchedulerQueue::Item::Item(CalculatorNode* node, CalculatorContext* cc)
-    : node_(node), cc_(cc) {
+SchedulerQueue::Item::Item(CalculatorNode* node, CalculatorContext* cc,
+                           absl::Time deadline)
+    : deadline_(deadline), node_(node), cc_(cc) {
   CHECK(node);
   CHECK(cc);
   is_source_ = node->IsSource();
@@ -81,6 +85,8 @@ bool SchedulerQueue::Item::operator<(const SchedulerQueue::Item& that) const {
   } else {
     // Non-sources run before sources.
     if (that.is_source_) return false;
+    // Later deadlines run after earlier deadlines.
+    if (deadline_ != that.deadline_) return deadline_ > that.deadline_;
     // For non-sources, higher ids run before lower ids.
     return id_ < that.id_;
   }
@@ -93,7 +99,16 @@ void SchedulerQueue::Reset() {
   running_count_ = 0;
 }
 
-void SchedulerQueue::SetExecutor(Executor* executor) { executor_ = executor; }
+void SchedulerQueue::SetExecutor(Executor* executor) {
+  executor_ = executor;
+  shards_.clear();
+  const int num_shards = executor->num_local_queues();
+  if (num_shards > 1) {
+    for (int i = 0; i < num_shards; ++i) {
+      shards_.push_back(absl::make_unique<Shard>());
+    }
+  }
+}
 
 bool SchedulerQueue::IsIdle() {
   VLOG(3) << "Scheduler queue empty: " << queue_.empty()
@@ -101,10 +116,56 @@ bool SchedulerQueue::IsIdle() {
   return queue_.empty() && num_pending_tasks_ == 0;
 }
 
+int SchedulerQueue::LocalShardIndex() {
+  const int num_shards = shards_.size();
+  int index = executor_->CurrentLocalQueueIndex();
+  if (index < 0 || index >= num_shards) {
+    // Threads that are not workers of the executor, such as the thread that
+    // adds packets to the graph, are spread over the shards by thread id.
+    index = std::hash<std::thread::id>()(std::this_thread::get_id()) %
+            num_shards;
+  }
+  return index;
+}
+
+SchedulerQueue::Item SchedulerQueue::PopItemFromShards() {
+  const int num_shards = shards_.size();
+  const int start = LocalShardIndex();
+  for (int i = 0; i < num_shards; ++i) {
+    Shard& shard = *shards_[(start + i) % num_shards];
+    absl::MutexLock lock(&shard.mutex);
+    if (!shard.queue.empty()) {
+      Item item = shard.queue.top();
+      shard.queue.pop();
+      return item;
+    }
+  }
+  // Every submitted task has a matching item in some shard, pushed before the
+  // task was submitted, but the scan above can miss it: it may have been
+  // pushed to a shard we had already scanned while another worker took the
+  // item we were about to steal. Holding all the shard locks, in index order,
+  // stops other workers from popping, so the item can't be missed again.
+  std::vector<std::unique_ptr<absl::MutexLock>> locks;
+  locks.reserve(num_shards);
+  for (const auto& shard : shards_) {
+    locks.push_back(absl::make_unique<absl::MutexLock>(&shard->mutex));
+  }
+  for (int i = 0; i < num_shards; ++i) {
+    Shard& shard = *shards_[(start + i) % num_shards];
+    shard.mutex.AssertHeld();
+    if (!shard.queue.empty()) {
+      Item item = shard.queue.top();
+      shard.queue.pop();
+      return item;
+    }
+  }
+  LOG(FATAL) << "Called RunNextTask when the queue is empty. "
+                "This should not happen.";
+}
+
 void SchedulerQueue::SetRunning(bool running) {
-  absl::MutexLock lock(&mutex_);
-  running_count_ += running ? 1 : -1;
-  DCHECK_LE(running_count_, 1);
+  const int running_count = running_count_ += running ? 1 : -1;
+  DCHECK_LE(running_count, 1);
 }
 
 void SchedulerQueue::AddNode(CalculatorNode* node, CalculatorContext* cc) {
@@ -120,7 +181,12 @@ void SchedulerQueue::AddNode(CalculatorNode* node, CalculatorContext* cc) {
     CHECK(node->IsSource()) << node->DebugName();
     return;
   }
-  AddItemToQueue(Item(node, cc));
+  if (node->IsSource()) {
+    AddItemToQueue(Item(node, cc));
+  } else {
+    AddItemToQueue(
+        Item(node, cc, shared_->deadlines.GetDeadline(cc->InputTimestamp())));
+  }
 }
 
 void SchedulerQueue::AddNodeForOpen(CalculatorNode* node) {
@@ -131,6 +197,10 @@ void SchedulerQueue::AddNodeForOpen(CalculatorNode* node) {
 }
 
 void SchedulerQueue::AddItemToQueue(Item&& item) {
+  if (!shards_.empty()) {
+    AddItemToShards(std::move(item));
+    return;
+  }
   const CalculatorNode* node = item.Node();
   bool was_idle;
   int tasks_to_add = 0;
@@ -161,9 +231,34 @@ void SchedulerQueue::AddItemToQueue(Item&& item) {
   }
 }
 
+void SchedulerQueue::AddItemToShards(Item&& item) {
+  VLOG(4) << item.Node()->DebugName() << " was added to the scheduler queue.";
+  // The item is counted before it can be popped: a task submitted for another
+  // item may steal it, and must not see the queue as idle when it completes.
+  // Only the transition from 0 items makes the queue active, and the queue
+  // only becomes idle once the task submitted below has completed, so every
+  // idle_callback_(true) follows its idle_callback_(false).
+  const bool was_idle = num_sharded_items_.fetch_add(1) == 0;
+  // The item must be in a shard before a task is submitted for it below.
+  {
+    Shard& shard = *shards_[LocalShardIndex()];
+    absl::MutexLock lock(&shard.mutex);
+    shard.queue.push(std::move(item));
+  }
+  ++num_tasks_to_add_;
+  const int tasks_to_add =
+      running_count_ > 0 ? GetTasksToSubmitToExecutor() : 0;
+  if (was_idle && idle_callback_) {
+    // Became not idle.
+    idle_callback_(false);
+  }
+  for (int i = 0; i < tasks_to_add; ++i) {
+    executor_->AddTask(this);
+  }
+}
+
 int SchedulerQueue::GetTasksToSubmitToExecutor() {
-  int tasks_to_add = num_tasks_to_add_;
-  num_tasks_to_add_ = 0;
+  const int tasks_to_add = num_tasks_to_add_.exchange(0);
   num_pending_tasks_ += tasks_to_add;
   return tasks_to_add;
 }
@@ -173,11 +268,8 @@ void SchedulerQueue::SubmitWaitingTasksToExecutor() {
   // we do not immediately submit tasks to the executor. Here we check for any
   // such waiting tasks, and submit them.
   int tasks_to_add = 0;
-  {
-    absl::MutexLock lock(&mutex_);
-    if (running_count_ > 0) {
-      tasks_to_add = GetTasksToSubmitToExecutor();
-    }
+  if (running_count_ > 0) {
+    tasks_to_add = GetTasksToSubmitToExecutor();
   }
   while (tasks_to_add > 0) {
     executor_->AddTask(this);
@@ -189,7 +281,14 @@ void SchedulerQueue::RunNextTask() {
   CalculatorNode* node;
   CalculatorContext* calculator_context;
   bool is_open_node;
-  {
+  if (!shards_.empty()) {
+    Item item = PopItemFromShards();
+    node = item.Node();
+    calculator_context = item.Context();
+    is_open_node = item.IsOpenNode();
+    CHECK(!node->Closed())
+        << "Scheduled a node that was closed. This should not happen.";
+  } else {
     absl::MutexLock lock(&mutex_);
 
     CHECK(!queue_.empty()) << "Called RunNextTask when the queue is empty. "
@@ -219,7 +318,11 @@ void SchedulerQueue::RunNextTask() {
   }
 
   bool is_idle;
-  {
+  if (!shards_.empty()) {
+    const int num_pending_tasks = num_pending_tasks_--;
+    DCHECK_GT(num_pending_tasks, 0);
+    is_idle = num_sharded_items_.fetch_sub(1) == 1;
+  } else {
     absl::MutexLock lock(&mutex_);
     DCHECK_GT(num_pending_tasks_, 0);
     --num_pending_tasks_;
@@ -298,13 +401,25 @@ void SchedulerQueue::CleanupAfterRun() {
   bool was_idle;
   {
     absl::MutexLock lock(&mutex_);
-    was_idle = IsIdle();
-    CHECK_EQ(num_pending_tasks_, 0);
-    CHECK_EQ(num_tasks_to_add_, queue_.size());
+    CHECK_EQ(num_pending_tasks_.load(), 0);
+    if (shards_.empty()) {
+      was_idle = IsIdle();
+      CHECK_EQ(num_tasks_to_add_.load(), static_cast<int>(queue_.size()));
+    } else {
+      was_idle = num_sharded_items_ == 0;
+      CHECK_EQ(num_tasks_to_add_.load(), num_sharded_items_.load());
+    }
     num_tasks_to_add_ = 0;
     while (!queue_.empty()) {
       queue_.pop();
     }
+    num_sharded_items_ = 0;
+    for (auto& shard : shards_) {
+      absl::MutexLock shard_lock(&shard->mutex);
+      while (!shard->queue.empty()) {
+        shard->queue.pop();
+      }
+    }
   }
   if (!was_idle && idle_callback_) {
     // Became idle.
@@ -20,9 +20,11 @@
 #include <memory>
 #include <queue>
 #include <utility>
+#include <vector>
 
 #include "absl/base/macros.h"
 #include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
 #include "mediapipe/framework/calculator_context.h"
 #include "mediapipe/framework/executor.h"
 #include "mediapipe/framework/port/integral_types.h"
@@ -45,7 +47,9 @@ class SchedulerQueue : public TaskQueue {
   // Item in the queue. Wraps a node pointer and helps with priority sorting.
   class Item {
    public:
-    Item(CalculatorNode* node, CalculatorContext* cc);
+    // "deadline" is the deadline of the input timestamp of "cc", if any.
+    Item(CalculatorNode* node, CalculatorContext* cc,
+         absl::Time deadline = absl::InfiniteFuture());
     // A null CalculatorContext indicates the task should run OpenNode().
     Item(CalculatorNode* node);
 
@@ -62,12 +66,14 @@ class SchedulerQueue : public TaskQueue {
     // - Sources are sorted by layer (lower layer numbers run first), then by
     //   Calculator::SourceProcessOrder (smaller values run first), then by
     //   node id: smaller ids run first, since they come earlier in the config.
-    // - Non-sources are sorted by node id: larger ids run first, because they
-    //   are closer to the leaves.
+    // - Non-sources are sorted by the deadline of their input timestamp
+    //   (earlier deadlines run first), then by node id: larger ids run first,
+    //   because they are closer to the leaves.
     bool operator<(const Item& that) const;
 
    private:
     int64 source_process_order_ = 0;
+    absl::Time deadline_ = absl::InfiniteFuture();
     CalculatorNode* node_;
     CalculatorContext* cc_;
     int id_ = 0;
@@ -79,7 +85,9 @@ class SchedulerQueue : public TaskQueue {
   explicit SchedulerQueue(SchedulerShared* shared) : shared_(shared) {}
 
   // Sets the executor that will run the nodes. Must be called before the
-  // scheduler is started.
+  // scheduler is started. If the executor keeps one task queue per worker
+  // thread (see Executor::num_local_queues), the scheduler queue keeps one
+  // priority queue per worker as well.
   void SetExecutor(Executor* executor);
 
   // Sets the idle callback. It is called exactly once whenever the queue goes
@@ -110,8 +118,8 @@ class SchedulerQueue : public TaskQueue {
   // Gets the number of tasks that need to be submitted to the executor, and
   // updates num_pending_tasks_. If this method is called and returns a
   // non-zero value, the executor's AddTask method *must* be called for each
-  // task returned, but it can be called without holding the lock.
-  int GetTasksToSubmitToExecutor() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // task returned.
+  int GetTasksToSubmitToExecutor();
 
   // Submits tasks that are waiting (e.g. that were added while the queue was
   // not running) if the queue is running. The caller must not hold any mutex.
@@ -143,28 +151,63 @@ class SchedulerQueue : public TaskQueue {
   void OpenCalculatorNode(CalculatorNode* node) ABSL_LOCKS_EXCLUDED(mutex_);
 
   // Checks whether the queue has no queued nodes or pending tasks.
+  // Only used without shards_, which track idleness with num_sharded_items_.
   bool IsIdle() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // A priority queue of nodes made ready by one worker of a work-stealing
+  // executor.
+  struct Shard {
+    absl::Mutex mutex;
+    std::priority_queue<Item> queue ABSL_GUARDED_BY(mutex);
+  };
+
+  // Returns the index of the shard owned by the calling thread.
+  int LocalShardIndex();
+
+  // Pops the highest priority item of the calling thread's shard, or steals
+  // the highest priority item of another shard if the local one is empty.
+  // REQUIRES: a task has been submitted for an item that was not popped yet.
+  Item PopItemFromShards();
+
+  // Adds "item" to the shard of the calling thread, and submits a task for
+  // it if the queue is running. Doesn't lock mutex_.
+  void AddItemToShards(Item&& item);
+
   Executor* executor_ = nullptr;
 
   IdleCallback idle_callback_;
 
+  // The counters below are atomic so that the sharded queue never needs to
+  // lock mutex_ to add or run an item.
+
   // The net number of times SetRunning(true) has been called.
   // SetRunning(true) increments running_count_ and SetRunning(false)
   // decrements it. The queue is running if running_count_ > 0. A running
   // queue will submit tasks to the executor.
   // Invariant: running_count_ <= 1.
-  int running_count_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::atomic<int> running_count_{0};
 
   // Number of tasks added to the Executor and not yet complete.
-  int num_pending_tasks_ ABSL_GUARDED_BY(mutex_);
+  std::atomic<int> num_pending_tasks_{0};
 
-  // Number of tasks that need to be added to the Executor.
-  int num_tasks_to_add_ ABSL_GUARDED_BY(mutex_);
+  // Number of tasks that need to be added to the Executor. Incremented before
+  // running_count_ is checked, and taken after it is set, so that a task is
+  // never left behind by a concurrent SetRunning(true).
+  std::atomic<int> num_tasks_to_add_{0};
 
   // Queue of nodes that need to be run.
   std::priority_queue<Item> queue_ ABSL_GUARDED_BY(mutex_);
 
+  // Per-worker queues of nodes that need to be run. Used instead of queue_
+  // when the executor keeps per-worker task queues, so that workers only
+  // contend on the shard they push to or pop from.
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Number of items in shards_, including items that have been popped by a
+  // task that has not completed yet. The queue becomes active when it goes
+  // from 0 to 1, and idle when it goes back to 0.
+  std::atomic<int> num_sharded_items_{0};
+
   SchedulerShared* const shared_;
 
   absl::Mutex mutex_;
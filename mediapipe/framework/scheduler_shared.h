@@ -27,6 +27,7 @@
 #include "mediapipe/framework/deps/monotonic_clock.h"
 #include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/timestamp_deadlines.h"
 
 namespace mediapipe {
 namespace internal {
@@ -108,6 +109,8 @@ struct SchedulerShared {
   std::function<void(const absl::Status& error)> error_callback;
   // Collects timing information for measuring overhead.
   internal::SchedulerTimer timer;
+  // The deadlines of the input timestamps.
+  TimestampDeadlines deadlines;
 };
 
 }  // namespace internal
@@ -0,0 +1,235 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_SPSC_QUEUE_H_
+#define MEDIAPIPE_FRAMEWORK_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/logging.h"
+
+namespace mediapipe {
+
+// An unbounded lock-free queue for exactly one producer thread and exactly
+// one consumer thread.
+//
+// Elements are stored in ring buffer segments. When the producer finds the
+// current segment full it links a new segment of twice the capacity, so a push
+// never blocks and never fails. The consumer frees a segment once it has been
+// drained and the producer has moved on to the next one. In steady state the
+// queue doesn't allocate.
+//
+// Push() may only be called by the producer, Empty(), Front() and Pop() only
+// by the consumer. Size() may be called from any thread and is exact only
+// when called by the producer or the consumer while the other side is idle.
+// "One producer thread" means the producer calls are serialized with a
+// happens-before relation between them, they don't need to come from the
+// same OS thread. The same holds for the consumer.
+//
+// The counters used by Size() and Empty() are updated with sequentially
+// consistent operations. A producer that pushes and then reads Size() and a
+// consumer that pops and then reads Size() can't both miss each other's
+// update, which lets callers decide reliably who has to signal whom.
+template <typename T>
+class SpscQueue {
+ public:
+  // "initial_capacity" must be a power of two.
+  explicit SpscQueue(int64 initial_capacity = 16);
+  ~SpscQueue();
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Appends "value" to the queue. Producer only.
+  void Push(T value);
+
+  // Returns true if the queue is empty. Consumer only.
+  bool Empty() const;
+
+  // Returns the element at the front of the queue, or nullptr if the queue is
+  // empty. The element stays valid until the next Pop(). Consumer only.
+  T* Front();
+
+  // Removes the element at the front of the queue, which must not be empty.
+  // Consumer only.
+  void Pop();
+
+  // Returns the number of elements in the queue.
+  int64 Size() const;
+
+  // Removes all the elements. Must not be called concurrently with any other
+  // method.
+  void Clear();
+
+ private:
+  struct Segment {
+    explicit Segment(int64 capacity)
+        : capacity(capacity), slots(new T[capacity]) {}
+
+    const int64 capacity;
+    std::unique_ptr<T[]> slots;
+    // Index of the next element to pop, written by the consumer.
+    alignas(64) std::atomic<int64> head{0};
+    // The producer's last observed value of "head".
+    int64 cached_head = 0;
+    // Index of the next element to push, written by the producer.
+    alignas(64) std::atomic<int64> tail{0};
+    // The consumer's last observed value of "tail".
+    int64 cached_tail = 0;
+    // The segment the producer moved on to once this one was full.
+    std::atomic<Segment*> next{nullptr};
+  };
+
+  // Returns the segment holding the front element, freeing the drained
+  // segments before it. Consumer only.
+  Segment* FrontSegment();
+
+  // The segment the consumer pops from.
+  alignas(64) Segment* head_segment_;
+  std::atomic<int64> num_popped_{0};
+  // The segment the producer pushes to.
+  alignas(64) Segment* tail_segment_;
+  std::atomic<int64> num_pushed_{0};
+};
+
+template <typename T>
+SpscQueue<T>::SpscQueue(int64 initial_capacity) {
+  // Capacities are powers of two so that slots can be indexed by masking.
+  CHECK_GT(initial_capacity, 0);
+  CHECK_EQ(initial_capacity & (initial_capacity - 1), 0)
+      << "SpscQueue capacity must be a power of two.";
+  head_segment_ = tail_segment_ = new Segment(initial_capacity);
+}
+
+template <typename T>
+SpscQueue<T>::~SpscQueue() {
+  Segment* segment = head_segment_;
+  while (segment) {
+    Segment* next = segment->next.load(std::memory_order_relaxed);
+    delete segment;
+    segment = next;
+  }
+}
+
+template <typename T>
+void SpscQueue<T>::Push(T value) {
+  Segment* segment = tail_segment_;
+  const int64 tail = segment->tail.load(std::memory_order_relaxed);
+  if (tail - segment->cached_head == segment->capacity) {
+    segment->cached_head = segment->head.load(std::memory_order_acquire);
+    if (tail - segment->cached_head == segment->capacity) {
+      Segment* next = new Segment(segment->capacity * 2);
+      next->slots[0] = std::move(value);
+      next->tail.store(1, std::memory_order_relaxed);
+      // Publishes the new segment together with its first element.
+      segment->next.store(next, std::memory_order_release);
+      tail_segment_ = next;
+      num_pushed_.fetch_add(1);
+      return;
+    }
+  }
+  segment->slots[tail & (segment->capacity - 1)] = std::move(value);
+  segment->tail.store(tail + 1, std::memory_order_release);
+  num_pushed_.fetch_add(1);
+}
+
+template <typename T>
+bool SpscQueue<T>::Empty() const {
+  return num_pushed_.load() == num_popped_.load(std::memory_order_relaxed);
+}
+
+template <typename T>
+typename SpscQueue<T>::Segment* SpscQueue<T>::FrontSegment() {
+  while (true) {
+    Segment* segment = head_segment_;
+    const int64 head = segment->head.load(std::memory_order_relaxed);
+    if (head != segment->cached_tail) {
+      return segment;
+    }
+    segment->cached_tail = segment->tail.load(std::memory_order_acquire);
+    if (head != segment->cached_tail) {
+      return segment;
+    }
+    Segment* next = segment->next.load(std::memory_order_acquire);
+    if (!next) {
+      return nullptr;
+    }
+    // The producer no longer writes to this segment, but it may have filled
+    // it up between our two loads above.
+    segment->cached_tail = segment->tail.load(std::memory_order_acquire);
+    if (head != segment->cached_tail) {
+      return segment;
+    }
+    head_segment_ = next;
+    delete segment;
+  }
+}
+
+template <typename T>
+T* SpscQueue<T>::Front() {
+  Segment* segment = FrontSegment();
+  if (!segment) {
+    return nullptr;
+  }
+  const int64 head = segment->head.load(std::memory_order_relaxed);
+  return &segment->slots[head & (segment->capacity - 1)];
+}
+
+template <typename T>
+void SpscQueue<T>::Pop() {
+  Segment* segment = FrontSegment();
+  CHECK(segment) << "Pop() called on an empty SpscQueue.";
+  const int64 head = segment->head.load(std::memory_order_relaxed);
+  // Releases whatever the element holds before the slot is reused.
+  segment->slots[head & (segment->capacity - 1)] = T();
+  segment->head.store(head + 1, std::memory_order_release);
+  num_popped_.fetch_add(1);
+}
+
+template <typename T>
+int64 SpscQueue<T>::Size() const {
+  // Loads num_popped_ first so that the result can't be negative.
+  const int64 num_popped = num_popped_.load();
+  return num_pushed_.load() - num_popped;
+}
+
+template <typename T>
+void SpscQueue<T>::Clear() {
+  // Keeps the last, largest segment so that the queue doesn't have to grow
+  // again when it is reused.
+  while (head_segment_ != tail_segment_) {
+    Segment* next = head_segment_->next.load(std::memory_order_relaxed);
+    delete head_segment_;
+    head_segment_ = next;
+  }
+  Segment* segment = tail_segment_;
+  const int64 tail = segment->tail.load(std::memory_order_relaxed);
+  for (int64 i = segment->head.load(std::memory_order_relaxed); i < tail;
+       ++i) {
+    segment->slots[i & (segment->capacity - 1)] = T();
+  }
+  segment->head.store(0, std::memory_order_relaxed);
+  segment->tail.store(0, std::memory_order_relaxed);
+  segment->cached_head = 0;
+  segment->cached_tail = 0;
+  num_pushed_.store(0);
+  num_popped_.store(0);
+}
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_SPSC_QUEUE_H_
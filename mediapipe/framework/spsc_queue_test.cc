@@ -0,0 +1,111 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/framework/spsc_queue.h"
+
+#include <memory>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+TEST(SpscQueueTest, FirstInFirstOut) {
+  SpscQueue<int> queue(4);
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_EQ(queue.Front(), nullptr);
+  for (int i = 0; i < 3; ++i) {
+    queue.Push(i);
+  }
+  EXPECT_FALSE(queue.Empty());
+  EXPECT_EQ(queue.Size(), 3);
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_NE(queue.Front(), nullptr);
+    EXPECT_EQ(*queue.Front(), i);
+    queue.Pop();
+  }
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_EQ(queue.Size(), 0);
+}
+
+TEST(SpscQueueTest, GrowsBeyondInitialCapacity) {
+  SpscQueue<int> queue(2);
+  // Interleaves pushes and pops so that the elements wrap around the
+  // segments before new ones are linked.
+  int next_pop = 0;
+  for (int i = 0; i < 100; ++i) {
+    queue.Push(i);
+    if (i % 3 == 0) {
+      ASSERT_EQ(*queue.Front(), next_pop++);
+      queue.Pop();
+    }
+  }
+  EXPECT_EQ(queue.Size(), 100 - next_pop);
+  while (!queue.Empty()) {
+    ASSERT_EQ(*queue.Front(), next_pop++);
+    queue.Pop();
+  }
+  EXPECT_EQ(next_pop, 100);
+}
+
+TEST(SpscQueueTest, PopReleasesElement) {
+  SpscQueue<std::shared_ptr<int>> queue;
+  auto value = std::make_shared<int>(1);
+  queue.Push(value);
+  EXPECT_EQ(value.use_count(), 2);
+  queue.Pop();
+  EXPECT_EQ(value.use_count(), 1);
+}
+
+TEST(SpscQueueTest, Clear) {
+  SpscQueue<std::shared_ptr<int>> queue(2);
+  auto value = std::make_shared<int>(1);
+  for (int i = 0; i < 5; ++i) {
+    queue.Push(value);
+  }
+  queue.Clear();
+  EXPECT_EQ(value.use_count(), 1);
+  EXPECT_TRUE(queue.Empty());
+  EXPECT_EQ(queue.Front(), nullptr);
+  queue.Push(value);
+  EXPECT_EQ(queue.Size(), 1);
+  EXPECT_EQ(*queue.Front(), value);
+}
+
+TEST(SpscQueueTest, ConcurrentProducerAndConsumer) {
+  constexpr int kNumElements = 100000;
+  SpscQueue<int> queue(8);
+  std::thread producer([&queue]() {
+    for (int i = 0; i < kNumElements; ++i) {
+      queue.Push(i);
+    }
+  });
+  int expected = 0;
+  while (expected < kNumElements) {
+    int* front = queue.Front();
+    if (!front) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(*front, expected);
+    queue.Pop();
+    ++expected;
+  }
+  producer.join();
+  EXPECT_TRUE(queue.Empty());
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -65,6 +65,9 @@ class FixedSizeInputStreamHandler : public DefaultInputStreamHandler {
     // implementation of SetLatePreparation.
   }
 
+  // Packets are erased from the queues while they are added.
+  bool SupportsLockFreeQueues() const override { return false; }
+
  private:
   // Drops packets if all input streams exceed trigger_queue_size.
   void EraseAllSurplus() ABSL_EXCLUSIVE_LOCKS_REQUIRED(erase_mutex_) {
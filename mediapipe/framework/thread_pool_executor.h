@@ -23,6 +23,9 @@
 namespace mediapipe {
 
 // A multithreaded executor based on a thread pool.
+//
+// If the ThreadPoolExecutorOptions specify the WORK_STEALING scheduling
+// policy, Create returns a WorkStealingExecutor instead.
 class ThreadPoolExecutor : public Executor {
  public:
   static absl::StatusOr<Executor*> Create(
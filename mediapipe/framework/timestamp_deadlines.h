@@ -0,0 +1,92 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_TIMESTAMP_DEADLINES_H_
+#define MEDIAPIPE_FRAMEWORK_TIMESTAMP_DEADLINES_H_
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "mediapipe/framework/timestamp.h"
+
+namespace mediapipe {
+namespace internal {
+
+// The deadlines of the input timestamps of a graph run. Nodes processing an
+// input timestamp with an earlier deadline are scheduled first, and may skip
+// the input timestamp once its deadline has passed. Thread-safe.
+class TimestampDeadlines {
+ public:
+  // Sets the deadline of an input timestamp. The earliest deadline is kept.
+  void SetDeadline(Timestamp timestamp, absl::Time deadline) {
+    absl::MutexLock lock(&mutex_);
+    auto result = deadlines_.emplace(timestamp, deadline);
+    if (!result.second) {
+      result.first->second = std::min(result.first->second, deadline);
+    }
+    // Only recent timestamps are of interest, the oldest ones are forgotten.
+    if (deadlines_.size() > kMaxDeadlines) {
+      deadlines_.erase(deadlines_.begin());
+    }
+    has_deadlines_.store(true, std::memory_order_release);
+  }
+
+  // Returns the deadline of an input timestamp, or absl::InfiniteFuture() if
+  // none was set.
+  absl::Time GetDeadline(Timestamp timestamp) const {
+    if (!has_deadlines_.load(std::memory_order_acquire)) {
+      return absl::InfiniteFuture();
+    }
+    absl::MutexLock lock(&mutex_);
+    auto it = deadlines_.find(timestamp);
+    return it == deadlines_.end() ? absl::InfiniteFuture() : it->second;
+  }
+
+  // Returns true if expired input timestamps are dropped and the deadline of
+  // "timestamp" has passed.
+  bool ShouldDrop(Timestamp timestamp) const {
+    if (!drop_expired_) {
+      return false;
+    }
+    const absl::Time deadline = GetDeadline(timestamp);
+    return deadline != absl::InfiniteFuture() && deadline < absl::Now();
+  }
+
+  // Called at the beginning of each graph run.
+  void Reset(bool drop_expired) {
+    absl::MutexLock lock(&mutex_);
+    deadlines_.clear();
+    has_deadlines_.store(false, std::memory_order_release);
+    drop_expired_ = drop_expired;
+  }
+
+ private:
+  // The maximum number of input timestamps with deadlines.
+  static constexpr size_t kMaxDeadlines = 4096;
+
+  std::atomic<bool> has_deadlines_{false};
+  // Only written by Reset, before the graph run starts.
+  bool drop_expired_ = false;
+  mutable absl::Mutex mutex_;
+  std::map<Timestamp, absl::Time> deadlines_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace internal
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_TIMESTAMP_DEADLINES_H_
@@ -0,0 +1,47 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_FRAMEWORK_WORK_STEALING_EXECUTOR_H_
+#define MEDIAPIPE_FRAMEWORK_WORK_STEALING_EXECUTOR_H_
+
+#include "mediapipe/framework/deps/thread_options.h"
+#include "mediapipe/framework/deps/work_stealing_threadpool.h"
+#include "mediapipe/framework/executor.h"
+
+namespace mediapipe {
+
+// A multithreaded executor based on a work-stealing thread pool.
+//
+// This executor is created by ThreadPoolExecutor::Create when the
+// ThreadPoolExecutorOptions specify the WORK_STEALING scheduling policy.
+class WorkStealingExecutor : public Executor {
+ public:
+  WorkStealingExecutor(const ThreadOptions& thread_options, int num_threads);
+  ~WorkStealingExecutor() override;
+  void Schedule(std::function<void()> task) override;
+  int num_local_queues() const override { return thread_pool_.num_threads(); }
+  int CurrentLocalQueueIndex() const override {
+    return thread_pool_.CurrentWorkerIndex();
+  }
+
+  // For testing.
+  int num_threads() const { return thread_pool_.num_threads(); }
+
+ private:
+  WorkStealingThreadPool thread_pool_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_FRAMEWORK_WORK_STEALING_EXECUTOR_H_
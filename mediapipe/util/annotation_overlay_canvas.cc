@@ -0,0 +1,55 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/annotation_overlay_canvas.h"
+
+#include <algorithm>
+
+namespace mediapipe {
+
+cv::Mat& AnnotationOverlayCanvas::BeginFrame(int width, int height,
+                                             const cv::Scalar& background) {
+  if (canvas_.cols != width || canvas_.rows != height) {
+    canvas_.create(height, width, CV_8UC3);
+    canvas_.setTo(background);
+    dirty_region_ = cv::Rect();
+    uploaded_ = false;
+  } else if (dirty_region_.area() > 0) {
+    // Erase the annotations of the previous frame.
+    canvas_(dirty_region_).setTo(background);
+  }
+  return canvas_;
+}
+
+AnnotationOverlayCanvas::RowRange AnnotationOverlayCanvas::EndFrame(
+    const cv::Rect& dirty_region) {
+  const cv::Rect drawn_region =
+      dirty_region & cv::Rect(0, 0, canvas_.cols, canvas_.rows);
+  RowRange rows;
+  if (!uploaded_) {
+    rows.end = canvas_.rows;
+  } else {
+    rows.first = canvas_.rows;
+    for (const cv::Rect& region : {dirty_region_, drawn_region}) {
+      if (region.area() == 0) continue;
+      rows.first = std::min(rows.first, region.y);
+      rows.end = std::max(rows.end, region.y + region.height);
+    }
+  }
+  dirty_region_ = drawn_region;
+  uploaded_ = true;
+  return rows;
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,67 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_ANNOTATION_OVERLAY_CANVAS_H_
+#define MEDIAPIPE_UTIL_ANNOTATION_OVERLAY_CANVAS_H_
+
+#include "mediapipe/framework/port/opencv_core_inc.h"
+
+namespace mediapipe {
+
+// The RGB canvas that annotations are drawn on before being uploaded to an
+// overlay texture, as AnnotationOverlayCalculator does on GPU. The canvas is
+// kept between frames, so that only the region drawn on in the previous frame
+// has to be cleared, and only the rows that changed have to be uploaded.
+//
+// Example usage:
+//   cv::Mat& canvas = overlay.BeginFrame(width, height, background);
+//   renderer.AdoptImage(&canvas);
+//   renderer.RenderDataOnImage(render_data);
+//   RowRange rows = overlay.EndFrame(renderer.GetDirtyRegion());
+//   <UPLOAD ROWS [rows.first, rows.end) OF THE CANVAS>
+class AnnotationOverlayCanvas {
+ public:
+  // Rows [first, end) of the canvas.
+  struct RowRange {
+    int first = 0;
+    int end = 0;
+    bool empty() const { return first >= end; }
+  };
+
+  // Returns the canvas to draw the next frame on. The canvas is filled with
+  // "background" when it is first created or resized; otherwise only the
+  // region drawn on in the previous frame is cleared.
+  cv::Mat& BeginFrame(int width, int height, const cv::Scalar& background);
+
+  // Records "dirty_region", which contains every pixel drawn since
+  // BeginFrame(), and returns the rows that differ from the last upload: all
+  // rows after the canvas was (re)created or Reset() was called, otherwise the
+  // rows drawn on in this frame or cleared from the previous one.
+  RowRange EndFrame(const cv::Rect& dirty_region);
+
+  // Requires the next EndFrame() to upload the whole canvas, e.g. after the
+  // overlay texture was recreated.
+  void Reset() { uploaded_ = false; }
+
+ private:
+  cv::Mat canvas_;
+  // The region drawn on in the previous frame.
+  cv::Rect dirty_region_;
+  // Whether the whole canvas has been uploaded since it was created.
+  bool uploaded_ = false;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_ANNOTATION_OVERLAY_CANVAS_H_
@@ -0,0 +1,136 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/annotation_overlay_canvas.h"
+
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr int kWidth = 32;
+constexpr int kHeight = 24;
+
+const cv::Scalar kBackground(2, 2, 2);
+const cv::Scalar kColor(255, 0, 0);
+
+bool IsFilledWith(const cv::Mat& mat, const cv::Scalar& color) {
+  cv::Mat expected(mat.size(), mat.type(), color);
+  return cv::norm(mat, expected, cv::NORM_INF) == 0;
+}
+
+TEST(AnnotationOverlayCanvasTest, FirstFrameIsClearedAndFullyUploaded) {
+  AnnotationOverlayCanvas overlay;
+  cv::Mat& canvas = overlay.BeginFrame(kWidth, kHeight, kBackground);
+  ASSERT_EQ(canvas.cols, kWidth);
+  ASSERT_EQ(canvas.rows, kHeight);
+  EXPECT_EQ(canvas.type(), CV_8UC3);
+  EXPECT_TRUE(IsFilledWith(canvas, kBackground));
+
+  // The whole canvas is uploaded, even if nothing was drawn.
+  const auto rows = overlay.EndFrame(cv::Rect());
+  EXPECT_EQ(rows.first, 0);
+  EXPECT_EQ(rows.end, kHeight);
+}
+
+TEST(AnnotationOverlayCanvasTest, ClearsAndUploadsOnlyChangedRows) {
+  AnnotationOverlayCanvas overlay;
+  overlay.BeginFrame(kWidth, kHeight, kBackground);
+  overlay.EndFrame(cv::Rect());
+
+  // Frame 1 draws on rows [4, 10).
+  const cv::Rect region1(3, 4, 10, 6);
+  cv::Mat* canvas = &overlay.BeginFrame(kWidth, kHeight, kBackground);
+  (*canvas)(region1).setTo(kColor);
+  auto rows = overlay.EndFrame(region1);
+  EXPECT_EQ(rows.first, 4);
+  EXPECT_EQ(rows.end, 10);
+
+  // Frame 2 draws on rows [15, 20). The annotations of frame 1 are erased, so
+  // their rows are uploaded too.
+  const cv::Rect region2(20, 15, 5, 5);
+  canvas = &overlay.BeginFrame(kWidth, kHeight, kBackground);
+  EXPECT_TRUE(IsFilledWith(*canvas, kBackground));
+  (*canvas)(region2).setTo(kColor);
+  rows = overlay.EndFrame(region2);
+  EXPECT_EQ(rows.first, 4);
+  EXPECT_EQ(rows.end, 20);
+
+  // Frame 3 draws nothing. Only the rows of frame 2 are cleared and uploaded.
+  canvas = &overlay.BeginFrame(kWidth, kHeight, kBackground);
+  EXPECT_TRUE(IsFilledWith(*canvas, kBackground));
+  rows = overlay.EndFrame(cv::Rect());
+  EXPECT_EQ(rows.first, 15);
+  EXPECT_EQ(rows.end, 20);
+
+  // Frame 4 draws nothing either, so nothing is uploaded.
+  overlay.BeginFrame(kWidth, kHeight, kBackground);
+  rows = overlay.EndFrame(cv::Rect());
+  EXPECT_TRUE(rows.empty());
+}
+
+TEST(AnnotationOverlayCanvasTest, ClearsOnlyThePreviousDirtyRegion) {
+  AnnotationOverlayCanvas overlay;
+  cv::Mat* canvas = &overlay.BeginFrame(kWidth, kHeight, kBackground);
+  // Pixels drawn outside the reported dirty region are not cleared.
+  (*canvas)(cv::Rect(0, 0, 2, 2)).setTo(kColor);
+  const cv::Rect region(10, 10, 4, 4);
+  (*canvas)(region).setTo(kColor);
+  overlay.EndFrame(region);
+
+  canvas = &overlay.BeginFrame(kWidth, kHeight, kBackground);
+  EXPECT_TRUE(IsFilledWith((*canvas)(region), kBackground));
+  EXPECT_TRUE(IsFilledWith((*canvas)(cv::Rect(0, 0, 2, 2)), kColor));
+}
+
+TEST(AnnotationOverlayCanvasTest, ClipsDirtyRegionToCanvas) {
+  AnnotationOverlayCanvas overlay;
+  overlay.BeginFrame(kWidth, kHeight, kBackground);
+  overlay.EndFrame(cv::Rect());
+
+  overlay.BeginFrame(kWidth, kHeight, kBackground);
+  auto rows = overlay.EndFrame(cv::Rect(-5, kHeight - 3, 10, 10));
+  EXPECT_EQ(rows.first, kHeight - 3);
+  EXPECT_EQ(rows.end, kHeight);
+
+  // Clearing the clipped region doesn't go out of bounds.
+  overlay.BeginFrame(kWidth, kHeight, kBackground);
+  rows = overlay.EndFrame(cv::Rect());
+  EXPECT_EQ(rows.first, kHeight - 3);
+  EXPECT_EQ(rows.end, kHeight);
+}
+
+TEST(AnnotationOverlayCanvasTest, UploadsEverythingAfterResetOrResize) {
+  AnnotationOverlayCanvas overlay;
+  overlay.BeginFrame(kWidth, kHeight, kBackground);
+  overlay.EndFrame(cv::Rect());
+
+  overlay.Reset();
+  overlay.BeginFrame(kWidth, kHeight, kBackground);
+  auto rows = overlay.EndFrame(cv::Rect());
+  EXPECT_EQ(rows.first, 0);
+  EXPECT_EQ(rows.end, kHeight);
+
+  cv::Mat& canvas = overlay.BeginFrame(kWidth * 2, kHeight * 2, kBackground);
+  EXPECT_EQ(canvas.cols, kWidth * 2);
+  EXPECT_EQ(canvas.rows, kHeight * 2);
+  EXPECT_TRUE(IsFilledWith(canvas, kBackground));
+  rows = overlay.EndFrame(cv::Rect());
+  EXPECT_EQ(rows.first, 0);
+  EXPECT_EQ(rows.end, kHeight * 2);
+}
+
+}  // namespace
+}  // namespace mediapipe
@@ -17,8 +17,10 @@
 #include <math.h>
 
 #include <algorithm>
+#include <climits>
 #include <cmath>
 
+#include "mediapipe/framework/port/integral_types.h"
 #include "mediapipe/framework/port/logging.h"
 #include "mediapipe/framework/port/vector.h"
 #include "mediapipe/util/color.pb.h"
@@ -85,11 +87,39 @@ void cv_line2(cv::Mat& img, const cv::Point& start, const cv::Point& end,
   }
 }
 
+// Returns true if the two annotations can be drawn in the same batch.
+bool HaveSameStyle(const RenderAnnotation& a, const RenderAnnotation& b) {
+  return a.data_case() == b.data_case() && a.thickness() == b.thickness() &&
+         a.color().r() == b.color().r() && a.color().g() == b.color().g() &&
+         a.color().b() == b.color().b();
+}
+
+// Largest point radius drawn with a precomputed stamp; larger points are drawn
+// one by one.
+constexpr int kMaxPointStampRadius = 64;
+
 }  // namespace
 
 void AnnotationRenderer::RenderDataOnImage(const RenderData& render_data) {
-  for (const auto& annotation : render_data.render_annotations()) {
-    if (annotation.data_case() == RenderAnnotation::kRectangle) {
+  const int num_annotations = render_data.render_annotations_size();
+  for (int i = 0; i < num_annotations; ++i) {
+    const auto& annotation = render_data.render_annotations(i);
+    if (annotation.data_case() == RenderAnnotation::kPoint ||
+        annotation.data_case() == RenderAnnotation::kLine) {
+      // Lines and points (e.g. landmarks and their connections) usually come
+      // in long runs with the same style, which are drawn together.
+      int end = i + 1;
+      while (end < num_annotations &&
+             HaveSameStyle(annotation, render_data.render_annotations(end))) {
+        ++end;
+      }
+      if (annotation.data_case() == RenderAnnotation::kPoint) {
+        DrawPoints(render_data, i, end);
+      } else {
+        DrawLines(render_data, i, end);
+      }
+      i = end - 1;
+    } else if (annotation.data_case() == RenderAnnotation::kRectangle) {
       DrawRectangle(annotation);
     } else if (annotation.data_case() == RenderAnnotation::kRoundedRectangle) {
       DrawRoundedRectangle(annotation);
@@ -104,10 +134,6 @@ void AnnotationRenderer::RenderDataOnImage(const RenderData& render_data) {
       DrawFilledOval(annotation);
     } else if (annotation.data_case() == RenderAnnotation::kText) {
       DrawText(annotation);
-    } else if (annotation.data_case() == RenderAnnotation::kPoint) {
-      DrawPoint(annotation);
-    } else if (annotation.data_case() == RenderAnnotation::kLine) {
-      DrawLine(annotation);
     } else if (annotation.data_case() == RenderAnnotation::kGradientLine) {
       DrawGradientLine(annotation);
     } else if (annotation.data_case() == RenderAnnotation::kArrow) {
@@ -124,6 +150,7 @@ void AnnotationRenderer::AdoptImage(cv::Mat* input_image) {
 
   // No pixel data copy here, only headers are copied.
   mat_image_ = *input_image;
+  dirty_region_ = cv::Rect();
 }
 
 int AnnotationRenderer::GetImageWidth() const { return mat_image_.cols; }
@@ -170,9 +197,11 @@ void AnnotationRenderer::DrawRectangle(const RenderAnnotation& annotation) {
       cv::line(mat_image_, vertices[i], vertices[(i + 1) % kNumVertices], color,
                thickness);
     }
+    MarkDirtyRect(rect.boundingRect(), thickness);
   } else {
     cv::Rect rect(left, top, right - left, bottom - top);
     cv::rectangle(mat_image_, rect, color, thickness);
+    MarkDirty({rect.tl(), rect.br()}, thickness);
   }
 }
 
@@ -210,9 +239,11 @@ void AnnotationRenderer::DrawFilledRectangle(
       vertices[i] = vertices2f[i];
     }
     cv::fillConvexPoly(mat_image_, vertices, kNumVertices, color);
+    MarkDirtyRect(rect.boundingRect(), 1);
   } else {
     cv::Rect rect(left, top, right - left, bottom - top);
     cv::rectangle(mat_image_, rect, color, -1);
+    MarkDirty({rect.tl(), rect.br()}, 1);
   }
 }
 
@@ -246,6 +277,7 @@ void AnnotationRenderer::DrawRoundedRectangle(
   DrawRoundedRectangle(mat_image_, cv::Point(left, top),
                        cv::Point(right, bottom), color, thickness, line_type,
                        corner_radius);
+  MarkDirty({cv::Point(left, top), cv::Point(right, bottom)}, thickness);
 }
 
 void AnnotationRenderer::DrawFilledRoundedRectangle(
@@ -277,6 +309,7 @@ void AnnotationRenderer::DrawFilledRoundedRectangle(
   DrawRoundedRectangle(mat_image_, cv::Point(left, top),
                        cv::Point(right, bottom), color, -1, line_type,
                        corner_radius);
+  MarkDirty({cv::Point(left, top), cv::Point(right, bottom)}, 1);
 }
 
 void AnnotationRenderer::DrawRoundedRectangle(cv::Mat src, cv::Point top_left,
@@ -349,6 +382,8 @@ void AnnotationRenderer::DrawOval(const RenderAnnotation& annotation) {
   const int thickness =
       ClampThickness(round(annotation.thickness() * scale_factor_));
   cv::ellipse(mat_image_, center, size, rotation, 0, 360, color, thickness);
+  MarkDirtyRect(cv::RotatedRect(center, size * 2, rotation).boundingRect(),
+                thickness);
 }
 
 void AnnotationRenderer::DrawFilledOval(const RenderAnnotation& annotation) {
@@ -377,6 +412,8 @@ void AnnotationRenderer::DrawFilledOval(const RenderAnnotation& annotation) {
   const double rotation = enclosing_rectangle.rotation() / M_PI * 180.f;
   const cv::Scalar color = MediapipeColorToOpenCVColor(annotation.color());
   cv::ellipse(mat_image_, center, size, rotation, 0, 360, color, -1);
+  MarkDirtyRect(cv::RotatedRect(center, size * 2, rotation).boundingRect(),
+                1);
 }
 
 void AnnotationRenderer::DrawArrow(const RenderAnnotation& annotation) {
@@ -427,6 +464,9 @@ void AnnotationRenderer::DrawArrow(const RenderAnnotation& annotation) {
                                  static_cast<int>(round(arrowtip_right[1])));
   cv::line(mat_image_, arrowtip_left_start, arrow_end, color, thickness);
   cv::line(mat_image_, arrowtip_right_start, arrow_end, color, thickness);
+  MarkDirty(
+      {arrow_start, arrow_end, arrowtip_left_start, arrowtip_right_start},
+      thickness);
 }
 
 void AnnotationRenderer::DrawPoint(const RenderAnnotation& annotation) {
@@ -446,6 +486,66 @@ void AnnotationRenderer::DrawPoint(const RenderAnnotation& annotation) {
   const int thickness =
       ClampThickness(round(annotation.thickness() * scale_factor_));
   cv::circle(mat_image_, point_to_draw, thickness, color, -1);
+  MarkDirty({point_to_draw}, thickness + 1);
+}
+
+void AnnotationRenderer::DrawPoints(const RenderData& render_data, int begin,
+                                    int end) {
+  const RenderAnnotation& first = render_data.render_annotations(begin);
+  const int radius = ClampThickness(round(first.thickness() * scale_factor_));
+  if (end - begin == 1 || radius > kMaxPointStampRadius ||
+      mat_image_.depth() != CV_8U || mat_image_.channels() > 4) {
+    for (int i = begin; i < end; ++i) {
+      DrawPoint(render_data.render_annotations(i));
+    }
+    return;
+  }
+
+  if (point_stamp_radius_ != radius) {
+    // Rasterize the circle once, with the same call as DrawPoint(), and keep
+    // the span of each row.
+    cv::Mat stamp = cv::Mat::zeros(2 * radius + 1, 2 * radius + 1, CV_8UC1);
+    cv::circle(stamp, cv::Point(radius, radius), radius, cv::Scalar(255), -1);
+    point_stamp_.clear();
+    for (int row = 0; row < stamp.rows; ++row) {
+      const uchar* pixels = stamp.ptr<uchar>(row);
+      int first_col = 0;
+      while (first_col < stamp.cols && !pixels[first_col]) ++first_col;
+      int last_col = stamp.cols - 1;
+      while (last_col >= first_col && !pixels[last_col]) --last_col;
+      point_stamp_.emplace_back(first_col - radius, last_col - radius);
+    }
+    point_stamp_radius_ = radius;
+  }
+
+  const cv::Scalar color = MediapipeColorToOpenCVColor(first.color());
+  const int channels = mat_image_.channels();
+  uchar pixel[4];
+  for (int c = 0; c < channels; ++c) {
+    pixel[c] = cv::saturate_cast<uchar>(color[c]);
+  }
+  cv::Point min_point(INT_MAX, INT_MAX);
+  cv::Point max_point(INT_MIN, INT_MIN);
+  for (int i = begin; i < end; ++i) {
+    const auto& point = render_data.render_annotations(i).point();
+    const cv::Point center = ToPixel(point.x(), point.y(), point.normalized());
+    min_point.x = std::min(min_point.x, center.x);
+    min_point.y = std::min(min_point.y, center.y);
+    max_point.x = std::max(max_point.x, center.x);
+    max_point.y = std::max(max_point.y, center.y);
+    const int first_row = std::max(center.y - radius, 0);
+    const int last_row = std::min(center.y + radius, mat_image_.rows - 1);
+    for (int y = first_row; y <= last_row; ++y) {
+      const auto& span = point_stamp_[y - center.y + radius];
+      const int x_begin = std::max(center.x + span.first, 0);
+      const int x_end = std::min(center.x + span.second, mat_image_.cols - 1);
+      uchar* dst = mat_image_.ptr<uchar>(y) + x_begin * channels;
+      for (int x = x_begin; x <= x_end; ++x, dst += channels) {
+        for (int c = 0; c < channels; ++c) dst[c] = pixel[c];
+      }
+    }
+  }
+  MarkDirty({min_point, max_point}, radius + 1);
 }
 
 void AnnotationRenderer::DrawLine(const RenderAnnotation& annotation) {
@@ -474,6 +574,38 @@ void AnnotationRenderer::DrawLine(const RenderAnnotation& annotation) {
   const int thickness =
       ClampThickness(round(annotation.thickness() * scale_factor_));
   cv::line(mat_image_, start, end, color, thickness);
+  MarkDirty({start, end}, thickness);
+}
+
+void AnnotationRenderer::DrawLines(const RenderData& render_data, int begin,
+                                   int end) {
+  const RenderAnnotation& first = render_data.render_annotations(begin);
+  if (end - begin == 1) {
+    DrawLine(first);
+    return;
+  }
+  line_points_.clear();
+  for (int i = begin; i < end; ++i) {
+    const auto& line = render_data.render_annotations(i).line();
+    line_points_.push_back(
+        ToPixel(line.x_start(), line.y_start(), line.normalized()));
+    line_points_.push_back(
+        ToPixel(line.x_end(), line.y_end(), line.normalized()));
+  }
+  const int num_lines = end - begin;
+  line_contours_.resize(num_lines);
+  line_contour_sizes_.assign(num_lines, 2);
+  for (int i = 0; i < num_lines; ++i) {
+    line_contours_[i] = &line_points_[2 * i];
+  }
+
+  // An open two-point polyline is drawn exactly like cv::line().
+  const cv::Scalar color = MediapipeColorToOpenCVColor(first.color());
+  const int thickness =
+      ClampThickness(round(first.thickness() * scale_factor_));
+  cv::polylines(mat_image_, line_contours_.data(), line_contour_sizes_.data(),
+                num_lines, /*isClosed=*/false, color, thickness);
+  MarkDirtyRect(cv::boundingRect(line_points_), thickness);
 }
 
 void AnnotationRenderer::DrawGradientLine(const RenderAnnotation& annotation) {
@@ -503,6 +635,10 @@ void AnnotationRenderer::DrawGradientLine(const RenderAnnotation& annotation) {
   const cv::Scalar color1 = MediapipeColorToOpenCVColor(line.color1());
   const cv::Scalar color2 = MediapipeColorToOpenCVColor(line.color2());
   cv_line2(mat_image_, start, end, color1, color2, thickness);
+  // Each step of the line fills a thickness x thickness square.
+  MarkDirty({start, end, start + cv::Point(thickness, thickness),
+             end + cv::Point(thickness, thickness)},
+            1);
 }
 
 void AnnotationRenderer::DrawText(const RenderAnnotation& annotation) {
@@ -543,6 +679,58 @@ void AnnotationRenderer::DrawText(const RenderAnnotation& annotation) {
   cv::putText(mat_image_, text.display_text(), origin, font_face, font_scale,
               color, thickness, /*lineType=*/8,
               /*bottomLeftOrigin=*/flip_text_vertically_);
+  // The text extends from "origin" by its height on one side of the baseline
+  // and by "text_baseline" on the other, depending on the orientation.
+  const int extent = std::max(text_size.height, text_baseline);
+  MarkDirty({origin + cv::Point(0, -extent),
+             origin + cv::Point(text_size.width, extent)},
+            thickness);
+}
+
+cv::Point AnnotationRenderer::ToPixel(double x, double y,
+                                     bool normalized) const {
+  cv::Point pixel;
+  if (normalized) {
+    CHECK(NormalizedtoPixelCoordinates(x, y, image_width_, image_height_,
+                                       &pixel.x, &pixel.y));
+  } else {
+    pixel.x = static_cast<int>(x * scale_factor_);
+    pixel.y = static_cast<int>(y * scale_factor_);
+  }
+  return pixel;
+}
+
+void AnnotationRenderer::MarkDirty(std::initializer_list<cv::Point> points,
+                                   int margin) {
+  cv::Point min_point(INT_MAX, INT_MAX);
+  cv::Point max_point(INT_MIN, INT_MIN);
+  for (const cv::Point& point : points) {
+    min_point.x = std::min(min_point.x, point.x);
+    min_point.y = std::min(min_point.y, point.y);
+    max_point.x = std::max(max_point.x, point.x);
+    max_point.y = std::max(max_point.y, point.y);
+  }
+  MarkDirtyRect(cv::Rect(min_point, max_point), margin);
+}
+
+void AnnotationRenderer::MarkDirtyRect(const cv::Rect& rect, int margin) {
+  // Grow the rectangle to include its bottom right corner and the margin, in
+  // 64 bits since coordinates of off-image annotations are unbounded.
+  const int64 left = std::max<int64>(int64{rect.x} - margin, 0);
+  const int64 top = std::max<int64>(int64{rect.y} - margin, 0);
+  const int64 right =
+      std::min<int64>(int64{rect.x} + rect.width + margin + 1, image_width_);
+  const int64 bottom =
+      std::min<int64>(int64{rect.y} + rect.height + margin + 1, image_height_);
+  if (left >= right || top >= bottom) return;
+  const cv::Rect clipped(static_cast<int>(left), static_cast<int>(top),
+                        static_cast<int>(right - left),
+                        static_cast<int>(bottom - top));
+  if (dirty_region_.area() == 0) {
+    dirty_region_ = clipped;
+  } else {
+    dirty_region_ |= clipped;
+  }
 }
 
 double AnnotationRenderer::ComputeFontScale(int font_face, int font_size,
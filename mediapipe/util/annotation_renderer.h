@@ -15,7 +15,10 @@
 #ifndef MEDIAPIPE_UTIL_ANNOTATION_RENDERER_H_
 #define MEDIAPIPE_UTIL_ANNOTATION_RENDERER_H_
 
+#include <initializer_list>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "mediapipe/framework/port/opencv_core_inc.h"
 #include "mediapipe/framework/port/opencv_imgproc_inc.h"
@@ -54,13 +57,19 @@ class AnnotationRenderer {
         image_height_(mat_image.rows),
         mat_image_(mat_image.clone()) {}
 
-  // Renders the image with the input render data.
+  // Renders the image with the input render data. Runs of consecutive lines
+  // or points with the same color and thickness are rasterized together.
   void RenderDataOnImage(const RenderData& render_data);
 
   // Resets the renderer with a new image. Does not own input_image. input_image
   // must not be modified by caller during rendering.
   void AdoptImage(cv::Mat* input_image);
 
+  // Returns a rectangle containing every pixel drawn since the last call to
+  // AdoptImage(), clipped to the image. The rectangle is empty if nothing was
+  // drawn, so callers can copy or upload only this region.
+  cv::Rect GetDirtyRegion() const { return dirty_region_; }
+
   // Gets image dimensions.
   int GetImageWidth() const;
   int GetImageHeight() const;
@@ -97,9 +106,17 @@ class AnnotationRenderer {
   // Draws a point on the image as described in the annotation.
   void DrawPoint(const RenderAnnotation& annotation);
 
+  // Draws the points of annotations [begin, end), which all have the color
+  // and thickness of the first one.
+  void DrawPoints(const RenderData& render_data, int begin, int end);
+
   // Draws a line segment on the image as described in the annotation.
   void DrawLine(const RenderAnnotation& annotation);
 
+  // Draws the line segments of annotations [begin, end), which all have the
+  // color and thickness of the first one, with a single polylines() call.
+  void DrawLines(const RenderData& render_data, int begin, int end);
+
   // Draws a 2-tone line segment on the image as described in the annotation.
   void DrawGradientLine(const RenderAnnotation& annotation);
 
@@ -125,6 +142,14 @@ class AnnotationRenderer {
   // Computes the font scale from font_face, size and thickness.
   double ComputeFontScale(int font_face, int font_size, int thickness);
 
+  // Returns the pixel coordinates of a point, which may be normalized.
+  cv::Point ToPixel(double x, double y, bool normalized) const;
+
+  // Adds the bounding box of "points", grown by "margin" pixels on each side,
+  // to the dirty region.
+  void MarkDirty(std::initializer_list<cv::Point> points, int margin);
+  void MarkDirtyRect(const cv::Rect& rect, int margin);
+
   // Width and Height of the image (in pixels).
   int image_width_ = -1;
   int image_height_ = -1;
@@ -132,6 +157,21 @@ class AnnotationRenderer {
   // The image for rendering.
   cv::Mat mat_image_;
 
+  // See GetDirtyRegion().
+  cv::Rect dirty_region_;
+
+  // Segment end points of the current line batch, and the pointers and counts
+  // passed to polylines().
+  std::vector<cv::Point> line_points_;
+  std::vector<const cv::Point*> line_contours_;
+  std::vector<int> line_contour_sizes_;
+
+  // Filled circle of radius "point_stamp_radius_", as horizontal spans
+  // [first, second] relative to the center for each row from -radius to
+  // radius. Used to draw batches of points.
+  std::vector<std::pair<int, int>> point_stamp_;
+  int point_stamp_radius_ = -1;
+
   // See SetFlipTextVertically(bool).
   bool flip_text_vertically_ = false;
 
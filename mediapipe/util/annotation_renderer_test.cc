@@ -0,0 +1,245 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/annotation_renderer.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/opencv_core_inc.h"
+#include "mediapipe/framework/port/opencv_imgproc_inc.h"
+#include "mediapipe/util/render_data.pb.h"
+
+namespace mediapipe {
+namespace {
+
+constexpr int kWidth = 64;
+constexpr int kHeight = 48;
+
+cv::Mat MakeImage(int type = CV_8UC3) {
+  cv::Mat image(kHeight, kWidth, type);
+  image.setTo(cv::Scalar(40, 80, 120, 160));
+  return image;
+}
+
+RenderAnnotation* AddAnnotation(int r, int g, int b, double thickness,
+                                RenderData* render_data) {
+  RenderAnnotation* annotation = render_data->add_render_annotations();
+  annotation->mutable_color()->set_r(r);
+  annotation->mutable_color()->set_g(g);
+  annotation->mutable_color()->set_b(b);
+  annotation->set_thickness(thickness);
+  return annotation;
+}
+
+void AddLine(int x_start, int y_start, int x_end, int y_end, int r, int g,
+             int b, double thickness, RenderData* render_data) {
+  auto* line = AddAnnotation(r, g, b, thickness, render_data)->mutable_line();
+  line->set_x_start(x_start);
+  line->set_y_start(y_start);
+  line->set_x_end(x_end);
+  line->set_y_end(y_end);
+}
+
+void AddPoint(int x, int y, int r, int g, int b, double thickness,
+              RenderData* render_data) {
+  auto* point = AddAnnotation(r, g, b, thickness, render_data)->mutable_point();
+  point->set_x(x);
+  point->set_y(y);
+}
+
+cv::Scalar ColorOf(const RenderAnnotation& annotation) {
+  return cv::Scalar(annotation.color().r(), annotation.color().g(),
+                    annotation.color().b());
+}
+
+// Draws the lines and points of "render_data" one by one, as the renderer did
+// before it batched them.
+void DrawOneByOne(const RenderData& render_data, cv::Mat* image) {
+  for (const RenderAnnotation& annotation : render_data.render_annotations()) {
+    const int thickness = std::max(1, static_cast<int>(annotation.thickness()));
+    if (annotation.has_line()) {
+      const auto& line = annotation.line();
+      cv::line(*image,
+               cv::Point(static_cast<int>(line.x_start()),
+                         static_cast<int>(line.y_start())),
+               cv::Point(static_cast<int>(line.x_end()),
+                         static_cast<int>(line.y_end())),
+               ColorOf(annotation), thickness);
+    } else if (annotation.has_point()) {
+      const auto& point = annotation.point();
+      cv::circle(*image,
+                 cv::Point(static_cast<int>(point.x()),
+                           static_cast<int>(point.y())),
+                 thickness, ColorOf(annotation), -1);
+    }
+  }
+}
+
+bool AreEqual(const cv::Mat& a, const cv::Mat& b) {
+  return a.size() == b.size() && a.type() == b.type() &&
+         cv::norm(a, b, cv::NORM_INF) == 0;
+}
+
+// Returns the bounding box of the pixels that differ between "a" and "b".
+cv::Rect ChangedRegion(const cv::Mat& a, const cv::Mat& b) {
+  cv::Mat diff;
+  cv::absdiff(a, b, diff);
+  std::vector<cv::Mat> channels;
+  cv::split(diff, channels);
+  cv::Mat mask = channels[0] | channels[1] | channels[2];
+  std::vector<cv::Point> changed;
+  cv::findNonZero(mask, changed);
+  return changed.empty() ? cv::Rect() : cv::boundingRect(changed);
+}
+
+TEST(AnnotationRendererTest, BatchedLinesMatchCvLine) {
+  for (int thickness : {1, 2, 3, 5, 8}) {
+    RenderData render_data;
+    // A run of lines with the same style, including lines that cross or lie
+    // outside the image edges.
+    AddLine(2, 3, 60, 40, 255, 0, 0, thickness, &render_data);
+    AddLine(60, 40, 10, 45, 255, 0, 0, thickness, &render_data);
+    AddLine(-10, 20, 30, -5, 255, 0, 0, thickness, &render_data);
+    AddLine(50, 10, 80, 60, 255, 0, 0, thickness, &render_data);
+    AddLine(-20, -20, -5, -30, 255, 0, 0, thickness, &render_data);
+    AddLine(32, 24, 32, 24, 255, 0, 0, thickness, &render_data);
+    // A different color starts a new run, drawn over the previous one.
+    AddLine(0, 47, 63, 0, 0, 255, 0, thickness, &render_data);
+    AddLine(5, 5, 5, 40, 0, 255, 0, thickness, &render_data);
+    // Then the first style again, drawn over the second run.
+    AddLine(0, 24, 63, 24, 255, 0, 0, thickness, &render_data);
+
+    cv::Mat image = MakeImage();
+    AnnotationRenderer renderer;
+    renderer.AdoptImage(&image);
+    renderer.RenderDataOnImage(render_data);
+
+    cv::Mat expected = MakeImage();
+    DrawOneByOne(render_data, &expected);
+    EXPECT_TRUE(AreEqual(image, expected)) << "thickness " << thickness;
+  }
+}
+
+TEST(AnnotationRendererTest, BatchedPointsMatchCvCircle) {
+  for (int type : {CV_8UC3, CV_8UC4}) {
+    for (int radius : {1, 2, 3, 7, 20}) {
+      RenderData render_data;
+      // Points inside the image, on and across each edge and corner, and
+      // fully outside of it.
+      const std::vector<cv::Point> centers = {
+          {10, 10}, {32, 24}, {33, 24}, {0, 0},    {63, 47}, {0, 30},
+          {63, 5},  {20, 0},  {40, 47}, {-2, 10},  {66, 30}, {12, -3},
+          {50, 50}, {-1, -1}, {64, 48}, {-40, 10}, {10, 90},
+      };
+      for (const cv::Point& center : centers) {
+        AddPoint(center.x, center.y, 0, 0, 255, radius, &render_data);
+      }
+      // A different color starts a new run, drawn over the previous one.
+      AddPoint(33, 24, 255, 255, 0, radius, &render_data);
+      AddPoint(62, 46, 255, 255, 0, radius, &render_data);
+
+      cv::Mat image = MakeImage(type);
+      AnnotationRenderer renderer;
+      renderer.AdoptImage(&image);
+      renderer.RenderDataOnImage(render_data);
+
+      cv::Mat expected = MakeImage(type);
+      DrawOneByOne(render_data, &expected);
+      EXPECT_TRUE(AreEqual(image, expected))
+          << "radius " << radius << ", channels " << CV_MAT_CN(type);
+    }
+  }
+}
+
+// Renders "render_data" and checks that the dirty region contains every pixel
+// that changed, and lies within the image. Returns the dirty region.
+cv::Rect RenderAndCheckDirtyRegion(const RenderData& render_data) {
+  cv::Mat image = MakeImage();
+  AnnotationRenderer renderer;
+  renderer.AdoptImage(&image);
+  renderer.RenderDataOnImage(render_data);
+  const cv::Rect changed = ChangedRegion(image, MakeImage());
+  const cv::Rect dirty_region = renderer.GetDirtyRegion();
+  EXPECT_EQ(dirty_region & changed, changed)
+      << "dirty " << dirty_region << ", changed " << changed;
+  EXPECT_EQ(dirty_region & cv::Rect(0, 0, kWidth, kHeight), dirty_region);
+  return dirty_region;
+}
+
+TEST(AnnotationRendererTest, GetDirtyRegionContainsDrawnPixels) {
+  {
+    RenderData render_data;
+    AddLine(10, 12, 20, 30, 255, 0, 0, 3, &render_data);
+    AddLine(-10, 40, 8, 47, 255, 0, 0, 3, &render_data);
+    const cv::Rect dirty_region = RenderAndCheckDirtyRegion(render_data);
+    // Only the region around the lines is dirty.
+    EXPECT_LT(dirty_region.area(), kWidth * kHeight / 2);
+  }
+  {
+    RenderData render_data;
+    AddPoint(5, 5, 0, 255, 0, 4, &render_data);
+    AddPoint(60, 44, 0, 255, 0, 4, &render_data);
+    AddPoint(61, 2, 0, 0, 255, 6, &render_data);
+    RenderAndCheckDirtyRegion(render_data);
+  }
+  {
+    RenderData render_data;
+    auto* rectangle =
+        AddAnnotation(0, 0, 255, 2, &render_data)->mutable_rectangle();
+    rectangle->set_left(30);
+    rectangle->set_top(4);
+    rectangle->set_right(50);
+    rectangle->set_bottom(20);
+    auto* oval = AddAnnotation(255, 0, 255, 1, &render_data)
+                     ->mutable_filled_oval()
+                     ->mutable_oval()
+                     ->mutable_rectangle();
+    oval->set_left(0.1);
+    oval->set_top(0.5);
+    oval->set_right(0.3);
+    oval->set_bottom(0.9);
+    oval->set_normalized(true);
+    auto* text = AddAnnotation(255, 255, 255, 1, &render_data)->mutable_text();
+    text->set_display_text("Hi");
+    text->set_left(20);
+    text->set_baseline(40);
+    text->set_font_height(10);
+    RenderAndCheckDirtyRegion(render_data);
+  }
+}
+
+TEST(AnnotationRendererTest, GetDirtyRegionIsResetByAdoptImage) {
+  cv::Mat image = MakeImage();
+  AnnotationRenderer renderer;
+  renderer.AdoptImage(&image);
+  EXPECT_EQ(renderer.GetDirtyRegion().area(), 0);
+  RenderData render_data;
+  AddPoint(10, 10, 255, 0, 0, 2, &render_data);
+  renderer.RenderDataOnImage(render_data);
+  EXPECT_GT(renderer.GetDirtyRegion().area(), 0);
+
+  renderer.AdoptImage(&image);
+  EXPECT_EQ(renderer.GetDirtyRegion().area(), 0);
+  // Annotations outside the image don't dirty it.
+  RenderData outside_render_data;
+  AddLine(-30, -30, -10, -20, 255, 0, 0, 2, &outside_render_data);
+  AddPoint(100, 100, 255, 0, 0, 2, &outside_render_data);
+  renderer.RenderDataOnImage(outside_render_data);
+  EXPECT_EQ(renderer.GetDirtyRegion().area(), 0);
+}
+
+}  // namespace
+}  // namespace mediapipe
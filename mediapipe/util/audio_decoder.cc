@@ -15,13 +15,16 @@
 #include "mediapipe/util/audio_decoder.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>  // required by avutil.h
 #include <cstdlib>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "Eigen/Core"
 #include "absl/base/internal/endian.h"
+#include "absl/memory/memory.h"
 #include "absl/strings/numbers.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/substitute.h"
@@ -681,12 +684,181 @@ absl::Status AudioDecoder::Initialize(
     end_time_ = Timestamp::FromSeconds(options.end_time());
   }
   is_first_packet_.resize(avformat_ctx_->nb_streams, true);
+  num_packets_read_ = 0;
+
+  if (options.seek_to_start_time() && start_time_ != Timestamp::Unset() &&
+      start_time_ > Timestamp(0)) {
+    // Timestamps are in microseconds, which is AV_TIME_BASE.  Seeking
+    // backwards lands at or before the start time, and GetData() drops the
+    // frames before it as without seeking.
+    const int ret = av_seek_frame(avformat_ctx_, /*stream_index=*/-1,
+                                  start_time_.Value(), AVSEEK_FLAG_BACKWARD);
+    if (ret < 0) {
+      LOG(WARNING) << "Could not seek to " << start_time_
+                   << ", decoding from the beginning instead: "
+                   << AvErrorToString(ret);
+    }
+  }
+
+  pending_chunks_.clear();
+  if (options.chunk_duration() > 0) {
+    for (const auto& item : audio_processor_) {
+      TimeSeriesHeader header;
+      MP_RETURN_IF_ERROR(item.second->FillHeader(&header));
+      PendingChunk& chunk = pending_chunks_[FindOrDie(
+          stream_id_to_audio_options_index_, item.first)];
+      chunk.sample_rate = header.sample_rate();
+      chunk.min_samples = std::max<int64>(
+          1, std::ceil(options.chunk_duration() * header.sample_rate()));
+    }
+  }
+  // The read-ahead thread is started by the first GetData() call, so that
+  // FillAudioHeader() can still be called until then.
+  max_read_ahead_packets_ = options.read_ahead_packets();
 
   decoder_closer.release();
   return absl::OkStatus();
 }
 
 absl::Status AudioDecoder::GetData(int* options_index, Packet* data) {
+  if (max_read_ahead_packets_ <= 0) {
+    return DecodeChunk(options_index, data);
+  }
+  if (!read_ahead_thread_) {
+    {
+      absl::MutexLock lock(&read_ahead_mutex_);
+      stop_read_ahead_ = false;
+      read_ahead_queue_.clear();
+    }
+    read_ahead_thread_ =
+        absl::make_unique<std::thread>(&AudioDecoder::ReadAheadLoop, this);
+  }
+  absl::MutexLock lock(&read_ahead_mutex_);
+  read_ahead_mutex_.Await(
+      absl::Condition(this, &AudioDecoder::ReadAheadQueueHasData));
+  ReadAheadItem& item = read_ahead_queue_.front();
+  if (!item.status.ok()) {
+    // The decoding thread has stopped after this item, so keep it for any
+    // later call.
+    return item.status;
+  }
+  *options_index = item.options_index;
+  *data = std::move(item.data);
+  read_ahead_queue_.pop_front();
+  return absl::OkStatus();
+}
+
+void AudioDecoder::ReadAheadLoop() {
+  while (true) {
+    ReadAheadItem item;
+    item.status = DecodeChunk(&item.options_index, &item.data);
+    const bool done = !item.status.ok();
+    absl::MutexLock lock(&read_ahead_mutex_);
+    read_ahead_mutex_.Await(
+        absl::Condition(this, &AudioDecoder::ReadAheadQueueHasSpace));
+    if (stop_read_ahead_) return;
+    read_ahead_queue_.push_back(std::move(item));
+    if (done) return;
+  }
+}
+
+bool AudioDecoder::ReadAheadQueueHasSpace() {
+  return stop_read_ahead_ ||
+         static_cast<int>(read_ahead_queue_.size()) < max_read_ahead_packets_;
+}
+
+bool AudioDecoder::ReadAheadQueueHasData() {
+  return !read_ahead_queue_.empty();
+}
+
+void AudioDecoder::StopReadAhead() {
+  if (!read_ahead_thread_) {
+    return;
+  }
+  {
+    absl::MutexLock lock(&read_ahead_mutex_);
+    stop_read_ahead_ = true;
+  }
+  read_ahead_thread_->join();
+  read_ahead_thread_.reset();
+  // Decode synchronously if GetData() is called again.
+  max_read_ahead_packets_ = 0;
+  absl::MutexLock lock(&read_ahead_mutex_);
+  read_ahead_queue_.clear();
+}
+
+absl::Status AudioDecoder::DecodeChunk(int* options_index, Packet* data) {
+  if (pending_chunks_.empty()) {
+    return DecodeFrame(options_index, data);
+  }
+  while (true) {
+    int frame_options_index = -1;
+    Packet frame;
+    const absl::Status status = DecodeFrame(&frame_options_index, &frame);
+    if (!status.ok()) {
+      if (status == tool::StatusStop()) {
+        // Output the remaining frames before stopping.
+        for (auto& item : pending_chunks_) {
+          if (!item.second.frames.empty()) {
+            *options_index = item.first;
+            *data = TakeChunk(&item.second);
+            return absl::OkStatus();
+          }
+        }
+      }
+      return status;
+    }
+
+    PendingChunk& chunk = pending_chunks_[frame_options_index];
+    const int64 num_frame_samples = frame.Get<Matrix>().cols();
+    if (!chunk.frames.empty()) {
+      const int64 expected_timestamp =
+          chunk.frames.front().Timestamp().Value() +
+          std::llround(chunk.num_samples *
+                       Timestamp::kTimestampUnitsPerSecond /
+                       chunk.sample_rate);
+      // Allow for the rounding of both timestamps to microseconds.
+      if (std::abs(frame.Timestamp().Value() - expected_timestamp) > 1) {
+        // Don't hide the gap or overlap inside a chunk.
+        *options_index = frame_options_index;
+        *data = TakeChunk(&chunk);
+        chunk.frames.push_back(std::move(frame));
+        chunk.num_samples = num_frame_samples;
+        return absl::OkStatus();
+      }
+    }
+    chunk.frames.push_back(std::move(frame));
+    chunk.num_samples += num_frame_samples;
+    if (chunk.num_samples >= chunk.min_samples) {
+      *options_index = frame_options_index;
+      *data = TakeChunk(&chunk);
+      return absl::OkStatus();
+    }
+  }
+}
+
+// static
+Packet AudioDecoder::TakeChunk(PendingChunk* chunk) {
+  Packet packet;
+  if (chunk->frames.size() == 1) {
+    packet = std::move(chunk->frames.front());
+  } else {
+    auto samples = absl::make_unique<Matrix>(
+        chunk->frames.front().Get<Matrix>().rows(), chunk->num_samples);
+    int64 column = 0;
+    for (const Packet& frame : chunk->frames) {
+      const Matrix& frame_samples = frame.Get<Matrix>();
+      samples->middleCols(column, frame_samples.cols()) = frame_samples;
+      column += frame_samples.cols();
+    }
+    packet = Adopt(samples.release()).At(chunk->frames.front().Timestamp());
+  }
+  chunk->frames.clear();
+  chunk->num_samples = 0;
+  return packet;
+}
+
+absl::Status AudioDecoder::DecodeFrame(int* options_index, Packet* data) {
   while (true) {
     for (auto& item : audio_processor_) {
       while (item.second && item.second->HasData()) {
@@ -727,7 +899,7 @@ absl::Status AudioDecoder::GetData(int* options_index, Packet* data) {
       }
     }
     if (flushed_) {
-      MP_RETURN_IF_ERROR(Close());
+      MP_RETURN_IF_ERROR(CloseStreams());
       return tool::StatusStop();
     }
     MP_RETURN_IF_ERROR(ProcessPacket());
@@ -736,6 +908,11 @@ absl::Status AudioDecoder::GetData(int* options_index, Packet* data) {
 }
 
 absl::Status AudioDecoder::Close() {
+  StopReadAhead();
+  return CloseStreams();
+}
+
+absl::Status AudioDecoder::CloseStreams() {
   for (auto& item : audio_processor_) {
     if (item.second) {
       item.second->Close();
@@ -769,6 +946,7 @@ absl::Status AudioDecoder::ProcessPacket() {
   if (ret >= 0) {
     CHECK(av_packet->data) << "AVPacket does not include any data but "
                               "av_read_frame was successful.";
+    ++num_packets_read_;
     const int stream_id = av_packet->stream_index;
     auto audio_iterator = audio_processor_.find(stream_id);
     if (audio_iterator != audio_processor_.end()) {
@@ -17,10 +17,14 @@
 
 #include <cstdint>  // required by avutil.h
 #include <deque>
+#include <memory>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/flags/flag.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/time/time.h"
 #include "mediapipe/framework/formats/time_series_header.pb.h"
 #include "mediapipe/framework/packet.h"
@@ -189,6 +193,10 @@ class AudioPacketProcessor : public BasePacketProcessor {
 // Decode the audio streams of a media file.  The AudioDecoder is responsible
 // for demuxing the audio streams in the container format, whereas decoding of
 // the content is delegated to AudioPacketProcessor.
+//
+// The options can make the decoder seek to the start time, concatenate
+// decoded frames into larger chunks, and decode ahead of GetData() on a
+// background thread.
 class AudioDecoder {
  public:
   AudioDecoder();
@@ -197,6 +205,10 @@ class AudioDecoder {
   absl::Status Initialize(const std::string& input_file,
                           const mediapipe::AudioDecoderOptions options);
 
+  // Returns the next packet of audio data, and the index of its stream in the
+  // options. Returns tool::StatusStop() once all streams are done. With
+  // read_ahead_packets set, the first call starts the decoding thread, so
+  // FillAudioHeader() must be called before it.
   absl::Status GetData(int* options_index, Packet* data);
 
   absl::Status Close();
@@ -204,9 +216,49 @@ class AudioDecoder {
   absl::Status FillAudioHeader(const AudioStreamOptions& stream_option,
                                TimeSeriesHeader* header) const;
 
+  // Returns the number of packets read from the container since Initialize(),
+  // of any stream. With read_ahead_packets set, it is only up to date after
+  // Close().
+  int64 num_packets_read() const { return num_packets_read_; }
+
  private:
+  // Decoded frames of a stream which have not been output yet, to be
+  // concatenated into one packet.
+  struct PendingChunk {
+    std::vector<Packet> frames;
+    int64 num_samples = 0;
+    // Minimum number of samples of an output chunk.
+    int64 min_samples = 0;
+    double sample_rate = 0;
+  };
+
+  // An output of the background decoding thread.
+  struct ReadAheadItem {
+    absl::Status status;
+    int options_index = -1;
+    Packet data;
+  };
+
   absl::Status ProcessPacket();
   absl::Status Flush();
+  // Closes the codecs and the file, without stopping the read-ahead thread.
+  absl::Status CloseStreams();
+
+  // Returns the next decoded frame of any stream.
+  absl::Status DecodeFrame(int* options_index, Packet* data);
+  // Returns the next decoded frame, or chunk of frames if chunk_duration is
+  // set.
+  absl::Status DecodeChunk(int* options_index, Packet* data);
+  // Returns the frames of "chunk" as a single packet, and clears it.
+  static Packet TakeChunk(PendingChunk* chunk);
+
+  // Runs on read_ahead_thread_, filling read_ahead_queue_.
+  void ReadAheadLoop();
+  void StopReadAhead();
+  bool ReadAheadQueueHasSpace()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(read_ahead_mutex_);
+  bool ReadAheadQueueHasData()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(read_ahead_mutex_);
 
   std::map<int, int> stream_id_to_audio_options_index_;
   std::map<int, int> stream_index_to_stream_id_;
@@ -216,10 +268,23 @@ class AudioDecoder {
   // a packet (whether returned or not), and false otherwise.
   std::vector<bool> is_first_packet_;
   bool flushed_ = false;
+  int64 num_packets_read_ = 0;
 
   Timestamp start_time_ = Timestamp::Unset();
   Timestamp end_time_ = Timestamp::Unset();
 
+  // Indexed by options index, used if chunk_duration is set.
+  std::map<int, PendingChunk> pending_chunks_;
+
+  // Maximum number of packets in read_ahead_queue_, or 0 to decode in
+  // GetData().
+  int max_read_ahead_packets_ = 0;
+  absl::Mutex read_ahead_mutex_;
+  std::deque<ReadAheadItem> read_ahead_queue_
+      ABSL_GUARDED_BY(read_ahead_mutex_);
+  bool stop_read_ahead_ ABSL_GUARDED_BY(read_ahead_mutex_) = false;
+  std::unique_ptr<std::thread> read_ahead_thread_;
+
   AVFormatContext* avformat_ctx_ = nullptr;
 };
 
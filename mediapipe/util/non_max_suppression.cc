@@ -0,0 +1,364 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// Overlaps are computed for four boxes at a time, with a scalar loop for the
+// remaining ones. The same operations are defined on floats and vectors.
+inline float Min(float a, float b) { return a < b ? a : b; }
+inline float Max(float a, float b) { return a > b ? a : b; }
+inline float Sub(float a, float b) { return a - b; }
+inline float Add(float a, float b) { return a + b; }
+inline float Mul(float a, float b) { return a * b; }
+inline float Div(float a, float b) { return a / b; }
+
+#if defined(__SSE2__)
+#define MEDIAPIPE_NMS_VECTORIZED 1
+using Vec4 = __m128;
+inline Vec4 Splat4(float value) { return _mm_set1_ps(value); }
+inline Vec4 Load4(const float* data) { return _mm_loadu_ps(data); }
+inline void Store4(Vec4 v, float* data) { _mm_storeu_ps(data, v); }
+inline Vec4 Min(Vec4 a, Vec4 b) { return _mm_min_ps(a, b); }
+inline Vec4 Max(Vec4 a, Vec4 b) { return _mm_max_ps(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return _mm_sub_ps(a, b); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+inline Vec4 Div(Vec4 a, Vec4 b) { return _mm_div_ps(a, b); }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define MEDIAPIPE_NMS_VECTORIZED 1
+using Vec4 = float32x4_t;
+inline Vec4 Splat4(float value) { return vdupq_n_f32(value); }
+inline Vec4 Load4(const float* data) { return vld1q_f32(data); }
+inline void Store4(Vec4 v, float* data) { vst1q_f32(data, v); }
+inline Vec4 Min(Vec4 a, Vec4 b) { return vminq_f32(a, b); }
+inline Vec4 Max(Vec4 a, Vec4 b) { return vmaxq_f32(a, b); }
+inline Vec4 Sub(Vec4 a, Vec4 b) { return vsubq_f32(a, b); }
+inline Vec4 Add(Vec4 a, Vec4 b) { return vaddq_f32(a, b); }
+inline Vec4 Mul(Vec4 a, Vec4 b) { return vmulq_f32(a, b); }
+inline Vec4 Div(Vec4 a, Vec4 b) { return vdivq_f32(a, b); }
+#endif
+
+// Returns the overlap of box "a" with box "b" (or of four boxes at a time).
+// The intersection is zero whenever the normalization is not positive, in
+// which case dividing by FLT_MIN yields the expected zero overlap.
+template <NmsOptions::OverlapType kOverlapType, typename V>
+inline V Overlap(V a_xmin, V a_ymin, V a_xmax, V a_ymax, V a_area, V b_xmin,
+                 V b_ymin, V b_xmax, V b_ymax, V zero, V min_normalization) {
+  const V width = Max(Sub(Min(a_xmax, b_xmax), Max(a_xmin, b_xmin)), zero);
+  const V height = Max(Sub(Min(a_ymax, b_ymax), Max(a_ymin, b_ymin)), zero);
+  const V intersection = Mul(width, height);
+  V normalization;
+  switch (kOverlapType) {
+    case NmsOptions::OverlapType::kJaccard:
+      normalization = Mul(Sub(Max(a_xmax, b_xmax), Min(a_xmin, b_xmin)),
+                          Sub(Max(a_ymax, b_ymax), Min(a_ymin, b_ymin)));
+      break;
+    case NmsOptions::OverlapType::kModifiedJaccard:
+      normalization = a_area;
+      break;
+    case NmsOptions::OverlapType::kIntersectionOverUnion:
+      normalization = Sub(
+          Add(a_area, Mul(Sub(b_xmax, b_xmin), Sub(b_ymax, b_ymin))),
+          intersection);
+      break;
+  }
+  return Div(intersection, Max(normalization, min_normalization));
+}
+
+template <NmsOptions::OverlapType kOverlapType>
+void ComputeOverlaps(float a_xmin, float a_ymin, float a_xmax, float a_ymax,
+                     const NmsBoxes& boxes, int begin, int end,
+                     float* overlaps) {
+  const float* xmin = boxes.xmin.data();
+  const float* ymin = boxes.ymin.data();
+  const float* xmax = boxes.xmax.data();
+  const float* ymax = boxes.ymax.data();
+  const float a_area = (a_xmax - a_xmin) * (a_ymax - a_ymin);
+  int i = begin;
+#if MEDIAPIPE_NMS_VECTORIZED
+  const Vec4 a_xmin4 = Splat4(a_xmin);
+  const Vec4 a_ymin4 = Splat4(a_ymin);
+  const Vec4 a_xmax4 = Splat4(a_xmax);
+  const Vec4 a_ymax4 = Splat4(a_ymax);
+  const Vec4 a_area4 = Splat4(a_area);
+  const Vec4 zero4 = Splat4(0.0f);
+  const Vec4 min_normalization4 = Splat4(FLT_MIN);
+  for (; i + 4 <= end; i += 4) {
+    Store4(Overlap<kOverlapType>(a_xmin4, a_ymin4, a_xmax4, a_ymax4, a_area4,
+                                 Load4(xmin + i), Load4(ymin + i),
+                                 Load4(xmax + i), Load4(ymax + i), zero4,
+                                 min_normalization4),
+           overlaps + i - begin);
+  }
+#endif  // MEDIAPIPE_NMS_VECTORIZED
+  for (; i < end; ++i) {
+    overlaps[i - begin] = Overlap<kOverlapType>(
+        a_xmin, a_ymin, a_xmax, a_ymax, a_area, xmin[i], ymin[i], xmax[i],
+        ymax[i], 0.0f, FLT_MIN);
+  }
+}
+
+// Returns the indices of the boxes by decreasing score, skipping those below
+// "min_score" if it is positive.
+std::vector<int> SortByScore(const NmsBoxes& boxes, float min_score) {
+  std::vector<int> order;
+  order.reserve(boxes.size());
+  for (int i = 0; i < boxes.size(); ++i) {
+    if (min_score <= 0.0f || boxes.score[i] >= min_score) {
+      order.push_back(i);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&boxes](int a, int b) {
+    return boxes.score[a] > boxes.score[b];
+  });
+  return order;
+}
+
+// Copies the boxes in "order" into "sorted".
+void Gather(const NmsBoxes& boxes, const std::vector<int>& order,
+            NmsBoxes* sorted) {
+  sorted->Clear();
+  sorted->Reserve(order.size());
+  for (int i : order) {
+    sorted->Add(boxes.xmin[i], boxes.ymin[i], boxes.xmax[i], boxes.ymax[i],
+                boxes.score[i]);
+  }
+}
+
+bool LimitReached(const NmsResult& result, const NmsOptions& options) {
+  return options.max_num_detections >= 0 &&
+         static_cast<int>(result.indices.size()) >= options.max_num_detections;
+}
+
+void HardNonMaxSuppression(const NmsBoxes& boxes, const NmsOptions& options,
+                           NmsResult* result) {
+  NmsBoxes retained;
+  std::vector<float> overlaps;
+  for (int i : SortByScore(boxes, options.min_score_threshold)) {
+    if (LimitReached(*result, options)) break;
+    overlaps.resize(retained.size());
+    ComputeOverlaps(options.overlap_type, boxes.xmin[i], boxes.ymin[i],
+                    boxes.xmax[i], boxes.ymax[i], retained, 0, retained.size(),
+                    overlaps.data());
+    const bool suppressed =
+        std::any_of(overlaps.begin(), overlaps.end(), [&options](float o) {
+          return o > options.min_suppression_threshold;
+        });
+    if (!suppressed) {
+      retained.Add(boxes.xmin[i], boxes.ymin[i], boxes.xmax[i], boxes.ymax[i],
+                   boxes.score[i]);
+      result->indices.push_back(i);
+      result->scores.push_back(boxes.score[i]);
+    }
+  }
+}
+
+void WeightedNonMaxSuppression(const NmsBoxes& boxes,
+                               const NmsOptions& options, NmsResult* result) {
+  // Boxes below the score threshold are never kept, but they still contribute
+  // to the averages.
+  std::vector<int> remaining_indices = SortByScore(boxes, /*min_score=*/0.0f);
+  NmsBoxes remaining;
+  Gather(boxes, remaining_indices, &remaining);
+  int num_remaining = remaining.size();
+  std::vector<float> overlaps(num_remaining);
+  result->cluster_offsets.push_back(0);
+  while (num_remaining > 0 && !LimitReached(*result, options)) {
+    const float top_xmin = remaining.xmin[0];
+    const float top_ymin = remaining.ymin[0];
+    const float top_xmax = remaining.xmax[0];
+    const float top_ymax = remaining.ymax[0];
+    const float top_score = remaining.score[0];
+    if (options.min_score_threshold > 0.0f &&
+        top_score < options.min_score_threshold) {
+      break;
+    }
+    result->indices.push_back(remaining_indices[0]);
+    result->scores.push_back(top_score);
+
+    // Moves the boxes overlapping the top box into its cluster and compacts
+    // the others in place.
+    ComputeOverlaps(options.overlap_type, top_xmin, top_ymin, top_xmax,
+                    top_ymax, remaining, 0, num_remaining, overlaps.data());
+    float w_xmin = 0.0f;
+    float w_ymin = 0.0f;
+    float w_xmax = 0.0f;
+    float w_ymax = 0.0f;
+    float total_score = 0.0f;
+    int num_kept = 0;
+    for (int j = 0; j < num_remaining; ++j) {
+      const float score = remaining.score[j];
+      if (overlaps[j] > options.min_suppression_threshold) {
+        total_score += score;
+        w_xmin += remaining.xmin[j] * score;
+        w_ymin += remaining.ymin[j] * score;
+        w_xmax += remaining.xmax[j] * score;
+        w_ymax += remaining.ymax[j] * score;
+        result->cluster_members.push_back(remaining_indices[j]);
+      } else {
+        remaining.xmin[num_kept] = remaining.xmin[j];
+        remaining.ymin[num_kept] = remaining.ymin[j];
+        remaining.xmax[num_kept] = remaining.xmax[j];
+        remaining.ymax[num_kept] = remaining.ymax[j];
+        remaining.score[num_kept] = score;
+        remaining_indices[num_kept] = remaining_indices[j];
+        ++num_kept;
+      }
+    }
+    if (static_cast<int>(result->cluster_members.size()) >
+        result->cluster_offsets.back()) {
+      result->weighted_boxes.Add(w_xmin / total_score, w_ymin / total_score,
+                                 w_xmax / total_score, w_ymax / total_score,
+                                 top_score);
+    } else {
+      result->weighted_boxes.Add(top_xmin, top_ymin, top_xmax, top_ymax,
+                                 top_score);
+    }
+    result->cluster_offsets.push_back(result->cluster_members.size());
+
+    // Nothing is suppressed if even the top box doesn't overlap itself enough,
+    // e.g. for a threshold of 1.
+    if (num_kept == num_remaining) break;
+    num_remaining = num_kept;
+  }
+}
+
+void SoftNonMaxSuppression(const NmsBoxes& boxes, const NmsOptions& options,
+                           NmsResult* result) {
+  std::vector<int> remaining_indices =
+      SortByScore(boxes, options.min_score_threshold);
+  NmsBoxes remaining;
+  Gather(boxes, remaining_indices, &remaining);
+  int num_remaining = remaining.size();
+  std::vector<float> overlaps(num_remaining);
+  while (num_remaining > 0 && !LimitReached(*result, options)) {
+    const int top = std::max_element(remaining.score.begin(),
+                                     remaining.score.begin() + num_remaining) -
+                    remaining.score.begin();
+    const float top_score = remaining.score[top];
+    if (options.min_score_threshold > 0.0f &&
+        top_score < options.min_score_threshold) {
+      break;
+    }
+    result->indices.push_back(remaining_indices[top]);
+    result->scores.push_back(top_score);
+
+    // Decays the other boxes, keeping their order so that ties are resolved
+    // by input order, and drops those falling below the score threshold.
+    ComputeOverlaps(options.overlap_type, remaining.xmin[top],
+                    remaining.ymin[top], remaining.xmax[top],
+                    remaining.ymax[top], remaining, 0, num_remaining,
+                    overlaps.data());
+    int num_kept = 0;
+    for (int j = 0; j < num_remaining; ++j) {
+      if (j == top) continue;
+      float score = remaining.score[j];
+      if (overlaps[j] > 0.0f) {
+        score *= std::exp(-overlaps[j] * overlaps[j] / options.soft_nms_sigma);
+        if (options.min_score_threshold > 0.0f &&
+            score < options.min_score_threshold) {
+          continue;
+        }
+      }
+      remaining.xmin[num_kept] = remaining.xmin[j];
+      remaining.ymin[num_kept] = remaining.ymin[j];
+      remaining.xmax[num_kept] = remaining.xmax[j];
+      remaining.ymax[num_kept] = remaining.ymax[j];
+      remaining.score[num_kept] = score;
+      remaining_indices[num_kept] = remaining_indices[j];
+      ++num_kept;
+    }
+    num_remaining = num_kept;
+  }
+}
+
+}  // namespace
+
+void NmsBoxes::Reserve(int capacity) {
+  xmin.reserve(capacity);
+  ymin.reserve(capacity);
+  xmax.reserve(capacity);
+  ymax.reserve(capacity);
+  score.reserve(capacity);
+}
+
+void NmsBoxes::Clear() {
+  xmin.clear();
+  ymin.clear();
+  xmax.clear();
+  ymax.clear();
+  score.clear();
+}
+
+void NmsBoxes::Add(float box_xmin, float box_ymin, float box_xmax,
+                   float box_ymax, float box_score) {
+  xmin.push_back(box_xmin);
+  ymin.push_back(box_ymin);
+  xmax.push_back(box_xmax);
+  ymax.push_back(box_ymax);
+  score.push_back(box_score);
+}
+
+void ComputeOverlaps(NmsOptions::OverlapType overlap_type, float a_xmin,
+                     float a_ymin, float a_xmax, float a_ymax,
+                     const NmsBoxes& boxes, int begin, int end,
+                     float* overlaps) {
+  switch (overlap_type) {
+    case NmsOptions::OverlapType::kJaccard:
+      ComputeOverlaps<NmsOptions::OverlapType::kJaccard>(
+          a_xmin, a_ymin, a_xmax, a_ymax, boxes, begin, end, overlaps);
+      break;
+    case NmsOptions::OverlapType::kModifiedJaccard:
+      ComputeOverlaps<NmsOptions::OverlapType::kModifiedJaccard>(
+          a_xmin, a_ymin, a_xmax, a_ymax, boxes, begin, end, overlaps);
+      break;
+    case NmsOptions::OverlapType::kIntersectionOverUnion:
+      ComputeOverlaps<NmsOptions::OverlapType::kIntersectionOverUnion>(
+          a_xmin, a_ymin, a_xmax, a_ymax, boxes, begin, end, overlaps);
+      break;
+  }
+}
+
+NmsResult NonMaxSuppression(const NmsBoxes& boxes, const NmsOptions& options) {
+  NmsResult result;
+  switch (options.algorithm) {
+    case NmsOptions::Algorithm::kHard:
+      HardNonMaxSuppression(boxes, options, &result);
+      break;
+    case NmsOptions::Algorithm::kWeighted:
+      WeightedNonMaxSuppression(boxes, options, &result);
+      break;
+    case NmsOptions::Algorithm::kSoft:
+      SoftNonMaxSuppression(boxes, options, &result);
+      break;
+  }
+  return result;
+}
+
+}  // namespace mediapipe
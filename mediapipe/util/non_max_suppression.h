@@ -0,0 +1,105 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_NON_MAX_SUPPRESSION_H_
+#define MEDIAPIPE_UTIL_NON_MAX_SUPPRESSION_H_
+
+#include <vector>
+
+namespace mediapipe {
+
+// Boxes to run non-maximum suppression on, in structure-of-arrays layout so
+// that overlaps with many boxes can be computed in vectorized loops.
+struct NmsBoxes {
+  std::vector<float> xmin;
+  std::vector<float> ymin;
+  std::vector<float> xmax;
+  std::vector<float> ymax;
+  std::vector<float> score;
+
+  int size() const { return static_cast<int>(score.size()); }
+  void Reserve(int capacity);
+  void Clear();
+  void Add(float box_xmin, float box_ymin, float box_xmax, float box_ymax,
+           float box_score);
+};
+
+struct NmsOptions {
+  enum class OverlapType {
+    // Intersection area over the area of the box enclosing both boxes.
+    kJaccard,
+    // Intersection area over the area of one of the boxes: the lower scoring
+    // one for hard NMS, the kept one for weighted and soft NMS.
+    kModifiedJaccard,
+    // Intersection area over union area.
+    kIntersectionOverUnion,
+  };
+  enum class Algorithm {
+    // Keeps a box unless it overlaps a higher scoring kept box.
+    kHard,
+    // Replaces every kept box by the score-weighted average of the boxes it
+    // suppresses, including itself.
+    kWeighted,
+    // Decays the scores of all boxes overlapping a kept box by
+    // exp(-overlap^2 / sigma) instead of removing them. Ignores
+    // min_suppression_threshold.
+    kSoft,
+  };
+
+  Algorithm algorithm = Algorithm::kHard;
+  OverlapType overlap_type = OverlapType::kJaccard;
+  // A box is suppressed by a higher scoring box if their overlap is greater
+  // than this threshold.
+  float min_suppression_threshold = 1.0f;
+  // If positive, boxes with a lower (possibly decayed) score are dropped.
+  float min_score_threshold = -1.0f;
+  // Maximum number of boxes to return, or -1 for no limit.
+  int max_num_detections = -1;
+  // The Gaussian decay parameter of soft NMS.
+  float soft_nms_sigma = 0.5f;
+};
+
+struct NmsResult {
+  // Indices of the kept input boxes, by decreasing score.
+  std::vector<int> indices;
+  // Scores of the kept boxes. These are the decayed scores for soft NMS and
+  // the input scores otherwise.
+  std::vector<float> scores;
+
+  // Weighted NMS only. The averaged boxes, and the input boxes averaged into
+  // each of them: those of kept box i are cluster_members[k] for k in
+  // [cluster_offsets[i], cluster_offsets[i + 1]). A cluster can be empty, in
+  // which case the averaged box is the kept box itself.
+  NmsBoxes weighted_boxes;
+  std::vector<int> cluster_offsets;
+  std::vector<int> cluster_members;
+};
+
+// Runs non-maximum suppression on "boxes". Boxes are visited by decreasing
+// score, and visiting stops at the first one below a positive
+// min_score_threshold. Hard and soft NMS skip such boxes upfront, weighted NMS
+// still averages them into the clusters of higher scoring boxes.
+NmsResult NonMaxSuppression(const NmsBoxes& boxes, const NmsOptions& options);
+
+// Computes the overlap of box "a" with each of the boxes [begin, end) of
+// "boxes", as used by NonMaxSuppression(). For kModifiedJaccard the overlap is
+// normalized by the area of box "a".
+void ComputeOverlaps(NmsOptions::OverlapType overlap_type, float a_xmin,
+                     float a_ymin, float a_xmax, float a_ymax,
+                     const NmsBoxes& boxes, int begin, int end,
+                     float* overlaps);
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_NON_MAX_SUPPRESSION_H_
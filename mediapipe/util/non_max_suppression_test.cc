@@ -0,0 +1,217 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/non_max_suppression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gmock.h"
+#include "mediapipe/framework/port/gtest.h"
+
+namespace mediapipe {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::FloatNear;
+using OverlapType = NmsOptions::OverlapType;
+
+// Returns "num_boxes" random boxes around "num_objects" object locations, as
+// produced by a detection model for its anchors.
+NmsBoxes MakeRandomBoxes(int num_boxes, int num_objects, int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  std::vector<float> centers(num_objects * 2);
+  for (float& center : centers) center = unit(rng);
+  NmsBoxes boxes;
+  for (int i = 0; i < num_boxes; ++i) {
+    const int object = i % num_objects;
+    const float x = centers[object * 2] + 0.05f * (unit(rng) - 0.5f);
+    const float y = centers[object * 2 + 1] + 0.05f * (unit(rng) - 0.5f);
+    const float size = 0.1f + 0.05f * unit(rng);
+    boxes.Add(x - size, y - size, x + size, y + size, unit(rng));
+  }
+  return boxes;
+}
+
+double ReferenceOverlap(OverlapType overlap_type, const NmsBoxes& boxes, int a,
+                        int b) {
+  const double width =
+      std::min(boxes.xmax[a], boxes.xmax[b]) -
+      std::max(boxes.xmin[a], boxes.xmin[b]);
+  const double height =
+      std::min(boxes.ymax[a], boxes.ymax[b]) -
+      std::max(boxes.ymin[a], boxes.ymin[b]);
+  if (width <= 0.0 || height <= 0.0) return 0.0;
+  const double intersection = width * height;
+  const double area_a = (static_cast<double>(boxes.xmax[a]) - boxes.xmin[a]) *
+                        (static_cast<double>(boxes.ymax[a]) - boxes.ymin[a]);
+  const double area_b = (static_cast<double>(boxes.xmax[b]) - boxes.xmin[b]) *
+                        (static_cast<double>(boxes.ymax[b]) - boxes.ymin[b]);
+  switch (overlap_type) {
+    case OverlapType::kJaccard:
+      return intersection /
+             ((std::max(boxes.xmax[a], boxes.xmax[b]) -
+               std::min(boxes.xmin[a], boxes.xmin[b])) *
+              static_cast<double>(std::max(boxes.ymax[a], boxes.ymax[b]) -
+                                  std::min(boxes.ymin[a], boxes.ymin[b])));
+    case OverlapType::kModifiedJaccard:
+      return intersection / area_a;
+    case OverlapType::kIntersectionOverUnion:
+      return intersection / (area_a + area_b - intersection);
+  }
+  return 0.0;
+}
+
+TEST(NonMaxSuppressionTest, ComputeOverlaps) {
+  // An odd number of boxes covers both the vectorized and the scalar loop.
+  const NmsBoxes boxes = MakeRandomBoxes(/*num_boxes=*/23, /*num_objects=*/3,
+                                         /*seed=*/1);
+  for (OverlapType overlap_type :
+       {OverlapType::kJaccard, OverlapType::kModifiedJaccard,
+        OverlapType::kIntersectionOverUnion}) {
+    for (int a = 0; a < boxes.size(); ++a) {
+      std::vector<float> overlaps(boxes.size() - 1);
+      ComputeOverlaps(overlap_type, boxes.xmin[a], boxes.ymin[a],
+                      boxes.xmax[a], boxes.ymax[a], boxes, 1, boxes.size(),
+                      overlaps.data());
+      for (int b = 1; b < boxes.size(); ++b) {
+        EXPECT_NEAR(overlaps[b - 1],
+                    ReferenceOverlap(overlap_type, boxes, a, b), 1e-5)
+            << "a=" << a << " b=" << b;
+      }
+    }
+  }
+}
+
+TEST(NonMaxSuppressionTest, DisjointAndEmptyBoxesDoNotOverlap) {
+  NmsBoxes boxes;
+  boxes.Add(0.0f, 0.0f, 0.1f, 0.1f, 1.0f);
+  boxes.Add(0.1f, 0.0f, 0.2f, 0.1f, 1.0f);  // Touching.
+  boxes.Add(0.5f, 0.5f, 0.5f, 0.5f, 1.0f);  // Empty.
+  float overlaps[3];
+  ComputeOverlaps(OverlapType::kIntersectionOverUnion, 0.0f, 0.0f, 0.1f, 0.1f,
+                  boxes, 1, 3, overlaps);
+  EXPECT_EQ(overlaps[0], 0.0f);
+  EXPECT_EQ(overlaps[1], 0.0f);
+  ComputeOverlaps(OverlapType::kModifiedJaccard, 0.5f, 0.5f, 0.5f, 0.5f, boxes,
+                  0, 3, overlaps);
+  EXPECT_THAT(overlaps, ElementsAre(0.0f, 0.0f, 0.0f));
+}
+
+// Boxes 0 and 2 overlap with an IoU of 0.75, box 1 is separate.
+NmsBoxes MakeTestBoxes() {
+  NmsBoxes boxes;
+  boxes.Add(0.0f, 0.0f, 0.4f, 0.4f, 0.7f);
+  boxes.Add(0.6f, 0.6f, 0.8f, 0.8f, 0.8f);
+  boxes.Add(0.0f, 0.1f, 0.4f, 0.4f, 0.9f);
+  return boxes;
+}
+
+TEST(NonMaxSuppressionTest, Hard) {
+  NmsOptions options;
+  options.overlap_type = OverlapType::kIntersectionOverUnion;
+  options.min_suppression_threshold = 0.5f;
+  NmsResult result = NonMaxSuppression(MakeTestBoxes(), options);
+  EXPECT_THAT(result.indices, ElementsAre(2, 1));
+  EXPECT_THAT(result.scores, ElementsAre(0.9f, 0.8f));
+
+  options.min_suppression_threshold = 0.8f;
+  EXPECT_THAT(NonMaxSuppression(MakeTestBoxes(), options).indices,
+              ElementsAre(2, 1, 0));
+
+  options.max_num_detections = 1;
+  EXPECT_THAT(NonMaxSuppression(MakeTestBoxes(), options).indices,
+              ElementsAre(2));
+
+  options.max_num_detections = -1;
+  options.min_score_threshold = 0.75f;
+  EXPECT_THAT(NonMaxSuppression(MakeTestBoxes(), options).indices,
+              ElementsAre(2, 1));
+}
+
+TEST(NonMaxSuppressionTest, Weighted) {
+  NmsOptions options;
+  options.algorithm = NmsOptions::Algorithm::kWeighted;
+  options.overlap_type = OverlapType::kIntersectionOverUnion;
+  options.min_suppression_threshold = 0.5f;
+  NmsResult result = NonMaxSuppression(MakeTestBoxes(), options);
+  EXPECT_THAT(result.indices, ElementsAre(2, 1));
+  EXPECT_THAT(result.cluster_offsets, ElementsAre(0, 2, 3));
+  EXPECT_THAT(result.cluster_members, ElementsAre(2, 0, 1));
+  ASSERT_EQ(result.weighted_boxes.size(), 2);
+  EXPECT_FLOAT_EQ(result.weighted_boxes.ymin[0], 0.1f * 0.9f / 1.6f);
+  EXPECT_FLOAT_EQ(result.weighted_boxes.xmax[0], 0.4f);
+  EXPECT_FLOAT_EQ(result.weighted_boxes.xmin[1], 0.6f);
+
+  // With a threshold of 1 no box suppresses another, not even itself: only
+  // the top box is returned, with an empty cluster.
+  options.min_suppression_threshold = 1.0f;
+  result = NonMaxSuppression(MakeTestBoxes(), options);
+  EXPECT_THAT(result.indices, ElementsAre(2));
+  EXPECT_THAT(result.cluster_offsets, ElementsAre(0, 0));
+  EXPECT_FLOAT_EQ(result.weighted_boxes.ymin[0], 0.1f);
+}
+
+TEST(NonMaxSuppressionTest, Soft) {
+  NmsOptions options;
+  options.algorithm = NmsOptions::Algorithm::kSoft;
+  options.overlap_type = OverlapType::kIntersectionOverUnion;
+  options.soft_nms_sigma = 0.5f;
+  const float iou = 0.75f;
+  const float decayed_score = 0.7f * std::exp(-iou * iou / 0.5f);
+  NmsResult result = NonMaxSuppression(MakeTestBoxes(), options);
+  EXPECT_THAT(result.indices, ElementsAre(2, 1, 0));
+  EXPECT_THAT(result.scores,
+              ElementsAre(0.9f, 0.8f, FloatNear(decayed_score, 1e-6)));
+
+  options.min_score_threshold = 0.3f;
+  result = NonMaxSuppression(MakeTestBoxes(), options);
+  EXPECT_THAT(result.indices, ElementsAre(2, 1));
+}
+
+void RunNmsBenchmark(benchmark::State& state, NmsOptions::Algorithm algorithm) {
+  const NmsBoxes boxes = MakeRandomBoxes(/*num_boxes=*/state.range(0),
+                                         /*num_objects=*/10, /*seed=*/0);
+  NmsOptions options;
+  options.algorithm = algorithm;
+  options.min_suppression_threshold = 0.3f;
+  options.min_score_threshold = 0.5f;
+  options.max_num_detections = 100;
+  for (auto _ : state) {
+    NmsResult result = NonMaxSuppression(boxes, options);
+    benchmark::DoNotOptimize(result);
+  }
+}
+
+void BM_HardNms(benchmark::State& state) {
+  RunNmsBenchmark(state, NmsOptions::Algorithm::kHard);
+}
+BENCHMARK(BM_HardNms)->Arg(896)->Arg(2016)->Arg(20000);
+
+void BM_WeightedNms(benchmark::State& state) {
+  RunNmsBenchmark(state, NmsOptions::Algorithm::kWeighted);
+}
+BENCHMARK(BM_WeightedNms)->Arg(896)->Arg(2016)->Arg(20000);
+
+void BM_SoftNms(benchmark::State& state) {
+  RunNmsBenchmark(state, NmsOptions::Algorithm::kSoft);
+}
+BENCHMARK(BM_SoftNms)->Arg(896)->Arg(2016)->Arg(20000);
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,337 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/polyphase_resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <utility>
+
+#include "absl/hash/hash.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/util/resource_cache.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDIAPIPE_POLYPHASE_RESAMPLER_NEON 1
+#endif
+
+namespace mediapipe {
+namespace {
+
+// Sets numerator / denominator to the closest continued fraction convergent
+// of "x" whose denominator is at most "max_denominator". The result is exact
+// for the ratios of common sample rates, e.g. 16000 / 44100 = 160 / 441.
+void RationalApproximation(double x, int max_denominator, int64* numerator,
+                           int64* denominator) {
+  int64 p0 = 0, q0 = 1, p1 = 1, q1 = 0;
+  double remainder = x;
+  for (int i = 0; i < 64; ++i) {
+    const double a = std::floor(remainder);
+    const int64 p2 = static_cast<int64>(a) * p1 + p0;
+    const int64 q2 = static_cast<int64>(a) * q1 + q0;
+    if (q2 > max_denominator) break;
+    p0 = p1;
+    q0 = q1;
+    p1 = p2;
+    q1 = q2;
+    const double fraction = remainder - a;
+    if (fraction < 1e-9) break;
+    remainder = 1.0 / fraction;
+  }
+  *numerator = p1;
+  *denominator = q1;
+}
+
+// Modified Bessel function of the first kind, order 0.
+double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 100 && term > 1e-12 * sum; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+double Sinc(double x) {
+  return x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+}
+
+// Designs the filter bank for resampling by upsample_factor /
+// downsample_factor: for each phase p, the coefficients of the input samples
+// at offsets -radius + 1 ... radius from the input sample at or before the
+// output time, which is p / upsample_factor input samples past it.
+std::vector<float> DesignFilters(int upsample_factor, int downsample_factor,
+                                 int radius, double radius_input_samples,
+                                 const PolyphaseResampler::Params& params) {
+  // Cutoff in cycles per input sample, times two.
+  const double cutoff =
+      params.cutoff_proportion *
+      std::min(1.0, static_cast<double>(upsample_factor) / downsample_factor);
+  const double window_scale = 1.0 / BesselI0(params.kaiser_beta);
+  const int num_taps = 2 * radius;
+  std::vector<float> filters(upsample_factor * num_taps);
+  for (int phase = 0; phase < upsample_factor; ++phase) {
+    for (int k = 0; k < num_taps; ++k) {
+      // Time from the input sample to the output sample.
+      const double t =
+          static_cast<double>(phase) / upsample_factor + radius - 1 - k;
+      const double x = t / radius_input_samples;
+      if (std::abs(x) > 1.0) continue;
+      const double window =
+          BesselI0(params.kaiser_beta * std::sqrt(1.0 - x * x)) *
+          window_scale;
+      filters[phase * num_taps + k] = cutoff * Sinc(cutoff * t) * window;
+    }
+  }
+  return filters;
+}
+
+// Maximum number of filter banks kept for new resamplers. When the limit is
+// reached, the least requested bank is dropped from the cache, and freed once
+// no resampler uses it anymore.
+constexpr int kMaxCachedFilterBanks = 8;
+// Halve the request counts of the cached banks every this many requests, and
+// drop the banks which are no longer requested.
+constexpr int kRequestCountScrubInterval = 50;
+
+// Returns the shared filter bank for the given factor and parameters.
+std::shared_ptr<const std::vector<float>> GetFilters(
+    int upsample_factor, int downsample_factor, int radius,
+    double radius_input_samples, const PolyphaseResampler::Params& params) {
+  using Filters = std::shared_ptr<const std::vector<float>>;
+  using Key = std::tuple<int, int, double, double, double>;
+  static absl::Mutex mutex(absl::kConstInit);
+  static auto* cache = new ResourceCache<Key, Filters, absl::Hash<Key>>();
+  const Key key(upsample_factor, downsample_factor,
+                params.filter_radius_factor, params.cutoff_proportion,
+                params.kaiser_beta);
+  Filters filters;
+  std::vector<Filters> evicted;
+  {
+    absl::MutexLock lock(&mutex);
+    filters = cache->Lookup(key, [&](const Key&, int) {
+      return std::make_shared<const std::vector<float>>(
+          DesignFilters(upsample_factor, downsample_factor, radius,
+                        radius_input_samples, params));
+    });
+    evicted = cache->Evict(kMaxCachedFilterBanks, kRequestCountScrubInterval);
+  }
+  // Evicted banks are released without holding the lock.
+  return filters;
+}
+
+// Computes output[c] = sum_k coefficients[k] * frames[k * num_channels + c]
+// for each channel c.
+void FilterFrames(const float* coefficients, int num_taps, const float* frames,
+                  int num_channels, float* output) {
+  if (num_channels == 1) {
+    // A single dot product over contiguous samples.
+    int k = 0;
+    float sum = 0.0f;
+#if defined(__SSE2__)
+    __m128 sum4 = _mm_setzero_ps();
+    for (; k + 4 <= num_taps; k += 4) {
+      sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_loadu_ps(coefficients + k),
+                                         _mm_loadu_ps(frames + k)));
+    }
+    float sums[4];
+    _mm_storeu_ps(sums, sum4);
+    sum = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#elif MEDIAPIPE_POLYPHASE_RESAMPLER_NEON
+    float32x4_t sum4 = vdupq_n_f32(0.0f);
+    for (; k + 4 <= num_taps; k += 4) {
+      sum4 =
+          vmlaq_f32(sum4, vld1q_f32(coefficients + k), vld1q_f32(frames + k));
+    }
+    sum = vaddvq_f32(sum4);
+#endif  // defined(__SSE2__)
+    for (; k < num_taps; ++k) {
+      sum += coefficients[k] * frames[k];
+    }
+    *output = sum;
+    return;
+  }
+
+  int c = 0;
+#if defined(__SSE2__)
+  if (num_channels == 2) {
+    // Two taps of both channels per vector, with each coefficient repeated
+    // for both channels.
+    __m128 sum4 = _mm_setzero_ps();
+    int k = 0;
+    for (; k + 2 <= num_taps; k += 2) {
+      const __m128 pair = _mm_castpd_ps(
+          _mm_load_sd(reinterpret_cast<const double*>(coefficients + k)));
+      sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_unpacklo_ps(pair, pair),
+                                         _mm_loadu_ps(frames + 2 * k)));
+    }
+    float sums[4];
+    _mm_storeu_ps(sums, sum4);
+    output[0] = sums[0] + sums[2];
+    output[1] = sums[1] + sums[3];
+    for (; k < num_taps; ++k) {
+      output[0] += coefficients[k] * frames[2 * k];
+      output[1] += coefficients[k] * frames[2 * k + 1];
+    }
+    return;
+  }
+  // One accumulator per channel, updated with the interleaved samples of
+  // each tap.
+  for (; c + 4 <= num_channels; c += 4) {
+    __m128 sum4 = _mm_setzero_ps();
+    for (int k = 0; k < num_taps; ++k) {
+      const __m128 samples = _mm_loadu_ps(frames + k * num_channels + c);
+      sum4 =
+          _mm_add_ps(sum4, _mm_mul_ps(_mm_set1_ps(coefficients[k]), samples));
+    }
+    _mm_storeu_ps(output + c, sum4);
+  }
+#elif MEDIAPIPE_POLYPHASE_RESAMPLER_NEON
+  for (; c + 4 <= num_channels; c += 4) {
+    float32x4_t sum4 = vdupq_n_f32(0.0f);
+    for (int k = 0; k < num_taps; ++k) {
+      sum4 = vmlaq_n_f32(sum4, vld1q_f32(frames + k * num_channels + c),
+                         coefficients[k]);
+    }
+    vst1q_f32(output + c, sum4);
+  }
+#endif  // defined(__SSE2__)
+  for (; c < num_channels; ++c) {
+    float sum = 0.0f;
+    for (int k = 0; k < num_taps; ++k) {
+      sum += coefficients[k] * frames[k * num_channels + c];
+    }
+    output[c] = sum;
+  }
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<PolyphaseResampler>> PolyphaseResampler::Create(
+    double source_sample_rate, double target_sample_rate, int num_channels,
+    const Params& params) {
+  RET_CHECK_GT(source_sample_rate, 0.0);
+  RET_CHECK_GT(target_sample_rate, 0.0);
+  RET_CHECK_GT(num_channels, 0);
+  RET_CHECK_GT(params.filter_radius_factor, 0.0);
+  RET_CHECK(params.cutoff_proportion > 0.0 && params.cutoff_proportion <= 1.0)
+      << "cutoff_proportion must be in (0, 1], got "
+      << params.cutoff_proportion;
+  RET_CHECK_GT(params.max_denominator, 0);
+  int64 upsample_factor;
+  int64 downsample_factor;
+  RationalApproximation(target_sample_rate / source_sample_rate,
+                        params.max_denominator, &upsample_factor,
+                        &downsample_factor);
+  RET_CHECK(upsample_factor > 0 && upsample_factor <= params.max_denominator)
+      << "Cannot approximate the resampling factor "
+      << target_sample_rate / source_sample_rate;
+  const double radius_input_samples =
+      params.filter_radius_factor *
+      std::max(1.0, static_cast<double>(downsample_factor) / upsample_factor);
+  const int radius = std::max(1, static_cast<int>(std::ceil(
+                                     radius_input_samples)));
+  return std::unique_ptr<PolyphaseResampler>(new PolyphaseResampler(
+      num_channels, upsample_factor, downsample_factor, radius,
+      GetFilters(upsample_factor, downsample_factor, radius,
+                 radius_input_samples, params)));
+}
+
+PolyphaseResampler::PolyphaseResampler(
+    int num_channels, int upsample_factor, int downsample_factor, int radius,
+    std::shared_ptr<const std::vector<float>> filters)
+    : num_channels_(num_channels),
+      upsample_factor_(upsample_factor),
+      downsample_factor_(downsample_factor),
+      radius_(radius),
+      filters_(std::move(filters)) {
+  Reset();
+}
+
+void PolyphaseResampler::Reset() {
+  // The first output sample reads radius_ - 1 samples before the input.
+  buffer_.assign((radius_ - 1) * num_channels_, 0.0f);
+  buffer_start_ = -(radius_ - 1);
+  output_index_ = 0;
+  input_index_ = 0;
+  phase_ = 0;
+}
+
+void PolyphaseResampler::ProcessSamples(const Matrix& input, Matrix* output) {
+  CHECK_EQ(input.rows(), num_channels_);
+  buffer_.insert(buffer_.end(), input.data(), input.data() + input.size());
+  // Output sample n needs the input samples up to
+  // floor(n * downsample_factor_ / upsample_factor_) + radius_.
+  const int64 buffer_end = buffer_start_ + buffer_.size() / num_channels_;
+  int64 end_output = 0;
+  if (buffer_end > radius_) {
+    end_output = ((buffer_end - radius_) * upsample_factor_ +
+                  downsample_factor_ - 1) /
+                 downsample_factor_;
+  }
+  ComputeOutputs(end_output, output);
+}
+
+void PolyphaseResampler::Flush(Matrix* output) {
+  const int64 num_input_samples =
+      buffer_start_ + buffer_.size() / num_channels_;
+  const int64 end_output =
+      (num_input_samples * upsample_factor_ + downsample_factor_ - 1) /
+      downsample_factor_;
+  if (end_output > output_index_) {
+    // Pad with zeros up to the last input sample read by the last output.
+    const int64 last_input_index =
+        (end_output - 1) * downsample_factor_ / upsample_factor_;
+    const int64 buffer_end = last_input_index + radius_ + 1;
+    buffer_.resize((buffer_end - buffer_start_) * num_channels_, 0.0f);
+  }
+  ComputeOutputs(end_output, output);
+  Reset();
+}
+
+void PolyphaseResampler::ComputeOutputs(int64 end_output, Matrix* output) {
+  const int num_outputs = std::max<int64>(0, end_output - output_index_);
+  output->resize(num_channels_, num_outputs);
+  const int num_taps = 2 * radius_;
+  for (int n = 0; n < num_outputs; ++n) {
+    const int64 first_input = input_index_ - radius_ + 1;
+    FilterFrames(filters_->data() + phase_ * num_taps, num_taps,
+                 buffer_.data() + (first_input - buffer_start_) * num_channels_,
+                 num_channels_, output->data() + n * num_channels_);
+    phase_ += downsample_factor_;
+    input_index_ += phase_ / upsample_factor_;
+    phase_ %= upsample_factor_;
+  }
+  output_index_ += num_outputs;
+
+  // Drop the samples before the first one needed by the next output sample.
+  const int64 num_dropped =
+      std::min<int64>(input_index_ - radius_ + 1 - buffer_start_,
+                      buffer_.size() / num_channels_);
+  if (num_dropped > 0) {
+    buffer_.erase(buffer_.begin(),
+                  buffer_.begin() + num_dropped * num_channels_);
+    buffer_start_ += num_dropped;
+  }
+}
+
+}  // namespace mediapipe
@@ -0,0 +1,116 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_POLYPHASE_RESAMPLER_H_
+#define MEDIAPIPE_UTIL_POLYPHASE_RESAMPLER_H_
+
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/formats/matrix.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/statusor.h"
+
+namespace mediapipe {
+
+// Resamples a multichannel signal by a rational factor with a polyphase
+// Kaiser-windowed sinc filter. All channels are filtered in one pass over
+// interleaved samples, which is the layout of the column-major Matrix used
+// for audio time series (one row per channel), and the dot products are
+// vectorized with SSE2 or NEON where available.
+//
+// The filter banks of the most requested resampling factors and filter
+// parameters are cached, and shared by the resamplers created with them.
+//
+// Output sample n is the filtered input at time n * source_sample_rate /
+// target_sample_rate, with the input taken as zero before the first sample.
+// Each output sample only depends on the input samples, so the output of
+// ProcessSamples() calls followed by Flush() is bit-identical however the
+// input is split into packets.
+//
+// Example usage:
+//   ASSIGN_OR_RETURN(auto resampler,
+//                    PolyphaseResampler::Create(44100, 16000, 2, {}));
+//   Matrix output;
+//   resampler->ProcessSamples(input, &output);
+//   ...
+//   resampler->Flush(&output);
+class PolyphaseResampler {
+ public:
+  // Filter parameters, with the meaning and defaults of
+  // audio_dsp::QResamplerParams.
+  struct Params {
+    // Filter radius, in units of the lower of the two sample periods.
+    double filter_radius_factor = 5.0;
+    // Anti-aliasing cutoff, as a proportion of the lower Nyquist frequency.
+    double cutoff_proportion = 0.9;
+    // Kaiser window beta parameter.
+    double kaiser_beta = 5.658;
+    // Largest denominator of the rational approximation of the factor.
+    int max_denominator = 2000;
+  };
+
+  static absl::StatusOr<std::unique_ptr<PolyphaseResampler>> Create(
+      double source_sample_rate, double target_sample_rate, int num_channels,
+      const Params& params);
+
+  // Resamples "input", which has one row per channel, and sets "output" to
+  // all the output samples which can be computed so far.
+  void ProcessSamples(const Matrix& input, Matrix* output);
+
+  // Sets "output" to the remaining output samples, as if the input were
+  // followed by zeros, and resets the resampler for a new signal. After
+  // Flush(), the total number of output samples is
+  // ceil(num_input_samples * target_sample_rate / source_sample_rate).
+  void Flush(Matrix* output);
+
+  // The resampling factor target_sample_rate / source_sample_rate is
+  // upsample_factor() / downsample_factor().
+  int upsample_factor() const { return upsample_factor_; }
+  int downsample_factor() const { return downsample_factor_; }
+  // Number of filter taps per output sample.
+  int num_taps() const { return 2 * radius_; }
+
+ private:
+  PolyphaseResampler(int num_channels, int upsample_factor,
+                     int downsample_factor, int radius,
+                     std::shared_ptr<const std::vector<float>> filters);
+
+  void Reset();
+  // Computes the output samples up to, but not including, "end_output".
+  void ComputeOutputs(int64 end_output, Matrix* output);
+
+  const int num_channels_;
+  const int upsample_factor_;
+  const int downsample_factor_;
+  // Number of input samples used on each side of the output time.
+  const int radius_;
+  // Coefficients of the num_taps() filter taps of each phase, phase by phase.
+  const std::shared_ptr<const std::vector<float>> filters_;
+
+  // Interleaved input samples from the first one needed by the next output
+  // sample on, and the index in the input signal of the first one.
+  std::vector<float> buffer_;
+  int64 buffer_start_;
+  // Index of the next output sample, the index of the input sample at or
+  // before its time, and its phase, in units of 1 / upsample_factor_ input
+  // samples past that input sample.
+  int64 output_index_;
+  int64 input_index_;
+  int phase_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_POLYPHASE_RESAMPLER_H_
@@ -0,0 +1,177 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/polyphase_resampler.h"
+
+#include <cmath>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+std::unique_ptr<PolyphaseResampler> CreateResampler(double source_sample_rate,
+                                                    double target_sample_rate,
+                                                    int num_channels) {
+  auto status_or_resampler = PolyphaseResampler::Create(
+      source_sample_rate, target_sample_rate, num_channels, {});
+  EXPECT_TRUE(status_or_resampler.ok()) << status_or_resampler.status();
+  return std::move(status_or_resampler).value();
+}
+
+// Returns a tone of a different frequency in each channel.
+Matrix MakeTones(int num_channels, int num_samples, double sample_rate) {
+  Matrix tones(num_channels, num_samples);
+  for (int c = 0; c < num_channels; ++c) {
+    const double frequency = 440.0 * (c + 1);
+    for (int i = 0; i < num_samples; ++i) {
+      tones(c, i) = std::sin(2 * M_PI * frequency * i / sample_rate);
+    }
+  }
+  return tones;
+}
+
+void AppendColumns(const Matrix& columns, Matrix* matrix) {
+  const int num_columns = matrix->cols();
+  matrix->conservativeResize(columns.rows(), num_columns + columns.cols());
+  matrix->rightCols(columns.cols()) = columns;
+}
+
+// Resamples "input" split into packets of "packet_size" samples, then flushes.
+Matrix ResampleInPackets(PolyphaseResampler* resampler, const Matrix& input,
+                         int packet_size) {
+  Matrix output(input.rows(), 0);
+  Matrix packet_output;
+  for (int start = 0; start < input.cols(); start += packet_size) {
+    const int size = std::min<int>(packet_size, input.cols() - start);
+    resampler->ProcessSamples(input.middleCols(start, size), &packet_output);
+    AppendColumns(packet_output, &output);
+  }
+  resampler->Flush(&packet_output);
+  AppendColumns(packet_output, &output);
+  return output;
+}
+
+TEST(PolyphaseResamplerTest, UsesExactFactorsForCommonRates) {
+  auto resampler = CreateResampler(44100, 16000, 1);
+  EXPECT_EQ(resampler->upsample_factor(), 160);
+  EXPECT_EQ(resampler->downsample_factor(), 441);
+  resampler = CreateResampler(48000, 16000, 1);
+  EXPECT_EQ(resampler->upsample_factor(), 1);
+  EXPECT_EQ(resampler->downsample_factor(), 3);
+  resampler = CreateResampler(16000, 44100, 1);
+  EXPECT_EQ(resampler->upsample_factor(), 441);
+  EXPECT_EQ(resampler->downsample_factor(), 160);
+}
+
+TEST(PolyphaseResamplerTest, PacketsDoNotChangeOutput) {
+  const std::vector<std::pair<double, double>> rates = {
+      {44100, 16000}, {48000, 16000}, {16000, 44100}, {4000, 7600}};
+  for (const auto& rate : rates) {
+    for (int num_channels : {1, 2, 6}) {
+      SCOPED_TRACE(testing::Message() << rate.first << " -> " << rate.second
+                                      << ", " << num_channels << " channels");
+      const Matrix input = MakeTones(num_channels, 5000, rate.first);
+      auto resampler = CreateResampler(rate.first, rate.second, num_channels);
+      const Matrix expected =
+          ResampleInPackets(resampler.get(), input, input.cols());
+      EXPECT_EQ(expected.cols(),
+                std::ceil(input.cols() * rate.second / rate.first));
+      // The resampler is reset by Flush() and can be reused.
+      for (int packet_size : {1, 7, 160, 441, 1000}) {
+        const Matrix actual =
+            ResampleInPackets(resampler.get(), input, packet_size);
+        ASSERT_EQ(actual.cols(), expected.cols()) << packet_size;
+        EXPECT_TRUE(actual == expected) << packet_size;
+      }
+    }
+  }
+}
+
+TEST(PolyphaseResamplerTest, ChannelsAreIndependent) {
+  constexpr int kNumChannels = 5;
+  const Matrix input = MakeTones(kNumChannels, 3000, 48000);
+  auto resampler = CreateResampler(48000, 16000, kNumChannels);
+  const Matrix output = ResampleInPackets(resampler.get(), input, 512);
+  for (int c = 0; c < kNumChannels; ++c) {
+    auto mono_resampler = CreateResampler(48000, 16000, 1);
+    const Matrix mono_output =
+        ResampleInPackets(mono_resampler.get(), input.row(c), 512);
+    EXPECT_TRUE(output.row(c).isApprox(mono_output, 1e-5f)) << c;
+  }
+}
+
+TEST(PolyphaseResamplerTest, PreservesTones) {
+  const std::vector<std::pair<double, double>> rates = {
+      {44100, 16000}, {48000, 16000}, {16000, 44100}};
+  for (const auto& rate : rates) {
+    SCOPED_TRACE(testing::Message() << rate.first << " -> " << rate.second);
+    const Matrix input = MakeTones(2, 4000, rate.first);
+    auto resampler = CreateResampler(rate.first, rate.second, 2);
+    const Matrix output = ResampleInPackets(resampler.get(), input, 256);
+    const Matrix expected = MakeTones(2, output.cols(), rate.second);
+    // Skip the edges, where the input is taken as zero.
+    const int margin = 100;
+    const int size = output.cols() - 2 * margin;
+    const Matrix difference =
+        output.middleCols(margin, size) - expected.middleCols(margin, size);
+    EXPECT_LT(difference.cwiseAbs().maxCoeff(), 2e-3);
+  }
+}
+
+// Tests that a resampler keeps its filter bank when many other resampling
+// factors push it out of the shared cache.
+TEST(PolyphaseResamplerTest, OutlivesCachedFilterBank) {
+  const Matrix input = MakeTones(2, 3000, 44100);
+  auto resampler = CreateResampler(44100, 15000, 2);
+  const Matrix expected = ResampleInPackets(resampler.get(), input, 512);
+  // More factors than the cache holds, each requested once.
+  for (int target_sample_rate = 8000; target_sample_rate < 8500;
+       target_sample_rate += 5) {
+    CreateResampler(44100, target_sample_rate, 2);
+  }
+  EXPECT_TRUE(ResampleInPackets(resampler.get(), input, 512) == expected);
+  auto new_resampler = CreateResampler(44100, 15000, 2);
+  EXPECT_TRUE(ResampleInPackets(new_resampler.get(), input, 512) == expected);
+}
+
+TEST(PolyphaseResamplerTest, RejectsInvalidArguments) {
+  EXPECT_FALSE(PolyphaseResampler::Create(0, 16000, 1, {}).ok());
+  EXPECT_FALSE(PolyphaseResampler::Create(16000, -1, 1, {}).ok());
+  EXPECT_FALSE(PolyphaseResampler::Create(44100, 16000, 0, {}).ok());
+  PolyphaseResampler::Params params;
+  params.cutoff_proportion = 1.5;
+  EXPECT_FALSE(PolyphaseResampler::Create(44100, 16000, 1, params).ok());
+}
+
+// One second of audio resampled from 44.1 kHz to 16 kHz in 10 ms packets.
+void BM_Resample(benchmark::State& state) {
+  const int num_channels = state.range(0);
+  const Matrix input = MakeTones(num_channels, 441, 44100);
+  auto resampler = CreateResampler(44100, 16000, num_channels);
+  Matrix output;
+  for (auto _ : state) {
+    for (int i = 0; i < 100; ++i) {
+      resampler->ProcessSamples(input, &output);
+      benchmark::DoNotOptimize(output.data());
+    }
+  }
+}
+BENCHMARK(BM_Resample)->Arg(1)->Arg(2)->Arg(8);
+
+}  // namespace
+}  // namespace mediapipe
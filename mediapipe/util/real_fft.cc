@@ -0,0 +1,189 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/real_fft.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "mediapipe/framework/port/ret_check.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDIAPIPE_REAL_FFT_NEON 1
+#endif
+
+namespace mediapipe {
+namespace {
+
+// Number of frames transformed together. Large enough to fill the vector
+// registers in the first butterfly pass, small enough for the work buffers of
+// typical audio frames to stay in the L2 cache.
+constexpr int kMaxGroupFrames = 16;
+
+// Computes "size" radix-2 butterflies sharing the twiddle factor w:
+//   sum = a + b, diff = (a - b) * w.
+void Butterflies(const float* a_re, const float* a_im, const float* b_re,
+                 const float* b_im, int size, float w_re, float w_im,
+                 float* sum_re, float* sum_im, float* diff_re,
+                 float* diff_im) {
+  int t = 0;
+#if defined(__SSE2__)
+  const __m128 w_re4 = _mm_set1_ps(w_re);
+  const __m128 w_im4 = _mm_set1_ps(w_im);
+  for (; t + 4 <= size; t += 4) {
+    const __m128 ar = _mm_loadu_ps(a_re + t);
+    const __m128 ai = _mm_loadu_ps(a_im + t);
+    const __m128 br = _mm_loadu_ps(b_re + t);
+    const __m128 bi = _mm_loadu_ps(b_im + t);
+    const __m128 dr = _mm_sub_ps(ar, br);
+    const __m128 di = _mm_sub_ps(ai, bi);
+    _mm_storeu_ps(sum_re + t, _mm_add_ps(ar, br));
+    _mm_storeu_ps(sum_im + t, _mm_add_ps(ai, bi));
+    _mm_storeu_ps(diff_re + t,
+                  _mm_sub_ps(_mm_mul_ps(dr, w_re4), _mm_mul_ps(di, w_im4)));
+    _mm_storeu_ps(diff_im + t,
+                  _mm_add_ps(_mm_mul_ps(dr, w_im4), _mm_mul_ps(di, w_re4)));
+  }
+#elif MEDIAPIPE_REAL_FFT_NEON
+  const float32x4_t w_re4 = vdupq_n_f32(w_re);
+  const float32x4_t w_im4 = vdupq_n_f32(w_im);
+  for (; t + 4 <= size; t += 4) {
+    const float32x4_t ar = vld1q_f32(a_re + t);
+    const float32x4_t ai = vld1q_f32(a_im + t);
+    const float32x4_t br = vld1q_f32(b_re + t);
+    const float32x4_t bi = vld1q_f32(b_im + t);
+    const float32x4_t dr = vsubq_f32(ar, br);
+    const float32x4_t di = vsubq_f32(ai, bi);
+    vst1q_f32(sum_re + t, vaddq_f32(ar, br));
+    vst1q_f32(sum_im + t, vaddq_f32(ai, bi));
+    vst1q_f32(diff_re + t, vmlsq_f32(vmulq_f32(dr, w_re4), di, w_im4));
+    vst1q_f32(diff_im + t, vmlaq_f32(vmulq_f32(dr, w_im4), di, w_re4));
+  }
+#endif  // defined(__SSE2__)
+  for (; t < size; ++t) {
+    const float d_re = a_re[t] - b_re[t];
+    const float d_im = a_im[t] - b_im[t];
+    sum_re[t] = a_re[t] + b_re[t];
+    sum_im[t] = a_im[t] + b_im[t];
+    diff_re[t] = d_re * w_re - d_im * w_im;
+    diff_im[t] = d_re * w_im + d_im * w_re;
+  }
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<RealFft>> Radix2RealFft::Create(
+    int fft_length) {
+  RET_CHECK(fft_length >= 2 && (fft_length & (fft_length - 1)) == 0)
+      << "FFT length must be a power of two, got " << fft_length;
+  return std::unique_ptr<RealFft>(new Radix2RealFft(fft_length));
+}
+
+Radix2RealFft::Radix2RealFft(int fft_length) : fft_length_(fft_length) {
+  const int half_length = fft_length / 2;
+  for (int j = 0; j < half_length / 2; ++j) {
+    const double angle = -2.0 * M_PI * j / half_length;
+    butterfly_cos_.push_back(std::cos(angle));
+    butterfly_sin_.push_back(std::sin(angle));
+  }
+  for (int k = 0; k <= half_length; ++k) {
+    const double angle = -2.0 * M_PI * k / fft_length;
+    split_cos_.push_back(std::cos(angle));
+    split_sin_.push_back(std::sin(angle));
+  }
+  real_.resize(half_length * kMaxGroupFrames);
+  imag_.resize(half_length * kMaxGroupFrames);
+  real_swap_.resize(half_length * kMaxGroupFrames);
+  imag_swap_.resize(half_length * kMaxGroupFrames);
+}
+
+void Radix2RealFft::ForwardBatch(const float* input, int input_stride,
+                                 int num_frames, std::complex<float>* output,
+                                 int output_stride) {
+  for (int first = 0; first < num_frames; first += kMaxGroupFrames) {
+    ForwardGroup(input + first * input_stride, input_stride,
+                 std::min(kMaxGroupFrames, num_frames - first),
+                 output + first * output_stride, output_stride);
+  }
+}
+
+void Radix2RealFft::ForwardGroup(const float* input, int input_stride,
+                                 int num_frames, std::complex<float>* output,
+                                 int output_stride) {
+  const int half_length = fft_length_ / 2;
+
+  // Pack the even samples of each frame as the real parts, and the odd
+  // samples as the imaginary parts, of a half length complex sequence.
+  // Element n of frame f is stored at n * num_frames + f.
+  float* real = real_.data();
+  float* imag = imag_.data();
+  for (int f = 0; f < num_frames; ++f) {
+    const float* frame = input + f * input_stride;
+    for (int n = 0; n < half_length; ++n) {
+      real[n * num_frames + f] = frame[2 * n];
+      imag[n * num_frames + f] = frame[2 * n + 1];
+    }
+  }
+
+  // Stockham radix-2 passes, which need no bit reversal. In the pass with
+  // "span" elements per butterfly leg, the butterflies sharing a twiddle
+  // factor touch contiguous runs of span * num_frames values.
+  float* real_out = real_swap_.data();
+  float* imag_out = imag_swap_.data();
+  for (int span = 1, legs = half_length / 2; legs >= 1;
+       span *= 2, legs /= 2) {
+    const int run = span * num_frames;
+    for (int p = 0; p < legs; ++p) {
+      Butterflies(real + p * run, imag + p * run, real + (p + legs) * run,
+                  imag + (p + legs) * run, run, butterfly_cos_[p * span],
+                  butterfly_sin_[p * span], real_out + 2 * p * run,
+                  imag_out + 2 * p * run, real_out + (2 * p + 1) * run,
+                  imag_out + (2 * p + 1) * run);
+    }
+    std::swap(real, real_out);
+    std::swap(imag, imag_out);
+  }
+
+  // Split the half length transform Z into the real transform:
+  //   X[k] = (Z[k] + conj(Z[N/2 - k])) / 2
+  //          - i * exp(-2 pi i k / N) * (Z[k] - conj(Z[N/2 - k])) / 2.
+  for (int k = 0; k <= half_length; ++k) {
+    const int index = (k % half_length) * num_frames;
+    const int mirror = ((half_length - k) % half_length) * num_frames;
+    const float w_re = split_cos_[k];
+    const float w_im = split_sin_[k];
+    for (int f = 0; f < num_frames; ++f) {
+      const float a_re = real[index + f];
+      const float a_im = imag[index + f];
+      const float b_re = real[mirror + f];
+      const float b_im = -imag[mirror + f];
+      const float even_re = 0.5f * (a_re + b_re);
+      const float even_im = 0.5f * (a_im + b_im);
+      const float odd_re = 0.5f * (a_im - b_im);
+      const float odd_im = -0.5f * (a_re - b_re);
+      output[f * output_stride + k] =
+          std::complex<float>(even_re + w_re * odd_re - w_im * odd_im,
+                              even_im + w_re * odd_im + w_im * odd_re);
+    }
+  }
+}
+
+REGISTER_REAL_FFT(Radix2RealFft);
+
+}  // namespace mediapipe
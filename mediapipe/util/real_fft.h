@@ -0,0 +1,107 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_REAL_FFT_H_
+#define MEDIAPIPE_UTIL_REAL_FFT_H_
+
+#include <complex>
+#include <memory>
+#include <vector>
+
+#include "mediapipe/framework/deps/registration.h"
+#include "mediapipe/framework/port/statusor.h"
+
+namespace mediapipe {
+
+// Computes the discrete Fourier transform of real frames whose length is a
+// power of two, many frames per call:
+//
+//   X[k] = sum_n x[n] * exp(-2 * pi * i * n * k / fft_length),
+//
+// for the num_bins() = fft_length / 2 + 1 non-redundant bins k.
+//
+// Implementations are registered with REGISTER_REAL_FFT and created by name,
+// so that a faster backend can be linked in without changing its users:
+//
+//   ASSIGN_OR_RETURN(std::unique_ptr<RealFft> fft,
+//                    RealFftRegistry::CreateByName("Radix2RealFft", 512));
+//
+// A RealFft keeps work buffers, so it must not be used from several threads
+// at once.
+class RealFft {
+ public:
+  virtual ~RealFft() = default;
+
+  virtual int fft_length() const = 0;
+  int num_bins() const { return fft_length() / 2 + 1; }
+
+  // Transforms "num_frames" frames. Frame i has fft_length() samples starting
+  // at input + i * input_stride, and its num_bins() bins are written starting
+  // at output + i * output_stride.
+  virtual void ForwardBatch(const float* input, int input_stride,
+                            int num_frames, std::complex<float>* output,
+                            int output_stride) = 0;
+};
+
+using RealFftRegistry =
+    GlobalFactoryRegistry<absl::StatusOr<std::unique_ptr<RealFft>>, int>;
+
+// Registers a RealFft implementation "name", which must have a static
+// absl::StatusOr<std::unique_ptr<RealFft>> Create(int fft_length).
+#define REGISTER_REAL_FFT(name)                                      \
+  REGISTER_FACTORY_FUNCTION_QUALIFIED(mediapipe::RealFftRegistry,    \
+                                      real_fft_registration, name,   \
+                                      name::Create)
+
+// The built-in implementation: a radix-2 FFT of half the length on packed
+// even and odd samples. Frames are transformed in groups, with the samples of
+// a group interleaved so that every butterfly loop runs over contiguous
+// memory and is vectorized with SSE2 or NEON where available.
+class Radix2RealFft : public RealFft {
+ public:
+  // Returns an error unless "fft_length" is a power of two, at least 2.
+  static absl::StatusOr<std::unique_ptr<RealFft>> Create(int fft_length);
+
+  int fft_length() const override { return fft_length_; }
+  void ForwardBatch(const float* input, int input_stride, int num_frames,
+                    std::complex<float>* output, int output_stride) override;
+
+ private:
+  explicit Radix2RealFft(int fft_length);
+
+  // Transforms at most kMaxGroupFrames frames.
+  void ForwardGroup(const float* input, int input_stride, int num_frames,
+                    std::complex<float>* output, int output_stride);
+
+  const int fft_length_;
+  // exp(-2 * pi * i * j / (fft_length / 2)) for j < fft_length / 4, used by
+  // the butterflies.
+  std::vector<float> butterfly_cos_;
+  std::vector<float> butterfly_sin_;
+  // exp(-2 * pi * i * k / fft_length) for k <= fft_length / 2, used to split
+  // the half length transform into the real transform.
+  std::vector<float> split_cos_;
+  std::vector<float> split_sin_;
+  // Real and imaginary parts of the half length transforms of a group, with
+  // the frames of a group interleaved, and the same for the other half of
+  // each butterfly pass.
+  std::vector<float> real_;
+  std::vector<float> imag_;
+  std::vector<float> real_swap_;
+  std::vector<float> imag_swap_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_REAL_FFT_H_
@@ -0,0 +1,111 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/real_fft.h"
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+
+namespace mediapipe {
+namespace {
+
+std::unique_ptr<RealFft> CreateFft(int fft_length) {
+  auto status_or_fft = RealFftRegistry::CreateByName("Radix2RealFft",
+                                                     fft_length);
+  EXPECT_TRUE(status_or_fft.ok()) << status_or_fft.status();
+  return std::move(status_or_fft).value();
+}
+
+std::vector<float> MakeFrames(int num_frames, int stride) {
+  std::vector<float> samples(num_frames * stride);
+  for (int i = 0; i < samples.size(); ++i) {
+    samples[i] = std::sin(0.37f * i) + 0.25f * std::cos(1.91f * i * i);
+  }
+  return samples;
+}
+
+void ExpectMatchesDft(const float* frame, int fft_length,
+                      const std::complex<float>* bins) {
+  for (int k = 0; k <= fft_length / 2; ++k) {
+    std::complex<double> expected = 0.0;
+    for (int n = 0; n < fft_length; ++n) {
+      expected += static_cast<double>(frame[n]) *
+                  std::polar(1.0, -2.0 * M_PI * n * k / fft_length);
+    }
+    const double tolerance = 1e-5 * fft_length;
+    ASSERT_NEAR(bins[k].real(), expected.real(), tolerance) << "bin " << k;
+    ASSERT_NEAR(bins[k].imag(), expected.imag(), tolerance) << "bin " << k;
+  }
+}
+
+TEST(RealFftTest, MatchesDft) {
+  for (int fft_length = 2; fft_length <= 1024; fft_length *= 2) {
+    SCOPED_TRACE(fft_length);
+    auto fft = CreateFft(fft_length);
+    ASSERT_EQ(fft->fft_length(), fft_length);
+    ASSERT_EQ(fft->num_bins(), fft_length / 2 + 1);
+    const std::vector<float> input = MakeFrames(1, fft_length);
+    std::vector<std::complex<float>> output(fft->num_bins());
+    fft->ForwardBatch(input.data(), fft_length, 1, output.data(),
+                      fft->num_bins());
+    ExpectMatchesDft(input.data(), fft_length, output.data());
+  }
+}
+
+TEST(RealFftTest, BatchWithStrides) {
+  constexpr int kFftLength = 64;
+  constexpr int kNumFrames = 37;
+  constexpr int kInputStride = 70;
+  constexpr int kOutputStride = 40;
+  auto fft = CreateFft(kFftLength);
+  const std::vector<float> input = MakeFrames(kNumFrames, kInputStride);
+  std::vector<std::complex<float>> output(kNumFrames * kOutputStride);
+  fft->ForwardBatch(input.data(), kInputStride, kNumFrames, output.data(),
+                    kOutputStride);
+  for (int f = 0; f < kNumFrames; ++f) {
+    SCOPED_TRACE(f);
+    ExpectMatchesDft(input.data() + f * kInputStride, kFftLength,
+                     output.data() + f * kOutputStride);
+  }
+}
+
+TEST(RealFftTest, RejectsInvalidLengths) {
+  EXPECT_FALSE(Radix2RealFft::Create(0).ok());
+  EXPECT_FALSE(Radix2RealFft::Create(1).ok());
+  EXPECT_FALSE(Radix2RealFft::Create(400).ok());
+  EXPECT_FALSE(RealFftRegistry::CreateByName("NoSuchFft", 512).ok());
+}
+
+// One second of 16 kHz audio in 25 ms frames with a 10 ms step.
+void BM_ForwardBatch(benchmark::State& state) {
+  constexpr int kFftLength = 512;
+  constexpr int kNumFrames = 100;
+  auto fft = CreateFft(kFftLength);
+  const std::vector<float> input = MakeFrames(kNumFrames, kFftLength);
+  std::vector<std::complex<float>> output(kNumFrames * fft->num_bins());
+  for (auto _ : state) {
+    fft->ForwardBatch(input.data(), kFftLength, kNumFrames, output.data(),
+                      fft->num_bins());
+    benchmark::DoNotOptimize(output.data());
+  }
+}
+BENCHMARK(BM_ForwardBatch);
+
+}  // namespace
+}  // namespace mediapipe
@@ -0,0 +1,429 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/video_decoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <utility>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/str_cat.h"
+#include "mediapipe/framework/deps/cleanup.h"
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/port/logging.h"
+#include "mediapipe/framework/port/ret_check.h"
+#include "mediapipe/framework/tool/status_util.h"
+
+namespace mediapipe {
+namespace {
+
+std::string AvErrorToString(int error) {
+  char buf[AV_ERROR_MAX_STRING_SIZE];
+  if (av_strerror(error, buf, sizeof(buf)) == 0) {
+    return absl::StrCat("AVERROR(", error, ") - ", buf);
+  }
+  return absl::StrCat("Unknown AVERROR number ", error);
+}
+
+absl::Status GetPixelFormat(ImageFormat::Format format,
+                            AVPixelFormat* pixel_format) {
+  switch (format) {
+    case ImageFormat::SRGB:
+      *pixel_format = AV_PIX_FMT_RGB24;
+      return absl::OkStatus();
+    case ImageFormat::SRGBA:
+      *pixel_format = AV_PIX_FMT_RGBA;
+      return absl::OkStatus();
+    case ImageFormat::GRAY8:
+      *pixel_format = AV_PIX_FMT_GRAY8;
+      return absl::OkStatus();
+    default:
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unsupported output format: ", format));
+  }
+}
+
+}  // namespace
+
+VideoDecoder::VideoDecoder() { av_register_all(); }
+
+VideoDecoder::~VideoDecoder() {
+  absl::Status status = Close();
+  if (!status.ok()) {
+    LOG(ERROR) << "Encountered error while closing media file: "
+               << status.message();
+  }
+}
+
+absl::Status VideoDecoder::Initialize(const std::string& input_file,
+                                      const VideoDecoderOptions& options) {
+  RET_CHECK(!decode_thread_) << "VideoDecoder is already initialized.";
+  options_ = options;
+  RET_CHECK_GT(options_.max_queued_frames(), 0);
+  if (options_.frame_selection() == VideoDecoderOptions::EVERY_NTH_FRAME) {
+    RET_CHECK_GT(options_.frame_stride(), 0);
+  }
+  if (options_.frame_selection() == VideoDecoderOptions::TARGET_FRAME_RATE) {
+    RET_CHECK_GT(options_.target_frame_rate(), 0);
+  }
+  MP_RETURN_IF_ERROR(
+      GetPixelFormat(options_.output_format(), &output_pixel_format_));
+
+  Cleanup<std::function<void()>> decoder_closer([this]() {
+    absl::Status status = Close();
+    if (!status.ok()) {
+      LOG(ERROR) << "Encountered error while closing media file: "
+                 << status.message();
+    }
+  });
+
+  avformat_ctx_ = avformat_alloc_context();
+  if (avformat_open_input(&avformat_ctx_, input_file.c_str(), NULL, NULL) < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Could not open file: ", input_file));
+  }
+  if (avformat_find_stream_info(avformat_ctx_, NULL) < 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Could not find stream information of file: ", input_file));
+  }
+
+  AVStream* stream = nullptr;
+  for (int current_video_index = 0, stream_id = 0;
+       stream_id < static_cast<int>(avformat_ctx_->nb_streams); ++stream_id) {
+    if (avformat_ctx_->streams[stream_id]->codecpar->codec_type !=
+        AVMEDIA_TYPE_VIDEO) {
+      continue;
+    }
+    if (current_video_index == options_.stream_index()) {
+      stream_id_ = stream_id;
+      stream = avformat_ctx_->streams[stream_id];
+      break;
+    }
+    ++current_video_index;
+  }
+  if (!stream) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Could not find video stream with index ",
+                     options_.stream_index(), " in file ", input_file));
+  }
+
+  const AVCodec* avcodec = avcodec_find_decoder(stream->codecpar->codec_id);
+  if (!avcodec) {
+    return absl::InvalidArgumentError("Failed to find codec");
+  }
+  avcodec_ctx_ = avcodec_alloc_context3(avcodec);
+  if (avcodec_parameters_to_context(avcodec_ctx_, stream->codecpar) < 0) {
+    return absl::UnknownError("avcodec_parameters_to_context() failed.");
+  }
+  // Frame threading decodes consecutive frames in parallel, slice threading
+  // the slices of a frame. The codec uses whichever it supports.
+  avcodec_ctx_->thread_count = options_.num_threads();
+  avcodec_ctx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+  if (options_.frame_selection() == VideoDecoderOptions::KEYFRAMES_ONLY) {
+    avcodec_ctx_->skip_frame = AVDISCARD_NONKEY;
+  }
+  if (avcodec_open2(avcodec_ctx_, avcodec, nullptr) < 0) {
+    return absl::UnknownError("avcodec_open() failed.");
+  }
+  decoded_frame_ = av_frame_alloc();
+
+  time_base_ = stream->time_base;
+  start_pts_ = stream->start_time;
+  AVRational frame_rate = stream->avg_frame_rate;
+  if (frame_rate.num <= 0 || frame_rate.den <= 0) {
+    frame_rate = stream->r_frame_rate;
+  }
+  if (frame_rate.num > 0 && frame_rate.den > 0) {
+    frame_rate_ = av_q2d(frame_rate);
+  }
+  if (options_.frame_selection() == VideoDecoderOptions::EVERY_NTH_FRAME ||
+      options_.frame_selection() == VideoDecoderOptions::TARGET_FRAME_RATE) {
+    RET_CHECK_GT(frame_rate_, 0)
+        << "Frame selection needs the frame rate of the stream, which is "
+           "unknown for "
+        << input_file;
+  }
+
+  header_.format = options_.output_format();
+  header_.width = avcodec_ctx_->width;
+  header_.height = avcodec_ctx_->height;
+  RET_CHECK(header_.width > 0 && header_.height > 0)
+      << "Invalid frame size " << header_.width << "x" << header_.height
+      << " in " << input_file;
+  switch (options_.frame_selection()) {
+    case VideoDecoderOptions::EVERY_NTH_FRAME:
+      header_.frame_rate = frame_rate_ / options_.frame_stride();
+      break;
+    case VideoDecoderOptions::TARGET_FRAME_RATE:
+      header_.frame_rate = std::min(frame_rate_, options_.target_frame_rate());
+      break;
+    default:
+      header_.frame_rate = frame_rate_;
+  }
+  if (avformat_ctx_->duration > 0) {
+    header_.duration = static_cast<double>(avformat_ctx_->duration) /
+                       AV_TIME_BASE;
+  } else if (stream->duration > 0) {
+    header_.duration = stream->duration * av_q2d(time_base_);
+  }
+
+  // Keep enough buffers for the queued frames and the ones being filled and
+  // consumed.
+  frame_pool_ =
+      ImageFramePool::Create(header_.width, header_.height,
+                             header_.format, options_.max_queued_frames() + 2);
+
+  VLOG(1) << "Opened video stream " << stream_id_ << " of " << input_file
+          << " (" << header_.width << "x" << header_.height << ", "
+          << frame_rate_ << " fps, codec " << avcodec->name << ").";
+
+  {
+    absl::MutexLock lock(&mutex_);
+    stop_ = false;
+    queue_.clear();
+  }
+  decode_thread_ =
+      absl::make_unique<std::thread>(&VideoDecoder::DecodeLoop, this);
+
+  decoder_closer.release();
+  return absl::OkStatus();
+}
+
+absl::Status VideoDecoder::FillVideoHeader(VideoHeader* header) const {
+  RET_CHECK(header);
+  RET_CHECK(header_.format != ImageFormat::UNKNOWN)
+      << "video stream is not open.";
+  *header = header_;
+  return absl::OkStatus();
+}
+
+absl::Status VideoDecoder::GetData(Packet* data) {
+  RET_CHECK(decode_thread_) << "VideoDecoder is not initialized.";
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &VideoDecoder::QueueHasData));
+  QueueItem& item = queue_.front();
+  if (!item.status.ok()) {
+    // The decoding thread has stopped after this item, so keep it for any
+    // later call.
+    return item.status;
+  }
+  *data = std::move(item.data);
+  queue_.pop_front();
+  return absl::OkStatus();
+}
+
+absl::Status VideoDecoder::Close() {
+  StopDecoding();
+  if (sws_ctx_) {
+    sws_freeContext(sws_ctx_);
+    sws_ctx_ = nullptr;
+  }
+  if (decoded_frame_) {
+    av_frame_free(&decoded_frame_);
+  }
+  if (avcodec_ctx_) {
+    avcodec_free_context(&avcodec_ctx_);
+  }
+  if (avformat_ctx_) {
+    avformat_close_input(&avformat_ctx_);
+  }
+  return absl::OkStatus();
+}
+
+void VideoDecoder::DecodeLoop() {
+  const absl::Status status = DecodeStream();
+  absl::MutexLock lock(&mutex_);
+  if (stop_) return;
+  // The final status may exceed max_queued_frames by one.
+  queue_.push_back({status, Packet()});
+}
+
+absl::Status VideoDecoder::DecodeStream() {
+  AVPacket packet;
+  av_init_packet(&packet);
+  packet.data = nullptr;
+  packet.size = 0;
+  while (true) {
+    const int ret = av_read_frame(avformat_ctx_, &packet);
+    if (ret < 0) {
+      if (ret == AVERROR(EAGAIN)) {
+        // The demuxer is trying to re-sync.
+        continue;
+      }
+      const int demuxing_error =
+          avformat_ctx_->pb ? avformat_ctx_->pb->error : 0 /* no error */;
+      RET_CHECK(ret == AVERROR_EOF && !demuxing_error)
+          << "Failed to read a frame: " << AvErrorToString(ret)
+          << ", avformat_ctx_->pb->error = " << demuxing_error;
+      break;
+    }
+    absl::Status status;
+    if (packet.stream_index == stream_id_ && !SkipPacket(packet)) {
+      status = DecodePacket(&packet);
+    }
+    av_packet_unref(&packet);
+    MP_RETURN_IF_ERROR(status);
+  }
+  // Flush the frames buffered by the codec.
+  MP_RETURN_IF_ERROR(DecodePacket(nullptr));
+  return tool::StatusStop();
+}
+
+absl::Status VideoDecoder::DecodePacket(const AVPacket* packet) {
+  int ret = avcodec_send_packet(avcodec_ctx_, packet);
+  if (ret < 0 && ret != AVERROR_EOF) {
+    return absl::UnknownError(
+        absl::StrCat("Failed to send packet: ", AvErrorToString(ret)));
+  }
+  while (true) {
+    ret = avcodec_receive_frame(avcodec_ctx_, decoded_frame_);
+    if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+      return absl::OkStatus();
+    }
+    if (ret < 0) {
+      return absl::UnknownError(
+          absl::StrCat("Failed to receive frame: ", AvErrorToString(ret)));
+    }
+    const absl::Status status = OutputFrame(*decoded_frame_);
+    av_frame_unref(decoded_frame_);
+    MP_RETURN_IF_ERROR(status);
+  }
+}
+
+bool VideoDecoder::SkipPacket(const AVPacket& packet) const {
+  switch (options_.frame_selection()) {
+    case VideoDecoderOptions::ALL_FRAMES:
+      return false;
+    case VideoDecoderOptions::KEYFRAMES_ONLY:
+      return !(packet.flags & AV_PKT_FLAG_KEY);
+    default:
+#ifdef AV_PKT_FLAG_DISPOSABLE
+      // No other frame references a disposable frame, so the codec does not
+      // need it unless it is output.
+      return (packet.flags & AV_PKT_FLAG_DISPOSABLE) &&
+             packet.pts != AV_NOPTS_VALUE && start_pts_ != AV_NOPTS_VALUE &&
+             !IsSelected(FrameIndex(packet.pts));
+#else
+      return false;
+#endif  // AV_PKT_FLAG_DISPOSABLE
+  }
+}
+
+absl::Status VideoDecoder::OutputFrame(const AVFrame& frame) {
+  int64 pts = frame.best_effort_timestamp;
+  if (pts == AV_NOPTS_VALUE) {
+    pts = frame.pts;
+  }
+  if (pts == AV_NOPTS_VALUE) {
+    VLOG(1) << "Skipping video frame without a timestamp.";
+    return absl::OkStatus();
+  }
+  if (start_pts_ == AV_NOPTS_VALUE) {
+    start_pts_ = pts;
+  }
+  const bool selected =
+      options_.frame_selection() == VideoDecoderOptions::KEYFRAMES_ONLY
+          ? frame.key_frame
+          : IsSelected(FrameIndex(pts));
+  if (!selected) {
+    return absl::OkStatus();
+  }
+  const Timestamp timestamp(av_rescale_q(pts, time_base_, {1, 1000000}));
+  if (last_timestamp_ != Timestamp::Unset() && timestamp <= last_timestamp_) {
+    VLOG(1) << "Skipping video frame with timestamp " << timestamp
+            << " not after the previous one " << last_timestamp_;
+    return absl::OkStatus();
+  }
+
+  ImageFrameSharedPtr buffer = frame_pool_->GetBuffer();
+  RET_CHECK(buffer);
+  sws_ctx_ = sws_getCachedContext(
+      sws_ctx_, frame.width, frame.height,
+      static_cast<AVPixelFormat>(frame.format), header_.width, header_.height,
+      output_pixel_format_, SWS_BILINEAR, nullptr, nullptr, nullptr);
+  RET_CHECK(sws_ctx_) << "Cannot convert video frames of format "
+                      << frame.format;
+  uint8* output_data[4] = {buffer->MutablePixelData()};
+  int output_linesize[4] = {buffer->WidthStep()};
+  sws_scale(sws_ctx_, frame.data, frame.linesize, 0, frame.height,
+            output_data, output_linesize);
+
+  // The output frame shares the pixels of the pooled buffer, which returns to
+  // the pool when the output frame is deleted.
+  auto image_frame = absl::make_unique<ImageFrame>(
+      buffer->Format(), buffer->Width(), buffer->Height(), buffer->WidthStep(),
+      buffer->MutablePixelData(), [buffer](uint8*) mutable { buffer.reset(); });
+  last_timestamp_ = timestamp;
+  if (!Push({absl::OkStatus(), Adopt(image_frame.release()).At(timestamp)})) {
+    return absl::CancelledError("Video decoding was stopped.");
+  }
+  return absl::OkStatus();
+}
+
+int64 VideoDecoder::FrameIndex(int64 pts) const {
+  return std::llround((pts - start_pts_) * av_q2d(time_base_) * frame_rate_);
+}
+
+bool VideoDecoder::IsSelected(int64 frame_index) const {
+  switch (options_.frame_selection()) {
+    case VideoDecoderOptions::EVERY_NTH_FRAME:
+      return frame_index % options_.frame_stride() == 0;
+    case VideoDecoderOptions::TARGET_FRAME_RATE: {
+      // Select the first frame of each output period.
+      const double output_frames_per_frame =
+          options_.target_frame_rate() / frame_rate_;
+      if (output_frames_per_frame >= 1.0) return true;
+      // The small offset keeps exact multiples from rounding down.
+      auto period = [output_frames_per_frame](int64 index) {
+        return std::floor(index * output_frames_per_frame + 1e-6);
+      };
+      return period(frame_index) != period(frame_index - 1);
+    }
+    default:
+      return true;
+  }
+}
+
+bool VideoDecoder::Push(QueueItem item) {
+  absl::MutexLock lock(&mutex_);
+  mutex_.Await(absl::Condition(this, &VideoDecoder::QueueHasSpace));
+  if (stop_) return false;
+  queue_.push_back(std::move(item));
+  return true;
+}
+
+void VideoDecoder::StopDecoding() {
+  if (!decode_thread_) {
+    return;
+  }
+  {
+    absl::MutexLock lock(&mutex_);
+    stop_ = true;
+  }
+  decode_thread_->join();
+  decode_thread_.reset();
+  absl::MutexLock lock(&mutex_);
+  queue_.clear();
+}
+
+bool VideoDecoder::QueueHasSpace() const {
+  return stop_ ||
+         static_cast<int>(queue_.size()) < options_.max_queued_frames();
+}
+
+bool VideoDecoder::QueueHasData() const { return !queue_.empty(); }
+
+}  // namespace mediapipe
@@ -0,0 +1,141 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_VIDEO_DECODER_H_
+#define MEDIAPIPE_UTIL_VIDEO_DECODER_H_
+
+#include <cstdint>  // required by avutil.h
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+
+#include "absl/base/thread_annotations.h"
+#include "absl/synchronization/mutex.h"
+#include "mediapipe/framework/formats/image_frame_pool.h"
+#include "mediapipe/framework/formats/video_stream_header.h"
+#include "mediapipe/framework/packet.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+#include "mediapipe/framework/timestamp.h"
+#include "mediapipe/util/video_decoder.pb.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libavutil/avutil.h"
+#include "libswscale/swscale.h"
+}
+
+namespace mediapipe {
+
+// Decodes a video stream of a media file into ImageFrames.
+//
+// Demuxing, decoding and color conversion run on a background thread, which
+// keeps up to max_queued_frames frames ready for GetData(), and the codec
+// decodes on its own pool of num_threads threads where it supports it.
+//
+// The frame_selection option thins the output while skipping as much decoding
+// work as the codec allows. With KEYFRAMES_ONLY, other packets are never sent
+// to the codec. With the other selections, packets which the container marks
+// as disposable, i.e. not referenced by other frames, are dropped before
+// decoding when their frame is not selected. The other unselected frames are
+// decoded, since later frames depend on them, but not converted.
+//
+// The pixels of the output frames come from an ImageFramePool, and return to
+// it once the last packet holding a frame is released.
+//
+// Example usage:
+//   VideoDecoder decoder;
+//   MP_RETURN_IF_ERROR(decoder.Initialize(path, options));
+//   Packet frame;
+//   absl::Status status;
+//   while ((status = decoder.GetData(&frame)).ok()) {
+//     ...
+//   }
+class VideoDecoder {
+ public:
+  VideoDecoder();
+  ~VideoDecoder();
+
+  // Opens the file and starts decoding.
+  absl::Status Initialize(const std::string& input_file,
+                          const VideoDecoderOptions& options);
+
+  // Fills in the header of the output frames. The frame rate is the rate of
+  // the selected frames, or the stream frame rate with KEYFRAMES_ONLY.
+  absl::Status FillVideoHeader(VideoHeader* header) const;
+
+  // Returns the next selected frame as an ImageFrame packet at its
+  // presentation time. Frames whose timestamp does not increase are dropped.
+  // Returns tool::StatusStop() at the end of the stream.
+  absl::Status GetData(Packet* data);
+
+  absl::Status Close();
+
+ private:
+  // An output of the decoding thread.
+  struct QueueItem {
+    absl::Status status;
+    Packet data;
+  };
+
+  // Runs on decode_thread_, filling queue_.
+  void DecodeLoop();
+  // Decodes the whole stream. Returns tool::StatusStop() at its end.
+  absl::Status DecodeStream();
+  // Sends "packet" to the codec and outputs the frames it returns. A null
+  // "packet" flushes the codec.
+  absl::Status DecodePacket(const AVPacket* packet);
+  // Returns true if "packet" can be dropped without decoding it.
+  bool SkipPacket(const AVPacket& packet) const;
+  // Converts "frame" and queues it, if it is selected.
+  absl::Status OutputFrame(const AVFrame& frame);
+
+  // Returns the index of the frame at "pts" from the stream start.
+  int64 FrameIndex(int64 pts) const;
+  bool IsSelected(int64 frame_index) const;
+
+  // Queues "item", waiting for space. Returns false if decoding was stopped.
+  bool Push(QueueItem item);
+  void StopDecoding();
+  bool QueueHasSpace() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  bool QueueHasData() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  VideoDecoderOptions options_;
+  VideoHeader header_;
+
+  // Used by the decoding thread only, once started.
+  AVFormatContext* avformat_ctx_ = nullptr;
+  AVCodecContext* avcodec_ctx_ = nullptr;
+  AVFrame* decoded_frame_ = nullptr;
+  SwsContext* sws_ctx_ = nullptr;
+  AVPixelFormat output_pixel_format_ = AV_PIX_FMT_NONE;
+  int stream_id_ = -1;
+  AVRational time_base_{0, 0};
+  // Presentation time of frame 0, in time_base_ units.
+  int64 start_pts_ = AV_NOPTS_VALUE;
+  double frame_rate_ = 0;
+  Timestamp last_timestamp_ = Timestamp::Unset();
+  std::shared_ptr<ImageFramePool> frame_pool_;
+
+  absl::Mutex mutex_;
+  std::deque<QueueItem> queue_ ABSL_GUARDED_BY(mutex_);
+  bool stop_ ABSL_GUARDED_BY(mutex_) = false;
+  std::unique_ptr<std::thread> decode_thread_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_VIDEO_DECODER_H_
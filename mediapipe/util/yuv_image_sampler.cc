@@ -0,0 +1,366 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/yuv_image_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include "mediapipe/framework/port/ret_check.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define MEDIAPIPE_YUV_IMAGE_SAMPLER_NEON 1
+#endif
+
+namespace mediapipe {
+
+namespace {
+
+// Builds the matrix from the luma weights of red and blue.
+YuvToRgbMatrix MakeMatrix(float kr, float kb, bool full_range) {
+  const float kg = 1.0f - kr - kb;
+  const float chroma_scale = full_range ? 1.0f : 255.0f / 224.0f;
+  YuvToRgbMatrix matrix;
+  matrix.y_offset = full_range ? 0.0f : 16.0f;
+  matrix.y_scale = full_range ? 1.0f : 255.0f / 219.0f;
+  matrix.r_v = chroma_scale * 2.0f * (1.0f - kr);
+  matrix.g_u = chroma_scale * 2.0f * (1.0f - kb) * kb / kg;
+  matrix.g_v = chroma_scale * 2.0f * (1.0f - kr) * kr / kg;
+  matrix.b_u = chroma_scale * 2.0f * (1.0f - kb);
+  return matrix;
+}
+
+// Rounds to the nearest integer, ties to even, and saturates.
+inline uint8 ToByte(float value) {
+  return std::min(std::max(std::nearbyint(value), 0.0f), 255.0f);
+}
+
+template <int kChannels>
+inline void ConvertPixel(const YuvToRgbMatrix& matrix, int luma, int u, int v,
+                         uint8* output) {
+  const float y_term = (luma - matrix.y_offset) * matrix.y_scale;
+  const float u_term = u - 128.0f;
+  const float v_term = v - 128.0f;
+  output[0] = ToByte(y_term + matrix.r_v * v_term);
+  output[1] = ToByte(y_term - matrix.g_u * u_term - matrix.g_v * v_term);
+  output[2] = ToByte(y_term + matrix.b_u * u_term);
+  if (kChannels == 4) {
+    output[3] = 255;
+  }
+}
+
+// Number of pixels converted at once by ConvertBlock.
+constexpr int kBlockSize = 8;
+
+// Converts kBlockSize pixels starting at an even column. "u" and "v" point to
+// the chroma samples of the first pixel, which are kChromaStep bytes apart
+// from the next ones. With interleaved chroma, one byte past the last sample
+// is read.
+#if defined(__SSE2__)
+// Rounds the values of the low and high halves, ties to even, and saturates.
+inline __m128i ToBytes(__m128 lo, __m128 hi) {
+  const __m128i words =
+      _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+  return _mm_packus_epi16(words, words);
+}
+
+// Returns the four chroma samples of a block, each repeated for the two
+// pixels using it, as 16-bit values.
+template <int kChromaStep>
+inline __m128i LoadChroma(const uint8* chroma) {
+  __m128i samples;
+  if (kChromaStep == 1) {
+    int32_t bytes;
+    std::memcpy(&bytes, chroma, 4);
+    samples = _mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), _mm_setzero_si128());
+  } else {
+    samples = _mm_and_si128(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(chroma)),
+        _mm_set1_epi16(0xFF));
+  }
+  return _mm_unpacklo_epi16(samples, samples);
+}
+
+// Packs four pixels with a zero fourth byte into the first 12 bytes.
+inline __m128i PackRgb(__m128i pixels) {
+  // Moves the odd pixels next to the even ones within each 64-bit half...
+  const __m128i pairs = _mm_or_si128(
+      _mm_and_si128(pixels, _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF)),
+      _mm_srli_epi64(
+          _mm_and_si128(pixels, _mm_set_epi32(0xFFFFFF, 0, 0xFFFFFF, 0)), 8));
+  // ...then the second half next to the first one.
+  return _mm_or_si128(
+      _mm_and_si128(pairs, _mm_set_epi32(0, 0, 0xFFFF, -1)),
+      _mm_and_si128(_mm_srli_si128(pairs, 2),
+                    _mm_set_epi32(0, -1, 0xFFFF0000, 0)));
+}
+
+template <int kChannels, int kChromaStep>
+inline void ConvertBlock(const YuvToRgbMatrix& matrix, const uint8* luma,
+                         const uint8* u, const uint8* v, uint8* output) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i y16 = _mm_unpacklo_epi8(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma)), zero);
+  const __m128i u16 = LoadChroma<kChromaStep>(u);
+  const __m128i v16 = LoadChroma<kChromaStep>(v);
+
+  const __m128 y_offset = _mm_set1_ps(matrix.y_offset);
+  const __m128 y_scale = _mm_set1_ps(matrix.y_scale);
+  const __m128 chroma_offset = _mm_set1_ps(128.0f);
+  __m128 r[2], g[2], b[2];
+  for (int half = 0; half < 2; ++half) {
+    const __m128i y32 = half ? _mm_unpackhi_epi16(y16, zero)
+                             : _mm_unpacklo_epi16(y16, zero);
+    const __m128i u32 = half ? _mm_unpackhi_epi16(u16, zero)
+                             : _mm_unpacklo_epi16(u16, zero);
+    const __m128i v32 = half ? _mm_unpackhi_epi16(v16, zero)
+                             : _mm_unpacklo_epi16(v16, zero);
+    const __m128 y_term =
+        _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(y32), y_offset), y_scale);
+    const __m128 u_term = _mm_sub_ps(_mm_cvtepi32_ps(u32), chroma_offset);
+    const __m128 v_term = _mm_sub_ps(_mm_cvtepi32_ps(v32), chroma_offset);
+    r[half] =
+        _mm_add_ps(y_term, _mm_mul_ps(_mm_set1_ps(matrix.r_v), v_term));
+    g[half] = _mm_sub_ps(
+        _mm_sub_ps(y_term, _mm_mul_ps(_mm_set1_ps(matrix.g_u), u_term)),
+        _mm_mul_ps(_mm_set1_ps(matrix.g_v), v_term));
+    b[half] =
+        _mm_add_ps(y_term, _mm_mul_ps(_mm_set1_ps(matrix.b_u), u_term));
+  }
+
+  // Interleaves the channels into pixels, with a fourth byte set to 255 or to
+  // zero when dropped.
+  const __m128i rg =
+      _mm_unpacklo_epi8(ToBytes(r[0], r[1]), ToBytes(g[0], g[1]));
+  const __m128i ba = _mm_unpacklo_epi8(
+      ToBytes(b[0], b[1]), kChannels == 4 ? _mm_set1_epi8(-1) : zero);
+  const __m128i pixels_lo = _mm_unpacklo_epi16(rg, ba);
+  const __m128i pixels_hi = _mm_unpackhi_epi16(rg, ba);
+  if (kChannels == 4) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), pixels_lo);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 16), pixels_hi);
+  } else {
+    // The 4 bytes past the first pixels are overwritten by the last ones.
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output), PackRgb(pixels_lo));
+    const __m128i last = PackRgb(pixels_hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + 12), last);
+    const int32_t last_bytes = _mm_cvtsi128_si32(_mm_srli_si128(last, 8));
+    std::memcpy(output + 20, &last_bytes, 4);
+  }
+}
+#elif MEDIAPIPE_YUV_IMAGE_SAMPLER_NEON
+// Rounds the values of the low and high halves, ties to even, and saturates.
+inline uint8x8_t ToBytes(float32x4_t lo, float32x4_t hi) {
+  const int16x8_t words = vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(lo)),
+                                       vqmovn_s32(vcvtnq_s32_f32(hi)));
+  return vqmovun_s16(words);
+}
+
+// Returns the four chroma samples of a block, each repeated for the two
+// pixels using it, as 16-bit values.
+template <int kChromaStep>
+inline uint16x8_t LoadChroma(const uint8* chroma) {
+  uint8x8_t samples;
+  if (kChromaStep == 1) {
+    uint32_t bytes;
+    std::memcpy(&bytes, chroma, 4);
+    samples = vreinterpret_u8_u32(vdup_n_u32(bytes));
+  } else {
+    const uint8x8_t interleaved = vld1_u8(chroma);
+    samples = vuzp1_u8(interleaved, interleaved);
+  }
+  return vmovl_u8(vzip1_u8(samples, samples));
+}
+
+template <int kChannels, int kChromaStep>
+inline void ConvertBlock(const YuvToRgbMatrix& matrix, const uint8* luma,
+                         const uint8* u, const uint8* v, uint8* output) {
+  const uint16x8_t y16 = vmovl_u8(vld1_u8(luma));
+  const uint16x8_t u16 = LoadChroma<kChromaStep>(u);
+  const uint16x8_t v16 = LoadChroma<kChromaStep>(v);
+
+  const float32x4_t y_offset = vdupq_n_f32(matrix.y_offset);
+  const float32x4_t y_scale = vdupq_n_f32(matrix.y_scale);
+  const float32x4_t chroma_offset = vdupq_n_f32(128.0f);
+  float32x4_t r[2], g[2], b[2];
+  for (int half = 0; half < 2; ++half) {
+    const uint32x4_t y32 =
+        vmovl_u16(half ? vget_high_u16(y16) : vget_low_u16(y16));
+    const uint32x4_t u32 =
+        vmovl_u16(half ? vget_high_u16(u16) : vget_low_u16(u16));
+    const uint32x4_t v32 =
+        vmovl_u16(half ? vget_high_u16(v16) : vget_low_u16(v16));
+    const float32x4_t y_term =
+        vmulq_f32(vsubq_f32(vcvtq_f32_u32(y32), y_offset), y_scale);
+    const float32x4_t u_term = vsubq_f32(vcvtq_f32_u32(u32), chroma_offset);
+    const float32x4_t v_term = vsubq_f32(vcvtq_f32_u32(v32), chroma_offset);
+    r[half] = vaddq_f32(y_term, vmulq_n_f32(v_term, matrix.r_v));
+    g[half] = vsubq_f32(vsubq_f32(y_term, vmulq_n_f32(u_term, matrix.g_u)),
+                        vmulq_n_f32(v_term, matrix.g_v));
+    b[half] = vaddq_f32(y_term, vmulq_n_f32(u_term, matrix.b_u));
+  }
+
+  if (kChannels == 4) {
+    uint8x8x4_t rgba;
+    rgba.val[0] = ToBytes(r[0], r[1]);
+    rgba.val[1] = ToBytes(g[0], g[1]);
+    rgba.val[2] = ToBytes(b[0], b[1]);
+    rgba.val[3] = vdup_n_u8(255);
+    vst4_u8(output, rgba);
+  } else {
+    uint8x8x3_t rgb;
+    rgb.val[0] = ToBytes(r[0], r[1]);
+    rgb.val[1] = ToBytes(g[0], g[1]);
+    rgb.val[2] = ToBytes(b[0], b[1]);
+    vst3_u8(output, rgb);
+  }
+}
+#else
+template <int kChannels, int kChromaStep>
+inline void ConvertBlock(const YuvToRgbMatrix& matrix, const uint8* luma,
+                         const uint8* u, const uint8* v, uint8* output) {
+  for (int i = 0; i < kBlockSize; ++i) {
+    const int chroma = i / 2 * kChromaStep;
+    ConvertPixel<kChannels>(matrix, luma[i], u[chroma], v[chroma],
+                            output + i * kChannels);
+  }
+}
+#endif  // defined(__SSE2__)
+
+template <int kChannels, int kChromaStep>
+void ConvertRow(const YuvToRgbMatrix& matrix, const uint8* y_row,
+                const uint8* u_row, const uint8* v_row, int left, int width,
+                uint8* output) {
+  const int end = left + width;
+  int x = left;
+  auto convert_pixel = [&]() {
+    const int chroma = (x >> 1) * kChromaStep;
+    ConvertPixel<kChannels>(matrix, y_row[x], u_row[chroma], v_row[chroma],
+                            output);
+    output += kChannels;
+    ++x;
+  };
+  // Blocks start at an even column.
+  if (x < end && (x & 1)) convert_pixel();
+  // The pixel after a block must be in the row, since its chroma samples may
+  // be read.
+  while (x + kBlockSize < end) {
+    const int chroma = (x >> 1) * kChromaStep;
+    ConvertBlock<kChannels, kChromaStep>(matrix, y_row + x, u_row + chroma,
+                                         v_row + chroma, output);
+    output += kBlockSize * kChannels;
+    x += kBlockSize;
+  }
+  while (x < end) convert_pixel();
+}
+
+}  // namespace
+
+YuvToRgbMatrix YuvToRgbMatrix::Bt601(bool full_range) {
+  return MakeMatrix(0.299f, 0.114f, full_range);
+}
+
+YuvToRgbMatrix YuvToRgbMatrix::Bt709(bool full_range) {
+  return MakeMatrix(0.2126f, 0.0722f, full_range);
+}
+
+YuvToRgbMatrix YuvToRgbMatrix::ForImage(const YUVImage& image) {
+  if (image.matrix_coefficients() ==
+      YUVImage::COLOR_MATRIX_COEFFICIENTS_BT709) {
+    return Bt709(image.full_range());
+  }
+  return Bt601(image.full_range());
+}
+
+bool YUVImageSampler::IsSupported(const YUVImage& image) {
+  if (image.bit_depth() != 8) return false;
+  switch (image.fourcc()) {
+    case libyuv::FOURCC_I420:
+    case libyuv::FOURCC_NV12:
+    case libyuv::FOURCC_NV21:
+      return true;
+    default:
+      return false;
+  }
+}
+
+YUVImageSampler::YUVImageSampler(const YUVImage& image,
+                                 const YuvToRgbMatrix& matrix)
+    : y_plane_(image.data(0)),
+      y_stride_(image.stride(0)),
+      chroma_stride_(image.stride(1)),
+      width_(image.width()),
+      height_(image.height()),
+      matrix_(matrix) {
+  switch (image.fourcc()) {
+    case libyuv::FOURCC_NV12:
+      u_plane_ = image.data(1);
+      v_plane_ = image.data(1) + 1;
+      chroma_step_ = 2;
+      break;
+    case libyuv::FOURCC_NV21:
+      u_plane_ = image.data(1) + 1;
+      v_plane_ = image.data(1);
+      chroma_step_ = 2;
+      break;
+    default:
+      u_plane_ = image.data(1);
+      v_plane_ = image.data(2);
+      chroma_step_ = 1;
+      break;
+  }
+}
+
+absl::Status YUVImageSampler::ConvertRegion(int left, int top,
+                                            ImageFrame* output) const {
+  RET_CHECK(output->Format() == ImageFormat::SRGB ||
+            output->Format() == ImageFormat::SRGBA)
+      << "Unsupported output format: " << output->Format();
+  RET_CHECK(left >= 0 && top >= 0 && left + output->Width() <= width_ &&
+            top + output->Height() <= height_)
+      << "Region is outside of the image.";
+  for (int y = 0; y < output->Height(); ++y) {
+    const int row = top + y;
+    const uint8* y_row = y_plane_ + row * y_stride_;
+    const uint8* u_row = u_plane_ + (row >> 1) * chroma_stride_;
+    const uint8* v_row = v_plane_ + (row >> 1) * chroma_stride_;
+    uint8* output_row = output->MutablePixelData() + y * output->WidthStep();
+    const bool has_alpha = output->Format() == ImageFormat::SRGBA;
+    if (chroma_step_ == 1) {
+      if (has_alpha) {
+        ConvertRow<4, 1>(matrix_, y_row, u_row, v_row, left, output->Width(),
+                         output_row);
+      } else {
+        ConvertRow<3, 1>(matrix_, y_row, u_row, v_row, left, output->Width(),
+                         output_row);
+      }
+    } else {
+      if (has_alpha) {
+        ConvertRow<4, 2>(matrix_, y_row, u_row, v_row, left, output->Width(),
+                         output_row);
+      } else {
+        ConvertRow<3, 2>(matrix_, y_row, u_row, v_row, left, output->Width(),
+                         output_row);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace mediapipe
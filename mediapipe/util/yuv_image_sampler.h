@@ -0,0 +1,158 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MEDIAPIPE_UTIL_YUV_IMAGE_SAMPLER_H_
+#define MEDIAPIPE_UTIL_YUV_IMAGE_SAMPLER_H_
+
+#include <algorithm>
+
+#include "mediapipe/framework/formats/image_frame.h"
+#include "mediapipe/framework/formats/yuv_image.h"
+#include "mediapipe/framework/port/integral_types.h"
+#include "mediapipe/framework/port/status.h"
+
+namespace mediapipe {
+
+// Coefficients of a YCbCr to RGB conversion:
+//   R = y_scale * (Y - y_offset)                    + r_v * (V - 128)
+//   G = y_scale * (Y - y_offset) - g_u * (U - 128) - g_v * (V - 128)
+//   B = y_scale * (Y - y_offset) + b_u * (U - 128)
+struct YuvToRgbMatrix {
+  float y_offset;
+  float y_scale;
+  float r_v;
+  float g_u;
+  float g_v;
+  float b_u;
+
+  // ITU-R BT.601 and BT.709, with luma in [16, 235] and chroma in [16, 240]
+  // unless "full_range" is true.
+  static YuvToRgbMatrix Bt601(bool full_range);
+  static YuvToRgbMatrix Bt709(bool full_range);
+
+  // The conversion described by the color metadata of "image". Images with
+  // unspecified coefficients are treated as BT.601, as libyuv does.
+  static YuvToRgbMatrix ForImage(const YUVImage& image);
+};
+
+// Reads RGB pixels from an 8-bit YUVImage with 4:2:0 chroma subsampling (I420,
+// NV12 or NV21) without converting the whole image, so that calculators that
+// only need a crop or a few small regions can sample the planes directly.
+//
+// As in libyuv, every pixel uses the chroma sample of its 2x2 block.
+class YUVImageSampler {
+ public:
+  // Returns true if the fourcc and bit depth of "image" are supported.
+  static bool IsSupported(const YUVImage& image);
+
+  // "image" must be supported and outlive the sampler.
+  YUVImageSampler(const YUVImage& image, const YuvToRgbMatrix& matrix);
+  explicit YUVImageSampler(const YUVImage& image)
+      : YUVImageSampler(image, YuvToRgbMatrix::ForImage(image)) {}
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  const YuvToRgbMatrix& matrix() const { return matrix_; }
+
+  // Returns the luma and chroma of pixel (x, y), which must be in the image.
+  inline void GetYuv(int x, int y, int* luma, int* u, int* v) const {
+    const int chroma_offset =
+        (y >> 1) * chroma_stride_ + (x >> 1) * chroma_step_;
+    *luma = y_plane_[y * y_stride_ + x];
+    *u = u_plane_[chroma_offset];
+    *v = v_plane_[chroma_offset];
+  }
+
+  // Converts a luma and chroma value to RGB in [0, 255].
+  inline void YuvToRgb(float luma, float u, float v, float* rgb) const {
+    const float y_term = matrix_.y_scale * (luma - matrix_.y_offset);
+    u -= 128.0f;
+    v -= 128.0f;
+    rgb[0] = Clamp(y_term + matrix_.r_v * v);
+    rgb[1] = Clamp(y_term - matrix_.g_u * u - matrix_.g_v * v);
+    rgb[2] = Clamp(y_term + matrix_.b_u * u);
+  }
+
+  // Returns the RGB value at (x, y) with bilinear interpolation, where (0, 0)
+  // is the center of the top left pixel. Outside of the image, border pixels
+  // are replicated if "replicate_border" is true, and black is used otherwise.
+  // Luma and chroma are interpolated before the conversion.
+  inline void SampleBilinear(float x, float y, bool replicate_border,
+                             float* rgb) const {
+    x = std::min(std::max(x, -2.0f), width_ + 1.0f);
+    y = std::min(std::max(y, -2.0f), height_ + 1.0f);
+    // Truncation rounds down the non-negative shifted coordinates.
+    const int x0 = static_cast<int>(x + 2.0f) - 2;
+    const int y0 = static_cast<int>(y + 2.0f) - 2;
+    const float wx = x - x0;
+    const float wy = y - y0;
+    float p00[3], p01[3], p10[3], p11[3];
+    Tap(x0, y0, replicate_border, p00);
+    Tap(x0 + 1, y0, replicate_border, p01);
+    Tap(x0, y0 + 1, replicate_border, p10);
+    Tap(x0 + 1, y0 + 1, replicate_border, p11);
+    float yuv[3];
+    for (int c = 0; c < 3; ++c) {
+      const float top = p00[c] + (p01[c] - p00[c]) * wx;
+      const float bottom = p10[c] + (p11[c] - p10[c]) * wx;
+      yuv[c] = top + (bottom - top) * wy;
+    }
+    YuvToRgb(yuv[0], yuv[1], yuv[2], rgb);
+  }
+
+  // Converts the region of the image starting at (left, top) with the size of
+  // "output", which must be SRGB or SRGBA and fit in the image. The alpha
+  // channel is set to 255.
+  absl::Status ConvertRegion(int left, int top, ImageFrame* output) const;
+
+ private:
+  static float Clamp(float value) {
+    return std::min(std::max(value, 0.0f), 255.0f);
+  }
+
+  // Writes the luma and chroma of pixel (x, y) to "yuv". Outside of the image,
+  // returns a border pixel or black.
+  inline void Tap(int x, int y, bool replicate_border, float* yuv) const {
+    if (replicate_border) {
+      x = std::min(std::max(x, 0), width_ - 1);
+      y = std::min(std::max(y, 0), height_ - 1);
+    } else if (x < 0 || y < 0 || x >= width_ || y >= height_) {
+      yuv[0] = matrix_.y_offset;
+      yuv[1] = 128.0f;
+      yuv[2] = 128.0f;
+      return;
+    }
+    int luma, u, v;
+    GetYuv(x, y, &luma, &u, &v);
+    yuv[0] = luma;
+    yuv[1] = u;
+    yuv[2] = v;
+  }
+
+  const uint8* y_plane_;
+  const uint8* u_plane_;
+  const uint8* v_plane_;
+  int y_stride_;
+  int chroma_stride_;
+  // Distance between the chroma samples of adjacent 2x2 blocks: 1 for planar
+  // chroma, 2 for interleaved chroma.
+  int chroma_step_;
+  int width_;
+  int height_;
+  YuvToRgbMatrix matrix_;
+};
+
+}  // namespace mediapipe
+
+#endif  // MEDIAPIPE_UTIL_YUV_IMAGE_SAMPLER_H_
@@ -0,0 +1,200 @@
+// Copyright 2021 The MediaPipe Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mediapipe/util/yuv_image_sampler.h"
+
+#include <cstring>
+#include <memory>
+
+#include "absl/memory/memory.h"
+#include "mediapipe/framework/port/benchmark.h"
+#include "mediapipe/framework/port/gtest.h"
+#include "mediapipe/framework/port/status_matchers.h"
+#include "mediapipe/util/image_frame_util.h"
+
+namespace mediapipe {
+namespace {
+
+// Returns an I420 image with varied luma and chroma.
+std::unique_ptr<YUVImage> MakeI420Image(int width, int height) {
+  const int chroma_width = (width + 1) / 2;
+  const int chroma_height = (height + 1) / 2;
+  auto y = absl::make_unique<uint8[]>(width * height);
+  auto u = absl::make_unique<uint8[]>(chroma_width * chroma_height);
+  auto v = absl::make_unique<uint8[]>(chroma_width * chroma_height);
+  for (int i = 0; i < width * height; ++i) {
+    y[i] = (i * 37) % 256;
+  }
+  for (int i = 0; i < chroma_width * chroma_height; ++i) {
+    u[i] = (i * 53 + 11) % 256;
+    v[i] = (i * 29 + 97) % 256;
+  }
+  return absl::make_unique<YUVImage>(libyuv::FOURCC_I420, std::move(y), width,
+                                     std::move(u), chroma_width, std::move(v),
+                                     chroma_width, width, height);
+}
+
+// Returns the same image with interleaved chroma, in NV12 or NV21 order.
+std::unique_ptr<YUVImage> ToSemiPlanar(const YUVImage& image, bool nv21) {
+  const int chroma_width = (image.width() + 1) / 2;
+  const int chroma_height = (image.height() + 1) / 2;
+  auto y = absl::make_unique<uint8[]>(image.width() * image.height());
+  auto uv = absl::make_unique<uint8[]>(2 * chroma_width * chroma_height);
+  std::memcpy(y.get(), image.data(0), image.width() * image.height());
+  for (int i = 0; i < chroma_width * chroma_height; ++i) {
+    uv[2 * i + (nv21 ? 1 : 0)] = image.data(1)[i];
+    uv[2 * i + (nv21 ? 0 : 1)] = image.data(2)[i];
+  }
+  return absl::make_unique<YUVImage>(
+      nv21 ? libyuv::FOURCC_NV21 : libyuv::FOURCC_NV12, std::move(y),
+      image.width(), std::move(uv), 2 * chroma_width, nullptr, 0,
+      image.width(), image.height());
+}
+
+TEST(YUVImageSamplerTest, IsSupported) {
+  auto image = MakeI420Image(8, 8);
+  EXPECT_TRUE(YUVImageSampler::IsSupported(*image));
+  EXPECT_TRUE(YUVImageSampler::IsSupported(*ToSemiPlanar(*image, false)));
+  image->set_fourcc(libyuv::FOURCC_ANY);
+  EXPECT_FALSE(YUVImageSampler::IsSupported(*image));
+}
+
+TEST(YUVImageSamplerTest, ConvertRegionMatchesBt601) {
+  auto image = MakeI420Image(33, 21);
+  const YUVImageSampler sampler(*image);
+  ImageFrame output(ImageFormat::SRGB, 20, 13);
+  MP_ASSERT_OK(sampler.ConvertRegion(7, 5, &output));
+  for (int y = 0; y < output.Height(); ++y) {
+    const uint8* row = output.PixelData() + y * output.WidthStep();
+    for (int x = 0; x < output.Width(); ++x) {
+      int luma, u, v;
+      sampler.GetYuv(x + 7, y + 5, &luma, &u, &v);
+      uint8 rgb[3];
+      image_frame_util::MpegYCbCrToSrgb(luma, u, v, &rgb[0], &rgb[1], &rgb[2]);
+      for (int c = 0; c < 3; ++c) {
+        EXPECT_NEAR(row[x * 3 + c], rgb[c], 1) << x << "," << y << "," << c;
+      }
+    }
+  }
+}
+
+TEST(YUVImageSamplerTest, SemiPlanarFormatsMatchI420) {
+  auto image = MakeI420Image(30, 18);
+  ImageFrame expected(ImageFormat::SRGBA, 30, 18);
+  MP_ASSERT_OK(YUVImageSampler(*image).ConvertRegion(0, 0, &expected));
+  for (bool nv21 : {false, true}) {
+    auto semi_planar = ToSemiPlanar(*image, nv21);
+    ImageFrame output(ImageFormat::SRGBA, 30, 18);
+    MP_ASSERT_OK(YUVImageSampler(*semi_planar).ConvertRegion(0, 0, &output));
+    for (int y = 0; y < output.Height(); ++y) {
+      EXPECT_EQ(0, std::memcmp(expected.PixelData() + y * expected.WidthStep(),
+                               output.PixelData() + y * output.WidthStep(),
+                               30 * 4))
+          << "nv21: " << nv21 << ", row " << y;
+    }
+  }
+}
+
+TEST(YUVImageSamplerTest, ConvertRegionRejectsInvalidRegions) {
+  auto image = MakeI420Image(16, 16);
+  const YUVImageSampler sampler(*image);
+  ImageFrame output(ImageFormat::SRGB, 8, 8);
+  EXPECT_FALSE(sampler.ConvertRegion(9, 0, &output).ok());
+  EXPECT_FALSE(sampler.ConvertRegion(0, -1, &output).ok());
+  ImageFrame gray(ImageFormat::GRAY8, 8, 8);
+  EXPECT_FALSE(sampler.ConvertRegion(0, 0, &gray).ok());
+}
+
+TEST(YUVImageSamplerTest, SampleBilinear) {
+  auto image = MakeI420Image(16, 16);
+  const YUVImageSampler sampler(*image);
+  ImageFrame converted(ImageFormat::SRGB, 16, 16);
+  MP_ASSERT_OK(sampler.ConvertRegion(0, 0, &converted));
+  auto pixel = [&converted](int x, int y, int c) {
+    return converted.PixelData()[y * converted.WidthStep() + x * 3 + c];
+  };
+
+  // Pixel centers.
+  float rgb[3];
+  sampler.SampleBilinear(5.0f, 9.0f, false, rgb);
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_NEAR(rgb[c], pixel(5, 9, c), 1.0f);
+  }
+  // Between two pixels of a 2x2 block, only luma is interpolated.
+  int luma0, luma1, u, v;
+  sampler.GetYuv(4, 2, &luma0, &u, &v);
+  sampler.GetYuv(5, 2, &luma1, &u, &v);
+  float expected[3];
+  sampler.YuvToRgb(0.5f * (luma0 + luma1), u, v, expected);
+  sampler.SampleBilinear(4.5f, 2.0f, false, rgb);
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_FLOAT_EQ(rgb[c], expected[c]);
+  }
+
+  // Outside of the image.
+  sampler.SampleBilinear(-3.0f, 20.0f, false, rgb);
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_FLOAT_EQ(rgb[c], 0.0f);
+  }
+  sampler.SampleBilinear(-3.0f, 20.0f, true, rgb);
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_NEAR(rgb[c], pixel(0, 15, c), 1.0f);
+  }
+  // Half way between the border pixel and black.
+  sampler.SampleBilinear(15.5f, 0.0f, false, rgb);
+  sampler.GetYuv(15, 0, &luma0, &u, &v);
+  sampler.YuvToRgb(0.5f * (luma0 + 16.0f), 0.5f * (u + 128.0f),
+                   0.5f * (v + 128.0f), expected);
+  for (int c = 0; c < 3; ++c) {
+    EXPECT_FLOAT_EQ(rgb[c], expected[c]);
+  }
+}
+
+TEST(YUVImageSamplerTest, Matrices) {
+  auto image = MakeI420Image(8, 8);
+  image->set_matrix_coefficients(YUVImage::COLOR_MATRIX_COEFFICIENTS_BT709);
+  image->set_full_range(true);
+  const YUVImageSampler sampler(*image);
+  EXPECT_FLOAT_EQ(sampler.matrix().y_offset, 0.0f);
+  EXPECT_FLOAT_EQ(sampler.matrix().y_scale, 1.0f);
+  EXPECT_NEAR(sampler.matrix().r_v, 1.5748f, 1e-4f);
+  EXPECT_NEAR(sampler.matrix().g_u, 0.1873f, 1e-4f);
+  EXPECT_NEAR(sampler.matrix().g_v, 0.4681f, 1e-4f);
+  EXPECT_NEAR(sampler.matrix().b_u, 1.8556f, 1e-4f);
+
+  // White and black are preserved by the limited range matrices.
+  for (const auto& matrix :
+       {YuvToRgbMatrix::Bt601(false), YuvToRgbMatrix::Bt709(false)}) {
+    const YUVImageSampler limited(*image, matrix);
+    float rgb[3];
+    limited.YuvToRgb(235.0f, 128.0f, 128.0f, rgb);
+    EXPECT_FLOAT_EQ(rgb[0], 255.0f);
+    EXPECT_FLOAT_EQ(rgb[2], 255.0f);
+    limited.YuvToRgb(16.0f, 128.0f, 128.0f, rgb);
+    EXPECT_FLOAT_EQ(rgb[1], 0.0f);
+  }
+}
+
+void BM_ConvertRegion(benchmark::State& state) {
+  auto image = MakeI420Image(1920, 1080);
+  const YUVImageSampler sampler(*image);
+  ImageFrame output(ImageFormat::SRGB, state.range(0), state.range(1));
+  for (auto _ : state) {
+    sampler.ConvertRegion(0, 0, &output).IgnoreError();
+  }
+}
+BENCHMARK(BM_ConvertRegion)->Args({1920, 1080})->Args({256, 256});
+
+}  // namespace
+}  // namespace mediapipe